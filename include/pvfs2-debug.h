@@ -80,11 +80,12 @@
 #define GOSSIP_SECURITY_DEBUG          ((uint64_t)1 << 58)
 #define GOSSIP_USRINT_DEBUG            ((uint64_t)1 << 59)
 #define GOSSIP_SECCACHE_DEBUG          ((uint64_t)1 << 60)
+#define GOSSIP_BMI_DEBUG_SHM           ((uint64_t)1 << 61)
 
 #define GOSSIP_BMI_DEBUG_ALL (uint64_t)                               \
 (GOSSIP_BMI_DEBUG_TCP + GOSSIP_BMI_DEBUG_CONTROL +                    \
  GOSSIP_BMI_DEBUG_GM + GOSSIP_BMI_DEBUG_OFFSETS + GOSSIP_BMI_DEBUG_IB \
- + GOSSIP_BMI_DEBUG_MX + GOSSIP_BMI_DEBUG_PORTALS)
+ + GOSSIP_BMI_DEBUG_MX + GOSSIP_BMI_DEBUG_PORTALS + GOSSIP_BMI_DEBUG_SHM)
 
 const char *PVFS_debug_get_next_debug_keyword(
     int position);
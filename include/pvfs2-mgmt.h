@@ -25,6 +25,7 @@
 
 #include "pvfs2-sysint.h"
 #include "pvfs2-types.h"
+#include "pvfs2-event.h"
 #include "pint-uid-mgmt.h"
 
 /* non-blocking mgmt operation handle */
@@ -89,6 +90,11 @@ enum PINT_server_perf_keys
     PINT_PERF_IO = 20,                  /* io requests called */
     PINT_PERF_SMALL_IO = 21,            /* small_io requests called */
     PINT_PERF_READDIR = 22,             /* readdir requests called */
+    PINT_PERF_FAIR_WAITING = 23,        /* requests held by fair-share */
+    PINT_PERF_FAIR_CLASSES = 24,        /* classes with held requests */
+    PINT_PERF_FAIR_DEPTH = 25,          /* deepest fair-share class queue */
+    PINT_PERF_SM_ALLOCS = 26,           /* state machine allocations */
+    PINT_PERF_SM_ALLOC_MISSES = 27,     /* of those, not served by a cache */
 };
 
 /*
@@ -106,10 +112,15 @@ enum PINT_server_perf_tkeys
     PINT_PERF_TIO = 7,                  /* time for io requests */
     PINT_PERF_TSMALL_IO = 8,            /* time for small_io requests */
     PINT_PERF_TREADDIR = 9,             /* time for readdir requests */
+    PINT_PERF_TBMI = 10,                /* time for BMI jobs */
+    PINT_PERF_TTROVE = 11,              /* time for Trove jobs */
+    PINT_PERF_TFLOW = 12,               /* time for flow jobs */
 };
 
-/** A counter is simply a 64-bit integer.  A timer is 4 64-bit integers 
+/** A counter is simply a 64-bit integer.  A timer is 7 64-bit integers 
  * This is included int the perf structs in common/misc/pint-perf-counter
+ * sum, count, min and max accumulate across intervals; the percentiles
+ * describe only the time samples taken during the sample's interval.
  */
 struct PINT_perf_timer
 {
@@ -117,6 +128,9 @@ struct PINT_perf_timer
     int64_t count; /* the number of time samples currently in sum */
     int64_t min;   /* minimum time sample */
     int64_t max;   /* maximum time sample */
+    int64_t p50;   /* median time sample in this interval */
+    int64_t p99;   /* 99th percentile time sample in this interval */
+    int64_t p999;  /* 99.9th percentile time sample in this interval */
 };
 
 /* low level information about individual server level objects */
@@ -138,27 +152,149 @@ endecode_fields_7_struct(
   PVFS_size, b_size,
   PVFS_handle, dirdata_handle);
 
-/* individual datapoint from event monitoring */
+/* individual datapoint from event monitoring; event and label index the
+ * newline separated name table returned alongside the events
+ */
 struct PVFS_mgmt_event
 {
-    int32_t api;
-    int32_t operation;
-    int64_t value;
-    PVFS_id_gen_t id;
-    int32_t flags;
-    int32_t tv_sec;
-    int32_t tv_usec;
+    int32_t event;      /* which event definition recorded this */
+    int32_t thread;     /* server thread that recorded it */
+    int64_t value;      /* first numeric argument, if any */
+    PVFS_id_gen_t id;   /* pairs PVFS_EVENT_FLAG_START with _END */
+    int32_t flags;      /* PVFS_EVENT_FLAG_* */
+    int32_t label;      /* name table index, or -1 */
+    int64_t timestamp;  /* nanoseconds since the epoch */
 };
-endecode_fields_8_struct(
+endecode_fields_7_struct(
     PVFS_mgmt_event,
-    int32_t, api,
-    int32_t, operation,
+    int32_t, event,
+    int32_t, thread,
     int64_t, value,
     PVFS_id_gen_t, id,
     int32_t, flags,
-    int32_t, tv_sec,
-    int32_t, tv_usec,
-    skip4,);
+    int32_t, label,
+    int64_t, timestamp);
+
+/* heavy hitter tables kept by each server, see PVFS_mgmt_get_top_list() */
+enum PVFS_mgmt_top_kind
+{
+    PVFS_MGMT_TOP_CLIENT = 0,   /* by client BMI address */
+    PVFS_MGMT_TOP_UID = 1,      /* by uid from the credential */
+    PVFS_MGMT_TOP_HANDLE = 2,   /* by target object */
+};
+#define PVFS_MGMT_TOP_KINDS 3
+
+/* which count a heavy hitter table is ranked by */
+enum PVFS_mgmt_top_metric
+{
+    PVFS_MGMT_TOP_OPS = 0,
+    PVFS_MGMT_TOP_BYTES = 1,
+};
+#define PVFS_MGMT_TOP_METRICS 2
+
+/* one heavy hitter; counts decay over time, and the ranked count may
+ * overstate the true value by at most error
+ */
+struct PVFS_mgmt_top_entry
+{
+    uint64_t key;    /* handle, uid, or index into the client name table */
+    uint64_t ops;    /* requests */
+    uint64_t bytes;  /* bytes read or written */
+    uint64_t error;  /* overestimate bound of the ranked count */
+};
+endecode_fields_4_struct(
+    PVFS_mgmt_top_entry,
+    uint64_t, key,
+    uint64_t, ops,
+    uint64_t, bytes,
+    uint64_t, error);
+
+/* running totals of PVFS_mgmt_remove_tree(), reported after each batch */
+struct PVFS_mgmt_remove_tree_progress
+{
+    uint64_t removed;   /* entries removed along with their objects */
+    uint64_t failed;    /* entries that could not be removed */
+    uint64_t dirs;      /* directories visited */
+    PVFS_error error;   /* first failure, 0 if none */
+};
+
+typedef void (*PVFS_mgmt_remove_tree_cb)(
+    const struct PVFS_mgmt_remove_tree_progress *progress,
+    void *arg);
+
+/* tests applied by PVFS_mgmt_scan_list(); each server checks them
+ * against its own objects and returns only those that pass every test
+ * named in the mask
+ */
+enum PVFS_mgmt_scan_test
+{
+    PVFS_MGMT_SCAN_TYPE = 1,    /* objtype is in type_mask */
+    PVFS_MGMT_SCAN_UID = 2,
+    PVFS_MGMT_SCAN_GID = 4,
+    PVFS_MGMT_SCAN_SIZE = 8,    /* size within [min_size, max_size] */
+    PVFS_MGMT_SCAN_ATIME = 16,  /* atime within [min_atime, max_atime] */
+    PVFS_MGMT_SCAN_MTIME = 32,
+    PVFS_MGMT_SCAN_CTIME = 64,
+};
+
+/* a server only knows the size of datafiles (bytes in the bstream), so
+ * the size test passes every other type; the logical size of a file must
+ * be fetched by the caller
+ */
+struct PVFS_mgmt_scan_filter
+{
+    uint32_t mask;        /* PVFS_MGMT_SCAN_* tests to apply */
+    uint32_t type_mask;   /* PVFS_TYPE_* values or'd together */
+    PVFS_uid uid;
+    PVFS_gid gid;
+    PVFS_size min_size;
+    PVFS_size max_size;
+    PVFS_time min_atime;
+    PVFS_time max_atime;
+    PVFS_time min_mtime;
+    PVFS_time max_mtime;
+    PVFS_time min_ctime;
+    PVFS_time max_ctime;
+};
+endecode_fields_12_struct(
+    PVFS_mgmt_scan_filter,
+    uint32_t, mask,
+    uint32_t, type_mask,
+    PVFS_uid, uid,
+    PVFS_gid, gid,
+    PVFS_size, min_size,
+    PVFS_size, max_size,
+    PVFS_time, min_atime,
+    PVFS_time, max_atime,
+    PVFS_time, min_mtime,
+    PVFS_time, max_mtime,
+    PVFS_time, min_ctime,
+    PVFS_time, max_ctime);
+
+/* one object that passed a scan */
+struct PVFS_mgmt_scan_rec
+{
+    PVFS_handle handle;
+    PVFS_ds_type type;
+    PVFS_uid uid;
+    PVFS_gid gid;
+    PVFS_permissions mode;
+    PVFS_size size;       /* see PVFS_mgmt_scan_filter, 0 if unknown */
+    PVFS_time atime;
+    PVFS_time mtime;
+    PVFS_time ctime;
+};
+endecode_fields_9_struct(
+    PVFS_mgmt_scan_rec,
+    PVFS_handle, handle,
+    PVFS_ds_type, type,
+    PVFS_uid, uid,
+    PVFS_gid, gid,
+    PVFS_permissions, mode,
+    PVFS_size, size,
+    PVFS_time, atime,
+    PVFS_time, mtime,
+    PVFS_time, ctime);
 
 /* values which may be or'd together in the flags field above */
 enum
@@ -298,6 +434,7 @@ PVFS_error PVFS_imgmt_event_mon_list(
     PVFS_fs_id fs_id,
     const PVFS_credential *credential,
     struct PVFS_mgmt_event** event_matrix,
+    char **event_names,
     PVFS_BMI_addr_t *addr_array,
     int server_count,
     int event_count,
@@ -310,6 +447,7 @@ PVFS_error PVFS_mgmt_event_mon_list(
     PVFS_fs_id fs_id,
     const PVFS_credential *credential,
     struct PVFS_mgmt_event **event_matrix,
+    char **event_names,
     PVFS_BMI_addr_t *addr_array,
     int server_count,
     int event_count,
@@ -498,6 +636,93 @@ PVFS_error PVFS_mgmt_get_uid_list(
     PVFS_hint hints,
     void *user_ptr);
 
+PVFS_error PVFS_imgmt_get_top_list(
+    PVFS_fs_id fs_id,
+    const PVFS_credential *credential,
+    int server_count,
+    PVFS_BMI_addr_t *addr_array,
+    enum PVFS_mgmt_top_kind kind,
+    enum PVFS_mgmt_top_metric metric,
+    int entry_count,
+    struct PVFS_mgmt_top_entry **entry_matrix,
+    uint32_t *count_array,
+    char **client_names,
+    PVFS_mgmt_op_id *op_id,
+    PVFS_hint hints,
+    void *user_ptr);
+
+PVFS_error PVFS_mgmt_get_top_list(
+    PVFS_fs_id fs_id,
+    const PVFS_credential *credential,
+    int server_count,
+    PVFS_BMI_addr_t *addr_array,
+    enum PVFS_mgmt_top_kind kind,
+    enum PVFS_mgmt_top_metric metric,
+    int entry_count,
+    struct PVFS_mgmt_top_entry **entry_matrix,
+    uint32_t *count_array,
+    char **client_names,
+    PVFS_hint hints);
+
+PVFS_error PVFS_imgmt_remove_tree_pass(
+    PVFS_object_ref ref,
+    const PVFS_credential *credential,
+    int batch_count,
+    struct PVFS_mgmt_remove_tree_progress *progress,
+    PVFS_mgmt_remove_tree_cb progress_cb,
+    void *progress_arg,
+    PVFS_dirent **dir_array,
+    int *dir_count,
+    PVFS_mgmt_op_id *op_id,
+    PVFS_hint hints,
+    void *user_ptr);
+
+PVFS_error PVFS_mgmt_remove_tree_pass(
+    PVFS_object_ref ref,
+    const PVFS_credential *credential,
+    int batch_count,
+    struct PVFS_mgmt_remove_tree_progress *progress,
+    PVFS_mgmt_remove_tree_cb progress_cb,
+    void *progress_arg,
+    PVFS_dirent **dir_array,
+    int *dir_count,
+    PVFS_hint hints);
+
+PVFS_error PVFS_mgmt_remove_tree(
+    PVFS_object_ref ref,
+    const PVFS_credential *credential,
+    int batch_count,
+    struct PVFS_mgmt_remove_tree_progress *progress,
+    PVFS_mgmt_remove_tree_cb progress_cb,
+    void *progress_arg,
+    PVFS_hint hints);
+
+PVFS_error PVFS_imgmt_scan_list(
+    PVFS_fs_id fs_id,
+    const PVFS_credential *credential,
+    const struct PVFS_mgmt_scan_filter *filter,
+    struct PVFS_mgmt_scan_rec **rec_matrix,
+    int *rec_count_array,
+    PVFS_ds_position *position_array,
+    PVFS_BMI_addr_t *addr_array,
+    int server_count,
+    PVFS_error_details *details,
+    PVFS_hint hints,
+    PVFS_mgmt_op_id *op_id,
+    void *user_ptr);
+
+PVFS_error PVFS_mgmt_scan_list(
+    PVFS_fs_id fs_id,
+    const PVFS_credential *credential,
+    const struct PVFS_mgmt_scan_filter *filter,
+    struct PVFS_mgmt_scan_rec **rec_matrix,
+    int *rec_count_array,
+    PVFS_ds_position *position_array,
+    PVFS_BMI_addr_t *addr_array,
+    int server_count,
+    PVFS_error_details *details,
+    PVFS_hint hints);
+
 #ifdef ENABLE_SECURITY_CERT
 PVFS_error PVFS_imgmt_get_user_cert(
     PVFS_fs_id fs_id,
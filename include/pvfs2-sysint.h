@@ -31,6 +31,7 @@ enum PVFS_sys_setinfo_opt
     PVFS_SYS_MSG_TIMEOUT_SECS,
     PVFS_SYS_MSG_RETRY_LIMIT,
     PVFS_SYS_MSG_RETRY_DELAY_MSECS,
+    PVFS_SYS_NCACHE_NEGATIVE_TIMEOUT_MSECS,
 };
 
 /** Holds a non-blocking system interface operation handle. */
@@ -8,14 +8,18 @@
 #include <errno.h>
 #include <string.h>
 #include <sys/stat.h>
+#include <sys/types.h>
 #include <fcntl.h>
 #include <sys/time.h>
 #include <time.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
 #include <getopt.h>
 
 #include "pvfs2.h"
 #include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
 
 #ifndef PVFS2_VERSION
 #define PVFS2_VERSION "Unknown"
@@ -23,14 +27,47 @@
 
 #define EVENT_DEPTH 2000
 
+enum output_format
+{
+    OUTPUT_TEXT,
+    OUTPUT_CHROME,
+    OUTPUT_CTF
+};
+
 struct options
 {
     char* mnt_point;
     int mnt_point_set;
+    enum output_format format;
+    char *output;
+    int depth;
+};
+
+/* an event with its names resolved against the table it arrived with */
+struct event
+{
+    int server;
+    const char *name;
+    const char *label;
+    struct PVFS_mgmt_event ev;
 };
 
+static struct event *events = NULL;
+static int event_count = 0;
+static int event_alloc = 0;
+
+/* distinct event names, in order of first appearance; ids for CTF */
+static const char **event_names = NULL;
+static int event_name_count = 0;
+
 static struct options* parse_args(int argc, char* argv[]);
 static void usage(int argc, char** argv);
+static int add_events(int server, struct PVFS_mgmt_event *ev, int count,
+                      char *names);
+static int write_text(FILE *out);
+static int write_chrome(FILE *out, PVFS_fs_id fs,
+                        PVFS_BMI_addr_t *addr_array, int server_count);
+static int write_ctf(const char *dir);
 
 int main(int argc, char **argv)
 {
@@ -42,7 +79,10 @@ int main(int argc, char **argv)
     PVFS_credential creds;
     int io_server_count;
     struct PVFS_mgmt_event** event_matrix;
+    char **names;
     PVFS_BMI_addr_t *addr_array;
+    int more;
+    FILE *out = stdout;
 
     /* look at command line arguments */
     user_opts = parse_args(argc, argv);
@@ -78,7 +118,6 @@ int main(int argc, char **argv)
 
     /* count how many I/O servers we have */
     ret = PVFS_mgmt_count_servers(cur_fs,
-                  &creds,
                   PVFS_MGMT_IO_SERVER,
                   &io_server_count);
     if (ret < 0)
@@ -90,7 +129,8 @@ int main(int argc, char **argv)
     /* allocate a 2 dimensional array for events */
     event_matrix = (struct PVFS_mgmt_event **)
     malloc(io_server_count * sizeof(struct PVFS_mgmt_event *));
-    if (event_matrix == NULL)
+    names = (char **)calloc(io_server_count, sizeof(char *));
+    if (event_matrix == NULL || names == NULL)
     {
         perror("malloc");
         return -1;
@@ -99,7 +139,7 @@ int main(int argc, char **argv)
     for (i=0; i < io_server_count; i++)
     {
         event_matrix[i] = (struct PVFS_mgmt_event *)
-        malloc(EVENT_DEPTH * sizeof(struct PVFS_mgmt_event));
+        malloc(user_opts->depth * sizeof(struct PVFS_mgmt_event));
         if (event_matrix[i] == NULL)
         {
             perror("malloc");
@@ -116,7 +156,6 @@ int main(int argc, char **argv)
         return -1;
     }
     ret = PVFS_mgmt_get_server_array(cur_fs,
-                     &creds,
                      PVFS_MGMT_IO_SERVER,
                      addr_array,
                      &io_server_count);
@@ -126,39 +165,73 @@ int main(int argc, char **argv)
         return -1;
     }
 
-    /* grap current events */
-    ret = PVFS_mgmt_event_mon_list(cur_fs,
-                   &creds,
-                   event_matrix,
-                   addr_array, 
-                   io_server_count,
-                   EVENT_DEPTH,
-                   NULL, /* detailed errors */
-                   NULL);
-    if (ret < 0)
+    /* servers hand back what they have buffered oldest first, so keep
+     * asking until none of them fills the array
+     */
+    do
     {
-        PVFS_perror("PVFS_mgmt_event_mon_list", EVENT_DEPTH);
-        return -1;
-    }
+        ret = PVFS_mgmt_event_mon_list(cur_fs,
+                       &creds,
+                       event_matrix,
+                       names,
+                       addr_array,
+                       io_server_count,
+                       user_opts->depth,
+                       NULL, /* detailed errors */
+                       NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_mgmt_event_mon_list", ret);
+            return -1;
+        }
 
-    printf("# (server number) (api) (operation) (value) (id) (flags) (sec) (usec)\n");
-    for (i=0; i < io_server_count; i++)
-    {
-        for (j=0; j < EVENT_DEPTH; j++)
+        more = 0;
+        for (i=0; i < io_server_count; i++)
         {
-            if ((event_matrix[i][j].flags & PVFS_EVENT_FLAG_INVALID) == 0)
+            for (j=0; j < user_opts->depth; j++)
+            {
+                if (event_matrix[i][j].flags & PVFS_EVENT_FLAG_INVALID)
+                {
+                    break;
+                }
+            }
+            if (add_events(i, event_matrix[i], j, names[i]) < 0)
+            {
+                perror("malloc");
+                return -1;
+            }
+            if (j == user_opts->depth)
             {
-                printf("%d %d %d %lld %lld %d %d %d\n", 
-                       i, 
-                       (int)event_matrix[i][j].api,
-                       (int)event_matrix[i][j].operation,
-                       (long long)event_matrix[i][j].value,
-                       (long long)event_matrix[i][j].id,
-                       (int)event_matrix[i][j].flags,
-                       (int)event_matrix[i][j].tv_sec,
-                       (int)event_matrix[i][j].tv_usec);
+                more = 1;
             }
         }
+    } while (more);
+
+    if (user_opts->output && user_opts->format != OUTPUT_CTF)
+    {
+        out = fopen(user_opts->output, "w");
+        if (!out)
+        {
+            perror(user_opts->output);
+            return -1;
+        }
+    }
+
+    switch (user_opts->format)
+    {
+        case OUTPUT_CHROME:
+            ret = write_chrome(out, cur_fs, addr_array, io_server_count);
+            break;
+        case OUTPUT_CTF:
+            ret = write_ctf(user_opts->output);
+            break;
+        default:
+            ret = write_text(out);
+            break;
+    }
+    if (out != stdout)
+    {
+        fclose(out);
     }
 
     PVFS_sys_finalize();
@@ -166,6 +239,339 @@ int main(int argc, char **argv)
     return ret;
 }
 
+/* name_lookup()
+ *
+ * returns line index of a newline separated table, NULL if absent
+ */
+static const char *name_lookup(char **table, int count, int index)
+{
+    if (index < 0 || index >= count)
+    {
+        return NULL;
+    }
+    return table[index];
+}
+
+/* add_events()
+ *
+ * appends one server's batch of events, resolving names against the
+ * table returned with that batch; the table is kept for the names'
+ * storage
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int add_events(int server, struct PVFS_mgmt_event *ev, int count,
+                      char *names)
+{
+    char **table = NULL;
+    int table_count = 0;
+    char *c;
+    int i, j;
+
+    for (c = names; c && *c; c++)
+    {
+        if (*c == '\n')
+        {
+            table_count++;
+        }
+    }
+    if (table_count)
+    {
+        table = (char **)malloc(table_count * sizeof(char *));
+        if (!table)
+        {
+            return -1;
+        }
+        for (i = 0, c = names; i < table_count; i++)
+        {
+            table[i] = c;
+            c = strchr(c, '\n');
+            *c++ = '\0';
+        }
+    }
+
+    if (event_count + count > event_alloc)
+    {
+        event_alloc = (event_count + count) * 2;
+        events = (struct event *)realloc(events,
+                                         event_alloc * sizeof(*events));
+        if (!events)
+        {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        struct event *e = &events[event_count++];
+
+        e->server = server;
+        e->ev = ev[i];
+        e->name = name_lookup(table, table_count, ev[i].event);
+        if (!e->name)
+        {
+            e->name = "unknown";
+        }
+        e->label = name_lookup(table, table_count, ev[i].label);
+
+        for (j = 0; j < event_name_count; j++)
+        {
+            if (!strcmp(event_names[j], e->name))
+            {
+                break;
+            }
+        }
+        if (j == event_name_count)
+        {
+            event_names = (const char **)realloc(
+                event_names, (event_name_count + 1) * sizeof(char *));
+            if (!event_names)
+            {
+                return -1;
+            }
+            event_names[event_name_count++] = e->name;
+        }
+    }
+
+    /* the strings stay referenced by the events */
+    free(table);
+    return 0;
+}
+
+static int compare_timestamp(const void *a, const void *b)
+{
+    const struct event *ea = a, *eb = b;
+
+    if (ea->ev.timestamp != eb->ev.timestamp)
+    {
+        return (ea->ev.timestamp < eb->ev.timestamp) ? -1 : 1;
+    }
+    return 0;
+}
+
+static const char *flag_string(int flags)
+{
+    if (flags & PVFS_EVENT_FLAG_START)
+    {
+        return "start";
+    }
+    if (flags & PVFS_EVENT_FLAG_END)
+    {
+        return "end";
+    }
+    return "log";
+}
+
+static int write_text(FILE *out)
+{
+    int i;
+
+    fprintf(out, "# (server number) (thread) (timestamp ns) (kind) (id) "
+            "(value) (event) (label)\n");
+    for (i = 0; i < event_count; i++)
+    {
+        fprintf(out, "%d %d %lld %s %llu %lld %s %s\n",
+                events[i].server,
+                (int)events[i].ev.thread,
+                (long long)events[i].ev.timestamp,
+                flag_string(events[i].ev.flags),
+                llu(events[i].ev.id),
+                (long long)events[i].ev.value,
+                events[i].name,
+                events[i].label ? events[i].label : "-");
+    }
+    return 0;
+}
+
+/* write_chrome()
+ *
+ * writes the Trace Event Format understood by chrome://tracing and
+ * Perfetto: starts and ends become async begin/end pairs matched by id,
+ * one process per server
+ */
+static int write_chrome(FILE *out, PVFS_fs_id fs,
+                        PVFS_BMI_addr_t *addr_array, int server_count)
+{
+    const char *addr;
+    int server_type;
+    int i;
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    for (i = 0; i < server_count; i++)
+    {
+        addr = PVFS_mgmt_map_addr(fs, addr_array[i], &server_type);
+        fprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,"
+                "\"args\":{\"name\":\"%s\"}},\n", i, addr ? addr : "unknown");
+    }
+    for (i = 0; i < event_count; i++)
+    {
+        struct event *e = &events[i];
+        const char *ph = "i";
+
+        if (e->ev.flags & PVFS_EVENT_FLAG_START)
+        {
+            ph = "b";
+        }
+        else if (e->ev.flags & PVFS_EVENT_FLAG_END)
+        {
+            ph = "e";
+        }
+
+        fprintf(out, "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\","
+                "\"pid\":%d,\"tid\":%d,\"ts\":%lld.%03d",
+                e->name, e->name, ph, e->server, (int)e->ev.thread,
+                (long long)(e->ev.timestamp / 1000),
+                (int)(e->ev.timestamp % 1000));
+        if (*ph == 'i')
+        {
+            fprintf(out, ",\"s\":\"t\"");
+        }
+        else
+        {
+            fprintf(out, ",\"id\":\"0x%llx\"", llu(e->ev.id));
+        }
+        fprintf(out, ",\"args\":{\"value\":%lld",
+                (long long)e->ev.value);
+        if (e->label)
+        {
+            fprintf(out, ",\"label\":\"%s\"", e->label);
+        }
+        fprintf(out, "}}%s\n", (i + 1 < event_count) ? "," : "");
+    }
+    fprintf(out, "]}\n");
+    return 0;
+}
+
+/* write_ctf()
+ *
+ * writes a Common Trace Format 1.8 trace to a directory: TSDL metadata
+ * describing one event class per event name, and a single stream of
+ * records in timestamp order, readable with babeltrace or Trace Compass
+ */
+static int write_ctf(const char *dir)
+{
+    char path[PATH_MAX];
+    FILE *meta, *stream;
+    uint32_t u32;
+    uint64_t u64;
+    int i, j;
+    union
+    {
+        uint32_t i;
+        char c[4];
+    } endian = { 1 };
+
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST)
+    {
+        perror(dir);
+        return -1;
+    }
+
+    snprintf(path, sizeof(path), "%s/metadata", dir);
+    meta = fopen(path, "w");
+    if (!meta)
+    {
+        perror(path);
+        return -1;
+    }
+    fprintf(meta,
+            "/* CTF 1.8 */\n\n"
+            "typealias integer { size = 32; align = 8; signed = false; }"
+            " := uint32_t;\n"
+            "typealias integer { size = 64; align = 8; signed = false; }"
+            " := uint64_t;\n"
+            "typealias integer { size = 64; align = 8; signed = true; }"
+            " := int64_t;\n\n"
+            "trace {\n"
+            "\tmajor = 1;\n"
+            "\tminor = 8;\n"
+            "\tbyte_order = %s;\n"
+            "\tpacket.header := struct {\n"
+            "\t\tuint32_t magic;\n"
+            "\t\tuint32_t stream_id;\n"
+            "\t};\n"
+            "};\n\n"
+            "clock {\n"
+            "\tname = realtime;\n"
+            "\tdescription = \"nanoseconds since the epoch\";\n"
+            "\tfreq = 1000000000;\n"
+            "};\n\n"
+            "typealias integer { size = 64; align = 8; signed = false;"
+            " map = clock.realtime.value; } := realtime_t;\n\n"
+            "stream {\n"
+            "\tid = 0;\n"
+            "\tevent.header := struct {\n"
+            "\t\tuint32_t id;\n"
+            "\t\trealtime_t timestamp;\n"
+            "\t};\n"
+            "};\n",
+            endian.c[0] ? "le" : "be");
+    for (i = 0; i < event_name_count; i++)
+    {
+        fprintf(meta,
+                "\nevent {\n"
+                "\tname = \"%s\";\n"
+                "\tid = %d;\n"
+                "\tstream_id = 0;\n"
+                "\tfields := struct {\n"
+                "\t\tuint32_t server;\n"
+                "\t\tuint32_t thread;\n"
+                "\t\tuint32_t kind;\n"
+                "\t\tuint64_t id;\n"
+                "\t\tint64_t value;\n"
+                "\t\tstring label;\n"
+                "\t};\n"
+                "};\n",
+                event_names[i], i);
+    }
+    fclose(meta);
+
+    snprintf(path, sizeof(path), "%s/stream", dir);
+    stream = fopen(path, "w");
+    if (!stream)
+    {
+        perror(path);
+        return -1;
+    }
+
+    qsort(events, event_count, sizeof(*events), compare_timestamp);
+
+    u32 = 0xC1FC1FC1;
+    fwrite(&u32, sizeof(u32), 1, stream);
+    u32 = 0;
+    fwrite(&u32, sizeof(u32), 1, stream);
+    for (i = 0; i < event_count; i++)
+    {
+        struct event *e = &events[i];
+
+        for (j = 0; j < event_name_count; j++)
+        {
+            if (!strcmp(event_names[j], e->name))
+            {
+                break;
+            }
+        }
+        u32 = j;
+        fwrite(&u32, sizeof(u32), 1, stream);
+        u64 = e->ev.timestamp;
+        fwrite(&u64, sizeof(u64), 1, stream);
+        u32 = e->server;
+        fwrite(&u32, sizeof(u32), 1, stream);
+        u32 = e->ev.thread;
+        fwrite(&u32, sizeof(u32), 1, stream);
+        u32 = e->ev.flags;
+        fwrite(&u32, sizeof(u32), 1, stream);
+        u64 = e->ev.id;
+        fwrite(&u64, sizeof(u64), 1, stream);
+        u64 = e->ev.value;
+        fwrite(&u64, sizeof(u64), 1, stream);
+        fputs(e->label ? e->label : "", stream);
+        fputc('\0', stream);
+    }
+    fclose(stream);
+    return 0;
+}
+
 
 /* parse_args()
  *
@@ -175,7 +581,7 @@ int main(int argc, char **argv)
  */
 static struct options* parse_args(int argc, char* argv[])
 {
-    char flags[] = "vm:";
+    char flags[] = "vm:f:o:n:";
     int one_opt = 0;
     int len = 0;
 
@@ -189,6 +595,7 @@ static struct options* parse_args(int argc, char* argv[])
         return NULL;
     }
     memset(tmp_opts, 0, sizeof(struct options));
+    tmp_opts->depth = EVENT_DEPTH;
 
     /* look at command line arguments */
     while((one_opt = getopt(argc, argv, flags)) != EOF)
@@ -220,13 +627,44 @@ static struct options* parse_args(int argc, char* argv[])
                 strcat(tmp_opts->mnt_point, "/");
                 tmp_opts->mnt_point_set = 1;
                 break;
+            case('f'):
+                if (!strcmp(optarg, "text"))
+                {
+                    tmp_opts->format = OUTPUT_TEXT;
+                }
+                else if (!strcmp(optarg, "chrome"))
+                {
+                    tmp_opts->format = OUTPUT_CHROME;
+                }
+                else if (!strcmp(optarg, "ctf"))
+                {
+                    tmp_opts->format = OUTPUT_CTF;
+                }
+                else
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('o'):
+                tmp_opts->output = optarg;
+                break;
+            case('n'):
+                tmp_opts->depth = atoi(optarg);
+                if (tmp_opts->depth < 1)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
             case('?'):
                 usage(argc, argv);
                 exit(EXIT_FAILURE);
         }
     }
 
-    if (!tmp_opts->mnt_point_set)
+    if (!tmp_opts->mnt_point_set ||
+        (tmp_opts->format == OUTPUT_CTF && !tmp_opts->output))
     {
         free(tmp_opts);
         return NULL;
@@ -239,8 +677,11 @@ static struct options* parse_args(int argc, char* argv[])
 static void usage(int argc, char** argv)
 {
     fprintf(stderr, "\n");
-    fprintf(stderr, "Usage  : %s [-m fs_mount_point]\n", argv[0]);
-    fprintf(stderr, "Example: %s -m /mnt/pvfs2\n", argv[0]);
+    fprintf(stderr, "Usage  : %s [-m fs_mount_point] [-f text|chrome|ctf] "
+            "[-o output] [-n depth]\n", argv[0]);
+    fprintf(stderr, "Example: %s -m /mnt/pvfs2 -f chrome -o trace.json\n",
+            argv[0]);
+    fprintf(stderr, "  ctf output is a directory and requires -o\n");
     return;
 }
 
@@ -252,4 +693,3 @@ static void usage(int argc, char** argv)
  *
  * vim: ts=8 sts=4 sw=4 expandtab
  */
-
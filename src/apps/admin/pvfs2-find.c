@@ -0,0 +1,718 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* pvfs2-find: lists the objects of a file system that match a filter on
+ * type, owner, size and timestamps.  The servers read their own objects
+ * and apply the filter, so the namespace is only walked, with readdir
+ * alone, when paths are asked for.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
+
+#ifndef PVFS2_VERSION
+#define PVFS2_VERSION "Unknown"
+#endif
+
+#define FIND_DEFAULT_BATCH 1024
+#define FIND_MAX_BATCH 1024     /* PVFS_REQ_LIMIT_MGMT_SCAN_COUNT */
+#define FIND_READDIR_COUNT 512
+#define FIND_DAY (24 * 60 * 60)
+
+struct options
+{
+    char* mnt_point;
+    int mnt_point_set;
+    struct PVFS_mgmt_scan_filter filter;
+    int size_set;            /* size test also applied to files */
+    int paths;
+    int batch;
+};
+
+/* sorted handles, searched while walking the namespace */
+struct handle_set
+{
+    PVFS_handle *handles;
+    int count;
+    int size;
+};
+
+typedef void (*scan_fn)(const struct PVFS_mgmt_scan_rec *rec, void *arg);
+
+static struct options* parse_args(int argc, char* argv[]);
+static void usage(int argc, char** argv);
+static int scan(PVFS_fs_id fs_id, PVFS_credential *creds,
+                const struct PVFS_mgmt_scan_filter *filter,
+                PVFS_BMI_addr_t *addr_array, int server_count, int batch,
+                scan_fn fn, void *arg);
+static int walk(PVFS_fs_id fs_id, PVFS_handle handle, char *path,
+                PVFS_credential *creds, struct handle_set *matches,
+                struct handle_set *dirs);
+
+static struct options *user_opts;
+static PVFS_fs_id cur_fs;
+static PVFS_credential creds;
+
+static const char *type_name(PVFS_ds_type type)
+{
+    switch (type)
+    {
+        case PVFS_TYPE_METAFILE:
+            return "file";
+        case PVFS_TYPE_DATAFILE:
+            return "datafile";
+        case PVFS_TYPE_DIRECTORY:
+            return "dir";
+        case PVFS_TYPE_SYMLINK:
+            return "symlink";
+        case PVFS_TYPE_DIRDATA:
+            return "dirdata";
+        default:
+            return "unknown";
+    }
+}
+
+/* check_size()
+ *
+ * the servers cannot test the size of a file, so fetch it here; only
+ * files that passed every other test get this far
+ */
+static int check_size(const struct PVFS_mgmt_scan_rec *rec, PVFS_size *size)
+{
+    PVFS_object_ref ref;
+    PVFS_sysresp_getattr resp;
+    int ret;
+
+    *size = rec->size;
+    if (rec->type != PVFS_TYPE_METAFILE)
+    {
+        return 1;
+    }
+    if (!user_opts->size_set)
+    {
+        return 1;
+    }
+
+    ref.fs_id = cur_fs;
+    ref.handle = rec->handle;
+    memset(&resp, 0, sizeof(resp));
+    ret = PVFS_sys_getattr(ref, PVFS_ATTR_SYS_SIZE, &creds, &resp, NULL);
+    if (ret < 0)
+    {
+        /* removed since the scan read it */
+        return 0;
+    }
+    *size = resp.attr.size;
+    PVFS_util_release_sys_attr(&resp.attr);
+
+    return *size >= user_opts->filter.min_size &&
+           *size <= user_opts->filter.max_size;
+}
+
+static void print_rec(const struct PVFS_mgmt_scan_rec *rec, void *arg)
+{
+    PVFS_size size;
+    char mtime[32] = "-";
+    struct tm *tm;
+    time_t t;
+
+    if (!check_size(rec, &size))
+    {
+        return;
+    }
+
+    t = rec->mtime;
+    tm = localtime(&t);
+    if (tm)
+    {
+        strftime(mtime, sizeof(mtime), "%Y-%m-%d %H:%M", tm);
+    }
+    printf("%llu %-8s %o %u %u %lld %s\n",
+           llu(rec->handle), type_name(rec->type), rec->mode,
+           rec->uid, rec->gid, lld(size), mtime);
+}
+
+static void add_handle(const struct PVFS_mgmt_scan_rec *rec, void *arg)
+{
+    struct handle_set *set = arg;
+    PVFS_handle *tmp;
+    PVFS_size size;
+
+    if (set->count < 0)
+    {
+        return;
+    }
+    if (!check_size(rec, &size))
+    {
+        return;
+    }
+    if (set->count == set->size)
+    {
+        set->size = set->size ? set->size * 2 : FIND_DEFAULT_BATCH;
+        tmp = realloc(set->handles, set->size * sizeof(PVFS_handle));
+        if (!tmp)
+        {
+            /* reported by the caller */
+            set->count = -1;
+            return;
+        }
+        set->handles = tmp;
+    }
+    set->handles[set->count++] = rec->handle;
+}
+
+static int handle_cmp(const void *a, const void *b)
+{
+    PVFS_handle x = *(const PVFS_handle *)a;
+    PVFS_handle y = *(const PVFS_handle *)b;
+
+    return (x > y) - (x < y);
+}
+
+static int handle_set_find(struct handle_set *set, PVFS_handle handle)
+{
+    return bsearch(&handle, set->handles, set->count, sizeof(PVFS_handle),
+                   handle_cmp) != NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    char path[PVFS_PATH_MAX];
+    int server_count;
+    PVFS_BMI_addr_t *addr_array;
+    PVFS_sysresp_lookup lookup_resp;
+    struct PVFS_mgmt_scan_filter dir_filter;
+    struct handle_set matches, dirs;
+
+    /* look at command line arguments */
+    user_opts = parse_args(argc, argv);
+    if (!user_opts)
+    {
+        fprintf(stderr, "Error: failed to parse command line arguments.\n");
+        usage(argc, argv);
+        return -1;
+    }
+
+    ret = PVFS_util_init_defaults();
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return(-1);
+    }
+
+    /* translate local path into pvfs2 relative path */
+    ret = PVFS_util_resolve(user_opts->mnt_point,
+        &cur_fs, pvfs_path, PVFS_NAME_MAX);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return -1;
+    }
+
+    ret = PVFS_util_gen_credential_defaults(&creds);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_gen_credential_defaults", ret);
+        return -1;
+    }
+
+    /* every server scans its own objects */
+    ret = PVFS_mgmt_count_servers(cur_fs,
+                  PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                  &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return -1;
+    }
+    addr_array = (PVFS_BMI_addr_t *)
+        malloc(server_count * sizeof(PVFS_BMI_addr_t));
+    if (!addr_array)
+    {
+        perror("malloc");
+        return -1;
+    }
+    ret = PVFS_mgmt_get_server_array(cur_fs,
+                     PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                     addr_array,
+                     &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_server_array", ret);
+        return -1;
+    }
+
+    if (!user_opts->paths)
+    {
+        ret = scan(cur_fs, &creds, &user_opts->filter, addr_array,
+                   server_count, user_opts->batch, print_rec, NULL);
+    }
+    else
+    {
+        /* find the matches and every directory, then name the matches
+         * while reading only the directories */
+        memset(&matches, 0, sizeof(matches));
+        memset(&dirs, 0, sizeof(dirs));
+        memset(&dir_filter, 0, sizeof(dir_filter));
+        dir_filter.mask = PVFS_MGMT_SCAN_TYPE;
+        dir_filter.type_mask = PVFS_TYPE_DIRECTORY;
+
+        ret = scan(cur_fs, &creds, &user_opts->filter, addr_array,
+                   server_count, user_opts->batch, add_handle, &matches);
+        if (ret == 0)
+        {
+            ret = scan(cur_fs, &creds, &dir_filter, addr_array,
+                       server_count, user_opts->batch, add_handle, &dirs);
+        }
+        if (ret == 0 && (matches.count < 0 || dirs.count < 0))
+        {
+            fprintf(stderr, "Error: out of memory.\n");
+            ret = -PVFS_ENOMEM;
+        }
+        if (ret == 0)
+        {
+            qsort(matches.handles, matches.count, sizeof(PVFS_handle),
+                  handle_cmp);
+            qsort(dirs.handles, dirs.count, sizeof(PVFS_handle),
+                  handle_cmp);
+
+            ret = PVFS_sys_lookup(cur_fs, "/", &creds, &lookup_resp,
+                                  PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+        }
+        if (ret == 0)
+        {
+            snprintf(path, sizeof(path), "%s", user_opts->mnt_point);
+            if (handle_set_find(&matches, lookup_resp.ref.handle))
+            {
+                printf("%s\n", path);
+            }
+            ret = walk(cur_fs, lookup_resp.ref.handle, path, &creds,
+                       &matches, &dirs);
+        }
+        free(matches.handles);
+        free(dirs.handles);
+    }
+    if (ret < 0)
+    {
+        PVFS_perror("pvfs2-find", ret);
+    }
+
+    free(addr_array);
+    PVFS_sys_finalize();
+
+    return(ret < 0 ? -1 : 0);
+}
+
+/* scan()
+ *
+ * runs a scan to the end on every server, calling fn for each object
+ * that passed the filter
+ */
+static int scan(PVFS_fs_id fs_id, PVFS_credential *creds,
+                const struct PVFS_mgmt_scan_filter *filter,
+                PVFS_BMI_addr_t *addr_array, int server_count, int batch,
+                scan_fn fn, void *arg)
+{
+    struct PVFS_mgmt_scan_rec **rec_matrix;
+    int *count_array;
+    PVFS_ds_position *position_array;
+    int i, j, more;
+    int ret = 0;
+
+    rec_matrix = (struct PVFS_mgmt_scan_rec **)
+        calloc(server_count, sizeof(struct PVFS_mgmt_scan_rec *));
+    count_array = (int *)malloc(server_count * sizeof(int));
+    position_array = (PVFS_ds_position *)
+        malloc(server_count * sizeof(PVFS_ds_position));
+    if (!rec_matrix || !count_array || !position_array)
+    {
+        ret = -PVFS_ENOMEM;
+        goto out;
+    }
+    for (i = 0; i < server_count; i++)
+    {
+        rec_matrix[i] = (struct PVFS_mgmt_scan_rec *)
+            malloc(batch * sizeof(struct PVFS_mgmt_scan_rec));
+        if (!rec_matrix[i])
+        {
+            ret = -PVFS_ENOMEM;
+            goto out;
+        }
+        position_array[i] = PVFS_ITERATE_START;
+    }
+
+    do
+    {
+        for (i = 0; i < server_count; i++)
+        {
+            count_array[i] = batch;
+        }
+
+        PVFS_util_refresh_credential(creds);
+        ret = PVFS_mgmt_scan_list(fs_id, creds, filter, rec_matrix,
+                                  count_array, position_array, addr_array,
+                                  server_count, NULL, NULL);
+        if (ret < 0)
+        {
+            break;
+        }
+
+        more = 0;
+        for (i = 0; i < server_count; i++)
+        {
+            for (j = 0; j < count_array[i]; j++)
+            {
+                fn(&rec_matrix[i][j], arg);
+            }
+            if (position_array[i] != PVFS_ITERATE_END)
+            {
+                more = 1;
+            }
+        }
+    } while (more);
+
+out:
+    if (rec_matrix)
+    {
+        for (i = 0; i < server_count; i++)
+        {
+            free(rec_matrix[i]);
+        }
+    }
+    free(rec_matrix);
+    free(count_array);
+    free(position_array);
+    return ret;
+}
+
+/* walk()
+ *
+ * prints the matches below one directory, descending into the entries
+ * the directory scan found; path is extended in place
+ */
+static int walk(PVFS_fs_id fs_id, PVFS_handle handle, char *path,
+                PVFS_credential *creds, struct handle_set *matches,
+                struct handle_set *dirs)
+{
+    PVFS_object_ref ref;
+    PVFS_sysresp_readdir resp;
+    PVFS_ds_position token = PVFS_READDIR_START;
+    size_t len = strlen(path);
+    int i, ret;
+
+    ref.fs_id = fs_id;
+    ref.handle = handle;
+    do
+    {
+        PVFS_util_refresh_credential(creds);
+        memset(&resp, 0, sizeof(resp));
+        ret = PVFS_sys_readdir(ref, token, FIND_READDIR_COUNT, creds, &resp,
+                               NULL);
+        if (ret < 0)
+        {
+            /* removed since the scan, or not readable by us */
+            return 0;
+        }
+
+        for (i = 0; i < resp.pvfs_dirent_outcount; i++)
+        {
+            if (snprintf(path + len, PVFS_PATH_MAX - len, "%s%s",
+                         (len && path[len - 1] == '/') ? "" : "/",
+                         resp.dirent_array[i].d_name) >= PVFS_PATH_MAX - len)
+            {
+                continue;
+            }
+            if (handle_set_find(matches, resp.dirent_array[i].handle))
+            {
+                printf("%s\n", path);
+            }
+            if (handle_set_find(dirs, resp.dirent_array[i].handle))
+            {
+                walk(fs_id, resp.dirent_array[i].handle, path, creds,
+                     matches, dirs);
+            }
+        }
+        path[len] = '\0';
+
+        token = resp.token;
+        free(resp.dirent_array);
+    } while (resp.pvfs_dirent_outcount == FIND_READDIR_COUNT);
+
+    return 0;
+}
+
+/* parse_days()
+ *
+ * turns a find(1) style day count into bounds: +n older than n days,
+ * -n newer than n days, n between n and n + 1 days old
+ */
+static int parse_days(const char *arg, PVFS_time *min, PVFS_time *max)
+{
+    PVFS_time now = time(NULL);
+    char *end;
+    long days;
+
+    days = strtol(arg, &end, 10);
+    if (*end || end == arg)
+    {
+        return -1;
+    }
+    if (arg[0] == '+')
+    {
+        *min = 0;
+        *max = now - days * FIND_DAY - 1;
+    }
+    else if (arg[0] == '-')
+    {
+        *min = now + days * FIND_DAY + 1;
+        *max = INT64_MAX;
+    }
+    else
+    {
+        *min = now - (days + 1) * FIND_DAY + 1;
+        *max = now - days * FIND_DAY;
+    }
+    return 0;
+}
+
+/* parse_size()
+ *
+ * +n larger than n bytes, -n smaller, n exactly; k, M and G suffixes
+ */
+static int parse_size(const char *arg, PVFS_size *min, PVFS_size *max)
+{
+    char *end;
+    long long size;
+
+    size = strtoll(arg, &end, 10);
+    if (end == arg)
+    {
+        return -1;
+    }
+    switch (*end)
+    {
+        case 'G':
+            size *= 1024;
+            /* fall through */
+        case 'M':
+            size *= 1024;
+            /* fall through */
+        case 'k':
+            size *= 1024;
+            end++;
+            break;
+        default:
+            break;
+    }
+    if (*end)
+    {
+        return -1;
+    }
+    if (arg[0] == '+')
+    {
+        *min = size + 1;
+        *max = INT64_MAX;
+    }
+    else if (arg[0] == '-')
+    {
+        *min = 0;
+        *max = -size - 1;
+    }
+    else
+    {
+        *min = *max = size;
+    }
+    return 0;
+}
+
+static struct options* parse_args(int argc, char* argv[])
+{
+    char flags[] = "vm:t:u:g:s:a:M:c:pn:";
+    int one_opt = 0;
+    int len = 0;
+
+    struct options *tmp_opts = NULL;
+    struct PVFS_mgmt_scan_filter *filter;
+    int ret = -1;
+
+    /* create storage for the command line options */
+    tmp_opts = (struct options *) malloc(sizeof(struct options));
+    if (tmp_opts == NULL)
+    {
+        return NULL;
+    }
+    memset(tmp_opts, 0, sizeof(struct options));
+    tmp_opts->batch = FIND_DEFAULT_BATCH;
+    filter = &tmp_opts->filter;
+
+    /* look at command line arguments */
+    while((one_opt = getopt(argc, argv, flags)) != EOF)
+    {
+        switch(one_opt)
+        {
+            case('v'):
+                printf("%s\n", PVFS2_VERSION);
+                exit(0);
+            case('m'):
+                len = strlen(optarg)+1;
+                tmp_opts->mnt_point = (char *) malloc(len + 1);
+                if (tmp_opts->mnt_point == NULL)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                memset(tmp_opts->mnt_point, 0, len+1);
+                ret = sscanf(optarg, "%s", tmp_opts->mnt_point);
+                if(ret < 1)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                /* TODO: dirty hack... fix later.  The remove_dir_prefix()
+                 * function expects some trailing segments or at least
+                 * a slash off of the mount point
+                 */
+                strcat(tmp_opts->mnt_point, "/");
+                tmp_opts->mnt_point_set = 1;
+                break;
+            case('t'):
+                filter->mask |= PVFS_MGMT_SCAN_TYPE;
+                if (!strcmp(optarg, "f"))
+                {
+                    filter->type_mask |= PVFS_TYPE_METAFILE;
+                }
+                else if (!strcmp(optarg, "d"))
+                {
+                    filter->type_mask |= PVFS_TYPE_DIRECTORY;
+                }
+                else if (!strcmp(optarg, "l"))
+                {
+                    filter->type_mask |= PVFS_TYPE_SYMLINK;
+                }
+                else if (!strcmp(optarg, "datafile"))
+                {
+                    filter->type_mask |= PVFS_TYPE_DATAFILE;
+                }
+                else if (!strcmp(optarg, "dirdata"))
+                {
+                    filter->type_mask |= PVFS_TYPE_DIRDATA;
+                }
+                else
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('u'):
+                filter->mask |= PVFS_MGMT_SCAN_UID;
+                filter->uid = strtoul(optarg, NULL, 10);
+                break;
+            case('g'):
+                filter->mask |= PVFS_MGMT_SCAN_GID;
+                filter->gid = strtoul(optarg, NULL, 10);
+                break;
+            case('s'):
+                filter->mask |= PVFS_MGMT_SCAN_SIZE;
+                tmp_opts->size_set = 1;
+                if (parse_size(optarg, &filter->min_size,
+                               &filter->max_size) < 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('a'):
+                filter->mask |= PVFS_MGMT_SCAN_ATIME;
+                if (parse_days(optarg, &filter->min_atime,
+                               &filter->max_atime) < 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('M'):
+                filter->mask |= PVFS_MGMT_SCAN_MTIME;
+                if (parse_days(optarg, &filter->min_mtime,
+                               &filter->max_mtime) < 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('c'):
+                filter->mask |= PVFS_MGMT_SCAN_CTIME;
+                if (parse_days(optarg, &filter->min_ctime,
+                               &filter->max_ctime) < 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('p'):
+                tmp_opts->paths = 1;
+                break;
+            case('n'):
+                tmp_opts->batch = atoi(optarg);
+                if (tmp_opts->batch < 1 ||
+                    tmp_opts->batch > FIND_MAX_BATCH)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('?'):
+                usage(argc, argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!tmp_opts->mnt_point_set)
+    {
+        free(tmp_opts);
+        return NULL;
+    }
+
+    /* by default only the objects that have names */
+    if (!(filter->mask & PVFS_MGMT_SCAN_TYPE))
+    {
+        filter->mask |= PVFS_MGMT_SCAN_TYPE;
+        filter->type_mask = PVFS_TYPE_METAFILE | PVFS_TYPE_DIRECTORY |
+                            PVFS_TYPE_SYMLINK;
+    }
+
+    return(tmp_opts);
+}
+
+static void usage(int argc, char** argv)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage  : %s [-m fs_mount_point] [-t type] [-u uid] "
+            "[-g gid] [-s [+-]size] [-a [+-]days] [-M [+-]days] "
+            "[-c [+-]days] [-p] [-n count]\n", argv[0]);
+    fprintf(stderr, "Example: %s -m /mnt/pvfs2 -t f -a +90 -p\n", argv[0]);
+    fprintf(stderr, "  -t  f, d, l, datafile or dirdata; may be repeated "
+            "(default f, d and l)\n");
+    fprintf(stderr, "  -s  size in bytes, with a k, M or G suffix\n");
+    fprintf(stderr, "  -a  accessed, -M modified, -c changed: +n more than "
+            "n days ago, -n less\n");
+    fprintf(stderr, "  -p  print paths instead of handles and attributes\n");
+    fprintf(stderr, "  -n  objects each server examines per request, at "
+            "most %d (default %d)\n",
+            FIND_MAX_BATCH, FIND_DEFAULT_BATCH);
+    fprintf(stderr, "  the size of each matching file is read from its "
+            "datafiles, all other\n  tests run on the servers\n");
+    return;
+}
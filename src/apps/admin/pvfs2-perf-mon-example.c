@@ -27,7 +27,7 @@
 #define PVFS2_VERSION "Unknown"
 #endif
 
-#define MAX_KEY_CNT 23
+#define MAX_KEY_CNT 28
 /* macros for accessing data returned from server */
 #define VALID_FLAG(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt] != 0.0)
 #define ID(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + key_cnt])
@@ -53,6 +53,11 @@
 #define RMDIRS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 17])
 #define GETATTRS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 18])
 #define SETATTRS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 19])
+#define FAIR_WAITING(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 23])
+#define FAIR_CLASSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 24])
+#define FAIR_DEPTH(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 25])
+#define SM_ALLOCS(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 26])
+#define SM_MISSES(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 27])
 #define IO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 20])
 #define SMALLIO(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 21])
 #define READDIR(s,h) (perf_matrix[(s)][((h) * (key_cnt + 2)) + 22])
@@ -322,6 +327,11 @@ int main(int argc, char **argv)
             PRINT_COUNTER("\nrmdir:   ", RMDIRS(i, j));
             PRINT_COUNTER("\ngetattrs: ", GETATTRS(i, j));
             PRINT_COUNTER("\nsetattrs: ", SETATTRS(i, j));
+            PRINT_COUNTER("\nfair waiting: ", FAIR_WAITING(i, j));
+            PRINT_COUNTER("\nfair classes: ", FAIR_CLASSES(i, j));
+            PRINT_COUNTER("\nfair depth: ", FAIR_DEPTH(i, j));
+            PRINT_COUNTER("\nsm allocs: ", SM_ALLOCS(i, j));
+            PRINT_COUNTER("\nsm alloc misses: ", SM_MISSES(i, j));
 	    PRINT_COUNTER("\ntimestep: ", (unsigned)ID(i, j));
 	    printf("\n");
 	}
@@ -50,6 +50,11 @@
 #define OID_REQ_IO ".1.3.6.1.4.1.7778.20"
 #define OID_REQ_SMALL_IO ".1.3.6.1.4.1.7778.21"
 #define OID_REQ_READDIR ".1.3.6.1.4.1.7778.22"
+#define OID_FAIR_WAITING ".1.3.6.1.4.1.7778.30"
+#define OID_FAIR_CLASSES ".1.3.6.1.4.1.7778.31"
+#define OID_FAIR_DEPTH ".1.3.6.1.4.1.7778.32"
+#define OID_SM_ALLOCS ".1.3.6.1.4.1.7778.33"
+#define OID_SM_ALLOC_MISSES ".1.3.6.1.4.1.7778.34"
 
 #define OID_TIMER_LOOKUP ".1.3.6.1.4.1.7778.40"
 #define OID_TIMER_CREAT ".1.3.6.1.4.1.7778.41"
@@ -103,6 +108,11 @@ static struct MGMT_perf_iod key_table[] =
    {OID_REQ_IO, CNT_TYPE, PINT_PERF_IO, "io requests called"},
    {OID_REQ_SMALL_IO, CNT_TYPE, PINT_PERF_SMALL_IO, "small io requests called"},
    {OID_REQ_READDIR, CNT_TYPE, PINT_PERF_READDIR, "readdir requests called"},
+   {OID_FAIR_WAITING, INT_TYPE, PINT_PERF_FAIR_WAITING, "Fair-Share Requests Waiting"},
+   {OID_FAIR_CLASSES, INT_TYPE, PINT_PERF_FAIR_CLASSES, "Fair-Share Classes Waiting"},
+   {OID_FAIR_DEPTH, INT_TYPE, PINT_PERF_FAIR_DEPTH, "Fair-Share Deepest Queue"},
+   {OID_SM_ALLOCS, CNT_TYPE, PINT_PERF_SM_ALLOCS, "State Machine Allocations"},
+   {OID_SM_ALLOC_MISSES, CNT_TYPE, PINT_PERF_SM_ALLOC_MISSES, "State Machine Allocation Misses"},
    {NULL, NULL, -1, NULL}   /* this halts the key count */
 };
 
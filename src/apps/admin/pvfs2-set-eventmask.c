@@ -42,6 +42,7 @@ int main(int argc, char **argv)
     char pvfs_path[PVFS_NAME_MAX] = {0};
     PVFS_credential creds;
     struct PVFS_mgmt_setparam_value param_value;
+    enum PVFS_server_param param;
 
     user_opts = parse_args(argc, argv);
     if(!user_opts)
@@ -76,19 +77,22 @@ int main(int argc, char **argv)
         return(-1);
     }
 
+    /* "none" clears the mask; anything else is added to it */
     param_value.type = PVFS_MGMT_PARAM_TYPE_STRING;
-    if(!user_opts->event_string)
+    if(!user_opts->event_string || !strcmp(user_opts->event_string, "none"))
     {
+        param = PVFS_SERV_PARAM_EVENT_DISABLE;
         param_value.u.string_value = "none";
     }
     else
     {
+        param = PVFS_SERV_PARAM_EVENT_ENABLE;
         param_value.u.string_value = user_opts->event_string;
     }
 
     ret = PVFS_mgmt_setparam_all(
         cur_fs, &creds,
-        PVFS_SERV_PARAM_EVENT_ENABLE,
+        param,
         &param_value, NULL, NULL);
     if(ret < 0)
     {
@@ -154,7 +158,7 @@ static struct options* parse_args(int argc, char* argv[])
 		break;
             case('e'):
                 tmp_opts->event_string = strdup(optarg);
-		if(ret < 1){
+		if(!tmp_opts->event_string){
 		    if(tmp_opts->mnt_point) free(tmp_opts->mnt_point);
 		    free(tmp_opts);
 		    return(NULL);
@@ -185,6 +189,8 @@ static void usage(int argc, char** argv)
             "[-e events]\n", argv[0]);
     fprintf(stderr, "Example: %s -m /mnt/pvfs2 -e bmi-send,dbpf-write\n",
             argv[0]);
+    fprintf(stderr, "         (use -e all to enable every event, "
+            "-e none to disable them)\n");
     return;
 }
 
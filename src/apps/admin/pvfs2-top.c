@@ -0,0 +1,409 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* pvfs2-top: shows the clients, users or objects generating the most
+ * requests or moving the most data on each server
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-internal.h"
+#include "bmi.h"
+
+#ifndef PVFS2_VERSION
+#define PVFS2_VERSION "Unknown"
+#endif
+
+#define TOP_DEFAULT_COUNT 10
+#define TOP_MAX_COUNT 64
+
+struct options
+{
+    char* mnt_point;
+    int mnt_point_set;
+    enum PVFS_mgmt_top_kind kind;
+    enum PVFS_mgmt_top_metric metric;
+    int count;
+    int delay;
+    int iterations;
+};
+
+static struct options* parse_args(int argc, char* argv[]);
+static void usage(int argc, char** argv);
+static void print_table(const char *server,
+                        enum PVFS_mgmt_top_kind kind,
+                        struct PVFS_mgmt_top_entry *entries,
+                        int count,
+                        char *names);
+
+static const char *kind_names[PVFS_MGMT_TOP_KINDS] =
+{
+    "client", "uid", "handle"
+};
+
+static const char *metric_names[PVFS_MGMT_TOP_METRICS] =
+{
+    "ops", "bytes"
+};
+
+int main(int argc, char **argv)
+{
+    int ret = -1;
+    PVFS_fs_id cur_fs;
+    struct options* user_opts = NULL;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    int i, iter;
+    PVFS_credential creds;
+    int server_count;
+    struct PVFS_mgmt_top_entry **entry_matrix;
+    uint32_t *count_array;
+    char **names;
+    PVFS_BMI_addr_t *addr_array;
+    time_t now;
+
+    /* look at command line arguments */
+    user_opts = parse_args(argc, argv);
+    if (!user_opts)
+    {
+        fprintf(stderr, "Error: failed to parse command line arguments.\n");
+        usage(argc, argv);
+        return -1;
+    }
+
+    ret = PVFS_util_init_defaults();
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return(-1);
+    }
+
+    /* translate local path into pvfs2 relative path */
+    ret = PVFS_util_resolve(user_opts->mnt_point,
+        &cur_fs, pvfs_path, PVFS_NAME_MAX);
+    if(ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return -1;
+    }
+
+    ret = PVFS_util_gen_credential_defaults(&creds);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_gen_credential_defaults", ret);
+        return -1;
+    }
+
+    /* every server keeps its own tables */
+    ret = PVFS_mgmt_count_servers(cur_fs,
+                  PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                  &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return -1;
+    }
+
+    entry_matrix = (struct PVFS_mgmt_top_entry **)
+        malloc(server_count * sizeof(struct PVFS_mgmt_top_entry *));
+    names = (char **)calloc(server_count, sizeof(char *));
+    count_array = (uint32_t *)malloc(server_count * sizeof(uint32_t));
+    addr_array = (PVFS_BMI_addr_t *)
+        malloc(server_count * sizeof(PVFS_BMI_addr_t));
+    if (!entry_matrix || !names || !count_array || !addr_array)
+    {
+        perror("malloc");
+        return -1;
+    }
+    for (i = 0; i < server_count; i++)
+    {
+        entry_matrix[i] = (struct PVFS_mgmt_top_entry *)
+            malloc(user_opts->count * sizeof(struct PVFS_mgmt_top_entry));
+        if (!entry_matrix[i])
+        {
+            perror("malloc");
+            return -1;
+        }
+    }
+
+    ret = PVFS_mgmt_get_server_array(cur_fs,
+                     PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                     addr_array,
+                     &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_server_array", ret);
+        return -1;
+    }
+
+    for (iter = 0; !user_opts->iterations || iter < user_opts->iterations;
+         iter++)
+    {
+        if (iter)
+        {
+            sleep(user_opts->delay);
+        }
+
+        ret = PVFS_mgmt_get_top_list(cur_fs,
+                                     &creds,
+                                     server_count,
+                                     addr_array,
+                                     user_opts->kind,
+                                     user_opts->metric,
+                                     user_opts->count,
+                                     entry_matrix,
+                                     count_array,
+                                     names,
+                                     NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_mgmt_get_top_list", ret);
+            return -1;
+        }
+
+        now = time(NULL);
+        printf("\npvfs2-top: top %d %s by %s, %s",
+               user_opts->count,
+               kind_names[user_opts->kind],
+               metric_names[user_opts->metric],
+               ctime(&now));
+
+        for (i = 0; i < server_count; i++)
+        {
+            print_table(BMI_addr_rev_lookup(addr_array[i]),
+                        user_opts->kind,
+                        entry_matrix[i],
+                        count_array[i],
+                        names[i]);
+            free(names[i]);
+            names[i] = NULL;
+        }
+        fflush(stdout);
+    }
+
+    for (i = 0; i < server_count; i++)
+    {
+        free(entry_matrix[i]);
+    }
+    free(entry_matrix);
+    free(names);
+    free(count_array);
+    free(addr_array);
+
+    PVFS_sys_finalize();
+
+    return(ret);
+}
+
+/* print_table()
+ *
+ * prints one server's table; client keys index the newline separated
+ * names that came back with it
+ */
+static void print_table(const char *server,
+                        enum PVFS_mgmt_top_kind kind,
+                        struct PVFS_mgmt_top_entry *entries,
+                        int count,
+                        char *names)
+{
+    const char *client[TOP_MAX_COUNT];
+    char *ptr, *next;
+    int i, n = 0;
+
+    if (kind == PVFS_MGMT_TOP_CLIENT && names)
+    {
+        for (ptr = names; *ptr && n < TOP_MAX_COUNT; ptr = next + 1)
+        {
+            next = strchr(ptr, '\n');
+            if (!next)
+            {
+                break;
+            }
+            *next = '\0';
+            client[n++] = ptr;
+        }
+    }
+
+    printf("\nServer: %s\n", server);
+    printf("  %-40s %12s %16s %12s\n",
+           kind_names[kind], "ops", "bytes", "+/-");
+    for (i = 0; i < count; i++)
+    {
+        if (kind == PVFS_MGMT_TOP_CLIENT)
+        {
+            printf("  %-40s", entries[i].key < n ?
+                   client[entries[i].key] : "unknown");
+        }
+        else
+        {
+            printf("  %-40llu", llu(entries[i].key));
+        }
+        printf(" %12llu %16llu %12llu\n",
+               llu(entries[i].ops),
+               llu(entries[i].bytes),
+               llu(entries[i].error));
+    }
+}
+
+static struct options* parse_args(int argc, char* argv[])
+{
+    char flags[] = "vm:k:r:n:d:i:";
+    int one_opt = 0;
+    int len = 0;
+
+    struct options *tmp_opts = NULL;
+    int ret = -1;
+
+    /* create storage for the command line options */
+    tmp_opts = (struct options *) malloc(sizeof(struct options));
+    if (tmp_opts == NULL)
+    {
+        return NULL;
+    }
+    memset(tmp_opts, 0, sizeof(struct options));
+    tmp_opts->kind = PVFS_MGMT_TOP_CLIENT;
+    tmp_opts->metric = PVFS_MGMT_TOP_OPS;
+    tmp_opts->count = TOP_DEFAULT_COUNT;
+    tmp_opts->delay = 1;
+    tmp_opts->iterations = 1;
+
+    /* look at command line arguments */
+    while((one_opt = getopt(argc, argv, flags)) != EOF)
+    {
+        switch(one_opt)
+        {
+            case('v'):
+                printf("%s\n", PVFS2_VERSION);
+                exit(0);
+            case('m'):
+                len = strlen(optarg)+1;
+                tmp_opts->mnt_point = (char *) malloc(len + 1);
+                if (tmp_opts->mnt_point == NULL)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                memset(tmp_opts->mnt_point, 0, len+1);
+                ret = sscanf(optarg, "%s", tmp_opts->mnt_point);
+                if(ret < 1)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                /* TODO: dirty hack... fix later.  The remove_dir_prefix()
+                 * function expects some trailing segments or at least
+                 * a slash off of the mount point
+                 */
+                strcat(tmp_opts->mnt_point, "/");
+                tmp_opts->mnt_point_set = 1;
+                break;
+            case('k'):
+                if (!strcmp(optarg, "client"))
+                {
+                    tmp_opts->kind = PVFS_MGMT_TOP_CLIENT;
+                }
+                else if (!strcmp(optarg, "uid"))
+                {
+                    tmp_opts->kind = PVFS_MGMT_TOP_UID;
+                }
+                else if (!strcmp(optarg, "handle"))
+                {
+                    tmp_opts->kind = PVFS_MGMT_TOP_HANDLE;
+                }
+                else
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('r'):
+                if (!strcmp(optarg, "ops"))
+                {
+                    tmp_opts->metric = PVFS_MGMT_TOP_OPS;
+                }
+                else if (!strcmp(optarg, "bytes"))
+                {
+                    tmp_opts->metric = PVFS_MGMT_TOP_BYTES;
+                }
+                else
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('n'):
+                tmp_opts->count = atoi(optarg);
+                if (tmp_opts->count < 1 || tmp_opts->count > TOP_MAX_COUNT)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('d'):
+                tmp_opts->delay = atoi(optarg);
+                if (tmp_opts->delay < 1)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('i'):
+                tmp_opts->iterations = atoi(optarg);
+                if (tmp_opts->iterations < 0)
+                {
+                    free(tmp_opts);
+                    return NULL;
+                }
+                break;
+            case('?'):
+                usage(argc, argv);
+                exit(EXIT_FAILURE);
+        }
+    }
+
+    if (!tmp_opts->mnt_point_set)
+    {
+        free(tmp_opts);
+        return NULL;
+    }
+
+    return(tmp_opts);
+}
+
+static void usage(int argc, char** argv)
+{
+    fprintf(stderr, "\n");
+    fprintf(stderr, "Usage  : %s [-m fs_mount_point] [-k client|uid|handle] "
+            "[-r ops|bytes] [-n count] [-d delay] [-i iterations]\n",
+            argv[0]);
+    fprintf(stderr, "Example: %s -m /mnt/pvfs2 -k handle -r bytes -d 5 -i 0\n",
+            argv[0]);
+    fprintf(stderr, "  -k  what to rank (default client)\n");
+    fprintf(stderr, "  -r  rank by requests or bytes moved (default ops)\n");
+    fprintf(stderr, "  -n  entries per server, at most %d (default %d)\n",
+            TOP_MAX_COUNT, TOP_DEFAULT_COUNT);
+    fprintf(stderr, "  -d  seconds between refreshes (default 1)\n");
+    fprintf(stderr, "  -i  number of refreshes, 0 runs until interrupted "
+            "(default 1)\n");
+    fprintf(stderr, "  counts halve every few seconds, so they reflect "
+            "recent load\n");
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
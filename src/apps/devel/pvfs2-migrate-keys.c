@@ -0,0 +1,390 @@
+/*
+ * Copyright 2016 Omnibond Systems, L.L.C.
+ *
+ * See COPYING in top-level directory.
+ */
+
+/** \file
+ * Utility for converting the dspace and keyval databases of a collection
+ * from the legacy key format to the format the database backend writes
+ * now.  The server must not be running.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <getopt.h>
+#include <errno.h>
+#include <unistd.h>
+
+#include "pvfs2-types.h"
+#include "trove-types.h"
+#include "pvfs2-storage.h"
+#include "pvfs2-internal.h"
+#include "trove-dbpf/dbpf.h"
+#include "server-config.h"
+
+#define DATASPACE_FILE          "dataspace_attributes.db"
+#define KEYVAL_FILE             "keyval.db"
+#define PACKED_FILE             "packed_bstreams.db"
+#define COLLECTION_ATTR_FILE    "collection_attributes.db"
+
+/* suffixes of the database being written and the one it replaces */
+#define MIGRATE_SUFFIX          ".migrate"
+#define LEGACY_SUFFIX           ".legacy"
+
+/* starting value buffer size; grown if a larger value is found */
+#define VAL_BUF_SIZE            65536
+
+typedef struct
+{
+    char dbpath[PATH_MAX];
+    char hexdir[PATH_MAX];
+    size_t db_max_size;
+    int verbose;
+} options_t;
+
+/* globals */
+static options_t opts;
+
+/* set so that the database backend sizes the new databases */
+extern filesystem_configuration_s *cfg_fs;
+
+int migrate_database(char *name, int compare, int required,
+    struct server_configuration_s *cfg);
+void print_help(char *progname);
+int process_args(int argc, char ** argv);
+
+int main( int argc, char **argv )
+{
+    struct server_configuration_s cfg;
+    filesystem_configuration_s fs_cfg;
+    dbpf_db *db_p = NULL;
+    struct dbpf_data key, val;
+    char path[PATH_MAX];
+    int32_t key_format = DBPF_DB_KEY_FORMAT_LEGACY;
+    int ret;
+
+    if( (ret = process_args( argc, argv)) != 0 )
+    {
+          return ret;
+    }
+
+    if (snprintf(path, PATH_MAX, "%s/%s/%s", opts.dbpath, opts.hexdir,
+                 COLLECTION_ATTR_FILE) >= PATH_MAX)
+    {
+        fprintf(stderr, "Path to %s is too long\n", COLLECTION_ATTR_FILE);
+        return ENAMETOOLONG;
+    }
+    ret = dbpf_db_open(path, 0, &db_p, 0, NULL);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(ret));
+        return ret;
+    }
+
+    key.data = TROVE_DBPF_KEY_FORMAT_KEY;
+    key.len = strlen(TROVE_DBPF_KEY_FORMAT_KEY);
+    val.data = &key_format;
+    val.len = sizeof(key_format);
+    ret = dbpf_db_get(db_p, &key, &val);
+    if (ret != 0 && ret != TROVE_ENOENT)
+    {
+        fprintf(stderr, "Unable to read key format: %s\n", strerror(ret));
+        dbpf_db_close(db_p);
+        return ret;
+    }
+    if (key_format == dbpf_db_key_format())
+    {
+        printf("Collection %s already uses key format %d\n", opts.hexdir,
+               key_format);
+        dbpf_db_close(db_p);
+        return 0;
+    }
+    if (key_format != DBPF_DB_KEY_FORMAT_LEGACY)
+    {
+        fprintf(stderr, "Collection %s has unknown key format %d\n",
+                opts.hexdir, key_format);
+        dbpf_db_close(db_p);
+        return EINVAL;
+    }
+
+    memset(&cfg, 0, sizeof(cfg));
+    memset(&fs_cfg, 0, sizeof(fs_cfg));
+    cfg.db_max_size = opts.db_max_size;
+    fs_cfg.db_max_size = opts.db_max_size;
+    cfg_fs = &fs_cfg;
+
+    ret = migrate_database(DATASPACE_FILE, DBPF_DB_COMPARE_DS_ATTR, 1, &cfg);
+    if (ret == 0)
+    {
+        ret = migrate_database(KEYVAL_FILE, DBPF_DB_COMPARE_KEYVAL, 1, &cfg);
+    }
+    if (ret == 0)
+    {
+        ret = migrate_database(PACKED_FILE, DBPF_DB_COMPARE_DS_ATTR, 0,
+                               &cfg);
+    }
+    if (ret != 0)
+    {
+        dbpf_db_close(db_p);
+        return ret;
+    }
+
+    /* only now will the server open the collection */
+    key_format = dbpf_db_key_format();
+    ret = dbpf_db_put(db_p, &key, &val);
+    if (ret == 0)
+    {
+        ret = dbpf_db_sync(db_p);
+    }
+    dbpf_db_close(db_p);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to write key format: %s\n", strerror(ret));
+        return ret;
+    }
+
+    printf("Collection %s converted to key format %d. The old databases\n"
+           "were kept with the suffix %s and may be removed.\n",
+           opts.hexdir, key_format, LEGACY_SUFFIX);
+    return 0;
+}
+
+/* copies every record of the named database into a new database with the
+ * current key format, then moves the new database into place */
+int migrate_database(char *name, int compare, int required,
+    struct server_configuration_s *cfg)
+{
+    char path[PATH_MAX], new_path[PATH_MAX], old_path[PATH_MAX];
+    dbpf_db *in_p = NULL, *out_p = NULL;
+    dbpf_cursor *dbc_p = NULL;
+    struct dbpf_data key, val;
+    char key_buf[DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(DBPF_MAX_KEY_LENGTH)];
+    size_t val_size = VAL_BUF_SIZE;
+    long count = 0;
+    int ret, op;
+
+    if (snprintf(path, PATH_MAX, "%s/%s/%s", opts.dbpath, opts.hexdir,
+                 name) >= PATH_MAX ||
+        snprintf(new_path, PATH_MAX, "%s%s", path,
+                 MIGRATE_SUFFIX) >= PATH_MAX ||
+        snprintf(old_path, PATH_MAX, "%s%s", path,
+                 LEGACY_SUFFIX) >= PATH_MAX)
+    {
+        fprintf(stderr, "Path to %s is too long\n", name);
+        return ENAMETOOLONG;
+    }
+
+    if (access(path, F_OK) != 0)
+    {
+        if (required)
+        {
+            fprintf(stderr, "Unable to find %s\n", path);
+            return ENOENT;
+        }
+        return 0;
+    }
+    if (access(new_path, F_OK) == 0 || access(old_path, F_OK) == 0)
+    {
+        fprintf(stderr, "%s or %s exists from an earlier run; remove it "
+                "first\n", new_path, old_path);
+        return EEXIST;
+    }
+
+    ret = dbpf_db_open(path, compare | DBPF_DB_COMPARE_LEGACY, &in_p, 0,
+                       cfg);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to open %s: %s\n", path, strerror(ret));
+        return ret;
+    }
+    ret = dbpf_db_open(new_path, compare, &out_p, 1, cfg);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to create %s: %s\n", new_path,
+                strerror(ret));
+        dbpf_db_close(in_p);
+        return ret;
+    }
+    ret = dbpf_db_cursor(in_p, &dbc_p, 1);
+    if (ret != 0)
+    {
+        fprintf(stderr, "Unable to open cursor on %s: %s\n", path,
+                strerror(ret));
+        goto out;
+    }
+
+    val.data = malloc(val_size);
+    if (!val.data)
+    {
+        ret = ENOMEM;
+        goto out;
+    }
+
+    op = DBPF_DB_CURSOR_FIRST;
+    while (1)
+    {
+        key.data = key_buf;
+        key.len = sizeof(key_buf);
+        val.len = val_size;
+        ret = dbpf_db_cursor_get(dbc_p, &key, &val, op, sizeof(key_buf));
+        if (ret != 0)
+        {
+            break;
+        }
+        if (val.len > val_size)
+        {
+            /* read the same record again with room for all of it */
+            free(val.data);
+            val_size = val.len;
+            val.data = malloc(val_size);
+            if (!val.data)
+            {
+                ret = ENOMEM;
+                break;
+            }
+            op = DBPF_DB_CURSOR_CURRENT;
+            continue;
+        }
+        op = DBPF_DB_CURSOR_NEXT;
+
+        ret = dbpf_db_putonce(out_p, &key, &val);
+        if (ret != 0)
+        {
+            fprintf(stderr, "Unable to write record %ld to %s: %s\n",
+                    count, new_path, strerror(ret));
+            break;
+        }
+        count++;
+    }
+    free(val.data);
+    if (ret == TROVE_ENOENT)
+    {
+        ret = 0;
+    }
+    else if (ret != 0)
+    {
+        fprintf(stderr, "Error reading %s: %s\n", path, strerror(ret));
+    }
+
+out:
+    if (dbc_p)
+    {
+        dbpf_db_cursor_close(dbc_p);
+    }
+    if (ret == 0)
+    {
+        ret = dbpf_db_sync(out_p);
+    }
+    dbpf_db_close(out_p);
+    dbpf_db_close(in_p);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    if (rename(path, old_path) != 0 || rename(new_path, path) != 0)
+    {
+        ret = errno;
+        fprintf(stderr, "Unable to move %s into place: %s\n", new_path,
+                strerror(ret));
+        return ret;
+    }
+    if (opts.verbose)
+    {
+        printf("%s: %ld records\n", name, count);
+    }
+    return 0;
+}
+
+int process_args(int argc, char ** argv)
+{
+    int ret = 0, option_index = 0;
+    static struct option long_opts[] =
+    {
+        {"help",0,0,0},
+        {"verbose",0,0,0},
+        {"dbpath",1,0,0},
+        {"hexdir",1,0,0},
+        {"dbmaxsize",1,0,0},
+        {0,0,0,0}
+    };
+
+    memset(&opts, 0, sizeof(options_t));
+    opts.db_max_size = 536870912;
+
+    while ((ret = getopt_long(argc, argv, "", long_opts, &option_index)) != -1)
+    {
+        switch (option_index)
+        {
+            case 0: /* help */
+                print_help(argv[0]);
+                exit(0);
+            case 1: /* verbose */
+                opts.verbose = 1;
+                break;
+            case 2: /*dbpath */
+                strncpy(opts.dbpath, optarg, PATH_MAX - 1);
+                break;
+            case 3: /* hexdir */
+                strncpy(opts.hexdir, optarg, PATH_MAX - 1);
+                break;
+            case 4: /* dbmaxsize */
+                opts.db_max_size = strtoull(optarg, NULL, 0);
+                break;
+            default:
+                print_help(argv[0]);
+                return -1;
+        }
+        option_index = 0;
+    }
+
+    if( strncmp( opts.dbpath,"",PATH_MAX ) == 0 )
+    {
+        fprintf(stderr, "\nError: --dbpath option must be given.\n");
+        print_help(argv[0]);
+        return -1;
+    }
+
+    if( strncmp( opts.hexdir,"",PATH_MAX ) == 0 )
+    {
+        fprintf(stderr, "\nError: --hexdir option must be given.\n");
+        print_help(argv[0]);
+        return -1;
+    }
+
+    return 0;
+}
+
+void print_help(char *progname)
+{
+    fprintf(stderr,
+            "\nThis utility converts the dataspace and keyval databases of\n"
+            "one collection to the key format used by this release. The\n"
+            "server must be stopped while it runs.\n");
+    fprintf(stderr, "\nUsage:\t\t%s --dbpath <path> --hexdir <hexdir>",
+            progname);
+    fprintf(stderr, "\nExample:\t%s --dbpath /tmp/pvfs2-space --hexdir "
+                    "4e3f77a5\n", progname);
+    fprintf(stderr, "\nOptions:\n"
+                    "\t--verbose\t\tPrint the records copied per database\n"
+                    "\t--help\t\t\tThis message.\n"
+                    "\t--dbpath <path>\t\tThe path of the server's "
+                    "metadata StorageSpace.\n"
+                    "\t--hexdir <dir>\t\tThe directory in dbpath that "
+                    "contains\n\t\t\t\tcollection_attributes.db, "
+                    "dataspace_attributes.db\n\t\t\t\tand keyval.db\n"
+                    "\t--dbmaxsize <bytes>\tMap size of the new databases "
+                    "(DBMaxSize)\n\n");
+    return;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -16,105 +16,209 @@
  */
 
 /* char *pvfs2fuse_version = "$Id: pvfs2fuse.c,v 1.3.8.2 2010-12-21 15:34:13 mtmoore Exp $"; */
-char *pvfs2fuse_version = "0.01";
+char *pvfs2fuse_version = "0.02";
+
+/* This daemon uses the FUSE low-level API.  FUSE inode numbers are
+ * pointers to pvfs_fuse_inode_t records that hold the PVFS object
+ * reference, so no request ever resolves a full path; the records are
+ * reference counted with the kernel's lookup counts and released on
+ * forget.  Entry and attribute timeouts handed to the kernel follow the
+ * ncache and acache timeouts of the system interface.
+ */
 
-#define FUSE_USE_VERSION 27
+/* API 30 is the oldest libfuse 3 API and every 3.x release accepts it.
+ * It keeps fuse_session_loop_mt(se, clone_fd) and the 3.0 layout of
+ * struct fuse_cmdline_opts; newer releases map both to compatibility
+ * symbols instead of the fuse_loop_config variants of 3.2 and 3.12.
+ */
+#define FUSE_USE_VERSION 30
 
-#include <fuse.h>
+#include <fuse_lowlevel.h>
 #include <fuse_opt.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <errno.h>
 #include <string.h>
 #include <stdio.h>
-#include <utime.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/stat.h>
+#include <sys/statvfs.h>
 
-#include "pvfs2-compat.h"
+#include "pvfs2.h"
+#include "pvfs2-sysint.h"
 #include "pint-dev-shared.h"
 #include "pint-util.h"
 #include "str-utils.h"
 #include "pvfs2-util.h"
 #include "pint-security.h"
 #include "security-util.h"
+#include "quickhash.h"
+#include "gen-locks.h"
+
+/* one per inode the kernel knows about */
+typedef struct {
+	  PVFS_object_ref	ref;
+	  uint64_t		nlookup;
+	  struct qhash_head	hash_link;
+} pvfs_fuse_inode_t;
 
+/* one per open file */
 typedef struct {
 	  PVFS_object_ref	ref;
 	  PVFS_credential	cred;
 } pvfs_fuse_handle_t;
 
+/* one per open directory; offsets handed to the kernel count entries
+ * from the start of the directory, with 0 and 1 for "." and ".."
+ */
+typedef struct {
+	  PVFS_object_ref	ref;
+	  PVFS_credential	cred;
+	  PVFS_ds_position	token;		/* position after the batch */
+	  off_t			batch_start;	/* offset of dirent_array[0] */
+	  int			eof;
+	  PVFS_sysresp_readdirplus batch;
+} pvfs_fuse_dir_t;
+
 struct pvfs2fuse {
 	  char	*fs_spec;
 	  char	*mntpoint;
 	  PVFS_fs_id	fs_id;
 	  struct PVFS_sys_mntent mntent;
+	  pvfs_fuse_inode_t root;
+	  int	acache_timeout;		/* msecs, -1 keeps the default */
+	  int	ncache_timeout;		/* msecs, -1 keeps the default */
+	  double attr_timeout;		/* secs, from the acache timeout */
+	  double entry_timeout;		/* secs, from the ncache timeout */
+	  unsigned int max_write;
+	  unsigned int dirent_count;
 };
 
 static struct pvfs2fuse pvfs2fuse;
 
-#if __LP64__
-#define SET_FUSE_HANDLE( fi, pfh ) \
-	fi->fh = (uint64_t)pfh
-#define GET_FUSE_HANDLE( fi ) \
-	(pvfs_fuse_handle_t *)fi->fh
-#else
+#define PVFS_FUSE_DEFAULT_MAX_WRITE	(1024 * 1024)
+#define PVFS_FUSE_DEFAULT_DIRENT_COUNT	512
+#define PVFS_FUSE_INODE_TABLE_SIZE	8191
+
+static struct qhash_table *inode_table = NULL;
+static gen_mutex_t inode_mutex = GEN_MUTEX_INITIALIZER;
+
 #define SET_FUSE_HANDLE( fi, pfh ) \
-	*((pvfs_fuse_handle_t **)(&fi->fh)) = pfh
+	fi->fh = (uint64_t)(uintptr_t)pfh
 #define GET_FUSE_HANDLE( fi ) \
-	*((pvfs_fuse_handle_t **)(&fi->fh))
-#endif
+	((pvfs_fuse_handle_t *)(uintptr_t)fi->fh)
+#define GET_FUSE_DIR( fi ) \
+	((pvfs_fuse_dir_t *)(uintptr_t)fi->fh)
+
+#define pvfs_fuse_cleanup_credential(cred) PINT_cleanup_credential(cred)
 
-#define PVFS_VERSION(a,b,c) (((a) << 16) + ((b) << 8) + (c))
-#define THIS_PVFS_VERSION \
-     PVFS_VERSION(PVFS2_VERSION_MAJOR, PVFS2_VERSION_MINOR, PVFS2_VERSION_SUB)
+/* pvfs_fuse_errno()
+ *
+ * maps a PVFS error code to the positive errno fuse_reply_err() wants
+ */
+static int pvfs_fuse_errno(int ret)
+{
+   int err;
+
+   if (ret >= 0)
+	  return EIO;
+   if (IS_PVFS_NON_ERRNO_ERROR(-ret))
+	  return EIO;
+   err = PVFS_ERROR_TO_ERRNO(ret);
+   if (err < 0)
+	  err = -err;
+   return err ? err : EIO;
+}
 
-#if THIS_PVFS_VERSION > PVFS_VERSION(2,6,3)
-#define PVFS_ERROR_TO_ERRNO_N(x) (-1)*PVFS_ERROR_TO_ERRNO(x)
-#else
-#define PVFS_ERROR_TO_ERRNO_N(x) PVFS_ERROR_TO_ERRNO(x)
-#endif
+/* credentials are generated per uid/gid pair and reused until they are
+ * close to expiring; with security enabled each generation forks
+ * pvfs2-gencred, which would otherwise dominate metadata workloads
+ */
+#define PVFS_FUSE_CRED_CACHE_SIZE	16
+#define PVFS_FUSE_CRED_MIN_LIFE		60
+
+struct pvfs_fuse_cred_entry {
+	  int		valid;
+	  uid_t		uid;
+	  gid_t		gid;
+	  PVFS_credential cred;
+};
 
-#define pvfs_fuse_cleanup_credential(cred) PINT_cleanup_credential(cred)
+static struct pvfs_fuse_cred_entry cred_cache[PVFS_FUSE_CRED_CACHE_SIZE];
+static gen_mutex_t cred_mutex = GEN_MUTEX_INITIALIZER;
 
 static int pvfs_fuse_gen_credential(
+   fuse_req_t req,
    PVFS_credential *credential)
 {
-   struct fuse_context *ctx = fuse_get_context();
+   const struct fuse_ctx *ctx = fuse_req_ctx(req);
+   struct pvfs_fuse_cred_entry *ent;
    PVFS_credential *new_cred;
    char uid[16], gid[16];
    int ret;
 
+   ent = &cred_cache[(ctx->uid ^ (ctx->gid << 4)) % PVFS_FUSE_CRED_CACHE_SIZE];
+
+   gen_mutex_lock(&cred_mutex);
+   if (ent->valid && ent->uid == ctx->uid && ent->gid == ctx->gid &&
+	   ent->cred.timeout > time(NULL) + PVFS_FUSE_CRED_MIN_LIFE)
+   {
+	  ret = PINT_copy_credential(&ent->cred, credential);
+	  gen_mutex_unlock(&cred_mutex);
+	  return ret;
+   }
+   gen_mutex_unlock(&cred_mutex);
+
    /* convert uid/gid to strings */
    ret = snprintf(uid, sizeof(uid), "%u", ctx->uid);
    if (ret < 0 || ret >= sizeof(uid))
    {
-      return -1;
+      return -PVFS_EINVAL;
    }
 
    ret = snprintf(gid, sizeof(gid), "%u", ctx->gid);
    if (ret < 0 || ret >= sizeof(gid))
    {
-       return -1;
+       return -PVFS_EINVAL;
    }
 
    /* allocate new credential */
    new_cred = (PVFS_credential *) malloc(sizeof(PVFS_credential));
    if (!new_cred)
    {
-       return -ENOMEM;
+       return -PVFS_ENOMEM;
    }
    memset(new_cred, 0, sizeof(PVFS_credential));
 
    /* generate credential -- this process must be running as root */
-   ret = PVFS_util_gen_credential(uid, 
-                                  gid, 
-                                  PVFS2_DEFAULT_CREDENTIAL_TIMEOUT, 
+   ret = PVFS_util_gen_credential(uid,
+                                  gid,
+                                  PVFS2_DEFAULT_CREDENTIAL_TIMEOUT,
                                   NULL, NULL,
                                   new_cred);
 
    if (ret == 0)
    {
        /* copy credential to provided buffer */
-       ret = PINT_copy_credential(new_cred, credential);      
+       ret = PINT_copy_credential(new_cred, credential);
+   }
+
+   if (ret == 0)
+   {
+       gen_mutex_lock(&cred_mutex);
+       if (ent->valid)
+       {
+          pvfs_fuse_cleanup_credential(&ent->cred);
+          ent->valid = 0;
+       }
+       if (PINT_copy_credential(new_cred, &ent->cred) == 0)
+       {
+          ent->uid = ctx->uid;
+          ent->gid = ctx->gid;
+          ent->valid = 1;
+       }
+       gen_mutex_unlock(&cred_mutex);
    }
 
    /* free generated credential */
@@ -124,55 +228,101 @@ static int pvfs_fuse_gen_credential(
    return ret;
 }
 
-static int lookup( const char *path, pvfs_fuse_handle_t *pfh, 
-				   int32_t follow_link )
+/*
+ * inode table
+ */
+
+static int pvfs_fuse_inode_compare(const void *key, struct qhash_head *link)
 {
-   PVFS_sysresp_lookup lk_response;
-   int			ret;
+   pvfs_fuse_inode_t *inode = qhash_entry(link, pvfs_fuse_inode_t, hash_link);
+
+   return (inode->ref.handle == *(const PVFS_handle *)key);
+}
 
-   /* we don't have to do a PVFS_util_resolve
-	* because FUSE resolves the path for us
-	*/
+static pvfs_fuse_inode_t *pvfs_fuse_inode(fuse_ino_t ino)
+{
+   if (ino == FUSE_ROOT_ID)
+	  return &pvfs2fuse.root;
+   return (pvfs_fuse_inode_t *)(uintptr_t)ino;
+}
 
-   ret = pvfs_fuse_gen_credential(&pfh->cred);
-   if (ret < 0)
+static fuse_ino_t pvfs_fuse_ino(pvfs_fuse_inode_t *inode)
+{
+   if (inode == &pvfs2fuse.root)
+	  return FUSE_ROOT_ID;
+   return (fuse_ino_t)(uintptr_t)inode;
+}
+
+/* pvfs_fuse_inode_get()
+ *
+ * returns the inode number for ref, adding one kernel lookup reference
+ */
+static fuse_ino_t pvfs_fuse_inode_get(PVFS_object_ref ref)
+{
+   struct qhash_head *link;
+   pvfs_fuse_inode_t *inode;
+
+   if (ref.handle == pvfs2fuse.root.ref.handle)
+	  return FUSE_ROOT_ID;
+
+   gen_mutex_lock(&inode_mutex);
+   link = qhash_search(inode_table, &ref.handle);
+   if (link)
    {
-      return ret;
+	  inode = qhash_entry(link, pvfs_fuse_inode_t, hash_link);
    }
-
-   memset(&lk_response, 0, sizeof(lk_response));
-   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, 
-						 (char *)path,
-						 &pfh->cred, 
-						 &lk_response, 
-						 follow_link);
-   if ( ret < 0 ) {
-      pvfs_fuse_cleanup_credential(&pfh->cred);
-	  return ret;
+   else
+   {
+	  inode = (pvfs_fuse_inode_t *)malloc(sizeof(pvfs_fuse_inode_t));
+	  if (!inode)
+	  {
+		 gen_mutex_unlock(&inode_mutex);
+		 return 0;
+	  }
+	  inode->ref = ref;
+	  inode->nlookup = 0;
+	  qhash_add(inode_table, &inode->ref.handle, &inode->hash_link);
    }
+   inode->nlookup++;
+   gen_mutex_unlock(&inode_mutex);
 
-   pfh->ref.handle = lk_response.ref.handle;
-   pfh->ref.fs_id  = pvfs2fuse.fs_id;
+   return pvfs_fuse_ino(inode);
+}
 
-   return 0;
+/* pvfs_fuse_inode_put()
+ *
+ * drops nlookup kernel references, freeing the inode with the last one
+ */
+static void pvfs_fuse_inode_put(fuse_ino_t ino, uint64_t nlookup)
+{
+   pvfs_fuse_inode_t *inode;
+
+   if (ino == FUSE_ROOT_ID || ino == 0)
+	  return;
+
+   inode = pvfs_fuse_inode(ino);
+   gen_mutex_lock(&inode_mutex);
+   if (inode->nlookup <= nlookup)
+   {
+	  qhash_del(&inode->hash_link);
+	  free(inode);
+   }
+   else
+   {
+	  inode->nlookup -= nlookup;
+   }
+   gen_mutex_unlock(&inode_mutex);
 }
 
-static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
+/*
+ * attributes
+ */
+
+static void pvfs_fuse_attr_to_stat(PVFS_object_ref ref, PVFS_sys_attr *attrs,
+								   struct stat *stbuf)
 {
-   PVFS_sysresp_getattr getattr_response;
-   PVFS_sys_attr*	attrs;
-   int			ret;
    int			perm_mode = 0;
 
-   memset(&getattr_response,0, sizeof(PVFS_sysresp_getattr));
-    
-   ret = PVFS_sys_getattr(pfhp->ref, 
-                          PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfhp->cred, 
-                          &getattr_response);
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
    memset(stbuf, 0, sizeof(struct stat));
 
    /* Code copied from kernel/linux-2.x/pvfs2-utils.c */
@@ -190,8 +340,6 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 
    */
 
-   attrs = &getattr_response.attr;
-   
    if (attrs->objtype == PVFS_TYPE_METAFILE)
    {
 	  if (attrs->mask & PVFS_ATTR_SYS_SIZE)
@@ -268,7 +416,7 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
 	  case PVFS_TYPE_DIRECTORY:
 		 stbuf->st_mode |= S_IFDIR;
-		 /* NOTE: we have no good way to keep nlink consistent for 
+		 /* NOTE: we have no good way to keep nlink consistent for
 		  * directories across clients; keep constant at 1.  Why 1?  If
 		  * we go with 2, then find(1) gets confused and won't work
 		  * properly withouth the -noleaf option */
@@ -281,402 +429,402 @@ static int pvfs_fuse_getattr_pfhp(pvfs_fuse_handle_t *pfhp, struct stat *stbuf)
 		 break;
    }
 
-   stbuf->st_dev = pfhp->ref.fs_id;
-   stbuf->st_ino = pfhp->ref.handle;
+   stbuf->st_dev = ref.fs_id;
+   stbuf->st_ino = ref.handle;
 
    stbuf->st_rdev = 0;
    stbuf->st_blksize = 4096;
-
-   PVFS_util_release_sys_attr(attrs);
-    
-   return 0;
-}
-
-static int pvfs_fuse_getattr(const char *path, struct stat *stbuf)
-{
-   int			ret;
-   pvfs_fuse_handle_t	pfh;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
-   if ( ret < 0 )
-   {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
-   }
-
-   ret = pvfs_fuse_getattr_pfhp( &pfh, stbuf );
-
-   pvfs_fuse_cleanup_credential(&pfh.cred);
-
-   return ret;
-}
-
-static int pvfs_fuse_fgetattr(const char *path, struct stat *stbuf,
-							  struct fuse_file_info *fi)
-{
-   return pvfs_fuse_getattr_pfhp( GET_FUSE_HANDLE( fi ), stbuf );
 }
 
-static int pvfs_fuse_readlink(const char *path, char *buf, size_t size)
+static int pvfs_fuse_getattr_ref(PVFS_object_ref ref, PVFS_credential *cred,
+								 struct stat *stbuf)
 {
    PVFS_sysresp_getattr getattr_response;
    int			ret;
-   size_t		len;
-   pvfs_fuse_handle_t	pfh;
-
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_NO_FOLLOW );
-   if ( ret < 0 )
-   {
-      return PVFS_ERROR_TO_ERRNO_N( ret );
-   }
-
-   ret = PVFS_sys_getattr(pfh.ref, 
-						  PVFS_ATTR_SYS_ALL_NOHINT,
-						  (PVFS_credential *) &pfh.cred, 
-						  &getattr_response);
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   memset(&getattr_response,0, sizeof(PVFS_sysresp_getattr));
 
+   ret = PVFS_sys_getattr(ref,
+                          PVFS_ATTR_SYS_ALL_NOHINT,
+                          cred,
+                          &getattr_response,
+                          PVFS_HINT_NULL);
    if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   if (getattr_response.attr.objtype != PVFS_TYPE_SYMLINK)
-	  return -EINVAL;
-
-   len = strlen( getattr_response.attr.link_target );
-   if ( len < (size-1) )
-	  size = len;
-
-   bcopy( getattr_response.attr.link_target, buf, size );
+	  return ret;
 
-   buf[len] = '\0';
+   pvfs_fuse_attr_to_stat(ref, &getattr_response.attr, stbuf);
+   PVFS_util_release_sys_attr(&getattr_response.attr);
 
    return 0;
 }
 
-static int pvfs_fuse_mkdir(const char *path, mode_t mode)
+/* pvfs_fuse_fill_entry()
+ *
+ * fetches the attributes of ref and takes a lookup reference for the
+ * kernel; the caller must hand e to a fuse_reply_entry()/create()
+ */
+static int pvfs_fuse_fill_entry(PVFS_object_ref ref, PVFS_credential *cred,
+								struct fuse_entry_param *e)
 {
-   int rc;
-   int num_segs;
-   PVFS_sys_attr attr;
-   char parent[PVFS_NAME_MAX];
-   char dirname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
-
-   PVFS_sysresp_mkdir resp_mkdir;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  dirname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-   {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
-
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
-   {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
-
-   /* Set attributes */
-   memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = parent_pfh.cred.userid;
-   attr.group = parent_pfh.cred.group_array[0];
-   attr.perms = mode;
-   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
-
-   rc = PVFS_sys_mkdir(dirname,
-					   parent_pfh.ref,
-					   attr,
-					   &parent_pfh.cred,
-					   &resp_mkdir);
+   int ret;
 
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
+   memset(e, 0, sizeof(*e));
+   ret = pvfs_fuse_getattr_ref(ref, cred, &e->attr);
+   if (ret < 0)
+	  return ret;
 
-   if (rc)
-   {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
+   e->ino = pvfs_fuse_inode_get(ref);
+   if (e->ino == 0)
+	  return -PVFS_ENOMEM;
+   e->attr_timeout = pvfs2fuse.attr_timeout;
+   e->entry_timeout = pvfs2fuse.entry_timeout;
 
    return 0;
 }
 
-static int pvfs_fuse_remove( const char *path )
-{
-   int rc;
-   int num_segs;
-   char parent[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	parent_pfh;
+/*
+ * operations
+ */
 
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, parent, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
+static void pvfs_fuse_lookup(fuse_req_t req, fuse_ino_t parent,
+							 const char *name)
+{
+   PVFS_sysresp_lookup lk_response;
+   PVFS_credential	cred;
+   struct fuse_entry_param e;
+   int			ret;
 
-   if (rc)
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
    }
 
-   rc = lookup( parent, &parent_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc)
+   memset(&lk_response, 0, sizeof(lk_response));
+   ret = PVFS_sys_ref_lookup(pvfs2fuse.fs_id,
+							 (char *)name,
+							 pvfs_fuse_inode(parent)->ref,
+							 &cred,
+							 &lk_response,
+							 PVFS2_LOOKUP_LINK_NO_FOLLOW,
+							 PVFS_HINT_NULL);
+   if (ret == -PVFS_ENOENT)
    {
-      return PVFS_ERROR_TO_ERRNO_N( rc );
+	  /* negative entry, cached by the kernel as long as the ncache
+	   * would have cached a positive one */
+	  memset(&e, 0, sizeof(e));
+	  e.entry_timeout = pvfs2fuse.entry_timeout;
+	  pvfs_fuse_cleanup_credential(&cred);
+	  fuse_reply_entry(req, &e);
+	  return;
    }
-
-   rc = PVFS_sys_remove(filename, parent_pfh.ref, &parent_pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&parent_pfh.cred);
-
-   if (rc)
+   if (ret == 0)
    {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
+	  ret = pvfs_fuse_fill_entry(lk_response.ref, &cred, &e);
    }
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_entry(req, &e);
 }
 
-static int pvfs_fuse_unlink(const char *path)
+static void pvfs_fuse_forget(fuse_req_t req, fuse_ino_t ino, uint64_t nlookup)
 {
-   return pvfs_fuse_remove(path);
+   pvfs_fuse_inode_put(ino, nlookup);
+   fuse_reply_none(req);
 }
 
-static int pvfs_fuse_rmdir(const char *path)
+static void pvfs_fuse_forget_multi(fuse_req_t req, size_t count,
+								   struct fuse_forget_data *forgets)
 {
-   return pvfs_fuse_remove(path);
+   size_t i;
+
+   for (i = 0; i < count; i++)
+	  pvfs_fuse_inode_put(forgets[i].ino, forgets[i].nlookup);
+   fuse_reply_none(req);
 }
 
-static int pvfs_fuse_symlink(const char *from, const char *to)
+static void pvfs_fuse_getattr(fuse_req_t req, fuse_ino_t ino,
+							  struct fuse_file_info *fi)
 {
-   int                  ret = 0;
-   PVFS_sys_attr        attr;
-   PVFS_sysresp_lookup  resp_lookup;
-   PVFS_object_ref      parent_ref;
-   PVFS_sysresp_symlink resp_sym;
-   PVFS_credential      credential;
-   pvfs_fuse_handle_t	dir_pfh;
-   char *tofile, *todir, *cp;
+   PVFS_credential	cred;
+   struct stat		stbuf;
+   int			ret;
+
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
+
+   ret = pvfs_fuse_getattr_ref(pvfs_fuse_inode(ino)->ref, &cred, &stbuf);
 
-   pvfs_fuse_gen_credential(&credential);
+   pvfs_fuse_cleanup_credential(&cred);
 
-   /* Initialize any variables */
-   memset(&attr,        0, sizeof(attr));
-   memset(&resp_lookup, 0, sizeof(resp_lookup));
-   memset(&parent_ref,  0, sizeof(parent_ref));
-   memset(&resp_sym,    0, sizeof(resp_sym));
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_attr(req, &stbuf, pvfs2fuse.attr_timeout);
+}
 
-   /* Set the attributes for the new directory */
-   attr.owner = credential.userid;
-   attr.group = credential.group_array[0];
-   attr.perms = 0777;              
-   attr.mask = (PVFS_ATTR_SYS_ALL_SETABLE);
+static void pvfs_fuse_setattr(fuse_req_t req, fuse_ino_t ino,
+							  struct stat *attr, int to_set,
+							  struct fuse_file_info *fi)
+{
+   PVFS_object_ref	ref = pvfs_fuse_inode(ino)->ref;
+   PVFS_credential	cred;
+   PVFS_sys_attr	new_attr;
+   struct stat		stbuf;
+   int			ret;
 
-   todir = strdup( to );
-   if ( todir == NULL )
-	  return -ENOMEM;
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
 
-   /* find the last / to get the parent directory */
-   cp = rindex( todir,  '/' );
-   if ( cp == NULL )
+   memset(&new_attr, 0, sizeof(new_attr));
+   if (to_set & FUSE_SET_ATTR_MODE)
    {
-	  free( todir );
-	  return -ENOTDIR;
+	  /* FUSE passes in 5 octets in 'mode'. However, the the first
+	   * octet is not related to permissions, hence checking only
+	   *  the lower 4 octets */
+	  new_attr.perms = attr->st_mode & 07777;
+	  new_attr.mask |= PVFS_ATTR_SYS_PERM;
    }
-   tofile = strdup( cp+1 );
-   if ( cp == todir )
+   if (to_set & FUSE_SET_ATTR_UID)
    {
-	  /* we're creating a link at the root, so keep the slash */
-	  *(cp+1) = '\0';
+	  new_attr.owner = attr->st_uid;
+	  new_attr.mask |= PVFS_ATTR_SYS_UID;
    }
-   else
+   if (to_set & FUSE_SET_ATTR_GID)
    {
-	  *cp = '\0';
+	  new_attr.group = attr->st_gid;
+	  new_attr.mask |= PVFS_ATTR_SYS_GID;
    }
-
-   ret = lookup( todir, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if(ret < 0)
+   /* an explicit time is stored as given; "now" is left to the server */
+   if (to_set & FUSE_SET_ATTR_ATIME)
    {
-	  free( tofile );
-	  free( todir );
-	  PVFS_perror("lookup", ret);
-	  return(-1);
+	  new_attr.atime = (PVFS_time)attr->st_atime;
+	  new_attr.mask |= PVFS_ATTR_SYS_ATIME | PVFS_ATTR_SYS_ATIME_SET;
+   }
+   else if (to_set & FUSE_SET_ATTR_ATIME_NOW)
+   {
+	  new_attr.mask |= PVFS_ATTR_SYS_ATIME;
+   }
+   if (to_set & FUSE_SET_ATTR_MTIME)
+   {
+	  new_attr.mtime = (PVFS_time)attr->st_mtime;
+	  new_attr.mask |= PVFS_ATTR_SYS_MTIME | PVFS_ATTR_SYS_MTIME_SET;
+   }
+   else if (to_set & FUSE_SET_ATTR_MTIME_NOW)
+   {
+	  new_attr.mask |= PVFS_ATTR_SYS_MTIME;
    }
 
-   ret = PVFS_sys_symlink(tofile, 
-						  dir_pfh.ref, 
-						  (char *) from,
-						  attr, 
-						  &credential, 
-						  &resp_sym);
+   ret = 0;
+   if (new_attr.mask)
+	  ret = PVFS_sys_setattr(ref, new_attr, &cred, PVFS_HINT_NULL);
+
+   if (ret == 0 && (to_set & FUSE_SET_ATTR_SIZE))
+	  ret = PVFS_sys_truncate(ref, attr->st_size, &cred, PVFS_HINT_NULL);
+
+   if (ret == 0)
+	  ret = pvfs_fuse_getattr_ref(ref, &cred, &stbuf);
+
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_attr(req, &stbuf, pvfs2fuse.attr_timeout);
+}
 
-   pvfs_fuse_cleanup_credential(&credential);
-   pvfs_fuse_cleanup_credential(&dir_pfh.cred);
+static void pvfs_fuse_readlink(fuse_req_t req, fuse_ino_t ino)
+{
+   PVFS_sysresp_getattr getattr_response;
+   PVFS_credential	cred;
+   int			ret;
 
+   ret = pvfs_fuse_gen_credential(req, &cred);
    if (ret < 0)
    {
-	  PVFS_perror("PVFS_sys_symlink", ret);
-	  return(ret);
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
    }
-   else
+
+   memset(&getattr_response, 0, sizeof(getattr_response));
+   ret = PVFS_sys_getattr(pvfs_fuse_inode(ino)->ref,
+						  PVFS_ATTR_SYS_ALL_NOHINT,
+						  &cred,
+						  &getattr_response,
+						  PVFS_HINT_NULL);
+
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if ( ret < 0 )
    {
-	  ret = 0;
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+	  return;
    }
-    
-   free( tofile );
-   free( todir );
-   return(ret);
+
+   if (getattr_response.attr.objtype != PVFS_TYPE_SYMLINK ||
+	   !getattr_response.attr.link_target)
+	  fuse_reply_err(req, EINVAL);
+   else
+	  fuse_reply_readlink(req, getattr_response.attr.link_target);
+
+   PVFS_util_release_sys_attr(&getattr_response.attr);
 }
 
-static int pvfs_fuse_rename(const char *from, const char *to)
+static void pvfs_fuse_init_attr(PVFS_sys_attr *attr, PVFS_credential *cred,
+								mode_t mode)
 {
-   int rc;
-   int num_segs;
-   char fromdir[PVFS_NAME_MAX], todir[PVFS_NAME_MAX];
-   char fromname[PVFS_SEGMENT_MAX], toname[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	todir_pfh, fromdir_pfh;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)from, fromdir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)from);
-   rc = PINT_get_path_element((char *)from, num_segs - 1,
-							  fromname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   rc = lookup( fromdir, &fromdir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)to, todir, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)to);
-   rc = PINT_get_path_element((char *)to, num_segs - 1,
-							  toname, PVFS_SEGMENT_MAX);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   lookup( todir, &todir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if (rc < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   rc = PVFS_sys_rename(fromname,
-						fromdir_pfh.ref,
-						toname,
-						todir_pfh.ref,
-						&todir_pfh.cred);
-
-   pvfs_fuse_cleanup_credential(&fromdir_pfh.cred);
-   pvfs_fuse_cleanup_credential(&todir_pfh.cred);
-
-   if (rc)
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   return 0;
+   memset(attr, 0, sizeof(PVFS_sys_attr));
+   attr->owner = cred->userid;
+   attr->group = cred->group_array[0];
+   attr->perms = mode & 07777;
+   attr->atime = time(NULL);
+   attr->mtime = attr->atime;
+   attr->mask = PVFS_ATTR_SYS_ALL_SETABLE;
+   attr->dfile_count = 0;
 }
 
-static int pvfs_fuse_chmod(const char *path, mode_t mode)
+static void pvfs_fuse_mkdir(fuse_req_t req, fuse_ino_t parent,
+							const char *name, mode_t mode)
 {
+   PVFS_credential	cred;
+   PVFS_sys_attr	attr;
+   PVFS_sysresp_mkdir	resp_mkdir;
+   struct fuse_entry_param e;
    int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   /* FUSE passes in 5 octets in 'mode'. However, the the first 
-    * octet is not related to permissions, hence checking only
-    *  the lower 4 octets */
-   new_attr.perms = mode & 07777;
-   new_attr.mask = PVFS_ATTR_SYS_PERM;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
+
+   pvfs_fuse_init_attr(&attr, &cred, mode);
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   ret = PVFS_sys_mkdir((char *)name,
+						pvfs_fuse_inode(parent)->ref,
+						attr,
+						&cred,
+						&resp_mkdir,
+						PVFS_HINT_NULL);
+   if (ret == 0)
+	  ret = pvfs_fuse_fill_entry(resp_mkdir.ref, &cred, &e);
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_cleanup_credential(&cred);
 
-   return 0;
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_entry(req, &e);
 }
 
-static int pvfs_fuse_chown(const char *path, uid_t uid, gid_t gid)
+static void pvfs_fuse_remove(fuse_req_t req, fuse_ino_t parent,
+							 const char *name)
 {
+   PVFS_credential	cred;
    int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.owner = uid;
-   new_attr.group = gid;
-   new_attr.mask = PVFS_ATTR_SYS_UID | PVFS_ATTR_SYS_GID;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   ret = PVFS_sys_remove((char *)name, pvfs_fuse_inode(parent)->ref,
+						 &cred, PVFS_HINT_NULL);
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   pvfs_fuse_cleanup_credential(&cred);
 
-   return 0;
+   fuse_reply_err(req, ret < 0 ? pvfs_fuse_errno(ret) : 0);
 }
 
-static int pvfs_fuse_truncate(const char *path, off_t size)
+static void pvfs_fuse_symlink(fuse_req_t req, const char *link,
+							  fuse_ino_t parent, const char *name)
 {
+   PVFS_credential	cred;
+   PVFS_sys_attr	attr;
+   PVFS_sysresp_symlink resp_sym;
+   struct fuse_entry_param e;
    int			ret;
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   ret = PVFS_sys_truncate(pfh.ref,size,&pfh.cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   pvfs_fuse_init_attr(&attr, &cred, 0777);
+   memset(&resp_sym, 0, sizeof(resp_sym));
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   ret = PVFS_sys_symlink((char *)name,
+						  pvfs_fuse_inode(parent)->ref,
+						  (char *)link,
+						  attr,
+						  &cred,
+						  &resp_sym,
+						  PVFS_HINT_NULL);
+   if (ret == 0)
+	  ret = pvfs_fuse_fill_entry(resp_sym.ref, &cred, &e);
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_entry(req, &e);
 }
 
-static int pvfs_fuse_utime(const char *path, struct utimbuf *timbuf)
+static void pvfs_fuse_rename(fuse_req_t req, fuse_ino_t parent,
+							 const char *name, fuse_ino_t newparent,
+							 const char *newname, unsigned int flags)
 {
+   PVFS_credential	cred;
    int			ret;
-   PVFS_sys_attr	new_attr;
- 
-   pvfs_fuse_handle_t	pfh;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-   
-   new_attr.atime = (PVFS_time)timbuf->actime;
-   new_attr.mtime = (PVFS_time)timbuf->modtime;
-   new_attr.mask = PVFS_ATTR_SYS_ATIME | PVFS_ATTR_SYS_MTIME;
- 
-   ret = PVFS_sys_setattr(pfh.ref,new_attr,&pfh.cred);
+   /* RENAME_EXCHANGE and RENAME_NOREPLACE cannot be done atomically */
+   if (flags)
+   {
+	  fuse_reply_err(req, EINVAL);
+	  return;
+   }
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
 
-   if (ret < 0) 
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   ret = PVFS_sys_rename((char *)name,
+						 pvfs_fuse_inode(parent)->ref,
+						 (char *)newname,
+						 pvfs_fuse_inode(newparent)->ref,
+						 &cred,
+						 PVFS_HINT_NULL);
 
-   return 0;
+   pvfs_fuse_cleanup_credential(&cred);
+
+   fuse_reply_err(req, ret < 0 ? pvfs_fuse_errno(ret) : 0);
 }
 
-static int pvfs_fuse_open(const char *path, struct fuse_file_info *fi)
+static pvfs_fuse_handle_t *pvfs_fuse_handle_alloc(fuse_req_t req,
+												  PVFS_object_ref ref,
+												  int *err)
 {
    pvfs_fuse_handle_t *pfhp;
    int			ret;
@@ -684,430 +832,687 @@ static int pvfs_fuse_open(const char *path, struct fuse_file_info *fi)
    pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
    if (pfhp == NULL)
    {
-	  return -ENOMEM;
+	  *err = ENOMEM;
+	  return NULL;
    }
 
-   ret = lookup( path, pfhp, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 ) {
-      free( pfhp );
-      return PVFS_ERROR_TO_ERRNO_N( ret );
+   ret = pvfs_fuse_gen_credential(req, &pfhp->cred);
+   if (ret < 0)
+   {
+	  free(pfhp);
+	  *err = pvfs_fuse_errno(ret);
+	  return NULL;
    }
+   pfhp->ref = ref;
 
-   SET_FUSE_HANDLE( fi, pfhp );
-
-   return 0;
+   return pfhp;
 }
 
-static int pvfs_fuse_read(const char *path, char *buf, size_t size, off_t offset,
-						  struct fuse_file_info *fi)
+static void pvfs_fuse_open(fuse_req_t req, fuse_ino_t ino,
+						   struct fuse_file_info *fi)
 {
-   PVFS_Request	mem_req, file_req;
-   PVFS_sysresp_io	resp_io;
-   int			ret;
-   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
-   ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
+   pvfs_fuse_handle_t *pfhp;
+   int			err;
+
+   pfhp = pvfs_fuse_handle_alloc(req, pvfs_fuse_inode(ino)->ref, &err);
+   if (!pfhp)
+   {
+	  fuse_reply_err(req, err);
+	  return;
+   }
+
+   SET_FUSE_HANDLE( fi, pfhp );
+   /* other clients may change the file at any time */
+   fi->direct_io = 1;
+
+   fuse_reply_open(req, fi);
+}
+
+static void pvfs_fuse_create(fuse_req_t req, fuse_ino_t parent,
+							 const char *name, mode_t mode,
+							 struct fuse_file_info *fi)
+{
+   PVFS_credential	cred;
+   PVFS_sys_attr	attr;
+   PVFS_sysresp_create resp_create;
+   struct fuse_entry_param e;
+   pvfs_fuse_handle_t *pfhp;
+   int			ret, err;
+
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
+
+   pvfs_fuse_init_attr(&attr, &cred, mode);
+
+   ret = PVFS_sys_create((char *)name,
+						 pvfs_fuse_inode(parent)->ref,
+						 attr,
+						 &cred,
+						 NULL,
+						 &resp_create,
+						 PVFS_SYS_LAYOUT_DEFAULT,
+						 PVFS_HINT_NULL);
+   if (ret == 0)
+	  ret = pvfs_fuse_fill_entry(resp_create.ref, &cred, &e);
+
+   pvfs_fuse_cleanup_credential(&cred);
+
    if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   {
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+	  return;
+   }
+
+   pfhp = pvfs_fuse_handle_alloc(req, resp_create.ref, &err);
+   if (!pfhp)
+   {
+	  pvfs_fuse_inode_put(e.ino, 1);
+	  fuse_reply_err(req, err);
+	  return;
+   }
+
+   SET_FUSE_HANDLE( fi, pfhp );
+   fi->direct_io = 1;
+
+   fuse_reply_create(req, &e, fi);
+}
 
-   ret = PVFS_sys_read(pfh->ref, file_req, offset, buf,
-					   mem_req, &pfh->cred, &resp_io);
+static void pvfs_fuse_mknod(fuse_req_t req, fuse_ino_t parent,
+							const char *name, mode_t mode, dev_t rdev)
+{
+   PVFS_credential	cred;
+   PVFS_sys_attr	attr;
+   PVFS_sysresp_create resp_create;
+   struct fuse_entry_param e;
+   int			ret;
 
-   if (ret == 0) 
+   /* PVFS has no device, fifo or socket objects */
+   if (!S_ISREG(mode))
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+	  fuse_reply_err(req, EPERM);
+	  return;
    }
+
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
+
+   pvfs_fuse_init_attr(&attr, &cred, mode);
+
+   ret = PVFS_sys_create((char *)name,
+						 pvfs_fuse_inode(parent)->ref,
+						 attr,
+						 &cred,
+						 NULL,
+						 &resp_create,
+						 PVFS_SYS_LAYOUT_DEFAULT,
+						 PVFS_HINT_NULL);
+   if (ret == 0)
+	  ret = pvfs_fuse_fill_entry(resp_create.ref, &cred, &e);
+
+   pvfs_fuse_cleanup_credential(&cred);
+
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
    else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+	  fuse_reply_entry(req, &e);
 }
 
-static int pvfs_fuse_write(const char *path, const char *buf, size_t size,
-						   off_t offset, struct fuse_file_info *fi)
+static int pvfs_fuse_io(pvfs_fuse_handle_t *pfh, enum PVFS_io_type io_type,
+						char *buf, size_t size, off_t offset)
 {
-   PVFS_Request	mem_req, file_req;
+   PVFS_Request	mem_req;
    PVFS_sysresp_io	resp_io;
    int			ret;
-   pvfs_fuse_handle_t	*pfh = GET_FUSE_HANDLE( fi );
-  
-   file_req = PVFS_BYTE;
+
    ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
    if (ret < 0)
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+	  return ret;
+
+   ret = PVFS_sys_io(pfh->ref, PVFS_BYTE, offset, buf, mem_req,
+					 &pfh->cred, &resp_io, io_type, PVFS_HINT_NULL);
+
+   PVFS_Request_free(&mem_req);
+
+   if (ret < 0)
+	  return ret;
+   return resp_io.total_completed;
+}
+
+static void pvfs_fuse_read(fuse_req_t req, fuse_ino_t ino, size_t size,
+						   off_t offset, struct fuse_file_info *fi)
+{
+   char			*buf;
+   int			ret;
+
+   buf = (char *)malloc(size ? size : 1);
+   if (!buf)
+   {
+	  fuse_reply_err(req, ENOMEM);
+	  return;
+   }
+
+   ret = pvfs_fuse_io(GET_FUSE_HANDLE( fi ), PVFS_IO_READ, buf, size, offset);
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_buf(req, buf, ret);
+
+   free(buf);
+}
 
-   ret = PVFS_sys_write(pfh->ref, file_req, offset, (char*)buf,
-						mem_req, &pfh->cred, &resp_io);
-   if (ret == 0) 
+/* pvfs_fuse_write_buf()
+ *
+ * Writes arrive here rather than through a plain write method so that,
+ * when the kernel splices them into a pipe, the payload is copied once,
+ * straight into the buffer handed to PVFS_sys_io().  Payloads already
+ * in memory are written in place.
+ */
+static void pvfs_fuse_write_buf(fuse_req_t req, fuse_ino_t ino,
+								struct fuse_bufvec *in_buf, off_t offset,
+								struct fuse_file_info *fi)
+{
+   size_t		size = fuse_buf_size(in_buf);
+   struct fuse_bufvec	mem_buf = FUSE_BUFVEC_INIT(size);
+   char			*buf = NULL;
+   char			*data;
+   ssize_t		copied;
+   int			ret;
+
+   if (in_buf->count == 1 && in_buf->idx == 0 &&
+	   !(in_buf->buf[0].flags & FUSE_BUF_IS_FD))
+   {
+	  data = (char *)in_buf->buf[0].mem + in_buf->off;
+   }
+   else
    {
-	  PVFS_Request_free(&mem_req);
-	  return(resp_io.total_completed);
+	  buf = (char *)malloc(size ? size : 1);
+	  if (!buf)
+	  {
+		 fuse_reply_err(req, ENOMEM);
+		 return;
+	  }
+	  mem_buf.buf[0].mem = buf;
+	  copied = fuse_buf_copy(&mem_buf, in_buf, 0);
+	  if (copied < 0)
+	  {
+		 free(buf);
+		 fuse_reply_err(req, -copied);
+		 return;
+	  }
+	  size = copied;
+	  data = buf;
    }
+
+   ret = pvfs_fuse_io(GET_FUSE_HANDLE( fi ), PVFS_IO_WRITE, data, size, offset);
+   if (ret < 0)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
    else
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+	  fuse_reply_write(req, ret);
+
+   free(buf);
 }
 
-static int pvfs_fuse_statfs(const char *path, struct statvfs *stbuf)
+static void pvfs_fuse_statfs(fuse_req_t req, fuse_ino_t ino)
 {
    int			ret;
    PVFS_credential	cred;
    PVFS_sysresp_statfs resp_statfs;
+   struct statvfs	stbuf;
 
-   ret = pvfs_fuse_gen_credential(&cred);
+   ret = pvfs_fuse_gen_credential(req, &cred);
    if (ret < 0)
    {
-       return PVFS_ERROR_TO_ERRNO_N(ret);
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
    }
 
    /* gather normal statfs statistics from system interface */
 
-   ret = PVFS_sys_statfs(pvfs2fuse.fs_id, &cred, &resp_statfs);
+   ret = PVFS_sys_statfs(pvfs2fuse.fs_id, &cred, &resp_statfs,
+						 PVFS_HINT_NULL);
 
    pvfs_fuse_cleanup_credential(&cred);
 
    if (ret < 0)
    {
-	  if(ret != ERANGE)
-		 return PVFS_ERROR_TO_ERRNO_N( ret );
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+	  return;
    }
 
-   memcpy(&stbuf->f_fsid, &resp_statfs.statfs_buf.fs_id, 
+   memset(&stbuf, 0, sizeof(stbuf));
+   memcpy(&stbuf.f_fsid, &resp_statfs.statfs_buf.fs_id,
 		  sizeof(resp_statfs.statfs_buf.fs_id));
    /* FIXME is this bsize right? */
 
-   stbuf->f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
-   stbuf->f_namemax = PVFS_NAME_MAX;
+   stbuf.f_bsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_frsize = PVFS2_BUFMAP_DEFAULT_DESC_SIZE;
+   stbuf.f_namemax = PVFS_NAME_MAX;
 
-   stbuf->f_blocks = resp_statfs.statfs_buf.bytes_total / stbuf->f_bsize;
-   stbuf->f_bfree = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_bavail = resp_statfs.statfs_buf.bytes_available / stbuf->f_bsize;
-   stbuf->f_files = resp_statfs.statfs_buf.handles_total_count;
-   stbuf->f_ffree = resp_statfs.statfs_buf.handles_available_count;
-   stbuf->f_favail = resp_statfs.statfs_buf.handles_available_count;
+   stbuf.f_blocks = resp_statfs.statfs_buf.bytes_total / stbuf.f_bsize;
+   stbuf.f_bfree = resp_statfs.statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_bavail = resp_statfs.statfs_buf.bytes_available / stbuf.f_bsize;
+   stbuf.f_files = resp_statfs.statfs_buf.handles_total_count;
+   stbuf.f_ffree = resp_statfs.statfs_buf.handles_available_count;
+   stbuf.f_favail = resp_statfs.statfs_buf.handles_available_count;
 
-   stbuf->f_flag = 0;
+   stbuf.f_flag = 0;
 
-   return 0;
+   fuse_reply_statfs(req, &stbuf);
 }
 
-static int pvfs_fuse_release(const char *path, struct fuse_file_info *fi)
+static void pvfs_fuse_release(fuse_req_t req, fuse_ino_t ino,
+							  struct fuse_file_info *fi)
 {
    pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
-  
+
    if ( pfh != NULL ) {
       pvfs_fuse_cleanup_credential(&pfh->cred);
       free( pfh );
       SET_FUSE_HANDLE( fi, NULL );
    }
 
-   return 0;
+   fuse_reply_err(req, 0);
 }
 
-static int pvfs_fuse_fsync(const char *path, int isdatasync,
-						   struct fuse_file_info *fi)
+static void pvfs_fuse_fsync(fuse_req_t req, fuse_ino_t ino, int datasync,
+							struct fuse_file_info *fi)
+{
+   pvfs_fuse_handle_t *pfh = GET_FUSE_HANDLE( fi );
+   int			ret;
+
+   ret = PVFS_sys_flush(pfh->ref, &pfh->cred, PVFS_HINT_NULL);
+
+   fuse_reply_err(req, ret < 0 ? pvfs_fuse_errno(ret) : 0);
+}
+
+/*
+ * directories
+ */
+
+static void pvfs_fuse_dir_release_batch(pvfs_fuse_dir_t *dir)
+{
+   uint32_t i;
+
+   if (dir->batch.attr_array)
+   {
+	  for (i = 0; i < dir->batch.pvfs_dirent_outcount; i++)
+		 PVFS_util_release_sys_attr(&dir->batch.attr_array[i]);
+   }
+   free(dir->batch.dirent_array);
+   free(dir->batch.stat_err_array);
+   free(dir->batch.attr_array);
+   dir->batch_start += dir->batch.pvfs_dirent_outcount;
+   memset(&dir->batch, 0, sizeof(dir->batch));
+}
+
+static void pvfs_fuse_dir_rewind(pvfs_fuse_dir_t *dir)
+{
+   pvfs_fuse_dir_release_batch(dir);
+   dir->token = PVFS_READDIR_START;
+   dir->batch_start = 2;
+   dir->eof = 0;
+}
+
+/* pvfs_fuse_dir_fetch()
+ *
+ * replaces the current batch with the next one; plus asks for the
+ * attributes of every entry in the same round trip
+ */
+static int pvfs_fuse_dir_fetch(pvfs_fuse_dir_t *dir, int plus)
 {
-   /* Just a stub.  This method is optional and can safely be left
-	  unimplemented */
+   PVFS_sysresp_readdir rd_response;
+   int ret;
+
+   pvfs_fuse_dir_release_batch(dir);
+   if (dir->eof)
+	  return 0;
+
+   if (plus)
+   {
+	  ret = PVFS_sys_readdirplus(dir->ref, dir->token,
+								 pvfs2fuse.dirent_count, &dir->cred,
+								 PVFS_ATTR_SYS_ALL_NOHINT,
+								 &dir->batch, PVFS_HINT_NULL);
+	  if (ret < 0)
+		 return ret;
+   }
+   else
+   {
+	  memset(&rd_response, 0, sizeof(rd_response));
+	  ret = PVFS_sys_readdir(dir->ref, dir->token,
+							 pvfs2fuse.dirent_count, &dir->cred,
+							 &rd_response, PVFS_HINT_NULL);
+	  if (ret < 0)
+		 return ret;
+	  dir->batch.token = rd_response.token;
+	  dir->batch.dirent_array = rd_response.dirent_array;
+	  dir->batch.pvfs_dirent_outcount = rd_response.pvfs_dirent_outcount;
+	  dir->batch.directory_version = rd_response.directory_version;
+   }
 
-   (void) path;
-   (void) isdatasync;
-   (void) fi;
+   dir->token = dir->batch.token;
+   if (dir->token == PVFS_READDIR_END)
+	  dir->eof = 1;
 
    return 0;
 }
 
-#define MAX_NUM_DIRENTS    32
+/* pvfs_fuse_dir_seek()
+ *
+ * makes the current batch hold offset off, unless the directory ends
+ * first; a seek backwards, or a plus read over a batch fetched without
+ * attributes, reads the directory again from the start
+ */
+static int pvfs_fuse_dir_seek(pvfs_fuse_dir_t *dir, off_t off, int plus)
+{
+   int ret;
+
+   if (off < dir->batch_start ||
+	   (plus && dir->batch.pvfs_dirent_outcount && !dir->batch.attr_array))
+   {
+	  pvfs_fuse_dir_rewind(dir);
+   }
+
+   while (off >= dir->batch_start + dir->batch.pvfs_dirent_outcount)
+   {
+	  if (dir->eof)
+		 return 0;
+	  ret = pvfs_fuse_dir_fetch(dir, plus);
+	  if (ret < 0)
+		 return ret;
+   }
+
+   return 0;
+}
 
-static int pvfs_fuse_readdir(const char *path, void *buf, fuse_fill_dir_t filler,
-							 off_t offset, struct fuse_file_info *fi)
+static void pvfs_fuse_opendir(fuse_req_t req, fuse_ino_t ino,
+							  struct fuse_file_info *fi)
 {
+   pvfs_fuse_dir_t	*dir;
    int			ret;
-   PVFS_ds_position	token;
-   pvfs_fuse_handle_t	pfh;
-   int			pvfs_dirent_incount;
-   PVFS_sysresp_readdir rd_response;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   dir = (pvfs_fuse_dir_t *)calloc(1, sizeof(pvfs_fuse_dir_t));
+   if (!dir)
+   {
+	  fuse_reply_err(req, ENOMEM);
+	  return;
+   }
 
-   pvfs_dirent_incount = MAX_NUM_DIRENTS;
-   token = 0;
-   do
+   ret = pvfs_fuse_gen_credential(req, &dir->cred);
+   if (ret < 0)
    {
-	  char *cur_file = NULL;
-	  int i;
+	  free(dir);
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
+   dir->ref = pvfs_fuse_inode(ino)->ref;
+   pvfs_fuse_dir_rewind(dir);
 
-	  memset(&rd_response, 0, sizeof(PVFS_sysresp_readdir));
-	  ret = PVFS_sys_readdir(
-		 pfh.ref, (!token ? PVFS_READDIR_START : token),
-		 pvfs_dirent_incount, &pfh.cred, &rd_response);
-	  if(ret < 0)
-      {
-         pvfs_fuse_cleanup_credential(&pfh.cred);
-         return PVFS_ERROR_TO_ERRNO_N( ret );
-      }
+   SET_FUSE_HANDLE( fi, dir );
+   fuse_reply_open(req, fi);
+}
 
-	  for(i = 0; i < rd_response.pvfs_dirent_outcount; i++)
-	  {
-		 cur_file = rd_response.dirent_array[i].d_name;
+static void pvfs_fuse_do_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+								 off_t off, struct fuse_file_info *fi,
+								 int plus)
+{
+   pvfs_fuse_dir_t	*dir = GET_FUSE_DIR( fi );
+   struct fuse_entry_param e;
+   const char		*name;
+   char			*buf, *p;
+   size_t		rem, entsize;
+   uint32_t		i;
+   int			ret = 0;
+
+   buf = (char *)malloc(size);
+   if (!buf)
+   {
+	  fuse_reply_err(req, ENOMEM);
+	  return;
+   }
+   p = buf;
+   rem = size;
 
-		 if (filler(buf, cur_file, NULL, 0))
+   for (;;)
+   {
+	  memset(&e, 0, sizeof(e));
+	  if (off < 2)
+	  {
+		 name = off ? ".." : ".";
+		 e.attr.st_ino = off ? 0 : dir->ref.handle;
+		 e.attr.st_mode = S_IFDIR;
+	  }
+	  else
+	  {
+		 ret = pvfs_fuse_dir_seek(dir, off, plus);
+		 if (ret < 0)
+			break;
+		 i = off - dir->batch_start;
+		 if (i >= dir->batch.pvfs_dirent_outcount)
 			break;
+
+		 name = dir->batch.dirent_array[i].d_name;
+		 e.attr.st_ino = dir->batch.dirent_array[i].handle;
+		 if (plus && dir->batch.attr_array && !dir->batch.stat_err_array[i])
+		 {
+			PVFS_object_ref ref;
+
+			ref.handle = dir->batch.dirent_array[i].handle;
+			ref.fs_id = dir->ref.fs_id;
+			pvfs_fuse_attr_to_stat(ref, &dir->batch.attr_array[i], &e.attr);
+			e.ino = pvfs_fuse_inode_get(ref);
+			e.attr_timeout = pvfs2fuse.attr_timeout;
+			e.entry_timeout = pvfs2fuse.entry_timeout;
+		 }
 	  }
-	  token = rd_response.token;
 
-	  if (rd_response.pvfs_dirent_outcount)
+	  if (plus)
+		 entsize = fuse_add_direntry_plus(req, p, rem, name, &e, off + 1);
+	  else
+		 entsize = fuse_add_direntry(req, p, rem, name, &e.attr, off + 1);
+	  if (entsize > rem)
 	  {
-		 free(rd_response.dirent_array);
-		 rd_response.dirent_array = NULL;
+		 /* the kernel never sees this entry, so drop its reference */
+		 pvfs_fuse_inode_put(e.ino, 1);
+		 break;
 	  }
+	  p += entsize;
+	  rem -= entsize;
+	  off++;
+   }
+
+   if (ret < 0 && p == buf)
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+   else
+	  fuse_reply_buf(req, buf, p - buf);
 
-   } while(token != PVFS_READDIR_END);
+   free(buf);
+}
 
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+static void pvfs_fuse_readdir(fuse_req_t req, fuse_ino_t ino, size_t size,
+							  off_t off, struct fuse_file_info *fi)
+{
+   pvfs_fuse_do_readdir(req, ino, size, off, fi, 0);
+}
 
-   return 0;
+static void pvfs_fuse_readdirplus(fuse_req_t req, fuse_ino_t ino, size_t size,
+								  off_t off, struct fuse_file_info *fi)
+{
+   pvfs_fuse_do_readdir(req, ino, size, off, fi, 1);
 }
 
-static int pvfs_fuse_access(const char *path, int mask)
+static void pvfs_fuse_releasedir(fuse_req_t req, fuse_ino_t ino,
+								 struct fuse_file_info *fi)
+{
+   pvfs_fuse_dir_t	*dir = GET_FUSE_DIR( fi );
+
+   pvfs_fuse_dir_release_batch(dir);
+   pvfs_fuse_cleanup_credential(&dir->cred);
+   free(dir);
+
+   fuse_reply_err(req, 0);
+}
+
+static void pvfs_fuse_access(fuse_req_t req, fuse_ino_t ino, int mask)
 {
    PVFS_sysresp_getattr getattr_response;
    PVFS_sys_attr*	attrs;
+   PVFS_credential	cred;
    int			ret;
-   pvfs_fuse_handle_t	pfh;
    int			in_group_flag = 0;
+   int			allowed = 0;
    PVFS_uid     uid;
    PVFS_gid     gid;
 
-   ret = lookup( path, &pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( ret < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
-
-   /* give root permission, no matter what */
-   if ( pfh.cred.userid == 0 )
-	  return 0;
+   ret = pvfs_fuse_gen_credential(req, &cred);
+   if (ret < 0)
+   {
+      fuse_reply_err(req, pvfs_fuse_errno(ret));
+      return;
+   }
 
-   /* if checking for file existence, return 0 */
-   if ( mask == F_OK )
-	  return 0;
+   /* give root permission, no matter what; and if checking for file
+    * existence, the inode already proves it */
+   if ( cred.userid == 0 || mask == F_OK )
+   {
+	  pvfs_fuse_cleanup_credential(&cred);
+	  fuse_reply_err(req, 0);
+	  return;
+   }
 
-   ret = PVFS_sys_getattr(pfh.ref, 
+   memset(&getattr_response, 0, sizeof(getattr_response));
+   ret = PVFS_sys_getattr(pvfs_fuse_inode(ino)->ref,
                           PVFS_ATTR_SYS_ALL_NOHINT,
-                          (PVFS_credential *) &pfh.cred, 
-                          &getattr_response);
+                          &cred,
+                          &getattr_response,
+                          PVFS_HINT_NULL);
 
    /* copy uid and gid so credential can be freed */
-   uid = pfh.cred.userid;
-   gid = pfh.cred.group_array[0];
-   pvfs_fuse_cleanup_credential(&pfh.cred);
+   uid = cred.userid;
+   gid = cred.group_array[0];
+   pvfs_fuse_cleanup_credential(&cred);
 
    if ( ret < 0 )
-   {            
-	  return PVFS_ERROR_TO_ERRNO_N( ret );
+   {
+	  fuse_reply_err(req, pvfs_fuse_errno(ret));
+	  return;
    }
 
    attrs = &getattr_response.attr;
 
    /* basic code is copied from PINT_check_mode() */
 
+   /* see if gid matches object group
+      TODO: check all groups */
+   if(attrs->group == gid)
+   {
+	  /* default group match */
+	  in_group_flag = 1;
+   }
+
    /* see if uid matches object owner */
    if ( attrs->owner == uid )
    {
 	  /* see if object user permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_U_READ))
-	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_U_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_U_EXECUTE))
+	  if( ((mask & R_OK) && (attrs->perms & PVFS_U_READ)) ||
+		  ((mask & W_OK) && (attrs->perms & PVFS_U_WRITE)) ||
+		  ((mask & X_OK) && (attrs->perms & PVFS_U_EXECUTE)))
 	  {
-		 return(0);
+		 allowed = 1;
 	  }
    }
 
    /* see if other bits allow access */
-   if( (mask & R_OK) && (attrs->perms & PVFS_O_READ))
+   if( ((mask & R_OK) && (attrs->perms & PVFS_O_READ)) ||
+	   ((mask & W_OK) && (attrs->perms & PVFS_O_WRITE)) ||
+	   ((mask & X_OK) && (attrs->perms & PVFS_O_EXECUTE)))
    {
-	  return(0);
-   }
-   if( (mask & W_OK) && (attrs->perms & PVFS_O_WRITE))
-   {
-	  return(0);
-   }
-   if( (mask & X_OK) && (attrs->perms & PVFS_O_EXECUTE))
-   {
-	  return(0);
-   }
-
-   /* see if gid matches object group 
-      TODO: check all groups */
-   if(attrs->group == gid)
-   {
-	  /* default group match */
-	  in_group_flag = 1;
-   }
-   else
-   {
-#if 0
-	  /* no default group match, check supplementary groups */
-	  ret = PINT_check_group(uid, attrs->group);
-	  if(ret == 0)
-	  {
-		 in_group_flag = 1;
-	  }
-	  else
-	  {
-		 if(ret != -PVFS_ENOENT)
-		 {
-			/* system error; not just failed match */
-			return(ret);
-		 }
-	  }
-#endif
+	  allowed = 1;
    }
 
    if(in_group_flag)
    {
 	  /* see if object group permissions match access type */
-	  if( (mask & R_OK) && (attrs->perms & PVFS_G_READ))
+	  if( ((mask & R_OK) && (attrs->perms & PVFS_G_READ)) ||
+		  ((mask & W_OK) && (attrs->perms & PVFS_G_WRITE)) ||
+		  ((mask & X_OK) && (attrs->perms & PVFS_G_EXECUTE)))
 	  {
-		 return(0);
-	  }
-	  if( (mask & W_OK) && (attrs->perms & PVFS_G_WRITE))
-	  {
-		 return(0);
-	  }
-	  if( (mask & X_OK) && (attrs->perms & PVFS_G_EXECUTE))
-	  {
-		 return(0);
+		 allowed = 1;
 	  }
    }
-  
+
+   PVFS_util_release_sys_attr(attrs);
+
    /* default case: access denied */
-   return -EACCES;
+   fuse_reply_err(req, allowed ? 0 : EACCES);
 }
 
-static int pvfs_fuse_create(const char *path, mode_t mode,
-							struct fuse_file_info *fi)
+static void pvfs_fuse_init(void *userdata, struct fuse_conn_info *conn)
 {
-   int rc;
-   int num_segs;
-   PVFS_sys_attr attr;
-   char directory[PVFS_NAME_MAX];
-   char filename[PVFS_SEGMENT_MAX];
-   pvfs_fuse_handle_t	dir_pfh, *pfhp;
-
-   PVFS_sysresp_create resp_create;
-
-   /* Translate path into pvfs2 relative path */
-   rc = PINT_get_base_dir((char *)path, directory, PVFS_NAME_MAX);
-   num_segs = PINT_string_count_segments((char *)path);
-   rc = PINT_get_path_element((char *)path, num_segs - 1,
-							  filename, PVFS_SEGMENT_MAX);
-
-   if (rc)
-   {
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
-
-   rc = lookup( directory, &dir_pfh, PVFS2_LOOKUP_LINK_FOLLOW );
-   if ( rc < 0 )
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-
-   /* Set attributes */
-   memset(&attr, 0, sizeof(PVFS_sys_attr));
-   attr.owner = dir_pfh.cred.userid;
-   attr.group = dir_pfh.cred.group_array[0];
-   attr.perms = mode;
-   attr.atime = time(NULL);
-   attr.mtime = attr.atime;
-   attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
-   attr.dfile_count = 0;
-
-   rc = PVFS_sys_create(filename,
-						dir_pfh.ref,
-						attr,
-						&dir_pfh.cred,
-						NULL,
-						&resp_create);
-   if (rc)
-   {
-      /* FIXME
-       * the PVFS2 server code returns a ENOENT instead of an EACCES
-       * because it does a ACL lookup for the system.posix_acl_access
-       * which returns a ENOENT from the TROVE DBPF and that error is
-       * just passed up in prelude_check_acls (server/prelude.c).  I'm
-       * not sure that's the right thing to do.
-       */
-	  if ( rc == -PVFS_ENOENT ) 
-	  {
-		 return -EACCES;
-	  }
-	  return PVFS_ERROR_TO_ERRNO_N( rc );
-   }
-
-   pfhp = (pvfs_fuse_handle_t *)malloc( sizeof( pvfs_fuse_handle_t ) );
-   if (pfhp == NULL)
-   {
-	  return -ENOMEM;
-   }
-
-   pfhp->ref = resp_create.ref;
-   pfhp->cred = dir_pfh.cred;
-
-   SET_FUSE_HANDLE( fi, pfhp );
-
-   return 0;
+   /* large writes are passed to PVFS_sys_io() whole */
+   conn->max_write = pvfs2fuse.max_write;
+   conn->max_readahead = pvfs2fuse.max_write;
+
+   if (conn->capable & FUSE_CAP_SPLICE_READ)
+	  conn->want |= FUSE_CAP_SPLICE_READ;
+   if (conn->capable & FUSE_CAP_SPLICE_MOVE)
+	  conn->want |= FUSE_CAP_SPLICE_MOVE;
+
+   /* every listing comes with attributes; without this the kernel
+    * alternates between readdir and readdirplus on its own */
+   if (conn->capable & FUSE_CAP_READDIRPLUS)
+	  conn->want |= FUSE_CAP_READDIRPLUS;
+   conn->want &= ~FUSE_CAP_READDIRPLUS_AUTO;
 }
 
-static struct fuse_operations pvfs_fuse_oper = {
+static struct fuse_lowlevel_ops pvfs_fuse_oper = {
+   .init	= pvfs_fuse_init,
+   .lookup	= pvfs_fuse_lookup,
+   .forget	= pvfs_fuse_forget,
+   .forget_multi = pvfs_fuse_forget_multi,
    .getattr	= pvfs_fuse_getattr,
-   .fgetattr	= pvfs_fuse_fgetattr,
+   .setattr	= pvfs_fuse_setattr,
    .readlink	= pvfs_fuse_readlink,
+   .mknod	= pvfs_fuse_mknod,
    .mkdir	= pvfs_fuse_mkdir,
-   .unlink	= pvfs_fuse_unlink,
-   .rmdir	= pvfs_fuse_rmdir,
+   .unlink	= pvfs_fuse_remove,
+   .rmdir	= pvfs_fuse_remove,
    .symlink	= pvfs_fuse_symlink,
    .rename	= pvfs_fuse_rename,
    /* .link	= pvfs_fuse_link, */ /* hard links not supported on PVFS */
-   .chmod	= pvfs_fuse_chmod,
-   .chown	= pvfs_fuse_chown,
-   .truncate	= pvfs_fuse_truncate,
-   .utime	= pvfs_fuse_utime,
    .open	= pvfs_fuse_open,
    .read	= pvfs_fuse_read,
-   .write	= pvfs_fuse_write,
+   .write_buf	= pvfs_fuse_write_buf,
    .statfs	= pvfs_fuse_statfs,
-/*  .flush	= pvfs_fuse_flush, */
    .release	= pvfs_fuse_release,
    .fsync	= pvfs_fuse_fsync,
+   .opendir	= pvfs_fuse_opendir,
    .readdir	= pvfs_fuse_readdir,
+   .readdirplus	= pvfs_fuse_readdirplus,
+   .releasedir	= pvfs_fuse_releasedir,
    .access	= pvfs_fuse_access,
    .create	= pvfs_fuse_create,
 };
 
-enum {
-   KEY_HELP,
-   KEY_VERSION,
-};
-
 #ifndef offsetof
 #define offsetof(TYPE, MEMBER) ((size_t) &((TYPE *)0)->MEMBER)
 #endif
 #define PVFS2FUSE_OPT(t, p, v) { t, offsetof(struct pvfs2fuse, p), v }
 
 static struct fuse_opt pvfs2fuse_opts[] = {
-   PVFS2FUSE_OPT("fs_spec=%s",     fs_spec, 0),
-
-   FUSE_OPT_KEY("-V",             KEY_VERSION),
-   FUSE_OPT_KEY("--version",      KEY_VERSION),
-   FUSE_OPT_KEY("-h",             KEY_HELP),
-   FUSE_OPT_KEY("--help",         KEY_HELP),
+   PVFS2FUSE_OPT("fs_spec=%s",          fs_spec, 0),
+   PVFS2FUSE_OPT("acache_timeout=%d",   acache_timeout, 0),
+   PVFS2FUSE_OPT("ncache_timeout=%d",   ncache_timeout, 0),
+   PVFS2FUSE_OPT("max_write=%u",        max_write, 0),
+   PVFS2FUSE_OPT("dirent_count=%u",     dirent_count, 0),
    FUSE_OPT_END
 };
 
@@ -1123,71 +1528,197 @@ static void usage(const char *progname)
 		   "\n"
 		   "PVFS2FUSE options:\n"
 		   "    -o fs_spec=FS_SPEC     PVFS2 fs_spec URI (eg. tcp://localhost:3334/pvfs2-fs)\n"
-		   "\n", progname);
+		   "    -o acache_timeout=MS   attribute cache timeout, also used for\n"
+		   "                           the kernel attribute timeout\n"
+		   "    -o ncache_timeout=MS   name cache timeout, also used for\n"
+		   "                           the kernel entry timeout\n"
+		   "    -o max_write=N         largest single write (default %d)\n"
+		   "    -o dirent_count=N      entries per readdir request (default %d)\n"
+		   "\n", progname, PVFS_FUSE_DEFAULT_MAX_WRITE,
+		   PVFS_FUSE_DEFAULT_DIRENT_COUNT);
 }
 
-static int pvfs_fuse_main(struct fuse_args *args)
+/* pvfs_fuse_set_timeouts()
+ *
+ * applies any cache timeouts given on the command line and mirrors the
+ * resulting values into the timeouts handed to the kernel
+ */
+static void pvfs_fuse_set_timeouts(void)
 {
-#if FUSE_VERSION >= 26
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper, NULL);
-#else
-   return fuse_main(args->argc, args->argv, &pvfs_fuse_oper);
-#endif
+   unsigned int msecs;
+
+   if (pvfs2fuse.acache_timeout >= 0)
+	  PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS,
+						pvfs2fuse.acache_timeout);
+   if (pvfs2fuse.ncache_timeout >= 0)
+	  PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS,
+						pvfs2fuse.ncache_timeout);
+
+   msecs = 0;
+   PVFS_sys_get_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, &msecs);
+   pvfs2fuse.attr_timeout = msecs / 1000.0;
+   msecs = 0;
+   PVFS_sys_get_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, &msecs);
+   pvfs2fuse.entry_timeout = msecs / 1000.0;
 }
 
-static int pvfs2fuse_opt_proc(void *data, const char *arg, int key,
-							  struct fuse_args *outargs)
+static int pvfs_fuse_add_mntent(void)
 {
-   (void) data;
+   struct PVFS_sys_mntent *me = &pvfs2fuse.mntent;
+   char *cp;
+   int cur_server;
+   int ret;
 
-   switch (key) {
-	  case FUSE_OPT_KEY_OPT:
-		 return 1;
+   /* the following is copied from PVFS_util_init_defaults()
+	  in fuse/lib/pvfs2-util.c */
 
-	  case FUSE_OPT_KEY_NONOPT:
-		 if (!pvfs2fuse.mntpoint) {
-                     if(!arg)
-                     {
-                         fprintf(stderr, "PVFS2FUSE requires mountpoint as argument\n");
-                         abort();
-                     }
+   /* initialize pvfs system interface */
+   ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
+   if (ret < 0)
+   {
+	  return(ret);
+   }
 
-            pvfs2fuse.mntpoint = strdup(arg);
+   /* the following is copied from PVFS_util_parse_pvfstab()
+	  in fuse/lib/pvfs2-util.c */
+   memset( me, 0, sizeof(pvfs2fuse.mntent) );
+
+   /* Enable integrity checks by default */
+   me->integrity_check = 1;
+   /* comma-separated list of ways to contact a config server */
+   me->num_pvfs_config_servers = 1;
+
+   for (cp=pvfs2fuse.fs_spec; *cp; cp++)
+	  if (*cp == ',')
+		 ++me->num_pvfs_config_servers;
+
+   /* allocate room for our copies of the strings */
+   me->pvfs_config_servers =
+	  malloc(me->num_pvfs_config_servers *
+			 sizeof(*me->pvfs_config_servers));
+   if (!me->pvfs_config_servers)
+	  exit(-1);
+   memset(me->pvfs_config_servers, 0,
+		  me->num_pvfs_config_servers * sizeof(*me->pvfs_config_servers));
+
+   me->mnt_dir = strdup(pvfs2fuse.mntpoint);
+   me->mnt_opts = NULL;
+
+   cp = pvfs2fuse.fs_spec;
+   cur_server = 0;
+   for (;;) {
+	  char *tok;
+	  int slashcount;
+	  char *slash;
+	  char *last_slash;
+
+	  tok = strsep(&cp, ",");
+	  if (!tok) break;
+
+	  slash = tok;
+	  slashcount = 0;
+	  while ((slash = index(slash, '/')))
+	  {
+		 slash++;
+		 slashcount++;
+	  }
+	  if (slashcount != 3)
+	  {
+		 fprintf(stderr,"Error: invalid FS spec: %s\n",
+				 pvfs2fuse.fs_spec);
+		 exit(-1);
+	  }
+
+	  /* find a reference point in the string */
+	  last_slash = rindex(tok, '/');
+	  *last_slash = '\0';
+
+	  /* config server and fs name are a special case, take one
+	   * string and split it in half on "/" delimiter
+	   */
+	  me->pvfs_config_servers[cur_server] = strdup(tok);
+	  if (!me->pvfs_config_servers[cur_server])
+		 exit(-1);
+
+	  ++last_slash;
+
+	  if (cur_server == 0) {
+		 me->pvfs_fs_name = strdup(last_slash);
+		 if (!me->pvfs_fs_name)
+			exit(-1);
+	  } else {
+		 if (strcmp(last_slash, me->pvfs_fs_name) != 0) {
+			fprintf(stderr,
+					"Error: different fs names in server addresses: %s\n",
+					pvfs2fuse.fs_spec);
+			exit(-1);
 		 }
-		 return 1;
-
-	  case KEY_HELP:
-		 usage(outargs->argv[0]);
-		 /* FIXME don't show the FUSE arguments
-			fuse_opt_add_arg(outargs, "-ho");
-			pvfs_fuse_main(outargs); */
-		 exit(1);
-
-	  case KEY_VERSION:
-		 fprintf(stderr, "PVFS2FUSE version %s (PVFS2 %s) (%s, %s)\n",
-				 pvfs2fuse_version, PVFS2_VERSION, __DATE__, __TIME__);
-#if FUSE_VERSION >= 25
-		 fuse_opt_add_arg(outargs, "--version");
-		 pvfs_fuse_main(outargs);
-#endif
-		 exit(0);
+	  }
+	  ++cur_server;
+   }
 
-	  default:
-		 fprintf(stderr, "internal error\n");
-		 abort();
+   /* FIXME flowproto should be an option */
+   me->flowproto = FLOWPROTO_DEFAULT;
+
+   /* FIXME encoding should be an option */
+   me->encoding = PVFS2_ENCODING_DEFAULT;
+
+   /* FIXME default_num_dfiles should be an option */
+
+   ret = PVFS_sys_fs_add(me);
+   if( ret < 0 )
+   {
+	  PVFS_perror("Could not add mnt entry", ret);
+	  return(ret);
    }
+   pvfs2fuse.fs_id = me->fs_id;
+
+   return 0;
 }
 
 int main(int argc, char *argv[])
 {
    int ret;
    struct fuse_args args = FUSE_ARGS_INIT(argc, argv);
+   struct fuse_cmdline_opts opts;
+   struct fuse_session *se;
+   PVFS_sysresp_lookup lk_response;
+   PVFS_credential cred;
 
    umask(0);
 
-   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts,
-					  pvfs2fuse_opt_proc) == -1 )
+   pvfs2fuse.acache_timeout = -1;
+   pvfs2fuse.ncache_timeout = -1;
+   pvfs2fuse.max_write = PVFS_FUSE_DEFAULT_MAX_WRITE;
+   pvfs2fuse.dirent_count = PVFS_FUSE_DEFAULT_DIRENT_COUNT;
+
+   if (fuse_opt_parse(&args, &pvfs2fuse, pvfs2fuse_opts, NULL) == -1)
+	  exit(1);
+
+   if (fuse_parse_cmdline(&args, &opts) != 0)
+	  exit(1);
+
+   if (opts.show_help)
+   {
+	  usage(args.argv[0]);
+	  fuse_cmdline_help();
+	  fuse_lowlevel_help();
+	  exit(0);
+   }
+   if (opts.show_version)
+   {
+	  fprintf(stderr, "PVFS2FUSE version %s (PVFS2 %s) (%s, %s)\n",
+			  pvfs2fuse_version, PVFS2_VERSION, __DATE__, __TIME__);
+	  fuse_lowlevel_version();
+	  exit(0);
+   }
+   if (!opts.mountpoint)
+   {
+	  fprintf(stderr, "PVFS2FUSE requires mountpoint as argument\n");
+	  usage(args.argv[0]);
 	  exit(1);
+   }
+   pvfs2fuse.mntpoint = opts.mountpoint;
 
    if (pvfs2fuse.fs_spec == NULL)
    {
@@ -1206,134 +1737,46 @@ int main(int argc, char *argv[])
 	  }
 
 	  PVFS_util_get_mntent_copy( pvfs2fuse.fs_id, &pvfs2fuse.mntent );
-	  /* Set timeouts for PVFS2's name cache and attribute cache */
-	  PVFS_sys_set_info(PVFS_SYS_ACACHE_TIMEOUT_MSECS, 0);
-	  PVFS_sys_set_info(PVFS_SYS_NCACHE_TIMEOUT_MSECS, 0);
    }
    else
    {
-	  struct PVFS_sys_mntent *me = &pvfs2fuse.mntent;
-	  char *cp;
-	  int cur_server;
-
-	  /* the following is copied from PVFS_util_init_defaults()
-		 in fuse/lib/pvfs2-util.c */
-
-	  /* initialize pvfs system interface */
-	  ret = PVFS_sys_initialize(GOSSIP_NO_DEBUG);
+	  ret = pvfs_fuse_add_mntent();
 	  if (ret < 0)
-	  {
-		 return(ret);
-	  }
-
-	  /* the following is copied from PVFS_util_parse_pvfstab()
-		 in fuse/lib/pvfs2-util.c */
-	  memset( me, 0, sizeof(pvfs2fuse.mntent) );
-
-	  /* Enable integrity checks by default */
-	  me->integrity_check = 1;
-	  /* comma-separated list of ways to contact a config server */
-	  me->num_pvfs_config_servers = 1;
-
-	  for (cp=pvfs2fuse.fs_spec; *cp; cp++)
-		 if (*cp == ',')
-			++me->num_pvfs_config_servers;
-
-	  /* allocate room for our copies of the strings */
-	  me->pvfs_config_servers =
-		 malloc(me->num_pvfs_config_servers *
-				sizeof(*me->pvfs_config_servers));
-	  if (!me->pvfs_config_servers)
-		 exit(-1);
-	  memset(me->pvfs_config_servers, 0,
-			 me->num_pvfs_config_servers * sizeof(*me->pvfs_config_servers));
-
-	  me->mnt_dir = strdup(pvfs2fuse.mntpoint);
-	  me->mnt_opts = NULL;
-
-	  cp = pvfs2fuse.fs_spec;
-	  cur_server = 0;
-	  for (;;) {
-		 char *tok;
-		 int slashcount;
-		 char *slash;
-		 char *last_slash;
-
-		 tok = strsep(&cp, ",");
-		 if (!tok) break;
-
-		 slash = tok;
-		 slashcount = 0;
-		 while ((slash = index(slash, '/')))
-		 {
-			slash++;
-			slashcount++;
-		 }
-		 if (slashcount != 3)
-		 {
-			fprintf(stderr,"Error: invalid FS spec: %s\n",
-					pvfs2fuse.fs_spec);
-			exit(-1);
-		 }
-
-		 /* find a reference point in the string */
-		 last_slash = rindex(tok, '/');
-		 *last_slash = '\0';
-
-		 /* config server and fs name are a special case, take one 
-		  * string and split it in half on "/" delimiter
-		  */
-		 me->pvfs_config_servers[cur_server] = strdup(tok);
-		 if (!me->pvfs_config_servers[cur_server])
-			exit(-1);
-
-		 ++last_slash;
-
-		 if (cur_server == 0) {
-			me->pvfs_fs_name = strdup(last_slash);
-			if (!me->pvfs_fs_name)
-			   exit(-1);
-		 } else {
-			if (strcmp(last_slash, me->pvfs_fs_name) != 0) {
-			   fprintf(stderr,
-					   "Error: different fs names in server addresses: %s\n",
-					   pvfs2fuse.fs_spec);
-			   exit(-1);
-			}
-		 }
-		 ++cur_server;
-	  }
-	
-	  /* FIXME flowproto should be an option */
-	  me->flowproto = FLOWPROTO_DEFAULT;
-
-	  /* FIXME encoding should be an option */
-	  me->encoding = PVFS2_ENCODING_DEFAULT;
+		 return(-1);
+   }
 
-	  /* FIXME default_num_dfiles should be an option */
+   pvfs_fuse_set_timeouts();
 
-	  ret = PVFS_sys_fs_add(me);
-	  if( ret < 0 )
-	  {
-		 PVFS_perror("Could not add mnt entry", ret);
-		 return(-1);
-	  }
-	  pvfs2fuse.fs_id = me->fs_id;
+   /* resolve the root once; everything else is found relative to it */
+   ret = PVFS_util_gen_credential_defaults(&cred);
+   if (ret < 0)
+   {
+	  PVFS_perror("PVFS_util_gen_credential_defaults", ret);
+	  return(-1);
    }
+   memset(&lk_response, 0, sizeof(lk_response));
+   ret = PVFS_sys_lookup(pvfs2fuse.fs_id, "/", &cred, &lk_response,
+						 PVFS2_LOOKUP_LINK_FOLLOW, PVFS_HINT_NULL);
+   pvfs_fuse_cleanup_credential(&cred);
+   if (ret < 0)
+   {
+	  PVFS_perror("PVFS_sys_lookup", ret);
+	  return(-1);
+   }
+   pvfs2fuse.root.ref = lk_response.ref;
+   pvfs2fuse.root.nlookup = 1;
 
-   /* FIXME should we allow all the FUSE options?  Maybe we should
-	* pass only some of the FUSE options to fuse_main.  For now,
-	* force the direct_io and allow_other options.  Also turn off
-	* multithreaded operation since it doesnt work with PVFS.
-	*/
+   inode_table = qhash_init(pvfs_fuse_inode_compare, quickhash_64bit_hash,
+							PVFS_FUSE_INODE_TABLE_SIZE);
+   if (!inode_table)
+   {
+	  fprintf(stderr, "Error: failed to allocate inode table\n");
+	  return(-1);
+   }
 
-   fuse_opt_insert_arg( &args, 1, "-odirect_io" );
-   fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0");
-   fuse_opt_insert_arg( &args, 1, "-omax_write=524288");
    if ( getuid() == 0 )
-	  fuse_opt_insert_arg( &args, 1, "-oallow_other" );
-   fuse_opt_insert_arg( &args, 1, "-s" );
-    
+	  fuse_opt_add_arg( &args, "-oallow_other" );
+
    {
 	  /* set the fsname and volname */
 	  char name[200];
@@ -1343,21 +1786,41 @@ int main(int argc, char *argv[])
 		 config = pvfs2fuse.mntent.pvfs_config_servers[0];
 
 	  snprintf( name, 200, "-ofsname=pvfs2fuse#%s/%s", config, pvfs2fuse.mntent.pvfs_fs_name );
-	  fuse_opt_insert_arg( &args, 1, name );
+	  fuse_opt_add_arg( &args, name );
 #if (__FreeBSD__ >= 10)
 	  snprintf( name, 200, "-ovolname=%s", pvfs2fuse.mntent.pvfs_fs_name );
-	  fuse_opt_insert_arg( &args, 1, name );
+	  fuse_opt_add_arg( &args, name );
 #endif
    }
-    
-#if (__FreeBSD__ >= 10)
+
+   se = fuse_session_new(&args, &pvfs_fuse_oper, sizeof(pvfs_fuse_oper),
+						 NULL);
+   if (se == NULL)
+	  return(-1);
+
+   ret = -1;
+   if (fuse_set_signal_handlers(se) == 0)
    {
-	  /* MacFUSE has a bug where cached attributes
-	   * arent invalidated on direct_io writes
-	   */
-	  fuse_opt_insert_arg( &args, 1, "-oattr_timeout=0" );
+	  if (fuse_session_mount(se, opts.mountpoint) == 0)
+	  {
+		 fuse_daemonize(opts.foreground);
+
+		 /* requests are served concurrently unless -s is given; the
+		  * system interface is thread safe */
+		 if (opts.singlethread)
+			ret = fuse_session_loop(se);
+		 else
+			ret = fuse_session_loop_mt(se, opts.clone_fd);
+
+		 fuse_session_unmount(se);
+	  }
+	  fuse_remove_signal_handlers(se);
    }
-#endif
+   fuse_session_destroy(se);
+
+   free(opts.mountpoint);
+   fuse_opt_free_args(&args);
+   PVFS_sys_finalize();
 
-   return pvfs_fuse_main(&args);
+   return ret ? 1 : 0;
 }
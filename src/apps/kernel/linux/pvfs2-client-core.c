@@ -14,6 +14,7 @@
 #include <unistd.h>
 #include <pwd.h>
 #include <pthread.h>
+#include <sched.h>
 #include <signal.h>
 #include <getopt.h>
 #include <net/if.h>
@@ -60,12 +61,17 @@
 /* only relevant if USE_RA_CACHE is on */
 
 /*
-  an arbitrary limit to the max number of operations we'll support in
-  flight at once, and the max number of items we can write into the
-  device file as a response
+  the default and upper limits on the number of operations we'll
+  support in flight at once (--max-ops), and the max number of items
+  we can write into the device file as a response
 */
-#define MAX_NUM_OPS                 64
-#define MAX_LIST_SIZE      MAX_NUM_OPS
+#define DEFAULT_NUM_OPS             64
+#define MAX_NUM_OPS               8192
+#define MAX_LIST_SIZE               64
+/* completions collected per testany call; the sysint allows up to 256 */
+#define MAX_TESTANY_OPS            256
+/* upper limit on the number of worker threads (--threads) */
+#define MAX_WORKER_THREADS          64
 #define IOX_HINDEXED_COUNT          64
 
 #define REMOUNT_PENDING     0xFFEEFF33
@@ -143,6 +149,10 @@ typedef struct
     int readahead_readcnt;
     int readahead_pinned;
     char *bmi_opts;
+    int max_ops;
+    int worker_threads;
+    char *replay_socket;
+    char *record_upcalls;
 } options_t;
 
 /*
@@ -208,6 +218,12 @@ typedef struct
 
     struct qlist_head hash_link;
 
+    /* worker thread hand-off; see queue_vfs_work() */
+    struct qlist_head work_link;
+    int work_type;
+    int work_error;
+    int in_worker;
+
 #ifdef CLIENT_CORE_OP_TIMING
     PINT_time_marker start;
     PINT_time_marker end;
@@ -259,15 +275,17 @@ static struct PINT_dev_params s_desc_params[NUM_MAP_DESC];
 /* static char hostname[100]; */
 
 /* used only for deleting all allocated vfs_request objects */
-vfs_request_t *s_vfs_request_array[MAX_NUM_OPS] = {NULL};
+vfs_request_t **s_vfs_request_array = NULL;
 
 static struct PINT_tcache *credential_cache = NULL;
+static pthread_mutex_t credential_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 /* this hashtable is used to keep track of operations in progress */
 #define DEFAULT_OPS_IN_PROGRESS_HTABLE_SIZE 67
 static int hash_key(const void *key, int table_size);
 static int hash_key_compare(const void *key, struct qlist_head *link);
 static struct qhash_table *s_ops_in_progress_table = NULL;
+static pthread_mutex_t s_ops_in_progress_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static void parse_args(int argc, char **argv, options_t *opts);
 static void print_help(char *progname);
@@ -461,9 +479,11 @@ static PVFS_error add_op_to_ops_in_progress_table(
 
     if (vfs_request)
     {
+        pthread_mutex_lock(&s_ops_in_progress_mutex);
         qhash_add(s_ops_in_progress_table,
                   (void *)(&vfs_request->info.tag),
                   &vfs_request->hash_link);
+        pthread_mutex_unlock(&s_ops_in_progress_mutex);
         ret = 0;
     }
     return ret;
@@ -481,6 +501,7 @@ static PVFS_error cancel_op_in_progress(PVFS_id_gen_t tag)
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
                  "cancel_op_in_progress called\n");
 
+    pthread_mutex_lock(&s_ops_in_progress_mutex);
     hash_link = qhash_search( s_ops_in_progress_table, (void *)(&tag));
     if (hash_link)
     {
@@ -520,6 +541,7 @@ static PVFS_error cancel_op_in_progress(PVFS_id_gen_t tag)
         gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "op in progress cannot "
                      "be found (tag = %lld)\n", lld(tag));
     }
+    pthread_mutex_unlock(&s_ops_in_progress_mutex);
     return ret;
 }
 
@@ -534,6 +556,7 @@ static int is_op_in_progress(vfs_request_t *vfs_request)
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "is_op_in_progress called on "
                  "tag %lld\n", lld(vfs_request->info.tag));
 
+    pthread_mutex_lock(&s_ops_in_progress_mutex);
     hash_link = qhash_search( s_ops_in_progress_table, 
                               (void *)(&vfs_request->info.tag));
     if (hash_link)
@@ -545,6 +568,7 @@ static int is_op_in_progress(vfs_request_t *vfs_request)
                     (tmp_request->in_upcall.type ==
                      vfs_request->in_upcall.type));
     }
+    pthread_mutex_unlock(&s_ops_in_progress_mutex);
     return op_found;
 }
 
@@ -557,8 +581,10 @@ static PVFS_error remove_op_from_ops_in_progress_table(
 
     if (vfs_request)
     {
+        pthread_mutex_lock(&s_ops_in_progress_mutex);
         hash_link = qhash_search_and_remove(s_ops_in_progress_table,
                                             (void *)(&vfs_request->info.tag));
+        pthread_mutex_unlock(&s_ops_in_progress_mutex);
         if (hash_link)
         {
             tmp_vfs_request = qhash_entry(hash_link,
@@ -4531,6 +4557,14 @@ repost_op:
                 {
                     ret = add_op_to_ops_in_progress_table(vfs_request);
                 }
+
+                /*
+                 * if a worker thread posted this op, hand it back to
+                 * the main thread; its completion may already be
+                 * waiting there, so this must be the last access
+                 */
+                __atomic_store_n(&vfs_request->in_worker, 0,
+                                 __ATOMIC_RELEASE);
             }
         }
         break;
@@ -4581,441 +4615,806 @@ static PVFS_error write_downcall(vfs_request_t *vfs_request)
     return ret;
 }
 
-static PVFS_error process_vfs_requests(void)
+/*
+  optional worker threads (--threads).  the main thread keeps running
+  PVFS_sys_testany() and the completion bookkeeping, but hands the
+  decode and post of new upcalls and the packaging and write of
+  finished downcalls to the workers.  a request belongs to exactly one
+  thread at a time: in_worker is set when it is queued and cleared
+  when the worker either reposts the request or has finished posting
+  its sysint operation.  completions that the main thread sees for a
+  request a worker still owns are parked until it lets go.
+*/
+#define VFS_WORK_UNEXP     1
+#define VFS_WORK_COMPLETE  2
+
+typedef struct
 {
-    PVFS_error ret = 0; 
-    int op_count = 0, i = 0;
-    vfs_request_t *vfs_request = NULL;
-    vfs_request_t *vfs_request_array[MAX_NUM_OPS] = {NULL};
-    PVFS_sys_op_id op_id_array[MAX_NUM_OPS];
-    int error_code_array[MAX_NUM_OPS] = {0};
-#ifdef USE_RA_CACHE
-    struct qlist_head *link = NULL;
-    gen_link_t *glink = NULL;
-    racache_buffer_t *buff = NULL;
-    vfs_request_t *vl = NULL;
-#endif
+    vfs_request_t *vfs_request;
+    PVFS_sys_op_id op_id;
+    int error_code;
+} deferred_completion_t;
+
+static int s_worker_count = 0;
+static int s_workers_running = 0;
+static pthread_t *s_worker_threads = NULL;
+static pthread_mutex_t s_work_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t s_work_cond = PTHREAD_COND_INITIALIZER;
+static QLIST_HEAD(s_work_queue);
+
+/* only touched by the main thread */
+static deferred_completion_t *s_deferred = NULL;
+static int s_deferred_count = 0;
+static int s_deferred_size = 0;
+
+static void process_vfs_completion(vfs_request_t *vfs_request,
+                                   PVFS_sys_op_id op_id,
+                                   int error_code);
+
+/* upcalls that are safe to decode and post off the main thread; mount,
+ * cancellation and the other administrative upcalls stay inline
+ */
+static int upcall_type_runs_on_worker(int type)
+{
+    switch(type)
+    {
+        case PVFS2_VFS_OP_LOOKUP:
+        case PVFS2_VFS_OP_CREATE:
+        case PVFS2_VFS_OP_SYMLINK:
+        case PVFS2_VFS_OP_GETATTR:
+        case PVFS2_VFS_OP_SETATTR:
+        case PVFS2_VFS_OP_REMOVE:
+        case PVFS2_VFS_OP_MKDIR:
+        case PVFS2_VFS_OP_READDIR:
+        case PVFS2_VFS_OP_READDIRPLUS:
+        case PVFS2_VFS_OP_RENAME:
+        case PVFS2_VFS_OP_TRUNCATE:
+        case PVFS2_VFS_OP_GETXATTR:
+        case PVFS2_VFS_OP_SETXATTR:
+        case PVFS2_VFS_OP_REMOVEXATTR:
+        case PVFS2_VFS_OP_LISTXATTR:
+        case PVFS2_VFS_OP_STATFS:
+        case PVFS2_VFS_OP_FILE_IO:
+        case PVFS2_VFS_OP_FILE_IOX:
+        case PVFS2_VFS_OP_FSYNC:
+            return 1;
+        default:
+            return 0;
+    }
+}
 
+static int upcall_runs_on_worker(vfs_request_t *vfs_request)
+{
+    pvfs2_upcall_t *upc = (pvfs2_upcall_t *)vfs_request->info.buffer;
 
-    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                 "process_vfs_requests called\n");
+    if (vfs_request->jstat.error_code ||
+        (vfs_request->info.size < sizeof(pvfs2_upcall_t)) ||
+        (remount_complete == REMOUNT_NOTCOMPLETED))
+    {
+        return 0;
+    }
+    return upcall_type_runs_on_worker(upc->type);
+}
 
-    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Post Initial Unexp Requests\n");
-    /* allocate and post all of our initial unexpected vfs requests */
-    for(i = 0; i < MAX_NUM_OPS; i++)
+static int downcall_runs_on_worker(int type)
+{
+    switch(type)
     {
-        vfs_request = (vfs_request_t *)malloc(sizeof(vfs_request_t));
-        assert(vfs_request);
+        /*
+          failed creates fall back to a blocking lookup while the
+          downcall is packaged; a blocking sysint call from a worker
+          would race the main thread's testany for its completion
+        */
+        case PVFS2_VFS_OP_CREATE:
+        case PVFS2_VFS_OP_SYMLINK:
+        case PVFS2_VFS_OP_MKDIR:
+            return 0;
+        default:
+            return upcall_type_runs_on_worker(type);
+    }
+}
 
-        s_vfs_request_array[i] = vfs_request;
+static void queue_vfs_work(vfs_request_t *vfs_request, int type, int error)
+{
+    vfs_request->in_worker = 1;
+    vfs_request->work_type = type;
+    vfs_request->work_error = error;
+
+    pthread_mutex_lock(&s_work_mutex);
+    qlist_add_tail(&vfs_request->work_link, &s_work_queue);
+    pthread_cond_signal(&s_work_cond);
+    pthread_mutex_unlock(&s_work_mutex);
+}
 
-        memset(vfs_request, 0, sizeof(vfs_request_t));
-        vfs_request->is_dev_unexp = 1;
+/* finishes a completed request on a worker: the same steps the main
+ * loop takes for a request without readahead cache state
+ */
+static PVFS_error finish_vfs_request(vfs_request_t *vfs_request,
+                                     int error_code)
+{
+    PVFS_error ret = 0;
 
-        ret = PINT_sys_dev_unexp(&vfs_request->info,
-                                 &vfs_request->jstat,
-                                 &vfs_request->op_id,
-                                 vfs_request);
+    package_downcall_members(vfs_request, &error_code);
 
+    if (!vfs_request->was_cancelled_io)
+    {
+        ret = write_downcall(vfs_request);
         if (ret < 0)
         {
-	    PVFS_perror_gossip("PINT_sys_dev_unexp()", ret);
-            return -PVFS_ENOMEM;
+            gossip_err("write_downcall failed (tag=%lld)\n",
+                       lld(vfs_request->info.tag));
         }
+        ret = repost_unexp_vfs_request(vfs_request, "normal_completion");
     }
-
-    /*
-      signal the remount thread to go ahead with the remount attempts
-      since we're ready to handle requests now
-    */
-    pthread_mutex_unlock(&remount_mutex);
-
-    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Start Processing Loop\n");
-    while(s_client_is_processing)
+    else
     {
-        op_count = MAX_NUM_OPS;
-        memset(error_code_array, 0, (MAX_NUM_OPS * sizeof(int)));
-        memset(vfs_request_array, 0, (MAX_NUM_OPS * sizeof(vfs_request_t *)));
-
-#if 0
-        /* generates too much logging, but useful sometimes */
-        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                 "Calling PVFS_sys_testany for new requests\n");
-#endif
+        ret = repost_unexp_vfs_request(vfs_request, "cancellation");
+    }
+    return ret;
+}
 
-        /* gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PVFS_sys_testany\n"); */
-        ret = PVFS_sys_testany(op_id_array,
-                               &op_count,
-                               (void *)vfs_request_array,
-                               error_code_array,
-                               PVFS2_CLIENT_DEFAULT_TEST_TIMEOUT_MS);
+static void *vfs_worker(void *ptr)
+{
+    struct qlist_head *link = NULL;
+    vfs_request_t *vfs_request = NULL;
+    PVFS_error ret = 0;
 
-        /* gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Process Request Array\n"); */
-        for(i = 0; i < op_count; i++)
+    pthread_mutex_lock(&s_work_mutex);
+    while (s_workers_running)
+    {
+        link = qlist_pop(&s_work_queue);
+        if (!link)
         {
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "Process Request Array(%d)\n",i);
-            vfs_request = vfs_request_array[i];
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "*** New vfs_request = %p\n", vfs_request);
+            pthread_cond_wait(&s_work_cond, &s_work_mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&s_work_mutex);
 
-            assert(vfs_request);
-/*             assert(vfs_request->op_id == op_id_array[i]); */
-            if (vfs_request->num_ops == 1 &&
-                    vfs_request->op_id != op_id_array[i])
+        /*
+          the request may be handed back to the main thread before
+          either call returns, so it must not be touched afterwards
+        */
+        vfs_request = qlist_entry(link, vfs_request_t, work_link);
+        if (vfs_request->work_type == VFS_WORK_UNEXP)
+        {
+            ret = handle_unexp_vfs_request(vfs_request);
+            if (ret != 0)
             {
-                gossip_err("op_id %Ld != completed op id %Ld\n",
-                        lld(vfs_request->op_id), lld(op_id_array[i]));
-#ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned too early 1\n");
-                }
-#endif
-                continue; /* for i loop */
+                gossip_err("error returned from handle_enexp_vfs_request "
+                           "probably unknown request code = %d\n", ret);
             }
-            else if (vfs_request->num_ops > 1)
+        }
+        else
+        {
+            ret = finish_vfs_request(vfs_request, vfs_request->work_error);
+            if (ret < 0)
             {
-                int j;
-                /* assert that completed op is one that we posted earlier */
-                for (j = 0; j < vfs_request->num_ops; j++)
-                {
-                    if (op_id_array[i] == vfs_request->op_ids[j])
-                    {
-                        break; /* for j loop */
-                    }
-                }
-                if (j == vfs_request->num_ops)
-                {
-                    gossip_err("completed op id (%Ld) is weird\n",
-                              lld(op_id_array[i]));
-#ifdef USE_RA_CACHE
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                        gossip_err("SPEC request returned too early 2\n");
-                    }
-#endif
-                    continue; /* for i loop */
-                }
+                PVFS_perror_gossip("finish_vfs_request", ret);
             }
+        }
 
-            /* check if this is a new dev unexp request */
-            if (vfs_request->is_dev_unexp)
-            {
-                /*
-                 * NOTE: possible optimization -- if we detect that
-                 * we're about to handle an inlined/blocking operation,
-                 * make sure all non-inline ops are posted beforehand
-                 * so that the sysint test() calls from the blocking
-                 * operation handling can be making progress on the
-                 * other ops in progress
-                */
-                gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
-                             " returned unexp vfs_request %p, tag: %llu\n",
-                             vfs_request,
-                             llu(vfs_request->info.tag));
-                ret = handle_unexp_vfs_request(vfs_request);
-                if (ret != 0)
-                {
-                    /* assert(ret == 0); */
-                    gossip_err("error returned from handle_enexp_vfs_request "
-                               "probably unknown request code = %d\n", ret);
-                    vfs_request->jstat.error_code = ret;
-                }
+        pthread_mutex_lock(&s_work_mutex);
+    }
+    pthread_mutex_unlock(&s_work_mutex);
+    return NULL;
+}
 
-                /* We've handled this unexpected request (posted the
-                 * client isys call), we can move
-                 * on to the next request in the queue.
-                 */
+static int start_vfs_workers(int count)
+{
+    int i = 0;
+
+    if (count < 1)
+    {
+        return 0;
+    }
+
+    s_worker_threads = (pthread_t *)calloc(count, sizeof(pthread_t));
+    if (!s_worker_threads)
+    {
+        return -PVFS_ENOMEM;
+    }
+
+    s_workers_running = 1;
+    for (i = 0; i < count; i++)
+    {
+        if (pthread_create(&s_worker_threads[i], NULL, vfs_worker, NULL))
+        {
+            gossip_err("Cannot create worker thread %d!\n", i);
+            break;
+        }
+    }
+    s_worker_count = i;
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Started %d worker threads\n",
+                 s_worker_count);
+    return (s_worker_count ? 0 : -PVFS_ENOMEM);
+}
+
+static void stop_vfs_workers(void)
+{
+    int i = 0;
+
+    if (!s_worker_count)
+    {
+        return;
+    }
+
+    pthread_mutex_lock(&s_work_mutex);
+    s_workers_running = 0;
+    pthread_cond_broadcast(&s_work_cond);
+    pthread_mutex_unlock(&s_work_mutex);
+
+    for (i = 0; i < s_worker_count; i++)
+    {
+        pthread_join(s_worker_threads[i], NULL);
+    }
+    free(s_worker_threads);
+    s_worker_threads = NULL;
+    s_worker_count = 0;
+
+    free(s_deferred);
+    s_deferred = NULL;
+    s_deferred_count = s_deferred_size = 0;
+}
+
+static void defer_vfs_completion(vfs_request_t *vfs_request,
+                                 PVFS_sys_op_id op_id,
+                                 int error_code)
+{
+    deferred_completion_t *new_deferred = NULL;
+    int new_size = 0;
+
+    if (s_deferred_count == s_deferred_size)
+    {
+        new_size = (s_deferred_size ? 2 * s_deferred_size : 16);
+        new_deferred = (deferred_completion_t *)realloc(
+            s_deferred, new_size * sizeof(deferred_completion_t));
+        /* every posted op has to be seen through to its downcall */
+        assert(new_deferred);
+        s_deferred = new_deferred;
+        s_deferred_size = new_size;
+    }
+
+    s_deferred[s_deferred_count].vfs_request = vfs_request;
+    s_deferred[s_deferred_count].op_id = op_id;
+    s_deferred[s_deferred_count].error_code = error_code;
+    s_deferred_count++;
+}
+
+/* retries parked completions in the order they arrived; those whose
+ * request is still owned by a worker (including any parked again
+ * while this runs) stay on the list
+ */
+static void process_deferred_completions(void)
+{
+    int i = 0, kept = 0, count = s_deferred_count;
+    deferred_completion_t d;
+
+    for (i = 0; i < count; i++)
+    {
+        d = s_deferred[i];
+        if (__atomic_load_n(&d.vfs_request->in_worker, __ATOMIC_ACQUIRE))
+        {
+            s_deferred[kept++] = d;
+            continue;
+        }
+        process_vfs_completion(d.vfs_request, d.op_id, d.error_code);
+    }
+
+    /* slide down anything parked while we were running */
+    memmove(&s_deferred[kept], &s_deferred[count],
+            (s_deferred_count - count) * sizeof(deferred_completion_t));
+    s_deferred_count = kept + (s_deferred_count - count);
+}
+
+/* process_vfs_completion()
+ *
+ * handles one completion returned by PVFS_sys_testany(): either a new
+ * upcall from the device or a finished sysint operation
+ */
+static void process_vfs_completion(vfs_request_t *vfs_request,
+                                   PVFS_sys_op_id op_id,
+                                   int error_code)
+{
+    PVFS_error ret = 0;
 #ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned too early 3\n");
-                }
+    struct qlist_head *link = NULL;
+    gen_link_t *glink = NULL;
+    racache_buffer_t *buff = NULL;
+    vfs_request_t *vl = NULL;
 #endif
-                continue; /* for i loop */
-            }
 
-            /* We've just completed an (expected) operation on this request,
-             * now we must figure out its completion state and act accordingly.
-             */
-            vfs_request->num_incomplete_ops--;
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "*** New vfs_request = %p\n", vfs_request);
 
-            /* if operation is not complete, we gotta continue */
-            if (vfs_request->num_incomplete_ops != 0)
-            {
+    assert(vfs_request);
+
+    /*
+      a worker thread still owns this request (it is between
+      posting the op and entering it in the in progress table), so
+      come back to the completion once the worker lets go of it
+    */
+    if (__atomic_load_n(&vfs_request->in_worker, __ATOMIC_ACQUIRE))
+    {
+        defer_vfs_completion(vfs_request, op_id, error_code);
+        return;
+    }
+
+/*             assert(vfs_request->op_id == op_id); */
+    if (vfs_request->num_ops == 1 &&
+            vfs_request->op_id != op_id)
+    {
+        gossip_err("op_id %Ld != completed op id %Ld\n",
+                lld(vfs_request->op_id), lld(op_id));
 #ifdef USE_RA_CACHE
-                if (vfs_request->is_readahead_speculative)
-                {
-                    gossip_err("SPEC request returned to early 4\n");
-                }
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned too early 1\n");
+        }
 #endif
-                continue; /* for i loop */
+        return;
+    }
+    else if (vfs_request->num_ops > 1)
+    {
+        int j;
+        /* assert that completed op is one that we posted earlier */
+        for (j = 0; j < vfs_request->num_ops; j++)
+        {
+            if (op_id == vfs_request->op_ids[j])
+            {
+                break; /* for j loop */
             }
-            log_operation_timing(vfs_request);
-
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
-                         " returned completed vfs_request %p\n",
-                         vfs_request);
-            /*
-             * if this is not a dev unexp msg, it's a non-blocking
-             * sysint operation that has just completed
-             */
-            assert(vfs_request->in_upcall.type);
-
-            /*
-             * even if the op was cancelled, if we get here, we
-             * will have to remove the op from the in progress
-             * table.  the error code on cancelled operations is
-             * already set appropriately
-             */
+        }
+        if (j == vfs_request->num_ops)
+        {
+            gossip_err("completed op id (%Ld) is weird\n",
+                      lld(op_id));
 #ifdef USE_RA_CACHE
-            /*
-             * first deal with waiters, if any
-             * note that even if primary req is spec, waiters
-             * may or may not be.
-             */
-            if (vfs_request->in_upcall.type == PVFS2_VFS_OP_FILE_IO &&
-                vfs_request->racache_status == RACACHE_POSTED &&
-                vfs_request->racache_buff != NULL)
+            if (vfs_request->is_readahead_speculative)
             {
-                gossip_debug(GOSSIP_RACACHE_DEBUG,
-                             "Process Waiting Racache Requests \n");
-                qlist_for_each_entry(glink,
-                                     &vfs_request->racache_buff->vfs_link,
-                                     link)
-                {
-                    vl = glink->payload;
-                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 1 vl = %p\n", vl);
-                    /* get a shared kernel/userspace buffer for the I/O
-                     * transfer
-                     */
-                    if (!vl->is_readahead_speculative)
-                    {
-                        gossip_debug(GOSSIP_RACACHE_DEBUG,
-                             "--- Remove waiting req from in_progress\n");
-                        ret = remove_op_from_ops_in_progress_table(vl);
-                        if (ret < 0)
-                        {
-                            gossip_err(
-                                "remove in_progress failed "
-                                "(tag=%lld)\n", lld(vl->info.tag));
-                            ret = repost_unexp_vfs_request(vfs_request,
-                                                       "error completion 1");
-                            assert(ret == 0);
-                        }
-                    }
-                }
+                gossip_err("SPEC request returned too early 2\n");
             }
-            /* now deal with primary request */
-            else
 #endif
-            {
-                ret = remove_op_from_ops_in_progress_table(vfs_request);
-                if (ret)
-                {
-                    PVFS_perror_gossip("Failed to remove op in progress "
-                                       "from table", ret);
+            return;
+        }
+    }
 
-                    /* repost the unexpected request since we're done
-                     * with this one.
-                     */
-                    ret = repost_unexp_vfs_request(vfs_request,
-                                                   "error completion 2");
+    /* check if this is a new dev unexp request */
+    if (vfs_request->is_dev_unexp)
+    {
+        /*
+         * NOTE: possible optimization -- if we detect that
+         * we're about to handle an inlined/blocking operation,
+         * make sure all non-inline ops are posted beforehand
+         * so that the sysint test() calls from the blocking
+         * operation handling can be making progress on the
+         * other ops in progress
+        */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
+                     " returned unexp vfs_request %p, tag: %llu\n",
+                     vfs_request,
+                     llu(vfs_request->info.tag));
+        if (s_worker_count && upcall_runs_on_worker(vfs_request))
+        {
+            queue_vfs_work(vfs_request, VFS_WORK_UNEXP, 0);
+            return;
+        }
+        ret = handle_unexp_vfs_request(vfs_request);
+        if (ret != 0)
+        {
+            /* assert(ret == 0); */
+            gossip_err("error returned from handle_enexp_vfs_request "
+                       "probably unknown request code = %d\n", ret);
+            vfs_request->jstat.error_code = ret;
+        }
 
-                    assert(ret == 0);
+        /* We've handled this unexpected request (posted the
+         * client isys call), we can move
+         * on to the next request in the queue.
+         */
 #ifdef USE_RA_CACHE
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                        gossip_err("SPEC request returned to early 5\n");
-                    }
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned too early 3\n");
+        }
 #endif
-                    continue; /* for i loop */
-                }
-            }
+        return;
+    }
 
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "Calling package_downcall_members\n");
-            package_downcall_members(vfs_request, &error_code_array[i]);
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                         "package_downcall_members Returns\n");
+    /* We've just completed an (expected) operation on this request,
+     * now we must figure out its completion state and act accordingly.
+     */
+    vfs_request->num_incomplete_ops--;
 
-            /*
-             * write the downcall if the operation was NOT a
-             * cancelled I/O operation.  while it's safe to write
-             * cancelled I/O operations to the kernel, it's a waste
-             * of time since it will be discarded.  just repost the
-             * op instead
+    /* if operation is not complete, we gotta continue */
+    if (vfs_request->num_incomplete_ops != 0)
+    {
+#ifdef USE_RA_CACHE
+        if (vfs_request->is_readahead_speculative)
+        {
+            gossip_err("SPEC request returned to early 4\n");
+        }
+#endif
+        return;
+    }
+    log_operation_timing(vfs_request);
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PINT_sys_testsome"
+                 " returned completed vfs_request %p\n",
+                 vfs_request);
+    /*
+     * if this is not a dev unexp msg, it's a non-blocking
+     * sysint operation that has just completed
+     */
+    assert(vfs_request->in_upcall.type);
+
+    /*
+     * even if the op was cancelled, if we get here, we
+     * will have to remove the op from the in progress
+     * table.  the error code on cancelled operations is
+     * already set appropriately
+     */
+#ifdef USE_RA_CACHE
+    /*
+     * first deal with waiters, if any
+     * note that even if primary req is spec, waiters
+     * may or may not be.
+     */
+    if (vfs_request->in_upcall.type == PVFS2_VFS_OP_FILE_IO &&
+        vfs_request->racache_status == RACACHE_POSTED &&
+        vfs_request->racache_buff != NULL)
+    {
+        gossip_debug(GOSSIP_RACACHE_DEBUG,
+                     "Process Waiting Racache Requests \n");
+        qlist_for_each_entry(glink,
+                             &vfs_request->racache_buff->vfs_link,
+                             link)
+        {
+            vl = glink->payload;
+            gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 1 vl = %p\n", vl);
+            /* get a shared kernel/userspace buffer for the I/O
+             * transfer
              */
-            if (!vfs_request->was_cancelled_io)
+            if (!vl->is_readahead_speculative)
             {
-#ifdef USE_RA_CACHE
-                /* if there are waiters process them first */
-                if (vfs_request->racache_status == RACACHE_POSTED)
+                gossip_debug(GOSSIP_RACACHE_DEBUG,
+                     "--- Remove waiting req from in_progress\n");
+                ret = remove_op_from_ops_in_progress_table(vl);
+                if (ret < 0)
                 {
-                    /* by definition all requests on this list are
-                     * waiting for the same buffer, referenced from
-                     * the vfs_request.
-                     * disassemble the waiter list as we go.
-                     */
-                    gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "Downcalls on waiter req list\n");
-                    buff = vfs_request->racache_buff;
-                    while((link = qlist_pop(&buff->vfs_link)))
-                    {
-                        /* remove waiting req from list */
-                        glink = qlist_entry(link, gen_link_t, link);
-                        assert(glink);
-                        vl = (vfs_request_t *)glink->payload;
-                        gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 2 vl = %p\n", vl);
-                        free(glink);
-                        buff->vfs_cnt--; /* this should decrement to 0 */
-    
-                        /* the first vl is equal for vfs_request
-                         * if it is speculative don't free here
-                         * because we need it below - we will have
-                         * to free it later
-                         */
-                        if (vl->is_readahead_speculative &&
-                            vl != vfs_request)
-                        {
-                            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                         "--- Free speculative vl\n");
-                            /* clean up */
-                            PVFS_hint_free(&vl->hints);
-                            vl->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vl = %p\n", vl);
-                            free(vl);
-                        }
-                        else if (!vl->is_readahead_speculative)
-                        {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                        "--- Racache downcall write %p \n", vl);
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vreq = %p\n", vfs_request);
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vl = %p\n", vl);
-                            /* first vl equals vfs_request so don't need
-                             * to copy these
-                             */
-                            if (vl != vfs_request)
-                            {
-                                vl->out_downcall.status =
-                                                vfs_request->out_downcall.status;
-                                vl->out_downcall.type =
-                                                vfs_request->out_downcall.type;
-                            }
+                    gossip_err(
+                        "remove in_progress failed "
+                        "(tag=%lld)\n", lld(vl->info.tag));
+                    ret = repost_unexp_vfs_request(vfs_request,
+                                               "error completion 1");
+                    assert(ret == 0);
+                }
+            }
+        }
+    }
+    /* now deal with primary request */
+    else
+#endif
+    {
+        ret = remove_op_from_ops_in_progress_table(vfs_request);
+        if (ret)
+        {
+            PVFS_perror_gossip("Failed to remove op in progress "
+                               "from table", ret);
 
-                            ret = write_downcall(vl);
-                            if (ret < 0)
-                            {
-                                gossip_err(
-                                    "--- write_downcall failed "
-                                    "(tag=%lld)\n", lld(vl->info.tag));
-                            }
+            /* repost the unexpected request since we're done
+             * with this one.
+             */
+            ret = repost_unexp_vfs_request(vfs_request,
+                                           "error completion 2");
 
-                            /* clean up */
-                            vl->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                        "--- Repost unexp %p\n", vl);
-                            ret = repost_unexp_vfs_request(vl,
-                                                       "waiting_completion");
-                            if (ret < 0)
-                            {
-                                gossip_err(
-                                    "--- repost_unexp_vfs_request failed "
-                                    "(tag=%lld)\n", lld(vl->info.tag));
-                            }
-                        }
-                    } /* while link */
+            assert(ret == 0);
+#ifdef USE_RA_CACHE
+            if (vfs_request->is_readahead_speculative)
+            {
+                gossip_err("SPEC request returned to early 5\n");
+            }
+#endif
+            return;
+        }
+    }
+
+    if (s_worker_count &&
+        downcall_runs_on_worker(vfs_request->in_upcall.type))
+    {
+        queue_vfs_work(vfs_request, VFS_WORK_COMPLETE, error_code);
+        return;
+    }
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "Calling package_downcall_members\n");
+    package_downcall_members(vfs_request, &error_code);
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "package_downcall_members Returns\n");
+
+    /*
+     * write the downcall if the operation was NOT a
+     * cancelled I/O operation.  while it's safe to write
+     * cancelled I/O operations to the kernel, it's a waste
+     * of time since it will be discarded.  just repost the
+     * op instead
+     */
+    if (!vfs_request->was_cancelled_io)
+    {
+#ifdef USE_RA_CACHE
+        /* if there are waiters process them first */
+        if (vfs_request->racache_status == RACACHE_POSTED)
+        {
+            /* by definition all requests on this list are
+             * waiting for the same buffer, referenced from
+             * the vfs_request.
+             * disassemble the waiter list as we go.
+             */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "Downcalls on waiter req list\n");
+            buff = vfs_request->racache_buff;
+            while((link = qlist_pop(&buff->vfs_link)))
+            {
+                /* remove waiting req from list */
+                glink = qlist_entry(link, gen_link_t, link);
+                assert(glink);
+                vl = (vfs_request_t *)glink->payload;
+                gossip_debug(GOSSIP_RACACHE_DEBUG, "Loop 2 vl = %p\n", vl);
+                free(glink);
+                buff->vfs_cnt--; /* this should decrement to 0 */
+
+                /* the first vl is equal for vfs_request
+                 * if it is speculative don't free here
+                 * because we need it below - we will have
+                 * to free it later
+                 */
+                if (vl->is_readahead_speculative &&
+                    vl != vfs_request)
+                {
+                    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                                 "--- Free speculative vl\n");
+                    /* clean up */
+                    PVFS_hint_free(&vl->hints);
+                    vl->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vl = %p\n", vl);
+                    free(vl);
+                }
+                else if (!vl->is_readahead_speculative)
+                {
                     gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "--- List Processing Complete\n");
-                    /* If the main request was speculative we will
-                     * free it here because we are done with it now
-                     */
-                    if (vfs_request->is_readahead_speculative)
-                    {
-                            gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                         "--- Free speculative vfs_request\n");
-                            /* clean up */
-                            PVFS_hint_free(&vfs_request->hints);
-                            vfs_request->racache_buff = NULL;
-                            gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vfs_request = %p\n", vl);
-                            free(vfs_request);
-                        /* done with this vfs_request */
-                        continue; /* for i loop */
-                    }
-#if 0
-                    /* spec requests are not part of the main pool
-                     * they are malloced so we need to free them
-                     * here and not repost them
+                                "--- Racache downcall write %p \n", vl);
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vreq = %p\n", vfs_request);
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Copy vl = %p\n", vl);
+                    /* first vl equals vfs_request so don't need
+                     * to copy these
                      */
-                    if (vfs_request->is_readahead_speculative)
+                    if (vl != vfs_request)
                     {
-                        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                     "--- Free speculative vfs_request\n");
-                        free(vfs_request);
+                        vl->out_downcall.status =
+                                        vfs_request->out_downcall.status;
+                        vl->out_downcall.type =
+                                        vfs_request->out_downcall.type;
                     }
-#endif
-                    /* see if this buffer is a remainder from a resize
-                     * and if so deal with it directly
-                     */
-                    if (buff->resizing)
+
+                    ret = write_downcall(vl);
+                    if (ret < 0)
                     {
-                        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                                     "--- Finish resizing a buffer\n");
-                        /* this wipes the buffer so don't try to use it
-                         * after this
-                         */
-                        pint_racache_finish_resize(buff);
-                        continue; /* for i loop */
+                        gossip_err(
+                            "--- write_downcall failed "
+                            "(tag=%lld)\n", lld(vl->info.tag));
                     }
-                    /* if buffer being freed then add to free list 
-                     * and remove from lru and buffer lists
-                     */
-                    if (buff->being_freed)
+
+                    /* clean up */
+                    vl->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                "--- Repost unexp %p\n", vl);
+                    ret = repost_unexp_vfs_request(vl,
+                                               "waiting_completion");
+                    if (ret < 0)
                     {
-                        gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                     "--- Buffer %d made free\n",
-                                     buff->buff_id);
-                        pint_racache_make_free(buff);
-                        vfs_request->racache_buff = NULL;
+                        gossip_err(
+                            "--- repost_unexp_vfs_request failed "
+                            "(tag=%lld)\n", lld(vl->info.tag));
                     }
-                    /* whether an racache op is spec or not we called
-                     * downcall and repost on it above as the primary
-                     * is also considered a waiter.
-                     */
-                    gossip_debug(GOSSIP_RACACHE_DEBUG,
-                                 "--- Racache transaction %p complete\n",
-                                 vfs_request);
-                    continue; /* for i loop */
                 }
-#endif
-                /* this handles non-readahead non-cancelled requests 
-                 * and racache hits which act like regular requests
-                 */
+            } /* while link */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "--- List Processing Complete\n");
+            /* If the main request was speculative we will
+             * free it here because we are done with it now
+             */
+            if (vfs_request->is_readahead_speculative)
+            {
+                    gossip_debug(GOSSIP_RACACHE_DEBUG,
+                                 "--- Free speculative vfs_request\n");
+                    /* clean up */
+                    PVFS_hint_free(&vfs_request->hints);
+                    vfs_request->racache_buff = NULL;
+                    gossip_debug(GOSSIP_RACACHE_DEBUG, "Free vfs_request = %p\n", vl);
+                    free(vfs_request);
+                /* done with this vfs_request */
+                return;
+            }
+#if 0
+            /* spec requests are not part of the main pool
+             * they are malloced so we need to free them
+             * here and not repost them
+             */
+            if (vfs_request->is_readahead_speculative)
+            {
                 gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
-                             "normal downcall write\n");
-                ret = write_downcall(vfs_request);
-                ret = repost_unexp_vfs_request(vfs_request,
-                                               "normal_completion");
-                assert(ret == 0);
+                             "--- Free speculative vfs_request\n");
+                free(vfs_request);
             }
-            else
+#endif
+            /* see if this buffer is a remainder from a resize
+             * and if so deal with it directly
+             */
+            if (buff->resizing)
             {
-                /* this handles cancelled requests 
-                 * we cannot cancel a speculative request because
-                 * the kernel and user don't know it exists - we just
-                 * let them run and free resources later if they are
-                 * nolonger needed.
+                gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                             "--- Finish resizing a buffer\n");
+                /* this wipes the buffer so don't try to use it
+                 * after this
                  */
-                gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "skipping "
-                             "downcall write due to previous "
-                             "cancellation\n");
-                /* normal request just repost */
-                ret = repost_unexp_vfs_request(vfs_request, "cancellation");
-                assert(ret == 0);
+                pint_racache_finish_resize(buff);
+                return;
+            }
+            /* if buffer being freed then add to free list 
+             * and remove from lru and buffer lists
+             */
+            if (buff->being_freed)
+            {
+                gossip_debug(GOSSIP_RACACHE_DEBUG,
+                             "--- Buffer %d made free\n",
+                             buff->buff_id);
+                pint_racache_make_free(buff);
+                vfs_request->racache_buff = NULL;
             }
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Done with Request(%d)\n",i);
-            gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "***\n");
+            /* whether an racache op is spec or not we called
+             * downcall and repost on it above as the primary
+             * is also considered a waiter.
+             */
+            gossip_debug(GOSSIP_RACACHE_DEBUG,
+                         "--- Racache transaction %p complete\n",
+                         vfs_request);
+            return;
+        }
+#endif
+        /* this handles non-readahead non-cancelled requests 
+         * and racache hits which act like regular requests
+         */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                     "normal downcall write\n");
+        ret = write_downcall(vfs_request);
+        ret = repost_unexp_vfs_request(vfs_request,
+                                       "normal_completion");
+        assert(ret == 0);
+    }
+    else
+    {
+        /* this handles cancelled requests 
+         * we cannot cancel a speculative request because
+         * the kernel and user don't know it exists - we just
+         * let them run and free resources later if they are
+         * nolonger needed.
+         */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "skipping "
+                     "downcall write due to previous "
+                     "cancellation\n");
+        /* normal request just repost */
+        ret = repost_unexp_vfs_request(vfs_request, "cancellation");
+        assert(ret == 0);
+    }
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Done with Request\n");
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "***\n");
+}
+
+/* process_vfs_requests()
+ *
+ * posts the initial device reads and runs the main event loop until a
+ * signal stops the client
+ */
+static PVFS_error process_vfs_requests(void)
+{
+    PVFS_error ret = 0; 
+    int op_count = 0, i = 0;
+    int batch_size = PVFS_util_min(s_opts.max_ops, MAX_TESTANY_OPS);
+    vfs_request_t *vfs_request = NULL;
+    vfs_request_t *vfs_request_array[MAX_TESTANY_OPS] = {NULL};
+    PVFS_sys_op_id op_id_array[MAX_TESTANY_OPS];
+    int error_code_array[MAX_TESTANY_OPS] = {0};
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "process_vfs_requests called\n");
+
+    s_vfs_request_array = (vfs_request_t **)calloc(
+        s_opts.max_ops, sizeof(vfs_request_t *));
+    if (!s_vfs_request_array)
+    {
+        return -PVFS_ENOMEM;
+    }
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Post Initial Unexp Requests\n");
+    /* allocate and post all of our initial unexpected vfs requests */
+    for(i = 0; i < s_opts.max_ops; i++)
+    {
+        vfs_request = (vfs_request_t *)malloc(sizeof(vfs_request_t));
+        assert(vfs_request);
+
+        s_vfs_request_array[i] = vfs_request;
+
+        memset(vfs_request, 0, sizeof(vfs_request_t));
+        vfs_request->is_dev_unexp = 1;
+
+        ret = PINT_sys_dev_unexp(&vfs_request->info,
+                                 &vfs_request->jstat,
+                                 &vfs_request->op_id,
+                                 vfs_request);
+
+        if (ret < 0)
+        {
+	    PVFS_perror_gossip("PINT_sys_dev_unexp()", ret);
+            return -PVFS_ENOMEM;
+        }
+    }
+
+    ret = start_vfs_workers(s_opts.worker_threads);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    /*
+      signal the remount thread to go ahead with the remount attempts
+      since we're ready to handle requests now
+    */
+    pthread_mutex_unlock(&remount_mutex);
+
+    gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Start Processing Loop\n");
+    while(s_client_is_processing)
+    {
+        op_count = batch_size;
+        memset(error_code_array, 0, (MAX_TESTANY_OPS * sizeof(int)));
+        memset(vfs_request_array, 0,
+               (MAX_TESTANY_OPS * sizeof(vfs_request_t *)));
+
+#if 0
+        /* generates too much logging, but useful sometimes */
+        gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                 "Calling PVFS_sys_testany for new requests\n");
+#endif
+
+        /*
+          don't block in the job layer while completions are parked
+          behind a worker thread; it lets go of them almost at once
+        */
+        if (s_deferred_count)
+        {
+            sched_yield();
+        }
+
+        /* gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "PVFS_sys_testany\n"); */
+        ret = PVFS_sys_testany(op_id_array,
+                               &op_count,
+                               (void *)vfs_request_array,
+                               error_code_array,
+                               (s_deferred_count ? 0 :
+                                PVFS2_CLIENT_DEFAULT_TEST_TIMEOUT_MS));
+
+        if (s_deferred_count)
+        {
+            process_deferred_completions();
+        }
+
+        /* gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Process Request Array\n"); */
+        for(i = 0; i < op_count; i++)
+        {
+            gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
+                         "Process Request Array(%d)\n",i);
+            process_vfs_completion(vfs_request_array[i],
+                                   op_id_array[i],
+                                   error_code_array[i]);
         } /* for i loop */
 
         /* The status of the remount thread needs to be checked in the event 
@@ -5038,11 +5437,13 @@ static PVFS_error process_vfs_requests(void)
             gossip_debug(GOSSIP_CLIENTCORE_DEBUG,
                          "%s: remount not completed successfully, no longer "
                          "handling requests.\n", __func__);
+            stop_vfs_workers();
             return -PVFS_EAGAIN; 
         }
     }
     gossip_err("Client Core Caught Signal %d - Halt Processing\n",
                s_client_signal);
+    stop_vfs_workers();
     return 0;
 }
 
@@ -5304,7 +5705,14 @@ int main(int argc, char **argv)
     }   
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Initialize Device\n");
-    ret = PINT_dev_initialize("/dev/pvfs2-req", 0);
+    if (s_opts.replay_socket)
+    {
+        ret = PINT_dev_initialize(s_opts.replay_socket, PINT_DEV_REPLAY);
+    }
+    else
+    {
+        ret = PINT_dev_initialize("/dev/pvfs2-req", 0);
+    }
     if (ret < 0)
     {
         PVFS_perror_gossip("PINT_dev_initialize", ret);
@@ -5312,6 +5720,16 @@ int main(int argc, char **argv)
         return -PVFS_EDEVINIT;
     }
 
+    if (s_opts.record_upcalls)
+    {
+        ret = PINT_dev_record_upcalls(s_opts.record_upcalls);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("PINT_dev_record_upcalls", ret);
+            return ret;
+        }
+    }
+
     /* setup a mapped region for I/O transfers */
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Setup I/O Transfer Regions\n");
     memset(s_io_desc, 0 , NUM_MAP_DESC * sizeof(struct PVFS_dev_map_desc));
@@ -5371,12 +5789,18 @@ int main(int argc, char **argv)
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Freeing Allocated Resources\n");
     /* free all allocated resources */
-    for(i = 0; i < MAX_NUM_OPS; i++)
+    for(i = 0; s_vfs_request_array && i < s_opts.max_ops; i++)
     {
+        if (!s_vfs_request_array[i])
+        {
+            break;
+        }
         PINT_dev_release_unexpected(&s_vfs_request_array[i]->info);
         PINT_sys_release(s_vfs_request_array[i]->op_id);
         free(s_vfs_request_array[i]);
     }
+    free(s_vfs_request_array);
+    s_vfs_request_array = NULL;
 
     gossip_debug(GOSSIP_CLIENTCORE_DEBUG, "Close Job Context\n");
     job_close_context(s_client_dev_context);
@@ -5482,6 +5906,14 @@ static void print_help(char *progname)
     printf("--desc-count=VALUE            overrides the default # of kernel buffer descriptors\n");
     printf("--desc-size=VALUE             overrides the default size of each kernel buffer descriptor\n");
     printf("--events=EVENT_LIST           specify the events to enable\n");
+    printf("--max-ops=VALUE               number of operations in flight at once "
+           "(default is %d)\n", DEFAULT_NUM_OPS);
+    printf("--threads=VALUE               number of worker threads "
+           "(default is 0)\n");
+    printf("--replay-socket=PATH          take upcalls from an upcall replay "
+           "harness instead of the kernel\n");
+    printf("--record-upcalls=FILE         record every upcall to FILE for "
+           "later replay\n");
 }
 
 static void parse_args(int argc, char **argv, options_t *opts)
@@ -5525,12 +5957,17 @@ static void parse_args(int argc, char **argv, options_t *opts)
         {"events",1,0,0},
         {"keypath",1,0,0},
         {"bmi-opts",1,0,0},
+        {"max-ops",1,0,0},
+        {"threads",1,0,0},
+        {"replay-socket",1,0,0},
+        {"record-upcalls",1,0,0},
         {0,0,0,0}
     };
 
     assert(opts);
     opts->perf_time_interval_secs = PERF_DEFAULT_UPDATE_INTERVAL / 1000;
     opts->perf_history_size = PERF_DEFAULT_HISTORY_SIZE;
+    opts->max_ops = DEFAULT_NUM_OPS;
 
     while((ret = getopt_long(argc, argv, "ha:n:c:L:b:",
                              long_opts, &option_index)) != -1)
@@ -5831,6 +6268,38 @@ static void parse_args(int argc, char **argv, options_t *opts)
                 {
                     opts->bmi_opts = optarg;
                 }
+                else if (strcmp("max-ops", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%d", &opts->max_ops);
+                    if ((ret != 1) || (opts->max_ops < 1) ||
+                        (opts->max_ops > MAX_NUM_OPS))
+                    {
+                        gossip_err(
+                            "Error: max-ops must be between 1 and %d.\n",
+                            MAX_NUM_OPS);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if (strcmp("threads", cur_option) == 0)
+                {
+                    ret = sscanf(optarg, "%d", &opts->worker_threads);
+                    if ((ret != 1) || (opts->worker_threads < 0) ||
+                        (opts->worker_threads > MAX_WORKER_THREADS))
+                    {
+                        gossip_err(
+                            "Error: threads must be between 0 and %d.\n",
+                            MAX_WORKER_THREADS);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                else if (strcmp("replay-socket", cur_option) == 0)
+                {
+                    opts->replay_socket = optarg;
+                }
+                else if (strcmp("record-upcalls", cur_option) == 0)
+                {
+                    opts->record_upcalls = optarg;
+                }
                 break;
             case 'h':
           do_help:
@@ -5900,6 +6369,20 @@ static void parse_args(int argc, char **argv, options_t *opts)
     {
         opts->logtype = "file";
     }
+
+    /*
+      worker threads share the sysint with the main thread, which is
+      only safe when it was built with real locks; the readahead cache
+      keeps state that is only ever touched from the main loop
+    */
+#if !defined(__GEN_POSIX_LOCKING__) || defined(USE_RA_CACHE)
+    if (opts->worker_threads)
+    {
+        gossip_err("Warning: worker threads need a threaded client core "
+                   "without the readahead cache; ignoring --threads.\n");
+        opts->worker_threads = 0;
+    }
+#endif
 }
 
 static void reset_acache_timeout(void)
@@ -6480,7 +6963,7 @@ static PVFS_credential *generate_credential(PVFS_uid uid, PVFS_gid gid)
 
 #define CRED_TIMEOUT_BUFFER 5
 
-static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
+static PVFS_credential *lookup_cached_credential(PVFS_uid uid, PVFS_gid gid)
 {
     struct credential_key ckey;
     struct credential_payload *cpayload;
@@ -6571,6 +7054,18 @@ static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
     return credential;
 }
 
+/* the credential cache is shared by the worker threads */
+static PVFS_credential *lookup_credential(PVFS_uid uid, PVFS_gid gid)
+{
+    PVFS_credential *credential;
+
+    pthread_mutex_lock(&credential_cache_mutex);
+    credential = lookup_cached_credential(uid, gid);
+    pthread_mutex_unlock(&credential_cache_mutex);
+
+    return credential;
+}
+
 /* remove credential from cache */
 void remove_credential(PVFS_uid uid,
                        PVFS_gid gid)
@@ -6586,6 +7081,7 @@ void remove_credential(PVFS_uid uid,
     ckey.gid = gid;
 
     /* lookup credential */
+    pthread_mutex_lock(&credential_cache_mutex);
     ret = PINT_tcache_lookup(credential_cache, &ckey, &entry, &status);
 
     if (ret == 0)
@@ -6599,7 +7095,7 @@ void remove_credential(PVFS_uid uid,
         gossip_debug(GOSSIP_SECURITY_DEBUG, "... cache lookup returned %d\n", 
                      ret);
     }
-
+    pthread_mutex_unlock(&credential_cache_mutex);
 }
 
 /*
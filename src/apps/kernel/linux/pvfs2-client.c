@@ -77,6 +77,8 @@ typedef struct
     char *readahead_readcnt;
     char *readahead_pinned;
     char *bmi_opts;
+    char *max_ops;
+    char *threads;
 } options_t;
 
 static void client_sig_handler(int signum);
@@ -529,6 +531,18 @@ static int monitor_pvfs2_client(options_t *opts)
                 arg_list[arg_index+1] = opts->bmi_opts;
                 arg_index+=2;
             }
+            if (opts->max_ops)
+            {
+                arg_list[arg_index] = "--max-ops";
+                arg_list[arg_index+1] = opts->max_ops;
+                arg_index+=2;
+            }
+            if (opts->threads)
+            {
+                arg_list[arg_index] = "--threads";
+                arg_list[arg_index+1] = opts->threads;
+                arg_index+=2;
+            }
 
             if(opts->verbose)
             {
@@ -600,6 +614,8 @@ static void print_help(char *progname)
     printf("--events=EVENTS               enable tracing of certain EVENTS\n");
     printf("--keypath=PATH                path to credential key file\n");
     printf("--bmi-opts=\"OPTIONS\"          comma-seperated options string to pass to bmi\n");
+    printf("--max-ops=VALUE               number of operations in flight at once\n");
+    printf("--threads=VALUE               number of client core worker threads\n");
 }
 
 static void parse_args(int argc, char **argv, options_t *opts)
@@ -646,6 +662,8 @@ static void parse_args(int argc, char **argv, options_t *opts)
         {"events",1,0,0},
         {"keypath",1,0,0},
         {"bmi-opts",1,0,0},
+        {"max-ops",1,0,0},
+        {"threads",1,0,0},
         {0,0,0,0}
     };
 
@@ -805,6 +823,14 @@ static void parse_args(int argc, char **argv, options_t *opts)
                 {
                     opts->bmi_opts = optarg;
                 }
+                else if (strcmp("max-ops", cur_option) == 0)
+                {
+                    opts->max_ops = optarg;
+                }
+                else if (strcmp("threads", cur_option) == 0)
+                {
+                    opts->threads = optarg;
+                }
 
                 break;
             case 'h':
@@ -0,0 +1,817 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/*
+ * pvfs2-upcall-replay: drives a pvfs2-client-core without the kernel
+ * module by feeding it an upcall stream recorded with
+ * "pvfs2-client-core --record-upcalls=FILE".  The client is started with
+ * "--replay-socket=SOCKET" and talks to this program over a unix
+ * SOCK_SEQPACKET socket using the same framing as /dev/pvfs2-req.
+ *
+ * Recorded upcalls carry the fs_id and handles of the file system they
+ * were captured against, so a replay has to run against servers
+ * serving that same file system.  Mount and unmount upcalls are
+ * replayed as barriers; everything else is kept up to the requested
+ * concurrency.  Use "-c 1" to preserve the recorded ordering exactly.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+
+#include "pvfs2-types.h"
+#include "pint-dev.h"
+#include "pvfs2-dev-proto.h"
+
+#define DEFAULT_CONCURRENCY   16
+#define MAX_CONCURRENCY     8192
+#define DOWNCALL_BUF_SIZE  (1024 * 1024)
+#define REPLAY_IDLE_TIMEOUT_MS 30000
+
+/* the header the device prepends to each upcall and downcall */
+#define DEV_HEADER_SIZE (2 * sizeof(int32_t) + sizeof(uint64_t))
+
+typedef struct
+{
+    char *sock_name;
+    char *record_file;
+    char *config_server;
+    int concurrency;
+    int passes;
+    int verbose;
+} options_t;
+
+/* one upcall loaded from the record file */
+typedef struct
+{
+    pvfs2_upcall_t *upcall;
+    uint32_t upcall_size;
+    char *trailer;
+    uint32_t trailer_size;
+} replay_op_t;
+
+/* one upcall the client has not answered yet */
+typedef struct
+{
+    int in_use;
+    uint64_t tag;
+    int32_t type;
+    double start;
+} replay_slot_t;
+
+typedef struct
+{
+    int32_t type;
+    char *name;
+    uint64_t count;
+    uint64_t errors;
+    double total_latency;
+} op_stats_t;
+
+static options_t s_opts;
+static int s_fd = -1;
+static int32_t s_magic;
+
+static replay_slot_t *s_slots = NULL;
+static int s_outstanding = 0;
+static uint64_t s_next_seq = 0;
+
+static double *s_latencies = NULL;
+static uint64_t s_latency_count = 0;
+static uint64_t s_latency_max = 0;
+
+static op_stats_t s_op_stats[] =
+{
+    { PVFS2_VFS_OP_FILE_IO, "file_io", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_LOOKUP, "lookup", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_CREATE, "create", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_GETATTR, "getattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_REMOVE, "remove", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_MKDIR, "mkdir", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_READDIR, "readdir", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_READDIRPLUS, "readdirplus", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_SETATTR, "setattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_SYMLINK, "symlink", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_RENAME, "rename", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_STATFS, "statfs", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_TRUNCATE, "truncate", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_RA_FLUSH, "ra_flush", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FS_MOUNT, "fs_mount", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FS_UMOUNT, "fs_umount", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_GETXATTR, "getxattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_SETXATTR, "setxattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_LISTXATTR, "listxattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_REMOVEXATTR, "removexattr", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_PARAM, "param", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_PERF_COUNT, "perf_count", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FSYNC, "fsync", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FSKEY, "fskey", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FILE_IOX, "file_iox", 0, 0, 0.0 },
+    { PVFS2_VFS_OP_FEATURES, "features", 0, 0, 0.0 },
+    { 0, "unknown", 0, 0, 0.0 }
+};
+
+static void usage(int argc, char **argv);
+static int parse_args(int argc, char **argv, options_t *opts);
+static int load_record(const char *path, replay_op_t **ops, int *op_count);
+static int accept_client(const char *sock_name);
+static int read_downcall(void);
+static int wait_socket(short events);
+static int send_packet(struct iovec *iov, int count, ssize_t total);
+static int send_upcall(replay_op_t *op);
+static int reap_downcalls(int min_outstanding);
+static void report(uint64_t sent, double elapsed);
+
+static double wtime(void)
+{
+    struct timeval t;
+
+    gettimeofday(&t, NULL);
+    return ((double)t.tv_sec + (double)t.tv_usec / 1000000.0);
+}
+
+static op_stats_t *lookup_op_stats(int32_t type)
+{
+    int i;
+    int limit = (int)(sizeof(s_op_stats) / sizeof(op_stats_t));
+
+    for (i = 0; i < limit - 1; i++)
+    {
+        if (s_op_stats[i].type == type)
+        {
+            return &s_op_stats[i];
+        }
+    }
+    return &s_op_stats[limit - 1];
+}
+
+static int is_barrier(int32_t type)
+{
+    return ((type == PVFS2_VFS_OP_FS_MOUNT) ||
+            (type == PVFS2_VFS_OP_FS_UMOUNT));
+}
+
+int main(int argc, char **argv)
+{
+    replay_op_t *ops = NULL;
+    int op_count = 0;
+    int i, pass, ret;
+    uint64_t sent = 0;
+    double start, elapsed;
+
+    if (parse_args(argc, argv, &s_opts) < 0)
+    {
+        usage(argc, argv);
+        return 1;
+    }
+
+    if (load_record(s_opts.record_file, &ops, &op_count) < 0)
+    {
+        return 1;
+    }
+
+    s_slots = calloc(s_opts.concurrency, sizeof(replay_slot_t));
+    s_latency_max = (uint64_t)op_count * s_opts.passes;
+    s_latencies = calloc(s_latency_max ? s_latency_max : 1, sizeof(double));
+    if (!s_slots || !s_latencies)
+    {
+        fprintf(stderr, "Error: out of memory.\n");
+        return 1;
+    }
+
+    if (accept_client(s_opts.sock_name) < 0)
+    {
+        return 1;
+    }
+
+    start = wtime();
+    for (pass = 0; pass < s_opts.passes; pass++)
+    {
+        for (i = 0; i < op_count; i++)
+        {
+            if (ops[i].upcall->type == PVFS2_VFS_OP_CANCEL)
+            {
+                /* the op it named was never outstanding in this replay */
+                continue;
+            }
+
+            if (is_barrier(ops[i].upcall->type))
+            {
+                ret = reap_downcalls(0);
+            }
+            else
+            {
+                ret = reap_downcalls(s_opts.concurrency - 1);
+            }
+            if (ret < 0)
+            {
+                goto replay_done;
+            }
+
+            if (send_upcall(&ops[i]) < 0)
+            {
+                goto replay_done;
+            }
+            sent++;
+
+            if (is_barrier(ops[i].upcall->type) && (reap_downcalls(0) < 0))
+            {
+                goto replay_done;
+            }
+        }
+    }
+    reap_downcalls(0);
+
+replay_done:
+    elapsed = wtime() - start;
+    report(sent, elapsed);
+
+    close(s_fd);
+    unlink(s_opts.sock_name);
+    for (i = 0; i < op_count; i++)
+    {
+        free(ops[i].upcall);
+        free(ops[i].trailer);
+    }
+    free(ops);
+    free(s_slots);
+    free(s_latencies);
+    return ((s_outstanding == 0) ? 0 : 1);
+}
+
+/* load_record()
+ *
+ * reads every upcall in a recording made by the client core
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int load_record(const char *path, replay_op_t **ops, int *op_count)
+{
+    struct PINT_dev_record_header header;
+    struct PINT_dev_upcall_record rec;
+    replay_op_t *op_array = NULL, *tmp;
+    int count = 0, size = 0;
+    FILE *f;
+
+    f = fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "Error: could not open %s: %s\n",
+                path, strerror(errno));
+        return -1;
+    }
+
+    if ((fread(&header, sizeof(header), 1, f) != 1) ||
+        memcmp(header.magic, PINT_DEV_RECORD_MAGIC, sizeof(header.magic)))
+    {
+        fprintf(stderr, "Error: %s is not an upcall recording.\n", path);
+        goto load_error;
+    }
+
+    if ((header.proto_ver != PVFS_KERNEL_PROTO_VERSION) ||
+        (header.upcall_size != sizeof(pvfs2_upcall_t)))
+    {
+        fprintf(stderr, "Error: %s was recorded by an incompatible "
+                "client (protocol %d, upcall size %d).\n",
+                path, header.proto_ver, header.upcall_size);
+        goto load_error;
+    }
+
+    while (fread(&rec, sizeof(rec), 1, f) == 1)
+    {
+        if ((rec.upcall_size == 0) ||
+            (rec.upcall_size > sizeof(pvfs2_upcall_t)))
+        {
+            fprintf(stderr, "Error: corrupt upcall record %d.\n", count);
+            goto load_error;
+        }
+
+        if (count == size)
+        {
+            size = (size ? size * 2 : 1024);
+            tmp = realloc(op_array, size * sizeof(replay_op_t));
+            if (!tmp)
+            {
+                fprintf(stderr, "Error: out of memory.\n");
+                goto load_error;
+            }
+            op_array = tmp;
+        }
+
+        memset(&op_array[count], 0, sizeof(replay_op_t));
+        op_array[count].upcall = calloc(1, sizeof(pvfs2_upcall_t));
+        op_array[count].upcall_size = rec.upcall_size;
+        op_array[count].trailer_size = rec.trailer_size;
+        if (rec.trailer_size)
+        {
+            op_array[count].trailer = malloc(rec.trailer_size);
+        }
+        if (!op_array[count].upcall ||
+            (rec.trailer_size && !op_array[count].trailer))
+        {
+            fprintf(stderr, "Error: out of memory.\n");
+            count++;
+            goto load_error;
+        }
+        count++;
+
+        if ((fread(op_array[count - 1].upcall, rec.upcall_size, 1, f) != 1) ||
+            (rec.trailer_size &&
+             (fread(op_array[count - 1].trailer,
+                    rec.trailer_size, 1, f) != 1)))
+        {
+            fprintf(stderr, "Error: truncated upcall record %d.\n",
+                    count - 1);
+            goto load_error;
+        }
+
+        if (s_opts.config_server &&
+            (op_array[count - 1].upcall->type == PVFS2_VFS_OP_FS_MOUNT))
+        {
+            pvfs2_fs_mount_request_t *mnt =
+                &op_array[count - 1].upcall->req.fs_mount;
+
+            memset(mnt->pvfs2_config_server, 0,
+                   sizeof(mnt->pvfs2_config_server));
+            strncpy(mnt->pvfs2_config_server, s_opts.config_server,
+                    sizeof(mnt->pvfs2_config_server) - 1);
+        }
+    }
+    fclose(f);
+
+    printf("loaded %d upcalls from %s\n", count, path);
+    *ops = op_array;
+    *op_count = count;
+    return 0;
+
+load_error:
+    fclose(f);
+    while (count-- > 0)
+    {
+        free(op_array[count].upcall);
+        free(op_array[count].trailer);
+    }
+    free(op_array);
+    return -1;
+}
+
+/* accept_client()
+ *
+ * waits for a client core to connect and sends it the device parameters
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int accept_client(const char *sock_name)
+{
+    struct sockaddr_un addr;
+    struct PINT_dev_replay_hello hello;
+    int listen_fd;
+
+    if (strlen(sock_name) >= sizeof(addr.sun_path))
+    {
+        fprintf(stderr, "Error: socket name %s is too long.\n", sock_name);
+        return -1;
+    }
+
+    listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (listen_fd < 0)
+    {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock_name);
+    unlink(sock_name);
+    if ((bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(listen_fd, 1) < 0))
+    {
+        perror("bind");
+        close(listen_fd);
+        return -1;
+    }
+
+    printf("waiting for pvfs2-client-core --replay-socket=%s\n", sock_name);
+    s_fd = accept(listen_fd, NULL, NULL);
+    close(listen_fd);
+    if (s_fd < 0)
+    {
+        perror("accept");
+        return -1;
+    }
+
+    s_magic = (int32_t)(getpid() ^ time(NULL));
+    memset(&hello, 0, sizeof(hello));
+    hello.magic = s_magic;
+    hello.max_upsize = DEV_HEADER_SIZE + sizeof(pvfs2_upcall_t);
+    hello.max_downsize = DEV_HEADER_SIZE + sizeof(pvfs2_downcall_t);
+    if (write(s_fd, &hello, sizeof(hello)) != sizeof(hello))
+    {
+        perror("write");
+        return -1;
+    }
+
+    /* downcalls are read whenever we would otherwise wait to send */
+    if (fcntl(s_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+        perror("fcntl");
+        return -1;
+    }
+    return 0;
+}
+
+/* read_downcall()
+ *
+ * reads and accounts for one downcall if the client has written one
+ *
+ * returns 1 if a downcall was read, 0 if none was waiting, -1 on failure
+ */
+static int read_downcall(void)
+{
+    static char *buf = NULL;
+    pvfs2_downcall_t *down;
+    op_stats_t *stats;
+    int32_t *magic;
+    uint64_t *tag;
+    ssize_t ret;
+    int slot;
+
+    if (!buf && !(buf = malloc(DOWNCALL_BUF_SIZE)))
+    {
+        fprintf(stderr, "Error: out of memory.\n");
+        return -1;
+    }
+
+    ret = read(s_fd, buf, DOWNCALL_BUF_SIZE);
+    if (ret < 0 && (errno == EAGAIN || errno == EINTR))
+    {
+        return 0;
+    }
+    if (ret <= 0)
+    {
+        fprintf(stderr, "Error: client core disconnected.\n");
+        return -1;
+    }
+    if (ret < (ssize_t)(DEV_HEADER_SIZE + sizeof(pvfs2_downcall_t)))
+    {
+        fprintf(stderr, "Error: short downcall (%zd bytes).\n", ret);
+        return -1;
+    }
+
+    magic = (int32_t *)(buf + sizeof(int32_t));
+    tag = (uint64_t *)(buf + 2 * sizeof(int32_t));
+    down = (pvfs2_downcall_t *)(buf + DEV_HEADER_SIZE);
+    if (*magic != s_magic)
+    {
+        fprintf(stderr, "Error: downcall magic does not match.\n");
+        return -1;
+    }
+
+    slot = (int)(*tag & 0xffff);
+    if ((slot >= s_opts.concurrency) || !s_slots[slot].in_use ||
+        (s_slots[slot].tag != *tag))
+    {
+        fprintf(stderr, "Warning: unexpected downcall tag %llu.\n",
+                (unsigned long long)*tag);
+        return 1;
+    }
+
+    stats = lookup_op_stats(s_slots[slot].type);
+    stats->count++;
+    if (down->status != 0)
+    {
+        stats->errors++;
+    }
+    s_latencies[s_latency_count] = wtime() - s_slots[slot].start;
+    stats->total_latency += s_latencies[s_latency_count];
+    if (s_latency_count < s_latency_max - 1)
+    {
+        s_latency_count++;
+    }
+
+    if (s_opts.verbose)
+    {
+        printf("done %s (tag %llu) status %d\n", stats->name,
+               (unsigned long long)*tag, down->status);
+    }
+    s_slots[slot].in_use = 0;
+    s_outstanding--;
+    return 1;
+}
+
+/* wait_socket()
+ *
+ * waits for the socket to become ready for events, reading any
+ * downcalls that arrive meanwhile so the client never stalls on a
+ * full socket while we do
+ *
+ * returns 0 when ready, -1 on failure or timeout
+ */
+static int wait_socket(short events)
+{
+    struct pollfd pfd;
+    int ret;
+
+    while (1)
+    {
+        pfd.fd = s_fd;
+        pfd.events = (events | POLLIN);
+        pfd.revents = 0;
+        ret = poll(&pfd, 1, REPLAY_IDLE_TIMEOUT_MS);
+        if (ret < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (ret <= 0)
+        {
+            fprintf(stderr, "Error: client core stopped answering "
+                    "(%d upcalls outstanding).\n", s_outstanding);
+            return -1;
+        }
+        if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            fprintf(stderr, "Error: client core disconnected.\n");
+            return -1;
+        }
+        if (pfd.revents & POLLIN)
+        {
+            if (read_downcall() < 0)
+            {
+                return -1;
+            }
+            if (events == POLLIN)
+            {
+                return 0;
+            }
+        }
+        if (pfd.revents & events)
+        {
+            return 0;
+        }
+    }
+}
+
+/* send_packet()
+ *
+ * writes one packet to the client, draining downcalls while it waits
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int send_packet(struct iovec *iov, int count, ssize_t total)
+{
+    ssize_t ret;
+
+    while (1)
+    {
+        ret = writev(s_fd, iov, count);
+        if (ret == total)
+        {
+            return 0;
+        }
+        if (ret >= 0 || (errno != EAGAIN && errno != EINTR))
+        {
+            perror("writev");
+            return -1;
+        }
+        if (wait_socket(POLLOUT) < 0)
+        {
+            return -1;
+        }
+    }
+}
+
+/* send_upcall()
+ *
+ * hands one upcall to the client in a free slot; the trailer follows
+ * as its own packet, which the client core expects in replay mode
+ *
+ * returns 0 on success, -1 on failure
+ */
+static int send_upcall(replay_op_t *op)
+{
+    int32_t proto_ver = PVFS_KERNEL_PROTO_VERSION;
+    struct iovec iov[4];
+    uint64_t tag;
+    int slot;
+
+    for (slot = 0; slot < s_opts.concurrency; slot++)
+    {
+        if (!s_slots[slot].in_use)
+        {
+            break;
+        }
+    }
+    if (slot == s_opts.concurrency)
+    {
+        fprintf(stderr, "Error: no free replay slot.\n");
+        return -1;
+    }
+
+    /* low bits name the slot, high bits keep tags unique */
+    tag = (++s_next_seq << 16) | (uint64_t)slot;
+
+    op->upcall->trailer_size = op->trailer_size;
+    op->upcall->trailer_buf = NULL;
+
+    /* claim the slot first; its downcall may be read while we send */
+    s_slots[slot].in_use = 1;
+    s_slots[slot].tag = tag;
+    s_slots[slot].type = op->upcall->type;
+    s_slots[slot].start = wtime();
+    s_outstanding++;
+
+    iov[0].iov_base = &proto_ver;
+    iov[0].iov_len = sizeof(int32_t);
+    iov[1].iov_base = &s_magic;
+    iov[1].iov_len = sizeof(int32_t);
+    iov[2].iov_base = &tag;
+    iov[2].iov_len = sizeof(uint64_t);
+    iov[3].iov_base = op->upcall;
+    iov[3].iov_len = op->upcall_size;
+    if (send_packet(iov, 4, DEV_HEADER_SIZE + op->upcall_size) < 0)
+    {
+        return -1;
+    }
+
+    if (op->trailer_size)
+    {
+        iov[0].iov_base = op->trailer;
+        iov[0].iov_len = op->trailer_size;
+        if (send_packet(iov, 1, op->trailer_size) < 0)
+        {
+            return -1;
+        }
+    }
+
+    if (s_opts.verbose)
+    {
+        printf("sent %s (tag %llu)\n",
+               lookup_op_stats(op->upcall->type)->name,
+               (unsigned long long)tag);
+    }
+    return 0;
+}
+
+/* reap_downcalls()
+ *
+ * reads downcalls until no more than min_outstanding upcalls remain
+ * unanswered
+ *
+ * returns 0 on success, -1 on failure or timeout
+ */
+static int reap_downcalls(int min_outstanding)
+{
+    while (s_outstanding > min_outstanding)
+    {
+        if (wait_socket(POLLIN) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+
+    return ((x < y) ? -1 : ((x > y) ? 1 : 0));
+}
+
+static double percentile(double pct)
+{
+    uint64_t i;
+
+    if (s_latency_count == 0)
+    {
+        return 0.0;
+    }
+    i = (uint64_t)(pct * (s_latency_count - 1) / 100.0);
+    return s_latencies[i];
+}
+
+static void report(uint64_t sent, double elapsed)
+{
+    uint64_t done = 0;
+    int i;
+    int limit = (int)(sizeof(s_op_stats) / sizeof(op_stats_t));
+
+    printf("\n%-12s %10s %8s %12s\n", "op", "count", "errors", "mean(us)");
+    for (i = 0; i < limit; i++)
+    {
+        if (s_op_stats[i].count == 0)
+        {
+            continue;
+        }
+        done += s_op_stats[i].count;
+        printf("%-12s %10llu %8llu %12.1f\n", s_op_stats[i].name,
+               (unsigned long long)s_op_stats[i].count,
+               (unsigned long long)s_op_stats[i].errors,
+               s_op_stats[i].total_latency * 1000000.0 /
+               s_op_stats[i].count);
+    }
+
+    qsort(s_latencies, s_latency_count, sizeof(double), compare_double);
+    printf("\nsent %llu upcalls, %llu answered in %.3f s (%.1f ops/s)\n",
+           (unsigned long long)sent, (unsigned long long)done, elapsed,
+           (elapsed > 0.0 ? done / elapsed : 0.0));
+    printf("latency (us): p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n",
+           percentile(50) * 1000000.0, percentile(90) * 1000000.0,
+           percentile(99) * 1000000.0, percentile(100) * 1000000.0);
+}
+
+static int parse_args(int argc, char **argv, options_t *opts)
+{
+    int ch;
+
+    memset(opts, 0, sizeof(options_t));
+    opts->concurrency = DEFAULT_CONCURRENCY;
+    opts->passes = 1;
+
+    while ((ch = getopt(argc, argv, "s:f:c:n:m:vh")) != -1)
+    {
+        switch (ch)
+        {
+            case 's':
+                opts->sock_name = optarg;
+                break;
+            case 'f':
+                opts->record_file = optarg;
+                break;
+            case 'c':
+                opts->concurrency = atoi(optarg);
+                if ((opts->concurrency < 1) ||
+                    (opts->concurrency > MAX_CONCURRENCY))
+                {
+                    fprintf(stderr, "Error: concurrency must be between "
+                            "1 and %d.\n", MAX_CONCURRENCY);
+                    return -1;
+                }
+                break;
+            case 'n':
+                opts->passes = atoi(optarg);
+                if (opts->passes < 1)
+                {
+                    return -1;
+                }
+                break;
+            case 'm':
+                opts->config_server = optarg;
+                break;
+            case 'v':
+                opts->verbose = 1;
+                break;
+            default:
+                return -1;
+        }
+    }
+
+    if (!opts->sock_name || !opts->record_file)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+static void usage(int argc, char **argv)
+{
+    fprintf(stderr, "Usage: %s -s SOCKET -f RECORD [-c CONCURRENCY] "
+            "[-n PASSES] [-m CONFIG_SERVER] [-v]\n", argv[0]);
+    fprintf(stderr, "  -s SOCKET         unix socket to pass to "
+            "pvfs2-client-core --replay-socket\n");
+    fprintf(stderr, "  -f RECORD         file written by "
+            "pvfs2-client-core --record-upcalls\n");
+    fprintf(stderr, "  -c CONCURRENCY    upcalls kept outstanding "
+            "(default %d; 1 keeps recorded order)\n", DEFAULT_CONCURRENCY);
+    fprintf(stderr, "  -n PASSES         times to replay the recording "
+            "(default 1)\n");
+    fprintf(stderr, "  -m CONFIG_SERVER  override the server named in "
+            "mount upcalls\n");
+    fprintf(stderr, "  -v                print every upcall and "
+            "downcall\n");
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
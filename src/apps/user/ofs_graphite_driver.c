@@ -41,8 +41,8 @@
 #endif
 
 /* these defaults overridden by command line args */
-#define MAX_KEY_COUNTER 23
-#define MAX_KEY_TIMER 10
+#define MAX_KEY_COUNTER 28
+#define MAX_KEY_TIMER 13
 #define HISTORY 10
 #define FREQUENCY 10
 
@@ -72,6 +72,9 @@ enum PINT_perf_timer_fields
     TIMER_COUNT = 1,
     TIMER_MINIMUM = 2,
     TIMER_MAXIMUM = 3,
+    TIMER_P50 = 4,
+    TIMER_P99 = 5,
+    TIMER_P999 = 6,
 };
 
 #define GRAPHITE_CNT(str, c, s, h)                                \
@@ -128,6 +131,40 @@ do {                                                              \
     }                                                             \
 } while(0);
 
+/* one percentile of a timer, these are per interval so never diffed */
+#define GRAPHITE_TIMER_PCT(str, sfx, c, f, s, h)                  \
+do {                                                              \
+    int64_t pct = GETSAMPLE(s, h, c, f);                          \
+    if (user_opts->print)                                         \
+    {                                                             \
+        fprintf(pfile,                                            \
+                "%s%s-%s %lld %lld\n",                            \
+                samplestr,                                        \
+                str,                                              \
+                sfx,                                              \
+                (long long int)pct,                               \
+                (long long int)START_TIME(s, h)/1000);            \
+    }                                                             \
+    if (user_opts->graphite)                                      \
+    {                                                             \
+        sprintf(graphite_message,                                 \
+                "%s%s-%s %lld %lld\n",                            \
+                samplestr,                                        \
+                str,                                              \
+                sfx,                                              \
+                (long long int)pct,                               \
+                (long long int)START_TIME(s, h)/1000);            \
+        bytes_written = write(graphite_fd,                        \
+                graphite_message,                                 \
+                strlen(graphite_message) + 1);                    \
+        if(bytes_written != strlen(graphite_message) + 1)         \
+        {                                                         \
+            fprintf(stderr, "write failed\n");                    \
+        }                                                         \
+        printf("sent graphite message\n");                        \
+    }                                                             \
+} while(0)
+
 #define GRAPHITE_TIMER(str, c, s, h)                              \
 if (c >= user_opts->keys) break;                                  \
 do {                                                              \
@@ -260,6 +297,9 @@ do {                                                              \
         }                                                         \
         printf("sent graphite message\n");                        \
     }                                                             \
+    GRAPHITE_TIMER_PCT(str, "p50", c, TIMER_P50, s, h);           \
+    GRAPHITE_TIMER_PCT(str, "p99", c, TIMER_P99, s, h);           \
+    GRAPHITE_TIMER_PCT(str, "p999", c, TIMER_P999, s, h);         \
 } while(0);
 
 struct options
@@ -617,6 +657,11 @@ int main(int argc, char **argv)
                         GRAPHITE_CNT("io", PINT_PERF_IO, s, h);
                         GRAPHITE_CNT("smallio", PINT_PERF_SMALL_IO, s, h);
                         GRAPHITE_CNT("readdir", PINT_PERF_READDIR, s, h);
+                        GRAPHITE_CNT("fairwaiting", PINT_PERF_FAIR_WAITING, s, h);
+                        GRAPHITE_CNT("fairclasses", PINT_PERF_FAIR_CLASSES, s, h);
+                        GRAPHITE_CNT("fairdepth", PINT_PERF_FAIR_DEPTH, s, h);
+                        GRAPHITE_CNT("smallocs", PINT_PERF_SM_ALLOCS, s, h);
+                        GRAPHITE_CNT("smallocmisses", PINT_PERF_SM_ALLOC_MISSES, s, h);
                     }
                 }
                 else if (user_opts->ctype == PINT_PERF_TIMER)
@@ -635,6 +680,9 @@ int main(int argc, char **argv)
                         GRAPHITE_TIMER("io-time", PINT_PERF_TIO, s, h);
                         GRAPHITE_TIMER("small_io-time", PINT_PERF_TSMALL_IO, s, h);
                         GRAPHITE_TIMER("readdir-time", PINT_PERF_TREADDIR, s, h);
+                        GRAPHITE_TIMER("bmi-time", PINT_PERF_TBMI, s, h);
+                        GRAPHITE_TIMER("trove-time", PINT_PERF_TTROVE, s, h);
+                        GRAPHITE_TIMER("flow-time", PINT_PERF_TFLOW, s, h);
                     }
                 }
             }
@@ -55,7 +55,7 @@ struct acache_payload
     PVFS_size size;          /**< cached size */
 };
 
-static struct PINT_tcache* acache = NULL;
+static struct PINT_tcache_shards* acache = NULL;
 static gen_mutex_t acache_mutex = GEN_MUTEX_INITIALIZER;
 static struct PINT_perf_counter* acache_pc = NULL;
 
@@ -78,18 +78,24 @@ static struct PINT_perf_key acache_keys[] =
 
 static int PINT_acache_initialize_perf_counter(void);
 
+static void acache_count_info(void);
+
+static void acache_count_entries(void);
+
 static int acache_compare_key_entry(const void* key, struct qhash_head* link);
 
 static int acache_free_payload(void* payload);
 
 static int acache_hash_key(const void* key, int table_size);
 
-static int set_tcache_defaults(struct PINT_tcache* instance);
+static int set_tcache_defaults(struct PINT_tcache_shards* instance);
 
-static void load_payload(struct PINT_tcache* instance,
+static void load_payload(struct PINT_tcache_shard* shard,
                          PVFS_object_ref refn,
                          void* payload);
 
+static void acache_strip_size(struct acache_payload* payload);
+
 /**
  * Initializes the acache 
  * \return pointer to tcache on success, NULL on failure
@@ -109,10 +115,11 @@ int PINT_acache_initialize(void)
     gen_mutex_lock(&acache_mutex);
 
     /* create tcache instances */
-    acache = PINT_tcache_initialize(acache_compare_key_entry,
-                                    acache_hash_key,
-                                    acache_free_payload,
-                                    -1 /* default tcache table size */);
+    acache = PINT_tcache_shards_initialize(acache_compare_key_entry,
+                                           acache_hash_key,
+                                           acache_free_payload,
+                                           -1 /* default tcache table size */,
+                                           -1 /* default shard count */);
     if(!acache)
     {
         gen_mutex_unlock(&acache_mutex);
@@ -133,12 +140,12 @@ int PINT_acache_initialize(void)
     }
 #endif
 
-    ret = PINT_tcache_set_info(acache,
-                               TCACHE_TIMEOUT_MSECS,
-                               ACACHE_DEFAULT_TIMEOUT_MSECS);
+    ret = PINT_tcache_shards_set_info(acache,
+                                      TCACHE_TIMEOUT_MSECS,
+                                      ACACHE_DEFAULT_TIMEOUT_MSECS);
     if(ret < 0)
     {
-        PINT_tcache_finalize(acache);
+        PINT_tcache_shards_finalize(acache);
         gen_mutex_unlock(&acache_mutex);
         return(ret);
     }
@@ -146,7 +153,7 @@ int PINT_acache_initialize(void)
     ret = set_tcache_defaults(acache);
     if(ret < 0)
     {
-        PINT_tcache_finalize(acache);
+        PINT_tcache_shards_finalize(acache);
         gen_mutex_unlock(&acache_mutex);
         return(ret);
     }
@@ -171,7 +178,7 @@ void PINT_acache_finalize(void)
 {
     gen_mutex_lock(&acache_mutex);
 
-    PINT_tcache_finalize(acache);
+    PINT_tcache_shards_finalize(acache);
     acache = NULL;
 
     PINT_perf_finalize(acache_pc);
@@ -192,9 +199,7 @@ int PINT_acache_get_info(
 {
     int ret = -1;
 
-    gen_mutex_lock(&acache_mutex);
-    ret = PINT_tcache_get_info(acache, option, arg);
-    gen_mutex_unlock(&acache_mutex);
+    ret = PINT_tcache_shards_get_info(acache, option, arg);
 
     return(ret);
 }
@@ -212,25 +217,10 @@ int PINT_acache_set_info(
 
     gen_mutex_lock(&acache_mutex);
 
-    ret = PINT_tcache_set_info(acache, option, arg);
+    ret = PINT_tcache_shards_set_info(acache, option, arg);
 
     /* record any resulting parameter changes */
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_SOFT_LIMIT,
-                    acache->soft_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_HARD_LIMIT,
-                    acache->hard_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_ENABLED,
-                    acache->enable,
-                    PINT_PERF_SET);
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_NUM_ENTRIES,
-                    acache->num_entries,
-                    PINT_PERF_SET);
+    acache_count_info();
 
     gen_mutex_unlock(&acache_mutex);
 
@@ -251,6 +241,7 @@ int PINT_acache_get_cached_entry(
     PVFS_size* size,       /**< logical size of the object */
     int* size_status)      /**< indicates if the size has expired */
 {
+    struct PINT_tcache_shard* shard;
     struct PINT_tcache_entry* tmp_entry;
     struct acache_payload* tmp_payload;
     int ret = -1;
@@ -276,10 +267,10 @@ int PINT_acache_get_cached_entry(
     *size_status = -PVFS_ETIME;
     attr->mask = 0;
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_shard_lock(acache, &refn);
 
     /* lookup */
-    ret = PINT_tcache_lookup(acache, &refn, &tmp_entry, attr_status);
+    ret = PINT_tcache_lookup(shard->tcache, &refn, &tmp_entry, attr_status);
     if(ret < 0 || *attr_status != 0)
     {
         /* acache now operates under the principle that the attrs must be
@@ -288,7 +279,7 @@ int PINT_acache_get_cached_entry(
          * That is, at minimum the static attrs should be present and
          * potentially some dynamic attributes.
          */
-        PINT_perf_count(acache_pc, PERF_ACACHE_MISSES, 1, PINT_PERF_ADD);
+        PINT_tcache_shard_count(shard, PERF_ACACHE_MISSES, 1);
         gossip_debug(GOSSIP_ACACHE_DEBUG, "%s: miss: H=%llu\n",
                      __func__,
                      llu(refn.handle));
@@ -325,7 +316,7 @@ int PINT_acache_get_cached_entry(
                              "%s: dynamic attrs have timed out!\n",
                              __func__);
                 /* Strip the cached mask of the PVFS_ATTR_DATA_SIZE bitmask */
-                tmp_payload->attr.mask &= ~(PVFS_ATTR_DATA_SIZE);
+                acache_strip_size(tmp_payload);
             }
             else
             {
@@ -384,7 +375,7 @@ int PINT_acache_get_cached_entry(
     ret = 0;
 
 done:
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_shard_unlock(acache, shard);
     return(ret);
 }
 
@@ -395,6 +386,7 @@ void PINT_acache_invalidate(
     PVFS_object_ref refn)
 {
     int ret = -1;
+    struct PINT_tcache_shard* shard;
     struct PINT_tcache_entry* tmp_entry;
     int tmp_status;
 
@@ -403,28 +395,25 @@ void PINT_acache_invalidate(
                  __func__,
                  llu(refn.handle));
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_shard_lock(acache, &refn);
 
-    ret = PINT_tcache_lookup(acache, 
+    ret = PINT_tcache_lookup(shard->tcache, 
                              &refn,
                              &tmp_entry,
                              &tmp_status);
     if(ret == 0)
     {
-        PINT_tcache_delete(acache, tmp_entry);
-        PINT_perf_count(acache_pc,
-                        PERF_ACACHE_ATTR_INVAL,
-                        1,
-                        PINT_PERF_ADD);
+        PINT_tcache_delete(shard->tcache, tmp_entry);
+        PINT_tcache_shard_count(shard, PERF_ACACHE_ATTR_INVAL, 1);
     }
 
-    /* set the new current number of entries */
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_NUM_ENTRIES,
-                    acache->num_entries,
-                    PINT_PERF_SET);
+    PINT_tcache_shard_unlock(acache, shard);
 
-    gen_mutex_unlock(&acache_mutex);
+    if(ret == 0)
+    {
+        /* set the new current number of entries */
+        acache_count_entries();
+    }
     return;
 }
 
@@ -436,11 +425,12 @@ void PINT_acache_invalidate_size(
     PVFS_object_ref refn)
 {
     int ret = -1;
+    struct PINT_tcache_shard* shard;
     struct PINT_tcache_entry* tmp_entry;
     struct acache_payload* tmp_payload;
     int tmp_status;
 
-    gen_mutex_lock(&acache_mutex);
+    shard = PINT_tcache_shard_lock(acache, &refn);
 
     gossip_debug(GOSSIP_ACACHE_DEBUG,
                  "%s: H=%llu\n",
@@ -448,7 +438,7 @@ void PINT_acache_invalidate_size(
                  llu(refn.handle));
 
     /* find out if the entry is in the cache */
-    ret = PINT_tcache_lookup(acache, 
+    ret = PINT_tcache_lookup(shard->tcache, 
                              &refn,
                              &tmp_entry,
                              &tmp_status);
@@ -456,14 +446,11 @@ void PINT_acache_invalidate_size(
     {
         /* found match in cache; set size to invalid */
         tmp_payload = tmp_entry->payload;
-        tmp_payload->attr.mask &= ~(PVFS_ATTR_DATA_SIZE);
-        PINT_perf_count(acache_pc,
-                        PERF_ACACHE_SIZE_INVAL,
-                        1,
-                        PINT_PERF_ADD);
+        acache_strip_size(tmp_payload);
+        PINT_tcache_shard_count(shard, PERF_ACACHE_SIZE_INVAL, 1);
     }
 
-    gen_mutex_unlock(&acache_mutex);
+    PINT_tcache_shard_unlock(acache, shard);
     return;
 }
 
@@ -481,6 +468,7 @@ int PINT_acache_update(
     PVFS_size* size)        /**< logical file size (NULL if not available) */
 {
     struct acache_payload* tmp_payload = NULL;
+    struct PINT_tcache_shard* shard;
     uint32_t save_mask;
     int ret = -1;
 
@@ -514,6 +502,11 @@ int PINT_acache_update(
     save_mask = attr->mask;
     /* Don't cache size_array (indicated by PVFS_ATTR_DIR_DIRENT_COUNT). */
     attr->mask &= ~(PVFS_ATTR_CAPABILITY | PVFS_ATTR_DIR_DIRENT_COUNT);
+    /* inline file data is only as fresh as the size */
+    if(!size)
+    {
+        attr->mask &= ~(PVFS_ATTR_META_INLINE_DATA);
+    }
     ret = PINT_copy_object_attr(&tmp_payload->attr, attr);
     attr->mask = save_mask;
     if(ret != 0)
@@ -569,14 +562,11 @@ int PINT_acache_update(
                 __func__,
                  tmp_payload->attr.mask);
 
-    gen_mutex_lock(&acache_mutex);
-
-    if(tmp_payload)
-    {
-        load_payload(acache, refn, tmp_payload);
-    }
+    shard = PINT_tcache_shard_lock(acache, &refn);
+    load_payload(shard, refn, tmp_payload);
+    PINT_tcache_shard_unlock(acache, shard);
 
-    gen_mutex_unlock(&acache_mutex);
+    acache_count_entries();
     return(0);
 }
 
@@ -648,23 +638,42 @@ static int PINT_acache_initialize_perf_counter(void)
         gossip_err("%s: Error: PINT_perf_initialize failure.\n", __func__);
         return -PVFS_ENOMEM;
     }
+    acache->pc = acache_pc;
 
     /* set initial values */
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_SOFT_LIMIT,
-                    acache->soft_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_HARD_LIMIT,
-                    acache->hard_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_ENABLED,
-                    acache->enable,
-                    PINT_PERF_SET);
+    acache_count_info();
     return 0;
 }
 
+/* acache_count_info()
+ *
+ * sets the perf counter values that describe the acache configuration
+ */
+static void acache_count_info(void)
+{
+    unsigned int value;
+
+    PINT_tcache_shards_get_info(acache, TCACHE_SOFT_LIMIT, &value);
+    PINT_perf_count(acache_pc, PERF_ACACHE_SOFT_LIMIT, value, PINT_PERF_SET);
+    PINT_tcache_shards_get_info(acache, TCACHE_HARD_LIMIT, &value);
+    PINT_perf_count(acache_pc, PERF_ACACHE_HARD_LIMIT, value, PINT_PERF_SET);
+    PINT_tcache_shards_get_info(acache, TCACHE_ENABLE, &value);
+    PINT_perf_count(acache_pc, PERF_ACACHE_ENABLED, value, PINT_PERF_SET);
+    acache_count_entries();
+}
+
+/* acache_count_entries()
+ *
+ * sets the perf counter value for the number of cached entries
+ */
+static void acache_count_entries(void)
+{
+    unsigned int value;
+
+    PINT_tcache_shards_get_info(acache, TCACHE_NUM_ENTRIES, &value);
+    PINT_perf_count(acache_pc, PERF_ACACHE_NUM_ENTRIES, value, PINT_PERF_SET);
+}
+
 /* acache_compare_key_entry()
  *
  * compares an opaque key (object ref in this case) against a payload to see
@@ -712,6 +721,23 @@ static int acache_hash_key(const void* key, int table_size)
  *
  * returns 0 on success
  */
+/* acache_strip_size()
+ *
+ * forgets the size of an entry, and the inline file data that goes
+ * with it
+ */
+static void acache_strip_size(struct acache_payload* payload)
+{
+    payload->attr.mask &= ~(PVFS_ATTR_DATA_SIZE);
+    if(payload->attr.mask & PVFS_ATTR_META_INLINE_DATA)
+    {
+        free(payload->attr.u.meta.inline_data);
+        payload->attr.u.meta.inline_data = NULL;
+        payload->attr.u.meta.inline_size = 0;
+        payload->attr.mask &= ~(PVFS_ATTR_META_INLINE_DATA);
+    }
+}
+
 static int acache_free_payload(void* payload)
 {
     struct acache_payload * payload_p = payload;
@@ -726,11 +752,11 @@ static int acache_free_payload(void* payload)
     return(0);
 }
 
-static int set_tcache_defaults(struct PINT_tcache* instance)
+static int set_tcache_defaults(struct PINT_tcache_shards* instance)
 {
     int ret;
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_HARD_LIMIT,
                                ACACHE_DEFAULT_HARD_LIMIT);
     if(ret < 0)
@@ -738,7 +764,7 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
         return(ret);
     }
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_SOFT_LIMIT,
                                ACACHE_DEFAULT_SOFT_LIMIT);
     if(ret < 0)
@@ -746,7 +772,7 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
         return(ret);
     }
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_RECLAIM_PERCENTAGE,
                                ACACHE_DEFAULT_RECLAIM_PERCENTAGE);
     if(ret < 0)
@@ -757,10 +783,11 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
     return(0);
 }
 
-static void load_payload(struct PINT_tcache* instance,
+static void load_payload(struct PINT_tcache_shard* shard,
     PVFS_object_ref refn,
     void* payload)
 {
+    struct PINT_tcache* instance = shard->tcache;
     int status;
     int purged;
     struct PINT_tcache_entry* tmp_entry;
@@ -781,7 +808,7 @@ static void load_payload(struct PINT_tcache* instance,
         tmp_entry->payload = payload;
         ret = PINT_tcache_refresh_entry(instance, tmp_entry);
         /* this counts as an update of an existing entry */
-        PINT_perf_count(acache_pc, PERF_ACACHE_UPDATES, 1, PINT_PERF_ADD);
+        PINT_tcache_shard_count(shard, PERF_ACACHE_UPDATES, 1);
     }
     else
     {
@@ -792,7 +819,7 @@ static void load_payload(struct PINT_tcache* instance,
                                        &purged);
         /* I think this should count as an update of the cache, regardless of
          * if the payload had previously been inserted. */
-        PINT_perf_count(acache_pc, PERF_ACACHE_UPDATES, 1, PINT_PERF_ADD);
+        PINT_tcache_shard_count(shard, PERF_ACACHE_UPDATES, 1);
         /* the purged variable indicates how many entries had to be purged
          * from the tcache to make room for this new one
          */
@@ -801,10 +828,7 @@ static void load_payload(struct PINT_tcache* instance,
             /* since only one item was purged, we count this as one item being
              * replaced rather than as a purge and an insert 
              */
-            PINT_perf_count(acache_pc,
-                            PERF_ACACHE_REPLACEMENTS,
-                            purged, 
-                            PINT_PERF_ADD);
+            PINT_tcache_shard_count(shard, PERF_ACACHE_REPLACEMENTS, purged);
         }
         else
         {
@@ -812,16 +836,9 @@ static void load_payload(struct PINT_tcache* instance,
             /* if we didn't purge anything, then the "purged" variable will
              * be zero and this counter call won't do anything.
              */
-            PINT_perf_count(acache_pc,
-                            PERF_ACACHE_PURGES,
-                            purged,
-                            PINT_PERF_ADD);
+            PINT_tcache_shard_count(shard, PERF_ACACHE_PURGES, purged);
         }
     }
-    PINT_perf_count(acache_pc,
-                    PERF_ACACHE_NUM_ENTRIES,
-                    instance->num_entries,
-                    PINT_PERF_SET);
     return;
 }
 
@@ -43,7 +43,8 @@ extern PINT_event_id PINT_client_sys_event_id;
  * (and possible completing operations in the test() call
  */
 static int s_completion_list_index = 0;
-static PINT_smcb *s_completion_list[MAX_RETURNED_JOBS] = {NULL};
+static int s_completion_list_size = 0;
+static PINT_smcb **s_completion_list = NULL;
 static gen_mutex_t s_completion_list_mutex = GEN_MUTEX_INITIALIZER;
 static gen_mutex_t test_mutex = GEN_MUTEX_INITIALIZER;
 
@@ -60,6 +61,13 @@ int PINT_client_state_machine_initialize(void)
 void PINT_client_state_machine_finalize(void)
 {
     job_close_context(pint_client_sm_context);
+
+    gen_mutex_lock(&s_completion_list_mutex);
+    free(s_completion_list);
+    s_completion_list = NULL;
+    s_completion_list_size = 0;
+    s_completion_list_index = 0;
+    gen_mutex_unlock(&s_completion_list_mutex);
 }
 
 job_context_id PINT_client_get_sm_context(void)
@@ -70,9 +78,27 @@ job_context_id PINT_client_get_sm_context(void)
 static PVFS_error add_sm_to_completion_list(PINT_smcb *smcb)
 {
     gen_mutex_lock(&s_completion_list_mutex);
-    assert(s_completion_list_index < MAX_RETURNED_JOBS);
     if (!smcb->op_completed)
     {
+        /*
+          callers with many operations in flight can have more than
+          MAX_RETURNED_JOBS state machines terminate before the next
+          test call drains the list, so grow it on demand
+        */
+        if (s_completion_list_index == s_completion_list_size)
+        {
+            int new_size = (s_completion_list_size ?
+                            2 * s_completion_list_size : MAX_RETURNED_JOBS);
+            PINT_smcb **new_list = realloc(
+                s_completion_list, new_size * sizeof(PINT_smcb *));
+            if (!new_list)
+            {
+                gen_mutex_unlock(&s_completion_list_mutex);
+                return -PVFS_ENOMEM;
+            }
+            s_completion_list = new_list;
+            s_completion_list_size = new_size;
+        }
         smcb->op_completed = 1;
         s_completion_list[s_completion_list_index++] = smcb;
     }
@@ -129,16 +155,12 @@ static PVFS_error completion_list_retrieve_any_completed(
 {
    int i = 0, new_list_index = 0;
    PINT_smcb *smcb = NULL;
-   PINT_smcb *tmp_completion_list[MAX_RETURNED_JOBS] = {NULL};
    PINT_client_sm *sm_p;
  
    assert(op_id_array);
    assert(error_code_array);
    assert(out_count);
  
-   memset(tmp_completion_list, 0,
-          (MAX_RETURNED_JOBS * sizeof(PINT_smcb *)));
- 
    gen_mutex_lock(&s_completion_list_mutex);
    for(i = 0; i < s_completion_list_index; i++)
    {
@@ -187,15 +209,14 @@ static PVFS_error completion_list_retrieve_any_completed(
        }
        else
        {
-           tmp_completion_list[new_list_index++] = smcb;
+           /* compact in place; new_list_index never passes i */
+           s_completion_list[new_list_index++] = smcb;
        }
    }
    *out_count = PVFS_util_min(i, limit);
  
    /* clean up and adjust the list and it's book keeping */
    s_completion_list_index = new_list_index;
-   memcpy(s_completion_list, tmp_completion_list,
-          (MAX_RETURNED_JOBS * sizeof(struct PINT_smcb *)));
    
    gen_mutex_unlock(&s_completion_list_mutex);
    return 0;
@@ -217,7 +238,6 @@ static PVFS_error completion_list_retrieve_some_completed(
     int out_op_count = 0;
     int found;
     PINT_smcb *smcb = NULL;
-    PINT_smcb *tmp_completion_list[MAX_RETURNED_JOBS] = {NULL};
     PINT_client_sm *sm_p;
     PVFS_sys_op_id out_ops[MAX_RETURNED_JOBS] = {0};
 
@@ -225,9 +245,6 @@ static PVFS_error completion_list_retrieve_some_completed(
     assert(error_code_array);
     assert(out_count);
 
-    memset(tmp_completion_list, 0,
-           (MAX_RETURNED_JOBS * sizeof(PINT_smcb *)));
-
     gen_mutex_lock(&s_completion_list_mutex);
     for(i = 0; i < s_completion_list_index; i++)
     {
@@ -289,15 +306,14 @@ static PVFS_error completion_list_retrieve_some_completed(
         }
         else
         {
-            tmp_completion_list[new_list_index++] = smcb;
+            /* compact in place; new_list_index never passes i */
+            s_completion_list[new_list_index++] = smcb;
         }
     }
     *out_count = out_op_count;
 
     /* clean up and adjust the list and it's book keeping */
     s_completion_list_index = new_list_index;
-    memcpy(s_completion_list, tmp_completion_list,
-           (MAX_RETURNED_JOBS * sizeof(struct PINT_smcb *)));
     gossip_debug(GOSSIP_CLIENT_DEBUG, "%s has %d items left on completed list\n", __func__, new_list_index);    
     /* return only the op_ids that were found in the input list */
     memcpy(op_id_array, out_ops, (out_op_count * sizeof(PVFS_sys_op_id)));
@@ -383,10 +399,13 @@ struct PINT_client_op_entry_s PINT_client_sm_mgmt_table[] =
     {&pvfs2_client_mgmt_get_uid_list_sm},
     {&pvfs2_client_mgmt_get_dirdata_array_sm},
 #ifdef ENABLE_SECURITY_CERT
-    {&pvfs2_client_mgmt_get_user_cert_sm}
+    {&pvfs2_client_mgmt_get_user_cert_sm},
 #else
-    {NULL}
+    {NULL},
 #endif
+    {&pvfs2_client_mgmt_get_top_list_sm},
+    {&pvfs2_client_mgmt_remove_tree_sm},
+    {&pvfs2_client_mgmt_scan_list_sm}
 };
 
 
@@ -753,8 +772,17 @@ PVFS_error PINT_client_io_cancel(PVFS_sys_op_id id)
             gossip_debug(GOSSIP_CANCEL_DEBUG,
                          "[%d] Posting cancellation of type: FLOW\n",i);
 
-            ret = job_flow_cancel(
-                cur_ctx->flow_job_id, pint_client_sm_context);
+            /* an eager write is a BMI send in place of the flow */
+            if (cur_ctx->msg.req.u.io.eager_size)
+            {
+                ret = job_bmi_cancel(
+                    cur_ctx->flow_job_id, pint_client_sm_context);
+            }
+            else
+            {
+                ret = job_flow_cancel(
+                    cur_ctx->flow_job_id, pint_client_sm_context);
+            }
             if (ret < 0)
             {
                 PVFS_perror_gossip("job_flow_cancel failed", ret);
@@ -832,12 +860,18 @@ PVFS_error PINT_client_state_machine_test(
         return 0;
     }
 
+    /*
+      don't hold the test mutex while blocking in the job layer; other
+      threads sharing this context may need it to post new operations
+    */
+    gen_mutex_unlock(&test_mutex);
     ret = job_testcontext(job_id_array,
 			  &job_count, /* in/out parameter */
 			  smcb_p_array,
 			  job_status_array,
 			  10,
 			  pint_client_sm_context);
+    gen_mutex_lock(&test_mutex);
     assert(ret > -1);
 
     /* do as much as we can on every job that has completed */
@@ -930,13 +964,17 @@ PVFS_error PINT_client_state_machine_testany(
        return ret;
    }
  
-   /* see if there are requests ready to make progress */
+   /* see if there are requests ready to make progress; the test
+    * mutex is dropped while blocking so other threads can post
+    */
+   gen_mutex_unlock(&test_mutex);
    ret = job_testcontext(job_id_array,
                           &job_count, /* in/out parameter */
                           smcb_p_array,
                           job_status_array,
                           timeout_ms,
                           pint_client_sm_context);
+   gen_mutex_lock(&test_mutex);
  
    assert(ret > -1); /* this assert is wrong
                        * should at least test for
@@ -1031,13 +1069,17 @@ PVFS_error PINT_client_state_machine_testsome(
         return ret;
     }
 
-    /* see if there are requests ready to make progress */
+    /* see if there are requests ready to make progress; the test
+     * mutex is dropped while blocking so other threads can post
+     */
+    gen_mutex_unlock(&test_mutex);
     ret = job_testcontext(job_id_array,
 			  &job_count, /* in/out parameter */
 			  smcb_p_array,
 			  job_status_array,
 			  timeout_ms,
 			  pint_client_sm_context);
+    gen_mutex_lock(&test_mutex);
 
     assert(ret > -1); /* this assert is wrong
                        * should at least test for
@@ -1232,6 +1274,9 @@ const char *PINT_client_get_name_str(int op_type)
         { PVFS_MGMT_GET_DIRDATA_ARRAY,
           "PVFS_MGMT_GET_DIRDATA_ARRAY" },
         { PVFS_MGMT_GET_USER_CERT, "PVFS_MGMT_GET_USER_CERT" },
+        { PVFS_MGMT_GET_TOP_LIST, "PVFS_MGMT_GET_TOP_LIST" },
+        { PVFS_MGMT_REMOVE_TREE, "PVFS_MGMT_REMOVE_TREE" },
+        { PVFS_MGMT_SCAN_LIST, "PVFS_MGMT_SCAN_LIST" },
         { PVFS_SYS_GETEATTR, "PVFS_SYS_GETEATTR" },
         { PVFS_SYS_SETEATTR, "PVFS_SYS_SETEATTR" },
         { PVFS_SYS_ATOMICEATTR, "PVFS_SYS_ATOMICEATTR" },
@@ -1322,6 +1367,9 @@ PVFS_error PVFS_sys_set_info(
         case PVFS_SYS_NCACHE_TIMEOUT_MSECS:
             ret = PINT_ncache_set_info(NCACHE_TIMEOUT_MSECS, arg);
             break;
+        case PVFS_SYS_NCACHE_NEGATIVE_TIMEOUT_MSECS:
+            ret = PINT_ncache_set_info(NCACHE_NEGATIVE_TIMEOUT_MSECS, arg);
+            break;
         case PVFS_SYS_ACACHE_TIMEOUT_MSECS:
             ret = PINT_acache_set_info(ACACHE_TIMEOUT_MSECS, arg);
             break;
@@ -1361,6 +1409,9 @@ PVFS_error PVFS_sys_get_info(
         case PVFS_SYS_NCACHE_TIMEOUT_MSECS:
             ret = PINT_ncache_get_info(NCACHE_TIMEOUT_MSECS, arg);
             break;
+        case PVFS_SYS_NCACHE_NEGATIVE_TIMEOUT_MSECS:
+            ret = PINT_ncache_get_info(NCACHE_NEGATIVE_TIMEOUT_MSECS, arg);
+            break;
         case PVFS_SYS_ACACHE_TIMEOUT_MSECS:
             ret = PINT_acache_get_info(ACACHE_TIMEOUT_MSECS, arg);
             break;
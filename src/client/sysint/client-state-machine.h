@@ -288,6 +288,12 @@ typedef struct PINT_client_io_ctx
     /* should we retry the original or not? */
     uint32_t retry_original;
 
+    /* set when a read was sent to a copy picked by recent server
+     * latency: the server it counts against, and when it was posted */
+    int mirror_tracked;
+    PVFS_BMI_addr_t mirror_addr;
+    PVFS_time mirror_post_time;
+
     job_id_t flow_job_id;
     job_status_s flow_status;
     flow_descriptor flow_desc;
@@ -314,6 +320,20 @@ typedef struct PINT_client_io_ctx
     int flow_in_progress;
     int write_ack_in_progress;
 
+    /*
+      the write data of this context, when it is small enough to be
+      sent right behind the request instead of in a flow.  the request's
+      eager_size says whether the current round sends it, in which case
+      the send takes the place of the flow.  eager_refused says the
+      server had no room for it this round; the request is then resent
+      right away with the data going through a flow.
+    */
+    PVFS_size eager_size;
+    int eager_refused;
+    int eager_count;
+    void *eager_buffers[IO_MAX_REGIONS];
+    PVFS_size eager_sizes[IO_MAX_REGIONS];
+
 } PINT_client_io_ctx;
 
 struct PINT_client_io_sm
@@ -408,6 +428,7 @@ typedef struct
     PVFS_object_attr seg_attr;
     PVFS_object_ref seg_starting_refn;
     PVFS_object_ref seg_resolved_refn;
+    PVFS_time seg_ncache_version;   /* version of an expired ncache entry */
 } PINT_client_lookup_sm_segment;
 
 #define PVFS2_MAX_LOOKUP_CONTEXTS 256
@@ -497,6 +518,7 @@ struct PINT_client_mgmt_event_mon_list_sm
 {
     PVFS_fs_id fs_id;
     struct PVFS_mgmt_event **event_matrix;
+    char **event_names;
     int server_count; 
     int event_count; 
     PVFS_id_gen_t *addr_array;
@@ -622,6 +644,47 @@ struct PINT_client_mgmt_get_uid_list_sm
     uint32_t *uid_count;               /* out */
 };
 
+/* scratch area used for the heavy hitter state machine */
+struct PINT_client_mgmt_get_top_list_sm
+{
+    PVFS_fs_id fs_id;
+    enum PVFS_mgmt_top_kind kind;
+    enum PVFS_mgmt_top_metric metric;
+    uint32_t entry_count;
+    int server_count;
+    PVFS_id_gen_t *addr_array;                  /* in */
+    struct PVFS_mgmt_top_entry **entry_matrix;  /* out */
+    uint32_t *count_array;                      /* out */
+    char **client_names;                        /* out */
+};
+
+/* scratch area used for one pass of the subtree removal state machine */
+struct PINT_client_mgmt_remove_tree_sm
+{
+    int batch_count;
+    int bucket_count;
+    PVFS_ds_position *token_array;   /* per dirdata bucket */
+    int *bucket_array;               /* bucket of each msgpair */
+    struct PVFS_mgmt_remove_tree_progress *progress;  /* in/out */
+    PVFS_mgmt_remove_tree_cb progress_cb;
+    void *progress_arg;
+    PVFS_dirent **dir_array;         /* out */
+    int *dir_count;                  /* out */
+    int dir_max;
+};
+
+struct PINT_client_mgmt_scan_list_sm
+{
+    PVFS_fs_id fs_id;
+    int server_count;
+    PVFS_BMI_addr_t *addr_array;
+    struct PVFS_mgmt_scan_filter filter;
+    struct PVFS_mgmt_scan_rec **rec_matrix;  /* out */
+    int *rec_count_array;                    /* in/out */
+    PVFS_ds_position *position_array;        /* in/out */
+    PVFS_error_details *details;
+};
+
 #ifdef ENABLE_SECURITY_CERT
 struct PINT_client_mgmt_get_user_cert_sm
 {
@@ -726,6 +789,9 @@ typedef struct PINT_client_sm
         struct PINT_sysdev_unexp_sm sysdev_unexp;
         struct PINT_client_job_timer_sm job_timer;
         struct PINT_client_mgmt_get_uid_list_sm get_uid_list;
+        struct PINT_client_mgmt_get_top_list_sm get_top_list;
+        struct PINT_client_mgmt_remove_tree_sm remove_tree;
+        struct PINT_client_mgmt_scan_list_sm scan_list;
 #ifdef ENABLE_SECURITY_CERT
         struct PINT_client_mgmt_get_user_cert_sm mgmt_get_user_cert;
 #endif
@@ -828,6 +894,9 @@ enum
     PVFS_MGMT_GET_UID_LIST         = 81, 
     PVFS_MGMT_GET_DIRDATA_ARRAY    = 82,
     PVFS_MGMT_GET_USER_CERT        = 83,
+    PVFS_MGMT_GET_TOP_LIST         = 84,
+    PVFS_MGMT_REMOVE_TREE          = 85,
+    PVFS_MGMT_SCAN_LIST            = 86,
     PVFS_SERVER_GET_CONFIG         = 200,
     PVFS_CLIENT_JOB_TIMER          = 300,
     PVFS_CLIENT_PERF_COUNT_TIMER   = 301,
@@ -836,7 +905,7 @@ enum
 
 #define PVFS_OP_SYS_MAXVALID  22
 #define PVFS_OP_SYS_MAXVAL 69
-#define PVFS_OP_MGMT_MAXVALID 84
+#define PVFS_OP_MGMT_MAXVALID 87
 #define PVFS_OP_MGMT_MAXVAL 199
 
 int PINT_client_io_cancel(job_id_t id);
@@ -942,6 +1011,9 @@ extern struct PINT_state_machine_s pvfs2_client_statfs_sm;
 extern struct PINT_state_machine_s pvfs2_fs_add_sm;
 extern struct PINT_state_machine_s pvfs2_client_mgmt_get_uid_list_sm;
 extern struct PINT_state_machine_s pvfs2_client_mgmt_get_dirdata_array_sm;
+extern struct PINT_state_machine_s pvfs2_client_mgmt_get_top_list_sm;
+extern struct PINT_state_machine_s pvfs2_client_mgmt_remove_tree_sm;
+extern struct PINT_state_machine_s pvfs2_client_mgmt_scan_list_sm;
 #ifdef ENABLE_SECURITY_CERT
 extern struct PINT_state_machine_s pvfs2_client_mgmt_get_user_cert_sm;
 #endif
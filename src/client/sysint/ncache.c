@@ -28,8 +28,16 @@ NCACHE_DEFAULT_SOFT_LIMIT     =  5120,
 NCACHE_DEFAULT_HARD_LIMIT     = 10240,
 NCACHE_DEFAULT_RECLAIM_PERCENTAGE = 25,
 NCACHE_DEFAULT_REPLACE_ALGORITHM = LEAST_RECENTLY_USED,
+NCACHE_DEFAULT_NEGATIVE_TIMEOUT_MSECS = 5000,  /* 5 seconds */
 };
 
+/* A directory modification time is only kept as a version if it is at
+ * least this many seconds in the past; two changes within the same
+ * second leave the time unchanged, and the server's clock may be a
+ * little ahead of ours.
+ */
+#define NCACHE_VERSION_MIN_AGE_SECS 2
+
 struct PINT_perf_key ncache_keys[] = 
 {
    {"NCACHE_NUM_ENTRIES", PERF_NCACHE_NUM_ENTRIES, PINT_PERF_PRESERVE},
@@ -42,6 +50,8 @@ struct PINT_perf_key ncache_keys[] =
    {"NCACHE_REPLACEMENTS", PERF_NCACHE_REPLACEMENTS, 0},
    {"NCACHE_DELETIONS", PERF_NCACHE_DELETIONS, 0},
    {"NCACHE_ENABLED", PERF_NCACHE_ENABLED, PINT_PERF_PRESERVE},
+   {"NCACHE_NEGATIVE_HITS", PERF_NCACHE_NEGATIVE_HITS, 0},
+   {"NCACHE_REVALIDATIONS", PERF_NCACHE_REVALIDATIONS, 0},
    {NULL, 0, 0},
 };
 
@@ -50,7 +60,9 @@ struct ncache_payload
 {
     PVFS_object_ref entry_ref;      /* PVFS2 object reference to entry */
     PVFS_object_ref parent_ref;     /* PVFS2 object reference to parent */
-    int entry_status;               /* is the entry valid? */
+    int entry_status;               /* 0, or -PVFS_ENOENT if the name
+                                       does not exist */
+    PVFS_time dir_version;          /* parent mtime when cached, or 0 */
     char* entry_name;
 };
 
@@ -60,15 +72,26 @@ struct ncache_key
     const char* entry_name;
 };
   
-static struct PINT_tcache* ncache = NULL;
+static struct PINT_tcache_shards* ncache = NULL;
 static gen_mutex_t ncache_mutex = GEN_MUTEX_INITIALIZER;
 static struct PINT_perf_counter* ncache_pc = NULL;
+static unsigned int ncache_negative_timeout_msecs =
+    NCACHE_DEFAULT_NEGATIVE_TIMEOUT_MSECS;
 
 static int PINT_ncache_initialize_perf_counter(void);
 static int ncache_compare_key_entry(const void* key, struct qhash_head* link);
 static int ncache_hash_key(const void* key, int table_size);
 static int ncache_free_payload(void* payload);
-static int set_tcache_defaults(struct PINT_tcache* instance);
+static int set_tcache_defaults(struct PINT_tcache_shards* instance);
+static void ncache_count_info(void);
+static void ncache_count_entries(void);
+static int ncache_update_entry(const char* entry,
+                               const PVFS_object_ref* entry_ref,
+                               const PVFS_object_ref* parent_ref,
+                               PVFS_time dir_version);
+static void ncache_set_expiration(struct PINT_tcache* tcache,
+                                  struct PINT_tcache_entry* tmp_entry);
+static void ncache_negative_expiration(struct timeval* expiration);
 
 /**
  * Initializes the ncache 
@@ -79,14 +102,16 @@ int PINT_ncache_initialize(void)
     int ret = -1;
     unsigned int ncache_timeout_msecs;
     char * ncache_timeout_str = NULL;
+    char * ncache_negative_timeout_str = NULL;
   
     gen_mutex_lock(&ncache_mutex);
   
     /* create tcache instance */
-    ncache = PINT_tcache_initialize(ncache_compare_key_entry,
-                                    ncache_hash_key,
-                                    ncache_free_payload,
-                                    -1 /* default tcache table size */);
+    ncache = PINT_tcache_shards_initialize(ncache_compare_key_entry,
+                                           ncache_hash_key,
+                                           ncache_free_payload,
+                                           -1 /* default tcache table size */,
+                                           -1 /* default shard count */);
     if(!ncache)
     {
         gen_mutex_unlock(&ncache_mutex);
@@ -104,12 +129,19 @@ int PINT_ncache_initialize(void)
         ncache_timeout_msecs = NCACHE_DEFAULT_TIMEOUT_MSECS;
     }
 
-    ret = PINT_tcache_set_info(ncache,
-                               TCACHE_TIMEOUT_MSECS,
-                               ncache_timeout_msecs);
+    ncache_negative_timeout_str = getenv("PVFS2_NCACHE_NEGATIVE_TIMEOUT");
+    if (ncache_negative_timeout_str != NULL)
+    {
+        ncache_negative_timeout_msecs = (unsigned int) strtoul(
+                ncache_negative_timeout_str,NULL,0);
+    }
+
+    ret = PINT_tcache_shards_set_info(ncache,
+                                      TCACHE_TIMEOUT_MSECS,
+                                      ncache_timeout_msecs);
     if(ret < 0)
     {
-        PINT_tcache_finalize(ncache);
+        PINT_tcache_shards_finalize(ncache);
         gen_mutex_unlock(&ncache_mutex);
         return(ret);
     }
@@ -117,7 +149,7 @@ int PINT_ncache_initialize(void)
     ret = set_tcache_defaults(ncache);
     if(ret < 0)
     {
-        PINT_tcache_finalize(ncache);
+        PINT_tcache_shards_finalize(ncache);
         gen_mutex_unlock(&ncache_mutex);
         return(ret);
     }
@@ -144,7 +176,7 @@ void PINT_ncache_finalize(void)
 
     if(ncache != NULL)
     {
-        PINT_tcache_finalize(ncache);
+        PINT_tcache_shards_finalize(ncache);
         ncache = NULL;
     }
 
@@ -170,7 +202,15 @@ int PINT_ncache_get_info(
     int ret = -1;
   
     gen_mutex_lock(&ncache_mutex);
-    ret = PINT_tcache_get_info(ncache, option, arg);
+    if((int)option == NCACHE_NEGATIVE_TIMEOUT_MSECS)
+    {
+        *arg = ncache_negative_timeout_msecs;
+        ret = 0;
+    }
+    else
+    {
+        ret = PINT_tcache_shards_get_info(ncache, option, arg);
+    }
     gen_mutex_unlock(&ncache_mutex);
   
     return(ret);
@@ -188,25 +228,17 @@ int PINT_ncache_set_info(
     int ret = -1;
   
     gen_mutex_lock(&ncache_mutex);
-    ret = PINT_tcache_set_info(ncache, option, arg);
+    if((int)option == NCACHE_NEGATIVE_TIMEOUT_MSECS)
+    {
+        /* zero disables negative entries */
+        ncache_negative_timeout_msecs = arg;
+        gen_mutex_unlock(&ncache_mutex);
+        return(0);
+    }
+    ret = PINT_tcache_shards_set_info(ncache, option, arg);
 
     /* record any resulting parameter changes */
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_SOFT_LIMIT,
-                    ncache->soft_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_HARD_LIMIT,
-                    ncache->hard_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_ENABLED,
-                    ncache->enable,
-                    PINT_PERF_SET);
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_NUM_ENTRIES,
-                    ncache->num_entries,
-                    PINT_PERF_SET);
+    ncache_count_info();
 
     gen_mutex_unlock(&ncache_mutex);
 
@@ -214,16 +246,25 @@ int PINT_ncache_set_info(
 }
   
 /** 
- * Retrieves a _copy_ of a cached object reference, and reports the
- * status to indicate if they are valid or  not
+ * Retrieves a _copy_ of a cached object reference.  A negative entry,
+ * recording that the name does not exist, is returned as a hit with a
+ * null handle in entry_ref.
+ *
+ * If the entry has expired but was cached with a parent version, that
+ * version is stored in dir_version (when not NULL) and -PVFS_ETIME is
+ * returned; the caller may then compare it with the parent's current
+ * modification time and call PINT_ncache_revalidate().
+ *
  * @return 0 on success, -PVFS_error on failure
  */
 int PINT_ncache_get_cached_entry(
     const char* entry,                 /**< path of obect to look up*/
     PVFS_object_ref* entry_ref,        /**< PVFS2 object looked up */
-    const PVFS_object_ref* parent_ref) /**< Parent of PVFS2 object */
+    const PVFS_object_ref* parent_ref, /**< Parent of PVFS2 object */
+    PVFS_time* dir_version)            /**< version of an expired entry */
 {
     int ret = -1;
+    struct PINT_tcache_shard* shard;
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_payload* tmp_payload;
     struct ncache_key entry_key;
@@ -232,28 +273,25 @@ int PINT_ncache_get_cached_entry(
     gossip_debug(GOSSIP_NCACHE_DEBUG, 
                  "ncache: get_cached_entry(): [%s]\n",entry);
   
+    if(dir_version)
+    {
+        *dir_version = 0;
+    }
+
     entry_key.entry_name = entry;
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
-    gen_mutex_lock(&ncache_mutex);
+    shard = PINT_tcache_shard_lock(ncache, &entry_key);
 
     /* lookup entry */
-    ret = PINT_tcache_lookup(ncache, (void *) &entry_key, &tmp_entry, &status);
-    if(ret < 0 || status != 0)
+    ret = PINT_tcache_lookup(shard->tcache, (void *) &entry_key, &tmp_entry, &status);
+    if(ret < 0)
     {
         gossip_debug(GOSSIP_NCACHE_DEBUG, 
             "ncache: miss: name=[%s]\n", entry_key.entry_name);
-        PINT_perf_count(ncache_pc,
-                        PERF_NCACHE_MISSES,
-                        1,
-                        PINT_PERF_ADD);
-        gen_mutex_unlock(&ncache_mutex);
-        /* Return -PVFS_ENOENT if the entry has expired */
-        if(status != 0)
-        {   
-            return(-PVFS_ENOENT);
-        }
+        PINT_tcache_shard_count(shard, PERF_NCACHE_MISSES, 1);
+        PINT_tcache_shard_unlock(ncache, shard);
         return(ret);
     }
     tmp_payload = tmp_entry->payload;
@@ -261,26 +299,91 @@ int PINT_ncache_get_cached_entry(
     gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: status=%d, entry_status=%d\n",
                  status, tmp_payload->entry_status);
 
-    /* copy out entry ref if valid */
-    if(tmp_payload->entry_status == 0 && 
-       tmp_payload->parent_ref.handle == parent_ref->handle)
+    if(status != 0)
     {
-        gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: copying out ref.\n");
-        *entry_ref = tmp_payload->entry_ref;
+        PINT_tcache_shard_count(shard, PERF_NCACHE_MISSES, 1);
+        /* an expired entry with a version may still be revalidated */
+        if(tmp_payload->dir_version && dir_version)
+        {
+            *dir_version = tmp_payload->dir_version;
+            PINT_tcache_shard_unlock(ncache, shard);
+            return(-PVFS_ETIME);
+        }
+        PINT_tcache_shard_unlock(ncache, shard);
+        /* Return -PVFS_ENOENT if the entry has expired */
+        return(-PVFS_ENOENT);
     }
-  
-    if(tmp_payload->entry_status == 0) 
+
+    /* copy out entry ref; the handle is null for a negative entry */
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: copying out ref.\n");
+    *entry_ref = tmp_payload->entry_ref;
+
+    /* return success if we got _anything_ out of the cache */
+    PINT_tcache_shard_count(shard, PERF_NCACHE_HITS, 1);
+    if(tmp_payload->entry_status != 0)
     {
-        /* return success if we got _anything_ out of the cache */
-        PINT_perf_count(ncache_pc, PERF_NCACHE_HITS, 1, PINT_PERF_ADD);
-        gen_mutex_unlock(&ncache_mutex);
-        return(0);
+        PINT_tcache_shard_count(shard, PERF_NCACHE_NEGATIVE_HITS, 1);
     }
+    PINT_tcache_shard_unlock(ncache, shard);
+    return(0);
+}
 
-    gen_mutex_unlock(&ncache_mutex);
-  
-    PINT_perf_count(ncache_pc, PERF_NCACHE_MISSES, 1, PINT_PERF_ADD);
-    return(-PVFS_ETIME);
+/**
+ * Refreshes an expired entry if its parent directory is still at the
+ * version it had when the entry was cached, and copies out the entry as
+ * PINT_ncache_get_cached_entry() does.  An entry at any other version is
+ * removed.
+ *
+ * @return 0 on success, -PVFS_ENOENT if the entry is gone or out of date
+ */
+int PINT_ncache_revalidate(
+    const char* entry,                 /**< path of obect to look up*/
+    PVFS_object_ref* entry_ref,        /**< PVFS2 object looked up */
+    const PVFS_object_ref* parent_ref, /**< Parent of PVFS2 object */
+    PVFS_time dir_version)             /**< current mtime of the parent */
+{
+    int ret = -1;
+    struct PINT_tcache_shard* shard;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_payload* tmp_payload;
+    struct ncache_key entry_key;
+    int status;
+
+    entry_key.entry_name = entry;
+    entry_key.parent_ref.handle = parent_ref->handle;
+    entry_key.parent_ref.fs_id = parent_ref->fs_id;
+
+    shard = PINT_tcache_shard_lock(ncache, &entry_key);
+
+    ret = PINT_tcache_lookup(shard->tcache, (void *) &entry_key, &tmp_entry, &status);
+    if(ret < 0)
+    {
+        PINT_tcache_shard_unlock(ncache, shard);
+        return(-PVFS_ENOENT);
+    }
+    tmp_payload = tmp_entry->payload;
+
+    if(tmp_payload->dir_version == 0 ||
+       tmp_payload->dir_version != dir_version)
+    {
+        gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: revalidate(): [%s] "
+                     "parent changed, version %lld now %lld\n", entry,
+                     lld(tmp_payload->dir_version), lld(dir_version));
+        PINT_tcache_delete(shard->tcache, tmp_entry);
+        PINT_tcache_shard_count(shard, PERF_NCACHE_DELETIONS, 1);
+        PINT_tcache_shard_unlock(ncache, shard);
+        ncache_count_entries();
+        return(-PVFS_ENOENT);
+    }
+
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: revalidate(): [%s] "
+                 "parent unchanged\n", entry);
+    ncache_set_expiration(shard->tcache, tmp_entry);
+    *entry_ref = tmp_payload->entry_ref;
+    PINT_tcache_shard_count(shard, PERF_NCACHE_REVALIDATIONS, 1);
+
+    PINT_tcache_shard_unlock(ncache, shard);
+    return(0);
 }
   
 /**
@@ -291,6 +394,7 @@ void PINT_ncache_invalidate(
     const PVFS_object_ref* parent_ref)  /**< Parent of PVFS2 object */
 {
     int ret = -1;
+    struct PINT_tcache_shard* shard;
     struct PINT_tcache_entry* tmp_entry;
     struct ncache_key entry_key;
     int tmp_status;
@@ -298,32 +402,30 @@ void PINT_ncache_invalidate(
     gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: invalidate(): entry=%s\n",
                  entry);
   
-    gen_mutex_lock(&ncache_mutex);
-  
     entry_key.entry_name = entry;
     entry_key.parent_ref.handle = parent_ref->handle;
     entry_key.parent_ref.fs_id = parent_ref->fs_id;
 
+    shard = PINT_tcache_shard_lock(ncache, &entry_key);
+
     /* find out if the entry is in the cache */
-    ret = PINT_tcache_lookup(ncache, 
+    ret = PINT_tcache_lookup(shard->tcache, 
                              &entry_key,
                              &tmp_entry,
                              &tmp_status);
     if(ret == 0)
     {
-        PINT_tcache_delete(ncache, tmp_entry);
-        PINT_perf_count(ncache_pc,
-                        PERF_NCACHE_DELETIONS,
-                        1,
-                        PINT_PERF_ADD);
+        PINT_tcache_delete(shard->tcache, tmp_entry);
+        PINT_tcache_shard_count(shard, PERF_NCACHE_DELETIONS, 1);
     }
 
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_NUM_ENTRIES,
-                    ncache->num_entries,
-                    PINT_PERF_SET);
+    PINT_tcache_shard_unlock(ncache, shard);
 
-    gen_mutex_unlock(&ncache_mutex);
+    if(ret == 0)
+    {
+        /* set the new current number of entries */
+        ncache_count_entries();
+    }
     return;
 }
   
@@ -331,6 +433,9 @@ void PINT_ncache_invalidate(
  * Adds a name to the cache, or updates it if already present.  
  * The given name is _copied_ into the cache.   
  *
+ * dir_version is the modification time of the parent directory as
+ * returned by the server before the name was resolved, or 0 if unknown.
+ *
  * \note NOTE: All previous information for the object will be discarded,
  * even if there is still time remaining before it expires.
  *
@@ -339,121 +444,33 @@ void PINT_ncache_invalidate(
 int PINT_ncache_update(
     const char* entry,                     /**< entry to update */
     const PVFS_object_ref* entry_ref,      /**< entry ref to update */
-    const PVFS_object_ref* parent_ref)     /**< parent ref to update */
+    const PVFS_object_ref* parent_ref,     /**< parent ref to update */
+    PVFS_time dir_version)                 /**< parent mtime, or 0 */
 {
-    int ret = -1;
-    struct PINT_tcache_entry* tmp_entry;
-    struct ncache_payload* tmp_payload;
-    struct ncache_key entry_key;
-    int status;
-    int purged;
-    unsigned int enabled;
-
-    /* skip out immediately if the cache is disabled */
-    PINT_tcache_get_info(ncache, TCACHE_ENABLE, &enabled);
-    if(!enabled)
-    {
-        return(0);
-    }
-    
-    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): name [%s]\n",entry);
-  
     if(!entry_ref->handle)
     {
         return(-PVFS_EINVAL);
     }
-  
-    /* create new payload with updated information */
-    tmp_payload = (struct ncache_payload*) 
-                        calloc(1,sizeof(struct ncache_payload));
-    if(tmp_payload == NULL)
-    {
-        return(-PVFS_ENOMEM);
-    }
-
-    tmp_payload->parent_ref.handle = parent_ref->handle;
-    tmp_payload->parent_ref.fs_id = parent_ref->fs_id;
-    tmp_payload->entry_ref.handle = entry_ref->handle;
-    tmp_payload->entry_ref.fs_id = entry_ref->fs_id;
-
-    tmp_payload->entry_status = 0;
-    tmp_payload->entry_name = (char*) calloc(1, strlen(entry) + 1);
-    if(tmp_payload->entry_name == NULL)
-    {
-        free(tmp_payload);
-        return(-PVFS_ENOMEM);
-    }
-    memcpy(tmp_payload->entry_name, entry, strlen(entry) + 1);
-
-    gen_mutex_lock(&ncache_mutex);
-
-    entry_key.entry_name = entry;
-    entry_key.parent_ref.handle = parent_ref->handle;
-    entry_key.parent_ref.fs_id = parent_ref->fs_id;
-
-    /* find out if the entry is already in the cache */
-    ret = PINT_tcache_lookup(ncache, 
-                             &entry_key,
-                             &tmp_entry,
-                             &status);
-    if(ret == 0)
-    {
-        /* found match in cache; destroy old payload, replace, and
-         * refresh time stamp
-         */
-        ncache_free_payload(tmp_entry->payload);
-        tmp_entry->payload = tmp_payload;
-        ret = PINT_tcache_refresh_entry(ncache, tmp_entry);
-        PINT_perf_count(ncache_pc, PERF_NCACHE_UPDATES, 1, PINT_PERF_ADD);
-    }
-    else
-    {
-        /* not found in cache; insert new payload*/
-        ret = PINT_tcache_insert_entry(ncache, 
-                                       &entry_key,
-                                       tmp_payload, 
-                                       &purged);
-        /* the purged variable indicates how many entries had to be purged
-         * from the tcache to make room for this new one
-         */
-        if(purged == 1)
-        {
-            /* since only one item was purged, we count this as one item being
-             * replaced rather than as a purge and an insert
-             */
-            PINT_perf_count(ncache_pc,
-                            PERF_NCACHE_REPLACEMENTS,
-                            purged,
-                            PINT_PERF_ADD);
-        }
-        else
-        {
-            /* otherwise we just purged as part of reclaimation */
-            /* if we didn't purge anything, then the "purged" variable will
-             * be zero and this counter call won't do anything.
-             */
-            PINT_perf_count(ncache_pc,
-                            PERF_NCACHE_PURGES,
-                            purged,
-                            PINT_PERF_ADD);
-        }
-    }
-    
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_NUM_ENTRIES,
-                    ncache->num_entries,
-                    PINT_PERF_SET);
+    return ncache_update_entry(entry, entry_ref, parent_ref, dir_version);
+}
 
-    gen_mutex_unlock(&ncache_mutex);
-  
-    /* cleanup if we did not succeed for some reason */
-    if(ret < 0)
+/** 
+ * Records that a name does not exist in the parent directory, replacing
+ * any entry for it.  Negative entries expire after
+ * NCACHE_NEGATIVE_TIMEOUT_MSECS; a timeout of zero disables them.
+ *
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_ncache_update_negative(
+    const char* entry,                     /**< entry that does not exist */
+    const PVFS_object_ref* parent_ref,     /**< parent ref to update */
+    PVFS_time dir_version)                 /**< parent mtime, or 0 */
+{
+    if(ncache_negative_timeout_msecs == 0)
     {
-        ncache_free_payload(tmp_payload);
+        return(0);
     }
-  
-    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): return=%d\n", ret);
-    return(ret);
+    return ncache_update_entry(entry, NULL, parent_ref, dir_version);
 }
 
 /**
@@ -482,22 +499,41 @@ static int PINT_ncache_initialize_perf_counter(void)
         gossip_err("Error: PINT_perf_initialize failure.\n");
         return -PVFS_ENOMEM;
     }
+    ncache->pc = ncache_pc;
 
     /* set initial values */
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_SOFT_LIMIT,
-                    ncache->soft_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_HARD_LIMIT,
-                    ncache->hard_limit,
-                    PINT_PERF_SET);
-    PINT_perf_count(ncache_pc,
-                    PERF_NCACHE_ENABLED,
-                    ncache->enable,
-                    PINT_PERF_SET);
+    ncache_count_info();
     return 0;
 }
+
+/* ncache_count_info()
+ *
+ * sets the perf counter values that describe the ncache configuration
+ */
+static void ncache_count_info(void)
+{
+    unsigned int value;
+
+    PINT_tcache_shards_get_info(ncache, TCACHE_SOFT_LIMIT, &value);
+    PINT_perf_count(ncache_pc, PERF_NCACHE_SOFT_LIMIT, value, PINT_PERF_SET);
+    PINT_tcache_shards_get_info(ncache, TCACHE_HARD_LIMIT, &value);
+    PINT_perf_count(ncache_pc, PERF_NCACHE_HARD_LIMIT, value, PINT_PERF_SET);
+    PINT_tcache_shards_get_info(ncache, TCACHE_ENABLE, &value);
+    PINT_perf_count(ncache_pc, PERF_NCACHE_ENABLED, value, PINT_PERF_SET);
+    ncache_count_entries();
+}
+
+/* ncache_count_entries()
+ *
+ * sets the perf counter value for the number of cached entries
+ */
+static void ncache_count_entries(void)
+{
+    unsigned int value;
+
+    PINT_tcache_shards_get_info(ncache, TCACHE_NUM_ENTRIES, &value);
+    PINT_perf_count(ncache_pc, PERF_NCACHE_NUM_ENTRIES, value, PINT_PERF_SET);
+}
   
 /* ncache_compare_key_entry()
  *
@@ -541,7 +577,9 @@ static int ncache_compare_key_entry(const void* key, struct qhash_head* link)
   
 /* ncache_hash_key()
  *
- * hash function for character pointers
+ * hash function for character pointers (FNV-1a); names in one directory
+ * often differ in a single character, which a plain sum of the
+ * characters maps to a handful of buckets
  *
  * returns hash index 
  */
@@ -549,14 +587,19 @@ static int ncache_hash_key(const void* key, int table_size)
 {
     const struct ncache_key* real_key = (const struct ncache_key*) key;
     int tmp_ret = 0;
-    unsigned int sum = 0, i = 0;
+    unsigned int sum = 2166136261U, i = 0;
 
     while(real_key->entry_name[i] != '\0')
     {
-        sum += (unsigned int) real_key->entry_name[i];
+        sum ^= (unsigned char) real_key->entry_name[i];
+        sum *= 16777619U;
         i++;
     }
-    sum += real_key->parent_ref.handle + real_key->parent_ref.fs_id;
+    sum ^= (unsigned int) (real_key->parent_ref.handle ^
+                           (real_key->parent_ref.handle >> 32));
+    sum *= 16777619U;
+    sum ^= (unsigned int) real_key->parent_ref.fs_id;
+    sum *= 16777619U;
     tmp_ret =  sum % table_size;
     return(tmp_ret);
 }
@@ -576,11 +619,182 @@ static int ncache_free_payload(void* payload)
     return(0);
 }
 
-static int set_tcache_defaults(struct PINT_tcache* instance)
+/* ncache_update_entry()
+ *
+ * inserts or replaces the entry for a name; entry_ref is NULL for a
+ * negative entry
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int ncache_update_entry(const char* entry,
+                               const PVFS_object_ref* entry_ref,
+                               const PVFS_object_ref* parent_ref,
+                               PVFS_time dir_version)
+{
+    int ret = -1;
+    struct PINT_tcache_shard* shard;
+    struct PINT_tcache_entry* tmp_entry;
+    struct ncache_payload* tmp_payload;
+    struct ncache_key entry_key;
+    int status;
+    int purged;
+    unsigned int enabled;
+    struct timeval now;
+
+    /* skip out immediately if the cache is disabled */
+    PINT_tcache_shards_get_info(ncache, TCACHE_ENABLE, &enabled);
+    if(!enabled)
+    {
+        return(0);
+    }
+    
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): name [%s]\n",entry);
+  
+    /* create new payload with updated information */
+    tmp_payload = (struct ncache_payload*) 
+                        calloc(1,sizeof(struct ncache_payload));
+    if(tmp_payload == NULL)
+    {
+        return(-PVFS_ENOMEM);
+    }
+
+    tmp_payload->parent_ref.handle = parent_ref->handle;
+    tmp_payload->parent_ref.fs_id = parent_ref->fs_id;
+    if(entry_ref)
+    {
+        tmp_payload->entry_ref.handle = entry_ref->handle;
+        tmp_payload->entry_ref.fs_id = entry_ref->fs_id;
+        tmp_payload->entry_status = 0;
+    }
+    else
+    {
+        tmp_payload->entry_ref.handle = PVFS_HANDLE_NULL;
+        tmp_payload->entry_ref.fs_id = parent_ref->fs_id;
+        tmp_payload->entry_status = -PVFS_ENOENT;
+    }
+
+    /* a recent modification time may not change again when the
+     * directory does, so it cannot be used to revalidate the entry
+     */
+    gettimeofday(&now, NULL);
+    if(dir_version + NCACHE_VERSION_MIN_AGE_SECS < now.tv_sec)
+    {
+        tmp_payload->dir_version = dir_version;
+    }
+    tmp_payload->entry_name = (char*) calloc(1, strlen(entry) + 1);
+    if(tmp_payload->entry_name == NULL)
+    {
+        free(tmp_payload);
+        return(-PVFS_ENOMEM);
+    }
+    memcpy(tmp_payload->entry_name, entry, strlen(entry) + 1);
+
+    entry_key.entry_name = entry;
+    entry_key.parent_ref.handle = parent_ref->handle;
+    entry_key.parent_ref.fs_id = parent_ref->fs_id;
+
+    shard = PINT_tcache_shard_lock(ncache, &entry_key);
+
+    /* find out if the entry is already in the cache */
+    ret = PINT_tcache_lookup(shard->tcache, 
+                             &entry_key,
+                             &tmp_entry,
+                             &status);
+    if(ret == 0)
+    {
+        /* found match in cache; destroy old payload, replace, and
+         * refresh time stamp
+         */
+        ncache_free_payload(tmp_entry->payload);
+        tmp_entry->payload = tmp_payload;
+        ncache_set_expiration(shard->tcache, tmp_entry);
+        PINT_tcache_shard_count(shard, PERF_NCACHE_UPDATES, 1);
+    }
+    else
+    {
+        /* not found in cache; insert new payload, giving negative
+         * entries their own timeout */
+        ncache_negative_expiration(&now);
+        ret = PINT_tcache_insert_entry_ex(shard->tcache, 
+                                          &entry_key,
+                                          tmp_payload, 
+                                          entry_ref ? NULL : &now,
+                                          &purged);
+        /* the purged variable indicates how many entries had to be purged
+         * from the tcache to make room for this new one
+         */
+        if(purged == 1)
+        {
+            /* since only one item was purged, we count this as one item being
+             * replaced rather than as a purge and an insert
+             */
+            PINT_tcache_shard_count(shard, PERF_NCACHE_REPLACEMENTS, purged);
+        }
+        else
+        {
+            /* otherwise we just purged as part of reclaimation */
+            /* if we didn't purge anything, then the "purged" variable will
+             * be zero and this counter call won't do anything.
+             */
+            PINT_tcache_shard_count(shard, PERF_NCACHE_PURGES, purged);
+        }
+    }
+
+    PINT_tcache_shard_unlock(ncache, shard);
+
+    ncache_count_entries();
+  
+    /* cleanup if we did not succeed for some reason */
+    if(ret < 0)
+    {
+        ncache_free_payload(tmp_payload);
+    }
+  
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "ncache: update(): return=%d\n", ret);
+    return(ret);
+}
+
+/* ncache_set_expiration()
+ *
+ * restarts the timeout of an entry, using the negative timeout for
+ * negative entries
+ */
+static void ncache_set_expiration(struct PINT_tcache* tcache,
+                                  struct PINT_tcache_entry* tmp_entry)
+{
+    struct ncache_payload* tmp_payload = tmp_entry->payload;
+
+    if(tmp_payload->entry_status == 0 || !tcache->expiration_enabled)
+    {
+        PINT_tcache_refresh_entry(tcache, tmp_entry);
+    }
+    else
+    {
+        ncache_negative_expiration(&tmp_entry->expiration_date);
+    }
+}
+
+/* ncache_negative_expiration()
+ *
+ * computes when a negative entry cached now will expire
+ */
+static void ncache_negative_expiration(struct timeval* expiration)
+{
+    gettimeofday(expiration, NULL);
+    expiration->tv_sec += ncache_negative_timeout_msecs / 1000;
+    expiration->tv_usec += (ncache_negative_timeout_msecs % 1000) * 1000;
+    if(expiration->tv_usec >= 1000000)
+    {
+        expiration->tv_usec -= 1000000;
+        expiration->tv_sec += 1;
+    }
+}
+
+static int set_tcache_defaults(struct PINT_tcache_shards* instance)
 {
     int ret;
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_HARD_LIMIT,
                                NCACHE_DEFAULT_HARD_LIMIT);
     if(ret < 0)
@@ -588,7 +802,7 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
         return(ret);
     }
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_SOFT_LIMIT,
                                NCACHE_DEFAULT_SOFT_LIMIT);
     if(ret < 0)
@@ -596,7 +810,7 @@ static int set_tcache_defaults(struct PINT_tcache* instance)
         return(ret);
     }
 
-    ret = PINT_tcache_set_info(instance,
+    ret = PINT_tcache_shards_set_info(instance,
                                TCACHE_RECLAIM_PERCENTAGE,
                                NCACHE_DEFAULT_RECLAIM_PERCENTAGE);
     if(ret < 0)
@@ -49,6 +49,15 @@
  * - pvfs2-create
  * .
  *
+ * Lookups that fail because the name does not exist insert a negative
+ * entry, which has its own, normally shorter, timeout.  Each entry also
+ * records the modification time of its parent directory when it was
+ * cached.  An expired entry is not discarded straight away: if a getattr
+ * of the parent shows the same modification time, the directory has not
+ * changed and the entry is refreshed instead of looked up again.  Since
+ * the parent attributes are themselves cached, one directory getattr
+ * revalidates every name cached under it.
+ *
  * Operations that may DELETE items from the cache:
  * - pvfs2-remove
  * - pvfs2-rename
@@ -72,6 +81,7 @@ NCACHE_HARD_LIMIT = TCACHE_HARD_LIMIT,
 NCACHE_SOFT_LIMIT = TCACHE_SOFT_LIMIT,
 NCACHE_ENABLE = TCACHE_ENABLE,
 NCACHE_RECLAIM_PERCENTAGE = TCACHE_RECLAIM_PERCENTAGE,
+NCACHE_NEGATIVE_TIMEOUT_MSECS = 100, /**< get/set negative entry timeout */
 };
 
 enum 
@@ -86,6 +96,8 @@ enum
    PERF_NCACHE_REPLACEMENTS = 7,
    PERF_NCACHE_DELETIONS = 8, 
    PERF_NCACHE_ENABLED = 9,
+   PERF_NCACHE_NEGATIVE_HITS = 10,
+   PERF_NCACHE_REVALIDATIONS = 11,
 };
 
 int PINT_ncache_initialize(void);
@@ -103,12 +115,25 @@ int PINT_ncache_set_info(
 int PINT_ncache_get_cached_entry(
     const char* entry, 
     PVFS_object_ref* entry_ref,
-    const PVFS_object_ref* parent_ref); 
+    const PVFS_object_ref* parent_ref,
+    PVFS_time* dir_version); 
+
+int PINT_ncache_revalidate(
+    const char* entry, 
+    PVFS_object_ref* entry_ref,
+    const PVFS_object_ref* parent_ref,
+    PVFS_time dir_version); 
 
 int PINT_ncache_update(
     const char* entry, 
     const PVFS_object_ref* entry_ref, 
-    const PVFS_object_ref* parent_ref); 
+    const PVFS_object_ref* parent_ref,
+    PVFS_time dir_version); 
+
+int PINT_ncache_update_negative(
+    const char* entry, 
+    const PVFS_object_ref* parent_ref,
+    PVFS_time dir_version); 
 
 void PINT_ncache_invalidate(
     const char* entry, 
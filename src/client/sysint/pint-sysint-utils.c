@@ -92,6 +92,30 @@ void PINT_put_server_config_struct(struct server_configuration_s *config)
     PINT_server_config_mgr_put_config(config);
 }
 
+/* PINT_get_inline_data_size()
+ *
+ * returns the size up to which stuffed files of fs_id keep their data
+ * inline, 0 if they do not
+ */
+int32_t PINT_get_inline_data_size(PVFS_fs_id fs_id)
+{
+    struct server_configuration_s *server_config;
+    struct filesystem_configuration_s *fs_config;
+    int32_t size = 0;
+
+    server_config = PINT_get_server_config_struct(fs_id);
+    if (server_config)
+    {
+        fs_config = PINT_config_find_fs_id(server_config, fs_id);
+        if (fs_config)
+        {
+            size = fs_config->inline_data_size;
+        }
+        PINT_put_server_config_struct(server_config);
+    }
+    return size;
+}
+
 /* PINT_lookup_parent()
  *
  * given a pathname and an fsid, looks up the handle of the parent
@@ -43,6 +43,8 @@ struct server_configuration_s *PINT_get_server_config_struct(PVFS_fs_id fs_id);
 
 void PINT_put_server_config_struct(struct server_configuration_s *config);
 
+int32_t PINT_get_inline_data_size(PVFS_fs_id fs_id);
+
 int PINT_lookup_parent(char *filename,
                        PVFS_fs_id fs_id,
                        PVFS_credential *credential,
@@ -20,7 +20,10 @@
 #include "string.h"
 #endif
 #include <errno.h>
+#include <poll.h>
+#include <linux/errqueue.h>
 #include <pint-cached-config.h>
+#include "client-state-machine.h"
 
 /** this is a global analog of errno for pvfs specific
  *  errors errno is set to EIO and this is set to the
@@ -3485,63 +3488,436 @@ errorout:
     return rc;
 }
 
-int iocommon_sendfile(int sockfd, pvfs_descriptor *pd,
-                      off64_t *offset, size_t count)
+/*
+ * sendfile pipeline
+ *
+ * iocommon_sendfile keeps up to IOCOMMON_SENDFILE_NBUF reads posted
+ * with PVFS_isys_io while the oldest completed chunk is pushed to the
+ * socket, so file system and network I/O overlap.  Chunk buffers are
+ * kept in a per-thread pool and reused across calls.  Large chunks are
+ * sent with MSG_ZEROCOPY when the kernel supports it; a buffer is not
+ * refilled until the kernel reports that its pages have been sent.
+ */
+#define IOCOMMON_SENDFILE_NBUF 4
+#define IOCOMMON_SENDFILE_BUFSZ (2*1024*1024)
+#define IOCOMMON_SENDFILE_ZC_MIN (64*1024)
+
+struct sendfile_chunk
 {
-    int rc = 0, bytes_read = 0;
-    PVFS_Request mem_req, file_req;
     char *buffer;
-    int buffer_size = (8*1024*1024);
+    PVFS_size len;            /* bytes requested from the file */
+    PVFS_Request mem_req;
+    PVFS_sys_op_id op_id;
+    PVFS_sysresp_io resp;
+    int posted;
+    uint64_t zc_mark;         /* zerocopy sends that must drain first */
+};
 
-    if (!pd || pd->is_in_use != PVFS_FS)
+struct sendfile_pool
+{
+    char *buffer[IOCOMMON_SENDFILE_NBUF];
+};
+
+struct sendfile_zc
+{
+    int enabled;
+    uint64_t issued;
+    uint64_t completed;
+};
+
+static pthread_key_t sendfile_pool_key;
+static pthread_once_t sendfile_pool_once = PTHREAD_ONCE_INIT;
+
+static void sendfile_pool_destroy(void *arg)
+{
+    struct sendfile_pool *pool = (struct sendfile_pool *)arg;
+    int i;
+
+    for (i = 0; i < IOCOMMON_SENDFILE_NBUF; i++)
     {
-        errno = EBADF;
-        return -1;
+        free(pool->buffer[i]);
     }
-    buffer = (char *)malloc(buffer_size);
+    free(pool);
+}
 
-    PVFS_Request_contiguous(buffer_size, PVFS_BYTE, &mem_req);
-    file_req = PVFS_BYTE;
+static void sendfile_pool_key_init(void)
+{
+    pthread_key_create(&sendfile_pool_key, sendfile_pool_destroy);
+}
 
-    errno = 0;
-    rc = iocommon_readorwrite_nocache(PVFS_IO_READ,
-                                      &pd->s->pvfs_ref,
-                                      *offset + bytes_read,
-                                      buffer,
-                                      mem_req,
-                                      file_req);
-    while(rc > 0)
+/** returns this thread's sendfile buffers, allocating them on first use
+ */
+static struct sendfile_pool *sendfile_pool_get(void)
+{
+    struct sendfile_pool *pool;
+    int i;
+
+    pthread_once(&sendfile_pool_once, sendfile_pool_key_init);
+    pool = (struct sendfile_pool *)pthread_getspecific(sendfile_pool_key);
+    if (pool)
+    {
+        return pool;
+    }
+    pool = (struct sendfile_pool *)calloc(1, sizeof(struct sendfile_pool));
+    if (!pool)
+    {
+        return NULL;
+    }
+    for (i = 0; i < IOCOMMON_SENDFILE_NBUF; i++)
+    {
+        pool->buffer[i] = (char *)malloc(IOCOMMON_SENDFILE_BUFSZ);
+        if (!pool->buffer[i])
+        {
+            sendfile_pool_destroy(pool);
+            return NULL;
+        }
+    }
+    pthread_setspecific(sendfile_pool_key, pool);
+    return pool;
+}
+
+/** turns on MSG_ZEROCOPY for the socket unless the application
+ *  already uses it, in which case its completions are not ours to eat
+ */
+static void sendfile_zc_start(int sockfd, struct sendfile_zc *zc)
+{
+    memset(zc, 0, sizeof(*zc));
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
     {
-        int flags = 0;
-        bytes_read += rc;
-        if (bytes_read + buffer_size < count)
+        int one = 1, cur = 0;
+        socklen_t len = sizeof(cur);
+
+        if (glibc_ops.getsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY,
+                                 &cur, &len) == 0 && !cur &&
+            glibc_ops.setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY,
+                                 &one, sizeof(one)) == 0)
         {
-            flags = MSG_MORE;
+            zc->enabled = 1;
         }
-        rc = glibc_ops.send(sockfd, buffer, rc, flags);
+    }
+#endif
+}
+
+/** reaps zerocopy completion notifications until at least "mark"
+ *  sends have completed.  Returns 0 on success, -1 on error
+ */
+static int sendfile_zc_wait(int sockfd, struct sendfile_zc *zc, uint64_t mark)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    while (zc->completed < mark)
+    {
+        char control[128];
+        struct msghdr msg;
+        struct cmsghdr *cm;
+        struct sock_extended_err *serr;
+        struct pollfd pfd;
+        int rc;
+
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        rc = glibc_ops.recvmsg(sockfd, &msg, MSG_ERRQUEUE);
         if (rc < 0)
         {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            {
+                /* POLLERR is raised when the error queue has data */
+                pfd.fd = sockfd;
+                pfd.events = 0;
+                pfd.revents = 0;
+                poll(&pfd, 1, 100);
+                continue;
+            }
+            return -1;
+        }
+        for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+        {
+            serr = (struct sock_extended_err *)CMSG_DATA(cm);
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno)
+            {
+                continue;
+            }
+            zc->completed += (uint64_t)(serr->ee_data - serr->ee_info) + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED)
+            {
+                /* kernel fell back to copying, e.g. loopback - stop
+                 * paying for page pinning and notifications
+                 */
+                zc->enabled = 0;
+            }
+        }
+    }
+#endif
+    return 0;
+}
+
+/** waits for all zerocopy sends and restores the socket option
+ */
+static void sendfile_zc_finish(int sockfd, struct sendfile_zc *zc)
+{
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+    int zero = 0;
+
+    if (zc->issued == 0 && !zc->enabled)
+    {
+        return;
+    }
+    sendfile_zc_wait(sockfd, zc, zc->issued);
+    glibc_ops.setsockopt(sockfd, SOL_SOCKET, SO_ZEROCOPY, &zero, sizeof(zero));
+#endif
+}
+
+/** sends len bytes from buf, retrying short writes.  Returns bytes
+ *  sent, which is less than len only on error
+ */
+static ssize_t sendfile_push(int sockfd,
+                             struct sendfile_zc *zc,
+                             const char *buf,
+                             size_t len,
+                             int more)
+{
+    size_t sent = 0;
+    int rc;
+
+    while (sent < len)
+    {
+        int flags = more ? MSG_MORE : 0;
+        int zerocopy = 0;
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+        if (zc->enabled && len - sent >= IOCOMMON_SENDFILE_ZC_MIN)
+        {
+            flags |= MSG_ZEROCOPY;
+            zerocopy = 1;
+        }
+#endif
+        rc = glibc_ops.send(sockfd, buf + sent, len - sent, flags);
+        if (rc < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == ENOBUFS && zerocopy)
+            {
+                /* out of optmem for pinned pages, copy instead */
+                zc->enabled = 0;
+                continue;
+            }
             break;
         }
-        errno = 0;
-        rc = iocommon_readorwrite_nocache(PVFS_IO_READ,
-                                          &pd->s->pvfs_ref,
-                                          *offset + bytes_read,
-                                          buffer,
-                                          mem_req,
-                                          file_req);
-    }  
-    PVFS_Request_free(&mem_req);
-    free(buffer);
+        if (zerocopy)
+        {
+            zc->issued++;
+        }
+        sent += rc;
+    }
+    return sent;
+}
+
+/** posts a nonblocking read of len bytes at offset into the chunk
+ */
+static int sendfile_post(pvfs_descriptor *pd,
+                         PVFS_credential *credential,
+                         struct sendfile_chunk *chunk,
+                         PVFS_size offset,
+                         PVFS_size len)
+{
+    int rc;
+
+    memset(&chunk->resp, 0, sizeof(chunk->resp));
+    chunk->len = len;
+    chunk->op_id = -1;
+    rc = PVFS_Request_contiguous(len, PVFS_BYTE, &chunk->mem_req);
+    if (rc < 0)
+    {
+        return rc;
+    }
+    rc = PVFS_isys_io(pd->s->pvfs_ref,
+                      PVFS_BYTE,
+                      offset,
+                      chunk->buffer,
+                      chunk->mem_req,
+                      credential,
+                      &chunk->resp,
+                      PVFS_IO_READ,
+                      &chunk->op_id,
+                      PVFS_HINT_NULL,
+                      NULL);
+    if (rc < 0)
+    {
+        PVFS_Request_free(&chunk->mem_req);
+        return rc;
+    }
+    chunk->posted = 1;
+    return 0;
+}
+
+/** waits for a posted read and releases it.  Returns bytes read or a
+ *  PVFS error code
+ */
+static PVFS_error sendfile_complete(struct sendfile_chunk *chunk)
+{
+    PVFS_error rc = 0, error = 0;
+
+    if (chunk->op_id != -1)
+    {
+        rc = PVFS_sys_wait(chunk->op_id, "sendfile", &error);
+        if (rc == 0)
+        {
+            rc = error;
+        }
+        PINT_sys_release(chunk->op_id);
+    }
+    PVFS_Request_free(&chunk->mem_req);
+    chunk->posted = 0;
     if (rc < 0)
+    {
+        return rc;
+    }
+    return chunk->resp.total_completed;
+}
+
+ssize_t iocommon_sendfile(int sockfd, pvfs_descriptor *pd,
+                          off64_t *offset, size_t count)
+{
+    int rc = 0;
+    int orig_errno = errno;
+    int i, head = 0, tail = 0, eof = 0, saved_errno;
+    ssize_t sent, bytes_sent = 0;
+    PVFS_size start, post_off, remaining;
+    PVFS_credential *credential;
+    struct sendfile_pool *pool;
+    struct sendfile_chunk chunk[IOCOMMON_SENDFILE_NBUF];
+    struct sendfile_zc zc;
+
+    if (!pd || pd->is_in_use != PVFS_FS)
+    {
+        errno = EBADF;
+        return -1;
+    }
+    if (count == 0)
+    {
+        return 0;
+    }
+    pool = sendfile_pool_get();
+    if (!pool)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    rc = iocommon_cred(&credential);
+    if (rc != 0)
     {
         return -1;
     }
+
+    /* a NULL offset means read from, and advance, the file pointer */
+    if (offset)
+    {
+        start = *offset;
+    }
     else
     {
-        *offset += bytes_read;
-        return bytes_read;
+        gen_mutex_lock(&pd->s->lock);
+        start = pd->s->file_pointer;
+        gen_mutex_unlock(&pd->s->lock);
+    }
+
+    memset(chunk, 0, sizeof(chunk));
+    for (i = 0; i < IOCOMMON_SENDFILE_NBUF; i++)
+    {
+        chunk[i].buffer = pool->buffer[i];
+    }
+    sendfile_zc_start(sockfd, &zc);
+
+    post_off = start;
+    remaining = count;
+
+    /* prime the pipeline */
+    for (i = 0; i < IOCOMMON_SENDFILE_NBUF && remaining > 0; i++)
+    {
+        PVFS_size len = PVFS_util_min(remaining, IOCOMMON_SENDFILE_BUFSZ);
+        errno = 0;
+        rc = sendfile_post(pd, credential, &chunk[tail], post_off, len);
+        IOCOMMON_CHECK_ERR(rc);
+        post_off += len;
+        remaining -= len;
+        tail = (tail + 1) % IOCOMMON_SENDFILE_NBUF;
+    }
+
+    /* retire chunks in file order, refilling each as it is sent */
+    while (chunk[head].posted)
+    {
+        PVFS_size len = chunk[head].len;
+
+        errno = 0;
+        rc = sendfile_complete(&chunk[head]);
+        IOCOMMON_CHECK_ERR(rc);
+        if (rc < len)
+        {
+            eof = 1;
+        }
+        if (rc > 0)
+        {
+            sent = sendfile_push(sockfd, &zc, chunk[head].buffer, rc,
+                                 !eof && (remaining > 0 ||
+                                 chunk[(head + 1) %
+                                       IOCOMMON_SENDFILE_NBUF].posted));
+            bytes_sent += sent;
+            chunk[head].zc_mark = zc.issued;
+            if (sent < rc)
+            {
+                rc = -1;
+                goto errorout;
+            }
+        }
+        if (!eof && remaining > 0)
+        {
+            len = PVFS_util_min(remaining, IOCOMMON_SENDFILE_BUFSZ);
+            if (sendfile_zc_wait(sockfd, &zc, chunk[head].zc_mark) < 0)
+            {
+                rc = -1;
+                goto errorout;
+            }
+            errno = 0;
+            rc = sendfile_post(pd, credential, &chunk[head], post_off, len);
+            IOCOMMON_CHECK_ERR(rc);
+            post_off += len;
+            remaining -= len;
+        }
+        head = (head + 1) % IOCOMMON_SENDFILE_NBUF;
+    }
+    rc = 0;
+
+errorout:
+    saved_errno = errno;
+    /* buffers go back to the pool, so nothing may still point at them */
+    for (i = 0; i < IOCOMMON_SENDFILE_NBUF; i++)
+    {
+        if (chunk[i].posted)
+        {
+            sendfile_complete(&chunk[i]);
+        }
+    }
+    sendfile_zc_finish(sockfd, &zc);
+    if (bytes_sent > 0)
+    {
+        /* like sendfile(2), report partial progress rather than error */
+        if (offset)
+        {
+            *offset = start + bytes_sent;
+        }
+        else
+        {
+            gen_mutex_lock(&pd->s->lock);
+            pd->s->file_pointer = start + bytes_sent;
+            gen_mutex_unlock(&pd->s->lock);
+        }
+        errno = orig_errno;
+        return bytes_sent;
     }
+    errno = saved_errno;
+    return rc < 0 ? -1 : 0;
 }
 
 /** Implelments an extended attribute get or read
@@ -282,10 +282,10 @@ extern int iocommon_access(const char *pvfs_path,
                            int flags,
                            PVFS_object_ref *pdir);
 
-extern int iocommon_sendfile(int sockfd,
-                             pvfs_descriptor *pd,
-                             off64_t *offset,
-                             size_t count);
+extern ssize_t iocommon_sendfile(int sockfd,
+                                 pvfs_descriptor *pd,
+                                 off64_t *offset,
+                                 size_t count);
 
 
 /* Functions in this file generally define a label errorout
@@ -8,23 +8,488 @@
  *  \ingroup usrint
  *
  *  mmap operations for user interface
+ *
+ *  When the kernel provides userfaultfd, PVFS mappings are backed by
+ *  an anonymous region that is filled on demand: a handler thread
+ *  services missing-page faults by reading one stripe at a time from
+ *  the file, growing the read window while access stays sequential.
+ *  For shared writable maps pages are installed write-protected so
+ *  the first store to each page is recorded in a dirty bitmap, and
+ *  msync/munmap write back only the modified ranges.  Without
+ *  userfaultfd the whole region is read at map time as before.
  */
 
 #include "usrint.h"
 #include "posix-ops.h"
 #include "posix-pvfs.h"
 #include "openfile-util.h"
+#include "iocommon.h"
+#include "client-state-machine.h"
 #include <quicklist.h>
+#ifdef HAVE_LINUX_USERFAULTFD_H
+#include <poll.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/userfaultfd.h>
+#endif
+
+/* fault-in unit when the file reports no stripe size */
+#define PVFS_MMAP_DEFAULT_BATCH (256*1024)
+/* upper bound on one fault-in unit */
+#define PVFS_MMAP_MAX_BATCH (4*1024*1024)
+/* sequential prefetch grows up to this many batches */
+#define PVFS_MMAP_MAX_WINDOW 8
+/* clean resident pages allowed between two dirty runs that are merged */
+#define PVFS_MMAP_MERGE_GAP 16
+/* writeback I/Os kept in flight by msync */
+#define PVFS_MMAP_MAX_WRITES 8
 
 static struct qlist_head maplist = QLIST_HEAD_INIT(maplist);
+static gen_mutex_t maplist_mutex = GEN_MUTEX_INITIALIZER;
+
+#define MAP_BIT_TEST(map, pg) ((map)[(pg) >> 3] & (1 << ((pg) & 7)))
+#define MAP_BIT_SET(map, pg) ((map)[(pg) >> 3] |= (1 << ((pg) & 7)))
+#define MAP_BIT_CLEAR(map, pg) ((map)[(pg) >> 3] &= ~(1 << ((pg) & 7)))
+
+static int mmap_writeback(struct pvfs_mmap_s *mapl,
+                          size_t first,
+                          size_t last);
+
+/** finds the mapping containing addr, maplist_mutex must be held
+ */
+static struct pvfs_mmap_s *mmap_find(void *addr, size_t length)
+{
+    struct pvfs_mmap_s *mapl;
+
+    qlist_for_each_entry(mapl, &maplist, link)
+    {
+        if ((u_char *)mapl->mst <= (u_char *)addr &&
+            (u_char *)mapl->mst + mapl->mlen >= (u_char *)addr + length)
+        {
+            return mapl;
+        }
+    }
+    return NULL;
+}
+
+/** reads len bytes of the file at offset into buf, zero filling
+ *  anything past EOF
+ */
+static int mmap_fill(PVFS_object_ref *ref,
+                     void *buf,
+                     off_t offset,
+                     size_t len)
+{
+    int rc;
+    PVFS_Request mem_req;
+
+    rc = PVFS_Request_contiguous(len, PVFS_BYTE, &mem_req);
+    if (rc < 0)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    rc = iocommon_readorwrite_nocache(PVFS_IO_READ,
+                                      ref,
+                                      offset,
+                                      buf,
+                                      mem_req,
+                                      PVFS_BYTE);
+    PVFS_Request_free(&mem_req);
+    if (rc < 0)
+    {
+        return -1;
+    }
+    if (rc < len)
+    {
+        memset((u_char *)buf + rc, 0, len - rc);
+    }
+    return 0;
+}
+
+#ifdef HAVE_LINUX_USERFAULTFD_H
+
+static int uffd = -1;
+static int uffd_wp = 0;
+static pthread_once_t uffd_once = PTHREAD_ONCE_INIT;
+static void *uffd_stage = NULL;
+static size_t uffd_stage_size = 0;
+
+static int uffd_open(uint64_t features)
+{
+    int fd;
+    struct uffdio_api api;
+
+    fd = syscall(__NR_userfaultfd, O_CLOEXEC | O_NONBLOCK);
+    if (fd < 0)
+    {
+        return -1;
+    }
+    memset(&api, 0, sizeof(api));
+    api.api = UFFD_API;
+    api.features = features;
+    if (ioctl(fd, UFFDIO_API, &api) < 0)
+    {
+        glibc_ops.close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** marks a page dirty and lets the faulting store proceed
+ */
+static void uffd_handle_wp(unsigned long addr)
+{
+#ifdef UFFDIO_WRITEPROTECT
+    struct pvfs_mmap_s *mapl;
+    struct uffdio_writeprotect wp;
+    long pagesize = getpagesize();
+
+    addr &= ~(pagesize - 1);
+    gen_mutex_lock(&maplist_mutex);
+    mapl = mmap_find((void *)addr, 1);
+    if (mapl && mapl->mdirty)
+    {
+        MAP_BIT_SET(mapl->mdirty, (addr - (unsigned long)mapl->mst) / pagesize);
+    }
+    gen_mutex_unlock(&maplist_mutex);
+    memset(&wp, 0, sizeof(wp));
+    wp.range.start = addr;
+    wp.range.len = pagesize;
+    wp.mode = 0;
+    ioctl(uffd, UFFDIO_WRITEPROTECT, &wp);
+#endif
+}
+
+/** installs len bytes of staged data at off within the mapping,
+ *  skipping pages that are already resident
+ */
+static void uffd_install(struct pvfs_mmap_s *mapl, size_t off, size_t len)
+{
+    struct uffdio_copy copy;
+    long pagesize = getpagesize();
+    size_t pg, first = off / pagesize, last = (off + len) / pagesize;
+
+    for (pg = first; pg < last; pg++)
+    {
+        size_t run;
+
+        if (MAP_BIT_TEST(mapl->mpresent, pg))
+        {
+            continue;
+        }
+        for (run = pg; run < last && !MAP_BIT_TEST(mapl->mpresent, run); run++)
+        {
+            MAP_BIT_SET(mapl->mpresent, run);
+        }
+        memset(&copy, 0, sizeof(copy));
+        copy.dst = (unsigned long)mapl->mst + pg * pagesize;
+        copy.src = (unsigned long)uffd_stage + (pg - first) * pagesize;
+        copy.len = (run - pg) * pagesize;
+#ifdef UFFDIO_COPY_MODE_WP
+        copy.mode = mapl->mdirty ? UFFDIO_COPY_MODE_WP : 0;
+#endif
+        while (ioctl(uffd, UFFDIO_COPY, &copy) < 0 &&
+               errno == EAGAIN && copy.copy > 0)
+        {
+            /* partial copy, carry on from where it stopped */
+            copy.dst += copy.copy;
+            copy.src += copy.copy;
+            copy.len -= copy.copy;
+            copy.copy = 0;
+        }
+        pg = run;
+    }
+}
+
+/** services a missing page by reading the batch that contains it,
+ *  or a larger window when the mapping is being read sequentially.
+ *  The read runs without maplist_mutex, so the mapping is looked up
+ *  again before the data is installed.  If the file cannot be read the
+ *  pages stay missing and the faulting thread gets SIGBUS, as it would
+ *  for a kernel-backed file mapping.
+ */
+static void uffd_handle_missing(unsigned long addr, pid_t ptid)
+{
+    struct pvfs_mmap_s *mapl;
+    struct uffdio_range range;
+    PVFS_object_ref ref;
+    long pagesize = getpagesize();
+    void *mst;
+    off_t moff;
+    size_t off, len, maplen;
+    int rc;
+
+    addr &= ~(pagesize - 1);
+    range.start = addr;
+    range.len = pagesize;
+    gen_mutex_lock(&maplist_mutex);
+    mapl = mmap_find((void *)addr, 1);
+    if (!mapl)
+    {
+        gen_mutex_unlock(&maplist_mutex);
+        /* raced with munmap, let the thread retry and fault normally */
+        ioctl(uffd, UFFDIO_WAKE, &range);
+        return;
+    }
+    off = addr - (unsigned long)mapl->mst;
+    off -= off % mapl->mbatch;
+    if (off == mapl->mnext)
+    {
+        mapl->mwindow *= 2;
+        if (mapl->mwindow > mapl->mbatch * PVFS_MMAP_MAX_WINDOW)
+        {
+            mapl->mwindow = mapl->mbatch * PVFS_MMAP_MAX_WINDOW;
+        }
+    }
+    else
+    {
+        mapl->mwindow = mapl->mbatch;
+    }
+    /* the registered range is whole pages even if mlen is not */
+    maplen = (mapl->mlen + pagesize - 1) & ~(pagesize - 1);
+    len = mapl->mwindow;
+    if (off + len > maplen)
+    {
+        len = maplen - off;
+    }
+    mapl->mnext = off + len;
+    mst = mapl->mst;
+    moff = mapl->moff;
+    ref = mapl->mref;
+    gen_mutex_unlock(&maplist_mutex);
+
+    /* only this thread uses the staging buffer */
+    rc = mmap_fill(&ref, uffd_stage, moff + off, len);
+
+    gen_mutex_lock(&maplist_mutex);
+    mapl = mmap_find((void *)addr, 1);
+    if (!mapl || mapl->mst != mst || mapl->moff != moff ||
+        mapl->mref.handle != ref.handle || mapl->mref.fs_id != ref.fs_id)
+    {
+        /* unmapped while reading, possibly mapped again */
+        gen_mutex_unlock(&maplist_mutex);
+        ioctl(uffd, UFFDIO_WAKE, &range);
+        return;
+    }
+    if (rc < 0)
+    {
+        gen_mutex_unlock(&maplist_mutex);
+        gossip_debug(GOSSIP_USRINT_DEBUG,
+                     "pvfs_mmap: read at offset %lld failed, raising SIGBUS\n",
+                     (long long)(moff + off));
+        /* the signal is pending by the time the woken thread would
+         * return to the faulting access
+         */
+        if (ptid > 0)
+        {
+            syscall(SYS_tgkill, getpid(), ptid, SIGBUS);
+        }
+        else
+        {
+            kill(getpid(), SIGBUS);
+        }
+        ioctl(uffd, UFFDIO_WAKE, &range);
+        return;
+    }
+    uffd_install(mapl, off, len);
+    gen_mutex_unlock(&maplist_mutex);
+}
+
+static void *uffd_handler(void *arg)
+{
+    struct uffd_msg msg[16];
+    struct pollfd pfd;
+    int i, n;
+
+    for (;;)
+    {
+        pfd.fd = uffd;
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+        if (poll(&pfd, 1, -1) < 0)
+        {
+            continue;
+        }
+        n = glibc_ops.read(uffd, msg, sizeof(msg));
+        if (n <= 0)
+        {
+            continue;
+        }
+        for (i = 0; i < n / (int)sizeof(struct uffd_msg); i++)
+        {
+            if (msg[i].event != UFFD_EVENT_PAGEFAULT)
+            {
+                continue;
+            }
+#ifdef UFFD_PAGEFAULT_FLAG_WP
+            if (msg[i].arg.pagefault.flags & UFFD_PAGEFAULT_FLAG_WP)
+            {
+                uffd_handle_wp(msg[i].arg.pagefault.address);
+                continue;
+            }
+#endif
+#ifdef UFFD_FEATURE_THREAD_ID
+            uffd_handle_missing(msg[i].arg.pagefault.address,
+                                msg[i].arg.pagefault.feat.ptid);
+#else
+            uffd_handle_missing(msg[i].arg.pagefault.address, 0);
+#endif
+        }
+    }
+    return NULL;
+}
+
+static void uffd_init(void)
+{
+    pthread_t tid;
+    uint64_t features = 0;
+    int fd = -1;
+
+    uffd_stage_size = PVFS_MMAP_MAX_BATCH * PVFS_MMAP_MAX_WINDOW;
+    uffd_stage = glibc_ops.mmap(NULL, uffd_stage_size,
+                                PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (uffd_stage == MAP_FAILED)
+    {
+        uffd_stage = NULL;
+        return;
+    }
+#ifdef UFFD_FEATURE_THREAD_ID
+    /* names the faulting thread, which gets SIGBUS on read errors */
+    features = UFFD_FEATURE_THREAD_ID;
+#endif
+#if defined(UFFD_FEATURE_PAGEFAULT_FLAG_WP) && defined(UFFDIO_WRITEPROTECT)
+    fd = uffd_open(UFFD_FEATURE_PAGEFAULT_FLAG_WP | features);
+    if (fd >= 0)
+    {
+        uffd_wp = 1;
+    }
+#endif
+    if (fd < 0)
+    {
+        fd = uffd_open(features);
+    }
+    if (fd < 0)
+    {
+        fd = uffd_open(0);
+    }
+    if (fd < 0)
+    {
+        gossip_debug(GOSSIP_USRINT_DEBUG,
+                     "pvfs_mmap: userfaultfd unavailable, mapping eagerly\n");
+        glibc_ops.munmap(uffd_stage, uffd_stage_size);
+        uffd_stage = NULL;
+        return;
+    }
+    uffd = fd;
+    if (pthread_create(&tid, NULL, uffd_handler, NULL) != 0)
+    {
+        glibc_ops.close(uffd);
+        uffd = -1;
+        return;
+    }
+    pthread_detach(tid);
+}
+
+/** registers a new mapping for demand paging.  Returns 0 on success,
+ *  -1 if the caller should fall back to an eager read
+ */
+static int uffd_register(struct pvfs_mmap_s *mapl)
+{
+    struct uffdio_register reg;
+    long pagesize = getpagesize();
+    size_t npages = (mapl->mlen + pagesize - 1) / pagesize;
+
+    pthread_once(&uffd_once, uffd_init);
+    if (uffd < 0)
+    {
+        return -1;
+    }
+    mapl->mpresent = (u_char *)calloc(1, (npages + 7) / 8);
+    if (!mapl->mpresent)
+    {
+        return -1;
+    }
+    memset(&reg, 0, sizeof(reg));
+    reg.range.start = (unsigned long)mapl->mst;
+    reg.range.len = npages * pagesize;
+    reg.mode = UFFDIO_REGISTER_MODE_MISSING;
+#ifdef UFFDIO_REGISTER_MODE_WP
+    if (uffd_wp && (mapl->mflags & MAP_SHARED) && (mapl->mprot & PROT_WRITE))
+    {
+        mapl->mdirty = (u_char *)calloc(1, (npages + 7) / 8);
+        if (mapl->mdirty)
+        {
+            reg.mode |= UFFDIO_REGISTER_MODE_WP;
+        }
+    }
+#endif
+    if (ioctl(uffd, UFFDIO_REGISTER, &reg) < 0)
+    {
+        free(mapl->mdirty);
+        free(mapl->mpresent);
+        mapl->mdirty = NULL;
+        mapl->mpresent = NULL;
+        return -1;
+    }
+    mapl->muffd = 1;
+    return 0;
+}
+
+static void uffd_unregister(struct pvfs_mmap_s *mapl)
+{
+    struct uffdio_range range;
+
+    if (!mapl->muffd)
+    {
+        return;
+    }
+    range.start = (unsigned long)mapl->mst;
+    range.len = mapl->mlen;
+    ioctl(uffd, UFFDIO_UNREGISTER, &range);
+    mapl->muffd = 0;
+}
+
+/** write-protects pages again before they are written back, so stores
+ *  that race with the writeback dirty them for the next msync
+ */
+static void uffd_rearm(struct pvfs_mmap_s *mapl, size_t pg, size_t npg)
+{
+#ifdef UFFDIO_WRITEPROTECT
+    struct uffdio_writeprotect wp;
+    long pagesize = getpagesize();
+
+    memset(&wp, 0, sizeof(wp));
+    wp.range.start = (unsigned long)mapl->mst + pg * pagesize;
+    wp.range.len = npg * pagesize;
+    wp.mode = UFFDIO_WRITEPROTECT_MODE_WP;
+    ioctl(uffd, UFFDIO_WRITEPROTECT, &wp);
+#endif
+}
+
+#else /* HAVE_LINUX_USERFAULTFD_H */
+
+static int uffd_register(struct pvfs_mmap_s *mapl)
+{
+    return -1;
+}
+
+static void uffd_unregister(struct pvfs_mmap_s *mapl)
+{
+}
+
+static void uffd_rearm(struct pvfs_mmap_s *mapl, size_t pg, size_t npg)
+{
+}
+
+#endif /* HAVE_LINUX_USERFAULTFD_H */
 
 /** PVFS mmap
  *
- *  This is a very basic implementation that reads whole mapped
- *  region into memory and writes it back if shared on unmap.
- *
- *  This may not perform well or do all of the neat things mmap
- *  does, but it will let basic stuff work.
+ *  Maps an anonymous region and fills it from the file, on demand
+ *  when userfaultfd is available and otherwise all at once.
  */
 void *pvfs_mmap(void *start,
                 size_t length,
@@ -36,6 +501,8 @@ void *pvfs_mmap(void *start,
     int rc = 0;
     pvfs_descriptor *pd;
     struct pvfs_mmap_s *mlist;
+    PVFS_sys_attr attr;
+    long pagesize = getpagesize();
     void *maddr;
 
     if (flags & MAP_ANONYMOUS)
@@ -57,28 +524,77 @@ void *pvfs_mmap(void *start,
     {
         return MAP_FAILED;
     }
-    /* we will map an ANON region and read the file into it */
-    maddr = glibc_ops.mmap(start, length, prot, flags & MAP_ANONYMOUS,
-                               -1, offset);
-    if (maddr == MAP_FAILED)
+    if (offset % pagesize != 0)
+    {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    mlist = (struct pvfs_mmap_s *)calloc(1, sizeof(struct pvfs_mmap_s));
+    if (!mlist)
     {
+        errno = ENOMEM;
         return MAP_FAILED;
     }
-    rc = pvfs_pread(fd, maddr, length, offset);
+    /* the object ref keeps the map usable after fd is closed */
+    mlist->mref = pd->s->pvfs_ref;
+    memset(&attr, 0, sizeof(attr));
+    rc = iocommon_getattr(mlist->mref, &attr,
+                          PVFS_ATTR_SYS_SIZE | PVFS_ATTR_SYS_BLKSIZE);
     if (rc < 0)
     {
-        glibc_ops.munmap(maddr, length);
+        free(mlist);
         return MAP_FAILED;
     }
-    /* record this in the open file descriptor */
-    mlist = (struct pvfs_mmap_s *)malloc(sizeof(struct pvfs_mmap_s));
-    mlist->mst = start;
+    mlist->mfsize = attr.size;
+    mlist->mbatch = attr.blksize ? attr.blksize : PVFS_MMAP_DEFAULT_BATCH;
+    mlist->mbatch = (mlist->mbatch + pagesize - 1) & ~(pagesize - 1);
+    if (mlist->mbatch > PVFS_MMAP_MAX_BATCH)
+    {
+        mlist->mbatch = PVFS_MMAP_MAX_BATCH;
+    }
+    mlist->mwindow = mlist->mbatch;
+    mlist->mnext = (size_t)-1;
+
+    /* we will map an ANON region and fill it from the file */
+    maddr = glibc_ops.mmap(start, length, prot | PROT_READ,
+                           MAP_PRIVATE | MAP_ANONYMOUS | (flags & MAP_FIXED),
+                           -1, 0);
+    if (maddr == MAP_FAILED)
+    {
+        free(mlist);
+        return MAP_FAILED;
+    }
+    mlist->mst = maddr;
     mlist->mlen = length;
     mlist->mprot = prot;
     mlist->mflags = flags;
     mlist->mfd = fd;
     mlist->moff = offset;
+
+    gen_mutex_lock(&maplist_mutex);
+    if (uffd_register(mlist) < 0)
+    {
+        /* no demand paging, read the whole region now */
+        if (!(prot & PROT_WRITE))
+        {
+            mprotect(maddr, length, prot | PROT_READ | PROT_WRITE);
+        }
+        rc = mmap_fill(&mlist->mref, maddr, offset, length);
+        if (!(prot & PROT_WRITE))
+        {
+            mprotect(maddr, length, prot | PROT_READ);
+        }
+        if (rc < 0)
+        {
+            gen_mutex_unlock(&maplist_mutex);
+            glibc_ops.munmap(maddr, length);
+            free(mlist);
+            return MAP_FAILED;
+        }
+    }
+    /* record this in the map list */
     qlist_add(&mlist->link, &maplist);
+    gen_mutex_unlock(&maplist_mutex);
     /* and done */
     return maddr;
 }
@@ -90,7 +606,7 @@ void *pvfs_mmap(void *start,
 int pvfs_munmap(void *start, size_t length)
 {
     int rc = 0;
-    struct pvfs_mmap_s *mapl, *temp;
+    struct pvfs_mmap_s *mapl = NULL, *cur;
     long long pagesize = getpagesize();
 
 #if PVFS2_SIZEOF_VOIDP == 64
@@ -102,26 +618,33 @@ int pvfs_munmap(void *start, size_t length)
         errno = EINVAL;
         return -1;
     }
-    qlist_for_each_entry_safe(mapl, temp, &maplist, link)
+    gen_mutex_lock(&maplist_mutex);
+    qlist_for_each_entry(cur, &maplist, link)
     {
         /* assuming we must unmap something that was mapped */
         /* and not just part of it */
-        if (mapl->mst == start && mapl->mlen == length)
+        if (cur->mst == start && cur->mlen == length)
         {
-            qlist_del(&mapl->link);
+            mapl = cur;
             break;
         }
     }
     if (!mapl)
     {
-        errno = EINVAL;
-        return -1;
+        gen_mutex_unlock(&maplist_mutex);
+        /* not ours, may be a plain anonymous map */
+        return glibc_ops.munmap(start, length);
     }
     if (mapl->mflags & MAP_SHARED)
     {
-        pvfs_pwrite(mapl->mfd, mapl->mst, mapl->mlen, mapl->moff);
+        mmap_writeback(mapl, 0, (mapl->mlen + pagesize - 1) / pagesize);
     }
+    qlist_del(&mapl->link);
+    uffd_unregister(mapl);
+    gen_mutex_unlock(&maplist_mutex);
     rc = glibc_ops.munmap(start, length);
+    free(mapl->mpresent);
+    free(mapl->mdirty);
     free(mapl);
     return rc;
 }
@@ -134,8 +657,9 @@ int pvfs_munmap(void *start, size_t length)
 int pvfs_msync(void *start, size_t length, int flags)
 {
     int rc = 0;
-    struct pvfs_mmap_s *mapl, *temp;
+    struct pvfs_mmap_s *mapl;
     long long pagesize = getpagesize();
+    size_t first;
 
 #if PVFS2_SIZEOF_VOIDP == 64
     if (((uint64_t)start % pagesize) != 0 || (length % pagesize) != 0)
@@ -146,31 +670,196 @@ int pvfs_msync(void *start, size_t length, int flags)
         errno = EINVAL;
         return -1;
     }
-    qlist_for_each_entry_safe(mapl, temp, &maplist, link)
-    {
-        if ((u_char *)mapl->mst <= (u_char *)start &&
-            (u_char *)mapl->mst + mapl->mlen >= (u_char *)start + length)
-        {
-            break;
-        }
-    }
+    gen_mutex_lock(&maplist_mutex);
+    mapl = mmap_find(start, length);
     if (!mapl)
     {
+        gen_mutex_unlock(&maplist_mutex);
         errno = ENOMEM;
         return -1;
     }
     if (mapl->mflags & MAP_SHARED)
     {
-        /* the diff between start and mst is distance from */
-        /* start of buffer, and distance from original offset */
-        rc = pvfs_pwrite(mapl->mfd,
-                         start,
-                         length,
-                         mapl->moff + ((u_char *)start - (u_char *)mapl->mst));
+        first = ((u_char *)start - (u_char *)mapl->mst) / pagesize;
+        rc = mmap_writeback(mapl, first, first + length / pagesize);
     }
+    gen_mutex_unlock(&maplist_mutex);
     return rc;
 }
 
+/** waits for the write in slot i of mmap_writeback and releases it.
+ *
+ *  A write that completes short counts as an error.
+ */
+static int mmap_writeback_retire(PVFS_sys_op_id *op_id,
+                                 PVFS_Request *mem_req,
+                                 PVFS_sysresp_io *resp,
+                                 PVFS_size *lens,
+                                 int i)
+{
+    PVFS_error rc = 0, error = 0;
+
+    if (op_id[i] != -1)
+    {
+        rc = PVFS_sys_wait(op_id[i], "msync", &error);
+        if (rc == 0)
+        {
+            rc = error;
+        }
+        PINT_sys_release(op_id[i]);
+    }
+    PVFS_Request_free(&mem_req[i]);
+    if (rc == 0 && resp[i].total_completed != lens[i])
+    {
+        rc = -PVFS_EIO;
+    }
+    return rc;
+}
+
+/** writes back pages [first, last) of a shared mapping.
+ *
+ *  With dirty tracking only modified pages are written, without it
+ *  every resident page, and without demand paging the whole range.
+ *  Runs separated by a few resident clean pages are merged so the
+ *  file sees a small number of large writes.  maplist_mutex must be
+ *  held.
+ */
+static int mmap_writeback(struct pvfs_mmap_s *mapl, size_t first, size_t last)
+{
+    int rc = 0, nposted = 0, slot, error;
+    unsigned int seq = 0;
+    long pagesize = getpagesize();
+    size_t pg, run_start, run_end, gap;
+    PVFS_size fileoff, len;
+    PVFS_credential *credential;
+    /* a ring of writes in flight; each keeps its slot until retired
+     * since the request holds pointers into resp */
+    PVFS_Request mem_req[PVFS_MMAP_MAX_WRITES];
+    PVFS_sys_op_id op_id[PVFS_MMAP_MAX_WRITES];
+    PVFS_sysresp_io resp[PVFS_MMAP_MAX_WRITES];
+    PVFS_size lens[PVFS_MMAP_MAX_WRITES];
+    u_char *want = mapl->mdirty ? mapl->mdirty : mapl->mpresent;
+
+    rc = iocommon_cred(&credential);
+    if (rc != 0)
+    {
+        return -1;
+    }
+    pg = first;
+    while (pg < last)
+    {
+        /* find the next run of pages to write */
+        if (want && !MAP_BIT_TEST(want, pg))
+        {
+            pg++;
+            continue;
+        }
+        run_start = pg;
+        run_end = pg + 1;
+        while (want && run_end < last)
+        {
+            if (MAP_BIT_TEST(want, run_end))
+            {
+                run_end++;
+                continue;
+            }
+            /* absorb a short gap of resident pages if more follows */
+            for (gap = run_end; gap < last &&
+                                gap - run_end < PVFS_MMAP_MERGE_GAP &&
+                                !MAP_BIT_TEST(want, gap) &&
+                                MAP_BIT_TEST(mapl->mpresent, gap); gap++);
+            if (gap < last && gap - run_end < PVFS_MMAP_MERGE_GAP &&
+                MAP_BIT_TEST(want, gap))
+            {
+                run_end = gap;
+                continue;
+            }
+            break;
+        }
+        if (!want)
+        {
+            run_end = last;
+        }
+        pg = run_end;
+
+        /* never extend the file past its size when it was mapped */
+        fileoff = mapl->moff + (PVFS_size)run_start * pagesize;
+        len = (PVFS_size)(run_end - run_start) * pagesize;
+        if (run_end * pagesize > mapl->mlen)
+        {
+            len = mapl->mlen - run_start * pagesize;
+        }
+        if (fileoff + len > mapl->mfsize)
+        {
+            if (fileoff >= mapl->mfsize)
+            {
+                continue;
+            }
+            len = mapl->mfsize - fileoff;
+        }
+        if (mapl->mdirty)
+        {
+            size_t p;
+            uffd_rearm(mapl, run_start, run_end - run_start);
+            for (p = run_start; p < run_end; p++)
+            {
+                MAP_BIT_CLEAR(mapl->mdirty, p);
+            }
+        }
+
+        slot = seq % PVFS_MMAP_MAX_WRITES;
+        if (nposted == PVFS_MMAP_MAX_WRITES)
+        {
+            /* the slot holds the oldest write; retire it first */
+            error = mmap_writeback_retire(op_id, mem_req, resp, lens, slot);
+            if (error < 0)
+            {
+                rc = error;
+            }
+            nposted--;
+        }
+        PVFS_Request_contiguous(len, PVFS_BYTE, &mem_req[slot]);
+        memset(&resp[slot], 0, sizeof(resp[slot]));
+        lens[slot] = len;
+        op_id[slot] = -1;
+        error = PVFS_isys_io(mapl->mref,
+                             PVFS_BYTE,
+                             fileoff,
+                             (u_char *)mapl->mst + run_start * pagesize,
+                             mem_req[slot],
+                             credential,
+                             &resp[slot],
+                             PVFS_IO_WRITE,
+                             &op_id[slot],
+                             PVFS_HINT_NULL,
+                             NULL);
+        if (error < 0)
+        {
+            PVFS_Request_free(&mem_req[slot]);
+            rc = error;
+            break;
+        }
+        seq++;
+        nposted++;
+    }
+    while (nposted > 0)
+    {
+        slot = (seq - nposted) % PVFS_MMAP_MAX_WRITES;
+        error = mmap_writeback_retire(op_id, mem_req, resp, lens, slot);
+        if (error < 0)
+        {
+            rc = error;
+        }
+        nposted--;
+    }
+    if (rc < 0)
+    {
+        errno = EIO;
+        return -1;
+    }
+    return 0;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
@@ -179,4 +868,3 @@ int pvfs_msync(void *start, size_t length, int flags)
  *
  * vim: ts=8 sts=4 sw=4 expandtab
  */
-
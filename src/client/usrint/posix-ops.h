@@ -196,6 +196,14 @@ typedef struct pvfs_mmap_s
     int mflags;             /**< flags of mmap region */
     int mfd;                /**< file descriptor of mmap region */
     off_t moff;             /**< offset of mmap region */
+    PVFS_object_ref mref;   /**< file mapped, valid after mfd is closed */
+    PVFS_size mfsize;       /**< file size when mapped */
+    size_t mbatch;          /**< fault-in unit, one stripe */
+    size_t mwindow;         /**< current sequential read-ahead window */
+    size_t mnext;           /**< offset a sequential fault would hit */
+    int muffd;              /**< region is registered with userfaultfd */
+    u_char *mpresent;       /**< bitmap of resident pages */
+    u_char *mdirty;         /**< bitmap of modified pages, if tracked */
     struct qlist_head link;
 } *pvfs_mmap_t;
 
@@ -12,9 +12,48 @@
 #include <usrint.h>
 #include <posix-pvfs.h>
 #include <gossip.h>
+#include <pvfs2-mgmt.h>
+#include <openfile-util.h>
+#include <iocommon.h>
 #include <recursive-remove.h>
 #include <str-utils.h>
 
+/* Empty the PVFS directory "dir" with PVFS_mgmt_remove_tree(), which has
+ * the metadata servers remove a batch of entries per request instead of
+ * the client walking the tree one entry at a time.
+ * Returns 0 if "dir" is now empty, -1 if it must be walked instead.
+ */
+static int remove_tree_on_servers(char *dir)
+{
+    int ret;
+    PVFS_object_ref ref;
+    PVFS_credential *credential;
+    struct PVFS_mgmt_remove_tree_progress progress;
+
+    if (!pvfs_valid_path(dir))
+    {
+        return -1;
+    }
+    ret = iocommon_lookup_absolute(dir, PVFS2_LOOKUP_LINK_NO_FOLLOW, &ref,
+                                   NULL, 0);
+    if (ret < 0)
+    {
+        return -1;
+    }
+    ret = iocommon_cred(&credential);
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    memset(&progress, 0, sizeof(progress));
+    ret = PVFS_mgmt_remove_tree(ref, credential, 0, &progress, NULL, NULL,
+                                NULL);
+    RR_PRINT("removed %llu entries in %llu dirs from %s, ret=%d\n",
+             llu(progress.removed), llu(progress.dirs), dir, ret);
+    return ret < 0 ? -1 : 0;
+}
+
 /* Recursively delete the absolute path "dir".
  * Returns 0 on success, -1 on failure.
  */
@@ -25,6 +64,17 @@ int recursive_delete_dir(char *dir)
     struct dirent * direntp = NULL;
 
     RR_PFI();
+    if (remove_tree_on_servers(dir) == 0)
+    {
+        RR_PRINT("removing dir: %s\n", dir);
+        if (rmdir(dir) != 0)
+        {
+            RR_PERROR("rmdir failed: ");
+            return -1;
+        }
+        return 0;
+    }
+
     RR_PRINT("opening dir=%s\n", dir);
     /* Open the directory specified by dir */
     dirp = opendir(dir);
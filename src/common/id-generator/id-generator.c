@@ -5,6 +5,7 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 
 #ifdef WIN32
@@ -12,169 +13,279 @@
 #endif
 
 #include "id-generator.h"
-#include "quickhash.h"
 #include "gen-locks.h"
 #include "pvfs2-internal.h"
 
-#define DEFAULT_ID_GEN_SAFE_TABLE_SIZE 997
+/* Safe ids are handed out from a table of slots that is allocated in
+ * slabs and never shrinks while the generator is initialized.  An id
+ * carries the slot index in its low 32 bits and the slot's generation in
+ * the high bits.  A slot's generation is odd while it holds an item and
+ * is bumped to even when the item is unregistered, so stale ids simply
+ * stop matching.  Register, lookup and unregister are lock free; the
+ * mutex is only taken to add a slab.
+ */
+#define ID_GEN_SAFE_SLAB_SHIFT 10
+#define ID_GEN_SAFE_SLAB_SIZE (1 << ID_GEN_SAFE_SLAB_SHIFT)
+#define ID_GEN_SAFE_MAX_SLABS 4096
+#define ID_GEN_SAFE_GEN_MASK 0x7fffffffU
+
+typedef struct
+{
+    /* odd while the slot holds an item, even while it is free */
+    uint32_t gen;
+    /* index + 1 of the next free slot; 0 ends the free list */
+    uint32_t next_free;
+    void *item;
+} id_gen_safe_slot_t;
 
 static gen_mutex_t s_id_gen_safe_mutex = GEN_MUTEX_INITIALIZER;
 static int s_id_gen_safe_init_count = 0;
 
-static int hash_key(const void *key, int table_size);
-static int hash_key_compare(const void *key, struct qlist_head *link);
+static id_gen_safe_slot_t *s_id_gen_safe_slabs[ID_GEN_SAFE_MAX_SLABS];
+static int s_id_gen_safe_slab_count = 0;
 
-static BMI_id_gen_t s_id_gen_safe_tag = 0;
+/* free list head: ABA tag in the high 32 bits, slot index + 1 below */
+static uint64_t s_id_gen_safe_free = 0;
 
-typedef struct
+#define ID_GEN_SAFE_INITIALIZED() \
+(s_id_gen_safe_init_count > 0)
+
+static int id_gen_safe_grow(void);
+
+static inline id_gen_safe_slot_t *id_gen_safe_slot(uint32_t index)
 {
-    struct qlist_head hash_link;
+    id_gen_safe_slot_t *slab;
 
-    BMI_id_gen_t id;
-    void *item;
-} id_gen_safe_t;
+    if ((index >> ID_GEN_SAFE_SLAB_SHIFT) >= ID_GEN_SAFE_MAX_SLABS)
+    {
+        return NULL;
+    }
+    slab = __atomic_load_n(
+        &s_id_gen_safe_slabs[index >> ID_GEN_SAFE_SLAB_SHIFT],
+        __ATOMIC_ACQUIRE);
+    if (!slab)
+    {
+        return NULL;
+    }
+    return &slab[index & (ID_GEN_SAFE_SLAB_SIZE - 1)];
+}
 
-static struct qhash_table *s_id_gen_safe_table = NULL;
+static inline void id_gen_safe_push(uint32_t first, uint32_t last)
+{
+    uint64_t head = __atomic_load_n(&s_id_gen_safe_free, __ATOMIC_RELAXED);
+    uint64_t new_head;
+    id_gen_safe_slot_t *slot = id_gen_safe_slot(last);
 
-#define ID_GEN_SAFE_INITIALIZED() \
-(s_id_gen_safe_table)
+    do
+    {
+        __atomic_store_n(&slot->next_free, (uint32_t)head, __ATOMIC_RELAXED);
+        new_head = (((head >> 32) + 1) << 32) | (first + 1);
+    } while (!__atomic_compare_exchange_n(&s_id_gen_safe_free, &head,
+                                          new_head, 1, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+}
 
-int id_gen_safe_initialize()
+static inline int id_gen_safe_pop(uint32_t *index,
+                                  id_gen_safe_slot_t **slot_out)
 {
-    if (!ID_GEN_SAFE_INITIALIZED())
+    uint64_t head = __atomic_load_n(&s_id_gen_safe_free, __ATOMIC_ACQUIRE);
+    uint64_t new_head;
+    id_gen_safe_slot_t *slot;
+
+    while ((uint32_t)head != 0)
     {
-        s_id_gen_safe_table = qhash_init(
-            hash_key_compare, hash_key, DEFAULT_ID_GEN_SAFE_TABLE_SIZE);
-        if (!s_id_gen_safe_table)
+        /* slabs are never released while in use, so reading next_free
+         * from a slot another thread just took is harmless; the tag
+         * makes the exchange fail in that case
+         */
+        slot = id_gen_safe_slot((uint32_t)head - 1);
+        new_head = (((head >> 32) + 1) << 32) |
+            __atomic_load_n(&slot->next_free, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&s_id_gen_safe_free, &head,
+                                        new_head, 1, __ATOMIC_ACQUIRE,
+                                        __ATOMIC_ACQUIRE))
         {
-            return -ENOMEM;
+            *index = (uint32_t)head - 1;
+            *slot_out = slot;
+            return 0;
         }
     }
+    return -1;
+}
+
+int id_gen_safe_initialize()
+{
     s_id_gen_safe_init_count++;
     return 0;
 }
 
 int id_gen_safe_finalize()
 {
+    int i;
+
     s_id_gen_safe_init_count--;
-    if(s_id_gen_safe_init_count == 0 && ID_GEN_SAFE_INITIALIZED())
+    if(s_id_gen_safe_init_count == 0)
     {
         gen_mutex_lock(&s_id_gen_safe_mutex);
-        qhash_destroy_and_finalize(s_id_gen_safe_table, id_gen_safe_t, hash_link, free);
-        s_id_gen_safe_table = NULL;
+        for (i = 0; i < s_id_gen_safe_slab_count; i++)
+        {
+            free(s_id_gen_safe_slabs[i]);
+            s_id_gen_safe_slabs[i] = NULL;
+        }
+        s_id_gen_safe_slab_count = 0;
+        s_id_gen_safe_free = 0;
         gen_mutex_unlock(&s_id_gen_safe_mutex);
     }
     return 0;
 }
 
-int id_gen_safe_register(
-    BMI_id_gen_t *new_id,
-    void *item)
+/* id_gen_safe_grow()
+ *
+ * adds a slab of free slots, unless another thread refilled the free
+ * list while we waited for the mutex
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int id_gen_safe_grow(void)
 {
-    id_gen_safe_t *id_elem = NULL;
+    id_gen_safe_slot_t *slab = NULL;
+    uint32_t base;
+    int i;
 
-    assert(s_id_gen_safe_table != NULL);
+    gen_mutex_lock(&s_id_gen_safe_mutex);
 
-    if (!item)
+    if ((uint32_t)__atomic_load_n(&s_id_gen_safe_free, __ATOMIC_ACQUIRE))
     {
-	return -EINVAL;
+        gen_mutex_unlock(&s_id_gen_safe_mutex);
+        return 0;
     }
 
-    gen_mutex_lock(&s_id_gen_safe_mutex);
+    if (s_id_gen_safe_slab_count == ID_GEN_SAFE_MAX_SLABS)
+    {
+        gen_mutex_unlock(&s_id_gen_safe_mutex);
+        return -ENOMEM;
+    }
 
-    id_elem = (id_gen_safe_t *)malloc(sizeof(id_gen_safe_t));
-    if (!id_elem)
+    slab = malloc(ID_GEN_SAFE_SLAB_SIZE * sizeof(id_gen_safe_slot_t));
+    if (!slab)
     {
+        gen_mutex_unlock(&s_id_gen_safe_mutex);
         return -ENOMEM;
     }
+    memset(slab, 0, ID_GEN_SAFE_SLAB_SIZE * sizeof(id_gen_safe_slot_t));
 
-    id_elem->id = ++s_id_gen_safe_tag;
-    if(id_elem->id == 0)
+    base = s_id_gen_safe_slab_count << ID_GEN_SAFE_SLAB_SHIFT;
+    for (i = 0; i < ID_GEN_SAFE_SLAB_SIZE - 1; i++)
     {
-        /* don't want this to land on zero */
-        id_elem->id = ++s_id_gen_safe_tag;
+        slab[i].next_free = base + i + 2;
     }
-    id_elem->item = item;
 
-    qhash_add(s_id_gen_safe_table, &id_elem->id, &id_elem->hash_link);
+    __atomic_store_n(&s_id_gen_safe_slabs[s_id_gen_safe_slab_count], slab,
+                     __ATOMIC_RELEASE);
+    s_id_gen_safe_slab_count++;
 
-    *new_id = id_elem->id;
+    /* links the last slot of the new slab to the current head */
+    id_gen_safe_push(base, base + ID_GEN_SAFE_SLAB_SIZE - 1);
 
     gen_mutex_unlock(&s_id_gen_safe_mutex);
     return 0;
 }
 
-void *id_gen_safe_lookup(BMI_id_gen_t id)
+int id_gen_safe_register(
+    BMI_id_gen_t *new_id,
+    void *item)
 {
-    void *ret = NULL;
-    id_gen_safe_t *id_elem = NULL;
-    struct qlist_head *hash_link = NULL;
+    id_gen_safe_slot_t *slot = NULL;
+    uint32_t index = 0;
+    uint32_t gen;
+    int ret;
+
+    assert(ID_GEN_SAFE_INITIALIZED());
 
-    if (ID_GEN_SAFE_INITIALIZED())
+    if (!item)
     {
-        gen_mutex_lock(&s_id_gen_safe_mutex);
+	return -EINVAL;
+    }
 
-        hash_link = qhash_search(s_id_gen_safe_table, &id);
-        if (hash_link)
+    while (id_gen_safe_pop(&index, &slot) < 0)
+    {
+        ret = id_gen_safe_grow();
+        if (ret < 0)
         {
-            id_elem = qlist_entry(hash_link, id_gen_safe_t, hash_link);
-            assert(id_elem);
-            assert(id_elem->id == id);
-            assert(id_elem->item);
-
-            ret = id_elem->item;
+            return ret;
         }
-        gen_mutex_unlock(&s_id_gen_safe_mutex);
     }
-    return ret;
+
+    __atomic_store_n(&slot->item, item, __ATOMIC_RELAXED);
+    /* publish; the generation goes from even (free) to odd (live) */
+    gen = (slot->gen + 1) & ID_GEN_SAFE_GEN_MASK;
+    __atomic_store_n(&slot->gen, gen, __ATOMIC_RELEASE);
+
+    *new_id = ((BMI_id_gen_t)gen << 32) | index;
+
+    return 0;
 }
 
-int id_gen_safe_unregister(BMI_id_gen_t new_id)
+void *id_gen_safe_lookup(BMI_id_gen_t id)
 {
-    int ret = -EINVAL;
-    id_gen_safe_t *id_elem = NULL;
-    struct qlist_head *hash_link = NULL;
+    id_gen_safe_slot_t *slot = NULL;
+    uint32_t gen = (uint32_t)((uint64_t)id >> 32);
+    void *item;
 
-    if (ID_GEN_SAFE_INITIALIZED())
+    if (!ID_GEN_SAFE_INITIALIZED() || !(gen & 1))
     {
-        gen_mutex_lock(&s_id_gen_safe_mutex);
+        return NULL;
+    }
 
-        hash_link = qhash_search_and_remove(
-            s_id_gen_safe_table, &new_id);
-        if (hash_link)
-        {
-            id_elem = qlist_entry(hash_link, id_gen_safe_t, hash_link);
-            assert(id_elem);
+    slot = id_gen_safe_slot((uint32_t)id);
+    if (!slot)
+    {
+        return NULL;
+    }
 
-            id_elem->item = NULL;
-            free(id_elem);
-            ret = 0;
-        }
-        gen_mutex_unlock(&s_id_gen_safe_mutex);
+    /* the item only counts if the generation held steady around it */
+    if (__atomic_load_n(&slot->gen, __ATOMIC_ACQUIRE) != gen)
+    {
+        return NULL;
+    }
+    item = __atomic_load_n(&slot->item, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&slot->gen, __ATOMIC_RELAXED) != gen)
+    {
+        return NULL;
     }
-    return ret;
+
+    return item;
 }
 
-static int hash_key(const void *key, int table_size)
+int id_gen_safe_unregister(BMI_id_gen_t new_id)
 {
-    unsigned long tmp = 0;
-    const BMI_id_gen_t *id = key;
+    id_gen_safe_slot_t *slot = NULL;
+    uint32_t gen = (uint32_t)((uint64_t)new_id >> 32);
+    uint32_t index = (uint32_t)new_id;
 
-    tmp += *id;
-    tmp = tmp % table_size;
-
-    return ((int) tmp);
-}
+    if (!ID_GEN_SAFE_INITIALIZED() || !(gen & 1))
+    {
+        return -EINVAL;
+    }
 
-static int hash_key_compare(const void *key, struct qlist_head *link)
-{
-    id_gen_safe_t *id_elem = NULL;
-    BMI_id_gen_t id = *((const BMI_id_gen_t *)key);
+    slot = id_gen_safe_slot(index);
+    if (!slot)
+    {
+        return -EINVAL;
+    }
 
-    id_elem = qlist_entry(link, id_gen_safe_t, hash_link);
-    assert(id_elem);
+    /* only one caller can retire a given generation */
+    if (!__atomic_compare_exchange_n(&slot->gen, &gen,
+                                     (gen + 1) & ID_GEN_SAFE_GEN_MASK, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    {
+        return -EINVAL;
+    }
+    __atomic_store_n(&slot->item, NULL, __ATOMIC_RELAXED);
 
-    return (id_elem->id == id);
+    id_gen_safe_push(index, index);
+    return 0;
 }
 
 /*
@@ -72,15 +72,26 @@ int id_gen_safe_finalize(void);
  * 
  * registers a piece of data (a pointer of some sort) and returns an
  * opaque id for it.  this register is safe because it is guaranteed
- * to have an indirect association with the data being registered
+ * to have an indirect association with the data being registered.
+ * The id names a slot in a lock free table plus that slot's
+ * generation, so ids are never zero and never reused while registered.
  *
  * returns 0 on success, -errno on failure
  */
 int id_gen_safe_register(BMI_id_gen_t *new_id,
                          void *item);
 
+/* id_gen_safe_lookup()
+ *
+ * returns the data registered with an id, or NULL if the id was never
+ * handed out or has since been unregistered
+ */
 void *id_gen_safe_lookup(BMI_id_gen_t id);
 
+/* id_gen_safe_unregister()
+ *
+ * returns 0 on success, -EINVAL if the id is not currently registered
+ */
 int id_gen_safe_unregister(BMI_id_gen_t new_id);
 
 #endif /* __ID_GENERATOR_H */
@@ -6,6 +6,8 @@
 
 #include <string.h>
 #include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
 #ifndef WIN32
 #include <sys/time.h>
 #endif
@@ -25,6 +27,7 @@
 #include "pvfs2-types.h"
 #include "pvfs2-mgmt.h"
 #include "gossip.h"
+#include "gen-locks.h"
 #include "quicklist.h"
 #include "quickhash.h"
 #include "id-generator.h"
@@ -43,8 +46,15 @@ static struct qhash_table *groups_table = NULL;
 static uint32_t event_count = 0;
 uint64_t PINT_event_enabled_mask = 0;
 
-#ifdef HAVE_TAU
+static enum PINT_event_method event_method = PINT_EVENT_TRACE_TAU;
+
+/* one bit of PINT_event_enabled_mask per event */
+#define PINT_EVENT_MAX_EVENTS 64
+/* arguments kept per record; later ones are ignored */
+#define PINT_EVENT_MAX_ARGS 5
+
 static int PINT_event_default_buffer_size = 1024*1024;
+#ifdef HAVE_TAU
 static int PINT_event_default_max_traces = 1024;
 #endif
 
@@ -65,8 +75,27 @@ struct PINT_event
     uint64_t mask;
     struct qlist_head group_link;
     struct qlist_head link;
+    uint32_t index;
+    /* argument types parsed from the start and end formats */
+    char start_args[PINT_EVENT_MAX_ARGS + 1];
+    char end_args[PINT_EVENT_MAX_ARGS + 1];
 };
 
+static struct PINT_event *event_by_index[PINT_EVENT_MAX_EVENTS];
+
+#ifndef WIN32
+
+static int PINT_event_native_init(void);
+static void PINT_event_native_fini(void);
+static void PINT_event_native_record(struct PINT_event *event,
+                                     int kind,
+                                     PINT_event_id id,
+                                     const char *arg_types,
+                                     va_list ap);
+static PINT_event_id PINT_event_native_next_id(void);
+
+#endif /* WIN32 */
+
 #if defined(HAVE_TAU)
 
 static void PINT_event_tau_init(void);
@@ -127,6 +156,61 @@ static int PINT_events_compare(const void *key, struct qhash_head *link)
     return 0;
 }
 
+/* parse_event_format()
+ *
+ * reduces a printf style event format to one type character per
+ * argument so that records can pull their arguments off a va_list:
+ * 'i' int, 'l' long, 'L' long long, 'p' pointer, 's' string, 'f' double
+ */
+static void parse_event_format(const char *format, char *types)
+{
+    int count = 0;
+    int longs;
+    const char *c = format;
+
+    while(c && *c && count < PINT_EVENT_MAX_ARGS)
+    {
+        if(*c++ != '%')
+        {
+            continue;
+        }
+        if(*c == '%')
+        {
+            c++;
+            continue;
+        }
+        while(*c && strchr("-+ #0123456789.", *c))
+        {
+            c++;
+        }
+        longs = 0;
+        while(*c && strchr("hlqjzt", *c))
+        {
+            longs += ((*c == 'l') ? 1 : ((*c == 'h') ? 0 : 2));
+            c++;
+        }
+        switch(*c)
+        {
+            case 's':
+                types[count++] = 's';
+                break;
+            case 'p':
+                types[count++] = 'p';
+                break;
+            case 'f': case 'e': case 'g':
+                types[count++] = 'f';
+                break;
+            case '\0':
+                continue;
+            default:
+                types[count++] = (longs > 1 ? 'L' : (longs ? 'l' : 'i'));
+                break;
+        }
+        c++;
+    }
+    types[count] = '\0';
+}
+
 int PINT_event_init(enum PINT_event_method method)
 {
     int ret;
@@ -164,8 +248,20 @@ int PINT_event_init(enum PINT_event_method method)
             break;
 #else
             return -PVFS_ENOSYS;
+#endif
+        case PINT_EVENT_TRACE_NATIVE:
+#ifndef WIN32
+            ret = PINT_event_native_init();
+            if(ret < 0)
+            {
+                return ret;
+            }
+            break;
+#else
+            return -PVFS_ENOSYS;
 #endif
     }
+    event_method = method;
 
     return(0);
 }
@@ -211,9 +307,19 @@ void PINT_event_free_bucket_resources(struct qhash_table *qht, unsigned long dis
 
 void PINT_event_finalize(void)
 {
+    PINT_event_enabled_mask = 0;
 #if defined(HAVE_TAU)
     PINT_event_tau_fini();
 #endif
+#ifndef WIN32
+    if(event_method == PINT_EVENT_TRACE_NATIVE)
+    {
+        PINT_event_native_fini();
+    }
+#endif
+    event_method = PINT_EVENT_TRACE_TAU;
+    event_count = 0;
+    memset(event_by_index, 0, sizeof(event_by_index));
 
     /*free the buckets in the tables and the tables themselves*/
     /* need to free contents as well */
@@ -292,7 +398,7 @@ int PINT_event_enable(const char *events)
 
         if(!strcmp(events, "all"))
         {
-            PINT_event_enabled_mask = 0xFFFFFFFF;
+            PINT_event_enabled_mask = ~((uint64_t)0);
             goto done;
         }
 
@@ -323,6 +429,17 @@ int PINT_event_disable(const char *events)
     int count, i;
     int ret = 0;
 
+    if(!groups_table)
+    {
+        return 0;
+    }
+
+    if(!strcmp(events, "none") || !strcmp(events, "all"))
+    {
+        PINT_event_enabled_mask = 0;
+        return 0;
+    }
+
     count = PINT_split_string_list(&event_strings, events);
 
     for(i = 0; i < count; ++i)
@@ -351,11 +468,6 @@ int PINT_event_disable(const char *events)
         }
     }
 
-    if(!strcmp(events, "none"))
-    {
-        PINT_event_enabled_mask = 0;
-    }
-
 done:
     for(i = 0; i < count; ++i)
     {
@@ -414,6 +526,12 @@ int PINT_event_define_event(PINT_event_group *group,
         return 0;
     }
 
+    if(event_count >= PINT_EVENT_MAX_EVENTS)
+    {
+        gossip_err("Error: too many events defined, ignoring %s\n", name);
+        return -PVFS_ENOSPC;
+    }
+
     if(!group)
     {
         /* use default group */
@@ -442,8 +560,13 @@ int PINT_event_define_event(PINT_event_group *group,
     Ttf_event_define(name, format_start, format_end, (int *)&event->type);
 #endif
 
+    parse_event_format(format_start, event->start_args);
+    parse_event_format(format_end, event->end_args);
+
     event->group = ag;
-    event->mask = (1 << event_count);
+    event->index = event_count;
+    event->mask = ((uint64_t)1 << event_count);
+    event_by_index[event_count] = event;
     ++event_count;
 
     g = id_gen_fast_lookup(ag);
@@ -467,12 +590,24 @@ int PINT_event_start_event(
         return 0;
     }
 
-event = id_gen_fast_lookup(type);
+    event = id_gen_fast_lookup(type);
     if(event && (event->mask & PINT_event_enabled_mask))
     {
         va_start(ap, id);
 #ifdef HAVE_TAU
-        Ttf_EnterState_info_va(event->type, process_id, thread_id, (int *)id, ap);
+        if(event_method == PINT_EVENT_TRACE_TAU)
+        {
+            Ttf_EnterState_info_va(event->type, process_id, thread_id,
+                                   (int *)id, ap);
+        }
+#endif
+#ifndef WIN32
+        if(event_method == PINT_EVENT_TRACE_NATIVE)
+        {
+            *id = PINT_event_native_next_id();
+            PINT_event_native_record(event, PVFS_EVENT_FLAG_START, *id,
+                                     event->start_args, ap);
+        }
 #endif
         va_end(ap);
     }
@@ -496,13 +631,76 @@ int PINT_event_end_event(
     {
         va_start(ap, id);
 #ifdef HAVE_TAU
-        Ttf_LeaveState_info_va(event->type, process_id, thread_id, id, ap);
+        if(event_method == PINT_EVENT_TRACE_TAU)
+        {
+            Ttf_LeaveState_info_va(event->type, process_id, thread_id, id, ap);
+        }
+#endif
+#ifndef WIN32
+        if(event_method == PINT_EVENT_TRACE_NATIVE)
+        {
+            PINT_event_native_record(event, PVFS_EVENT_FLAG_END, id,
+                                     event->end_args, ap);
+        }
 #endif
         va_end(ap);
     }
     return 0;
 }
 
+int PINT_event_log_event(
+    PINT_event_type type, int process_id, int *thread_id, ...)
+{
+    va_list ap;
+    struct PINT_event *event;
+
+    if(!groups_table)
+    {
+        /* assume that the events interface just hasn't been initialized */
+        return 0;
+    }
+
+    event = id_gen_fast_lookup(type);
+    if(event && (event->mask & PINT_event_enabled_mask))
+    {
+        va_start(ap, thread_id);
+#ifndef WIN32
+        if(event_method == PINT_EVENT_TRACE_NATIVE)
+        {
+            PINT_event_native_record(event, PVFS_EVENT_FLAG_NONE, 0,
+                                     event->start_args, ap);
+        }
+#endif
+        va_end(ap);
+    }
+    return 0;
+}
+
+int PINT_event_setinfo(enum PINT_event_info info, void *value)
+{
+    switch(info)
+    {
+        case PINT_EVENT_INFO_BUFFER_SIZE:
+            /* takes effect for buffers allocated afterwards */
+            PINT_event_default_buffer_size = *(int *)value;
+            return 0;
+        default:
+            return -PVFS_ENOSYS;
+    }
+}
+
+int PINT_event_getinfo(enum PINT_event_info info, void *value)
+{
+    switch(info)
+    {
+        case PINT_EVENT_INFO_BUFFER_SIZE:
+            *(int *)value = PINT_event_default_buffer_size;
+            return 0;
+        default:
+            return -PVFS_ENOSYS;
+    }
+}
+
 /******************************************************************************/
 #if defined(HAVE_TAU)
 
@@ -543,6 +741,423 @@ static void PINT_event_tau_thread_fini() {
 #endif /* HAVE_TAU */
 /******************************************************************************/
 
+/******************************************************************************/
+#ifndef WIN32
+
+/*
+ * Native backend.  Every thread that records an event gets its own ring
+ * of fixed size records, so recording takes no locks: the owning thread
+ * is the only writer, and it publishes each record by advancing head.
+ * PINT_event_export() drains the rings from another thread; claim is
+ * advanced (and fenced) before a slot is overwritten so the exporter
+ * can discard anything the writer lapped while it was copying.  Rings
+ * keep the newest records when the exporter falls behind.
+ */
+struct PINT_event_record
+{
+    uint64_t timestamp;   /* ticks, see PINT_event_ticks() */
+    PINT_event_id id;     /* matches a start to its end */
+    uint64_t args[PINT_EVENT_MAX_ARGS];
+    uint32_t event;       /* index of the event definition */
+    uint16_t thread;
+    uint8_t kind;         /* PVFS_EVENT_FLAG_START, _END or _NONE */
+    uint8_t pad;
+};
+
+struct PINT_event_ring
+{
+    uint64_t head;         /* records published */
+    uint64_t claim;        /* records the owner has started writing */
+    uint64_t next_id;
+    uint64_t read_cursor;  /* next record to export */
+    uint64_t mask;
+    uint32_t thread;
+    struct PINT_event_record *records;
+    struct PINT_event_ring *next;
+};
+
+static __thread struct PINT_event_ring *native_ring = NULL;
+static __thread uint32_t native_ring_generation = 0;
+
+/* bumped by init so threads drop rings left over from an earlier init */
+static uint32_t native_generation = 0;
+static struct PINT_event_ring *native_rings = NULL;
+static uint32_t native_thread_count = 0;
+static gen_mutex_t native_mutex = GEN_MUTEX_INITIALIZER;
+
+/* pairs of tick and wall clock readings used to convert timestamps */
+static uint64_t native_base_ticks;
+static int64_t native_base_ns;
+
+/* PINT_event_ticks()
+ *
+ * cheap timestamp for records: the TSC on x86, which is assumed to be
+ * invariant and synchronized across cores, else the monotonic clock
+ */
+static inline uint64_t PINT_event_ticks(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t lo, hi;
+
+    __asm__ __volatile__("rdtsc" : "=a" (lo), "=d" (hi));
+    return (((uint64_t)hi << 32) | lo);
+#else
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+#endif
+}
+
+static int64_t PINT_event_wall_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((int64_t)ts.tv_sec * 1000000000LL + ts.tv_nsec);
+}
+
+static int PINT_event_native_init(void)
+{
+    gen_mutex_lock(&native_mutex);
+    native_generation++;
+    native_base_ticks = PINT_event_ticks();
+    native_base_ns = PINT_event_wall_ns();
+    gen_mutex_unlock(&native_mutex);
+    return 0;
+}
+
+static void PINT_event_native_fini(void)
+{
+    struct PINT_event_ring *ring;
+
+    gen_mutex_lock(&native_mutex);
+    native_generation++;
+    while(native_rings)
+    {
+        ring = native_rings;
+        native_rings = ring->next;
+        free(ring->records);
+        free(ring);
+    }
+    native_thread_count = 0;
+    gen_mutex_unlock(&native_mutex);
+}
+
+static struct PINT_event_ring *PINT_event_native_ring(void)
+{
+    struct PINT_event_ring *ring;
+    uint64_t size = 1;
+
+    if(native_ring && native_ring_generation == native_generation)
+    {
+        return native_ring;
+    }
+    native_ring = NULL;
+
+    /* largest power of two number of records that fits the buffer */
+    while(size * 2 * sizeof(struct PINT_event_record) <=
+          (uint64_t)PINT_event_default_buffer_size)
+    {
+        size *= 2;
+    }
+
+    ring = calloc(1, sizeof(*ring));
+    if(!ring)
+    {
+        return NULL;
+    }
+    ring->records = calloc(size, sizeof(struct PINT_event_record));
+    if(!ring->records)
+    {
+        free(ring);
+        return NULL;
+    }
+    ring->mask = size - 1;
+
+    gen_mutex_lock(&native_mutex);
+    ring->thread = native_thread_count++;
+    ring->next = native_rings;
+    native_rings = ring;
+    native_ring_generation = native_generation;
+    gen_mutex_unlock(&native_mutex);
+
+    native_ring = ring;
+    return ring;
+}
+
+static PINT_event_id PINT_event_native_next_id(void)
+{
+    struct PINT_event_ring *ring = PINT_event_native_ring();
+
+    if(!ring)
+    {
+        return 0;
+    }
+    /* unique without coordination: the thread in the top bits */
+    return (((PINT_event_id)(ring->thread + 1) << 48) | ++ring->next_id);
+}
+
+static void PINT_event_native_record(struct PINT_event *event,
+                                     int kind,
+                                     PINT_event_id id,
+                                     const char *arg_types,
+                                     va_list ap)
+{
+    struct PINT_event_ring *ring = PINT_event_native_ring();
+    struct PINT_event_record *rec;
+    uint64_t head;
+    double d;
+    int i;
+
+    if(!ring)
+    {
+        return;
+    }
+
+    head = ring->head;
+    __atomic_store_n(&ring->claim, head + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    rec = &ring->records[head & ring->mask];
+    rec->timestamp = PINT_event_ticks();
+    rec->id = id;
+    rec->event = event->index;
+    rec->thread = ring->thread;
+    rec->kind = kind;
+    for(i = 0; arg_types[i]; i++)
+    {
+        switch(arg_types[i])
+        {
+            case 'l':
+                rec->args[i] = (uint64_t)va_arg(ap, long);
+                break;
+            case 'L':
+                rec->args[i] = (uint64_t)va_arg(ap, long long);
+                break;
+            case 'p':
+            case 's':
+                rec->args[i] = (uint64_t)(uintptr_t)va_arg(ap, void *);
+                break;
+            case 'f':
+                d = va_arg(ap, double);
+                memcpy(&rec->args[i], &d, sizeof(d));
+                break;
+            default:
+                rec->args[i] = (uint64_t)(int64_t)va_arg(ap, int);
+                break;
+        }
+    }
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* labels interned into the name table during one export */
+struct PINT_event_label
+{
+    uint64_t key[2];
+    int index;
+};
+#define PINT_EVENT_MAX_LABELS 256
+
+static int append_name(char *names, int names_size, int *used,
+                       const char *a, const char *b)
+{
+    int len = strlen(a) + (b ? strlen(b) + 1 : 0) + 1;
+
+    if(*used + len + 1 > names_size)
+    {
+        return -1;
+    }
+    if(b)
+    {
+        sprintf(names + *used, "%s:%s\n", a, b);
+    }
+    else
+    {
+        sprintf(names + *used, "%s\n", a);
+    }
+    *used += len;
+    return 0;
+}
+
+/* PINT_event_export()
+ *
+ * moves up to array_count recorded events, oldest first per thread, into
+ * event_array.  names receives a newline separated table: the name of
+ * every defined event, indexed by the event field, followed by the
+ * labels referenced by the label field.  Labels are built from an
+ * event's string arguments, which are read here and so must point to
+ * static storage such as state machine and state names.
+ *
+ * returns the number of events exported
+ */
+int PINT_event_export(struct PVFS_mgmt_event *event_array,
+                      int array_count,
+                      char *names,
+                      int names_size)
+{
+    static gen_mutex_t export_mutex = GEN_MUTEX_INITIALIZER;
+    static struct PINT_event_label labels[PINT_EVENT_MAX_LABELS];
+    struct PINT_event_ring *ring;
+    struct PINT_event_record *rec;
+    struct PINT_event *event;
+    struct PVFS_mgmt_event *out;
+    const char *arg_types;
+    const char *strs[2];
+    uint64_t head, claim, first, valid, i;
+    uint64_t now_ticks;
+    int64_t now_ns;
+    double ns_per_tick = 1.0;
+    int count = 0, batch_start, name_count = 0, label_count = 0;
+    int used = 0, nstrs, j, k;
+
+    if(names_size > 0)
+    {
+        names[0] = '\0';
+    }
+    if(event_method != PINT_EVENT_TRACE_NATIVE)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&export_mutex);
+
+    for(j = 0; j < (int)event_count; j++)
+    {
+        append_name(names, names_size, &used, event_by_index[j]->name, NULL);
+        name_count++;
+    }
+
+    now_ticks = PINT_event_ticks();
+    now_ns = PINT_event_wall_ns();
+    if(now_ticks > native_base_ticks)
+    {
+        ns_per_tick = (double)(now_ns - native_base_ns) /
+                      (double)(now_ticks - native_base_ticks);
+    }
+
+    gen_mutex_lock(&native_mutex);
+    ring = native_rings;
+    gen_mutex_unlock(&native_mutex);
+
+    /* rings are only ever pushed on the front, so walking is safe */
+    for(; ring && count < array_count; ring = ring->next)
+    {
+        head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        first = ring->read_cursor;
+        if(head > ring->mask + 1 && first < head - (ring->mask + 1))
+        {
+            first = head - (ring->mask + 1);
+        }
+
+        batch_start = count;
+        for(i = first; i < head && count < array_count; i++)
+        {
+            rec = &ring->records[i & ring->mask];
+            out = &event_array[count++];
+            event = (rec->event < event_count ?
+                     event_by_index[rec->event] : NULL);
+
+            out->event = rec->event;
+            out->thread = rec->thread;
+            out->id = rec->id;
+            out->flags = rec->kind;
+            out->timestamp = native_base_ns + (int64_t)
+                ((double)(int64_t)(rec->timestamp - native_base_ticks) *
+                 ns_per_tick);
+            out->value = 0;
+            out->label = -1;
+            if(!event)
+            {
+                continue;
+            }
+
+            arg_types = (rec->kind == PVFS_EVENT_FLAG_END ?
+                         event->end_args : event->start_args);
+            nstrs = 0;
+            for(j = 0, k = 0; arg_types[j]; j++)
+            {
+                if(arg_types[j] == 's')
+                {
+                    if(nstrs < 2)
+                    {
+                        strs[nstrs++] = (const char *)(uintptr_t)rec->args[j];
+                    }
+                }
+                else if(!k++)
+                {
+                    out->value = (int64_t)rec->args[j];
+                }
+            }
+            if(!nstrs || !strs[0])
+            {
+                continue;
+            }
+            if(nstrs < 2)
+            {
+                strs[1] = NULL;
+            }
+
+            for(j = 0; j < label_count; j++)
+            {
+                if(labels[j].key[0] == (uint64_t)(uintptr_t)strs[0] &&
+                   labels[j].key[1] == (uint64_t)(uintptr_t)strs[1])
+                {
+                    break;
+                }
+            }
+            if(j == label_count)
+            {
+                if(label_count == PINT_EVENT_MAX_LABELS ||
+                   append_name(names, names_size, &used, strs[0], strs[1]))
+                {
+                    continue;
+                }
+                labels[j].key[0] = (uint64_t)(uintptr_t)strs[0];
+                labels[j].key[1] = (uint64_t)(uintptr_t)strs[1];
+                labels[j].index = name_count++;
+                label_count++;
+            }
+            out->label = labels[j].index;
+        }
+        ring->read_cursor = i;
+
+        /* drop whatever the writer lapped while we were copying */
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        claim = __atomic_load_n(&ring->claim, __ATOMIC_RELAXED);
+        valid = (claim > ring->mask + 1 ? claim - (ring->mask + 1) : 0);
+        if(first < valid)
+        {
+            k = (int)((valid - first < (uint64_t)(count - batch_start)) ?
+                      valid - first : (uint64_t)(count - batch_start));
+            memmove(&event_array[batch_start], &event_array[batch_start + k],
+                    (count - batch_start - k) * sizeof(*event_array));
+            count -= k;
+        }
+    }
+
+    gen_mutex_unlock(&export_mutex);
+    return count;
+}
+
+#else /* WIN32 */
+
+int PINT_event_export(struct PVFS_mgmt_event *event_array,
+                      int event_count,
+                      char *names,
+                      int names_size)
+{
+    if(names_size > 0)
+    {
+        names[0] = '\0';
+    }
+    return 0;
+}
+
+#endif /* WIN32 */
+/******************************************************************************/
+
 
 /*
  * Local variables:
@@ -19,7 +19,8 @@ extern uint64_t PINT_event_enabled_mask;
 
 enum PINT_event_method
 {
-    PINT_EVENT_TRACE_TAU
+    PINT_EVENT_TRACE_TAU,
+    PINT_EVENT_TRACE_NATIVE  /* per-thread ring buffers, see PINT_event_export */
 };
 
 enum PINT_event_info
@@ -69,29 +70,58 @@ int PINT_event_log_event(PINT_event_type type,
                          int *thread_id,
                          ...);
 
+struct PVFS_mgmt_event;
+int PINT_event_export(struct PVFS_mgmt_event *event_array,
+                      int event_count,
+                      char *names,
+                      int names_size);
+
 #ifdef __PVFS2_ENABLE_EVENT__
 
+/*
+ * trace points test the runtime mask inline, so a disabled event costs a
+ * load and a branch.  A start skipped while disabled leaves its event id
+ * untouched, so the matching end may be recorded without a start.
+ */
 #ifdef WIN32
 
 #define PINT_EVENT_START(ET, PID, TID, EID, ...)  \
-   PINT_event_start_event(ET, PID, TID, EID, __VA_ARGS__)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_start_event(ET, PID, TID, EID, __VA_ARGS__); \
+} while (0)
 
 #define PINT_EVENT_END(ET, PID, TID, EID, ...) \
-   PINT_event_end_event(ET, PID, TID, EID, __VA_ARGS__)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_end_event(ET, PID, TID, EID, __VA_ARGS__); \
+} while (0)
 
 #define PINT_EVENT_LOG(ET, PID, TID, ...) \
-   PINT_event_log_event(ET, PID, TID, __VA_ARGS__)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_log_event(ET, PID, TID, __VA_ARGS__); \
+} while (0)
 
 #else 
 
 #define PINT_EVENT_START(ET, PID, TID, EID, args...)  \
-   PINT_event_start_event(ET, PID, TID, EID, ## args)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_start_event(ET, PID, TID, EID, ## args); \
+} while (0)
 
 #define PINT_EVENT_END(ET, PID, TID, EID, args...) \
-   PINT_event_end_event(ET, PID, TID, EID, ## args)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_end_event(ET, PID, TID, EID, ## args); \
+} while (0)
 
 #define PINT_EVENT_LOG(ET, PID, TID, args...) \
-   PINT_event_log_event(ET, PID, TID, ## args)
+do { \
+    if (PINT_event_enabled_mask) \
+        PINT_event_log_event(ET, PID, TID, ## args); \
+} while (0)
 
 #endif /* WIN32 */
 
@@ -57,6 +57,10 @@ static int _clock_gettime(struct timespec *tp)
 #endif
 
 static struct timespec timediff(struct timespec start, struct timespec end);
+static void perf_hist_record(struct PINT_perf_counter *pc,
+                             int key,
+                             int64_t value);
+static void perf_hist_merge(struct PINT_perf_counter *pc);
 
 #define PINT_PERF_REALLOC_ARRAY(__pc, __tmp_ptr, __src_ptr, __new_history, __type) \
 {                                                                      \
@@ -100,6 +104,12 @@ struct PINT_perf_key server_keys[] =
     {"io requests called", PINT_PERF_IO, PINT_PERF_PRESERVE},
     {"small_io requests called", PINT_PERF_SMALL_IO, PINT_PERF_PRESERVE},
     {"readdir requests called", PINT_PERF_READDIR, PINT_PERF_PRESERVE},
+    {"fair-share requests waiting", PINT_PERF_FAIR_WAITING, PINT_PERF_PRESERVE},
+    {"fair-share classes waiting", PINT_PERF_FAIR_CLASSES, PINT_PERF_PRESERVE},
+    {"fair-share deepest queue", PINT_PERF_FAIR_DEPTH, PINT_PERF_PRESERVE},
+    {"state machine allocations", PINT_PERF_SM_ALLOCS, PINT_PERF_PRESERVE},
+    {"state machine allocation misses", PINT_PERF_SM_ALLOC_MISSES,
+        PINT_PERF_PRESERVE},
     {NULL, 0, 0},
 };
 
@@ -120,9 +130,113 @@ struct PINT_perf_key server_tkeys[] =
     {"io timer", PINT_PERF_TIO, PINT_PERF_PRESERVE},
     {"small_io timer", PINT_PERF_TSMALL_IO, PINT_PERF_PRESERVE},
     {"readdir timer", PINT_PERF_TREADDIR, PINT_PERF_PRESERVE},
+    {"bmi job timer", PINT_PERF_TBMI, PINT_PERF_PRESERVE},
+    {"trove job timer", PINT_PERF_TTROVE, PINT_PERF_PRESERVE},
+    {"flow job timer", PINT_PERF_TFLOW, PINT_PERF_PRESERVE},
     {NULL, 0, 0},
 };
 
+/**
+ * timer histograms are recorded by each thread into its own block
+ * without taking pc->mutex.  The owning thread only ever adds to a
+ * block; perf_hist_merge() drains it with atomic exchanges under
+ * pc->mutex, so a sample racing with a merge simply lands in the next
+ * interval.
+ */
+struct PINT_perf_hist_key
+{
+    int64_t sum;
+    int64_t count;
+    int64_t min;
+    int64_t max;
+    int64_t bucket[PINT_PERF_HIST_BUCKETS];
+};
+
+struct PINT_perf_hist_block
+{
+    struct PINT_perf_hist_block *next;
+    struct PINT_perf_hist_key key[1]; /* really [pc->key_count] */
+};
+
+/* each thread caches its block for a few timer counters; pcs are
+ * matched by id rather than address so a finalized counter never
+ * matches a stale entry.  A slot whose id is no longer in hist_live
+ * belongs to a finalized counter (which freed the block) and is
+ * reclaimed the next time the thread needs a free slot.
+ */
+#define PINT_PERF_HIST_TLS_SLOTS 4
+#define PINT_PERF_HIST_LIVE_MAX 64
+
+static __thread struct
+{
+    uint32_t id;
+    struct PINT_perf_hist_block *block;
+} hist_tls[PINT_PERF_HIST_TLS_SLOTS];
+static __thread uint32_t hist_tls_generation;
+
+static uint32_t hist_next_id = 0;
+static uint32_t hist_live[PINT_PERF_HIST_LIVE_MAX];
+static uint32_t hist_generation = 0; /* bumped when a counter is dropped */
+static gen_mutex_t hist_live_mutex = GEN_MUTEX_INITIALIZER;
+
+/**
+ * gives a timer counter an id and records it as live
+ * \returns 0 if the table is full; the counter then records samples
+ * under pc->mutex only
+ */
+static uint32_t perf_hist_register(void)
+{
+    uint32_t id = 0;
+    int i;
+
+    gen_mutex_lock(&hist_live_mutex);
+    for (i = 0; i < PINT_PERF_HIST_LIVE_MAX; i++)
+    {
+        if (hist_live[i] == 0)
+        {
+            /* skip 0 when the counter wraps, it marks a free entry */
+            do
+            {
+                id = ++hist_next_id;
+            } while (id == 0);
+            hist_live[i] = id;
+            break;
+        }
+    }
+    gen_mutex_unlock(&hist_live_mutex);
+    return id;
+}
+
+/**
+ * drops id from the live table and the calling thread's slots; other
+ * threads reclaim their slots for it in perf_hist_block()
+ */
+static void perf_hist_unregister(uint32_t id)
+{
+    int i;
+
+    gen_mutex_lock(&hist_live_mutex);
+    for (i = 0; i < PINT_PERF_HIST_LIVE_MAX; i++)
+    {
+        if (hist_live[i] == id)
+        {
+            hist_live[i] = 0;
+            break;
+        }
+    }
+    __atomic_add_fetch(&hist_generation, 1, __ATOMIC_RELEASE);
+    gen_mutex_unlock(&hist_live_mutex);
+
+    for (i = 0; i < PINT_PERF_HIST_TLS_SLOTS; i++)
+    {
+        if (hist_tls[i].id == id)
+        {
+            hist_tls[i].id = 0;
+            hist_tls[i].block = NULL;
+        }
+    }
+}
+
 /**
  * this utility removes all of the samples from a perf counter
  * this is mostly for cleanup in case of a memory alloc error
@@ -130,10 +244,26 @@ struct PINT_perf_key server_tkeys[] =
 void PINT_free_pc (struct PINT_perf_counter *pc)
 {
     struct PINT_perf_sample *tmp, *tmp2;
+    struct PINT_perf_hist_block *b, *b2;
     if (!pc)
     {
         return;
     }
+    if (pc->hist_id)
+    {
+        perf_hist_unregister(pc->hist_id);
+    }
+    b = pc->hist_blocks;
+    while(b)
+    {
+        b2 = b;
+        b = b->next;
+        free(b2);
+    }
+    if (pc->hist)
+    {
+        free(pc->hist);
+    }
     tmp = pc->sample;
     while(tmp)
     {
@@ -201,6 +331,15 @@ struct PINT_perf_counter *PINT_perf_initialize(
     if (cnt_type == PINT_PERF_TIMER)
     {
         pc->perf_counter_size = sizeof(struct PINT_perf_timer);
+        pc->hist = (int64_t *)calloc(pc->key_count * PINT_PERF_HIST_BUCKETS,
+                                     sizeof(int64_t));
+        if (!pc->hist)
+        {
+            gen_mutex_destroy(&pc->mutex);
+            free(pc);
+            return(NULL);
+        }
+        pc->hist_id = perf_hist_register();
     }
     else
     {
@@ -282,7 +421,7 @@ void PINT_perf_reset(struct PINT_perf_counter* pc)
         /* zero out all fields */
         memset(&s->start_time_ms, 0, sizeof(uint64_t));
         memset(&s->interval_ms, 0, sizeof(uint64_t));
-        memset(&s->value.v, 0, pc->key_count * pc->perf_counter_size);
+        memset(s->value.v, 0, pc->key_count * pc->perf_counter_size);
         /* on a reset should we not zero them all ??? */
 #if 0
         for(i = 0; i < pc->key_count; i++)
@@ -301,6 +440,14 @@ void PINT_perf_reset(struct PINT_perf_counter* pc)
         }
 #endif
     }
+    if (pc->hist)
+    {
+        /* drain the per-thread blocks so old samples are not merged later */
+        perf_hist_merge(pc);
+        memset(pc->sample->value.v, 0, pc->key_count * pc->perf_counter_size);
+        memset(pc->hist, 0,
+               pc->key_count * PINT_PERF_HIST_BUCKETS * sizeof(int64_t));
+    }
 
     /* set initial timestamp */
     pc->sample->start_time_ms = PINT_util_get_time_ms();
@@ -328,7 +475,6 @@ void __PINT_perf_count( struct PINT_perf_counter* pc,
                         int64_t value,
                         enum PINT_perf_ops op)
 {
-    struct PINT_perf_timer *pt;
 #if 0
     int64_t tmp; /* this is for debugging purposes */
 #endif
@@ -339,6 +485,29 @@ void __PINT_perf_count( struct PINT_perf_counter* pc,
         return;
     }
 
+    if (op == PINT_PERF_END)
+    {
+        /* timers do not take the mutex, see perf_hist_record() */
+        if (pc->cnt_type != PINT_PERF_TIMER)
+        {
+            gossip_err("Error: PINT_perf_count(): invalid op for non-timer.\n");
+        }
+        else if(key < 0 || key >= pc->key_count)
+        {
+            gossip_err("Error: PINT_perf_count(): invalid key.\n");
+        }
+        else if (value < 0)
+        {
+            /* rollover - throw away this sample */
+            gossip_err("Error: PINT_perf_count(): sample rolled over.\n");
+        }
+        else
+        {
+            perf_hist_record(pc, key, value);
+        }
+        return;
+    }
+
     gen_mutex_lock(&pc->mutex);
 
 #if 0
@@ -381,32 +550,6 @@ void __PINT_perf_count( struct PINT_perf_counter* pc,
         case PINT_PERF_START: /* This is probably going away */
             break;
 
-        case PINT_PERF_END:
-            if (pc->cnt_type != PINT_PERF_TIMER)
-            {
-                gossip_err("Error: PINT_perf_count(): invalid op for non-timer.\n");
-                goto errorout;
-            }
-            pt = &pc->sample->value.t[key];
-            if (value < 0)
-            {
-                /* rollover - throw away this sample */
-                gossip_err("Error: PINT_perf_count(): sample rolled over.\n");
-            }
-            else
-            {
-                pt->sum += value;
-                pt->count++;
-                if (value > pt->max)
-                {
-                    pt->max = value;
-                }
-                if (pt->min == 0 || value < pt->min)
-                {
-                    pt->min = value;
-                }
-            }
-            break;
         default:
             gossip_err("Error: PINT_perf_count(): invalid op.\n");
             break;
@@ -445,6 +588,261 @@ static struct timespec timediff(struct timespec start, struct timespec end)
     return diff;
 }
 
+/**
+ * maps a time in ns to its log-linear histogram bucket
+ */
+static inline int perf_hist_bucket(int64_t value)
+{
+    int msb;
+
+    if (value < PINT_PERF_HIST_SUB)
+    {
+        return (int)value;
+    }
+    msb = 63 - __builtin_clzll((uint64_t)value);
+    if (msb > PINT_PERF_HIST_MAX_BITS)
+    {
+        return PINT_PERF_HIST_BUCKETS - 1;
+    }
+    return ((msb - PINT_PERF_HIST_SUB_BITS + 1) * PINT_PERF_HIST_SUB) +
+           (int)((value >> (msb - PINT_PERF_HIST_SUB_BITS)) &
+                 (PINT_PERF_HIST_SUB - 1));
+}
+
+/**
+ * returns the value reported for a bucket: the middle of its range
+ */
+static int64_t perf_hist_value(int bucket)
+{
+    int shift;
+
+    if (bucket < PINT_PERF_HIST_SUB)
+    {
+        return bucket;
+    }
+    shift = (bucket / PINT_PERF_HIST_SUB) - 1;
+    return ((int64_t)(PINT_PERF_HIST_SUB + (bucket % PINT_PERF_HIST_SUB))
+                << shift) + (((int64_t)1 << shift) >> 1);
+}
+
+/**
+ * finds (or creates) the calling thread's histogram block for pc
+ * \returns NULL if the thread has no free slot or memory is short
+ */
+static struct PINT_perf_hist_block *perf_hist_block(
+                                        struct PINT_perf_counter *pc)
+{
+    struct PINT_perf_hist_block *b;
+    uint32_t generation;
+    int i, j;
+
+    if (pc->hist_id == 0)
+    {
+        return NULL;
+    }
+    for (i = 0; i < PINT_PERF_HIST_TLS_SLOTS; i++)
+    {
+        if (hist_tls[i].id == pc->hist_id)
+        {
+            return hist_tls[i].block;
+        }
+    }
+
+    /* release slots of counters finalized by other threads since this
+     * thread last looked; their blocks were freed along with the counter
+     */
+    generation = __atomic_load_n(&hist_generation, __ATOMIC_ACQUIRE);
+    if (generation != hist_tls_generation)
+    {
+        gen_mutex_lock(&hist_live_mutex);
+        hist_tls_generation = hist_generation;
+        for (i = 0; i < PINT_PERF_HIST_TLS_SLOTS; i++)
+        {
+            if (hist_tls[i].block == NULL)
+            {
+                continue;
+            }
+            for (j = 0; j < PINT_PERF_HIST_LIVE_MAX; j++)
+            {
+                if (hist_live[j] == hist_tls[i].id)
+                {
+                    break;
+                }
+            }
+            if (j == PINT_PERF_HIST_LIVE_MAX)
+            {
+                hist_tls[i].id = 0;
+                hist_tls[i].block = NULL;
+            }
+        }
+        gen_mutex_unlock(&hist_live_mutex);
+    }
+
+    for (i = 0; i < PINT_PERF_HIST_TLS_SLOTS; i++)
+    {
+        if (hist_tls[i].block == NULL)
+        {
+            break;
+        }
+    }
+    if (i == PINT_PERF_HIST_TLS_SLOTS)
+    {
+        return NULL;
+    }
+
+    b = (struct PINT_perf_hist_block *)calloc(1,
+                sizeof(struct PINT_perf_hist_block) +
+                ((pc->key_count - 1) * sizeof(struct PINT_perf_hist_key)));
+    if (!b)
+    {
+        return NULL;
+    }
+    gen_mutex_lock(&pc->mutex);
+    b->next = pc->hist_blocks;
+    pc->hist_blocks = b;
+    gen_mutex_unlock(&pc->mutex);
+
+    hist_tls[i].id = pc->hist_id;
+    hist_tls[i].block = b;
+    return b;
+}
+
+/**
+ * records one timer sample without taking pc->mutex
+ */
+static void perf_hist_record(struct PINT_perf_counter *pc,
+                             int key,
+                             int64_t value)
+{
+    struct PINT_perf_hist_block *b;
+    struct PINT_perf_hist_key *hk;
+    struct PINT_perf_timer *pt;
+    int64_t old;
+
+    b = perf_hist_block(pc);
+    if (!b)
+    {
+        /* no per-thread block available, fall back to the locked path */
+        gen_mutex_lock(&pc->mutex);
+        pt = &pc->sample->value.t[key];
+        pt->sum += value;
+        pt->count++;
+        if (value > pt->max)
+        {
+            pt->max = value;
+        }
+        if (pt->min == 0 || value < pt->min)
+        {
+            pt->min = value;
+        }
+        pc->hist[(key * PINT_PERF_HIST_BUCKETS) + perf_hist_bucket(value)]++;
+        gen_mutex_unlock(&pc->mutex);
+        return;
+    }
+
+    hk = &b->key[key];
+    __atomic_fetch_add(&hk->bucket[perf_hist_bucket(value)], 1,
+                       __ATOMIC_RELAXED);
+    __atomic_fetch_add(&hk->sum, value, __ATOMIC_RELAXED);
+    old = __atomic_load_n(&hk->max, __ATOMIC_RELAXED);
+    while (value > old &&
+           !__atomic_compare_exchange_n(&hk->max, &old, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    old = __atomic_load_n(&hk->min, __ATOMIC_RELAXED);
+    while ((old == 0 || value < old) &&
+           !__atomic_compare_exchange_n(&hk->min, &old, value, 1,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    __atomic_fetch_add(&hk->count, 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * folds all per-thread blocks into the current sample and the interval
+ * histogram, then recomputes the current sample's percentiles
+ * pc->mutex must be held
+ */
+static void perf_hist_merge(struct PINT_perf_counter *pc)
+{
+    static const int permille[3] = {500, 990, 999};
+    struct PINT_perf_hist_block *b;
+    struct PINT_perf_hist_key *hk;
+    struct PINT_perf_timer *pt;
+    int64_t *row, count, total, target, seen, val;
+    int64_t *pct[3];
+    int i, k, p;
+
+    for (b = pc->hist_blocks; b; b = b->next)
+    {
+        for (k = 0; k < pc->key_count; k++)
+        {
+            hk = &b->key[k];
+            count = __atomic_exchange_n(&hk->count, 0, __ATOMIC_ACQUIRE);
+            if (count == 0)
+            {
+                continue;
+            }
+            pt = &pc->sample->value.t[k];
+            pt->count += count;
+            pt->sum += __atomic_exchange_n(&hk->sum, 0, __ATOMIC_RELAXED);
+            val = __atomic_exchange_n(&hk->min, 0, __ATOMIC_RELAXED);
+            if (val != 0 && (pt->min == 0 || val < pt->min))
+            {
+                pt->min = val;
+            }
+            val = __atomic_exchange_n(&hk->max, 0, __ATOMIC_RELAXED);
+            if (val > pt->max)
+            {
+                pt->max = val;
+            }
+            row = &pc->hist[k * PINT_PERF_HIST_BUCKETS];
+            for (i = 0; i < PINT_PERF_HIST_BUCKETS; i++)
+            {
+                if (__atomic_load_n(&hk->bucket[i], __ATOMIC_RELAXED))
+                {
+                    row[i] += __atomic_exchange_n(&hk->bucket[i], 0,
+                                                  __ATOMIC_RELAXED);
+                }
+            }
+        }
+    }
+
+    for (k = 0; k < pc->key_count; k++)
+    {
+        pt = &pc->sample->value.t[k];
+        pct[0] = &pt->p50;
+        pct[1] = &pt->p99;
+        pct[2] = &pt->p999;
+        row = &pc->hist[k * PINT_PERF_HIST_BUCKETS];
+        for (total = 0, i = 0; i < PINT_PERF_HIST_BUCKETS; i++)
+        {
+            total += row[i];
+        }
+        for (p = 0; p < 3; p++)
+        {
+            *pct[p] = 0;
+        }
+        if (total == 0)
+        {
+            continue;
+        }
+        for (p = 0, seen = 0, i = 0; i < PINT_PERF_HIST_BUCKETS && p < 3; i++)
+        {
+            seen += row[i];
+            while (p < 3)
+            {
+                /* rank of the sample at this percentile, rounded up */
+                target = ((total * permille[p]) + 999) / 1000;
+                if (seen < target)
+                {
+                    break;
+                }
+                val = perf_hist_value(i);
+                *pct[p] = (pt->max && val > pt->max) ? pt->max : val;
+                p++;
+            }
+        }
+    }
+}
+
 /* This is used for debugging the function below */
 #if 0
 static void *st;
@@ -530,6 +928,10 @@ void PINT_perf_rollover( struct PINT_perf_counter* pc)
      *
      * associate the "current" values with the "current" sample.
      */
+    if (pc->hist)
+    {
+        perf_hist_merge(pc);
+    }
     pc->sample->interval_ms = int_time - pc->sample->start_time_ms;
     head = pc->sample;
     for(tail = head; tail && tail->next; tail = tail->next);
@@ -548,6 +950,19 @@ void PINT_perf_rollover( struct PINT_perf_counter* pc)
     pc->sample->start_time_ms = int_time;
     pc->sample->interval_ms = 0;
 
+    if (pc->hist)
+    {
+        /* percentiles always describe a single interval */
+        memset(pc->hist, 0,
+               pc->key_count * PINT_PERF_HIST_BUCKETS * sizeof(int64_t));
+        for(i = 0; i < pc->key_count; i++)
+        {
+            pc->sample->value.t[i].p50 = 0;
+            pc->sample->value.t[i].p99 = 0;
+            pc->sample->value.t[i].p999 = 0;
+        }
+    }
+
     for(i = 0; i < pc->key_count; i++)
     {
         if(!(pc->key_array[i].flag & PINT_PERF_PRESERVE))
@@ -790,6 +1205,12 @@ void PINT_perf_retrieve(
     /* this must always be true or caller is incorrect */
     assert (pc->history * pc_sample_size <= array_size);
 
+    if (pc->hist)
+    {
+        /* bring the current sample up to date with the thread blocks */
+        perf_hist_merge(pc);
+    }
+
     /* clear the needed space - could clear all the space, but we will
      * opt for the faster approach
      */
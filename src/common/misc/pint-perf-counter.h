@@ -25,6 +25,19 @@ enum PINT_perf_defaults
  */
 #define PINT_PERF_PRESERVE 1
 
+/** timers keep a log-linear latency histogram per key: values below
+ * PINT_PERF_HIST_SUB ns are exact, and each power of two above that is
+ * split into PINT_PERF_HIST_SUB equal buckets (about 6% relative error).
+ * Values of 2^PINT_PERF_HIST_MAX_BITS ns (about 18 minutes) or more all
+ * land in the last bucket.
+ */
+#define PINT_PERF_HIST_SUB_BITS 4
+#define PINT_PERF_HIST_SUB (1 << PINT_PERF_HIST_SUB_BITS)
+#define PINT_PERF_HIST_MAX_BITS 40
+#define PINT_PERF_HIST_BUCKETS \
+    ((PINT_PERF_HIST_MAX_BITS - PINT_PERF_HIST_SUB_BITS + 2) * \
+     PINT_PERF_HIST_SUB)
+
 /** enumeration of valid measurement operations */
 enum PINT_perf_ops
 {
@@ -65,6 +78,9 @@ struct PINT_perf_sample
                                    /**< history sameples */
 };
 
+/** per-thread histogram block, private to pint-perf-counter.c */
+struct PINT_perf_hist_block;
+
 /** struct representing a multi-sample set of perf counters */
 struct PINT_perf_counter
 {
@@ -80,6 +96,11 @@ struct PINT_perf_counter
     struct PINT_perf_sample *sample;     /**< list of samples for this counter */
     int (*start_rollover)(struct PINT_perf_counter *pc,
                           struct PINT_perf_counter *tpc);
+    /* timers only */
+    uint32_t hist_id;                    /**< matches per-thread blocks */
+    struct PINT_perf_hist_block *hist_blocks; /**< one per recording thread */
+    int64_t *hist;                       /**< [key][bucket] for current */
+                                         /**< interval, merged at rollover */
 };
 
 
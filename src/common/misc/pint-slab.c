@@ -0,0 +1,297 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Each cache hands out objects of one size.  A thread allocates from and
+ * frees to its own magazine for that cache without locking.  When the
+ * magazine runs dry it takes half a magazine from the cache's depot, and
+ * when it fills up it gives half back; only then is the cache's mutex
+ * taken.  Objects beyond PINT_SLAB_DEPOT_MAX go back to malloc, so a
+ * burst does not pin memory forever.  A thread's magazines are returned
+ * to the depots when it exits.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "pvfs2-internal.h"
+#include "gen-locks.h"
+#include "pint-slab.h"
+
+/* thread-local counts are folded into the totals this often */
+#define SLAB_FOLD_INTERVAL 1024
+
+struct PINT_slab_cache
+{
+    size_t size;
+    int index;
+    gen_mutex_t mutex;
+    void *depot;        /* free objects, linked through their first word */
+    int depot_count;
+};
+
+struct slab_magazine
+{
+    int count;
+    void *objs[PINT_SLAB_MAGAZINE_SIZE];
+};
+
+struct slab_thread
+{
+    struct slab_magazine mags[PINT_SLAB_MAX_CACHES];
+    uint64_t allocs;
+    uint64_t misses;
+};
+
+static struct PINT_slab_cache slab_caches[PINT_SLAB_MAX_CACHES];
+static volatile int slab_cache_count = 0;
+static gen_mutex_t slab_caches_mutex = GEN_MUTEX_INITIALIZER;
+
+/* totals, protected by slab_caches_mutex */
+static uint64_t slab_allocs = 0;
+static uint64_t slab_misses = 0;
+
+static __thread struct slab_thread *slab_self = NULL;
+static pthread_key_t slab_key;
+static pthread_once_t slab_key_once = PTHREAD_ONCE_INIT;
+
+static void slab_fold(struct slab_thread *t)
+{
+    gen_mutex_lock(&slab_caches_mutex);
+    slab_allocs += t->allocs;
+    slab_misses += t->misses;
+    gen_mutex_unlock(&slab_caches_mutex);
+    t->allocs = 0;
+    t->misses = 0;
+}
+
+/* moves up to count objects from the magazine to the cache's depot */
+static void slab_flush(struct PINT_slab_cache *cache,
+                       struct slab_magazine *mag,
+                       int count)
+{
+    void *obj;
+
+    gen_mutex_lock(&cache->mutex);
+    while (count-- > 0 && mag->count > 0)
+    {
+        obj = mag->objs[--mag->count];
+        if (cache->depot_count < PINT_SLAB_DEPOT_MAX)
+        {
+            *(void **)obj = cache->depot;
+            cache->depot = obj;
+            cache->depot_count++;
+        }
+        else
+        {
+            free(obj);
+        }
+    }
+    gen_mutex_unlock(&cache->mutex);
+}
+
+/* moves up to half a magazine of objects from the depot */
+static void slab_refill(struct PINT_slab_cache *cache,
+                        struct slab_magazine *mag)
+{
+    void *obj;
+
+    gen_mutex_lock(&cache->mutex);
+    while (cache->depot && mag->count < PINT_SLAB_MAGAZINE_SIZE / 2)
+    {
+        obj = cache->depot;
+        cache->depot = *(void **)obj;
+        cache->depot_count--;
+        mag->objs[mag->count++] = obj;
+    }
+    gen_mutex_unlock(&cache->mutex);
+}
+
+static void slab_thread_exit(void *arg)
+{
+    struct slab_thread *t = arg;
+    int i;
+
+    for (i = 0; i < slab_cache_count; i++)
+    {
+        slab_flush(&slab_caches[i], &t->mags[i], PINT_SLAB_MAGAZINE_SIZE);
+    }
+    slab_fold(t);
+    free(t);
+}
+
+static void slab_key_create(void)
+{
+    pthread_key_create(&slab_key, slab_thread_exit);
+}
+
+static struct slab_thread *slab_thread_get(void)
+{
+    struct slab_thread *t;
+
+    if (slab_self)
+    {
+        return slab_self;
+    }
+    t = calloc(1, sizeof(*t));
+    if (!t)
+    {
+        return NULL;
+    }
+    pthread_once(&slab_key_once, slab_key_create);
+    pthread_setspecific(slab_key, t);
+    slab_self = t;
+    return t;
+}
+
+/* PINT_slab_cache_get()
+ *
+ * returns the cache for objects of the given size, creating it if
+ * needed.  Returns NULL if every cache is in use, in which case
+ * PINT_slab_alloc() and PINT_slab_free() fall back to malloc and free.
+ */
+struct PINT_slab_cache *PINT_slab_cache_get(size_t size)
+{
+    struct PINT_slab_cache *cache = NULL;
+    int i, count;
+
+    /* objects link through their first word while in a depot */
+    size = (size + 15) & ~((size_t)15);
+
+    count = slab_cache_count;
+    for (i = 0; i < count; i++)
+    {
+        if (slab_caches[i].size == size)
+        {
+            return &slab_caches[i];
+        }
+    }
+
+    gen_mutex_lock(&slab_caches_mutex);
+    for (i = 0; i < slab_cache_count; i++)
+    {
+        if (slab_caches[i].size == size)
+        {
+            cache = &slab_caches[i];
+            break;
+        }
+    }
+    if (!cache && slab_cache_count < PINT_SLAB_MAX_CACHES)
+    {
+        cache = &slab_caches[slab_cache_count];
+        cache->size = size;
+        cache->index = slab_cache_count;
+        gen_mutex_init(&cache->mutex);
+        cache->depot = NULL;
+        cache->depot_count = 0;
+        /* publish the entry before the count that makes it visible */
+        __sync_synchronize();
+        slab_cache_count++;
+    }
+    gen_mutex_unlock(&slab_caches_mutex);
+    return cache;
+}
+
+/* PINT_slab_alloc()
+ *
+ * returns a zeroed object from the cache, or NULL if out of memory
+ */
+void *PINT_slab_alloc(struct PINT_slab_cache *cache)
+{
+    struct slab_thread *t;
+    struct slab_magazine *mag;
+    void *obj = NULL;
+
+    if (!cache || !(t = slab_thread_get()))
+    {
+        return cache ? calloc(1, cache->size) : NULL;
+    }
+
+    mag = &t->mags[cache->index];
+    if (mag->count == 0)
+    {
+        slab_refill(cache, mag);
+    }
+    if (mag->count > 0)
+    {
+        obj = mag->objs[--mag->count];
+    }
+    else
+    {
+        obj = malloc(cache->size);
+        t->misses++;
+    }
+    if (++t->allocs >= SLAB_FOLD_INTERVAL)
+    {
+        slab_fold(t);
+    }
+
+    if (obj)
+    {
+        memset(obj, 0, cache->size);
+    }
+    return obj;
+}
+
+void PINT_slab_free(struct PINT_slab_cache *cache, void *obj)
+{
+    struct slab_thread *t;
+    struct slab_magazine *mag;
+
+    if (!obj)
+    {
+        return;
+    }
+    if (!cache || !(t = slab_thread_get()))
+    {
+        free(obj);
+        return;
+    }
+
+    mag = &t->mags[cache->index];
+    if (mag->count == PINT_SLAB_MAGAZINE_SIZE)
+    {
+        slab_flush(cache, mag, PINT_SLAB_MAGAZINE_SIZE / 2);
+    }
+    mag->objs[mag->count++] = obj;
+}
+
+/* PINT_slab_get_stats()
+ *
+ * reports totals across all caches; counts still held by running
+ * threads are folded in every SLAB_FOLD_INTERVAL allocations
+ */
+void PINT_slab_get_stats(struct PINT_slab_stats *stats)
+{
+    int i;
+
+    if (slab_self)
+    {
+        slab_fold(slab_self);
+    }
+
+    gen_mutex_lock(&slab_caches_mutex);
+    stats->allocs = slab_allocs;
+    stats->misses = slab_misses;
+    gen_mutex_unlock(&slab_caches_mutex);
+
+    stats->cached = 0;
+    for (i = 0; i < slab_cache_count; i++)
+    {
+        gen_mutex_lock(&slab_caches[i].mutex);
+        stats->cached += slab_caches[i].depot_count;
+        gen_mutex_unlock(&slab_caches[i].mutex);
+    }
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
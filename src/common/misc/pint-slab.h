@@ -0,0 +1,56 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/** \file
+ *  Caches of fixed size objects for allocations that happen on every
+ *  operation, such as state machine control blocks and frames.  Freed
+ *  objects are kept in a small per-thread magazine and then in a shared
+ *  depot per size, so the common alloc/free pair never reaches malloc or
+ *  takes a lock.
+ */
+
+#ifndef __PINT_SLAB_H
+#define __PINT_SLAB_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/* objects held by each thread for each cache */
+#define PINT_SLAB_MAGAZINE_SIZE 32
+
+/* objects held in the shared depot of each cache; the rest are freed */
+#define PINT_SLAB_DEPOT_MAX 4096
+
+/* distinct object sizes that may be cached */
+#define PINT_SLAB_MAX_CACHES 16
+
+struct PINT_slab_cache;
+
+struct PINT_slab_stats
+{
+    uint64_t allocs;    /* objects handed out */
+    uint64_t misses;    /* of those, objects that had to be malloc'd */
+    uint64_t cached;    /* objects currently held in depots */
+};
+
+struct PINT_slab_cache *PINT_slab_cache_get(size_t size);
+
+void *PINT_slab_alloc(struct PINT_slab_cache *cache);
+
+void PINT_slab_free(struct PINT_slab_cache *cache, void *obj);
+
+void PINT_slab_get_stats(struct PINT_slab_stats *stats);
+
+#endif /* __PINT_SLAB_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,434 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* heavy hitter accounting
+ *
+ * Each (kind, metric) pair has a fixed table of PINT_TOP_CAPACITY
+ * counters maintained with the Space-Saving algorithm: a key already in
+ * the table is incremented, otherwise it replaces the smallest counter
+ * and inherits its count, which is remembered as the key's error bound.
+ * A table ranked by ops also totals bytes for keys it holds, and vice
+ * versa, so both columns are meaningful in either ranking.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pvfs2-internal.h"
+#include "pint-top.h"
+#include "quicklist.h"
+#include "quickhash.h"
+#include "gen-locks.h"
+
+struct top_counter
+{
+    struct PVFS_mgmt_top_entry entry;
+    PVFS_uid uid;               /* client tables: last uid seen */
+    int used;
+    struct qlist_head hash_link;
+};
+
+struct top_table
+{
+    enum PVFS_mgmt_top_metric metric;
+    struct qhash_table *hash;
+    struct top_counter counter[PINT_TOP_CAPACITY];
+};
+
+static struct top_table *top_tables[PVFS_MGMT_TOP_KINDS][PVFS_MGMT_TOP_METRICS];
+static time_t top_last_decay = 0;
+
+static gen_mutex_t top_mutex = GEN_MUTEX_INITIALIZER;
+
+static int top_hash_compare_keys(const void *key, struct qlist_head *link);
+
+/* PINT_top_initialize()
+ *
+ * Allocate the heavy hitter tables.
+ */
+int PINT_top_initialize(void)
+{
+    struct top_table *t;
+    int k, m;
+
+    PINT_top_finalize();
+
+    for (k = 0; k < PVFS_MGMT_TOP_KINDS; k++)
+    {
+        for (m = 0; m < PVFS_MGMT_TOP_METRICS; m++)
+        {
+            t = (struct top_table *)calloc(1, sizeof(struct top_table));
+            if (!t)
+            {
+                PINT_top_finalize();
+                return -PVFS_ENOMEM;
+            }
+            t->metric = m;
+            t->hash = qhash_init(top_hash_compare_keys,
+                                 quickhash_64bit_hash,
+                                 PINT_TOP_HASH_TABLE_SIZE);
+            if (!t->hash)
+            {
+                free(t);
+                PINT_top_finalize();
+                return -PVFS_ENOMEM;
+            }
+            top_tables[k][m] = t;
+        }
+    }
+    top_last_decay = time(NULL);
+
+    return 0;
+}
+
+/* PINT_top_finalize()
+ *
+ * Free all memory associated with the heavy hitter tables.
+ */
+void PINT_top_finalize(void)
+{
+    int k, m;
+
+    gen_mutex_lock(&top_mutex);
+    for (k = 0; k < PVFS_MGMT_TOP_KINDS; k++)
+    {
+        for (m = 0; m < PVFS_MGMT_TOP_METRICS; m++)
+        {
+            if (top_tables[k][m])
+            {
+                qhash_finalize(top_tables[k][m]->hash);
+                free(top_tables[k][m]);
+                top_tables[k][m] = NULL;
+            }
+        }
+    }
+    gen_mutex_unlock(&top_mutex);
+}
+
+/* top_find()
+ *
+ * returns the counter holding key, or NULL
+ */
+static struct top_counter *top_find(struct top_table *t, uint64_t key)
+{
+    struct qlist_head *link;
+
+    link = qhash_search(t->hash, &key);
+    if (!link)
+    {
+        return NULL;
+    }
+    return qlist_entry(link, struct top_counter, hash_link);
+}
+
+/* top_claim()
+ *
+ * returns the counter holding key, evicting the smallest counter if the
+ * key is not present
+ */
+static struct top_counter *top_claim(struct top_table *t, uint64_t key)
+{
+    struct top_counter *c, *min = NULL;
+    uint64_t count, min_count = 0;
+    int i;
+
+    c = top_find(t, key);
+    if (c)
+    {
+        return c;
+    }
+
+    for (i = 0; i < PINT_TOP_CAPACITY; i++)
+    {
+        c = &t->counter[i];
+        if (!c->used)
+        {
+            min = c;
+            min_count = 0;
+            break;
+        }
+        count = (t->metric == PVFS_MGMT_TOP_OPS) ?
+                c->entry.ops : c->entry.bytes;
+        if (!min || count < min_count)
+        {
+            min = c;
+            min_count = count;
+        }
+    }
+
+    if (min->used)
+    {
+        qhash_del(&min->hash_link);
+    }
+    memset(&min->entry, 0, sizeof(min->entry));
+    min->entry.key = key;
+    min->entry.error = min_count;
+    if (t->metric == PVFS_MGMT_TOP_OPS)
+    {
+        min->entry.ops = min_count;
+    }
+    else
+    {
+        min->entry.bytes = min_count;
+    }
+    min->uid = PINT_TOP_UID_NONE;
+    min->used = 1;
+    qhash_add(t->hash, &min->entry.key, &min->hash_link);
+
+    return min;
+}
+
+/* top_add()
+ *
+ * charges ops and bytes to key in both tables of one kind; each table
+ * only admits new keys for its own metric
+ */
+static struct top_counter *top_add(int kind,
+                                   uint64_t key,
+                                   uint64_t ops,
+                                   uint64_t bytes)
+{
+    struct top_table *ranked = top_tables[kind][ops ? PVFS_MGMT_TOP_OPS :
+                                                      PVFS_MGMT_TOP_BYTES];
+    struct top_table *other = top_tables[kind][ops ? PVFS_MGMT_TOP_BYTES :
+                                                     PVFS_MGMT_TOP_OPS];
+    struct top_counter *c;
+
+    c = top_find(other, key);
+    if (c)
+    {
+        c->entry.ops += ops;
+        c->entry.bytes += bytes;
+    }
+
+    c = top_claim(ranked, key);
+    c->entry.ops += ops;
+    c->entry.bytes += bytes;
+    return c;
+}
+
+/* top_client_uid()
+ *
+ * returns the last uid seen from a client address
+ */
+static PVFS_uid top_client_uid(PVFS_BMI_addr_t addr)
+{
+    struct top_counter *c;
+    int m;
+
+    for (m = 0; m < PVFS_MGMT_TOP_METRICS; m++)
+    {
+        c = top_find(top_tables[PVFS_MGMT_TOP_CLIENT][m], (uint64_t)addr);
+        if (c && c->uid != PINT_TOP_UID_NONE)
+        {
+            return c->uid;
+        }
+    }
+    return PINT_TOP_UID_NONE;
+}
+
+/* PINT_top_count_op()
+ *
+ * Charges one request to its client, user and target object.  Requests
+ * without a credential (I/O in particular) are charged to the last uid
+ * that client presented.
+ */
+void PINT_top_count_op(PVFS_BMI_addr_t addr,
+                       PVFS_uid uid,
+                       PVFS_handle handle)
+{
+    struct top_counter *c;
+    struct top_counter *other;
+
+    gen_mutex_lock(&top_mutex);
+    if (!top_tables[0][0])
+    {
+        gen_mutex_unlock(&top_mutex);
+        return;
+    }
+
+    c = top_add(PVFS_MGMT_TOP_CLIENT, (uint64_t)addr, 1, 0);
+    if (uid != PINT_TOP_UID_NONE)
+    {
+        c->uid = uid;
+        other = top_find(top_tables[PVFS_MGMT_TOP_CLIENT][PVFS_MGMT_TOP_BYTES],
+                         (uint64_t)addr);
+        if (other)
+        {
+            other->uid = uid;
+        }
+    }
+    else
+    {
+        uid = top_client_uid(addr);
+    }
+
+    if (uid != PINT_TOP_UID_NONE)
+    {
+        top_add(PVFS_MGMT_TOP_UID, (uint64_t)uid, 1, 0);
+    }
+    if (handle != PVFS_HANDLE_NULL)
+    {
+        top_add(PVFS_MGMT_TOP_HANDLE, (uint64_t)handle, 1, 0);
+    }
+    gen_mutex_unlock(&top_mutex);
+}
+
+/* PINT_top_count_bytes()
+ *
+ * Charges bytes moved by an I/O request to its client, user and object.
+ */
+void PINT_top_count_bytes(PVFS_BMI_addr_t addr,
+                          PVFS_handle handle,
+                          PVFS_size bytes)
+{
+    PVFS_uid uid;
+
+    if (bytes <= 0)
+    {
+        return;
+    }
+
+    gen_mutex_lock(&top_mutex);
+    if (!top_tables[0][0])
+    {
+        gen_mutex_unlock(&top_mutex);
+        return;
+    }
+
+    uid = top_client_uid(addr);
+    top_add(PVFS_MGMT_TOP_CLIENT, (uint64_t)addr, 0, bytes)->uid = uid;
+    if (uid != PINT_TOP_UID_NONE)
+    {
+        top_add(PVFS_MGMT_TOP_UID, (uint64_t)uid, 0, bytes);
+    }
+    if (handle != PVFS_HANDLE_NULL)
+    {
+        top_add(PVFS_MGMT_TOP_HANDLE, (uint64_t)handle, 0, bytes);
+    }
+    gen_mutex_unlock(&top_mutex);
+}
+
+/* PINT_top_decay()
+ *
+ * Halves every count once per PINT_TOP_HALF_LIFE_SECS.  Called from the
+ * periodic perf counter update.
+ */
+void PINT_top_decay(void)
+{
+    struct top_counter *c;
+    time_t now = time(NULL);
+    int k, m, i;
+
+    gen_mutex_lock(&top_mutex);
+    if (!top_tables[0][0] || now - top_last_decay < PINT_TOP_HALF_LIFE_SECS)
+    {
+        gen_mutex_unlock(&top_mutex);
+        return;
+    }
+    top_last_decay = now;
+
+    for (k = 0; k < PVFS_MGMT_TOP_KINDS; k++)
+    {
+        for (m = 0; m < PVFS_MGMT_TOP_METRICS; m++)
+        {
+            for (i = 0; i < PINT_TOP_CAPACITY; i++)
+            {
+                c = &top_tables[k][m]->counter[i];
+                c->entry.ops >>= 1;
+                c->entry.bytes >>= 1;
+                c->entry.error >>= 1;
+            }
+        }
+    }
+    gen_mutex_unlock(&top_mutex);
+}
+
+static int top_compare_ops(const void *a, const void *b)
+{
+    const struct PVFS_mgmt_top_entry *x = a, *y = b;
+
+    return (x->ops < y->ops) - (x->ops > y->ops);
+}
+
+static int top_compare_bytes(const void *a, const void *b)
+{
+    const struct PVFS_mgmt_top_entry *x = a, *y = b;
+
+    return (x->bytes < y->bytes) - (x->bytes > y->bytes);
+}
+
+/* PINT_top_dump()
+ *
+ * Copies up to entry_count of the heaviest keys of one table, heaviest
+ * first, into entry_array.  Client keys are BMI addresses.
+ *
+ * returns the number of entries copied
+ */
+int PINT_top_dump(enum PVFS_mgmt_top_kind kind,
+                  enum PVFS_mgmt_top_metric metric,
+                  struct PVFS_mgmt_top_entry *entry_array,
+                  int entry_count)
+{
+    struct PVFS_mgmt_top_entry all[PINT_TOP_CAPACITY];
+    struct top_table *t;
+    int i, n = 0;
+
+    if ((unsigned)kind >= PVFS_MGMT_TOP_KINDS ||
+        (unsigned)metric >= PVFS_MGMT_TOP_METRICS)
+    {
+        return -PVFS_EINVAL;
+    }
+
+    gen_mutex_lock(&top_mutex);
+    t = top_tables[kind][metric];
+    if (!t)
+    {
+        gen_mutex_unlock(&top_mutex);
+        return 0;
+    }
+    for (i = 0; i < PINT_TOP_CAPACITY; i++)
+    {
+        if (t->counter[i].used &&
+            (metric == PVFS_MGMT_TOP_OPS ? t->counter[i].entry.ops :
+                                           t->counter[i].entry.bytes))
+        {
+            all[n++] = t->counter[i].entry;
+        }
+    }
+    gen_mutex_unlock(&top_mutex);
+
+    qsort(all, n, sizeof(all[0]),
+          metric == PVFS_MGMT_TOP_OPS ? top_compare_ops : top_compare_bytes);
+    if (n > entry_count)
+    {
+        n = entry_count;
+    }
+    memcpy(entry_array, all, n * sizeof(all[0]));
+
+    return n;
+}
+
+/* top_hash_compare_keys()
+ *
+ * Compare will return true if hash entry has same key as a given key.
+ */
+static int top_hash_compare_keys(const void *key, struct qlist_head *link)
+{
+    struct top_counter *c = qhash_entry(link, struct top_counter, hash_link);
+
+    return (*(const uint64_t *)key == c->entry.key);
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
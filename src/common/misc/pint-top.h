@@ -0,0 +1,51 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __PINT_TOP_H
+#define __PINT_TOP_H
+
+#include "pvfs2-internal.h"
+#include "pvfs2-types.h"
+#include "pvfs2-mgmt.h"
+
+/* PINT_TOP_CAPACITY is the number of counters kept per table.  The
+ *   Space-Saving algorithm guarantees that any key carrying more than
+ *   1/PINT_TOP_CAPACITY of a table's total is present in that table.
+ * PINT_TOP_HALF_LIFE_SECS is how often all counts are halved, so the
+ *   tables follow the current load rather than the server's lifetime.
+ */
+#define PINT_TOP_CAPACITY 64
+#define PINT_TOP_HASH_TABLE_SIZE 127
+#define PINT_TOP_HALF_LIFE_SECS 10
+
+/* passed as the uid of requests that carry no credential */
+#define PINT_TOP_UID_NONE ((PVFS_uid)-1)
+
+/* FUNCTION PROTOTYPES */
+int PINT_top_initialize(void);
+void PINT_top_finalize(void);
+void PINT_top_count_op(PVFS_BMI_addr_t addr,
+                       PVFS_uid uid,
+                       PVFS_handle handle);
+void PINT_top_count_bytes(PVFS_BMI_addr_t addr,
+                          PVFS_handle handle,
+                          PVFS_size bytes);
+void PINT_top_decay(void);
+int PINT_top_dump(enum PVFS_mgmt_top_kind kind,
+                  enum PVFS_mgmt_top_metric metric,
+                  struct PVFS_mgmt_top_entry *entry_array,
+                  int entry_count);
+
+#endif /* __PINT_TOP_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
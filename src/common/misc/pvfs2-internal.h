@@ -152,6 +152,10 @@
 #define NUM_DFILES_REQ_KEYSTR         "nd\0"
 #define NUM_DFILES_REQ_KEYLEN         3
 
+/* kept on the datafile of a stuffed file whose bytes are stored inline */
+#define INLINE_DATA_KEYSTR            "id\0"
+#define INLINE_DATA_KEYLEN            3
+
 /* new keys for distributed directory, '/' makes sure no conflict with dirent names */
 #define DIST_DIR_ATTR_KEYSTR          "/dda\0"
 #define DIST_DIR_ATTR_KEYLEN          5
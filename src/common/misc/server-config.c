@@ -107,6 +107,7 @@ static DOTCONF_CB(get_attr_cache_max_num_elems);
 static DOTCONF_CB(get_trove_sync_meta);
 static DOTCONF_CB(get_trove_sync_data);
 static DOTCONF_CB(get_file_stuffing);
+static DOTCONF_CB(get_inline_data_size);
 static DOTCONF_CB(get_trove_max_concurrent_io);
 /* Berkeley DB */
 static DOTCONF_CB(get_db_cache_size_bytes);
@@ -133,6 +134,7 @@ static DOTCONF_CB(get_small_file_size);
 static DOTCONF_CB(directio_thread_num);
 static DOTCONF_CB(directio_ops_per_queue);
 static DOTCONF_CB(directio_timeout);
+static DOTCONF_CB(get_packed_bstream_max_size);
 
 static DOTCONF_CB(get_key_store);
 static DOTCONF_CB(get_server_key);
@@ -164,6 +166,14 @@ static DOTCONF_CB(tree_threshold);
 static DOTCONF_CB(distr_dir_servers_initial);
 static DOTCONF_CB(distr_dir_servers_max);
 static DOTCONF_CB(distr_dir_split_size);
+static DOTCONF_CB(get_fair_share);
+static DOTCONF_CB(get_fair_share_max_ops);
+static DOTCONF_CB(get_fair_share_max_bytes);
+static DOTCONF_CB(get_fair_share_quantum);
+static DOTCONF_CB(get_fair_share_unit_bytes);
+static DOTCONF_CB(get_fair_share_weights);
+static DOTCONF_CB(get_eager_write_sizes);
+static DOTCONF_CB(get_mirror_read_selector);
 
 static FUNC_ERRORHANDLER(errorhandler);
 const char *contextchecker(command_t *cmd, unsigned long mask);
@@ -722,7 +732,11 @@ static const configoption_t options[] =
     {"EventLogging",ARG_LIST, get_event_logging_list,NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"none,"},
 
-    /* Enable code related to the use of TAU (Tuning and Analysis Utilities) */
+    /* Start the server with every event enabled.  Events are recorded to
+     * TAU (Tuning and Analysis Utilities) when built with it, otherwise to
+     * in-memory ring buffers read back through pvfs2-event-mon-example.
+     * Either way they can be toggled at runtime with pvfs2-set-eventmask.
+     */
     {"EnableTracing",ARG_STR, get_event_tracing,NULL,
         CTX_DEFAULTS|CTX_SERVER_OPTIONS,"no"},
 
@@ -868,6 +882,15 @@ static const configoption_t options[] =
     {"FileStuffing",ARG_STR, get_file_stuffing, NULL, 
         CTX_FILESYSTEM,"yes"},
 
+    /* Stuffed files no larger than this many bytes keep their data in a
+     * keyval next to the metadata instead of a bstream, and a getattr
+     * that asks for the size returns it.  A file moves to a bstream when
+     * it grows past this size.  0 disables inline data; the maximum is
+     * 4096.
+     */
+    {"InlineDataSize", ARG_INT, get_inline_data_size, NULL,
+        CTX_FILESYSTEM, "0"},
+
      /* This specifies the number of samples
       * that performance monitor should keep
       *
@@ -1219,6 +1242,13 @@ static const configoption_t options[] =
     {"DirectIOTimeout", ARG_INT, directio_timeout, NULL,
         CTX_STORAGEHINTS, "1000"},
 
+    /* Bstreams no larger than this many bytes are stored as records in
+     * shared container files rather than one local file each; they move
+     * to their own file once they grow past it.  0 disables packing.
+     */
+    {"PackedBstreamMaxSize", ARG_INT, get_packed_bstream_max_size, NULL,
+        CTX_STORAGEHINTS, "0"},
+
     /* Specifies the number of partitions to use for tree communication. */
     {"TreeWidth", ARG_INT, tree_width, NULL,
         CTX_FILESYSTEM, "2"},
@@ -1239,6 +1269,71 @@ static const configoption_t options[] =
     {"DistrDirSplitSize", ARG_INT, distr_dir_split_size, NULL,
         CTX_FILESYSTEM, "10000"},
 
+    /* Groups requests for fair-share admission in the request scheduler.
+     * "uid" gives each user an equal share of the server, "client" gives
+     * each client address one, and "none" (the default) admits requests
+     * in arrival order.  Admission only holds requests back once the
+     * limits below are reached.
+     */
+    {"FairShare", ARG_STR, get_fair_share, NULL,
+        CTX_FILESYSTEM, "none"},
+
+    /* Specifies how many requests may be admitted to the scheduler at
+     * once before FairShare starts holding them back.  0 is unlimited.
+     */
+    {"FairShareMaxOps", ARG_INT, get_fair_share_max_ops, NULL,
+        CTX_FILESYSTEM, "256"},
+
+    /* Specifies how many I/O bytes may be in progress at once before
+     * FairShare starts holding requests back.  0 is unlimited.
+     */
+    {"FairShareMaxBytes", ARG_INT, get_fair_share_max_bytes, NULL,
+        CTX_FILESYSTEM, "268435456"},
+
+    /* Specifies how many cost units a class with weight 1 may admit per
+     * round.  Every request costs one unit plus one per
+     * FairShareUnitBytes of I/O.
+     */
+    {"FairShareQuantum", ARG_INT, get_fair_share_quantum, NULL,
+        CTX_FILESYSTEM, "4"},
+
+    /* Specifies the number of I/O bytes charged as one cost unit. */
+    {"FairShareUnitBytes", ARG_INT, get_fair_share_unit_bytes, NULL,
+        CTX_FILESYSTEM, "1048576"},
+
+    /* Gives some classes a larger share than others, as a list of
+     * key:weight entries.  Keys are uids when FairShare is "uid" and
+     * client address prefixes when it is "client".  Unlisted classes
+     * have weight 1.
+     *
+     * <c>FairShareWeights 0:8 1000:2</c>
+     * <c>FairShareWeights tcp://10.0.0.5:4 tcp://10.0.1.:2</c>
+     */
+    {"FairShareWeights", ARG_LIST, get_fair_share_weights, NULL,
+        CTX_FILESYSTEM, ""},
+
+    /* Lets clients send up to this many bytes of a write to a server
+     * right behind the I/O request instead of waiting for its ack, as a
+     * list of method:bytes entries keyed by the BMI address scheme.
+     * Servers receive the data into a buffer before the request is
+     * scheduled.  Methods that are not listed, and clients short on
+     * memory, wait for the ack.  The maximum is 1048576.
+     *
+     * <c>EagerWriteSizes tcp:262144 ib:65536</c>
+     */
+    {"EagerWriteSizes", ARG_LIST, get_eager_write_sizes, NULL,
+        CTX_FILESYSTEM, ""},
+
+    /* Chooses which copy of a mirrored (immutable) file each datafile
+     * read goes to.  "primary" (the default) reads the original
+     * datafiles and only uses the mirrors when a read fails.  "hash"
+     * spreads the datafiles of each client over all copies by a hash of
+     * the client's host name and pid.  "latency" sends each read to the
+     * copy whose server has answered this client fastest lately.
+     */
+    {"MirrorReadSelector", ARG_STR, get_mirror_read_selector, NULL,
+        CTX_FILESYSTEM, "primary"},
+
     LAST_OPTION
 };
 
@@ -2828,6 +2923,26 @@ DOTCONF_CB(get_file_stuffing)
     return NULL;
 }
 
+DOTCONF_CB(get_inline_data_size)
+{
+    struct filesystem_configuration_s *fs_conf = NULL;
+    struct server_configuration_s *config_s = 
+                 (struct server_configuration_s *)cmd->context;
+
+    fs_conf = (struct filesystem_configuration_s *)
+                    PINT_llist_head(config_s->file_systems);
+    assert(fs_conf);
+
+    if (cmd->data.value < 0 ||
+        cmd->data.value > PVFS_REQ_LIMIT_INLINE_DATA)
+    {
+        return("InlineDataSize must be between 0 and 4096.\n");
+    }
+    fs_conf->inline_data_size = (int32_t)cmd->data.value;
+
+    return NULL;
+}
+
 
 DOTCONF_CB(get_trove_sync_meta)
 {
@@ -3447,6 +3562,20 @@ DOTCONF_CB(directio_timeout)
     return NULL;
 }
 
+DOTCONF_CB(get_packed_bstream_max_size)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    fs_conf->packed_bstream_max = cmd->data.value;
+
+    return NULL;
+}
+
 DOTCONF_CB(get_key_store)
 {
     struct server_configuration_s *config_s =
@@ -3953,6 +4082,224 @@ DOTCONF_CB(distr_dir_split_size)
     return NULL;
 }
 
+DOTCONF_CB(get_fair_share)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (!strcasecmp(cmd->data.str, "none"))
+    {
+        fs_conf->fair_share = PINT_FAIR_SHARE_NONE;
+    }
+    else if (!strcasecmp(cmd->data.str, "uid"))
+    {
+        fs_conf->fair_share = PINT_FAIR_SHARE_UID;
+    }
+    else if (!strcasecmp(cmd->data.str, "client"))
+    {
+        fs_conf->fair_share = PINT_FAIR_SHARE_CLIENT;
+    }
+    else
+    {
+        return "FairShare must be one of none, uid or client\n";
+    }
+    return NULL;
+}
+
+DOTCONF_CB(get_fair_share_max_ops)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (cmd->data.value < 0)
+    {
+        return "FairShareMaxOps must not be negative\n";
+    }
+    fs_conf->fair_share_max_ops = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_fair_share_max_bytes)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (cmd->data.value < 0)
+    {
+        return "FairShareMaxBytes must not be negative\n";
+    }
+    fs_conf->fair_share_max_bytes = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_fair_share_quantum)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (cmd->data.value < 1)
+    {
+        return "FairShareQuantum must be at least 1\n";
+    }
+    fs_conf->fair_share_quantum = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_fair_share_unit_bytes)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (cmd->data.value < 1)
+    {
+        return "FairShareUnitBytes must be at least 1\n";
+    }
+    fs_conf->fair_share_unit_bytes = cmd->data.value;
+    return NULL;
+}
+
+DOTCONF_CB(get_fair_share_weights)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+    char *sep, *end;
+    long weight;
+    int i;
+
+    free_list_of_strings(fs_conf->fair_share_weight_count,
+                         &fs_conf->fair_share_weight_keys);
+    free(fs_conf->fair_share_weights);
+    fs_conf->fair_share_weights = NULL;
+    fs_conf->fair_share_weight_count = 0;
+
+    if (cmd->arg_count == 0)
+    {
+        return NULL;
+    }
+
+    fs_conf->fair_share_weights = (int *)calloc(cmd->arg_count, sizeof(int));
+    if (!fs_conf->fair_share_weights ||
+        get_list_of_strings(cmd->arg_count, cmd->data.list,
+                            &fs_conf->fair_share_weight_keys) < 0)
+    {
+        free(fs_conf->fair_share_weights);
+        fs_conf->fair_share_weights = NULL;
+        return "Could not allocate memory for FairShareWeights\n";
+    }
+    fs_conf->fair_share_weight_count = cmd->arg_count;
+
+    /* the weight follows the last colon so client keys may hold ports */
+    for (i = 0; i < cmd->arg_count; i++)
+    {
+        sep = strrchr(fs_conf->fair_share_weight_keys[i], ':');
+        weight = sep ? strtol(sep + 1, &end, 10) : 0;
+        if (!sep || sep == fs_conf->fair_share_weight_keys[i] ||
+            *end != '\0' || weight < 1)
+        {
+            return "FairShareWeights entries must look like key:weight "
+                   "with a weight of at least 1\n";
+        }
+        *sep = '\0';
+        fs_conf->fair_share_weights[i] = weight;
+    }
+    return NULL;
+}
+
+DOTCONF_CB(get_eager_write_sizes)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+    char *sep, *end;
+    long size;
+    int i;
+
+    free_list_of_strings(fs_conf->eager_write_count,
+                         &fs_conf->eager_write_methods);
+    free(fs_conf->eager_write_sizes);
+    fs_conf->eager_write_sizes = NULL;
+    fs_conf->eager_write_count = 0;
+
+    if (cmd->arg_count == 0)
+    {
+        return NULL;
+    }
+
+    fs_conf->eager_write_sizes =
+        (int32_t *)calloc(cmd->arg_count, sizeof(int32_t));
+    if (!fs_conf->eager_write_sizes ||
+        get_list_of_strings(cmd->arg_count, cmd->data.list,
+                            &fs_conf->eager_write_methods) < 0)
+    {
+        free(fs_conf->eager_write_sizes);
+        fs_conf->eager_write_sizes = NULL;
+        return "Could not allocate memory for EagerWriteSizes\n";
+    }
+    fs_conf->eager_write_count = cmd->arg_count;
+
+    for (i = 0; i < cmd->arg_count; i++)
+    {
+        sep = strchr(fs_conf->eager_write_methods[i], ':');
+        size = sep ? strtol(sep + 1, &end, 10) : -1;
+        if (!sep || sep == fs_conf->eager_write_methods[i] ||
+            *end != '\0' || size < 0 || size > PVFS_REQ_LIMIT_EAGER_WRITE)
+        {
+            return "EagerWriteSizes entries must look like method:bytes "
+                   "with at most 1048576 bytes\n";
+        }
+        *sep = '\0';
+        fs_conf->eager_write_sizes[i] = size;
+    }
+    return NULL;
+}
+
+DOTCONF_CB(get_mirror_read_selector)
+{
+    struct server_configuration_s *config_s =
+        (struct server_configuration_s *)cmd->context;
+    struct filesystem_configuration_s *fs_conf =
+        (struct filesystem_configuration_s *)
+        PINT_llist_head(config_s->file_systems);
+
+    if (!strcasecmp(cmd->data.str, "primary"))
+    {
+        fs_conf->mirror_read_selector = PINT_MIRROR_READ_PRIMARY;
+    }
+    else if (!strcasecmp(cmd->data.str, "hash"))
+    {
+        fs_conf->mirror_read_selector = PINT_MIRROR_READ_HASH;
+    }
+    else if (!strcasecmp(cmd->data.str, "latency"))
+    {
+        fs_conf->mirror_read_selector = PINT_MIRROR_READ_LATENCY;
+    }
+    else
+    {
+        return "MirrorReadSelector must be one of primary, hash or latency\n";
+    }
+    return NULL;
+}
+
 
 /*
  * Function: PINT_config_release
@@ -4338,6 +4685,28 @@ static void free_filesystem(void *ptr)
             free(fs->root_squash_exceptions_netmasks);
             fs->root_squash_exceptions_netmasks = NULL;
         }
+        if (fs->fair_share_weight_keys)
+        {
+            free_list_of_strings(fs->fair_share_weight_count,
+                                 &fs->fair_share_weight_keys);
+            fs->fair_share_weight_count = 0;
+        }
+        if (fs->fair_share_weights)
+        {
+            free(fs->fair_share_weights);
+            fs->fair_share_weights = NULL;
+        }
+        if (fs->eager_write_methods)
+        {
+            free_list_of_strings(fs->eager_write_count,
+                                 &fs->eager_write_methods);
+            fs->eager_write_count = 0;
+        }
+        if (fs->eager_write_sizes)
+        {
+            free(fs->eager_write_sizes);
+            fs->eager_write_sizes = NULL;
+        }
         /* free all root_squash_hosts specifications */
         if (fs->root_squash_hosts)
         {
@@ -4532,6 +4901,51 @@ static void copy_filesystem(struct filesystem_configuration_s *dest_fs,
 
         dest_fs->fp_buffer_size = src_fs->fp_buffer_size;
         dest_fs->fp_buffers_per_flow = src_fs->fp_buffers_per_flow;
+
+        dest_fs->inline_data_size = src_fs->inline_data_size;
+
+        dest_fs->fair_share = src_fs->fair_share;
+        dest_fs->mirror_read_selector = src_fs->mirror_read_selector;
+        dest_fs->fair_share_max_ops = src_fs->fair_share_max_ops;
+        dest_fs->fair_share_max_bytes = src_fs->fair_share_max_bytes;
+        dest_fs->fair_share_quantum = src_fs->fair_share_quantum;
+        dest_fs->fair_share_unit_bytes = src_fs->fair_share_unit_bytes;
+        if (src_fs->fair_share_weight_count > 0)
+        {
+            int i;
+            dest_fs->fair_share_weight_count = src_fs->fair_share_weight_count;
+            dest_fs->fair_share_weight_keys = (char **) calloc(
+                src_fs->fair_share_weight_count, sizeof(char *));
+            assert(dest_fs->fair_share_weight_keys);
+            dest_fs->fair_share_weights = (int *) calloc(
+                src_fs->fair_share_weight_count, sizeof(int));
+            assert(dest_fs->fair_share_weights);
+            for (i = 0; i < src_fs->fair_share_weight_count; i++)
+            {
+                dest_fs->fair_share_weight_keys[i] =
+                    strdup(src_fs->fair_share_weight_keys[i]);
+                assert(dest_fs->fair_share_weight_keys[i]);
+                dest_fs->fair_share_weights[i] = src_fs->fair_share_weights[i];
+            }
+        }
+        if (src_fs->eager_write_count > 0)
+        {
+            int i;
+            dest_fs->eager_write_count = src_fs->eager_write_count;
+            dest_fs->eager_write_methods = (char **) calloc(
+                src_fs->eager_write_count, sizeof(char *));
+            assert(dest_fs->eager_write_methods);
+            dest_fs->eager_write_sizes = (int32_t *) calloc(
+                src_fs->eager_write_count, sizeof(int32_t));
+            assert(dest_fs->eager_write_sizes);
+            for (i = 0; i < src_fs->eager_write_count; i++)
+            {
+                dest_fs->eager_write_methods[i] =
+                    strdup(src_fs->eager_write_methods[i]);
+                assert(dest_fs->eager_write_methods[i]);
+                dest_fs->eager_write_sizes[i] = src_fs->eager_write_sizes[i];
+            }
+        }
     }
 }
 
@@ -5365,6 +5779,43 @@ int PINT_config_trim_filesystems_except(
     return ret;
 }
 
+/*
+ * Function: PINT_config_get_eager_write_size
+ *
+ * Returns:  the number of bytes a write may send to the server at
+ *           addr_string right behind its request, 0 if none
+ *
+ * Synopsis: looks up the EagerWriteSizes entry for the scheme of a
+ *           BMI address such as tcp://host:port
+ */
+int32_t PINT_config_get_eager_write_size(
+    struct filesystem_configuration_s *fs,
+    const char *addr_string)
+{
+    const char *sep;
+    int i;
+
+    if (!fs || !addr_string)
+    {
+        return 0;
+    }
+    sep = strstr(addr_string, "://");
+    if (!sep)
+    {
+        return 0;
+    }
+    for (i = 0; i < fs->eager_write_count; i++)
+    {
+        if (strlen(fs->eager_write_methods[i]) == (size_t)(sep - addr_string)
+            && !strncmp(fs->eager_write_methods[i], addr_string,
+                        sep - addr_string))
+        {
+            return fs->eager_write_sizes[i];
+        }
+    }
+    return 0;
+}
+
 int PINT_config_get_fs_key(struct server_configuration_s *config,
                            PVFS_fs_id fs_id,
                            char ** key,
@@ -32,6 +32,21 @@ enum
     CTX_LDAP             = (1 << 12),
 };
 
+/* how the request scheduler groups requests for fair-share admission */
+enum PINT_fair_share_class
+{
+    PINT_FAIR_SHARE_NONE = 0,
+    PINT_FAIR_SHARE_UID,
+    PINT_FAIR_SHARE_CLIENT
+};
+
+enum PINT_mirror_read_selector
+{
+    PINT_MIRROR_READ_PRIMARY = 0,
+    PINT_MIRROR_READ_HASH,
+    PINT_MIRROR_READ_LATENCY
+};
+
 typedef struct phys_server_desc
 {
     PVFS_BMI_addr_t addr;
@@ -92,6 +107,8 @@ typedef struct filesystem_configuration_s
     int coalescing_high_watermark;
     int coalescing_low_watermark;
     int file_stuffing;
+    /* bytes a stuffed file may keep inline; 0 if disabled */
+    int32_t inline_data_size;
 
     char *secret_key;
 
@@ -128,8 +145,29 @@ typedef struct filesystem_configuration_s
     int32_t directio_ops_per_queue;
     int32_t directio_timeout;
 
+    /* bstreams up to this size are packed into container files */
+    int32_t packed_bstream_max;
+
     /* size used to create keyval, dataspace, and collection_attributes databases. LMDB only.*/
     size_t db_max_size;
+
+    /* fair-share admission in the request scheduler */
+    enum PINT_fair_share_class fair_share;
+    int32_t fair_share_max_ops;
+    int64_t fair_share_max_bytes;
+    int32_t fair_share_quantum;
+    int64_t fair_share_unit_bytes;
+    int    fair_share_weight_count;
+    char **fair_share_weight_keys;   /* uid or client address prefix */
+    int   *fair_share_weights;
+
+    /* bytes of a write sent behind its request, per BMI address scheme */
+    int      eager_write_count;
+    char   **eager_write_methods;
+    int32_t *eager_write_sizes;
+
+    /* how clients pick among the copies of a mirrored file for reads */
+    enum PINT_mirror_read_selector mirror_read_selector;
 } filesystem_configuration_s;
 
 typedef struct distribution_param_configuration_s
@@ -343,6 +381,10 @@ int PINT_config_trim_filesystems_except(
     struct server_configuration_s *config_s,
     PVFS_fs_id fs_id);
 
+int32_t PINT_config_get_eager_write_size(
+    struct filesystem_configuration_s *fs,
+    const char *addr_string);
+
 int PINT_config_get_fs_key(
     struct server_configuration_s *config,
     PVFS_fs_id fs_id,
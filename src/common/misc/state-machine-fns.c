@@ -16,15 +16,25 @@
 #include "pvfs2-debug.h"
 #include "state-machine.h"
 #include "client-state-machine.h"
+#include "pint-slab.h"
 
 struct PINT_frame_s
 {
     int task_id;
     void *frame;
     int error;
+    struct PINT_slab_cache *cache; /* owner of frame, if allocated here */
     struct qlist_head link;
 };
 
+/* smcbs, frame list entries and base frames are allocated on every
+ * operation; these caches recycle them instead of going to malloc
+ */
+static struct PINT_slab_cache *smcb_cache = NULL;
+static struct PINT_slab_cache *frame_entry_cache = NULL;
+
+PINT_event_type PINT_sm_state_event_id;
+
 static struct PINT_state_s *PINT_pop_state(struct PINT_smcb *);
 static void PINT_push_state(struct PINT_smcb *, struct PINT_state_s *);
 static struct PINT_state_s *PINT_sm_task_map(struct PINT_smcb *smcb, int task_id);
@@ -124,6 +134,9 @@ PINT_sm_action PINT_state_machine_invoke(struct PINT_smcb *smcb,
     const char * state_name;
     const char * machine_name;
     int children_started = 0;
+#if PINT_EVENT_ENABLED
+    PINT_event_id state_event_id = 0;
+#endif
 
     if (!(smcb) || !(smcb->current_state) ||
             !(smcb->current_state->flag == SM_RUN ||
@@ -149,7 +162,10 @@ PINT_sm_action PINT_state_machine_invoke(struct PINT_smcb *smcb,
 //}
      
     /* call state action function */
+    PINT_EVENT_START(PINT_sm_state_event_id, 0, NULL, &state_event_id,
+                     machine_name, state_name);
     retval = (smcb->current_state->action.func)(smcb,r);
+    PINT_EVENT_END(PINT_sm_state_event_id, 0, NULL, state_event_id, 0);
     /* process return code */
     switch (retval)
     {
@@ -522,13 +538,18 @@ int PINT_smcb_alloc(
         int (*term_fn)(struct PINT_smcb *, job_status_s *),
         job_context_id context_id)
 {
-    *smcb = (struct PINT_smcb *)malloc(sizeof(struct PINT_smcb));
+    struct PINT_slab_cache *frame_cache;
+
+    if (!smcb_cache)
+    {
+        smcb_cache = PINT_slab_cache_get(sizeof(struct PINT_smcb));
+    }
+    /* members are zeroed by the cache */
+    *smcb = (struct PINT_smcb *)PINT_slab_alloc(smcb_cache);
     if (!(*smcb))
     {
         return -PVFS_ENOMEM;
     }
-    /* zero out all members */
-    memset(*smcb, 0, sizeof(struct PINT_smcb));
 
     INIT_QLIST_HEAD(&(*smcb)->frames);
     (*smcb)->base_frame = -1; /* no frames yet */
@@ -537,16 +558,20 @@ int PINT_smcb_alloc(
     /* if frame_size given, allocate a frame */
     if (frame_size > 0)
     {
-        void *new_frame = malloc(frame_size);
-        if (!new_frame)
+        void *new_frame;
+
+        frame_cache = PINT_slab_cache_get(frame_size);
+        new_frame = PINT_slab_alloc(frame_cache);
+        if (!new_frame ||
+            PINT_sm_push_frame(*smcb, 0, new_frame) < 0)
         {
-            free(*smcb);
+            PINT_slab_free(frame_cache, new_frame);
+            PINT_slab_free(smcb_cache, *smcb);
             *smcb = NULL;
             return -PVFS_ENOMEM;
         }
-        /* zero out all members */
-        memset(new_frame, 0, frame_size);
-        PINT_sm_push_frame(*smcb, 0, new_frame);
+        qlist_entry((*smcb)->frames.next, struct PINT_frame_s,
+                    link)->cache = frame_cache;
         (*smcb)->base_frame = 0;
     }
     (*smcb)->op = op;
@@ -594,12 +619,19 @@ void PINT_smcb_free(struct PINT_smcb *smcb)
         if (frame_entry->frame && frame_entry->task_id == 0)
         {
             /* only free if task_id is 0 */
-            free(frame_entry->frame);
+            if (frame_entry->cache)
+            {
+                PINT_slab_free(frame_entry->cache, frame_entry->frame);
+            }
+            else
+            {
+                free(frame_entry->frame);
+            }
         } 
         qlist_del(&frame_entry->link);
-        free(frame_entry);
+        PINT_slab_free(frame_entry_cache, frame_entry);
     }
-    free(smcb);
+    PINT_slab_free(smcb_cache, smcb);
 }
 
 /* Function: PINT_pop_state
@@ -708,7 +740,11 @@ int PINT_sm_push_frame(struct PINT_smcb *smcb, int task_id, void *frame_p)
     gossip_debug(GOSSIP_STATE_MACHINE_DEBUG,
                  "[SM Frame PUSH]: (%p) frame: %p\n",
                  smcb, frame_p);
-    newframe = malloc(sizeof(struct PINT_frame_s));
+    if (!frame_entry_cache)
+    {
+        frame_entry_cache = PINT_slab_cache_get(sizeof(struct PINT_frame_s));
+    }
+    newframe = PINT_slab_alloc(frame_entry_cache);
     if(!newframe)
     {
         return -PVFS_ENOMEM;
@@ -755,7 +791,7 @@ void *PINT_sm_pop_frame(struct PINT_smcb *smcb,
     *error_code = frame_entry->error;
     *task_id = frame_entry->task_id;
 
-    free(frame_entry);
+    PINT_slab_free(frame_entry_cache, frame_entry);
 
     gossip_debug(GOSSIP_STATE_MACHINE_DEBUG,
             "[SM Frame POP]: (%p) frame: %p\n",
@@ -11,6 +11,7 @@
 #include "job.h"
 #include "quicklist.h"
 #include "server-config-mgr.h"
+#include "pint-event.h"
 
 /* STATE-MACHINE.H
  *
@@ -164,6 +165,9 @@ typedef enum {
 } PINT_sm_action;
 
 extern char * PINT_sm_action_string[];
+
+/* event recorded around every state action, once defined by the server */
+extern PINT_event_type PINT_sm_state_event_id;
 #define SM_ACTION_STRING(action) \
     (action == SM_ERROR ? "ERROR" : PINT_sm_action_string[action])
 
@@ -11,6 +11,7 @@
 #include "pvfs2-internal.h"
 #include "tcache.h"
 #include "gossip.h"
+#include "pint-perf-counter.h"
 
 /** \file
  *  \ingroup tcache
@@ -26,6 +27,9 @@ TCACHE_DEFAULT_TABLE_SIZE     =  1019,
 TCACHE_DEFAULT_REPLACE_ALGORITHM  = LEAST_RECENTLY_USED,
 };
 
+/* shard counts are added to the perf counter after this many events */
+#define TCACHE_SHARD_FOLD_INTERVAL 64
+
 static int check_expiration(
     struct PINT_tcache* tcache,
     struct PINT_tcache_entry* entry, /**< tcached entry */
@@ -611,6 +615,230 @@ static int check_expiration(
     return(0);
 }
 
+/**
+ * Initializes a sharded tcache instance.  The table size is divided among
+ * the shards.
+ * \return pointer to the instance on success, NULL on failure
+ */
+struct PINT_tcache_shards* PINT_tcache_shards_initialize(
+    int (*compare_key_entry) (const void *key, struct qhash_head* link), /**< see
+    PINT_tcache_initialize() */
+    int (*hash_key) (const void *key, int table_size), /**< function to hash keys */
+    int (*free_payload) (void* payload), /**< function to free payload members */
+    int table_size,  /**< total size of the hash tables, or -1 for default */
+    int shard_count) /**< number of shards, or -1 for default */
+{
+    struct PINT_tcache_shards* shards = NULL;
+    int i;
+
+    if(shard_count <= 0)
+    {
+        shard_count = TCACHE_DEFAULT_SHARD_COUNT;
+    }
+    if(table_size <= 0)
+    {
+        table_size = TCACHE_DEFAULT_TABLE_SIZE;
+    }
+    /* keys in one shard share a hash value modulo shard_count; an odd
+     * table size still spreads them over every bucket
+     */
+    table_size = (table_size / shard_count) | 1;
+
+    shards = (struct PINT_tcache_shards*)calloc(1, sizeof(*shards));
+    if(!shards)
+    {
+        return(NULL);
+    }
+    shards->shards = (struct PINT_tcache_shard*)calloc(shard_count,
+        sizeof(struct PINT_tcache_shard));
+    if(!shards->shards)
+    {
+        free(shards);
+        return(NULL);
+    }
+    shards->hash_key = hash_key;
+    shards->shard_count = shard_count;
+
+    for(i = 0; i < shard_count; i++)
+    {
+        gen_mutex_init(&shards->shards[i].mutex);
+        shards->shards[i].tcache = PINT_tcache_initialize(compare_key_entry,
+            hash_key, free_payload, table_size);
+        if(!shards->shards[i].tcache)
+        {
+            PINT_tcache_shards_finalize(shards);
+            return(NULL);
+        }
+    }
+
+    /* apply the default limits to the cache as a whole */
+    PINT_tcache_shards_set_info(shards, TCACHE_SOFT_LIMIT,
+                                TCACHE_DEFAULT_SOFT_LIMIT);
+    PINT_tcache_shards_set_info(shards, TCACHE_HARD_LIMIT,
+                                TCACHE_DEFAULT_HARD_LIMIT);
+
+    return(shards);
+}
+
+/** Finalizes and destroys a sharded tcache instance, frees all payloads */
+void PINT_tcache_shards_finalize(
+    struct PINT_tcache_shards* shards) /**< instance to destroy */
+{
+    int i;
+
+    if(!shards)
+    {
+        gossip_err("PINT_tcache_shards_finalize called with NULL pointer\n");
+        return;
+    }
+
+    for(i = 0; i < shards->shard_count; i++)
+    {
+        if(shards->shards[i].tcache)
+        {
+            PINT_tcache_finalize(shards->shards[i].tcache);
+        }
+        gen_mutex_destroy(&shards->shards[i].mutex);
+    }
+    free(shards->shards);
+    free(shards);
+}
+
+/**
+ * Retrieves parameters from a sharded tcache instance.  Limits and the
+ * number of entries are reported for the cache as a whole; the number of
+ * entries is read without locking and is approximate while other threads
+ * are changing the cache.
+ * @see PINT_tcache_options
+ * \return 0 on success, -PVFS_error on failure
+ */
+int PINT_tcache_shards_get_info(
+    struct PINT_tcache_shards* shards, /**< sharded tcache instance */
+    enum PINT_tcache_options option,   /**< option to read */
+    unsigned int* arg)                 /**< output value */
+{
+    struct PINT_tcache_shard* shard = &shards->shards[0];
+    int ret;
+    int i;
+
+    if(option == TCACHE_NUM_ENTRIES)
+    {
+        *arg = 0;
+        for(i = 0; i < shards->shard_count; i++)
+        {
+            *arg += shards->shards[i].tcache->num_entries;
+        }
+        return(0);
+    }
+
+    gen_mutex_lock(&shard->mutex);
+    ret = PINT_tcache_get_info(shard->tcache, option, arg);
+    gen_mutex_unlock(&shard->mutex);
+    if(ret == 0 &&
+       (option == TCACHE_HARD_LIMIT || option == TCACHE_SOFT_LIMIT))
+    {
+        *arg *= shards->shard_count;
+    }
+    return(ret);
+}
+
+/**
+ * Sets optional parameters on every shard of a sharded tcache instance.
+ * Limits are given for the cache as a whole and divided among the shards.
+ * @see PINT_tcache_options
+ * @return 0 on success, -PVFS_error on failure
+ */
+int PINT_tcache_shards_set_info(
+    struct PINT_tcache_shards* shards, /**< sharded tcache instance */
+    enum PINT_tcache_options option,   /**< option to modify */
+    unsigned int arg)                  /**< input value */
+{
+    struct PINT_tcache_shard* shard;
+    int ret = 0;
+    int i;
+
+    if(option == TCACHE_HARD_LIMIT || option == TCACHE_SOFT_LIMIT)
+    {
+        if(arg < 1)
+        {
+            return(-PVFS_EINVAL);
+        }
+        arg = (arg + shards->shard_count - 1) / shards->shard_count;
+    }
+
+    for(i = 0; i < shards->shard_count && ret == 0; i++)
+    {
+        shard = &shards->shards[i];
+        gen_mutex_lock(&shard->mutex);
+        ret = PINT_tcache_set_info(shard->tcache, option, arg);
+        gen_mutex_unlock(&shard->mutex);
+    }
+    return(ret);
+}
+
+/**
+ * Locks and returns the shard that holds the given key.  The caller uses
+ * the shard's tcache as an ordinary tcache until it calls
+ * PINT_tcache_shard_unlock().
+ */
+struct PINT_tcache_shard* PINT_tcache_shard_lock(
+    struct PINT_tcache_shards* shards, /**< sharded tcache instance */
+    const void* key)                   /**< key to be looked up */
+{
+    struct PINT_tcache_shard* shard;
+
+    shard = &shards->shards[shards->hash_key(key, shards->shard_count)];
+    gen_mutex_lock(&shard->mutex);
+    return(shard);
+}
+
+/**
+ * Unlocks a shard.  Every TCACHE_SHARD_FOLD_INTERVAL events the shard's
+ * counts are added to the instance's perf counter, after the shard lock
+ * has been dropped.
+ */
+void PINT_tcache_shard_unlock(
+    struct PINT_tcache_shards* shards, /**< sharded tcache instance */
+    struct PINT_tcache_shard* shard)   /**< shard returned by lock */
+{
+    int64_t counts[TCACHE_SHARD_MAX_KEYS];
+    int i;
+
+    if(shard->pending < TCACHE_SHARD_FOLD_INTERVAL)
+    {
+        gen_mutex_unlock(&shard->mutex);
+        return;
+    }
+
+    memcpy(counts, shard->counts, sizeof(counts));
+    memset(shard->counts, 0, sizeof(shard->counts));
+    shard->pending = 0;
+    gen_mutex_unlock(&shard->mutex);
+
+    for(i = 0; i < TCACHE_SHARD_MAX_KEYS; i++)
+    {
+        if(counts[i])
+        {
+            PINT_perf_count(shards->pc, i, counts[i], PINT_PERF_ADD);
+        }
+    }
+}
+
+/**
+ * Adds to a perf counter key of the instance.  The caller must hold the
+ * shard lock; the count reaches the perf counter when the shard is
+ * unlocked at the end of the next fold interval.
+ */
+void PINT_tcache_shard_count(
+    struct PINT_tcache_shard* shard, /**< locked shard */
+    int key,                         /**< perf counter key */
+    int64_t value)                   /**< amount to add */
+{
+    assert(key >= 0 && key < TCACHE_SHARD_MAX_KEYS);
+    shard->counts[key] += value;
+    shard->pending++;
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
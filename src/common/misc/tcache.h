@@ -15,9 +15,12 @@
 # include "wincommon.h"
 #endif
 #include "pvfs2-types.h"
+#include "gen-locks.h"
 #include "quicklist.h"
 #include "quickhash.h"
 
+struct PINT_perf_counter;
+
 
 /** \defgroup tcache Timeout Cache (tcache)
  *
@@ -67,6 +70,12 @@
  * - must be provided comparison function to search for cache entries
  * - must be provided hash function to index cache entries
  * .
+ * A sharded tcache (PINT_tcache_shards_initialize()) splits the entries
+ * among several tcache instances by key hash, each with its own mutex, so
+ * that threads looking up different keys do not serialize on one lock.
+ * Limits are divided evenly among the shards and each shard reclaims its
+ * own expired entries when it reaches its share of the soft limit.
+ * .
  *
  * @{
  */
@@ -185,6 +194,63 @@ int PINT_tcache_refresh_entry(
     struct PINT_tcache* tcache,
     struct PINT_tcache_entry* entry);
 
+/** default number of shards in a sharded tcache */
+#define TCACHE_DEFAULT_SHARD_COUNT 16
+/** perf counter keys below this can be counted per shard */
+#define TCACHE_SHARD_MAX_KEYS 16
+
+/** One shard of a sharded tcache */
+struct PINT_tcache_shard
+{
+    gen_mutex_t mutex;            /**< protects everything below */
+    struct PINT_tcache* tcache;   /**< entries whose keys hash here */
+    int64_t counts[TCACHE_SHARD_MAX_KEYS]; /**< not yet in perf counter */
+    unsigned int pending;         /**< events since counts were added */
+};
+
+/** Describes a sharded tcache instance */
+struct PINT_tcache_shards
+{
+    /** hash function, also used to pick the shard */
+    int (*hash_key)(const void* key, int table_size);
+    /** perf counter that shard counts are added to, may be NULL */
+    struct PINT_perf_counter* pc;
+    int shard_count;
+    struct PINT_tcache_shard* shards;
+};
+
+struct PINT_tcache_shards* PINT_tcache_shards_initialize(
+    int (*compare_key_entry) (const void *key, struct qhash_head* link),
+    int (*hash_key) (const void *key, int table_size),
+    int (*free_payload) (void* payload),
+    int table_size,
+    int shard_count);
+
+void PINT_tcache_shards_finalize(struct PINT_tcache_shards* shards);
+
+int PINT_tcache_shards_get_info(
+    struct PINT_tcache_shards* shards,
+    enum PINT_tcache_options option,
+    unsigned int* arg);
+
+int PINT_tcache_shards_set_info(
+    struct PINT_tcache_shards* shards,
+    enum PINT_tcache_options option,
+    unsigned int arg);
+
+struct PINT_tcache_shard* PINT_tcache_shard_lock(
+    struct PINT_tcache_shards* shards,
+    const void* key);
+
+void PINT_tcache_shard_unlock(
+    struct PINT_tcache_shards* shards,
+    struct PINT_tcache_shard* shard);
+
+void PINT_tcache_shard_count(
+    struct PINT_tcache_shard* shard,
+    int key,
+    int64_t value);
+
 #endif /* __TCACHE_H */
 
 /* @} */
@@ -578,6 +578,69 @@ int PINT_server_to_server_capability(PVFS_capability *capability,
     return 0;
 }
 
+/*  PINT_forward_capability
+ *
+ *  Reissues cap under this server's name, for a request the server
+ *  passes on to another one.  The copy carries the same rights, handles
+ *  and expiry as cap, plus PINT_CAP_SERVER.  A null capability is
+ *  copied as it is.
+ *
+ *  returns 0 on success
+ *  returns negative on error
+ */
+int PINT_forward_capability(PVFS_capability *capability,
+                            const PVFS_capability *cap)
+{
+    server_configuration_s *config = PINT_server_config_mgr_get_config();
+    PVFS_time remaining;
+    int ret;
+
+    if (PINT_capability_is_null(cap))
+    {
+        return PINT_copy_capability(cap, capability);
+    }
+
+    ret = PINT_init_capability(capability);
+    if (ret < 0)
+    {
+        return -PVFS_ENOMEM;
+    }
+
+    capability->issuer = (char *) malloc(strlen(config->server_alias) + 3);
+    if (capability->issuer == NULL)
+    {
+        PINT_cleanup_capability(capability);
+        return -PVFS_ENOMEM;
+    }
+    strcpy(capability->issuer, "S:");
+    strcat(capability->issuer, config->server_alias);
+
+    if (cap->num_handles)
+    {
+        capability->handle_array = (PVFS_handle *)
+            malloc(cap->num_handles * sizeof(PVFS_handle));
+        if (capability->handle_array == NULL)
+        {
+            PINT_cleanup_capability(capability);
+            return -PVFS_ENOMEM;
+        }
+        memcpy(capability->handle_array, cap->handle_array,
+               cap->num_handles * sizeof(PVFS_handle));
+    }
+    capability->num_handles = cap->num_handles;
+    capability->fsid = cap->fsid;
+    capability->op_mask = cap->op_mask | PINT_CAP_SERVER;
+
+    remaining = cap->timeout - PINT_util_get_current_time();
+    ret = PINT_sign_capability(capability, &remaining);
+    if (ret < 0)
+    {
+        PINT_cleanup_capability(capability);
+        return -PVFS_EINVAL;
+    }
+    return 0;
+}
+
 /*  PINT_verify_capability
  *
  *  Takes in a PVFS_capability structure and checks to see if the
@@ -29,6 +29,8 @@
 #define PINT_CAP_BATCH_CREATE (1 << 7)
 /* permission to remove multiple objects */
 #define PINT_CAP_BATCH_REMOVE (1 << 8)
+/* set only in capabilities that servers issue each other */
+#define PINT_CAP_SERVER       (1U << 31)
 
 #ifdef WIN32
 #define PINT_SECURITY_CHECK(rc, label, format, ...) \
@@ -140,6 +142,8 @@ int PINT_server_to_server_capability(PVFS_capability *capability,
                                      PVFS_fs_id fs_id,
                                      int num_handles,
                                      PVFS_handle *handle_array);
+int PINT_forward_capability(PVFS_capability *capability,
+                            const PVFS_capability *cap);
 
 
 int PINT_init_credential(PVFS_credential *cred);
@@ -99,6 +99,55 @@ int PINT_server_to_server_capability(PVFS_capability *capability,
     return 0;
 }
 
+int PINT_forward_capability(PVFS_capability *capability,
+                            const PVFS_capability *cap)
+{
+    server_configuration_s *config = PINT_server_config_mgr_get_config();
+    PVFS_time remaining;
+    int ret;
+
+    if (PINT_capability_is_null(cap))
+    {
+        return PINT_copy_capability(cap, capability);
+    }
+
+    ret = PINT_init_capability(capability);
+    if (ret < 0)
+    {
+        return -PVFS_ENOMEM;
+    }
+
+    capability->issuer = (char *) malloc(strlen(config->server_alias) + 3);
+    if (capability->issuer == NULL)
+    {
+        PINT_cleanup_capability(capability);
+        return -PVFS_ENOMEM;
+    }
+    strcpy(capability->issuer, "S:");
+    strcat(capability->issuer, config->server_alias);
+
+    if (cap->num_handles)
+    {
+        capability->handle_array = (PVFS_handle *)
+            malloc(cap->num_handles * sizeof(PVFS_handle));
+        if (capability->handle_array == NULL)
+        {
+            PINT_cleanup_capability(capability);
+            return -PVFS_ENOMEM;
+        }
+        memcpy(capability->handle_array, cap->handle_array,
+               cap->num_handles * sizeof(PVFS_handle));
+    }
+    capability->num_handles = cap->num_handles;
+    capability->fsid = cap->fsid;
+    capability->op_mask = cap->op_mask | PINT_CAP_SERVER;
+
+    /* the stub only stamps the timeout; it cannot fail */
+    remaining = cap->timeout - PINT_util_get_current_time();
+    PINT_sign_capability(capability, &remaining);
+    return 0;
+}
+
 int PINT_verify_capability(const PVFS_capability *cap)
 {
     struct server_configuration_s *config = PINT_server_config_mgr_get_config();
@@ -77,6 +77,9 @@ struct drop_item
 #ifdef __STATIC_METHOD_BMI_TCP__
 extern struct bmi_method_ops bmi_tcp_ops;
 #endif
+#ifdef __STATIC_METHOD_BMI_SHM__
+extern struct bmi_method_ops bmi_shm_ops;
+#endif
 #ifdef __STATIC_METHOD_BMI_GM__
 extern struct bmi_method_ops bmi_gm_ops;
 #endif
@@ -97,6 +100,9 @@ static struct bmi_method_ops *const static_methods[] = {
 #ifdef __STATIC_METHOD_BMI_TCP__
     &bmi_tcp_ops,
 #endif
+#ifdef __STATIC_METHOD_BMI_SHM__
+    &bmi_shm_ops,
+#endif
 #ifdef __STATIC_METHOD_BMI_GM__
     &bmi_gm_ops,
 #endif
@@ -1667,6 +1673,20 @@ int BMI_get_info(BMI_addr_t addr,
             }
             break;
 
+        case BMI_GET_METHOD_NAME:
+            gen_mutex_lock(&ref_mutex);
+            tmp_ref = ref_list_search_addr(cur_ref_list, addr);
+            if (!tmp_ref)
+            {
+                gen_mutex_unlock(&ref_mutex);
+                return (bmi_errno_to_pvfs(-EINVAL));
+            }
+            gen_mutex_unlock(&ref_mutex);
+            /* skip the "bmi_" prefix of the module name */
+            *((const char **) inout_parameter) =
+                tmp_ref->interface->method_name + 4;
+            break;
+
         case BMI_TRANSPORT_METHODS_STRING:
             {
             /*
@@ -1825,8 +1845,10 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
 {
     ref_st_p new_ref = NULL;
     bmi_method_addr_p meth_addr = NULL;
+    const char *id_entry = NULL;
     int ret = -1;
     int i = 0;
+    int k = 0;
     int failed;
 
     gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "BMI_addr_lookup: %s\n", id_string);
@@ -1854,63 +1876,78 @@ int BMI_addr_lookup(BMI_addr_t * new_addr,
     gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "\taddr not found, go to methods\n");
 
     /* Now we will run through each method looking for one that
-     * responds successfully.  It is assumed that they are already
-     * listed in order of preference
+     * responds successfully.  Methods named in the address string are
+     * tried in the order they appear there, so "shm://h:p,tcp://h:p"
+     * prefers shm and falls back to tcp when shm declines the address.
      */
-    i = 0;
+    failed = 0;
     gen_mutex_lock(&active_method_count_mutex);
-    while ((i < active_method_count) &&
-           !(meth_addr = active_method_table[i]->method_addr_lookup(id_string)))
+    id_entry = id_string;
+    while (!meth_addr && id_entry && *id_entry)
     {
-        gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, 
-                     "\tLooking up in active method\n");
-        i++;
-    }
+        for (k = 0; k < known_method_count; k++)
+        {
+            /* well-known that mapping is "x" -> "bmi_x" */
+            const char *name = known_method_table[k]->method_name + 4;
+            if (!strncmp(id_entry, name, strlen(name)))
+            {
+                break;
+            }
+        }
+        id_entry = strchr(id_entry, ',');
+        if (id_entry)
+        {
+            id_entry++;
+        }
+        if (k == known_method_count)
+        {
+            continue;
+        }
 
-    /* if not found, try to bring it up now */
-    failed = 0;
-    if (!meth_addr)
-    {
-        for (i = 0; i < known_method_count; i++)
+        for (i = 0; i < active_method_count; i++)
         {
-            const char *name;
-            /* only bother with those not active */
-            int j;
-            for (j = 0; j < active_method_count; j++)
+            if (known_method_table[k] == active_method_table[i])
             {
-                if (known_method_table[i] == active_method_table[j])
-                {
-                    break;
-                }
+                break;
             }
-            if (j < active_method_count)
+        }
+        if (i == active_method_count)
+        {
+            /* bring it up now */
+            gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "\tActivating method\n");
+            ret = activate_method(known_method_table[k]->method_name,
+                                  0,
+                                  0,
+                                  bmi_opts);
+            if (ret < 0)
             {
+                failed = 1;
                 continue;
             }
+            i = active_method_count - 1;  /* point at the new one */
+        }
 
-            /* well-known that mapping is "x" -> "bmi_x" */
-            name = known_method_table[i]->method_name + 4;
-            if (!strncmp(id_string, name, strlen(name)))
-            {
-                gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "\tActivating method\n");
-                ret = activate_method(known_method_table[i]->method_name,
-                                      0,
-                                      0,
-                                      bmi_opts);
-                if (ret < 0)
-                {
-                    failed = 1;
-                    break;
-                }
-                gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, 
-                             "\tLooking up in method\n");
-                meth_addr = known_method_table[i]->
-                                    method_addr_lookup(id_string);
-                i = active_method_count - 1;  /* point at the new one */
-                break;
-            }
+        gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, "\tLooking up in method\n");
+        meth_addr = active_method_table[i]->method_addr_lookup(id_string);
+    }
+
+    /* fall back to any active method that recognizes the string */
+    if (!meth_addr)
+    {
+        i = 0;
+        while ((i < active_method_count) &&
+               !(meth_addr = 
+                    active_method_table[i]->method_addr_lookup(id_string)))
+        {
+            gossip_debug(GOSSIP_BMI_DEBUG_CONTROL, 
+                         "\tLooking up in active method\n");
+            i++;
         }
     }
+    if (meth_addr)
+    {
+        failed = 0;
+    }
     gen_mutex_unlock(&active_method_count_mutex);
     if (failed)
     {
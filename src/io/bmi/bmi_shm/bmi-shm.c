@@ -0,0 +1,3078 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Shared memory implementation of a BMI method, for clients and servers
+ * that run on the same node.
+ *
+ * Each connection is a memfd segment holding two single producer / single
+ * consumer byte rings (one per direction).  A unix domain socket is kept
+ * alongside the segment; it carries the handshake (file descriptors are
+ * passed with SCM_RIGHTS), wakes a peer that is blocked in poll(), and
+ * reports peer death through EOF.
+ *
+ * Small and unexpected messages are copied inline through the ring.
+ * Larger messages are described by an (offset, length) pair into the
+ * sender's buffer arena, which every peer maps read-only; the receiver
+ * copies straight out of the arena into the posted buffer and returns an
+ * ACK frame so the sender can complete.  Buffers obtained through
+ * BMI_memalloc() live in the arena already and are never staged, so they
+ * cross the process boundary with the single copy that BMI receive
+ * semantics require.
+ *
+ * Addresses look like shm://host:port.  Lookups only succeed when host is
+ * this node and a server answers on the port, so an address string such
+ * as "shm://host:3334,tcp://host:3334" falls through to bmi_tcp for
+ * remote peers.
+ */
+
+#include "pvfs2-internal.h"
+
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <assert.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/time.h>
+
+#include "bmi-method-support.h"
+#include "bmi-method-callback.h"
+#include "op-list.h"
+#include "gossip.h"
+#include "id-generator.h"
+#include "pvfs2-debug.h"
+#include "gen-locks.h"
+#include "pint-hint.h"
+#include "quicklist.h"
+
+static gen_mutex_t interface_mutex = GEN_MUTEX_INITIALIZER;
+static gen_cond_t interface_cond = GEN_COND_INITIALIZER;
+static int poll_busy = 0;
+
+/* function prototypes */
+int BMI_shm_initialize(bmi_method_addr_p listen_addr,
+                       int method_id,
+                       int init_flags,
+                       char *options);
+
+int BMI_shm_finalize(void);
+
+int BMI_shm_set_info(int option,
+                     void *inout_parameter);
+
+int BMI_shm_get_info(int option,
+                     void *inout_parameter);
+
+void *BMI_shm_memalloc(bmi_size_t size,
+                       enum bmi_op_type send_recv);
+
+int BMI_shm_memfree(void *buffer,
+                    bmi_size_t size,
+                    enum bmi_op_type send_recv);
+
+int BMI_shm_unexpected_free(void *buffer);
+
+int BMI_shm_post_send(bmi_op_id_t *id,
+                      bmi_method_addr_p dest,
+                      const void *buffer,
+                      bmi_size_t size,
+                      enum bmi_buffer_type buffer_type,
+                      bmi_msg_tag_t tag,
+                      void *user_ptr,
+                      bmi_context_id context_id,
+                      PVFS_hint hints);
+
+int BMI_shm_post_sendunexpected(bmi_op_id_t *id,
+                                bmi_method_addr_p dest,
+                                const void *buffer,
+                                bmi_size_t size,
+                                enum bmi_buffer_type buffer_type,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id,
+                                PVFS_hint hints);
+
+int BMI_shm_post_recv(bmi_op_id_t *id,
+                      bmi_method_addr_p src,
+                      void *buffer,
+                      bmi_size_t expected_size,
+                      bmi_size_t *actual_size,
+                      enum bmi_buffer_type buffer_type,
+                      bmi_msg_tag_t tag,
+                      void *user_ptr,
+                      bmi_context_id context_id,
+                      PVFS_hint hints);
+
+int BMI_shm_test(bmi_op_id_t id,
+                 int *outcount,
+                 bmi_error_code_t *error_code,
+                 bmi_size_t *actual_size,
+                 void **user_ptr,
+                 int max_idle_time_ms,
+                 bmi_context_id context_id);
+
+int BMI_shm_testsome(int incount,
+                     bmi_op_id_t *id_array,
+                     int *outcount,
+                     int *index_array,
+                     bmi_error_code_t *error_code_array,
+                     bmi_size_t *actual_size_array,
+                     void **user_ptr_array,
+                     int max_idle_time_ms,
+                     bmi_context_id context_id);
+
+int BMI_shm_testunexpected(int incount,
+                           int *outcount,
+                           struct bmi_method_unexpected_info *info,
+                           int max_idle_time_ms);
+
+int BMI_shm_testcontext(int incount,
+                        bmi_op_id_t *out_id_array,
+                        int *outcount,
+                        bmi_error_code_t *error_code_array,
+                        bmi_size_t *actual_size_array,
+                        void **user_ptr_array,
+                        int max_idle_time_ms,
+                        bmi_context_id context_id);
+
+bmi_method_addr_p BMI_shm_method_addr_lookup(const char *id_string);
+
+const char *BMI_shm_addr_rev_lookup_unexpected(bmi_method_addr_p map);
+
+int BMI_shm_query_addr_range(bmi_method_addr_p map,
+                             const char *wildcard_string,
+                             int netmask);
+
+int BMI_shm_post_send_list(bmi_op_id_t *id,
+                           bmi_method_addr_p dest,
+                           const void *const *buffer_list,
+                           const bmi_size_t *size_list,
+                           int list_count,
+                           bmi_size_t total_size,
+                           enum bmi_buffer_type buffer_type,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints);
+
+int BMI_shm_post_recv_list(bmi_op_id_t *id,
+                           bmi_method_addr_p src,
+                           void *const *buffer_list,
+                           const bmi_size_t *size_list,
+                           int list_count,
+                           bmi_size_t total_expected_size,
+                           bmi_size_t *total_actual_size,
+                           enum bmi_buffer_type buffer_type,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints);
+
+int BMI_shm_post_sendunexpected_list(bmi_op_id_t *id,
+                                     bmi_method_addr_p dest,
+                                     const void *const *buffer_list,
+                                     const bmi_size_t *size_list,
+                                     int list_count,
+                                     bmi_size_t total_size,
+                                     enum bmi_buffer_type buffer_type,
+                                     bmi_msg_tag_t tag,
+                                     void *user_ptr,
+                                     bmi_context_id context_id,
+                                     PVFS_hint hints);
+
+int BMI_shm_open_context(bmi_context_id context_id);
+
+void BMI_shm_close_context(bmi_context_id context_id);
+
+int BMI_shm_cancel(bmi_op_id_t id,
+                   bmi_context_id context_id);
+
+char BMI_shm_method_name[] = "bmi_shm";
+
+const struct bmi_method_ops bmi_shm_ops = {
+    .method_name = BMI_shm_method_name,
+    .initialize = BMI_shm_initialize,
+    .finalize = BMI_shm_finalize,
+    .set_info = BMI_shm_set_info,
+    .get_info = BMI_shm_get_info,
+    .memalloc = BMI_shm_memalloc,
+    .memfree  = BMI_shm_memfree,
+    .unexpected_free = BMI_shm_unexpected_free,
+    .post_send = BMI_shm_post_send,
+    .post_sendunexpected = BMI_shm_post_sendunexpected,
+    .post_recv = BMI_shm_post_recv,
+    .test = BMI_shm_test,
+    .testsome = BMI_shm_testsome,
+    .testcontext = BMI_shm_testcontext,
+    .testunexpected = BMI_shm_testunexpected,
+    .method_addr_lookup = BMI_shm_method_addr_lookup,
+    .post_send_list = BMI_shm_post_send_list,
+    .post_recv_list = BMI_shm_post_recv_list,
+    .post_sendunexpected_list = BMI_shm_post_sendunexpected_list,
+    .open_context = BMI_shm_open_context,
+    .close_context = BMI_shm_close_context,
+    .cancel = BMI_shm_cancel,
+    .rev_lookup_unexpected = BMI_shm_addr_rev_lookup_unexpected,
+    .query_addr_range = BMI_shm_query_addr_range,
+};
+
+/* sizes of the shared regions; the ring size must be a power of two */
+#define BMI_SHM_RING_SIZE (256 * 1024)
+#define BMI_SHM_ARENA_SIZE (64 * 1024 * 1024)
+#define BMI_SHM_ARENA_ALIGN 64
+
+/* how long a connecting client waits for the listener to answer */
+#define BMI_SHM_CONNECT_TIMEOUT_MS 5000
+
+/* abstract unix socket name a server listens on, followed by the port */
+#define BMI_SHM_SOCKET_PREFIX "pvfs2-bmi-shm:"
+
+#define BMI_SHM_PROTO_VERSION 1
+
+/* Allowable sizes for each mode */
+enum
+{
+    SHM_MODE_EAGER_LIMIT = 16384,       /* 16K */
+    SHM_MODE_REND_LIMIT = 16777216      /* 16M */
+};
+
+/* frame types carried on the rings */
+enum shm_frame_type
+{
+    SHM_FRAME_EAGER = 1,    /* payload follows inline */
+    SHM_FRAME_UNEXP = 2,    /* unexpected message, payload inline */
+    SHM_FRAME_REND = 3,     /* payload lives in the sender's arena */
+    SHM_FRAME_ACK = 4       /* receiver is done with a REND payload */
+};
+
+struct shm_frame
+{
+    uint32_t type;
+    uint32_t inline_len;    /* bytes of payload following the frame */
+    bmi_msg_tag_t tag;
+    uint32_t pad;
+    int64_t size;           /* total message size */
+    uint64_t offset;        /* REND: payload offset in sender arena */
+    uint64_t cookie;        /* REND/ACK: matches an ACK to its send */
+};
+
+#define SHM_ALIGN8(x) (((x) + 7) & ~((uint64_t)7))
+
+/* One direction of a connection.  The producer owns tail and the consumer
+ * owns head and waiting; they sit on separate cache lines so neither side
+ * bounces the other's line while streaming.
+ */
+struct shm_ring
+{
+    uint64_t tail;
+    char pad0[56];
+    uint64_t head;
+    uint32_t waiting;       /* consumer is (about to be) blocked in poll */
+    char pad1[52];
+    char data[BMI_SHM_RING_SIZE];
+};
+
+/* first message on a new socket, in both directions */
+struct shm_hello
+{
+    uint32_t magic_nr;
+    uint32_t version;
+    uint64_t ring_size;
+    uint64_t arena_size;
+    int32_t pid;
+    int32_t pad;
+};
+
+enum shm_conn_state
+{
+    SHM_CONN_ACCEPTED = 1,  /* server side, waiting for the client hello */
+    SHM_CONN_CONNECTING,    /* client side, waiting for the server hello */
+    SHM_CONN_READY
+};
+
+struct shm_conn
+{
+    struct qlist_head link;         /* shm_conn_list */
+    int state;
+    int sock;
+    bmi_method_addr_p map;          /* NULL until an accepted peer says hello */
+    char *seg;
+    size_t seg_size;
+    struct shm_ring *tx;
+    struct shm_ring *rx;
+    char *peer_arena;
+    uint64_t peer_arena_size;
+    int peer_pid;
+    uint64_t next_cookie;
+    op_list_p send_queue;           /* sends not yet placed on the ring */
+    op_list_p recv_queue;           /* posted receives */
+    op_list_p early_queue;          /* arrivals with no posted receive */
+    struct qlist_head inflight;     /* REND sends waiting on an ACK */
+    struct qlist_head acks;         /* ACKs that did not fit in the ring */
+};
+
+struct shm_addr
+{
+    char *hostname;
+    int port;
+    int accepted;                   /* created by the listener */
+    struct shm_conn *conn;
+    BMI_addr_t bmi_addr;
+    char peer_string[64];
+};
+
+enum shm_op_state
+{
+    SHM_OP_QUEUED = 1,
+    SHM_OP_INFLIGHT,
+    SHM_OP_EARLY,
+    SHM_OP_COMPLETE
+};
+
+struct shm_inflight
+{
+    struct qlist_head link;
+    uint64_t cookie;
+    uint64_t offset;
+    uint64_t len;
+    int staged;                     /* arena chunk belongs to the method */
+    method_op_p op;                 /* NULL once cancelled */
+};
+
+struct shm_ack
+{
+    struct qlist_head link;
+    uint64_t cookie;
+};
+
+struct shm_op
+{
+    int state;
+    int frame_type;
+    struct shm_conn *conn;
+    struct shm_inflight *inflight;
+    /* early REND arrivals keep their descriptor here */
+    uint64_t offset;
+    uint64_t cookie;
+};
+
+/* the process wide buffer arena */
+struct shm_extent
+{
+    struct qlist_head link;
+    uint64_t offset;
+    uint64_t len;
+};
+
+static struct
+{
+    int fd;
+    char *base;
+    uint64_t size;
+    struct qlist_head free_list;    /* sorted by offset */
+} shm_arena = { -1, NULL, 0, QLIST_HEAD_INIT(shm_arena.free_list) };
+
+/* memalloc/memfree are called without interface_mutex */
+static gen_mutex_t arena_mutex = GEN_MUTEX_INITIALIZER;
+
+/* module parameters */
+static struct
+{
+    int initialized;
+    int method_flags;
+    int method_id;
+    int listen_sock;
+    bmi_method_addr_p listen_addr;
+} shm_method_params = { 0, 0, -1, -1, NULL };
+
+static QLIST_HEAD(shm_conn_list);
+static op_list_p completion_array[BMI_MAX_CONTEXTS] = { NULL };
+static op_list_p unexp_list = NULL;
+static int forceful_cancel_mode = 0;
+static struct pollfd *poll_array = NULL;
+static int poll_array_size = 0;
+
+static bmi_method_addr_p alloc_shm_method_addr(const char *hostname,
+                                               int port);
+static void dealloc_shm_method_addr(bmi_method_addr_p map);
+static int shm_conn_connect(bmi_method_addr_p map);
+static void shm_conn_close(struct shm_conn *conn, int error_code);
+static int shm_do_work(int max_idle_time_ms);
+static int shm_post_send_generic(bmi_op_id_t *id,
+                                 bmi_method_addr_p dest,
+                                 const void *const *buffer_list,
+                                 const bmi_size_t *size_list,
+                                 int list_count,
+                                 bmi_size_t total_size,
+                                 bmi_msg_tag_t tag,
+                                 void *user_ptr,
+                                 bmi_context_id context_id,
+                                 int frame_type);
+static int shm_post_recv_generic(bmi_op_id_t *id,
+                                 bmi_method_addr_p src,
+                                 void *const *buffer_list,
+                                 const bmi_size_t *size_list,
+                                 int list_count,
+                                 bmi_size_t expected_size,
+                                 bmi_size_t *actual_size,
+                                 bmi_msg_tag_t tag,
+                                 void *user_ptr,
+                                 bmi_context_id context_id);
+
+
+/******************************************************************
+ * buffer arena
+ */
+
+/* shm_arena_alloc()
+ *
+ * first fit allocation out of the arena free list
+ *
+ * returns 0 on success, -ENOMEM if no extent is large enough
+ */
+static int shm_arena_alloc(uint64_t len, uint64_t *offset)
+{
+    struct shm_extent *ext = NULL;
+    int ret = -ENOMEM;
+
+    len = (len + BMI_SHM_ARENA_ALIGN - 1) & ~((uint64_t)BMI_SHM_ARENA_ALIGN - 1);
+    if (len == 0)
+    {
+        len = BMI_SHM_ARENA_ALIGN;
+    }
+
+    gen_mutex_lock(&arena_mutex);
+    qlist_for_each_entry(ext, &shm_arena.free_list, link)
+    {
+        if (ext->len >= len)
+        {
+            *offset = ext->offset;
+            ext->offset += len;
+            ext->len -= len;
+            if (ext->len == 0)
+            {
+                qlist_del(&ext->link);
+                free(ext);
+            }
+            ret = 0;
+            break;
+        }
+    }
+    gen_mutex_unlock(&arena_mutex);
+    return ret;
+}
+
+/* shm_arena_free()
+ *
+ * returns an extent to the free list, merging it with its neighbours
+ */
+static void shm_arena_free(uint64_t offset, uint64_t len)
+{
+    struct shm_extent *ext = NULL;
+    struct shm_extent *prev = NULL;
+    struct shm_extent *new_ext = NULL;
+    struct qlist_head *pos = NULL;
+
+    len = (len + BMI_SHM_ARENA_ALIGN - 1) & ~((uint64_t)BMI_SHM_ARENA_ALIGN - 1);
+    if (len == 0)
+    {
+        len = BMI_SHM_ARENA_ALIGN;
+    }
+
+    gen_mutex_lock(&arena_mutex);
+
+    /* find the first extent past the one being freed */
+    pos = &shm_arena.free_list;
+    qlist_for_each_entry(ext, &shm_arena.free_list, link)
+    {
+        if (ext->offset > offset)
+        {
+            pos = &ext->link;
+            break;
+        }
+        prev = ext;
+    }
+
+    if (prev && prev->offset + prev->len == offset)
+    {
+        prev->len += len;
+        new_ext = prev;
+    }
+    else
+    {
+        new_ext = (struct shm_extent *) malloc(sizeof(*new_ext));
+        if (!new_ext)
+        {
+            /* leak the extent rather than corrupt the list */
+            gossip_lerr("Error: out of memory freeing shm arena extent.\n");
+            gen_mutex_unlock(&arena_mutex);
+            return;
+        }
+        new_ext->offset = offset;
+        new_ext->len = len;
+        qlist_add_tail(&new_ext->link, pos);
+    }
+
+    /* merge with the following extent */
+    if (new_ext->link.next != &shm_arena.free_list)
+    {
+        ext = qlist_entry(new_ext->link.next, struct shm_extent, link);
+        if (new_ext->offset + new_ext->len == ext->offset)
+        {
+            new_ext->len += ext->len;
+            qlist_del(&ext->link);
+            free(ext);
+        }
+    }
+
+    gen_mutex_unlock(&arena_mutex);
+}
+
+static inline int shm_arena_contains(const void *buffer, bmi_size_t size)
+{
+    const char *ptr = (const char *) buffer;
+
+    return (shm_arena.base && ptr >= shm_arena.base &&
+            ptr + size <= shm_arena.base + shm_arena.size);
+}
+
+static int shm_arena_setup(void)
+{
+    struct shm_extent *ext = NULL;
+
+    shm_arena.fd = memfd_create("pvfs2-bmi-shm-arena", MFD_CLOEXEC);
+    if (shm_arena.fd < 0)
+    {
+        return -errno;
+    }
+    if (ftruncate(shm_arena.fd, BMI_SHM_ARENA_SIZE) < 0)
+    {
+        goto setup_failure;
+    }
+    shm_arena.base = mmap(NULL, BMI_SHM_ARENA_SIZE, PROT_READ | PROT_WRITE,
+                          MAP_SHARED, shm_arena.fd, 0);
+    if (shm_arena.base == MAP_FAILED)
+    {
+        shm_arena.base = NULL;
+        goto setup_failure;
+    }
+    shm_arena.size = BMI_SHM_ARENA_SIZE;
+
+    ext = (struct shm_extent *) malloc(sizeof(*ext));
+    if (!ext)
+    {
+        errno = ENOMEM;
+        goto setup_failure;
+    }
+    ext->offset = 0;
+    ext->len = shm_arena.size;
+    qlist_add_tail(&ext->link, &shm_arena.free_list);
+    return 0;
+
+  setup_failure:
+    {
+        int tmp_errno = errno;
+
+        if (shm_arena.base)
+        {
+            munmap(shm_arena.base, BMI_SHM_ARENA_SIZE);
+            shm_arena.base = NULL;
+        }
+        close(shm_arena.fd);
+        shm_arena.fd = -1;
+        return -tmp_errno;
+    }
+}
+
+static void shm_arena_teardown(void)
+{
+    struct shm_extent *ext = NULL;
+    struct shm_extent *tmp = NULL;
+
+    qlist_for_each_entry_safe(ext, tmp, &shm_arena.free_list, link)
+    {
+        qlist_del(&ext->link);
+        free(ext);
+    }
+    if (shm_arena.base)
+    {
+        munmap(shm_arena.base, shm_arena.size);
+        shm_arena.base = NULL;
+    }
+    if (shm_arena.fd >= 0)
+    {
+        close(shm_arena.fd);
+        shm_arena.fd = -1;
+    }
+    shm_arena.size = 0;
+}
+
+
+/******************************************************************
+ * rings
+ */
+
+static void shm_ring_write(struct shm_ring *ring,
+                           uint64_t pos,
+                           const void *src,
+                           uint64_t len)
+{
+    uint64_t off = pos & (BMI_SHM_RING_SIZE - 1);
+    uint64_t first = BMI_SHM_RING_SIZE - off;
+
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(ring->data + off, src, first);
+    if (len > first)
+    {
+        memcpy(ring->data, (const char *) src + first, len - first);
+    }
+}
+
+static void shm_ring_read(struct shm_ring *ring,
+                          uint64_t pos,
+                          void *dest,
+                          uint64_t len)
+{
+    uint64_t off = pos & (BMI_SHM_RING_SIZE - 1);
+    uint64_t first = BMI_SHM_RING_SIZE - off;
+
+    if (first > len)
+    {
+        first = len;
+    }
+    memcpy(dest, ring->data + off, first);
+    if (len > first)
+    {
+        memcpy((char *) dest + first, ring->data, len - first);
+    }
+}
+
+/* shm_ring_push()
+ *
+ * places one frame, plus the gathered payload for inline frames, on the
+ * outgoing ring.  Only one thread produces on a ring at a time (callers
+ * hold interface_mutex), so the tail is read relaxed.
+ *
+ * returns 1 if the frame was published, 0 if the ring is full
+ */
+static int shm_ring_push(struct shm_conn *conn,
+                         const struct shm_frame *frame,
+                         const void *const *buffer_list,
+                         const bmi_size_t *size_list,
+                         int list_count)
+{
+    struct shm_ring *ring = conn->tx;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t needed = SHM_ALIGN8(sizeof(*frame) + frame->inline_len);
+    uint64_t pos = tail;
+    uint64_t left = frame->inline_len;
+    char c = 0;
+    int i;
+
+    if (BMI_SHM_RING_SIZE - (tail - head) < needed)
+    {
+        return 0;
+    }
+
+    shm_ring_write(ring, pos, frame, sizeof(*frame));
+    pos += sizeof(*frame);
+    for (i = 0; i < list_count && left > 0; i++)
+    {
+        uint64_t len = size_list[i] < (bmi_size_t) left ?
+            (uint64_t) size_list[i] : left;
+        shm_ring_write(ring, pos, buffer_list[i], len);
+        pos += len;
+        left -= len;
+    }
+
+    __atomic_store_n(&ring->tail, tail + needed, __ATOMIC_RELEASE);
+
+    /* pairs with the fence in shm_wait(): either the consumer sees the new
+     * tail before it sleeps, or we see its waiting flag and kick it
+     */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->waiting, __ATOMIC_RELAXED))
+    {
+        send(conn->sock, &c, 1, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+    return 1;
+}
+
+static void shm_scatter(void *const *buffer_list,
+                        const bmi_size_t *size_list,
+                        int list_count,
+                        const char *src,
+                        bmi_size_t len)
+{
+    int i;
+
+    for (i = 0; i < list_count && len > 0; i++)
+    {
+        bmi_size_t chunk = size_list[i] < len ? size_list[i] : len;
+        memcpy(buffer_list[i], src, chunk);
+        src += chunk;
+        len -= chunk;
+    }
+}
+
+static void shm_gather(char *dest,
+                       const void *const *buffer_list,
+                       const bmi_size_t *size_list,
+                       int list_count,
+                       bmi_size_t len)
+{
+    int i;
+
+    for (i = 0; i < list_count && len > 0; i++)
+    {
+        bmi_size_t chunk = size_list[i] < len ? size_list[i] : len;
+        memcpy(dest, buffer_list[i], chunk);
+        dest += chunk;
+        len -= chunk;
+    }
+}
+
+static void shm_scatter_from_ring(struct shm_ring *ring,
+                                  uint64_t pos,
+                                  void *const *buffer_list,
+                                  const bmi_size_t *size_list,
+                                  int list_count,
+                                  bmi_size_t len)
+{
+    int i;
+
+    for (i = 0; i < list_count && len > 0; i++)
+    {
+        bmi_size_t chunk = size_list[i] < len ? size_list[i] : len;
+        shm_ring_read(ring, pos, buffer_list[i], chunk);
+        pos += chunk;
+        len -= chunk;
+    }
+}
+
+
+/******************************************************************
+ * operations
+ */
+
+static method_op_p alloc_shm_method_op(void)
+{
+    method_op_p op = bmi_alloc_method_op(sizeof(struct shm_op));
+
+    if (op)
+    {
+        /* single buffer ops use the list fields as well */
+        op->buffer_list = &op->buffer;
+        op->size_list = &op->expected_size;
+        op->list_count = 1;
+    }
+    return op;
+}
+
+static void dealloc_shm_method_op(method_op_p op)
+{
+    bmi_dealloc_method_op(op);
+}
+
+static void shm_op_complete(method_op_p op, int error_code)
+{
+    struct shm_op *shm_op_data = op->method_data;
+
+    op->error_code = error_code;
+    shm_op_data->state = SHM_OP_COMPLETE;
+    op_list_add(completion_array[op->context_id], op);
+}
+
+/* shm_send_ack()
+ *
+ * tells the peer it may reuse a REND payload; queued if the ring is full
+ */
+static void shm_send_ack(struct shm_conn *conn, uint64_t cookie)
+{
+    struct shm_frame frame;
+    struct shm_ack *ack = NULL;
+
+    memset(&frame, 0, sizeof(frame));
+    frame.type = SHM_FRAME_ACK;
+    frame.cookie = cookie;
+
+    if (qlist_empty(&conn->acks) && shm_ring_push(conn, &frame, NULL, NULL, 0))
+    {
+        return;
+    }
+
+    ack = (struct shm_ack *) malloc(sizeof(*ack));
+    if (!ack)
+    {
+        /* the sender will never complete; report it loudly */
+        gossip_lerr("Error: out of memory queueing shm ack.\n");
+        return;
+    }
+    ack->cookie = cookie;
+    qlist_add_tail(&ack->link, &conn->acks);
+}
+
+/* shm_deliver()
+ *
+ * copies an arrived message into a posted receive and completes it
+ */
+static void shm_deliver(struct shm_conn *conn,
+                        method_op_p recv_op,
+                        bmi_size_t size,
+                        const char *payload,
+                        uint64_t ring_pos)
+{
+    bmi_size_t copy_size = size;
+    int error_code = 0;
+
+    if (size > recv_op->expected_size)
+    {
+        gossip_err("Error: shm message of %lld bytes overflows %lld byte "
+                   "receive buffer.\n", lld(size),
+                   lld(recv_op->expected_size));
+        copy_size = recv_op->expected_size;
+        error_code = bmi_errno_to_pvfs(-EMSGSIZE);
+    }
+
+    if (payload)
+    {
+        shm_scatter(recv_op->buffer_list, recv_op->size_list,
+                    recv_op->list_count, payload, copy_size);
+    }
+    else
+    {
+        shm_scatter_from_ring(conn->rx, ring_pos, recv_op->buffer_list,
+                              recv_op->size_list, recv_op->list_count,
+                              copy_size);
+    }
+    recv_op->actual_size = copy_size;
+    recv_op->amt_complete = copy_size;
+    shm_op_complete(recv_op, error_code);
+}
+
+/* shm_conn_push()
+ *
+ * moves queued ACKs and sends onto the outgoing ring, in order
+ *
+ * returns the number of frames published
+ */
+static int shm_conn_push(struct shm_conn *conn)
+{
+    struct shm_frame frame;
+    struct shm_ack *ack = NULL;
+    struct shm_ack *tmp_ack = NULL;
+    method_op_p op = NULL;
+    struct shm_op *shm_op_data = NULL;
+    struct shm_inflight *inflight = NULL;
+    int count = 0;
+
+    qlist_for_each_entry_safe(ack, tmp_ack, &conn->acks, link)
+    {
+        memset(&frame, 0, sizeof(frame));
+        frame.type = SHM_FRAME_ACK;
+        frame.cookie = ack->cookie;
+        if (!shm_ring_push(conn, &frame, NULL, NULL, 0))
+        {
+            return count;
+        }
+        qlist_del(&ack->link);
+        free(ack);
+        count++;
+    }
+
+    while ((op = op_list_shownext(conn->send_queue)))
+    {
+        shm_op_data = op->method_data;
+        memset(&frame, 0, sizeof(frame));
+        frame.type = shm_op_data->frame_type;
+        frame.tag = op->msg_tag;
+        frame.size = op->actual_size;
+
+        if (frame.type != SHM_FRAME_REND)
+        {
+            frame.inline_len = op->actual_size;
+            if (!shm_ring_push(conn, &frame, (const void *const *)
+                               op->buffer_list, op->size_list,
+                               op->list_count))
+            {
+                break;
+            }
+            op_list_remove(op);
+            op->amt_complete = op->actual_size;
+            shm_op_complete(op, 0);
+            count++;
+            continue;
+        }
+
+        if (!shm_op_data->inflight)
+        {
+            inflight = (struct shm_inflight *) malloc(sizeof(*inflight));
+            if (!inflight)
+            {
+                op_list_remove(op);
+                shm_op_complete(op, bmi_errno_to_pvfs(-ENOMEM));
+                continue;
+            }
+            memset(inflight, 0, sizeof(*inflight));
+            inflight->len = op->actual_size;
+
+            if (op->list_count == 1 &&
+                shm_arena_contains(op->buffer_list[0], op->actual_size))
+            {
+                /* BMI_memalloc'd buffer; the peer reads it in place */
+                inflight->offset = (const char *) op->buffer_list[0] -
+                    shm_arena.base;
+            }
+            else
+            {
+                if (shm_arena_alloc(op->actual_size, &inflight->offset) < 0)
+                {
+                    /* wait for outstanding ACKs to release arena space */
+                    free(inflight);
+                    break;
+                }
+                inflight->staged = 1;
+                shm_gather(shm_arena.base + inflight->offset,
+                           (const void *const *) op->buffer_list,
+                           op->size_list, op->list_count, op->actual_size);
+            }
+            inflight->cookie = conn->next_cookie++;
+            inflight->op = op;
+            shm_op_data->inflight = inflight;
+        }
+
+        inflight = shm_op_data->inflight;
+        frame.offset = inflight->offset;
+        frame.cookie = inflight->cookie;
+        if (!shm_ring_push(conn, &frame, NULL, NULL, 0))
+        {
+            break;
+        }
+        op_list_remove(op);
+        shm_op_data->state = SHM_OP_INFLIGHT;
+        qlist_add_tail(&inflight->link, &conn->inflight);
+        count++;
+    }
+
+    return count;
+}
+
+/* shm_conn_recv()
+ *
+ * consumes every frame currently on the incoming ring
+ *
+ * returns the number of frames consumed, -errno if the peer misbehaved
+ */
+static int shm_conn_recv(struct shm_conn *conn)
+{
+    struct shm_ring *ring = conn->rx;
+    struct shm_frame frame;
+    struct op_list_search_key key;
+    struct shm_inflight *inflight = NULL;
+    method_op_p op = NULL;
+    struct shm_op *shm_op_data = NULL;
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t payload_pos;
+    int count = 0;
+
+    while (head != tail)
+    {
+        shm_ring_read(ring, head, &frame, sizeof(frame));
+        payload_pos = head + sizeof(frame);
+
+        if (frame.inline_len > SHM_MODE_EAGER_LIMIT ||
+            frame.size < 0 || frame.size > SHM_MODE_REND_LIMIT)
+        {
+            gossip_err("Error: malformed shm frame from pid %d.\n",
+                       conn->peer_pid);
+            return bmi_errno_to_pvfs(-EPROTO);
+        }
+
+        switch (frame.type)
+        {
+        case SHM_FRAME_ACK:
+            qlist_for_each_entry(inflight, &conn->inflight, link)
+            {
+                if (inflight->cookie == frame.cookie)
+                {
+                    break;
+                }
+            }
+            if (&inflight->link == &conn->inflight)
+            {
+                gossip_err("Error: shm ack for unknown send.\n");
+                break;
+            }
+            qlist_del(&inflight->link);
+            if (inflight->staged)
+            {
+                shm_arena_free(inflight->offset, inflight->len);
+            }
+            if (inflight->op)
+            {
+                inflight->op->amt_complete = inflight->op->actual_size;
+                ((struct shm_op *) inflight->op->method_data)->inflight = NULL;
+                shm_op_complete(inflight->op, 0);
+            }
+            free(inflight);
+            break;
+
+        case SHM_FRAME_UNEXP:
+            op = alloc_shm_method_op();
+            if (!op)
+            {
+                return bmi_errno_to_pvfs(-ENOMEM);
+            }
+            op->buffer = malloc(frame.inline_len ? frame.inline_len : 1);
+            if (!op->buffer)
+            {
+                dealloc_shm_method_op(op);
+                return bmi_errno_to_pvfs(-ENOMEM);
+            }
+            shm_ring_read(ring, payload_pos, op->buffer, frame.inline_len);
+            op->send_recv = BMI_RECV;
+            op->addr = conn->map;
+            op->msg_tag = frame.tag;
+            op->actual_size = frame.inline_len;
+            op_list_add(unexp_list, op);
+            break;
+
+        case SHM_FRAME_EAGER:
+        case SHM_FRAME_REND:
+            if (frame.type == SHM_FRAME_REND &&
+                (frame.offset > conn->peer_arena_size ||
+                 (uint64_t) frame.size > conn->peer_arena_size - frame.offset))
+            {
+                gossip_err("Error: shm payload outside of peer arena.\n");
+                return bmi_errno_to_pvfs(-EPROTO);
+            }
+
+            memset(&key, 0, sizeof(key));
+            key.msg_tag = frame.tag;
+            key.msg_tag_yes = 1;
+            op = op_list_search(conn->recv_queue, &key);
+            if (op)
+            {
+                op_list_remove(op);
+                if (frame.type == SHM_FRAME_EAGER)
+                {
+                    shm_deliver(conn, op, frame.inline_len,
+                                NULL, payload_pos);
+                }
+                else
+                {
+                    shm_deliver(conn, op, frame.size,
+                                conn->peer_arena + frame.offset, 0);
+                    shm_send_ack(conn, frame.cookie);
+                }
+                break;
+            }
+
+            /* nobody is waiting for it yet */
+            op = alloc_shm_method_op();
+            if (!op)
+            {
+                return bmi_errno_to_pvfs(-ENOMEM);
+            }
+            shm_op_data = op->method_data;
+            shm_op_data->state = SHM_OP_EARLY;
+            shm_op_data->frame_type = frame.type;
+            shm_op_data->conn = conn;
+            op->send_recv = BMI_RECV;
+            op->addr = conn->map;
+            op->msg_tag = frame.tag;
+            if (frame.type == SHM_FRAME_EAGER)
+            {
+                op->actual_size = frame.inline_len;
+                op->buffer = malloc(frame.inline_len ? frame.inline_len : 1);
+                if (!op->buffer)
+                {
+                    dealloc_shm_method_op(op);
+                    return bmi_errno_to_pvfs(-ENOMEM);
+                }
+                shm_ring_read(ring, payload_pos, op->buffer,
+                              frame.inline_len);
+            }
+            else
+            {
+                /* leave the payload in the peer arena until matched */
+                op->actual_size = frame.size;
+                shm_op_data->offset = frame.offset;
+                shm_op_data->cookie = frame.cookie;
+            }
+            op_list_add(conn->early_queue, op);
+            break;
+
+        default:
+            gossip_err("Error: unknown shm frame type %u.\n", frame.type);
+            return bmi_errno_to_pvfs(-EPROTO);
+        }
+
+        head += SHM_ALIGN8(sizeof(frame) + frame.inline_len);
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+        count++;
+
+        if (head == tail)
+        {
+            tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        }
+    }
+
+    return count;
+}
+
+
+/******************************************************************
+ * connections
+ */
+
+static int shm_socket_name(int port, struct sockaddr_un *sun, socklen_t *len)
+{
+    int name_len;
+
+    memset(sun, 0, sizeof(*sun));
+    sun->sun_family = AF_UNIX;
+    /* abstract namespace: leading NUL, no file system entry to clean up */
+    name_len = snprintf(sun->sun_path + 1, sizeof(sun->sun_path) - 1,
+                        "%s%d", BMI_SHM_SOCKET_PREFIX, port);
+    *len = offsetof(struct sockaddr_un, sun_path) + 1 + name_len;
+    return 0;
+}
+
+static int shm_set_nonblock(int fd)
+{
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        return -errno;
+    }
+    return 0;
+}
+
+static int shm_send_hello(int sock, const int *fds, int fd_count)
+{
+    struct shm_hello hello;
+    struct msghdr msg;
+    struct iovec iov;
+    char cbuf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr *cmsg = NULL;
+    ssize_t ret;
+
+    memset(&hello, 0, sizeof(hello));
+    hello.magic_nr = BMI_MAGIC_NR;
+    hello.version = BMI_SHM_PROTO_VERSION;
+    hello.ring_size = BMI_SHM_RING_SIZE;
+    hello.arena_size = shm_arena.size;
+    hello.pid = getpid();
+
+    memset(&msg, 0, sizeof(msg));
+    memset(cbuf, 0, sizeof(cbuf));
+    iov.iov_base = &hello;
+    iov.iov_len = sizeof(hello);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = CMSG_SPACE(fd_count * sizeof(int));
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(fd_count * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, fd_count * sizeof(int));
+
+    do
+    {
+        ret = sendmsg(sock, &msg, MSG_NOSIGNAL);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        return -errno;
+    }
+    return (ret == sizeof(hello)) ? 0 : -EPROTO;
+}
+
+/* shm_recv_hello()
+ *
+ * returns number of fds received, -EAGAIN if nothing is there yet, or
+ * -errno on failure
+ */
+static int shm_recv_hello(int sock,
+                          struct shm_hello *hello,
+                          int *fds,
+                          int max_fds)
+{
+    struct msghdr msg;
+    struct iovec iov;
+    char cbuf[CMSG_SPACE(2 * sizeof(int))];
+    struct cmsghdr *cmsg = NULL;
+    int fd_count = 0;
+    ssize_t ret;
+
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = hello;
+    iov.iov_len = sizeof(*hello);
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+
+    do
+    {
+        ret = recvmsg(sock, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC);
+    } while (ret < 0 && errno == EINTR);
+    if (ret < 0)
+    {
+        return (errno == EWOULDBLOCK) ? -EAGAIN : -errno;
+    }
+
+    for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            int n = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            int i;
+            int *cfds = (int *) CMSG_DATA(cmsg);
+
+            for (i = 0; i < n; i++)
+            {
+                if (fd_count < max_fds)
+                {
+                    fds[fd_count++] = cfds[i];
+                }
+                else
+                {
+                    close(cfds[i]);
+                }
+            }
+        }
+    }
+
+    if (ret != sizeof(*hello) || hello->magic_nr != BMI_MAGIC_NR ||
+        hello->version != BMI_SHM_PROTO_VERSION ||
+        hello->ring_size != BMI_SHM_RING_SIZE)
+    {
+        while (fd_count > 0)
+        {
+            close(fds[--fd_count]);
+        }
+        return (ret == 0) ? -ECONNRESET : -EPROTO;
+    }
+    return fd_count;
+}
+
+static int shm_map_peer_arena(struct shm_conn *conn,
+                              int fd,
+                              uint64_t arena_size)
+{
+    conn->peer_arena = mmap(NULL, arena_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (conn->peer_arena == MAP_FAILED)
+    {
+        conn->peer_arena = NULL;
+        return -errno;
+    }
+    conn->peer_arena_size = arena_size;
+    return 0;
+}
+
+static struct shm_conn *alloc_shm_conn(int sock)
+{
+    struct shm_conn *conn = (struct shm_conn *) malloc(sizeof(*conn));
+
+    if (!conn)
+    {
+        return NULL;
+    }
+    memset(conn, 0, sizeof(*conn));
+    conn->sock = sock;
+    conn->peer_pid = -1;
+    conn->next_cookie = 1;
+    conn->send_queue = op_list_new();
+    conn->recv_queue = op_list_new();
+    conn->early_queue = op_list_new();
+    if (!conn->send_queue || !conn->recv_queue || !conn->early_queue)
+    {
+        if (conn->send_queue)
+            op_list_cleanup(conn->send_queue);
+        if (conn->recv_queue)
+            op_list_cleanup(conn->recv_queue);
+        if (conn->early_queue)
+            op_list_cleanup(conn->early_queue);
+        free(conn);
+        return NULL;
+    }
+    INIT_QLIST_HEAD(&conn->inflight);
+    INIT_QLIST_HEAD(&conn->acks);
+    qlist_add_tail(&conn->link, &shm_conn_list);
+    return conn;
+}
+
+/* shm_fail_queue()
+ *
+ * completes every op on a connection queue with the given error
+ */
+static void shm_fail_queue(op_list_p olp, int error_code)
+{
+    method_op_p op = NULL;
+
+    while ((op = op_list_shownext(olp)))
+    {
+        op_list_remove(op);
+        shm_op_complete(op, error_code);
+    }
+}
+
+/* shm_conn_close()
+ *
+ * tears a connection down and aborts every operation that used it
+ */
+static void shm_conn_close(struct shm_conn *conn, int error_code)
+{
+    struct shm_inflight *inflight = NULL;
+    struct shm_inflight *tmp_inflight = NULL;
+    struct shm_ack *ack = NULL;
+    struct shm_ack *tmp_ack = NULL;
+    struct shm_addr *shm_addr_data = NULL;
+    method_op_p op = NULL;
+
+    gossip_debug(GOSSIP_BMI_DEBUG_SHM, "Closing shm connection to pid %d.\n",
+                 conn->peer_pid);
+
+    qlist_del(&conn->link);
+
+    shm_fail_queue(conn->send_queue, error_code);
+    shm_fail_queue(conn->recv_queue, error_code);
+
+    /* staged sends may have been cancelled already; the peer can no longer
+     * read the arena once the connection is gone
+     */
+    qlist_for_each_entry_safe(inflight, tmp_inflight, &conn->inflight, link)
+    {
+        qlist_del(&inflight->link);
+        if (inflight->staged)
+        {
+            shm_arena_free(inflight->offset, inflight->len);
+        }
+        if (inflight->op)
+        {
+            ((struct shm_op *) inflight->op->method_data)->inflight = NULL;
+            shm_op_complete(inflight->op, error_code);
+        }
+        free(inflight);
+    }
+    qlist_for_each_entry_safe(ack, tmp_ack, &conn->acks, link)
+    {
+        qlist_del(&ack->link);
+        free(ack);
+    }
+    while ((op = op_list_shownext(conn->early_queue)))
+    {
+        op_list_remove(op);
+        if (op->buffer)
+        {
+            free(op->buffer);
+        }
+        dealloc_shm_method_op(op);
+    }
+    op_list_cleanup(conn->send_queue);
+    op_list_cleanup(conn->recv_queue);
+    op_list_cleanup(conn->early_queue);
+
+    if (conn->seg)
+    {
+        munmap(conn->seg, conn->seg_size);
+    }
+    if (conn->peer_arena)
+    {
+        munmap(conn->peer_arena, conn->peer_arena_size);
+    }
+    if (conn->sock >= 0)
+    {
+        close(conn->sock);
+    }
+
+    if (conn->map)
+    {
+        shm_addr_data = conn->map->method_data;
+        shm_addr_data->conn = NULL;
+        if (shm_addr_data->accepted)
+        {
+            /* nobody can reconnect to this address; let the bmi control
+             * layer decide when it can be forgotten
+             */
+            bmi_method_addr_forget_callback(shm_addr_data->bmi_addr);
+        }
+    }
+    free(conn);
+}
+
+/* shm_conn_connect()
+ *
+ * client side of connection setup: connect to the listener, build the
+ * segment, and hand both it and our arena over.  The server's hello is
+ * picked up later by the progress engine, so a server can connect to
+ * its own listen address without deadlocking.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int shm_conn_connect(bmi_method_addr_p map)
+{
+    struct shm_addr *shm_addr_data = map->method_data;
+    struct shm_conn *conn = NULL;
+    struct sockaddr_un sun;
+    socklen_t sun_len;
+    int sock = -1;
+    int seg_fd = -1;
+    int fds[2];
+    size_t seg_size = 2 * sizeof(struct shm_ring);
+    char *seg = NULL;
+    int ret;
+
+    shm_socket_name(shm_addr_data->port, &sun, &sun_len);
+    sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (sock < 0)
+    {
+        return -errno;
+    }
+    if (connect(sock, (struct sockaddr *) &sun, sun_len) < 0)
+    {
+        ret = -errno;
+        close(sock);
+        return ret;
+    }
+
+    seg_fd = memfd_create("pvfs2-bmi-shm-conn", MFD_CLOEXEC);
+    if (seg_fd < 0)
+    {
+        ret = -errno;
+        goto connect_failure;
+    }
+    if (ftruncate(seg_fd, seg_size) < 0)
+    {
+        ret = -errno;
+        goto connect_failure;
+    }
+    seg = mmap(NULL, seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, seg_fd, 0);
+    if (seg == MAP_FAILED)
+    {
+        seg = NULL;
+        ret = -errno;
+        goto connect_failure;
+    }
+
+    fds[0] = seg_fd;
+    fds[1] = shm_arena.fd;
+    ret = shm_send_hello(sock, fds, 2);
+    if (ret < 0)
+    {
+        goto connect_failure;
+    }
+    close(seg_fd);
+    seg_fd = -1;
+
+    ret = shm_set_nonblock(sock);
+    if (ret < 0)
+    {
+        goto connect_failure;
+    }
+
+    conn = alloc_shm_conn(sock);
+    if (!conn)
+    {
+        ret = -ENOMEM;
+        goto connect_failure;
+    }
+    conn->state = SHM_CONN_CONNECTING;
+    conn->seg = seg;
+    conn->seg_size = seg_size;
+    conn->tx = (struct shm_ring *) seg;
+    conn->rx = (struct shm_ring *) (seg + sizeof(struct shm_ring));
+    conn->map = map;
+    shm_addr_data->conn = conn;
+
+    gossip_debug(GOSSIP_BMI_DEBUG_SHM, "Connected to shm://%s:%d.\n",
+                 shm_addr_data->hostname, shm_addr_data->port);
+    return 0;
+
+  connect_failure:
+    if (seg)
+    {
+        munmap(seg, seg_size);
+    }
+    if (seg_fd >= 0)
+    {
+        close(seg_fd);
+    }
+    close(sock);
+    return ret;
+}
+
+/* shm_conn_handshake()
+ *
+ * consumes the peer's hello on either side of a new connection
+ *
+ * returns 1 when the connection became ready, 0 if the hello has not
+ * arrived yet, -errno on failure
+ */
+static int shm_conn_handshake(struct shm_conn *conn)
+{
+    struct shm_hello hello;
+    struct shm_addr *shm_addr_data = NULL;
+    int fds[2];
+    int fd_count;
+    int ret;
+
+    fd_count = shm_recv_hello(conn->sock, &hello, fds, 2);
+    if (fd_count == -EAGAIN)
+    {
+        return 0;
+    }
+    if (fd_count < 0)
+    {
+        return fd_count;
+    }
+    conn->peer_pid = hello.pid;
+
+    if (conn->state == SHM_CONN_CONNECTING)
+    {
+        if (fd_count != 1)
+        {
+            ret = -EPROTO;
+            goto handshake_failure;
+        }
+        ret = shm_map_peer_arena(conn, fds[0], hello.arena_size);
+        fd_count = 0;
+        if (ret < 0)
+        {
+            return ret;
+        }
+        conn->state = SHM_CONN_READY;
+        return 1;
+    }
+
+    /* accepted connection: map the client's segment and arena */
+    if (fd_count != 2)
+    {
+        ret = -EPROTO;
+        goto handshake_failure;
+    }
+    conn->seg_size = 2 * sizeof(struct shm_ring);
+    conn->seg = mmap(NULL, conn->seg_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fds[0], 0);
+    close(fds[0]);
+    if (conn->seg == MAP_FAILED)
+    {
+        conn->seg = NULL;
+        close(fds[1]);
+        return -errno;
+    }
+    conn->rx = (struct shm_ring *) conn->seg;
+    conn->tx = (struct shm_ring *) (conn->seg + sizeof(struct shm_ring));
+    ret = shm_map_peer_arena(conn, fds[1], hello.arena_size);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    ret = shm_send_hello(conn->sock, &shm_arena.fd, 1);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    conn->map = alloc_shm_method_addr("localhost", -1);
+    if (!conn->map)
+    {
+        return -ENOMEM;
+    }
+    shm_addr_data = conn->map->method_data;
+    shm_addr_data->accepted = 1;
+    shm_addr_data->conn = conn;
+    snprintf(shm_addr_data->peer_string, sizeof(shm_addr_data->peer_string),
+             "shm://localhost/pid-%d", conn->peer_pid);
+    shm_addr_data->bmi_addr = bmi_method_addr_reg_callback(conn->map);
+    if (shm_addr_data->bmi_addr == 0)
+    {
+        shm_addr_data->conn = NULL;
+        dealloc_shm_method_addr(conn->map);
+        conn->map = NULL;
+        return -ENOMEM;
+    }
+
+    gossip_debug(GOSSIP_BMI_DEBUG_SHM, "Accepted shm connection from "
+                 "pid %d.\n", conn->peer_pid);
+    conn->state = SHM_CONN_READY;
+    return 1;
+
+  handshake_failure:
+    while (fd_count > 0)
+    {
+        close(fds[--fd_count]);
+    }
+    return ret;
+}
+
+/* shm_conn_drain_socket()
+ *
+ * reads wakeup bytes; an EOF means the peer has gone away
+ *
+ * returns 0 on success, -errno if the connection is dead
+ */
+static int shm_conn_drain_socket(struct shm_conn *conn)
+{
+    char buf[64];
+    ssize_t ret;
+
+    for (;;)
+    {
+        ret = recv(conn->sock, buf, sizeof(buf), MSG_DONTWAIT);
+        if (ret > 0)
+        {
+            continue;
+        }
+        if (ret == 0)
+        {
+            return -ECONNRESET;
+        }
+        if (errno == EINTR)
+        {
+            continue;
+        }
+        return (errno == EWOULDBLOCK) ? 0 : -errno;
+    }
+}
+
+static void shm_accept(void)
+{
+    struct shm_conn *conn = NULL;
+    int sock;
+
+    for (;;)
+    {
+        sock = accept4(shm_method_params.listen_sock, NULL, NULL,
+                       SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (sock < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        conn = alloc_shm_conn(sock);
+        if (!conn)
+        {
+            close(sock);
+            return;
+        }
+        conn->state = SHM_CONN_ACCEPTED;
+    }
+}
+
+/* shm_progress()
+ *
+ * one non-blocking pass over the listener and every connection
+ *
+ * returns number of events handled
+ */
+static int shm_progress(void)
+{
+    struct shm_conn *conn = NULL;
+    struct shm_conn *tmp = NULL;
+    int count = 0;
+    int ret;
+
+    if (shm_method_params.listen_sock >= 0)
+    {
+        shm_accept();
+    }
+
+    qlist_for_each_entry_safe(conn, tmp, &shm_conn_list, link)
+    {
+        if (conn->state != SHM_CONN_READY)
+        {
+            ret = shm_conn_handshake(conn);
+            if (ret < 0)
+            {
+                shm_conn_close(conn, bmi_errno_to_pvfs(ret));
+                continue;
+            }
+            count += ret;
+        }
+        if (conn->state == SHM_CONN_ACCEPTED)
+        {
+            continue;
+        }
+
+        /* a connecting client must leave the socket alone until the
+         * server hello (which carries a descriptor) has been read
+         */
+        if (conn->state == SHM_CONN_READY)
+        {
+            ret = shm_conn_drain_socket(conn);
+            if (ret == 0)
+            {
+                ret = shm_conn_recv(conn);
+            }
+            if (ret < 0)
+            {
+                shm_conn_close(conn, bmi_errno_to_pvfs(ret));
+                continue;
+            }
+            count += ret;
+        }
+        count += shm_conn_push(conn);
+    }
+
+    return count;
+}
+
+/* shm_wait()
+ *
+ * blocks in poll() until a peer kicks us, a connection arrives, or the
+ * timeout expires.  Called with interface_mutex held; drops it while
+ * sleeping.
+ */
+static void shm_wait(int max_idle_time_ms)
+{
+    struct shm_conn *conn = NULL;
+    struct timeval start;
+    struct timespec wait_time;
+    int nfds = 0;
+    int pending = 0;
+
+    if (poll_busy)
+    {
+        /* another thread is polling; wait for it rather than spinning */
+        gettimeofday(&start, NULL);
+        wait_time.tv_sec = start.tv_sec + max_idle_time_ms / 1000;
+        wait_time.tv_nsec = (start.tv_usec +
+                             ((max_idle_time_ms % 1000) * 1000)) * 1000;
+        if (wait_time.tv_nsec >= 1000000000)
+        {
+            wait_time.tv_nsec -= 1000000000;
+            wait_time.tv_sec++;
+        }
+        gen_cond_timedwait(&interface_cond, &interface_mutex, &wait_time);
+        return;
+    }
+
+    qlist_for_each_entry(conn, &shm_conn_list, link)
+    {
+        nfds++;
+    }
+    nfds++;
+    if (nfds > poll_array_size)
+    {
+        struct pollfd *tmp_array = (struct pollfd *)
+            realloc(poll_array, nfds * sizeof(*poll_array));
+        if (!tmp_array)
+        {
+            return;
+        }
+        poll_array = tmp_array;
+        poll_array_size = nfds;
+    }
+
+    nfds = 0;
+    if (shm_method_params.listen_sock >= 0)
+    {
+        poll_array[nfds].fd = shm_method_params.listen_sock;
+        poll_array[nfds].events = POLLIN;
+        nfds++;
+    }
+    qlist_for_each_entry(conn, &shm_conn_list, link)
+    {
+        poll_array[nfds].fd = conn->sock;
+        poll_array[nfds].events = POLLIN;
+        nfds++;
+        if (conn->state == SHM_CONN_READY)
+        {
+            __atomic_store_n(&conn->rx->waiting, 1, __ATOMIC_RELAXED);
+        }
+        /* a full ring or arena frees up without a kick; poll briefly */
+        if (!op_list_empty(conn->send_queue) || !qlist_empty(&conn->acks))
+        {
+            pending = 1;
+        }
+    }
+
+    /* pairs with the fence in shm_ring_push() */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    qlist_for_each_entry(conn, &shm_conn_list, link)
+    {
+        if (conn->state == SHM_CONN_READY &&
+            __atomic_load_n(&conn->rx->tail, __ATOMIC_ACQUIRE) !=
+            __atomic_load_n(&conn->rx->head, __ATOMIC_RELAXED))
+        {
+            max_idle_time_ms = 0;
+        }
+    }
+    if (pending && max_idle_time_ms > 1)
+    {
+        max_idle_time_ms = 1;
+    }
+
+    if (max_idle_time_ms > 0)
+    {
+        poll_busy = 1;
+        gen_mutex_unlock(&interface_mutex);
+        poll(poll_array, nfds, max_idle_time_ms);
+        gen_mutex_lock(&interface_mutex);
+        poll_busy = 0;
+        gen_cond_broadcast(&interface_cond);
+    }
+
+    qlist_for_each_entry(conn, &shm_conn_list, link)
+    {
+        if (conn->state == SHM_CONN_READY)
+        {
+            __atomic_store_n(&conn->rx->waiting, 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* shm_do_work()
+ *
+ * makes progress on every connection, sleeping up to max_idle_time_ms if
+ * nothing happened.  Called with interface_mutex held.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int shm_do_work(int max_idle_time_ms)
+{
+    if (shm_progress() > 0 || max_idle_time_ms <= 0)
+    {
+        return 0;
+    }
+    shm_wait(max_idle_time_ms);
+    shm_progress();
+    return 0;
+}
+
+static struct shm_conn *shm_addr_conn(bmi_method_addr_p map, int *error)
+{
+    struct shm_addr *shm_addr_data = map->method_data;
+    int ret;
+
+    if (!shm_addr_data->conn)
+    {
+        if (shm_addr_data->accepted)
+        {
+            *error = bmi_errno_to_pvfs(-ECONNRESET);
+            return NULL;
+        }
+        ret = shm_conn_connect(map);
+        if (ret < 0)
+        {
+            *error = bmi_errno_to_pvfs(ret);
+            return NULL;
+        }
+    }
+    return shm_addr_data->conn;
+}
+
+
+/******************************************************************
+ * addresses
+ */
+
+static bmi_method_addr_p alloc_shm_method_addr(const char *hostname,
+                                               int port)
+{
+    bmi_method_addr_p map = NULL;
+    struct shm_addr *shm_addr_data = NULL;
+
+    map = bmi_alloc_method_addr(shm_method_params.method_id,
+                                (bmi_size_t) sizeof(struct shm_addr));
+    if (!map)
+    {
+        return NULL;
+    }
+    shm_addr_data = map->method_data;
+    memset(shm_addr_data, 0, sizeof(*shm_addr_data));
+    shm_addr_data->hostname = strdup(hostname);
+    if (!shm_addr_data->hostname)
+    {
+        bmi_dealloc_method_addr(map);
+        return NULL;
+    }
+    shm_addr_data->port = port;
+    snprintf(shm_addr_data->peer_string, sizeof(shm_addr_data->peer_string),
+             "shm://%s:%d", hostname, port);
+    return map;
+}
+
+static void dealloc_shm_method_addr(bmi_method_addr_p map)
+{
+    struct shm_addr *shm_addr_data = map->method_data;
+
+    if (shm_addr_data->conn)
+    {
+        shm_addr_data->conn->map = NULL;
+        shm_conn_close(shm_addr_data->conn, bmi_errno_to_pvfs(-ECONNRESET));
+    }
+    free(shm_addr_data->hostname);
+    bmi_dealloc_method_addr(map);
+}
+
+/* shm_host_is_local()
+ *
+ * compares host against this node's name; a short name matches the
+ * fully qualified one and vice versa
+ */
+static int shm_host_is_local(const char *host)
+{
+    char local[256];
+    size_t host_len;
+    size_t local_len;
+
+    if (!strcmp(host, "localhost") || !strncmp(host, "127.", 4))
+    {
+        return 1;
+    }
+    if (gethostname(local, sizeof(local)) < 0)
+    {
+        return 0;
+    }
+    local[sizeof(local) - 1] = '\0';
+
+    host_len = strcspn(host, ".");
+    local_len = strcspn(local, ".");
+    return (host_len == local_len && !strncmp(host, local, host_len));
+}
+
+
+/******************************************************************
+ * method interface
+ */
+
+/* BMI_shm_initialize()
+ *
+ * Initializes the shm method.  Must be called before any other shm
+ * method functions.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_initialize(bmi_method_addr_p listen_addr,
+                       int method_id,
+                       int init_flags,
+                       char *options)
+{
+    struct shm_addr *shm_addr_data = NULL;
+    struct sockaddr_un sun;
+    socklen_t sun_len;
+    int ret;
+
+    gossip_ldebug(GOSSIP_BMI_DEBUG_SHM, "Initializing shm module.\n");
+
+    if ((init_flags & BMI_INIT_SERVER) && !listen_addr)
+    {
+        return bmi_errno_to_pvfs(-EINVAL);
+    }
+
+    gen_mutex_lock(&interface_mutex);
+
+    shm_method_params.method_id = method_id;
+    shm_method_params.method_flags = init_flags;
+    shm_method_params.listen_addr = listen_addr;
+
+    unexp_list = op_list_new();
+    if (!unexp_list)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return bmi_errno_to_pvfs(-ENOMEM);
+    }
+
+    ret = shm_arena_setup();
+    if (ret < 0)
+    {
+        gossip_err("Error: failed to create shm buffer arena: %s\n",
+                   strerror(-ret));
+        goto init_failure;
+    }
+
+    if (init_flags & BMI_INIT_SERVER)
+    {
+        shm_addr_data = listen_addr->method_data;
+        shm_socket_name(shm_addr_data->port, &sun, &sun_len);
+        shm_method_params.listen_sock =
+            socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (shm_method_params.listen_sock < 0)
+        {
+            ret = -errno;
+            goto init_failure;
+        }
+        if (bind(shm_method_params.listen_sock,
+                 (struct sockaddr *) &sun, sun_len) < 0 ||
+            listen(shm_method_params.listen_sock, SOMAXCONN) < 0)
+        {
+            ret = -errno;
+            gossip_err("Error: failed to listen on shm port %d: %s\n",
+                       shm_addr_data->port, strerror(-ret));
+            goto init_failure;
+        }
+        ret = shm_set_nonblock(shm_method_params.listen_sock);
+        if (ret < 0)
+        {
+            goto init_failure;
+        }
+    }
+
+    shm_method_params.initialized = 1;
+    gen_mutex_unlock(&interface_mutex);
+
+    gossip_ldebug(GOSSIP_BMI_DEBUG_SHM, "shm module successfully "
+                  "initialized.\n");
+    return 0;
+
+  init_failure:
+    if (shm_method_params.listen_sock >= 0)
+    {
+        close(shm_method_params.listen_sock);
+        shm_method_params.listen_sock = -1;
+    }
+    shm_arena_teardown();
+    op_list_cleanup(unexp_list);
+    unexp_list = NULL;
+    gen_mutex_unlock(&interface_mutex);
+    return bmi_errno_to_pvfs(ret);
+}
+
+
+/* BMI_shm_finalize()
+ *
+ * Shuts down the shm method.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_finalize(void)
+{
+    struct shm_conn *conn = NULL;
+    struct shm_conn *tmp = NULL;
+    method_op_p op = NULL;
+    int i;
+
+    gen_mutex_lock(&interface_mutex);
+
+    qlist_for_each_entry_safe(conn, tmp, &shm_conn_list, link)
+    {
+        if (conn->map)
+        {
+            ((struct shm_addr *) conn->map->method_data)->conn = NULL;
+            conn->map = NULL;
+        }
+        shm_conn_close(conn, bmi_errno_to_pvfs(-ECANCELED));
+    }
+
+    if (shm_method_params.listen_sock >= 0)
+    {
+        close(shm_method_params.listen_sock);
+        shm_method_params.listen_sock = -1;
+    }
+    if (shm_method_params.listen_addr)
+    {
+        dealloc_shm_method_addr(shm_method_params.listen_addr);
+        shm_method_params.listen_addr = NULL;
+    }
+
+    if (unexp_list)
+    {
+        while ((op = op_list_shownext(unexp_list)))
+        {
+            op_list_remove(op);
+            free(op->buffer);
+            dealloc_shm_method_op(op);
+        }
+        op_list_cleanup(unexp_list);
+        unexp_list = NULL;
+    }
+    for (i = 0; i < BMI_MAX_CONTEXTS; i++)
+    {
+        if (completion_array[i])
+        {
+            op_list_cleanup(completion_array[i]);
+            completion_array[i] = NULL;
+        }
+    }
+
+    shm_arena_teardown();
+    free(poll_array);
+    poll_array = NULL;
+    poll_array_size = 0;
+    shm_method_params.initialized = 0;
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_method_addr_lookup()
+ *
+ * resolves the string representation of a shm address.  Only addresses
+ * on this node with a live listener are claimed, so the caller can fall
+ * back to another method otherwise.
+ *
+ * returns a pointer to method_addr on success, NULL on failure
+ */
+bmi_method_addr_p BMI_shm_method_addr_lookup(const char *id_string)
+{
+    char *shm_string = NULL;
+    char *delim = NULL;
+    bmi_method_addr_p new_addr = NULL;
+    int port;
+    int ret;
+
+    shm_string = string_key("shm", id_string);
+    if (!shm_string)
+    {
+        /* the string doesn't even have our info */
+        return NULL;
+    }
+
+    delim = strchr(shm_string, ':');
+    if (!delim)
+    {
+        gossip_lerr("Error: malformed shm address: %s\n", id_string);
+        free(shm_string);
+        return NULL;
+    }
+    *delim = '\0';
+    port = atoi(delim + 1);
+
+    /* listen addresses are looked up before the method is initialized,
+     * and may name no host at all
+     */
+    if (!shm_method_params.initialized)
+    {
+        new_addr = alloc_shm_method_addr(shm_string, port);
+        free(shm_string);
+        return new_addr;
+    }
+
+    if (!shm_host_is_local(shm_string))
+    {
+        gossip_debug(GOSSIP_BMI_DEBUG_SHM, "%s is not on this node.\n",
+                     shm_string);
+        free(shm_string);
+        return NULL;
+    }
+
+    new_addr = alloc_shm_method_addr(shm_string, port);
+    free(shm_string);
+    if (!new_addr)
+    {
+        return NULL;
+    }
+
+    /* probe the listener now so that lookup failure means fallback */
+    gen_mutex_lock(&interface_mutex);
+    ret = shm_conn_connect(new_addr);
+    gen_mutex_unlock(&interface_mutex);
+    if (ret < 0)
+    {
+        gossip_debug(GOSSIP_BMI_DEBUG_SHM, "No shm listener for %s: %s\n",
+                     id_string, strerror(-ret));
+        dealloc_shm_method_addr(new_addr);
+        return NULL;
+    }
+
+    return new_addr;
+}
+
+
+/* BMI_shm_set_info()
+ *
+ * Pass in optional parameters.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_set_info(int option,
+                     void *inout_parameter)
+{
+    bmi_method_addr_p tmp_addr = NULL;
+    int ret = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    switch (option)
+    {
+    case BMI_FORCEFUL_CANCEL_MODE:
+        forceful_cancel_mode = 1;
+        break;
+    case BMI_DROP_ADDR:
+        if (inout_parameter == NULL)
+        {
+            ret = bmi_errno_to_pvfs(-EINVAL);
+        }
+        else
+        {
+            tmp_addr = (bmi_method_addr_p) inout_parameter;
+            if (tmp_addr == shm_method_params.listen_addr)
+            {
+                break;
+            }
+            dealloc_shm_method_addr(tmp_addr);
+        }
+        break;
+    default:
+        gossip_ldebug(GOSSIP_BMI_DEBUG_SHM,
+                      "shm hint %d not implemented.\n", option);
+        break;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return ret;
+}
+
+
+/* BMI_shm_get_info()
+ *
+ * Query for optional parameters.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_get_info(int option,
+                     void *inout_parameter)
+{
+    struct method_drop_addr_query *query = NULL;
+    struct shm_addr *shm_addr_data = NULL;
+    int ret = 0;
+
+    switch (option)
+    {
+    case BMI_CHECK_MAXSIZE:
+        *((int *) inout_parameter) = SHM_MODE_REND_LIMIT;
+        break;
+    case BMI_GET_UNEXP_SIZE:
+        *((int *) inout_parameter) = SHM_MODE_EAGER_LIMIT;
+        break;
+    case BMI_DROP_ADDR_QUERY:
+        query = (struct method_drop_addr_query *) inout_parameter;
+        shm_addr_data = query->addr->method_data;
+        gen_mutex_lock(&interface_mutex);
+        /* an accepted peer that went away can never come back */
+        query->response = (shm_addr_data->accepted && !shm_addr_data->conn);
+        gen_mutex_unlock(&interface_mutex);
+        break;
+    default:
+        gossip_ldebug(GOSSIP_BMI_DEBUG_SHM,
+                      "shm hint %d not implemented.\n", option);
+        ret = bmi_errno_to_pvfs(-ENOSYS);
+        break;
+    }
+
+    return ret;
+}
+
+
+/* BMI_shm_memalloc()
+ *
+ * Allocates memory out of the shared arena, so that sends from it need no
+ * staging copy.  Falls back to ordinary memory if the arena is full.
+ *
+ * returns pointer to buffer on success, NULL on failure.
+ */
+void *BMI_shm_memalloc(bmi_size_t size,
+                       enum bmi_op_type send_recv)
+{
+    uint64_t offset;
+    void *ptr = NULL;
+
+    if (shm_arena.base && shm_arena_alloc(size, &offset) == 0)
+    {
+        return shm_arena.base + offset;
+    }
+    if (posix_memalign(&ptr, 4096, size) != 0)
+    {
+        return NULL;
+    }
+    return ptr;
+}
+
+
+/* BMI_shm_memfree()
+ *
+ * Frees memory that was allocated with BMI_shm_memalloc()
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_memfree(void *buffer,
+                    bmi_size_t size,
+                    enum bmi_op_type send_recv)
+{
+    if (shm_arena_contains(buffer, size))
+    {
+        shm_arena_free((char *) buffer - shm_arena.base, size);
+    }
+    else
+    {
+        free(buffer);
+    }
+    return 0;
+}
+
+
+/* BMI_shm_unexpected_free()
+ *
+ * Frees memory that was returned from BMI_shm_test_unexpected()
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_unexpected_free(void *buffer)
+{
+    if (buffer)
+    {
+        free(buffer);
+    }
+    return 0;
+}
+
+
+/* BMI_shm_post_send()
+ *
+ * Submits send operations.
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_send(bmi_op_id_t *id,
+                      bmi_method_addr_p dest,
+                      const void *buffer,
+                      bmi_size_t size,
+                      enum bmi_buffer_type buffer_type,
+                      bmi_msg_tag_t tag,
+                      void *user_ptr,
+                      bmi_context_id context_id,
+                      PVFS_hint hints)
+{
+    return shm_post_send_generic(id, dest, &buffer, &size, 1, size, tag,
+                                 user_ptr, context_id,
+                                 size <= SHM_MODE_EAGER_LIMIT ?
+                                 SHM_FRAME_EAGER : SHM_FRAME_REND);
+}
+
+
+/* BMI_shm_post_sendunexpected()
+ *
+ * Submits unexpected send operations.
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_sendunexpected(bmi_op_id_t *id,
+                                bmi_method_addr_p dest,
+                                const void *buffer,
+                                bmi_size_t size,
+                                enum bmi_buffer_type buffer_type,
+                                bmi_msg_tag_t tag,
+                                void *user_ptr,
+                                bmi_context_id context_id,
+                                PVFS_hint hints)
+{
+    return shm_post_send_generic(id, dest, &buffer, &size, 1, size, tag,
+                                 user_ptr, context_id, SHM_FRAME_UNEXP);
+}
+
+
+/* BMI_shm_post_recv()
+ *
+ * Submits receive operations.
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_recv(bmi_op_id_t *id,
+                      bmi_method_addr_p src,
+                      void *buffer,
+                      bmi_size_t expected_size,
+                      bmi_size_t *actual_size,
+                      enum bmi_buffer_type buffer_type,
+                      bmi_msg_tag_t tag,
+                      void *user_ptr,
+                      bmi_context_id context_id,
+                      PVFS_hint hints)
+{
+    return shm_post_recv_generic(id, src, &buffer, &expected_size, 1,
+                                 expected_size, actual_size, tag, user_ptr,
+                                 context_id);
+}
+
+
+/* BMI_shm_post_send_list()
+ *
+ * same as the BMI_shm_post_send() function, except that it sends
+ * from an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_send_list(bmi_op_id_t *id,
+                           bmi_method_addr_p dest,
+                           const void *const *buffer_list,
+                           const bmi_size_t *size_list,
+                           int list_count,
+                           bmi_size_t total_size,
+                           enum bmi_buffer_type buffer_type,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints)
+{
+    return shm_post_send_generic(id, dest, buffer_list, size_list,
+                                 list_count, total_size, tag, user_ptr,
+                                 context_id,
+                                 total_size <= SHM_MODE_EAGER_LIMIT ?
+                                 SHM_FRAME_EAGER : SHM_FRAME_REND);
+}
+
+
+/* BMI_shm_post_recv_list()
+ *
+ * same as the BMI_shm_post_recv() function, except that it recvs
+ * into an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_recv_list(bmi_op_id_t *id,
+                           bmi_method_addr_p src,
+                           void *const *buffer_list,
+                           const bmi_size_t *size_list,
+                           int list_count,
+                           bmi_size_t total_expected_size,
+                           bmi_size_t *total_actual_size,
+                           enum bmi_buffer_type buffer_type,
+                           bmi_msg_tag_t tag,
+                           void *user_ptr,
+                           bmi_context_id context_id,
+                           PVFS_hint hints)
+{
+    return shm_post_recv_generic(id, src, buffer_list, size_list,
+                                 list_count, total_expected_size,
+                                 total_actual_size, tag, user_ptr,
+                                 context_id);
+}
+
+
+/* BMI_shm_post_sendunexpected_list()
+ *
+ * same as the BMI_shm_post_sendunexpected() function, except that it sends
+ * from an array of possibly non contiguous buffers
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+int BMI_shm_post_sendunexpected_list(bmi_op_id_t *id,
+                                     bmi_method_addr_p dest,
+                                     const void *const *buffer_list,
+                                     const bmi_size_t *size_list,
+                                     int list_count,
+                                     bmi_size_t total_size,
+                                     enum bmi_buffer_type buffer_type,
+                                     bmi_msg_tag_t tag,
+                                     void *user_ptr,
+                                     bmi_context_id context_id,
+                                     PVFS_hint hints)
+{
+    return shm_post_send_generic(id, dest, buffer_list, size_list,
+                                 list_count, total_size, tag, user_ptr,
+                                 context_id, SHM_FRAME_UNEXP);
+}
+
+
+/* shm_post_send_generic()
+ *
+ * common send path.  Eager sends that fit in the ring while nothing is
+ * queued ahead of them complete immediately; everything else is queued
+ * in order on the connection.
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+static int shm_post_send_generic(bmi_op_id_t *id,
+                                 bmi_method_addr_p dest,
+                                 const void *const *buffer_list,
+                                 const bmi_size_t *size_list,
+                                 int list_count,
+                                 bmi_size_t total_size,
+                                 bmi_msg_tag_t tag,
+                                 void *user_ptr,
+                                 bmi_context_id context_id,
+                                 int frame_type)
+{
+    struct shm_conn *conn = NULL;
+    struct shm_frame frame;
+    method_op_p op = NULL;
+    struct shm_op *shm_op_data = NULL;
+    int ret = 0;
+
+    /* clear the id field for safety */
+    *id = 0;
+
+    if (total_size > SHM_MODE_REND_LIMIT ||
+        (frame_type == SHM_FRAME_UNEXP && total_size > SHM_MODE_EAGER_LIMIT))
+    {
+        gossip_lerr("Error: BMI message too large!\n");
+        return bmi_errno_to_pvfs(-EMSGSIZE);
+    }
+
+    gen_mutex_lock(&interface_mutex);
+
+    conn = shm_addr_conn(dest, &ret);
+    if (!conn)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return ret;
+    }
+
+    if (frame_type != SHM_FRAME_REND && op_list_empty(conn->send_queue) &&
+        qlist_empty(&conn->acks))
+    {
+        memset(&frame, 0, sizeof(frame));
+        frame.type = frame_type;
+        frame.tag = tag;
+        frame.size = total_size;
+        frame.inline_len = total_size;
+        if (shm_ring_push(conn, &frame, buffer_list, size_list, list_count))
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return 1;
+        }
+    }
+
+    op = alloc_shm_method_op();
+    if (!op)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return bmi_errno_to_pvfs(-ENOMEM);
+    }
+    shm_op_data = op->method_data;
+    shm_op_data->state = SHM_OP_QUEUED;
+    shm_op_data->frame_type = frame_type;
+    shm_op_data->conn = conn;
+    op->send_recv = BMI_SEND;
+    op->addr = dest;
+    op->user_ptr = user_ptr;
+    op->msg_tag = tag;
+    op->context_id = context_id;
+    op->actual_size = total_size;
+    op->expected_size = total_size;
+    if (list_count == 1)
+    {
+        op->buffer = (void *) buffer_list[0];
+    }
+    else
+    {
+        op->buffer_list = (void *const *) buffer_list;
+        op->size_list = size_list;
+        op->list_count = list_count;
+    }
+    *id = op->op_id;
+
+    op_list_add(conn->send_queue, op);
+    shm_conn_push(conn);
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* shm_post_recv_generic()
+ *
+ * common receive path; matches against early arrivals first
+ *
+ * returns 0 on success, 1 on immediate successful completion,
+ * -errno on failure
+ */
+static int shm_post_recv_generic(bmi_op_id_t *id,
+                                 bmi_method_addr_p src,
+                                 void *const *buffer_list,
+                                 const bmi_size_t *size_list,
+                                 int list_count,
+                                 bmi_size_t expected_size,
+                                 bmi_size_t *actual_size,
+                                 bmi_msg_tag_t tag,
+                                 void *user_ptr,
+                                 bmi_context_id context_id)
+{
+    struct shm_conn *conn = NULL;
+    struct op_list_search_key key;
+    method_op_p op = NULL;
+    method_op_p early_op = NULL;
+    struct shm_op *shm_op_data = NULL;
+    struct shm_op *early_data = NULL;
+    bmi_size_t copy_size;
+    int ret = 0;
+
+    /* clear the id field for safety */
+    *id = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    conn = shm_addr_conn(src, &ret);
+    if (!conn)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return ret;
+    }
+
+    memset(&key, 0, sizeof(key));
+    key.msg_tag = tag;
+    key.msg_tag_yes = 1;
+    early_op = op_list_search(conn->early_queue, &key);
+    if (early_op)
+    {
+        op_list_remove(early_op);
+        early_data = early_op->method_data;
+        copy_size = early_op->actual_size;
+        if (copy_size > expected_size)
+        {
+            gossip_err("Error: shm message of %lld bytes overflows %lld "
+                       "byte receive buffer.\n", lld(copy_size),
+                       lld(expected_size));
+            copy_size = expected_size;
+            ret = bmi_errno_to_pvfs(-EMSGSIZE);
+        }
+        if (early_data->frame_type == SHM_FRAME_EAGER)
+        {
+            shm_scatter(buffer_list, size_list, list_count,
+                        early_op->buffer, copy_size);
+            free(early_op->buffer);
+        }
+        else
+        {
+            shm_scatter(buffer_list, size_list, list_count,
+                        conn->peer_arena + early_data->offset, copy_size);
+            shm_send_ack(conn, early_data->cookie);
+        }
+        dealloc_shm_method_op(early_op);
+        *actual_size = copy_size;
+        gen_mutex_unlock(&interface_mutex);
+        return (ret < 0) ? ret : 1;
+    }
+
+    op = alloc_shm_method_op();
+    if (!op)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return bmi_errno_to_pvfs(-ENOMEM);
+    }
+    shm_op_data = op->method_data;
+    shm_op_data->state = SHM_OP_QUEUED;
+    shm_op_data->conn = conn;
+    op->send_recv = BMI_RECV;
+    op->addr = src;
+    op->user_ptr = user_ptr;
+    op->msg_tag = tag;
+    op->context_id = context_id;
+    op->expected_size = expected_size;
+    if (list_count == 1)
+    {
+        op->buffer = buffer_list[0];
+    }
+    else
+    {
+        op->buffer_list = buffer_list;
+        op->size_list = size_list;
+        op->list_count = list_count;
+    }
+    *id = op->op_id;
+    op_list_add(conn->recv_queue, op);
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* shm_test_complete()
+ *
+ * pops a completed op, filling in the caller's results
+ */
+static void shm_test_complete(method_op_p query_op,
+                              bmi_error_code_t *error_code,
+                              bmi_size_t *actual_size,
+                              void **user_ptr)
+{
+    op_list_remove(query_op);
+    *error_code = query_op->error_code;
+    *actual_size = query_op->actual_size;
+    if (user_ptr != NULL)
+    {
+        *user_ptr = query_op->user_ptr;
+    }
+    dealloc_shm_method_op(query_op);
+}
+
+
+/* BMI_shm_test()
+ *
+ * Checks to see if a particular message has completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_test(bmi_op_id_t id,
+                 int *outcount,
+                 bmi_error_code_t *error_code,
+                 bmi_size_t *actual_size,
+                 void **user_ptr,
+                 int max_idle_time_ms,
+                 bmi_context_id context_id)
+{
+    method_op_p query_op = NULL;
+    int ret;
+
+    *outcount = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    query_op = (method_op_p) id_gen_fast_lookup(id);
+    assert(query_op);
+    if (((struct shm_op *) query_op->method_data)->state != SHM_OP_COMPLETE)
+    {
+        ret = shm_do_work(max_idle_time_ms);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return ret;
+        }
+    }
+
+    if (((struct shm_op *) query_op->method_data)->state == SHM_OP_COMPLETE)
+    {
+        assert(query_op->context_id == context_id);
+        shm_test_complete(query_op, error_code, actual_size, user_ptr);
+        *outcount = 1;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_testsome()
+ *
+ * Checks to see if any messages from the specified list have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_testsome(int incount,
+                     bmi_op_id_t *id_array,
+                     int *outcount,
+                     int *index_array,
+                     bmi_error_code_t *error_code_array,
+                     bmi_size_t *actual_size_array,
+                     void **user_ptr_array,
+                     int max_idle_time_ms,
+                     bmi_context_id context_id)
+{
+    method_op_p query_op = NULL;
+    int ret;
+    int i;
+
+    *outcount = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    ret = shm_do_work(op_list_empty(completion_array[context_id]) ?
+                      max_idle_time_ms : 0);
+    if (ret < 0)
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return ret;
+    }
+
+    for (i = 0; i < incount; i++)
+    {
+        if (!id_array[i])
+        {
+            continue;
+        }
+        query_op = (method_op_p) id_gen_fast_lookup(id_array[i]);
+        if (((struct shm_op *) query_op->method_data)->state ==
+            SHM_OP_COMPLETE)
+        {
+            assert(query_op->context_id == context_id);
+            index_array[*outcount] = i;
+            shm_test_complete(query_op, &error_code_array[*outcount],
+                              &actual_size_array[*outcount],
+                              user_ptr_array ?
+                              &user_ptr_array[*outcount] : NULL);
+            (*outcount)++;
+        }
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_testunexpected()
+ *
+ * Checks to see if any unexpected messages have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_testunexpected(int incount,
+                           int *outcount,
+                           struct bmi_method_unexpected_info *info,
+                           int max_idle_time_ms)
+{
+    method_op_p query_op = NULL;
+    int ret;
+
+    *outcount = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    if (op_list_empty(unexp_list))
+    {
+        ret = shm_do_work(max_idle_time_ms);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return ret;
+        }
+    }
+
+    while ((*outcount < incount) && (query_op = op_list_shownext(unexp_list)))
+    {
+        info[*outcount].error_code = query_op->error_code;
+        info[*outcount].addr = query_op->addr;
+        info[*outcount].buffer = query_op->buffer;
+        info[*outcount].size = query_op->actual_size;
+        info[*outcount].tag = query_op->msg_tag;
+        op_list_remove(query_op);
+        dealloc_shm_method_op(query_op);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_testcontext()
+ *
+ * Checks to see if any messages from the specified context have completed.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_testcontext(int incount,
+                        bmi_op_id_t *out_id_array,
+                        int *outcount,
+                        bmi_error_code_t *error_code_array,
+                        bmi_size_t *actual_size_array,
+                        void **user_ptr_array,
+                        int max_idle_time_ms,
+                        bmi_context_id context_id)
+{
+    method_op_p query_op = NULL;
+    int ret;
+
+    *outcount = 0;
+
+    gen_mutex_lock(&interface_mutex);
+
+    if (op_list_empty(completion_array[context_id]))
+    {
+        /* let the next testunexpected call pick these up without delay */
+        if (!op_list_empty(unexp_list))
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return 0;
+        }
+
+        ret = shm_do_work(max_idle_time_ms);
+        if (ret < 0)
+        {
+            gen_mutex_unlock(&interface_mutex);
+            return ret;
+        }
+    }
+
+    while ((*outcount < incount) &&
+           (query_op = op_list_shownext(completion_array[context_id])))
+    {
+        assert(query_op->context_id == context_id);
+        out_id_array[*outcount] = query_op->op_id;
+        shm_test_complete(query_op, &error_code_array[*outcount],
+                          &actual_size_array[*outcount],
+                          user_ptr_array ? &user_ptr_array[*outcount] : NULL);
+        (*outcount)++;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_open_context()
+ *
+ * opens a new context with the specified context id
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_open_context(bmi_context_id context_id)
+{
+    gen_mutex_lock(&interface_mutex);
+
+    completion_array[context_id] = op_list_new();
+    if (!completion_array[context_id])
+    {
+        gen_mutex_unlock(&interface_mutex);
+        return bmi_errno_to_pvfs(-ENOMEM);
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_close_context()
+ *
+ * shuts down a context, previously opened with BMI_shm_open_context()
+ *
+ * no return value
+ */
+void BMI_shm_close_context(bmi_context_id context_id)
+{
+    gen_mutex_lock(&interface_mutex);
+
+    op_list_cleanup(completion_array[context_id]);
+    completion_array[context_id] = NULL;
+
+    gen_mutex_unlock(&interface_mutex);
+}
+
+
+/* BMI_shm_cancel()
+ *
+ * attempt to cancel a pending bmi shm operation.  A send whose payload
+ * the peer may still be reading out of our arena cannot be pulled back:
+ * staged copies are completed at once (the copy is released when the
+ * ACK arrives), while sends straight from a user buffer complete when
+ * the ACK arrives or the connection is torn down.
+ *
+ * returns 0 on success, -errno on failure
+ */
+int BMI_shm_cancel(bmi_op_id_t id, bmi_context_id context_id)
+{
+    method_op_p query_op = NULL;
+    struct shm_op *shm_op_data = NULL;
+
+    gen_mutex_lock(&interface_mutex);
+
+    query_op = (method_op_p) id_gen_fast_lookup(id);
+    if (!query_op)
+    {
+        /* if we can't find the operation, then assume it has already
+         * completed naturally.
+         */
+        gen_mutex_unlock(&interface_mutex);
+        return 0;
+    }
+    shm_op_data = query_op->method_data;
+
+    switch (shm_op_data->state)
+    {
+    case SHM_OP_QUEUED:
+        op_list_remove(query_op);
+        if (shm_op_data->inflight)
+        {
+            /* staged but never published */
+            if (shm_op_data->inflight->staged)
+            {
+                shm_arena_free(shm_op_data->inflight->offset,
+                               shm_op_data->inflight->len);
+            }
+            free(shm_op_data->inflight);
+            shm_op_data->inflight = NULL;
+        }
+        shm_op_complete(query_op, bmi_errno_to_pvfs(-ECANCELED));
+        break;
+    case SHM_OP_INFLIGHT:
+        if (shm_op_data->inflight && shm_op_data->inflight->staged)
+        {
+            shm_op_data->inflight->op = NULL;
+            shm_op_data->inflight = NULL;
+            shm_op_complete(query_op, bmi_errno_to_pvfs(-ECANCELED));
+        }
+        else if (forceful_cancel_mode && shm_op_data->conn)
+        {
+            shm_conn_close(shm_op_data->conn, bmi_errno_to_pvfs(-ECANCELED));
+        }
+        break;
+    default:
+        break;
+    }
+
+    gen_mutex_unlock(&interface_mutex);
+    return 0;
+}
+
+
+/* BMI_shm_addr_rev_lookup_unexpected()
+ *
+ * looks up an address that was initialized unexpectedly and returns a
+ * string describing the peer
+ *
+ * returns string on success, "UNKNOWN" on failure
+ */
+const char *BMI_shm_addr_rev_lookup_unexpected(bmi_method_addr_p map)
+{
+    struct shm_addr *shm_addr_data = map->method_data;
+
+    if (!shm_addr_data)
+    {
+        return "UNKNOWN";
+    }
+    return shm_addr_data->peer_string;
+}
+
+
+/* BMI_shm_query_addr_range()
+ *
+ * every shm peer is on this node, so only wildcards that cover the local
+ * host name or the loopback network match
+ *
+ * returns 1 on match, 0 on no match, -errno on failure
+ */
+int BMI_shm_query_addr_range(bmi_method_addr_p map,
+                             const char *wildcard_string,
+                             int netmask)
+{
+    const char *shm_wildcard = wildcard_string + 6; /* strlen("shm://") */
+
+    if (netmask == -1)
+    {
+        if (!strcmp(shm_wildcard, "*") || shm_host_is_local(shm_wildcard))
+        {
+            return 1;
+        }
+        return 0;
+    }
+    return (!strncmp(shm_wildcard, "127.", 4)) ? 1 : 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
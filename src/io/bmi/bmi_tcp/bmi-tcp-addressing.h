@@ -13,6 +13,7 @@
 
 #include "bmi-types.h"
 #include <netinet/in.h>
+#include <sys/time.h>
 
 /*****************************************************************
  * Information specific to tcp/ip
@@ -77,6 +78,23 @@ struct tcp_addr
     int dont_reconnect;
     char* peer;
     int peer_type;
+    /* small outgoing messages (header and payload) staged for a single
+     * send() to this peer; coalesce_sent is how much has been written
+     */
+    char *coalesce_buf;
+    int coalesce_len;
+    int coalesce_sent;
+    /* time at which the oldest staged message was accepted */
+    struct timeval coalesce_start;
+    /* set while we hold a write bit for a partially flushed buffer */
+    int coalesce_write_bit;
+    /* link in the list of addresses with staged data */
+    struct qlist_head coalesce_link;
+    int coalesce_queued;
+    /* data read ahead from the socket, not yet parsed into messages */
+    char *recv_buf;
+    int recv_buf_off;
+    int recv_buf_len;
 };
 
 
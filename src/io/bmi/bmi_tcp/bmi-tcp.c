@@ -56,6 +56,9 @@ static gen_mutex_t interface_mutex = GEN_MUTEX_INITIALIZER;
 static gen_cond_t interface_cond = GEN_COND_INITIALIZER;
 static int sc_test_busy = 0;
 
+/* addresses with small messages staged in their coalesce buffer */
+static QLIST_HEAD(tcp_coalesce_list);
+
 /* function prototypes */
 int BMI_tcp_initialize(bmi_method_addr_p listen_addr,
                        int method_id,
@@ -345,6 +348,19 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
                                  bmi_context_id context_id,
                                  PVFS_hint hints);
 
+static int tcp_coalesce_stage(bmi_method_addr_p map,
+                              const void *const *buffer_list,
+                              const bmi_size_t *size_list,
+                              int list_count,
+                              struct tcp_msg_header *my_header);
+static int tcp_coalesce_flush(bmi_method_addr_p map);
+static void tcp_coalesce_flush_all(void);
+static void tcp_coalesce_drain(struct tcp_addr *tcp_addr_data);
+static int tcp_recv_fill(struct tcp_addr *tcp_addr_data);
+static int tcp_recv_payload(method_op_p my_method_op);
+static int tcp_recv_new_msg(bmi_method_addr_p map,
+                            struct tcp_msg_header *hdr,
+                            int *next_flag);
 static int payload_progress(int s,
                             void *const *buffer_list,
                             const bmi_size_t *size_list,
@@ -456,6 +472,22 @@ enum
     TCP_MODE_REND_LIMIT = 16777216	/* 16M */
 };
 
+/* Send coalescing and receive read-ahead */
+enum
+{
+    /* messages (header included) at or below this size are staged and
+     * written to the socket together with their neighbors
+     */
+    TCP_COALESCE_MSG_LIMIT = 4096,
+    TCP_COALESCE_BUF_SIZE = 16384,
+    /* longest a staged message waits for company before being flushed */
+    TCP_COALESCE_USECS = 50,
+    /* read-ahead per connection; must not exceed TCP_MODE_EAGER_LIMIT so
+     * that anything buffered behind a rendezvous header is all payload
+     */
+    TCP_RECV_BUF_SIZE = 16384
+};
+
 /* toggles cancel mode; for bmi_tcp this will result in socket being closed
  * in all cancellation cases
  */
@@ -2311,6 +2343,7 @@ static void dealloc_tcp_method_addr(bmi_method_addr_p map)
     {
 	if (tcp_addr_data->socket > -1)
 	{
+            tcp_coalesce_drain(tcp_addr_data);
 	    close(tcp_addr_data->socket);
 	}
     }
@@ -2327,6 +2360,18 @@ static void dealloc_tcp_method_addr(bmi_method_addr_p map)
     {
         free(tcp_addr_data->peer);
     }
+    if (tcp_addr_data->coalesce_queued)
+    {
+        qlist_del(&tcp_addr_data->coalesce_link);
+    }
+    if (tcp_addr_data->coalesce_buf)
+    {
+        free(tcp_addr_data->coalesce_buf);
+    }
+    if (tcp_addr_data->recv_buf)
+    {
+        free(tcp_addr_data->recv_buf);
+    }
 
     bmi_dealloc_method_addr(map);
 
@@ -2960,21 +3005,11 @@ static int tcp_post_recv_generic(bmi_op_id_t *id,
         if (query_op->amt_complete < query_op->actual_size)
         {
             /* try to recv some more data */
-            tcp_addr_data = query_op->addr->method_data;
-            ret = payload_progress(tcp_addr_data->socket,
-                                   query_op->buffer_list,
-                                   query_op->size_list,
-                                   query_op->list_count,
-                                   query_op->actual_size,
-                                   &(query_op->list_index),
-                                   &(query_op->cur_index_complete),
-                                   BMI_RECV,
-                                   NULL,
-                                   0);
+            ret = tcp_recv_payload(query_op);
             if (ret < 0)
             {
-                PVFS_perror_gossip("Error: payload_progress", ret);
-                /* payload_progress() returns BMI error codes */
+                PVFS_perror_gossip("Error: tcp_recv_payload", ret);
+                /* tcp_recv_payload() returns BMI error codes */
                 tcp_forget_addr(query_op->addr, 0, ret);
                 return (ret);
             }
@@ -3128,11 +3163,24 @@ static int tcp_shutdown_addr(bmi_method_addr_p map)
 
     if (tcp_addr_data->socket > -1)
     {
+        tcp_coalesce_drain(tcp_addr_data);
 	close(tcp_addr_data->socket);
     }
     tcp_addr_data->socket = -1;
     tcp_addr_data->not_connected = 1;
 
+    /* anything staged or read ahead belonged to the old connection */
+    if (tcp_addr_data->coalesce_queued)
+    {
+        qlist_del(&tcp_addr_data->coalesce_link);
+        tcp_addr_data->coalesce_queued = 0;
+    }
+    tcp_addr_data->coalesce_len = 0;
+    tcp_addr_data->coalesce_sent = 0;
+    tcp_addr_data->coalesce_write_bit = 0;
+    tcp_addr_data->recv_buf_off = 0;
+    tcp_addr_data->recv_buf_len = 0;
+
     return (0);
 }
 
@@ -3191,6 +3239,9 @@ static int tcp_do_work(int max_idle_time)
 
     /* this thread has gained control of the polling.  */
     sc_test_busy = 1;
+
+    /* nothing staged may sit behind a poll that could block */
+    tcp_coalesce_flush_all();
     gen_mutex_unlock(&interface_mutex);
 
     /* our turn to look at the socket collection */
@@ -3308,9 +3359,29 @@ static int tcp_do_work_send(bmi_method_addr_p map,
     int blocked_flag = 0;
     int ret = 0;
     int tmp_stall_flag;
+    struct tcp_addr *tcp_addr_data = map->method_data;
 
     *stall_flag = 1;
 
+    /* staged messages precede anything in the send queue */
+    if (tcp_addr_data->coalesce_len)
+    {
+        ret = tcp_coalesce_flush(map);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: tcp_coalesce_flush", ret);
+            tcp_forget_addr(map, 0, ret);
+            return (0);
+        }
+        if (ret == 0)
+        {
+            /* socket is still full */
+            return (0);
+        }
+        *stall_flag = 0;
+        ret = 0;
+    }
+
     while (blocked_flag == 0 && ret == 0)
     {
 	/* what we want to do here is find the first operation in the send
@@ -3417,13 +3488,10 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 {
     method_op_p active_method_op = NULL;
     int ret = -1;
-    void *new_buffer = NULL;
-    struct op_list_search_key key;
     struct tcp_msg_header new_header;
     struct tcp_addr *tcp_addr_data = map->method_data;
     struct tcp_op *tcp_op_data = NULL;
-    int tmp_errno;
-    int tmp;
+    int next_flag;
     bmi_size_t old_amt_complete = 0;
     time_t current_time;
 
@@ -3486,41 +3554,62 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	}
     }
 
-    /* let's see if the entire header is ready to be received.  If so
-     * we will go ahead and pull it.  Otherwise, we will try again later.
-     * It isn't worth the complication of reading only a partial message
-     * header - we really want it atomically
+    /* pull whatever the socket has into the read-ahead buffer; a single
+     * recv() here usually picks up several small messages at once
      */
-    ret = BMI_sockio_nbpeek(tcp_addr_data->socket,
-                            new_header.enc_hdr, 
-                            TCP_ENC_HDR_SIZE);
-    if (ret < 0)
+    if ((tcp_addr_data->recv_buf_len - tcp_addr_data->recv_buf_off) <
+        TCP_ENC_HDR_SIZE)
     {
-	tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-errno));
-	return (0);
-    }
+        ret = tcp_recv_fill(tcp_addr_data);
+        if (ret < 0)
+        {
+            tcp_forget_addr(map, 0, ret);
+            return (0);
+        }
 
-    if (ret == 0)
-    {
-        gossip_debug(GOSSIP_BMI_DEBUG_TCP, 
-                     "Warning: bmi_tcp unable "
-                     "to recv any data reported by poll(). [2]\n");
+        if (ret == 0)
+        {
+            gossip_debug(GOSSIP_BMI_DEBUG_TCP, 
+                         "Warning: bmi_tcp unable "
+                         "to recv any data reported by poll(). [2]\n");
 
-        if (tcp_addr_data->zero_read_limit++ == BMI_TCP_ZERO_READ_LIMIT)
+            if (tcp_addr_data->zero_read_limit++ == BMI_TCP_ZERO_READ_LIMIT)
+            {
+                gossip_debug(GOSSIP_BMI_DEBUG_TCP,
+                             "...dropping connection.\n");
+                tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-EPIPE));
+            }
+            return (0);
+        }
+        else
         {
-            gossip_debug(GOSSIP_BMI_DEBUG_TCP,
-                         "...dropping connection.\n");
-            tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-EPIPE));
+            tcp_addr_data->zero_read_limit = 0;
         }
-	return (0);
     }
-    else
+
+    /* work through every complete header we have buffered */
+    while ((tcp_addr_data->recv_buf_len - tcp_addr_data->recv_buf_off) >=
+           TCP_ENC_HDR_SIZE)
     {
-        tcp_addr_data->zero_read_limit = 0;
+        tcp_addr_data->short_header_timer = 0;
+        *stall_flag = 0;
+        gossip_ldebug(GOSSIP_BMI_DEBUG_TCP, "Reading header for new op.\n");
+        memcpy(new_header.enc_hdr,
+               tcp_addr_data->recv_buf + tcp_addr_data->recv_buf_off,
+               TCP_ENC_HDR_SIZE);
+        tcp_addr_data->recv_buf_off += TCP_ENC_HDR_SIZE;
+
+        next_flag = 0;
+        ret = tcp_recv_new_msg(map, &new_header, &next_flag);
+        if (ret < 0 || !next_flag)
+        {
+            return (ret);
+        }
     }
 
-    if (ret < TCP_ENC_HDR_SIZE)
+    if (tcp_addr_data->recv_buf_len > tcp_addr_data->recv_buf_off)
     {
+        /* part of a header; the rest has not arrived yet */
         current_time = time(NULL);
         if (!tcp_addr_data->short_header_timer)
         {
@@ -3535,24 +3624,31 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
             tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-EPIPE));
             return (0);
         }
-
-	/* header not ready yet, but we will keep hoping */
-	return (0);
     }
 
-    tcp_addr_data->short_header_timer = 0;
-    *stall_flag = 0;
-    gossip_ldebug(GOSSIP_BMI_DEBUG_TCP, "Reading header for new op.\n");
-    ret = BMI_sockio_nbrecv(tcp_addr_data->socket,
-                            new_header.enc_hdr, 
-                            TCP_ENC_HDR_SIZE);
-    if (ret < TCP_ENC_HDR_SIZE)
-    {
-	tmp_errno = errno;
-	gossip_err("Error: BMI_sockio_nbrecv: %s\n", strerror(tmp_errno));
-	tcp_forget_addr(map, 0, bmi_tcp_errno_to_pvfs(-tmp_errno));
-	return (0);
-    }
+    return (0);
+}
+
+
+/* tcp_recv_new_msg()
+ *
+ * handles a message whose header has just been taken from the
+ * read-ahead buffer.  next_flag is set if the caller may go on to parse
+ * the following message; it is left clear when this message must wait
+ * for a matching receive post or the address has been shut down.
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int tcp_recv_new_msg(bmi_method_addr_p map,
+                            struct tcp_msg_header *hdr,
+                            int *next_flag)
+{
+    method_op_p active_method_op = NULL;
+    void *new_buffer = NULL;
+    struct op_list_search_key key;
+    struct tcp_msg_header new_header = *hdr;
+    struct tcp_op *tcp_op_data = NULL;
+    int tmp;
 
     /* decode the header */
     BMI_TCP_DEC_HDR(new_header);
@@ -3618,6 +3714,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
 	
         /* grab some data if we can */
+	*next_flag = 1;
 	return (work_on_recv_op(active_method_op, &tmp));
     }
 
@@ -3649,6 +3746,7 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 	active_method_op->env_amt_complete = TCP_ENC_HDR_SIZE;
 	active_method_op->actual_size = new_header.size;
 	op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
+	*next_flag = 1;
 	return (work_on_recv_op(active_method_op, &tmp));
     }
 
@@ -3696,9 +3794,12 @@ static int tcp_do_work_recv(bmi_method_addr_p map,
 
     op_list_add(op_list_array[IND_RECV_INFLIGHT], active_method_op);
 
-    /* grab some data if we can */
+    /* grab some data if we can; a rendezvous payload stays where it is
+     * (socket or read-ahead buffer) until the matching receive is posted
+     */
     if (new_header.mode == TCP_MODE_EAGER)
     {
+	*next_flag = 1;
 	return (work_on_recv_op(active_method_op, &tmp));
     }
 
@@ -3808,7 +3909,6 @@ static int work_on_recv_op(method_op_p my_method_op,
                            int *stall_flag)
 {
     int ret = -1;
-    struct tcp_addr *tcp_addr_data = my_method_op->addr->method_data;
     struct tcp_op *tcp_op_data = my_method_op->method_data;
 
     *stall_flag = 1;
@@ -3816,19 +3916,10 @@ static int work_on_recv_op(method_op_p my_method_op,
     if (my_method_op->actual_size != 0)
     {
 	/* now let's try to recv some actual data */
-	ret = payload_progress(tcp_addr_data->socket,
-	                       my_method_op->buffer_list,
-	                       my_method_op->size_list,
-	                       my_method_op->list_count,
-	                       my_method_op->actual_size,
-	                       &(my_method_op->list_index),
-	                       &(my_method_op->cur_index_complete),
-	                       BMI_RECV,
-	                       NULL,
-	                       0);
+	ret = tcp_recv_payload(my_method_op);
 	if (ret < 0)
 	{
-            PVFS_perror_gossip("Error: payload_progress", ret);
+            PVFS_perror_gossip("Error: tcp_recv_payload", ret);
             /* payload_progress() returns BMI error codes */
 	    tcp_forget_addr(my_method_op->addr, 0, ret);
 	    return (0);
@@ -4247,6 +4338,7 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
     PINT_event_id eid = 0;
 
 #if PINT_EVENT_ENABLED
+    bmi_size_t total_size = 0;
     int i = 0;
     for (; i < list_count; ++i)
     {
@@ -4385,6 +4477,74 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
 	return (ret);
     }
 
+    /* small messages are staged and written together with whatever
+     * else is posted to this peer before the next poll; skip this when
+     * another thread is already sitting in poll(), since nobody would
+     * flush the buffer until it returns.
+     */
+    if (!sc_test_busy &&
+        (TCP_ENC_HDR_SIZE + my_header.size) <= TCP_COALESCE_MSG_LIMIT)
+    {
+        ret = tcp_coalesce_stage(dest, buffer_list, size_list, list_count,
+                                 &my_header);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: tcp_coalesce_stage", ret);
+            tcp_forget_addr(dest, 0, ret);
+            PINT_EVENT_END(bmi_tcp_send_event_id, bmi_tcp_pid, NULL, eid,
+                           0, ret);
+            return (ret);
+        }
+        if (ret == 1)
+        {
+            PINT_EVENT_END(bmi_tcp_send_event_id, 
+                           bmi_tcp_pid,
+                           NULL, 
+                           eid, 
+                           0, 
+                           my_header.size);
+            return (1);
+        }
+    }
+
+    /* anything already staged must reach the socket before this message */
+    if (tcp_addr_data->coalesce_len)
+    {
+        ret = tcp_coalesce_flush(dest);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: tcp_coalesce_flush", ret);
+            tcp_forget_addr(dest, 0, ret);
+            PINT_EVENT_END(bmi_tcp_send_event_id, bmi_tcp_pid, NULL, eid,
+                           0, ret);
+            return (ret);
+        }
+        if (ret == 0)
+        {
+            ret = enqueue_operation(op_list_array[IND_SEND], 
+                                    BMI_SEND,
+                                    dest, 
+                                    (void **) buffer_list, 
+                                    size_list,
+                                    list_count, 
+                                    0, 
+                                    0,
+                                    id, 
+                                    BMI_TCP_INPROGRESS, 
+                                    my_header, 
+                                    user_ptr,
+                                    my_header.size, 
+                                    0,
+                                    context_id,
+                                    eid);
+            if (ret < 0)
+            {
+                gossip_err("Error: enqueue_operation() returned: %d\n", ret);
+            }
+            return (ret);
+        }
+    }
+
     /* try to send some data */
     env_amt_complete = 0;
     ret = payload_progress(tcp_addr_data->socket,
@@ -4447,6 +4607,333 @@ static int tcp_post_send_generic(bmi_op_id_t *id,
 }
 
 
+/* tcp_coalesce_stage()
+ *
+ * copies a small message (encoded header plus payload) into the
+ * coalesce buffer of its destination so that it can go out in the same
+ * send() as the messages around it.  The buffer is flushed right away
+ * once it fills up or its oldest message has waited TCP_COALESCE_USECS;
+ * otherwise tcp_do_work() flushes it before polling.
+ *
+ * returns 1 if the message was staged, 0 if it must be sent directly,
+ * -errno on failure
+ */
+static int tcp_coalesce_stage(bmi_method_addr_p map,
+                              const void *const *buffer_list,
+                              const bmi_size_t *size_list,
+                              int list_count,
+                              struct tcp_msg_header *my_header)
+{
+    struct tcp_addr *tcp_addr_data = map->method_data;
+    bmi_size_t msg_size = TCP_ENC_HDR_SIZE + my_header->size;
+    bmi_size_t remaining = my_header->size;
+    bmi_size_t copy_size = 0;
+    struct timeval now;
+    int ret = 0;
+    int i;
+
+    if (!tcp_addr_data->coalesce_buf)
+    {
+        tcp_addr_data->coalesce_buf = malloc(TCP_COALESCE_BUF_SIZE);
+        if (!tcp_addr_data->coalesce_buf)
+        {
+            /* not fatal; just send it the old way */
+            return (0);
+        }
+    }
+
+    if (tcp_addr_data->coalesce_len + msg_size > TCP_COALESCE_BUF_SIZE)
+    {
+        ret = tcp_coalesce_flush(map);
+        if (ret < 0)
+        {
+            return (ret);
+        }
+        /* slide a partially written remainder to the front */
+        if (tcp_addr_data->coalesce_sent)
+        {
+            memmove(tcp_addr_data->coalesce_buf,
+                    tcp_addr_data->coalesce_buf + tcp_addr_data->coalesce_sent,
+                    tcp_addr_data->coalesce_len - tcp_addr_data->coalesce_sent);
+            tcp_addr_data->coalesce_len -= tcp_addr_data->coalesce_sent;
+            tcp_addr_data->coalesce_sent = 0;
+        }
+        if (tcp_addr_data->coalesce_len + msg_size > TCP_COALESCE_BUF_SIZE)
+        {
+            return (0);
+        }
+    }
+
+    if (tcp_addr_data->coalesce_len == 0)
+    {
+        gettimeofday(&tcp_addr_data->coalesce_start, NULL);
+    }
+
+    memcpy(tcp_addr_data->coalesce_buf + tcp_addr_data->coalesce_len,
+           my_header->enc_hdr, TCP_ENC_HDR_SIZE);
+    tcp_addr_data->coalesce_len += TCP_ENC_HDR_SIZE;
+    for (i = 0; i < list_count && remaining > 0; i++)
+    {
+        copy_size = size_list[i];
+        if (copy_size > remaining)
+        {
+            copy_size = remaining;
+        }
+        memcpy(tcp_addr_data->coalesce_buf + tcp_addr_data->coalesce_len,
+               buffer_list[i], copy_size);
+        tcp_addr_data->coalesce_len += copy_size;
+        remaining -= copy_size;
+    }
+
+    if (!tcp_addr_data->coalesce_queued)
+    {
+        qlist_add_tail(&tcp_addr_data->coalesce_link, &tcp_coalesce_list);
+        tcp_addr_data->coalesce_queued = 1;
+    }
+
+    /* don't let a full buffer or an old message sit around */
+    if (tcp_addr_data->coalesce_len + TCP_ENC_HDR_SIZE > TCP_COALESCE_BUF_SIZE)
+    {
+        ret = tcp_coalesce_flush(map);
+    }
+    else
+    {
+        gettimeofday(&now, NULL);
+        if (((now.tv_sec - tcp_addr_data->coalesce_start.tv_sec) * 1000000 +
+             (now.tv_usec - tcp_addr_data->coalesce_start.tv_usec)) >=
+            TCP_COALESCE_USECS)
+        {
+            ret = tcp_coalesce_flush(map);
+        }
+    }
+
+    return ((ret < 0) ? ret : 1);
+}
+
+
+/* tcp_coalesce_flush()
+ *
+ * writes out as much of an address's coalesce buffer as the socket will
+ * take.  If some of it is left over, a write bit is held on the address
+ * so that tcp_do_work_send() finishes the job.
+ *
+ * returns 1 if the buffer is empty, 0 if data remains, -errno on failure
+ */
+static int tcp_coalesce_flush(bmi_method_addr_p map)
+{
+    struct tcp_addr *tcp_addr_data = map->method_data;
+    int ret;
+
+    if (tcp_addr_data->coalesce_sent < tcp_addr_data->coalesce_len)
+    {
+        ret = BMI_sockio_nbsend(tcp_addr_data->socket,
+                                tcp_addr_data->coalesce_buf +
+                                tcp_addr_data->coalesce_sent,
+                                tcp_addr_data->coalesce_len -
+                                tcp_addr_data->coalesce_sent);
+        if (ret < 0)
+        {
+            return (bmi_tcp_errno_to_pvfs(-errno));
+        }
+        gossip_ldebug(GOSSIP_BMI_DEBUG_TCP,
+                      "Sent: %d bytes of coalesced data.\n", ret);
+        tcp_addr_data->coalesce_sent += ret;
+    }
+
+    if (tcp_addr_data->coalesce_sent < tcp_addr_data->coalesce_len)
+    {
+        if (!tcp_addr_data->coalesce_write_bit)
+        {
+            BMI_socket_collection_add_write_bit(tcp_socket_collection_p, map);
+            tcp_addr_data->coalesce_write_bit = 1;
+        }
+        return (0);
+    }
+
+    tcp_addr_data->coalesce_len = 0;
+    tcp_addr_data->coalesce_sent = 0;
+    if (tcp_addr_data->coalesce_write_bit)
+    {
+        BMI_socket_collection_remove_write_bit(tcp_socket_collection_p, map);
+        tcp_addr_data->coalesce_write_bit = 0;
+    }
+    if (tcp_addr_data->coalesce_queued)
+    {
+        qlist_del(&tcp_addr_data->coalesce_link);
+        tcp_addr_data->coalesce_queued = 0;
+    }
+
+    return (1);
+}
+
+
+/* tcp_coalesce_flush_all()
+ *
+ * flushes every address with staged messages
+ *
+ * no return value
+ */
+static void tcp_coalesce_flush_all(void)
+{
+    struct qlist_head *iterator = NULL;
+    struct qlist_head *scratch = NULL;
+    struct tcp_addr *tcp_addr_data = NULL;
+    int ret;
+
+    qlist_for_each_safe(iterator, scratch, &tcp_coalesce_list)
+    {
+        tcp_addr_data = qlist_entry(iterator, struct tcp_addr, coalesce_link);
+        ret = tcp_coalesce_flush(tcp_addr_data->map);
+        if (ret < 0)
+        {
+            PVFS_perror_gossip("Error: tcp_coalesce_flush", ret);
+            tcp_forget_addr(tcp_addr_data->map, 0, ret);
+        }
+    }
+
+    return;
+}
+
+
+/* tcp_coalesce_drain()
+ *
+ * last attempt to write out staged messages before their socket is
+ * closed; those sends were already reported complete to the caller.
+ * Nothing is retried and the socket collection is left alone, since
+ * this also runs after the method has been finalized.
+ *
+ * no return value
+ */
+static void tcp_coalesce_drain(struct tcp_addr *tcp_addr_data)
+{
+    if (tcp_addr_data->coalesce_sent < tcp_addr_data->coalesce_len)
+    {
+        BMI_sockio_nbsend(tcp_addr_data->socket,
+                          tcp_addr_data->coalesce_buf +
+                          tcp_addr_data->coalesce_sent,
+                          tcp_addr_data->coalesce_len -
+                          tcp_addr_data->coalesce_sent);
+    }
+    tcp_addr_data->coalesce_len = 0;
+    tcp_addr_data->coalesce_sent = 0;
+
+    return;
+}
+
+
+/* tcp_recv_fill()
+ *
+ * reads whatever the socket has available into the address's read-ahead
+ * buffer, after any partial header already sitting there.
+ *
+ * returns number of bytes read, 0 if none were available, -errno on
+ * failure
+ */
+static int tcp_recv_fill(struct tcp_addr *tcp_addr_data)
+{
+    int ret;
+    int leftover = tcp_addr_data->recv_buf_len - tcp_addr_data->recv_buf_off;
+
+    if (!tcp_addr_data->recv_buf)
+    {
+        tcp_addr_data->recv_buf = malloc(TCP_RECV_BUF_SIZE);
+        if (!tcp_addr_data->recv_buf)
+        {
+            return (bmi_tcp_errno_to_pvfs(-ENOMEM));
+        }
+    }
+
+    if (tcp_addr_data->recv_buf_off)
+    {
+        memmove(tcp_addr_data->recv_buf,
+                tcp_addr_data->recv_buf + tcp_addr_data->recv_buf_off,
+                leftover);
+        tcp_addr_data->recv_buf_off = 0;
+        tcp_addr_data->recv_buf_len = leftover;
+    }
+
+    ret = BMI_sockio_nbrecv_avail(tcp_addr_data->socket,
+                                  tcp_addr_data->recv_buf + leftover,
+                                  TCP_RECV_BUF_SIZE - leftover);
+    if (ret < 0)
+    {
+        return (bmi_tcp_errno_to_pvfs(-errno));
+    }
+
+    tcp_addr_data->recv_buf_len += ret;
+    return (ret);
+}
+
+
+/* tcp_recv_payload()
+ *
+ * moves payload for a receive operation into its buffers, draining the
+ * read-ahead buffer first.  The socket is only read directly when the
+ * read-ahead buffer had nothing to offer, so that large payloads skip
+ * the extra copy.
+ *
+ * returns amount completed on success, -errno on failure
+ */
+static int tcp_recv_payload(method_op_p my_method_op)
+{
+    struct tcp_addr *tcp_addr_data = my_method_op->addr->method_data;
+    bmi_size_t remaining = my_method_op->actual_size -
+                           my_method_op->amt_complete;
+    bmi_size_t copy_size = 0;
+    int copied = 0;
+    int ret;
+
+    while (remaining > 0 &&
+           tcp_addr_data->recv_buf_off < tcp_addr_data->recv_buf_len &&
+           my_method_op->list_index < my_method_op->list_count)
+    {
+        copy_size = my_method_op->size_list[my_method_op->list_index] -
+                    my_method_op->cur_index_complete;
+        if (copy_size > remaining)
+        {
+            copy_size = remaining;
+        }
+        if (copy_size > (tcp_addr_data->recv_buf_len -
+                         tcp_addr_data->recv_buf_off))
+        {
+            copy_size = tcp_addr_data->recv_buf_len -
+                        tcp_addr_data->recv_buf_off;
+        }
+        memcpy((char *) my_method_op->buffer_list[my_method_op->list_index] +
+               my_method_op->cur_index_complete,
+               tcp_addr_data->recv_buf + tcp_addr_data->recv_buf_off,
+               copy_size);
+        tcp_addr_data->recv_buf_off += copy_size;
+        my_method_op->cur_index_complete += copy_size;
+        copied += copy_size;
+        remaining -= copy_size;
+        if (my_method_op->cur_index_complete ==
+            my_method_op->size_list[my_method_op->list_index])
+        {
+            my_method_op->list_index++;
+            my_method_op->cur_index_complete = 0;
+        }
+    }
+
+    if (copied || remaining == 0)
+    {
+        return (copied);
+    }
+
+    ret = payload_progress(tcp_addr_data->socket,
+                           my_method_op->buffer_list,
+                           my_method_op->size_list,
+                           my_method_op->list_count,
+                           my_method_op->actual_size,
+                           &(my_method_op->list_index),
+                           &(my_method_op->cur_index_complete),
+                           BMI_RECV,
+                           NULL,
+                           0);
+    return (ret);
+}
+
+
 /* payload_progress()
  *
  * makes progress on sending/recving data payload portion of a message
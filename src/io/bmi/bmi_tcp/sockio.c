@@ -252,6 +252,41 @@ int BMI_sockio_nbpeek(int s, void* buf, int len)
 }
 
 
+/* BMI_sockio_nbrecv_avail()
+ *
+ * performs a single nonblocking recv of up to len bytes, returning
+ * whatever the socket has buffered at the moment.  Unlike
+ * BMI_sockio_nbrecv() this does not keep reading until EWOULDBLOCK, so
+ * it costs exactly one system call.
+ *
+ * returns number of bytes read on success, 0 if nothing was available,
+ * -1 on failure (including a closed socket).
+ */
+int BMI_sockio_nbrecv_avail(int s, void *buf, int len)
+{
+    int ret;
+    assert(fcntl(s, F_GETFL, 0) & O_NONBLOCK);
+
+  nbrecv_avail_restart:
+    ret = recv(s, buf, len, DEFAULT_MSG_FLAGS);
+    if (ret == 0)
+    {
+        errno = EPIPE;
+        return (-1);
+    }
+    else if (ret == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+        return (0);
+    }
+    else if (ret == -1 && errno == EINTR)
+    {
+        goto nbrecv_avail_restart;
+    }
+
+    return (ret);
+}
+
+
 /* nonblocking send */
 /* should always return 0 when nothing gets done! */
 int BMI_sockio_nbsend(int s,
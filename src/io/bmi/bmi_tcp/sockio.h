@@ -62,6 +62,9 @@ int BMI_sockio_set_sockopt(int s,
 int BMI_sockio_nbpeek(int s,
 		      void* buf,
 		      int len);
+int BMI_sockio_nbrecv_avail(int s,
+			    void *buf,
+			    int len);
 #ifdef __USE_SENDFILE__
 int BMI_sockio_nbsendfile(int s,
 			  int f,
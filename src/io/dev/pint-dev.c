@@ -22,6 +22,8 @@
 #include <sys/ioctl.h>
 #include <sys/poll.h>
 #include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/un.h>
 #endif
 #include <assert.h>
 #ifndef WIN32
@@ -61,6 +63,13 @@ static int parse_devices(
     const char *targetfile,
     const char *devname, 
     int *majornum);
+
+static int replay_connect(
+    const char *sock_name);
+
+static void record_upcall(
+    pvfs2_upcall_t *upc,
+    int size);
 #endif  /* __linux__ */
 
 
@@ -69,6 +78,10 @@ static int32_t pdev_magic;
 #ifdef __linux__
 static int32_t pdev_max_upsize;
 static int32_t pdev_max_downsize;
+/* set when the "device" is an upcall replay harness socket */
+static int pdev_replay = 0;
+/* upcalls are appended here when recording is enabled */
+static int pdev_record_fd = -1;
 #endif  /* __linux__ */
 
 int32_t pvfs2_bufmap_total_size, pvfs2_bufmap_desc_size;
@@ -101,6 +114,11 @@ int PINT_dev_initialize(
         debug_string = "none";
     }
 
+    if (flags & PINT_DEV_REPLAY)
+    {
+        return replay_connect(dev_name);
+    }
+
     /* we have to be root to access the device */
     if ((getuid() != 0) && (geteuid() != 0))
     {
@@ -268,6 +286,14 @@ out:
  */
 void PINT_dev_finalize(void)
 {
+#ifdef __linux__
+    if (pdev_record_fd > -1)
+    {
+        close(pdev_record_fd);
+        pdev_record_fd = -1;
+    }
+    pdev_replay = 0;
+#endif
     if (pdev_fd > -1)
     {
 #ifdef WIN32
@@ -333,9 +359,10 @@ int PINT_dev_get_mapped_regions(int ndesc, struct PVFS_dev_map_desc *desc,
         memset(ptr, 0, total_size);
 
         /* fixes a corruption issue on linux 2.4 kernels where the buffers are
-         * not being pinned in memory properly 
+         * not being pinned in memory properly; a replay harness never
+         * touches these pages, so don't ask for locked memory there
          */
-        if(mlock( (const char *) ptr, total_size) != 0)
+        if(!pdev_replay && mlock( (const char *) ptr, total_size) != 0)
         { 
            gossip_err("Error: FAILED to mlock shared buffer\n");
            break;
@@ -355,7 +382,7 @@ int PINT_dev_get_mapped_regions(int ndesc, struct PVFS_dev_map_desc *desc,
         /* ioctl to ask driver to map pages if needed */
         if (ioctl_cmd[i] != 0)
         {
-            ret = ioctl(pdev_fd, ioctl_cmd[i], &desc[i]);
+            ret = (pdev_replay ? 0 : ioctl(pdev_fd, ioctl_cmd[i], &desc[i]));
             if (ret < 0)
             {
                 gossip_err("Error: ioctl FAILED returned %d\n", errno);
@@ -574,6 +601,14 @@ int PINT_dev_test_unexpected(
             goto dev_test_unexp_error;
         }
 
+        if ((ret == 0) && pdev_replay)
+        {
+            /* unlike the device, a harness can hang up */
+            gossip_err("Error: upcall replay harness disconnected.\n");
+            free(buffer);
+            return -(PVFS_ENODEV|PVFS_ERROR_DEV);
+        }
+
         if (ret == 0)
         {   
             /* assume we are done and return */
@@ -640,6 +675,16 @@ int PINT_dev_test_unexpected(
                 ret = -(PVFS_ENOMEM|PVFS_ERROR_DEV);
                 goto dev_test_unexp_error;
             }
+            if (pdev_replay)
+            {
+                /*
+                  the device queues the trailer with its upcall, but a
+                  harness sends it as a separate packet that may not
+                  have arrived yet
+                */
+                pfd.revents = 0;
+                poll(&pfd, 1, -1);
+            }
             ret = read(pdev_fd, upc->trailer_buf, upc->trailer_size);
             if (ret < 0)
             {
@@ -648,6 +693,11 @@ int PINT_dev_test_unexpected(
             }
         }
 
+        if (pdev_record_fd > -1)
+        {
+            record_upcall(upc, info_array[*outcount].size);
+        }
+
         (*outcount)++;
 
         /*
@@ -811,6 +861,22 @@ int PINT_dev_write_list(
     free(buffer);
 #else
     ret = writev(pdev_fd, io_array, io_count);
+#ifdef __linux__
+    while ((ret < 0) && pdev_replay && (errno == EAGAIN || errno == EINTR))
+    {
+        /*
+          the device always takes a downcall, but a harness socket can
+          be full for a moment; wait instead of losing the reply
+        */
+        struct pollfd pfd;
+
+        pfd.fd = pdev_fd;
+        pfd.events = POLLOUT;
+        pfd.revents = 0;
+        poll(&pfd, 1, -1);
+        ret = writev(pdev_fd, io_array, io_count);
+    }
+#endif  /* __linux__ */
 #endif
 
     if (ret == bytes_to_write) {
@@ -836,6 +902,11 @@ int PINT_dev_remount(void)
     int ret = -PVFS_EINVAL;
 
 #ifdef __linux__
+    if (pdev_replay)
+    {
+        /* nothing is mounted; the harness sends its own mount upcalls */
+        return 0;
+    }
     if (pdev_fd > -1)
     {
         ret = ((ioctl(pdev_fd, PVFS_DEV_REMOUNT_ALL, NULL) < 0) ?
@@ -849,6 +920,49 @@ int PINT_dev_remount(void)
     return ret;
 }
 
+/* PINT_dev_record_upcalls()
+ *
+ * appends every upcall subsequently read from the device, along with
+ * its trailer, to the file at path so that the stream can be fed back
+ * to a client later by an upcall replay harness
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+int PINT_dev_record_upcalls(const char *path)
+{
+#ifdef __linux__
+    struct PINT_dev_record_header header;
+    int fd;
+
+    fd = open(path, (O_WRONLY | O_CREAT | O_TRUNC | O_APPEND), 0600);
+    if (fd < 0)
+    {
+        gossip_err("Error: could not open upcall record file %s\n", path);
+        return -PVFS_errno_to_error(errno);
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, PINT_DEV_RECORD_MAGIC, sizeof(header.magic));
+    header.proto_ver = PVFS_KERNEL_PROTO_VERSION;
+    header.upcall_size = sizeof(pvfs2_upcall_t);
+    if (write(fd, &header, sizeof(header)) != sizeof(header))
+    {
+        gossip_err("Error: could not write upcall record header\n");
+        close(fd);
+        return -PVFS_EIO;
+    }
+
+    if (pdev_record_fd > -1)
+    {
+        close(pdev_record_fd);
+    }
+    pdev_record_fd = fd;
+    return 0;
+#else
+    return -PVFS_ENOSYS;
+#endif  /* __linux__ */
+}
+
 /* PINT_dev_write()
  *
  * writes a buffer into the device
@@ -1024,6 +1138,116 @@ static int parse_devices(
     fclose(devfile);
     return 0;
 }
+
+/* replay_connect()
+ *
+ * connects to an upcall replay harness listening on the unix socket
+ * sock_name and takes the device parameters from its hello message
+ *
+ * returns 0 on success, -PVFS_error on failure
+ */
+static int replay_connect(const char *sock_name)
+{
+    struct sockaddr_un addr;
+    struct PINT_dev_replay_hello hello;
+    int ret = -1;
+
+    if (strlen(sock_name) >= sizeof(addr.sun_path))
+    {
+        return -(PVFS_ENAMETOOLONG|PVFS_ERROR_DEV);
+    }
+
+    pdev_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (pdev_fd < 0)
+    {
+        return -(PVFS_ENODEV|PVFS_ERROR_DEV);
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, sock_name);
+    if (connect(pdev_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        gossip_err("Error: could not connect to replay socket %s\n",
+                   sock_name);
+        goto replay_error;
+    }
+
+    /* block for the hello, then switch to the device's semantics */
+    do
+    {
+        ret = read(pdev_fd, &hello, sizeof(hello));
+    } while ((ret < 0) && (errno == EINTR));
+
+    if (ret != sizeof(hello))
+    {
+        gossip_err("Error: short hello from replay harness.\n");
+        goto replay_error;
+    }
+
+    if (hello.max_upsize < (2 * sizeof(int32_t) + sizeof(uint64_t) +
+                            sizeof(pvfs2_upcall_t)))
+    {
+        gossip_err("Error: replay harness upcall size %d is too small.\n",
+                   hello.max_upsize);
+        goto replay_error;
+    }
+
+    if (fcntl(pdev_fd, F_SETFL, O_NONBLOCK) < 0)
+    {
+        goto replay_error;
+    }
+
+    pdev_magic = hello.magic;
+    pdev_max_upsize = hello.max_upsize;
+    pdev_max_downsize = hello.max_downsize;
+    pdev_replay = 1;
+
+    gossip_debug(GOSSIP_USER_DEV_DEBUG,
+                 "[DEV]: replaying upcalls from %s\n", sock_name);
+    return 0;
+
+replay_error:
+    close(pdev_fd);
+    pdev_fd = -1;
+    return -(PVFS_ENODEV|PVFS_ERROR_DEV);
+}
+
+/* record_upcall()
+ *
+ * appends one upcall and its trailer to the recording file; recording
+ * stops on the first failure rather than disturbing the client
+ */
+static void record_upcall(pvfs2_upcall_t *upc, int size)
+{
+    struct PINT_dev_upcall_record rec;
+    struct iovec iov[3];
+    int count = 2;
+    ssize_t total;
+
+    rec.upcall_size = size;
+    rec.trailer_size = (upc->trailer_size > 0 ? upc->trailer_size : 0);
+
+    iov[0].iov_base = &rec;
+    iov[0].iov_len = sizeof(rec);
+    iov[1].iov_base = upc;
+    iov[1].iov_len = size;
+    total = iov[0].iov_len + iov[1].iov_len;
+    if (rec.trailer_size)
+    {
+        iov[2].iov_base = upc->trailer_buf;
+        iov[2].iov_len = rec.trailer_size;
+        total += iov[2].iov_len;
+        count++;
+    }
+
+    if (writev(pdev_record_fd, iov, count) != total)
+    {
+        gossip_err("Error: upcall recording failed; recording stopped.\n");
+        close(pdev_record_fd);
+        pdev_record_fd = -1;
+    }
+}
 #endif  /* __linux__ */
 
 /*
@@ -60,6 +60,42 @@ struct PINT_dev_params
     uint64_t dev_buffer_size;
 };
 
+/* flags accepted by PINT_dev_initialize() */
+#define PINT_DEV_REPLAY 0x1 /* dev_name is a replay harness socket */
+
+/*
+ * sent by an upcall replay harness when the client connects to its
+ * SOCK_SEQPACKET socket; stands in for the device parameter ioctls.
+ * Upcalls and downcalls then use the same framing as the device.
+ */
+struct PINT_dev_replay_hello
+{
+    int32_t magic;
+    int32_t max_upsize;
+    int32_t max_downsize;
+    int32_t reserved;
+};
+
+/*
+ * upcall recording file layout: one PINT_dev_record_header, followed
+ * by a PINT_dev_upcall_record and its upcall and trailer bytes for
+ * every upcall read from the device
+ */
+#define PINT_DEV_RECORD_MAGIC "PVFSUPC1"
+
+struct PINT_dev_record_header
+{
+    char magic[8];
+    int32_t proto_ver;
+    int32_t upcall_size;
+};
+
+struct PINT_dev_upcall_record
+{
+    uint32_t upcall_size;
+    uint32_t trailer_size;
+};
+
 int PINT_dev_initialize(
     const char* dev_name,
     int flags);
@@ -101,6 +137,7 @@ int PINT_dev_write(
     enum PINT_dev_buffer_type buffer_type,
     PVFS_id_gen_t tag);
 
+int PINT_dev_record_upcalls(const char *path);
 int PINT_dev_remount(void);
 void *PINT_dev_memalloc(int size);
 void PINT_dev_memfree(void* buffer, int size);
@@ -17,12 +17,15 @@
 #include "gossip.h"
 #include "id-generator.h"
 #include "pint-util.h"
+#include "pint-perf-counter.h"
 #include "pvfs2-internal.h"
 
 #ifdef WIN32
 typedef enum job_type job_type_t;
 #endif
 
+PINT_event_type job_desc_event_id;
+
 /***************************************************************
  * Visible functions
  */
@@ -52,6 +55,16 @@ struct job_desc *alloc_job_desc(int type)
     jd->type = type;
 #endif
 
+    PINT_EVENT_START(job_desc_event_id, 0, NULL, &jd->event_id, type);
+
+#ifdef __PVFS2_SERVER__
+    if (PINT_server_tpc &&
+        (type == JOB_BMI || type == JOB_TROVE || type == JOB_FLOW))
+    {
+        PINT_perf_timer_start(&jd->start_time);
+    }
+#endif
+
     return (jd);
 };
 
@@ -63,6 +76,29 @@ struct job_desc *alloc_job_desc(int type)
  */
 void dealloc_job_desc(struct job_desc *jd)
 {
+    PINT_EVENT_END(job_desc_event_id, 0, NULL, jd->event_id, 0);
+#ifdef __PVFS2_SERVER__
+    if (PINT_server_tpc && (jd->start_time.tv_sec || jd->start_time.tv_nsec))
+    {
+        switch (jd->type)
+        {
+        case JOB_BMI:
+            PINT_perf_timer_end(PINT_server_tpc, PINT_PERF_TBMI,
+                                &jd->start_time);
+            break;
+        case JOB_TROVE:
+            PINT_perf_timer_end(PINT_server_tpc, PINT_PERF_TTROVE,
+                                &jd->start_time);
+            break;
+        case JOB_FLOW:
+            PINT_perf_timer_end(PINT_server_tpc, PINT_PERF_TFLOW,
+                                &jd->start_time);
+            break;
+        default:
+            break;
+        }
+    }
+#endif
     id_gen_safe_unregister(jd->job_id);
     free(jd);
 }
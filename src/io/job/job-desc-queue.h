@@ -18,6 +18,7 @@
 #include "trove-types.h"
 #include "src/server/request-scheduler/request-scheduler.h"
 #include "thread-mgr.h"
+#include "pint-event.h"
 
 /* describes BMI operations */
 struct bmi_desc
@@ -126,6 +127,8 @@ struct job_desc
     struct PINT_thread_mgr_bmi_callback bmi_callback;  /* callback information */
     struct PINT_thread_mgr_trove_callback trove_callback;  /* callback information */
     PVFS_hint hints;
+    PINT_event_id event_id;     /* spans allocation to deallocation */
+    struct timespec start_time; /* for the server's job timers */
 
     /* union of information for lower level interfaces */
     union
@@ -148,6 +151,9 @@ struct job_desc
 
 typedef struct qlist_head *job_desc_q_p;
 
+/* event recorded over the lifetime of each job descriptor */
+extern PINT_event_type job_desc_event_id;
+
 struct job_desc *alloc_job_desc(int type);
 void dealloc_job_desc(struct job_desc *jd);
 job_desc_q_p job_desc_q_new(void);
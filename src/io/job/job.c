@@ -220,6 +220,11 @@ int job_initialize(int flags)
 
     id_gen_safe_initialize();
 
+    /* START: (job type)
+     *   END: ()
+     */
+    PINT_event_define_event(NULL, "job", "%d", "", &job_desc_event_id);
+
     gen_mutex_lock(&initialized_mutex);
     initialized = 1;
     gen_mutex_unlock(&initialized_mutex);
@@ -1051,6 +1056,7 @@ int job_req_sched_post(enum PVFS_server_op op,
                        PVFS_handle handle,
                        enum PINT_server_req_access_type access_type,
                        enum PINT_server_sched_policy sched_policy,
+                       const struct PINT_req_sched_share *share,
                        void *user_ptr,
                        job_aint status_user_tag,
                        job_status_s * out_status_p,
@@ -1082,7 +1088,8 @@ int job_req_sched_post(enum PVFS_server_op op,
     jd->status_user_tag = status_user_tag;
 
     ret = PINT_req_sched_post(
-        op, fs_id, handle, access_type, sched_policy, jd, &(jd->u.req_sched.id));
+        op, fs_id, handle, access_type, sched_policy, share, jd,
+        &(jd->u.req_sched.id));
 
     if (ret < 0)
     {
@@ -189,6 +189,7 @@ int job_req_sched_post(enum PVFS_server_op op,
                        PVFS_handle handle,
                        enum PINT_server_req_access_type access_type,
                        enum PINT_server_sched_policy sched_policy,
+                       const struct PINT_req_sched_share *share,
 		       void *user_ptr,
 		       job_aint status_user_tag,
 		       job_status_s * out_status_p,
@@ -29,11 +29,15 @@
 #include "dbpf-attr-cache.h"
 #include "dbpf-bstream.h"
 #include "dbpf-sync.h"
+#include "dbpf-timestamp-log.h"
+#include "dbpf-bstream-packed.h"
 /* #include "pint-mem.h" obsolete */
 #include "pint-mgmt.h"
 #include "pint-context.h"
 #include "pint-op.h"
 
+/* size updates rewrite the whole dspace record, so they also hold
+ * dbpf_timestamp_log_flush_mutex, taken first */
 static gen_mutex_t dbpf_update_size_lock = GEN_MUTEX_INITIALIZER;
 static gen_mutex_t grow_bstream_table_lock = GEN_MUTEX_INITIALIZER;
 
@@ -929,6 +933,7 @@ static int dbpf_bstream_direct_write_op_svc(void *ptr, PVFS_hint hint)
     {
         int outcount;
 
+        gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
         gen_mutex_lock(&dbpf_update_size_lock);
         ret = dbpf_dspace_attr_get(qop_p->op.coll_p, ref, &attr);
         if(ret != 0)
@@ -936,6 +941,7 @@ static int dbpf_bstream_direct_write_op_svc(void *ptr, PVFS_hint hint)
             gossip_err("%s: failed to get size from dspace attr: (error=%d)\n",
                        __func__, ret);
             gen_mutex_unlock(&dbpf_update_size_lock);
+            gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
             grow_bstream_handle_release_lock( ref );
             goto cache_put;
         }
@@ -950,12 +956,14 @@ static int dbpf_bstream_direct_write_op_svc(void *ptr, PVFS_hint hint)
                 gossip_err("%s: failed to update size in dspace attr: "
                            "(error=%d)\n", __func__, ret);
                 gen_mutex_unlock(&dbpf_update_size_lock);
+                gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
                 grow_bstream_handle_release_lock( ref );
                 goto cache_put;
             }
             sync_required = 1;
         }
         gen_mutex_unlock(&dbpf_update_size_lock);
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
 
         if(sync_required == 1)
         {
@@ -1115,6 +1123,14 @@ static int dbpf_bstream_direct_read_list(TROVE_coll_id coll_id,
     op->mem_size_array = mem_size_array;
     op->queued_op_ptr = q_op_p;
 
+    /* direct I/O only works on bstream files */
+    ret = dbpf_bstream_packed_unpack(coll_p, handle);
+    if(ret < 0)
+    {
+        dbpf_queued_op_free(q_op_p);
+        return ret;
+    }
+
     ret = dbpf_open_cache_get(
         coll_id, handle,
         DBPF_FD_DIRECT_READ,
@@ -1203,6 +1219,14 @@ static int dbpf_bstream_direct_write_list(TROVE_coll_id coll_id,
     op->mem_size_array = mem_size_array;
     op->queued_op_ptr = q_op_p;
 
+    /* direct I/O only works on bstream files */
+    ret = dbpf_bstream_packed_unpack(coll_p, handle);
+    if(ret < 0)
+    {
+        dbpf_queued_op_free(q_op_p);
+        return ret;
+    }
+
     ret = dbpf_open_cache_get(
         coll_id, handle,
         DBPF_FD_DIRECT_WRITE,
@@ -1237,11 +1261,13 @@ static int dbpf_bstream_direct_resize_op_svc(struct dbpf_op *op_p)
     ref.fs_id = op_p->coll_p->coll_id;
     ref.handle = op_p->handle;
 
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
     gen_mutex_lock(&dbpf_update_size_lock);
     ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
     if(ret != 0)
     {
         gen_mutex_unlock(&dbpf_update_size_lock);
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
         return ret;
     }
 
@@ -1252,9 +1278,11 @@ static int dbpf_bstream_direct_resize_op_svc(struct dbpf_op *op_p)
     if(ret < 0)
     {
         gen_mutex_unlock(&dbpf_update_size_lock);
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
         return ret;
     }
     gen_mutex_unlock(&dbpf_update_size_lock);
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
 
     /* setup op for sync coalescing */
     dbpf_queued_op_init(q_op_p,
@@ -1267,6 +1295,12 @@ static int dbpf_bstream_direct_resize_op_svc(struct dbpf_op *op_p)
                         q_op_p->op.context_id);
     q_op_p->op.state = OP_IN_SERVICE;
 
+    ret = dbpf_bstream_packed_unpack(op_p->coll_p, ref.handle);
+    if(ret < 0)
+    {
+        return ret;
+    }
+
     /* truncate file after attributes are set */
     ret = dbpf_open_cache_get(
         op_p->coll_p->coll_id, op_p->handle,
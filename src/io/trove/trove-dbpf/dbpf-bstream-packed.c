@@ -0,0 +1,1384 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Packed bstream store.
+ *
+ * Every bstream normally lives in its own file under the collection's
+ * bstream bucket directories, which costs an inode, a directory entry
+ * and at least one block per datafile even when it only holds a few
+ * bytes.  When PackedBstreamMaxSize is set, bstreams that stay at or
+ * below that size are instead appended as records to large container
+ * files under packed-bstreams/.  The packed bstream db maps each such
+ * handle to the container, offset and length of its newest record;
+ * older records are dead space.
+ *
+ * Records are never updated in place: a write merges the old contents
+ * with the new data and appends a fresh record.  Once a bstream grows
+ * past the limit it is copied out to an ordinary bstream file and its
+ * entry dropped, after which the usual aio path takes over.  Closed
+ * containers that are mostly dead are compacted a step at a time by
+ * moving their live records to the active container, then unlinked.
+ *
+ * A bstream file always wins over an index entry: promotion writes and
+ * syncs the file under a temporary name in packed-bstreams/, renames it
+ * into place and only then drops the entry, and if the store was not
+ * closed cleanly any entry that still has a file is discarded on open.
+ */
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <aio.h>
+
+#include "gossip.h"
+#include "pvfs2-debug.h"
+#include "trove.h"
+#include "trove-internal.h"
+#include "dbpf.h"
+#include "dbpf-open-cache.h"
+#include "dbpf-bstream-packed.h"
+
+extern struct server_configuration_s *server_cfg;
+
+#define PACKED_BSTREAM_STATE_STRING "packed_bstream_state"
+#define PACKED_RECORD_MAGIC 0x7061636bU
+
+/* header written in front of every record in a container */
+struct dbpf_packed_record
+{
+    uint32_t magic;
+    uint32_t length;
+    TROVE_handle handle;
+};
+
+/* value stored in the packed bstream db, keyed by handle */
+struct dbpf_packed_extent
+{
+    uint32_t container;
+    uint32_t length;
+    uint64_t offset;    /* start of the record data */
+};
+
+struct dbpf_packed_container
+{
+    int fd;
+    int broken;         /* unreadable record found; never compacted */
+    int dirty;          /* records appended since the last sync */
+    uint64_t size;
+    uint64_t live;      /* header and data bytes still referenced */
+};
+
+struct dbpf_packed_store
+{
+    gen_mutex_t mutex;
+    dbpf_db *db;
+    int max;            /* bstreams past this are promoted; 0 packs none */
+    uint32_t active;
+    uint32_t count;
+    struct dbpf_packed_container *containers;
+    int compacting;     /* container being compacted, or -1 */
+    uint64_t compact_off;
+};
+
+/* state of a read or write walking the request's memory and stream
+ * regions */
+struct packed_io
+{
+    struct dbpf_packed_store *st;
+    struct dbpf_packed_extent ext;
+    TROVE_size b_size;
+    TROVE_size *out_size_p;
+    char *buf;
+    int fd;
+};
+
+typedef int (*packed_piece_fn)(
+    struct packed_io *io, char *mem, TROVE_offset pos, TROVE_size len);
+
+#define PACKED_RECORD_SPACE(__len) \
+    ((uint64_t)sizeof(struct dbpf_packed_record) + (__len))
+
+static int packed_grow(struct dbpf_packed_store *st, uint32_t count)
+{
+    struct dbpf_packed_container *tmp;
+    uint32_t i;
+
+    if (count <= st->count)
+    {
+        return 0;
+    }
+    tmp = realloc(st->containers, count * sizeof(*tmp));
+    if (!tmp)
+    {
+        return -TROVE_ENOMEM;
+    }
+    for (i = st->count; i < count; i++)
+    {
+        memset(&tmp[i], 0, sizeof(tmp[i]));
+        tmp[i].fd = -1;
+    }
+    st->containers = tmp;
+    st->count = count;
+    return 0;
+}
+
+static int packed_container_open(struct dbpf_collection *coll_p,
+                                 struct dbpf_packed_store *st,
+                                 uint32_t id,
+                                 int create)
+{
+    char path[PATH_MAX];
+    struct stat statbuf;
+    struct dbpf_packed_container *c;
+    int ret;
+
+    ret = packed_grow(st, id + 1);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    c = &st->containers[id];
+
+    DBPF_GET_PACKED_CONTAINER_FILENAME(path, PATH_MAX,
+                                       my_storage_p->data_path,
+                                       coll_p->coll_id, id);
+    c->fd = open(path, O_RDWR | (create ? O_CREAT|O_EXCL : 0),
+                 TROVE_FD_MODE);
+    if (c->fd < 0 || fstat(c->fd, &statbuf) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("%s: failed to open container %s\n", __func__, path);
+        if (c->fd > -1)
+        {
+            close(c->fd);
+            c->fd = -1;
+        }
+        return ret;
+    }
+    c->size = statbuf.st_size;
+    c->live = 0;
+    return 0;
+}
+
+static void packed_container_unlink(struct dbpf_collection *coll_p,
+                                    struct dbpf_packed_store *st,
+                                    uint32_t id)
+{
+    char path[PATH_MAX];
+    struct dbpf_packed_container *c = &st->containers[id];
+
+    DBPF_GET_PACKED_CONTAINER_FILENAME(path, PATH_MAX,
+                                       my_storage_p->data_path,
+                                       coll_p->coll_id, id);
+    gossip_debug(GOSSIP_TROVE_DEBUG, "packed: removing container %s\n",
+                 path);
+    close(c->fd);
+    c->fd = -1;
+    c->size = 0;
+    c->live = 0;
+    if (unlink(path) != 0)
+    {
+        gossip_err("%s: failed to unlink %s: %s\n", __func__, path,
+                   strerror(errno));
+    }
+}
+
+static int packed_lookup(struct dbpf_packed_store *st,
+                         TROVE_handle handle,
+                         struct dbpf_packed_extent *ext)
+{
+    struct dbpf_data key, data;
+    int ret;
+
+    key.data = &handle;
+    key.len = sizeof(handle);
+    data.data = ext;
+    data.len = sizeof(*ext);
+
+    ret = dbpf_db_get(st->db, &key, &data);
+    if (ret == 0 && ext->container >= st->count)
+    {
+        gossip_err("%s: handle %llu refers to unknown container %u\n",
+                   __func__, llu(handle), ext->container);
+        return -TROVE_EIO;
+    }
+    return -ret;
+}
+
+static int packed_store_ext(struct dbpf_packed_store *st,
+                            TROVE_handle handle,
+                            struct dbpf_packed_extent *ext)
+{
+    struct dbpf_data key, data;
+
+    key.data = &handle;
+    key.len = sizeof(handle);
+    data.data = ext;
+    data.len = sizeof(*ext);
+    return -dbpf_db_put(st->db, &key, &data);
+}
+
+static int packed_drop_ext(struct dbpf_packed_store *st,
+                           TROVE_handle handle,
+                           struct dbpf_packed_extent *ext)
+{
+    struct dbpf_data key;
+    int ret;
+
+    key.data = &handle;
+    key.len = sizeof(handle);
+    ret = dbpf_db_del(st->db, &key);
+    if (ret != 0)
+    {
+        return -ret;
+    }
+    st->containers[ext->container].live -= PACKED_RECORD_SPACE(ext->length);
+    return 0;
+}
+
+static int packed_bstream_exists(struct dbpf_collection *coll_p,
+                                 TROVE_handle handle)
+{
+    char path[PATH_MAX];
+
+    DBPF_GET_BSTREAM_FILENAME(path, PATH_MAX, my_storage_p->data_path,
+                              coll_p->coll_id, llu(handle));
+    return (access(path, F_OK) == 0);
+}
+
+static int packed_read_data(struct dbpf_packed_store *st,
+                            struct dbpf_packed_extent *ext,
+                            char *buf,
+                            uint64_t off,
+                            uint64_t len)
+{
+    int ret;
+
+    ret = dbpf_pread(st->containers[ext->container].fd, buf, len,
+                     ext->offset + off);
+    if (ret < 0)
+    {
+        return -trove_errno_to_trove_error(errno);
+    }
+    if ((uint64_t)ret != len)
+    {
+        gossip_err("%s: short read from container %u\n", __func__,
+                   ext->container);
+        return -TROVE_EIO;
+    }
+    return 0;
+}
+
+/* packed_append()
+ *
+ * writes a new record to the end of the active container, starting a
+ * new container once the active one is full
+ */
+static int packed_append(struct dbpf_collection *coll_p,
+                         struct dbpf_packed_store *st,
+                         TROVE_handle handle,
+                         char *buf,
+                         uint32_t len,
+                         struct dbpf_packed_extent *ext)
+{
+    struct dbpf_packed_container *c = NULL;
+    struct dbpf_packed_record rec;
+    int ret;
+
+    if (st->count)
+    {
+        c = &st->containers[st->active];
+    }
+    if (!c || c->fd < 0 ||
+        (c->size && c->size + PACKED_RECORD_SPACE(len) >
+                    DBPF_PACKED_CONTAINER_SIZE))
+    {
+        ret = packed_container_open(coll_p, st, st->count, 1);
+        if (ret < 0)
+        {
+            return ret;
+        }
+        st->active = st->count - 1;
+        c = &st->containers[st->active];
+    }
+
+    rec.magic = PACKED_RECORD_MAGIC;
+    rec.length = len;
+    rec.handle = handle;
+    ret = dbpf_pwrite(c->fd, &rec, sizeof(rec), c->size);
+    if (ret >= 0 && len)
+    {
+        ret = dbpf_pwrite(c->fd, buf, len, c->size + sizeof(rec));
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    c->dirty = 1;
+    ext->container = st->active;
+    ext->offset = c->size + sizeof(rec);
+    ext->length = len;
+    c->size += PACKED_RECORD_SPACE(len);
+    c->live += PACKED_RECORD_SPACE(len);
+    return 0;
+}
+
+/* packed_promote()
+ *
+ * copies a packed bstream out to its own bstream file and drops it from
+ * the index
+ */
+static int packed_promote(struct dbpf_collection *coll_p,
+                          struct dbpf_packed_store *st,
+                          TROVE_handle handle,
+                          struct dbpf_packed_extent *ext)
+{
+    char path[PATH_MAX], tmp_path[PATH_MAX];
+    TROVE_object_ref obj = {handle, coll_p->coll_id};
+    TROVE_ds_attributes attr;
+    char *buf = NULL, *slash;
+    int fd, dir_fd, ret = 0;
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "packed: promoting handle %llu "
+                 "(%u bytes)\n", llu(handle), ext->length);
+
+    if (ext->length)
+    {
+        buf = malloc(ext->length);
+        if (!buf)
+        {
+            return -TROVE_ENOMEM;
+        }
+        ret = packed_read_data(st, ext, buf, 0, ext->length);
+        if (ret < 0)
+        {
+            free(buf);
+            return ret;
+        }
+    }
+
+    /* the file must be complete before it appears under its real name,
+     * since on open after a crash its existence alone drops the entry */
+    DBPF_GET_BSTREAM_FILENAME(path, PATH_MAX, my_storage_p->data_path,
+                              coll_p->coll_id, llu(handle));
+    DBPF_GET_PACKED_PROMOTE_FILENAME(tmp_path, PATH_MAX,
+                                     my_storage_p->data_path,
+                                     coll_p->coll_id, llu(handle));
+    fd = open(tmp_path, O_RDWR | O_CREAT | O_TRUNC, TROVE_FD_MODE);
+    if (fd < 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("%s: failed to create %s\n", __func__, tmp_path);
+        free(buf);
+        return ret;
+    }
+    if (buf)
+    {
+        ret = dbpf_pwrite(fd, buf, ext->length, 0);
+        free(buf);
+    }
+
+    /* keep the file as long as the bstream; the tail of a packed
+     * bstream past its record reads as zeroes */
+    if (ret >= 0 && dbpf_dspace_attr_get(coll_p, obj, &attr) == 0 &&
+        attr.u.datafile.b_size > ext->length &&
+        ftruncate(fd, attr.u.datafile.b_size) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    if (ret >= 0 && fdatasync(fd) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    close(fd);
+    if (ret >= 0 && rename(tmp_path, path) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("%s: failed to rename %s to %s\n", __func__, tmp_path,
+                   path);
+    }
+    if (ret < 0)
+    {
+        unlink(tmp_path);
+        return ret;
+    }
+
+    /* make the new name durable before the entry can go */
+    slash = strrchr(path, '/');
+    *slash = '\0';
+    dir_fd = open(path, O_RDONLY);
+    if (dir_fd < 0 || fsync(dir_fd) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    if (dir_fd > -1)
+    {
+        close(dir_fd);
+    }
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    return packed_drop_ext(st, handle, ext);
+}
+
+/* packed_compact_step()
+ *
+ * moves up to DBPF_PACKED_COMPACT_STEP bytes of live records out of the
+ * mostly dead container being compacted, choosing one if needed, and
+ * removes the container once nothing in it is referenced
+ */
+static void packed_compact_step(struct dbpf_collection *coll_p,
+                                struct dbpf_packed_store *st)
+{
+    struct dbpf_packed_container *c;
+    struct dbpf_packed_record rec;
+    struct dbpf_packed_extent ext, new_ext;
+    uint64_t moved = 0;
+    char *buf;
+    uint32_t i;
+    int ret;
+
+    if (st->compacting < 0)
+    {
+        for (i = 0; i < st->count; i++)
+        {
+            c = &st->containers[i];
+            if (i != st->active && c->fd > -1 && !c->broken && c->size &&
+                (c->size - c->live) * 100 >=
+                c->size * DBPF_PACKED_COMPACT_PERCENT)
+            {
+                st->compacting = i;
+                st->compact_off = 0;
+                break;
+            }
+        }
+        if (st->compacting < 0)
+        {
+            return;
+        }
+        gossip_debug(GOSSIP_TROVE_DEBUG, "packed: compacting container %d "
+                     "(%llu of %llu bytes live)\n", st->compacting,
+                     llu(st->containers[st->compacting].live),
+                     llu(st->containers[st->compacting].size));
+    }
+    c = &st->containers[st->compacting];
+
+    while (c->live && st->compact_off < c->size &&
+           moved < DBPF_PACKED_COMPACT_STEP)
+    {
+        ret = dbpf_pread(c->fd, &rec, sizeof(rec), st->compact_off);
+        if (ret != sizeof(rec) || rec.magic != PACKED_RECORD_MAGIC)
+        {
+            gossip_err("%s: bad record at offset %llu of container %d; "
+                       "leaving it in place\n", __func__,
+                       llu(st->compact_off), st->compacting);
+            c->broken = 1;
+            st->compacting = -1;
+            return;
+        }
+
+        ret = packed_lookup(st, rec.handle, &ext);
+        if (ret == 0 && ext.container == (uint32_t)st->compacting &&
+            ext.offset == st->compact_off + sizeof(rec))
+        {
+            buf = malloc(ext.length ? ext.length : 1);
+            if (!buf)
+            {
+                return;
+            }
+            ret = packed_read_data(st, &ext, buf, 0, ext.length);
+            if (ret == 0)
+            {
+                ret = packed_append(coll_p, st, rec.handle, buf,
+                                    ext.length, &new_ext);
+            }
+            free(buf);
+            if (ret == 0)
+            {
+                ret = packed_store_ext(st, rec.handle, &new_ext);
+            }
+            if (ret < 0)
+            {
+                gossip_err("%s: failed to move handle %llu: %d\n",
+                           __func__, llu(rec.handle), ret);
+                return;
+            }
+            /* starting a new active container may have moved the array */
+            c = &st->containers[st->compacting];
+            c->live -= PACKED_RECORD_SPACE(ext.length);
+            moved += PACKED_RECORD_SPACE(ext.length);
+        }
+        st->compact_off += PACKED_RECORD_SPACE(rec.length);
+    }
+
+    if (c->live && st->compact_off < c->size)
+    {
+        return;
+    }
+    if (c->live)
+    {
+        gossip_err("%s: container %d still has %llu live bytes after a "
+                   "full pass; leaving it in place\n", __func__,
+                   st->compacting, llu(c->live));
+        c->broken = 1;
+        st->compacting = -1;
+        return;
+    }
+
+    /* the moved records must be durable before their old copies go;
+     * the active container may have rolled over while they moved, so
+     * every container written since its last sync is synced */
+    for (i = 0; i < st->count; i++)
+    {
+        c = &st->containers[i];
+        if (c->dirty && c->fd > -1 && i != (uint32_t)st->compacting)
+        {
+            if (fdatasync(c->fd) != 0)
+            {
+                gossip_err("%s: sync of container %u failed; keeping "
+                           "container %d\n", __func__, i, st->compacting);
+                st->compacting = -1;
+                return;
+            }
+            c->dirty = 0;
+        }
+    }
+    if (dbpf_db_sync(st->db) != 0)
+    {
+        gossip_err("%s: sync failed; keeping container %d\n", __func__,
+                   st->compacting);
+        st->compacting = -1;
+        return;
+    }
+    packed_container_unlink(coll_p, st, st->compacting);
+    st->compacting = -1;
+}
+
+/* packed_walk()
+ *
+ * calls fn for each piece of the request where a memory region and a
+ * stream region line up
+ */
+static int packed_walk(struct dbpf_bstream_rw_list_op *rw_op,
+                       packed_piece_fn fn,
+                       struct packed_io *io)
+{
+    int mi = 0, si = 0, ret;
+    TROVE_size moff = 0, soff = 0, len;
+
+    while (mi < rw_op->mem_array_count && si < rw_op->stream_array_count)
+    {
+        len = rw_op->mem_size_array[mi] - moff;
+        if (len > rw_op->stream_size_array[si] - soff)
+        {
+            len = rw_op->stream_size_array[si] - soff;
+        }
+        if (len > 0)
+        {
+            ret = fn(io, rw_op->mem_offset_array[mi] + moff,
+                     rw_op->stream_offset_array[si] + soff, len);
+            if (ret < 0)
+            {
+                return ret;
+            }
+        }
+        moff += len;
+        soff += len;
+        if (moff >= rw_op->mem_size_array[mi])
+        {
+            mi++;
+            moff = 0;
+        }
+        if (soff >= rw_op->stream_size_array[si])
+        {
+            si++;
+            soff = 0;
+        }
+    }
+    return 0;
+}
+
+static int packed_read_piece(struct packed_io *io, char *mem,
+                             TROVE_offset pos, TROVE_size len)
+{
+    TROVE_size held = 0;
+    int ret;
+
+    if (pos >= io->b_size)
+    {
+        return 0;
+    }
+    if (pos + len > io->b_size)
+    {
+        len = io->b_size - pos;
+    }
+    if (pos < io->ext.length)
+    {
+        held = io->ext.length - pos;
+        if (held > len)
+        {
+            held = len;
+        }
+        ret = packed_read_data(io->st, &io->ext, mem, pos, held);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    memset(mem + held, 0, len - held);
+    *io->out_size_p += len;
+    return 0;
+}
+
+static int packed_merge_piece(struct packed_io *io, char *mem,
+                              TROVE_offset pos, TROVE_size len)
+{
+    memcpy(io->buf + pos, mem, len);
+    *io->out_size_p += len;
+    return 0;
+}
+
+static int packed_file_read_piece(struct packed_io *io, char *mem,
+                                  TROVE_offset pos, TROVE_size len)
+{
+    int ret;
+
+    ret = dbpf_pread(io->fd, mem, len, pos);
+    if (ret < 0)
+    {
+        return -trove_errno_to_trove_error(errno);
+    }
+    *io->out_size_p += ret;
+    return 0;
+}
+
+static int packed_file_write_piece(struct packed_io *io, char *mem,
+                                   TROVE_offset pos, TROVE_size len)
+{
+    int ret;
+
+    ret = dbpf_pwrite(io->fd, mem, len, pos);
+    if (ret < 0)
+    {
+        return ret;
+    }
+    *io->out_size_p += ret;
+    return 0;
+}
+
+static TROVE_offset packed_end_of_request(TROVE_offset *stream_offset_array,
+                                          TROVE_size *stream_size_array,
+                                          int stream_count)
+{
+    TROVE_offset eor = 0;
+    int i;
+
+    for (i = 0; i < stream_count; i++)
+    {
+        if (eor < stream_offset_array[i] + stream_size_array[i])
+        {
+            eor = stream_offset_array[i] + stream_size_array[i];
+        }
+    }
+    return eor;
+}
+
+/* dbpf_bstream_packed_open()
+ *
+ * opens the packed store of a collection if it has one, or creates it
+ * if create is set; rebuilds the live byte count of every container
+ * from the index
+ */
+int dbpf_bstream_packed_open(struct dbpf_collection *coll_p, int create)
+{
+    char path[PATH_MAX], tmp_path[PATH_MAX];
+    struct dbpf_packed_store *st;
+    struct dbpf_cursor *dbc;
+    struct dbpf_data key, data;
+    struct dbpf_packed_extent ext;
+    TROVE_handle handle;
+    DIR *dir;
+    struct dirent *dirent;
+    unsigned int id;
+    unsigned long long promoted;
+    char tail;
+    int32_t state = 0;
+    int exists, ret, dropped = 0;
+
+    if (coll_p->packed)
+    {
+        return 0;
+    }
+
+    DBPF_GET_PACKED_BSTREAM_DBNAME(path, PATH_MAX, my_storage_p->meta_path,
+                                   coll_p->coll_id);
+    exists = (access(path, F_OK) == 0);
+    if (!exists && !create)
+    {
+        return 0;
+    }
+
+    st = calloc(1, sizeof(*st));
+    if (!st)
+    {
+        return -TROVE_ENOMEM;
+    }
+    gen_mutex_init(&st->mutex);
+    st->compacting = -1;
+
+    ret = dbpf_db_open(path, DBPF_DB_COMPARE_DS_ATTR, &st->db, !exists,
+                       server_cfg);
+    if (ret)
+    {
+        gossip_err("%s: failed to open %s\n", __func__, path);
+        free(st);
+        return -ret;
+    }
+
+    DBPF_GET_PACKED_BSTREAM_DIRNAME(path, PATH_MAX, my_storage_p->data_path,
+                                    coll_p->coll_id);
+    if (mkdir(path, 0755) != 0 && errno != EEXIST)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        gossip_err("%s: mkdir failed on %s\n", __func__, path);
+        goto error;
+    }
+
+    dir = opendir(path);
+    if (!dir)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+        goto error;
+    }
+    while ((dirent = readdir(dir)))
+    {
+        if (sscanf(dirent->d_name, "%llx.promot%c", &promoted,
+                   &tail) == 2 && tail == 'e')
+        {
+            /* a promotion that never got renamed into place; the
+             * entry still holds the data */
+            snprintf(tmp_path, PATH_MAX, "%s/%s", path, dirent->d_name);
+            unlink(tmp_path);
+            continue;
+        }
+        if (sscanf(dirent->d_name, "%08x.pac%c", &id, &tail) != 2 ||
+            tail != 'k')
+        {
+            continue;
+        }
+        ret = packed_container_open(coll_p, st, id, 0);
+        if (ret < 0)
+        {
+            closedir(dir);
+            goto error;
+        }
+    }
+    closedir(dir);
+    st->active = st->count ? st->count - 1 : 0;
+
+    /* a store that was not closed cleanly may hold entries whose
+     * promotion finished but whose removal never reached the db */
+    key.data = PACKED_BSTREAM_STATE_STRING;
+    key.len = strlen(PACKED_BSTREAM_STATE_STRING);
+    data.data = &state;
+    data.len = sizeof(state);
+    if (exists && dbpf_db_get(coll_p->coll_attr_db, &key, &data) != 0)
+    {
+        state = 1;
+    }
+
+    ret = dbpf_db_cursor(st->db, &dbc, 0);
+    if (ret)
+    {
+        ret = -ret;
+        goto error;
+    }
+    key.data = &handle;
+    key.len = sizeof(handle);
+    data.data = &ext;
+    data.len = sizeof(ext);
+    ret = dbpf_db_cursor_get(dbc, &key, &data, DBPF_DB_CURSOR_FIRST,
+                             sizeof(handle));
+    while (ret == 0)
+    {
+        if (ext.container >= st->count ||
+            st->containers[ext.container].fd < 0)
+        {
+            gossip_err("%s: dropping handle %llu from missing container "
+                       "%u\n", __func__, llu(handle), ext.container);
+            dbpf_db_cursor_del(dbc);
+            dropped++;
+        }
+        else if (state && packed_bstream_exists(coll_p, handle))
+        {
+            dbpf_db_cursor_del(dbc);
+            dropped++;
+        }
+        else
+        {
+            st->containers[ext.container].live +=
+                PACKED_RECORD_SPACE(ext.length);
+        }
+        key.len = sizeof(handle);
+        data.len = sizeof(ext);
+        ret = dbpf_db_cursor_get(dbc, &key, &data, DBPF_DB_CURSOR_NEXT,
+                                 sizeof(handle));
+    }
+    dbpf_db_cursor_close(dbc);
+    if (ret != TROVE_ENOENT)
+    {
+        ret = -ret;
+        goto error;
+    }
+
+    /* mark the store open until it is closed cleanly */
+    state = 1;
+    key.data = PACKED_BSTREAM_STATE_STRING;
+    key.len = strlen(PACKED_BSTREAM_STATE_STRING);
+    data.data = &state;
+    data.len = sizeof(state);
+    ret = dbpf_db_put(coll_p->coll_attr_db, &key, &data);
+    if (ret == 0)
+    {
+        ret = dbpf_db_sync(coll_p->coll_attr_db);
+    }
+    if (ret)
+    {
+        ret = -ret;
+        goto error;
+    }
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "packed: collection %08x has %u "
+                 "containers (%d stale entries dropped)\n",
+                 coll_p->coll_id, st->count, dropped);
+    coll_p->packed = st;
+    return 0;
+
+error:
+    for (id = 0; id < st->count; id++)
+    {
+        if (st->containers[id].fd > -1)
+        {
+            close(st->containers[id].fd);
+        }
+    }
+    free(st->containers);
+    dbpf_db_close(st->db);
+    free(st);
+    return ret;
+}
+
+void dbpf_bstream_packed_close(struct dbpf_collection *coll_p)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_data key, data;
+    int32_t state = 0;
+    uint32_t i;
+    int clean = 1;
+
+    if (!st)
+    {
+        return;
+    }
+
+    for (i = 0; i < st->count; i++)
+    {
+        if (st->containers[i].fd > -1)
+        {
+            if (fdatasync(st->containers[i].fd) != 0)
+            {
+                clean = 0;
+            }
+            close(st->containers[i].fd);
+        }
+    }
+    if (dbpf_db_sync(st->db) != 0)
+    {
+        clean = 0;
+    }
+    dbpf_db_close(st->db);
+
+    if (clean && coll_p->coll_attr_db)
+    {
+        key.data = PACKED_BSTREAM_STATE_STRING;
+        key.len = strlen(PACKED_BSTREAM_STATE_STRING);
+        data.data = &state;
+        data.len = sizeof(state);
+        if (dbpf_db_put(coll_p->coll_attr_db, &key, &data) == 0)
+        {
+            dbpf_db_sync(coll_p->coll_attr_db);
+        }
+    }
+
+    gen_mutex_destroy(&st->mutex);
+    free(st->containers);
+    free(st);
+    coll_p->packed = NULL;
+}
+
+int dbpf_bstream_packed_set_max(struct dbpf_collection *coll_p, int max)
+{
+    int ret;
+
+    if (max < 0)
+    {
+        max = 0;
+    }
+    if (max > DBPF_PACKED_MAX_LIMIT)
+    {
+        gossip_err("PackedBstreamMaxSize %d is too large; using %d\n",
+                   max, DBPF_PACKED_MAX_LIMIT);
+        max = DBPF_PACKED_MAX_LIMIT;
+    }
+
+    if (max > 0 && !coll_p->packed)
+    {
+        ret = dbpf_bstream_packed_open(coll_p, 1);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    if (coll_p->packed)
+    {
+        gen_mutex_lock(&coll_p->packed->mutex);
+        coll_p->packed->max = max;
+        gen_mutex_unlock(&coll_p->packed->mutex);
+    }
+    return 0;
+}
+
+/* dbpf_bstream_packed_route()
+ *
+ * decides at post time whether a read or write list goes to the packed
+ * store.  Returns 1 if it should be serviced by dbpf_bstream_packed_rw()
+ * and 0 if the bstream file should be used; writes that outgrow a packed
+ * bstream promote it here so the aio path finds the file.
+ */
+int dbpf_bstream_packed_route(struct dbpf_collection *coll_p,
+                              TROVE_handle handle,
+                              int opcode,
+                              TROVE_offset *stream_offset_array,
+                              TROVE_size *stream_size_array,
+                              int stream_count)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    struct open_cache_ref ref;
+    TROVE_offset eor = 0;
+    int ret;
+
+    if (!st)
+    {
+        return 0;
+    }
+    if (opcode == LIO_WRITE)
+    {
+        eor = packed_end_of_request(stream_offset_array, stream_size_array,
+                                    stream_count);
+    }
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &ext);
+    if (ret == 0)
+    {
+        if (opcode == LIO_READ || eor <= st->max)
+        {
+            ret = 1;
+        }
+        else
+        {
+            ret = packed_promote(coll_p, st, handle, &ext);
+        }
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+        if (opcode == LIO_WRITE && st->max > 0)
+        {
+            if (eor > st->max)
+            {
+                /* create the file while holding the lock so that a
+                 * small write to the same handle cannot pack it */
+                ret = dbpf_open_cache_get(coll_p->coll_id, handle,
+                                          DBPF_FD_BUFFERED_WRITE, &ref);
+                if (ret == 0)
+                {
+                    dbpf_open_cache_put(&ref);
+                }
+            }
+            else if (!packed_bstream_exists(coll_p, handle))
+            {
+                ret = 1;
+            }
+        }
+    }
+    gen_mutex_unlock(&st->mutex);
+    return ret;
+}
+
+/* dbpf_bstream_packed_rw()
+ *
+ * services a read or write list routed to the packed store.  The
+ * decision is repeated under the lock since the bstream may have been
+ * promoted since it was posted; in that case the file is used directly.
+ */
+int dbpf_bstream_packed_rw(struct dbpf_collection *coll_p,
+                           TROVE_handle handle,
+                           struct dbpf_bstream_rw_list_op *rw_op,
+                           TROVE_size b_size,
+                           TROVE_ds_flags flags)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent new_ext;
+    struct open_cache_ref ref;
+    struct packed_io io;
+    int write = (rw_op->opcode == LIO_WRITE);
+    int found, packed, ret;
+    uint64_t len;
+    TROVE_offset eor;
+
+    memset(&io, 0, sizeof(io));
+    io.st = st;
+    io.b_size = b_size;
+    io.out_size_p = rw_op->out_size_p;
+    *rw_op->out_size_p = 0;
+
+    eor = packed_end_of_request(rw_op->stream_offset_array,
+                                rw_op->stream_size_array,
+                                rw_op->stream_array_count);
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &io.ext);
+    if (ret < 0 && ret != -TROVE_ENOENT)
+    {
+        goto out;
+    }
+    found = (ret == 0);
+    packed = found;
+    if (write && found && eor > st->max)
+    {
+        ret = packed_promote(coll_p, st, handle, &io.ext);
+        if (ret < 0)
+        {
+            goto out;
+        }
+        packed = 0;
+    }
+    else if (write && !found)
+    {
+        packed = (st->max > 0 && eor <= st->max &&
+                  !packed_bstream_exists(coll_p, handle));
+    }
+
+    if (!packed)
+    {
+        /* open (and for writes create) the file before dropping the lock */
+        ret = dbpf_open_cache_get(
+            coll_p->coll_id, handle,
+            write ? DBPF_FD_BUFFERED_WRITE : DBPF_FD_BUFFERED_READ, &ref);
+        gen_mutex_unlock(&st->mutex);
+        if (ret < 0)
+        {
+            /* bstreams are created lazily; nothing written reads empty */
+            return (ret == -TROVE_ENOENT && !write) ? 0 : ret;
+        }
+        io.fd = ref.fd;
+        ret = packed_walk(rw_op, write ? packed_file_write_piece :
+                          packed_file_read_piece, &io);
+        if (ret == 0 && write && (flags & TROVE_SYNC) &&
+            fdatasync(ref.fd) != 0)
+        {
+            ret = -trove_errno_to_trove_error(errno);
+        }
+        dbpf_open_cache_put(&ref);
+        return ret;
+    }
+
+    if (!write)
+    {
+        ret = packed_walk(rw_op, packed_read_piece, &io);
+        goto out;
+    }
+
+    /* merge the write into a copy of the record and append it */
+    len = found ? io.ext.length : 0;
+    if ((uint64_t)eor > len)
+    {
+        len = eor;
+    }
+    io.buf = malloc(len ? len : 1);
+    if (!io.buf)
+    {
+        ret = -TROVE_ENOMEM;
+        goto out;
+    }
+    if (found && io.ext.length)
+    {
+        ret = packed_read_data(st, &io.ext, io.buf, 0, io.ext.length);
+        if (ret < 0)
+        {
+            goto out;
+        }
+    }
+    memset(io.buf + (found ? io.ext.length : 0), 0,
+           len - (found ? io.ext.length : 0));
+    ret = packed_walk(rw_op, packed_merge_piece, &io);
+    if (ret == 0)
+    {
+        ret = packed_append(coll_p, st, handle, io.buf, len, &new_ext);
+    }
+    if (ret == 0 && (flags & TROVE_SYNC) &&
+        fdatasync(st->containers[new_ext.container].fd) != 0)
+    {
+        ret = -trove_errno_to_trove_error(errno);
+    }
+    if (ret == 0)
+    {
+        ret = packed_store_ext(st, handle, &new_ext);
+    }
+    if (ret == 0 && (flags & TROVE_SYNC))
+    {
+        ret = -dbpf_db_sync(st->db);
+    }
+    if (ret == 0 && found)
+    {
+        st->containers[io.ext.container].live -=
+            PACKED_RECORD_SPACE(io.ext.length);
+        packed_compact_step(coll_p, st);
+    }
+
+out:
+    gen_mutex_unlock(&st->mutex);
+    free(io.buf);
+    if (ret < 0)
+    {
+        *rw_op->out_size_p = 0;
+    }
+    return ret;
+}
+
+/* dbpf_bstream_packed_resize()
+ *
+ * returns 1 if the bstream is packed and was resized in place, 0 if the
+ * caller should truncate the bstream file
+ */
+int dbpf_bstream_packed_resize(struct dbpf_collection *coll_p,
+                               TROVE_handle handle,
+                               TROVE_size size)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    int ret;
+
+    if (!st)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &ext);
+    if (ret == 0)
+    {
+        if (size > st->max)
+        {
+            ret = packed_promote(coll_p, st, handle, &ext);
+        }
+        else if (size < ext.length)
+        {
+            /* the tail of the record becomes dead space */
+            st->containers[ext.container].live -= ext.length - size;
+            ext.length = size;
+            ret = packed_store_ext(st, handle, &ext);
+            ret = (ret < 0) ? ret : 1;
+        }
+        else
+        {
+            ret = 1;
+        }
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+        if (st->max > 0 && size <= st->max &&
+            !packed_bstream_exists(coll_p, handle))
+        {
+            /* an empty record stands in for the file ftruncate would
+             * have created */
+            ret = packed_append(coll_p, st, handle, NULL, 0, &ext);
+            if (ret == 0)
+            {
+                ret = packed_store_ext(st, handle, &ext);
+            }
+            ret = (ret < 0) ? ret : 1;
+        }
+    }
+    gen_mutex_unlock(&st->mutex);
+    return ret;
+}
+
+/* dbpf_bstream_packed_flush()
+ *
+ * returns 1 if the bstream is packed and its container was synced, 0 if
+ * the caller should sync the bstream file
+ */
+int dbpf_bstream_packed_flush(struct dbpf_collection *coll_p,
+                              TROVE_handle handle)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    int ret;
+
+    if (!st)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &ext);
+    if (ret == 0)
+    {
+        ret = 1;
+        if (fdatasync(st->containers[ext.container].fd) != 0)
+        {
+            ret = -trove_errno_to_trove_error(errno);
+        }
+        else if (dbpf_db_sync(st->db) != 0)
+        {
+            ret = -TROVE_EIO;
+        }
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+    }
+    gen_mutex_unlock(&st->mutex);
+    return ret;
+}
+
+/* dbpf_bstream_packed_unpack()
+ *
+ * promotes a packed bstream to its own file, if it is packed; used by
+ * methods that only work on bstream files
+ */
+int dbpf_bstream_packed_unpack(struct dbpf_collection *coll_p,
+                               TROVE_handle handle)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    int ret;
+
+    if (!st)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &ext);
+    if (ret == 0)
+    {
+        ret = packed_promote(coll_p, st, handle, &ext);
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+    }
+    gen_mutex_unlock(&st->mutex);
+    return ret;
+}
+
+int dbpf_bstream_packed_remove(struct dbpf_collection *coll_p,
+                               TROVE_handle handle)
+{
+    struct dbpf_packed_store *st = coll_p->packed;
+    struct dbpf_packed_extent ext;
+    int ret;
+
+    if (!st)
+    {
+        return 0;
+    }
+
+    gen_mutex_lock(&st->mutex);
+    ret = packed_lookup(st, handle, &ext);
+    if (ret == 0)
+    {
+        ret = packed_drop_ext(st, handle, &ext);
+        packed_compact_step(coll_p, st);
+    }
+    else if (ret == -TROVE_ENOENT)
+    {
+        ret = 0;
+    }
+    gen_mutex_unlock(&st->mutex);
+    return ret;
+}
+
+static void packed_remove_tree(char *path)
+{
+    char tmp_path[PATH_MAX];
+    DIR *dir;
+    struct dirent *dirent;
+
+    if (unlink(path) == 0 || errno == ENOENT)
+    {
+        return;
+    }
+    dir = opendir(path);
+    if (dir)
+    {
+        while ((dirent = readdir(dir)))
+        {
+            if (strcmp(dirent->d_name, ".") && strcmp(dirent->d_name, ".."))
+            {
+                snprintf(tmp_path, PATH_MAX, "%s/%s", path, dirent->d_name);
+                unlink(tmp_path);
+            }
+        }
+        closedir(dir);
+    }
+    if (rmdir(path) != 0)
+    {
+        gossip_err("failure removing %s: %s\n", path, strerror(errno));
+    }
+}
+
+/* dbpf_bstream_packed_destroy()
+ *
+ * removes the containers and index of a collection being removed; the
+ * store must already be closed
+ */
+int dbpf_bstream_packed_destroy(TROVE_coll_id coll_id)
+{
+    char path[PATH_MAX];
+
+    DBPF_GET_PACKED_BSTREAM_DIRNAME(path, PATH_MAX, my_storage_p->data_path,
+                                    coll_id);
+    packed_remove_tree(path);
+    DBPF_GET_PACKED_BSTREAM_DBNAME(path, PATH_MAX, my_storage_p->meta_path,
+                                   coll_id);
+    packed_remove_tree(path);
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,78 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __DBPF_BSTREAM_PACKED_H__
+#define __DBPF_BSTREAM_PACKED_H__
+
+#include "pvfs2-internal.h"
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+#include "trove.h"
+#include "dbpf.h"
+
+/* container files are rolled over once they reach this size */
+#define DBPF_PACKED_CONTAINER_SIZE (64*1024*1024)
+
+/* largest bstream that may be configured to stay packed */
+#define DBPF_PACKED_MAX_LIMIT (4*1024*1024)
+
+/* a closed container is compacted once this percentage of it is dead */
+#define DBPF_PACKED_COMPACT_PERCENT 50
+
+/* bytes of records moved out of a container per compaction step */
+#define DBPF_PACKED_COMPACT_STEP (1024*1024)
+
+int dbpf_bstream_packed_open(struct dbpf_collection *coll_p, int create);
+
+void dbpf_bstream_packed_close(struct dbpf_collection *coll_p);
+
+int dbpf_bstream_packed_set_max(struct dbpf_collection *coll_p, int max);
+
+int dbpf_bstream_packed_route(struct dbpf_collection *coll_p,
+                              TROVE_handle handle,
+                              int opcode,
+                              TROVE_offset *stream_offset_array,
+                              TROVE_size *stream_size_array,
+                              int stream_count);
+
+int dbpf_bstream_packed_rw(struct dbpf_collection *coll_p,
+                           TROVE_handle handle,
+                           struct dbpf_bstream_rw_list_op *rw_op,
+                           TROVE_size b_size,
+                           TROVE_ds_flags flags);
+
+int dbpf_bstream_packed_resize(struct dbpf_collection *coll_p,
+                               TROVE_handle handle,
+                               TROVE_size size);
+
+int dbpf_bstream_packed_flush(struct dbpf_collection *coll_p,
+                              TROVE_handle handle);
+
+int dbpf_bstream_packed_unpack(struct dbpf_collection *coll_p,
+                               TROVE_handle handle);
+
+int dbpf_bstream_packed_remove(struct dbpf_collection *coll_p,
+                               TROVE_handle handle);
+
+int dbpf_bstream_packed_destroy(TROVE_coll_id coll_id);
+
+#if defined(__cplusplus)
+}
+#endif
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
+
+#endif
@@ -27,8 +27,10 @@
 #include "pint-event.h"
 #include "dbpf-open-cache.h"
 #include "dbpf-sync.h"
+#include "dbpf-timestamp-log.h"
 
 #include "dbpf-alt-aio.h"
+#include "dbpf-bstream-packed.h"
 
 extern gen_mutex_t dbpf_attr_cache_mutex;
 
@@ -38,6 +40,8 @@ extern int TROVE_max_concurrent_io;
 static int s_dbpf_ios_in_progress = 0;
 static dbpf_op_queue_p s_dbpf_io_ready_queue = NULL;
 static gen_mutex_t s_dbpf_io_mutex = GEN_MUTEX_INITIALIZER;
+/* size updates rewrite the whole dspace record, so they also hold
+ * dbpf_timestamp_log_flush_mutex, taken first */
 static gen_mutex_t dbpf_update_size_lock = GEN_MUTEX_INITIALIZER;
 
 static struct dbpf_aio_ops aio_ops;
@@ -60,6 +64,7 @@ static char *list_proc_state_strings[] __attribute__((unused)) = {
 static int dbpf_bstream_rw_list_op_svc(struct dbpf_op *op_p);
 #endif
 static int dbpf_bstream_flush_op_svc(struct dbpf_op *op_p);
+static int dbpf_bstream_packed_rw_op_svc(struct dbpf_op *op_p);
 
 #ifdef __PVFS2_TROVE_AIO_THREADED__
 #include "dbpf-thread.h"
@@ -168,11 +173,13 @@ static void aio_progress_notification(union sigval sig)
             ref.fs_id = op_p->coll_p->coll_id;
             ref.handle = op_p->handle;
 
+            gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
             gen_mutex_lock(&dbpf_update_size_lock);
             ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
             if(ret != 0)
             {
                 gen_mutex_unlock(&dbpf_update_size_lock);
+                gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
                 goto error_in_cleanup;
             }
 
@@ -184,6 +191,7 @@ static void aio_progress_notification(union sigval sig)
                 if(ret != 0)
                 {
                     gen_mutex_unlock(&dbpf_update_size_lock);
+                    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
                     goto error_in_cleanup;
                 }
                 if(op_p->flags & TROVE_SYNC)
@@ -192,6 +200,7 @@ static void aio_progress_notification(union sigval sig)
                 }
             }
             gen_mutex_unlock(&dbpf_update_size_lock);
+            gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
         }
 
 error_in_cleanup:
@@ -592,6 +601,12 @@ static int dbpf_bstream_flush_op_svc(struct dbpf_op *op_p)
     int ret = -TROVE_EINVAL, got_fd = 0;
     struct open_cache_ref tmp_ref;
 
+    ret = dbpf_bstream_packed_flush(op_p->coll_p, op_p->handle);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
     ret = dbpf_open_cache_get(
         op_p->coll_p->coll_id, op_p->handle,
         DBPF_FD_BUFFERED_WRITE, &tmp_ref);
@@ -618,6 +633,75 @@ return_error:
     return ret;
 }
 
+/* dbpf_bstream_packed_rw_op_svc()
+ *
+ * services a read or write list of a bstream kept in the packed store,
+ * then updates the bstream size the same way aio completion does
+ */
+static int dbpf_bstream_packed_rw_op_svc(struct dbpf_op *op_p)
+{
+    int ret, j;
+    TROVE_ds_attributes attr;
+    TROVE_object_ref ref;
+    TROVE_offset eor = 0;
+    dbpf_queued_op_t *q_op_p;
+
+    q_op_p = (dbpf_queued_op_t *)op_p->u.b_rw_list.queued_op_ptr;
+
+    ref.fs_id = op_p->coll_p->coll_id;
+    ref.handle = op_p->handle;
+
+    ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    ret = dbpf_bstream_packed_rw(op_p->coll_p, op_p->handle,
+                                 &op_p->u.b_rw_list,
+                                 attr.u.datafile.b_size, op_p->flags);
+    if (ret < 0 || op_p->u.b_rw_list.opcode != LIO_WRITE)
+    {
+        return (ret < 0) ? ret : DBPF_OP_COMPLETE;
+    }
+
+    for (j = 0; j < op_p->u.b_rw_list.stream_array_count; j++)
+    {
+        if (eor < op_p->u.b_rw_list.stream_offset_array[j] +
+            op_p->u.b_rw_list.stream_size_array[j])
+        {
+            eor = op_p->u.b_rw_list.stream_offset_array[j] +
+                op_p->u.b_rw_list.stream_size_array[j];
+        }
+    }
+
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
+    gen_mutex_lock(&dbpf_update_size_lock);
+    ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
+    if (ret == 0 && eor > attr.u.datafile.b_size)
+    {
+        attr.u.datafile.b_size = eor;
+        ret = dbpf_dspace_attr_set(op_p->coll_p, ref, &attr);
+        if (ret == 0 && (op_p->flags & TROVE_SYNC))
+        {
+            /* let the coalescing path sync the size update */
+            dbpf_queued_op_init(q_op_p,
+                                DSPACE_SETATTR,
+                                ref.handle,
+                                q_op_p->op.coll_p,
+                                dbpf_dspace_setattr_op_svc,
+                                q_op_p->op.user_ptr,
+                                TROVE_SYNC,
+                                q_op_p->op.context_id);
+            q_op_p->op.state = OP_IN_SERVICE;
+        }
+    }
+    gen_mutex_unlock(&dbpf_update_size_lock);
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
+
+    return (ret < 0) ? ret : DBPF_OP_COMPLETE;
+}
+
 int dbpf_bstream_validate(TROVE_coll_id coll_id,
                           TROVE_handle handle,
                           TROVE_ds_flags flags,
@@ -861,6 +945,35 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
 
     q_op_p->op.u.b_rw_list.list_proc_state = LIST_PROC_INITIALIZED;
 
+    /*
+      if we're doing an i/o write, remove the cached attribute for
+      this handle if it's present
+    */
+    if (opcode == LIO_WRITE)
+    {
+        TROVE_object_ref ref = {handle, coll_id};
+        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_remove(ref);
+        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+    }
+
+    /* small bstreams may live in the packed store instead of a file */
+    ret = dbpf_bstream_packed_route(coll_p, handle, opcode,
+                                    stream_offset_array, stream_size_array,
+                                    stream_count);
+    if (ret < 0)
+    {
+        dbpf_queued_op_free(q_op_p);
+        return ret;
+    }
+    if (ret == 1)
+    {
+        q_op_p->op.svc_fn = dbpf_bstream_packed_rw_op_svc;
+        q_op_p->op.u.b_rw_list.queued_op_ptr = (void *)q_op_p;
+        *out_op_id_p = dbpf_queued_op_queue(q_op_p);
+        return 0;
+    }
+
     ret = dbpf_open_cache_get(
         coll_id, handle, 
         (opcode == LIO_WRITE) ? DBPF_FD_BUFFERED_WRITE : DBPF_FD_BUFFERED_READ, 
@@ -874,18 +987,6 @@ inline int dbpf_bstream_rw_list(TROVE_coll_id coll_id,
     }
     q_op_p->op.u.b_rw_list.fd = q_op_p->op.u.b_rw_list.open_ref.fd;
 
-    /*
-      if we're doing an i/o write, remove the cached attribute for
-      this handle if it's present
-    */
-    if (opcode == LIO_WRITE)
-    {
-        TROVE_object_ref ref = {handle, coll_id};
-        gen_mutex_lock(&dbpf_attr_cache_mutex);
-        dbpf_attr_cache_remove(ref);
-        gen_mutex_unlock(&dbpf_attr_cache_mutex);
-    }
-
 #ifndef __PVFS2_TROVE_AIO_THREADED__
 
     *out_op_id_p = dbpf_queued_op_queue(q_op_p);
@@ -1361,11 +1462,13 @@ static int dbpf_bstream_resize_op_svc(struct dbpf_op *op_p)
     ref.fs_id = op_p->coll_p->coll_id;
     ref.handle = op_p->handle;
 
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
     gen_mutex_lock(&dbpf_update_size_lock);
     ret = dbpf_dspace_attr_get(op_p->coll_p, ref, &attr);
     if(ret != 0)
     {
         gen_mutex_unlock(&dbpf_update_size_lock);
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
         return ret;
     }
 
@@ -1376,9 +1479,11 @@ static int dbpf_bstream_resize_op_svc(struct dbpf_op *op_p)
     if(ret < 0)
     {
         gen_mutex_unlock(&dbpf_update_size_lock);
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
         return ret;
     }
     gen_mutex_unlock(&dbpf_update_size_lock);
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
 
     /* setup op for sync coalescing */
     dbpf_queued_op_init(q_op_p,
@@ -1391,6 +1496,12 @@ static int dbpf_bstream_resize_op_svc(struct dbpf_op *op_p)
                         q_op_p->op.context_id);
     q_op_p->op.state = OP_IN_SERVICE;
 
+    ret = dbpf_bstream_packed_resize(op_p->coll_p, ref.handle, tmpsize);
+    if(ret != 0)
+    {
+        return (ret < 0) ? ret : DBPF_OP_COMPLETE;
+    }
+
     /* truncate file after attributes are set */
     ret = dbpf_open_cache_get(
         op_p->coll_p->coll_id, op_p->handle,
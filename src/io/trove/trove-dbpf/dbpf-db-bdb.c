@@ -112,6 +112,10 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
     int create, struct server_configuration_s *cfg)
 {
     int r;
+
+    /* Berkeley DB keys are only ever stored in the legacy format. */
+    compare &= ~DBPF_DB_COMPARE_LEGACY;
+
     *db = malloc(sizeof **db);
     if (!*db)
     {
@@ -166,6 +170,11 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
     return 0;
 }
 
+int dbpf_db_key_format(void)
+{
+    return DBPF_DB_KEY_FORMAT_LEGACY;
+}
+
 int dbpf_db_close(struct dbpf_db *db)
 {
     int r;
@@ -217,6 +226,17 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     return 0;
 }
 
+int dbpf_db_get_multi(struct dbpf_db *db, int count, struct dbpf_data *keys,
+    struct dbpf_data *vals, int *errors)
+{
+    int i;
+    for (i = 0; i < count; i++)
+    {
+        errors[i] = dbpf_db_get(db, &keys[i], &vals[i]);
+    }
+    return 0;
+}
+
 int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
@@ -230,6 +250,21 @@ int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     return db_error(db->db->put(db->db, NULL, &db_key, &db_data, 0));
 }
 
+int dbpf_db_put_multi(struct dbpf_db *db, int count, struct dbpf_data *keys,
+    struct dbpf_data *vals)
+{
+    int i, r;
+    for (i = 0; i < count; i++)
+    {
+        r = dbpf_db_put(db, &keys[i], &vals[i]);
+        if (r)
+        {
+            return r;
+        }
+    }
+    return 0;
+}
+
 int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
@@ -6,6 +6,7 @@
 
 #include <errno.h>
 #include <stdlib.h>
+#include <pthread.h>
 #include <sys/stat.h>
 
 #include <gossip.h>
@@ -15,19 +16,38 @@
 #include "dbpf.h"
 
 #include "server-config.h"
+#include "quicklist.h"
 
 extern filesystem_configuration_s *cfg_fs;
 
 struct dbpf_db {
     MDB_env *env;
     MDB_dbi dbi;
+    int encode;     /* keys begin with a handle stored big-endian */
+    int ordered;    /* keys sort with memcmp */
+    pthread_key_t reader_key;
+    gen_mutex_t reader_mutex;
+    struct qlist_head readers;
+};
+
+/* A read-only transaction kept by one thread for one database. Between
+ * lookups it is reset, which releases its snapshot but keeps its reader
+ * slot, and the next lookup renews it. */
+struct db_reader {
+    MDB_txn *txn;
+    struct dbpf_db *db;
+    struct qlist_head link;
 };
 
 struct dbpf_cursor {
     MDB_cursor *cursor;
     MDB_txn *txn;
+    int encode;
 };
 
+/* large enough for any dspace or keyval key */
+#define KEY_BUF_SIZE DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(DBPF_MAX_KEY_LENGTH)
+
 static int db_error(int e)
 {
     /* values greater than zero are errno values */
@@ -55,6 +75,115 @@ static int db_error(int e)
     return DBPF_ERROR_UNKNOWN;
 }
 
+/* Dspace and keyval keys begin with a handle. It is stored most
+ * significant byte first so that LMDB's default memcmp ordering sorts
+ * the dspace database by handle and the keyval database by handle, type
+ * and then key name. The rest of the key is already byte ordered. */
+static void handle_encode(unsigned char *p, TROVE_handle handle)
+{
+    int i;
+    for (i = sizeof(TROVE_handle) - 1; i >= 0; i--)
+    {
+        p[i] = handle & 0xff;
+        handle >>= 8;
+    }
+}
+
+static TROVE_handle handle_decode(const unsigned char *p)
+{
+    TROVE_handle handle = 0;
+    int i;
+    for (i = 0; i < sizeof(TROVE_handle); i++)
+    {
+        handle = (handle << 8) | p[i];
+    }
+    return handle;
+}
+
+/* Fills in *db_key* for *key*, encoding it into *buf* if necessary. */
+static int key_encode(int encode, struct dbpf_data *key, MDB_val *db_key,
+    unsigned char *buf)
+{
+    TROVE_handle handle;
+
+    db_key->mv_size = key->len;
+    db_key->mv_data = key->data;
+    if (!encode || key->len < sizeof(TROVE_handle))
+    {
+        return 0;
+    }
+    if (key->len > KEY_BUF_SIZE)
+    {
+        return TROVE_EINVAL;
+    }
+    memcpy(&handle, key->data, sizeof(TROVE_handle));
+    handle_encode(buf, handle);
+    memcpy(buf + sizeof(TROVE_handle),
+           (char *)key->data + sizeof(TROVE_handle),
+           key->len - sizeof(TROVE_handle));
+    db_key->mv_data = buf;
+    return 0;
+}
+
+static void reader_destroy(void *arg)
+{
+    struct db_reader *reader = arg;
+
+    gen_mutex_lock(&reader->db->reader_mutex);
+    qlist_del(&reader->link);
+    gen_mutex_unlock(&reader->db->reader_mutex);
+    mdb_txn_abort(reader->txn);
+    free(reader);
+}
+
+/* Returns this thread's read transaction for *db*, renewed so that it
+ * sees the latest committed data. */
+static int reader_get(struct dbpf_db *db, struct db_reader **reader)
+{
+    int r;
+
+    *reader = pthread_getspecific(db->reader_key);
+    if (*reader)
+    {
+        r = mdb_txn_renew((*reader)->txn);
+        if (r)
+        {
+            pthread_setspecific(db->reader_key, NULL);
+            reader_destroy(*reader);
+            *reader = NULL;
+            return db_error(r);
+        }
+        return 0;
+    }
+
+    *reader = malloc(sizeof **reader);
+    if (!*reader)
+    {
+        return db_error(errno);
+    }
+    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &(*reader)->txn);
+    if (r)
+    {
+        free(*reader);
+        *reader = NULL;
+        return db_error(r);
+    }
+    (*reader)->db = db;
+    gen_mutex_lock(&db->reader_mutex);
+    qlist_add(&(*reader)->link, &db->readers);
+    gen_mutex_unlock(&db->reader_mutex);
+    pthread_setspecific(db->reader_key, *reader);
+    return 0;
+}
+
+static void reader_put(struct db_reader *reader)
+{
+    mdb_txn_reset(reader->txn);
+}
+
+/* The comparisons below order keys in the legacy format. They are only
+ * installed when a database is opened with DBPF_DB_COMPARE_LEGACY. */
+
 static int ds_attr_compare(const MDB_val *a, const MDB_val *b)
 {
     TROVE_handle *handle_a = (TROVE_handle *)a->mv_data;
@@ -116,7 +245,10 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
     int create, struct server_configuration_s *cfg)
 {
     MDB_txn *txn;
-    int r;
+    int legacy, r;
+
+    legacy = compare & DBPF_DB_COMPARE_LEGACY;
+    compare &= ~DBPF_DB_COMPARE_LEGACY;
 
     *db = malloc(sizeof **db);
     if (!*db)
@@ -124,6 +256,10 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
         gossip_err("%s:Error allocating space\n",__func__);
         return db_error(errno);
     }
+    (*db)->encode = !legacy && (compare == DBPF_DB_COMPARE_DS_ATTR ||
+        compare == DBPF_DB_COMPARE_KEYVAL);
+    (*db)->ordered = !legacy || (compare != DBPF_DB_COMPARE_DS_ATTR &&
+        compare != DBPF_DB_COMPARE_KEYVAL);
 
     r = mdb_env_create(&(*db)->env);
     if (r)
@@ -172,7 +308,10 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
             return db_error(errno);
         }
     }
-    r = mdb_env_open((*db)->env, name, MDB_MAPASYNC|MDB_WRITEMAP,
+    /* MDB_NOTLS ties reader slots to transactions rather than threads, so
+     * a thread may hold its reset read transaction while it opens
+     * cursors. */
+    r = mdb_env_open((*db)->env, name, MDB_MAPASYNC|MDB_WRITEMAP|MDB_NOTLS,
             TROVE_DB_MODE);
     if (r)
     {
@@ -198,11 +337,11 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
         return db_error(r);
     }
 
-    if (compare == DBPF_DB_COMPARE_DS_ATTR)
+    if (legacy && compare == DBPF_DB_COMPARE_DS_ATTR)
     {
         r = mdb_set_compare(txn, (*db)->dbi, ds_attr_compare);
     }
-    else if (compare == DBPF_DB_COMPARE_KEYVAL)
+    else if (legacy && compare == DBPF_DB_COMPARE_KEYVAL)
     {
         r = mdb_set_compare(txn, (*db)->dbi, keyval_compare);
     }
@@ -222,11 +361,37 @@ int dbpf_db_open(char *name, int compare, struct dbpf_db **db,
         return db_error(errno);
     }
 
+    r = pthread_key_create(&(*db)->reader_key, reader_destroy);
+    if (r)
+    {
+        mdb_env_close((*db)->env);
+        free(*db);
+        return db_error(r);
+    }
+    gen_mutex_init(&(*db)->reader_mutex);
+    INIT_QLIST_HEAD(&(*db)->readers);
+
     return 0;
 }
 
+int dbpf_db_key_format(void)
+{
+    return DBPF_DB_KEY_FORMAT_MEMCMP;
+}
+
 int dbpf_db_close(struct dbpf_db *db)
 {
+    struct db_reader *reader, *tmp;
+
+    /* threads that still hold a read transaction no longer find it, and
+     * their exit will not try to free it again */
+    pthread_key_delete(db->reader_key);
+    qlist_for_each_entry_safe(reader, tmp, &db->readers, link)
+    {
+        mdb_txn_abort(reader->txn);
+        free(reader);
+    }
+    gen_mutex_destroy(&db->reader_mutex);
     mdb_env_close(db->env);
     free(db);
     return 0;
@@ -241,31 +406,131 @@ int dbpf_db_get(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
     MDB_val db_key, db_data;
-    MDB_txn *txn;
+    struct db_reader *reader;
+    unsigned char buf[KEY_BUF_SIZE];
     int r;
 
-    db_key.mv_size = key->len;
-    db_key.mv_data = key->data;
+    r = key_encode(db->encode, key, &db_key, buf);
+    if (r)
+    {
+        return r;
+    }
 
-    r = mdb_txn_begin(db->env, NULL, MDB_RDONLY, &txn);
+    r = reader_get(db, &reader);
     if (r)
     {
-        return db_error(r);
+        return r;
+    }
+    r = mdb_get(reader->txn, db->dbi, &db_key, &db_data);
+    if (r == 0)
+    {
+        memcpy(val->data, db_data.mv_data,
+               db_data.mv_size < val->len ? db_data.mv_size : val->len);
+        val->len = db_data.mv_size;
+    }
+    reader_put(reader);
+    return db_error(r);
+}
+
+struct multi_key
+{
+    MDB_val key;
+    int index;
+};
+
+static int multi_key_compare(const void *a, const void *b)
+{
+    const MDB_val *ka = &((const struct multi_key *)a)->key;
+    const MDB_val *kb = &((const struct multi_key *)b)->key;
+    int r;
+
+    r = memcmp(ka->mv_data, kb->mv_data,
+               ka->mv_size < kb->mv_size ? ka->mv_size : kb->mv_size);
+    if (r == 0 && ka->mv_size != kb->mv_size)
+    {
+        r = ka->mv_size < kb->mv_size ? -1 : 1;
+    }
+    return r;
+}
+
+int dbpf_db_get_multi(struct dbpf_db *db, int count, struct dbpf_data *keys,
+    struct dbpf_data *vals, int *errors)
+{
+    struct multi_key *order;
+    unsigned char *buf;
+    struct db_reader *reader;
+    MDB_cursor *cursor;
+    MDB_val db_data;
+    size_t total = 0;
+    int i, j, r;
+
+    if (count <= 0)
+    {
+        return 0;
     }
-    r = mdb_get(txn, db->dbi, &db_key, &db_data);
+
+    /* encoded keys are the same length as the originals, so pack them
+     * back to back rather than giving each one a KEY_BUF_SIZE slot */
+    for (i = 0; i < count; i++)
+    {
+        total += keys[i].len;
+    }
+    order = malloc(count * sizeof(*order) + total);
+    if (!order)
+    {
+        return db_error(errno);
+    }
+    buf = (unsigned char *)(order + count);
+    for (i = 0; i < count; i++)
+    {
+        r = key_encode(db->encode, &keys[i], &order[i].key, buf);
+        if (r)
+        {
+            free(order);
+            return r;
+        }
+        order[i].index = i;
+        buf += keys[i].len;
+    }
+
+    /* Looking the keys up in database order lets the cursor stay on the
+     * same leaf page from one key to the next. */
+    if (db->ordered)
+    {
+        qsort(order, count, sizeof(*order), multi_key_compare);
+    }
+
+    r = reader_get(db, &reader);
     if (r)
     {
-        mdb_txn_abort(txn);
-        return db_error(r);
+        free(order);
+        return r;
     }
-    r = mdb_txn_commit(txn);
+    r = mdb_cursor_open(reader->txn, db->dbi, &cursor);
     if (r)
     {
+        reader_put(reader);
+        free(order);
         return db_error(r);
     }
 
-    memcpy(val->data, db_data.mv_data, val->len);
-    val->len = db_data.mv_size;
+    for (i = 0; i < count; i++)
+    {
+        j = order[i].index;
+        r = mdb_cursor_get(cursor, &order[i].key, &db_data, MDB_SET_KEY);
+        if (r == 0)
+        {
+            memcpy(vals[j].data, db_data.mv_data,
+                   db_data.mv_size < vals[j].len ?
+                   db_data.mv_size : vals[j].len);
+            vals[j].len = db_data.mv_size;
+        }
+        errors[j] = db_error(r);
+    }
+
+    mdb_cursor_close(cursor);
+    reader_put(reader);
+    free(order);
     return 0;
 }
 
@@ -274,10 +539,14 @@ int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
 {
     MDB_val db_key, db_data;
     MDB_txn *txn;
+    unsigned char buf[KEY_BUF_SIZE];
     int r;
 
-    db_key.mv_size = key->len;
-    db_key.mv_data = key->data;
+    r = key_encode(db->encode, key, &db_key, buf);
+    if (r)
+    {
+        return r;
+    }
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
@@ -300,15 +569,63 @@ int dbpf_db_put(struct dbpf_db *db, struct dbpf_data *key,
     return 0;
 }
 
+int dbpf_db_put_multi(struct dbpf_db *db, int count, struct dbpf_data *keys,
+    struct dbpf_data *vals)
+{
+    MDB_val db_key, db_data;
+    MDB_txn *txn;
+    unsigned char buf[KEY_BUF_SIZE];
+    int i, r;
+
+    if (count <= 0)
+    {
+        return 0;
+    }
+
+    /* one commit, and so one sync, for the whole batch */
+    r = mdb_txn_begin(db->env, NULL, 0, &txn);
+    if (r)
+    {
+        return db_error(r);
+    }
+    for (i = 0; i < count; i++)
+    {
+        r = key_encode(db->encode, &keys[i], &db_key, buf);
+        if (r)
+        {
+            mdb_txn_abort(txn);
+            return r;
+        }
+        db_data.mv_size = vals[i].len;
+        db_data.mv_data = vals[i].data;
+        r = mdb_put(txn, db->dbi, &db_key, &db_data, 0);
+        if (r)
+        {
+            mdb_txn_abort(txn);
+            return db_error(r);
+        }
+    }
+    r = mdb_txn_commit(txn);
+    if (r)
+    {
+        return db_error(r);
+    }
+    return 0;
+}
+
 int dbpf_db_putonce(struct dbpf_db *db, struct dbpf_data *key,
     struct dbpf_data *val)
 {
     MDB_val db_key, db_data;
     MDB_txn *txn;
+    unsigned char buf[KEY_BUF_SIZE];
     int r;
 
-    db_key.mv_size = key->len;
-    db_key.mv_data = key->data;
+    r = key_encode(db->encode, key, &db_key, buf);
+    if (r)
+    {
+        return r;
+    }
     db_data.mv_size = val->len;
     db_data.mv_data = val->data;
 
@@ -335,10 +652,14 @@ int dbpf_db_del(struct dbpf_db *db, struct dbpf_data *key)
 {
     MDB_val db_key;
     MDB_txn *txn;
+    unsigned char buf[KEY_BUF_SIZE];
     int r;
 
-    db_key.mv_size = key->len;
-    db_key.mv_data = key->data;
+    r = key_encode(db->encode, key, &db_key, buf);
+    if (r)
+    {
+        return r;
+    }
 
     r = mdb_txn_begin(db->env, NULL, 0, &txn);
     if (r)
@@ -367,6 +688,7 @@ int dbpf_db_cursor(struct dbpf_db *db, struct dbpf_cursor **dbc, int rdonly)
     {
         return db_error(errno);
     }
+    (*dbc)->encode = db->encode;
 
     r = mdb_txn_begin(db->env, NULL, rdonly ? MDB_RDONLY : 0, &(*dbc)->txn);
     if (r)
@@ -402,6 +724,9 @@ int dbpf_db_cursor_get(struct dbpf_cursor *dbc, struct dbpf_data *key,
     struct dbpf_data *val, int op, size_t maxkeylen)
 {
     MDB_val db_key, db_data;
+    unsigned char buf[KEY_BUF_SIZE];
+    TROVE_handle handle;
+    size_t len;
     /* The variable db_op is set to 0 to silence a compiler warning claming
      * that we never set it even though we do for all possible values of op. */
     int db_op = 0, r;
@@ -413,13 +738,19 @@ int dbpf_db_cursor_get(struct dbpf_cursor *dbc, struct dbpf_data *key,
         db_op = MDB_GET_CURRENT;
         break;
     case DBPF_DB_CURSOR_SET:
-        db_key.mv_size = key->len;
-        db_key.mv_data = key->data;
+        r = key_encode(dbc->encode, key, &db_key, buf);
+        if (r)
+        {
+            return r;
+        }
         db_op = MDB_SET_KEY;
         break;
     case DBPF_DB_CURSOR_SET_RANGE:
-        db_key.mv_size = key->len;
-        db_key.mv_data = key->data;
+        r = key_encode(dbc->encode, key, &db_key, buf);
+        if (r)
+        {
+            return r;
+        }
         db_op = MDB_SET_RANGE;
         break;
     case DBPF_DB_CURSOR_FIRST:
@@ -432,8 +763,15 @@ int dbpf_db_cursor_get(struct dbpf_cursor *dbc, struct dbpf_data *key,
         return db_error(r);
     }
 
-    memcpy(key->data, db_key.mv_data, key->len);
-    memcpy(val->data, db_data.mv_data, val->len);
+    len = db_key.mv_size < key->len ? db_key.mv_size : key->len;
+    memcpy(key->data, db_key.mv_data, len);
+    if (dbc->encode && len >= sizeof(TROVE_handle))
+    {
+        handle = handle_decode(db_key.mv_data);
+        memcpy(key->data, &handle, sizeof(TROVE_handle));
+    }
+    memcpy(val->data, db_data.mv_data,
+           db_data.mv_size < val->len ? db_data.mv_size : val->len);
     key->len = db_key.mv_size;
     val->len = db_data.mv_size;
     return 0;
@@ -26,6 +26,19 @@ struct dbpf_data
 #define DBPF_DB_COMPARE_DS_ATTR 1
 #define DBPF_DB_COMPARE_KEYVAL 2
 
+/* Or'd into the compare argument to open a database whose keys are still
+ * in the legacy format (see dbpf_db_key_format). Only used when
+ * migrating a collection. */
+#define DBPF_DB_COMPARE_LEGACY 0x100
+
+/* These are the values returned by dbpf_db_key_format. In the legacy
+ * format dspace and keyval keys are the host order structs and the
+ * database orders them with a custom comparison. In the memcmp format
+ * handles are stored big-endian so the database's native byte ordering
+ * sorts keys by handle, then keyval type, then key name. */
+#define DBPF_DB_KEY_FORMAT_LEGACY 0
+#define DBPF_DB_KEY_FORMAT_MEMCMP 1
+
 /* A cursor is an object which is used to iterate through the keys in a
  * collection. These are used to control which keys are returned. */
 #define DBPF_DB_CURSOR_NEXT 0
@@ -43,6 +56,11 @@ struct dbpf_data
 int dbpf_db_open(char *, int, dbpf_db **, int,
     struct server_configuration_s *);
 
+/* dbpf_db_key_format(): Return the format of the dspace and keyval keys
+ * this backend writes. Callers always pass and receive host order keys;
+ * any conversion happens inside the backend. */
+int dbpf_db_key_format(void);
+
 /* dbpf_db_close(db): Close the database *db*. */
 int dbpf_db_close(dbpf_db *);
 
@@ -53,10 +71,23 @@ int dbpf_db_sync(dbpf_db *);
  * *val*. */
 int dbpf_db_get(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
 
+/* dbpf_db_get_multi(db, count, keys, vals, errors): Retrieve the values
+ * for *count* keys in *db* into *vals*, setting errors[i] to zero or the
+ * error for keys[i]. The backend may look the keys up in any order and
+ * reads them from one snapshot where it can. Returns nonzero only if no
+ * lookup could be attempted. */
+int dbpf_db_get_multi(dbpf_db *, int, struct dbpf_data *, struct dbpf_data *,
+    int *);
+
 /* dbpf_db_put(db, key, val): Put value for *key* in *db* into
  * *val*, overwriting if necessary. */
 int dbpf_db_put(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
 
+/* dbpf_db_put_multi(db, count, keys, vals): Put the values for *count*
+ * keys in *db*, overwriting if necessary. The backend writes them in one
+ * transaction where it can, so either all are stored or none are. */
+int dbpf_db_put_multi(dbpf_db *, int, struct dbpf_data *, struct dbpf_data *);
+
 /* dbpf_db_putonce(db, key, val): Put value for *key* in *db* into
  * *val*, returning an error if it already exists. */
 int dbpf_db_putonce(dbpf_db *, struct dbpf_data *, struct dbpf_data *);
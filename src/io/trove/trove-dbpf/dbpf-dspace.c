@@ -30,7 +30,9 @@
 #include "dbpf-bstream.h"
 #include "dbpf-op-queue.h"
 #include "dbpf-attr-cache.h"
+#include "dbpf-timestamp-log.h"
 #include "dbpf-open-cache.h"
+#include "dbpf-bstream-packed.h"
 
 #define TROVE_DEFAULT_DB_PAGESIZE 512
 
@@ -512,7 +514,11 @@ static int remove_one_handle(TROVE_object_ref ref,
     key.data = &ref.handle;
     key.len = sizeof(TROVE_handle);
 
+    /* a flush of the timestamp log must not write the record back */
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
+    dbpf_timestamp_log_drop(ref, UINT64_MAX);
     ret = dbpf_db_del(coll_p->ds_db, &key);
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
     if (ret == TROVE_ENOENT)
     {
         gossip_err("tried to remove non-existant dataspace\n");
@@ -538,6 +544,12 @@ static int remove_one_handle(TROVE_object_ref ref,
      * error if this fails (may not have ever been created)
      */
     ret = dbpf_open_cache_remove(coll_p->coll_id, ref.handle);
+    ret = dbpf_bstream_packed_remove(coll_p, ref.handle);
+    if (ret < 0)
+    {
+        gossip_err("%s: failed to drop packed bstream for handle %llu: "
+                   "%d\n", __func__, llu(ref.handle), ret);
+    }
 
     /* remove the keyval entries for this handle if any exist.
      * this way seems a bit messy to me, i.e. we're operating
@@ -994,6 +1006,7 @@ static int dbpf_dspace_getattr(TROVE_coll_id coll_id,
 
         UPDATE_PERF_METADATA_READ();
         gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_timestamp_log_apply(ref, ds_attr_p);
         return 1;
     }
     gen_mutex_unlock(&dbpf_attr_cache_mutex);
@@ -1101,6 +1114,7 @@ static int dbpf_dspace_getattr_list(TROVE_coll_id coll_id,
             }
 
             UPDATE_PERF_METADATA_READ();
+            dbpf_timestamp_log_apply(ref, &ds_attr_p[i]);
             error_array[i] = 0;
             cache_hits++;
         }
@@ -1170,6 +1184,7 @@ static int dbpf_dspace_setattr(TROVE_coll_id coll_id,
     int ret;
     PINT_event_id event_id = 0;
     PINT_event_type event_type;
+    TROVE_object_ref ref = {handle, coll_id};
 
     coll_p = dbpf_collection_find_registered(coll_id);
     if (coll_p == NULL)
@@ -1177,6 +1192,17 @@ static int dbpf_dspace_setattr(TROVE_coll_id coll_id,
         return -TROVE_EINVAL;
     }
 
+#ifdef __PVFS2_TROVE_THREADED__
+    /* only the timestamps change; log them for the dbpf thread to
+     * write with others, and complete now */
+    if ((flags & TROVE_DEFER_TIMESTAMPS) &&
+        dbpf_timestamp_log_add(ref, ds_attr_p) == 0)
+    {
+        UPDATE_PERF_METADATA_WRITE();
+        return 1;
+    }
+#endif
+
     ret = dbpf_op_init_queued_or_immediate(
         &op, &q_op_p,
         DSPACE_SETATTR,
@@ -1203,6 +1229,7 @@ static int dbpf_dspace_setattr(TROVE_coll_id coll_id,
 
    /* initialize op-specific members */
     op_p->u.d_setattr.attr_p = ds_attr_p;
+    op_p->u.d_setattr.timestamp_seq = dbpf_timestamp_log_seq();
     op_p->hints = hints;
 
     PINT_perf_count(PINT_server_pc, PINT_PERF_METADATA_DSPACE_OPS,
@@ -1245,7 +1272,15 @@ int dbpf_dspace_setattr_op_svc(struct dbpf_op *op_p)
     int ret = -TROVE_EINVAL;
     TROVE_object_ref ref = {op_p->handle, op_p->coll_p->coll_id};
 
+    /* the caller read the timestamps logged before it posted this, so
+     * the write stores them and they can be forgotten */
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
     ret = dbpf_dspace_attr_set(op_p->coll_p, ref, op_p->u.d_setattr.attr_p);
+    if (ret == 0)
+    {
+        dbpf_timestamp_log_drop(ref, op_p->u.d_setattr.timestamp_seq);
+    }
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
     if(ret != 0)
     {
         return ret;
@@ -1322,14 +1357,34 @@ static int dbpf_dspace_getattr_op_svc(struct dbpf_op *op_p)
     {
         return(ret);
     }
+    dbpf_timestamp_log_apply(ref, op_p->u.d_getattr.attr_p);
 
     return 1;
 }
 
 static int dbpf_dspace_getattr_list_op_svc(struct dbpf_op *op_p)
 {
-    int i;
+    int i, n = 0, ret;
     TROVE_object_ref ref;
+    struct dbpf_data *keys;
+    struct dbpf_data *vals;
+    int *index;
+    int *errors;
+
+    if (op_p->u.d_getattr_list.count == 0)
+    {
+        return 1;
+    }
+
+    keys = malloc(op_p->u.d_getattr_list.count *
+                  (2 * sizeof(*keys) + 2 * sizeof(int)));
+    if (!keys)
+    {
+        return -TROVE_ENOMEM;
+    }
+    vals = keys + op_p->u.d_getattr_list.count;
+    index = (int *)(vals + op_p->u.d_getattr_list.count);
+    errors = index + op_p->u.d_getattr_list.count;
 
     for (i = 0; i < op_p->u.d_getattr_list.count; i++)
     {
@@ -1344,13 +1399,44 @@ static int dbpf_dspace_getattr_list_op_svc(struct dbpf_op *op_p)
             continue;
         }
 
-        ref.handle = op_p->u.d_getattr_list.handle_array[i];
+        keys[n].data = &op_p->u.d_getattr_list.handle_array[i];
+        keys[n].len = sizeof(TROVE_handle);
+        vals[n].data = &op_p->u.d_getattr_list.attr_p[i];
+        vals[n].len = sizeof(TROVE_ds_attributes);
+        index[n++] = i;
+    }
+
+    /* read every remaining handle in one pass over the database */
+    ret = dbpf_db_get_multi(op_p->coll_p->ds_db, n, keys, vals, errors);
+    if (ret)
+    {
+        free(keys);
+        return -ret;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        op_p->u.d_getattr_list.error_p[index[i]] = -errors[i];
+        if (errors[i])
+        {
+            if (errors[i] != TROVE_ENOENT)
+            {
+                gossip_err("TROVE:DBPF: dspace dbpf_db_get_multi");
+            }
+            continue;
+        }
+
+        ref.handle = op_p->u.d_getattr_list.handle_array[index[i]];
         ref.fs_id = op_p->coll_p->coll_id;
 
-        op_p->u.d_getattr_list.error_p[i] = dbpf_dspace_attr_get(
-           op_p->coll_p, ref, &op_p->u.d_getattr_list.attr_p[i]);
+        gen_mutex_lock(&dbpf_attr_cache_mutex);
+        dbpf_attr_cache_insert(ref, &op_p->u.d_getattr_list.attr_p[index[i]]);
+        gen_mutex_unlock(&dbpf_attr_cache_mutex);
+        dbpf_timestamp_log_apply(ref,
+                                 &op_p->u.d_getattr_list.attr_p[index[i]]);
     }
 
+    free(keys);
     return 1;
 }
 
@@ -1119,47 +1119,77 @@ static int dbpf_keyval_read_list(TROVE_coll_id coll_id,
 static int dbpf_keyval_read_list_op_svc(struct dbpf_op *op_p)
 {
     int ret, i = 0;
-    struct dbpf_keyval_db_entry key_entry;
-    struct dbpf_data key, data;
+    struct dbpf_keyval_db_entry *key_entries;
+    struct dbpf_data *keys, *data;
+    int *errors;
+    int count = op_p->u.k_read_list.count;
     int success_count = 0;
 
-    for(i = 0; i < op_p->u.k_read_list.count; i++)
+    if (count == 0)
     {
-        key_entry.handle = op_p->handle;
+        return 1;
+    }
+
+    key_entries = malloc(count * (sizeof(*key_entries) +
+                                  2 * sizeof(*keys) + sizeof(int)));
+    if (!key_entries)
+    {
+        return -TROVE_ENOMEM;
+    }
+    keys = (struct dbpf_data *)(key_entries + count);
+    data = keys + count;
+    errors = (int *)(data + count);
+
+    for(i = 0; i < count; i++)
+    {
+        key_entries[i].handle = op_p->handle;
         if (op_p->flags & TROVE_KEYVAL_DIRECTORY_ENTRY)
         {
-            key_entry.type = DBPF_DIRECTORY_ENTRY_TYPE;
+            key_entries[i].type = DBPF_DIRECTORY_ENTRY_TYPE;
         }
         else
         {
-            key_entry.type = DBPF_ATTRIBUTE_TYPE;
+            key_entries[i].type = DBPF_ATTRIBUTE_TYPE;
         }
 
-        memcpy(key_entry.key, 
+        memcpy(key_entries[i].key, 
                op_p->u.k_read_list.key_array[i].buffer,
                op_p->u.k_read_list.key_array[i].buffer_sz);
 
-        key.data = &key_entry;
-        key.len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(
+        keys[i].data = &key_entries[i];
+        keys[i].len = DBPF_KEYVAL_DB_ENTRY_TOTAL_SIZE(
             op_p->u.k_read_list.key_array[i].buffer_sz);
 
-        data.data = op_p->u.k_read_list.val_array[i].buffer;
-        data.len = op_p->u.k_read_list.val_array[i].buffer_sz;
+        data[i].data = op_p->u.k_read_list.val_array[i].buffer;
+        data[i].len = op_p->u.k_read_list.val_array[i].buffer_sz;
+    }
 
-        ret = dbpf_db_get(op_p->coll_p->keyval_db, &key, &data);
+    /* all keys belong to one handle, so they sit next to each other */
+    ret = dbpf_db_get_multi(op_p->coll_p->keyval_db, count, keys, data,
+                            errors);
+    if (ret != 0)
+    {
+        free(key_entries);
+        return -ret;
+    }
+
+    for(i = 0; i < count; i++)
+    {
+        ret = errors[i];
         if (ret != 0)
         {
             gossip_debug(GOSSIP_DBPF_KEYVAL_DEBUG, 
                          "keyval read list (get) %s failed with error %s\n",
-                         key_entry.key, strerror(ret));
+                         key_entries[i].key, strerror(ret));
             /* if data buffer is too small returns ERANGE error */
-            if (data.len > op_p->u.k_read_list.val_array[i].buffer_sz)
+            if (data[i].len > op_p->u.k_read_list.val_array[i].buffer_sz)
             {
                 gossip_debug(GOSSIP_DBPF_KEYVAL_DEBUG,
                          "warning: Value buffer too small %d < %lu\n",
-                         op_p->u.k_read_list.val_array[i].buffer_sz, data.len);
+                         op_p->u.k_read_list.val_array[i].buffer_sz,
+                         data[i].len);
                 /* let the user know */
-                op_p->u.k_read_list.val_array[i].read_sz = data.len;
+                op_p->u.k_read_list.val_array[i].read_sz = data[i].len;
                 /* this is still a success */
                 success_count++;
             }
@@ -1177,9 +1207,10 @@ static int dbpf_keyval_read_list_op_svc(struct dbpf_op *op_p)
         {
             success_count++;
             op_p->u.k_read_list.err_array[i] = 0;
-            op_p->u.k_read_list.val_array[i].read_sz = data.len;
+            op_p->u.k_read_list.val_array[i].read_sz = data[i].len;
         }
     }
+    free(key_entries);
 
     if(success_count)
     {
@@ -35,12 +35,14 @@
 #include "dbpf-bstream.h"
 #include "dbpf-thread.h"
 #include "dbpf-attr-cache.h"
+#include "dbpf-timestamp-log.h"
 #include "trove-ledger.h"
 #include "trove-handle-mgmt.h"
 #include "gossip.h"
 #include "dbpf-open-cache.h"
 #include "pint-util.h"
 #include "dbpf-sync.h"
+#include "dbpf-bstream-packed.h"
 
 #include "server-config.h"
 
@@ -260,6 +262,13 @@ int dbpf_collection_setinfo(TROVE_method_id method_id,
             trove_directio_timeout = *(int *)parameter;
             ret = 0;
             break;
+        case TROVE_COLLECTION_PACKED_BSTREAM_MAX:
+            gossip_debug(GOSSIP_TROVE_DEBUG,
+                         "dbpf collection %d - packing bstreams up to %d "
+                         "bytes\n", (int) coll_id, *(int *)parameter);
+            assert(coll);
+            ret = dbpf_bstream_packed_set_max(coll, *(int *)parameter);
+            break;
     }
     return ret;
 }
@@ -543,6 +552,12 @@ static int dbpf_initialize(char *data_path,
 
     dbpf_open_cache_initialize();
 
+    ret = dbpf_timestamp_log_initialize();
+    if (ret < 0)
+    {
+        return ret;
+    }
+
     return dbpf_thread_initialize();
 }
 
@@ -659,6 +674,7 @@ int dbpf_finalize(void)
     int ret = -TROVE_EINVAL;
 
     dbpf_thread_finalize();
+    dbpf_timestamp_log_finalize();
     dbpf_open_cache_finalize();
     gen_mutex_lock(&dbpf_attr_cache_mutex);
     dbpf_attr_cache_finalize();
@@ -846,6 +862,7 @@ int dbpf_collection_create(char *collname,
 {
     int ret = -TROVE_EINVAL, error = 0, i = 0;
     TROVE_handle zero = TROVE_HANDLE_NULL;
+    int32_t key_format;
     struct dbpf_storage *sto_p;
     struct dbpf_collection_db_entry db_data;
     dbpf_db *db_p = NULL;
@@ -998,6 +1015,23 @@ int dbpf_collection_create(char *collname,
         GOSSIP_TROVE_DEBUG, "wrote trove-dbpf version %s to "
         "collection attribute database\n", TROVE_DBPF_VERSION_VALUE);
 
+    /* store the key format the database backend writes, so that a
+     * collection is never opened by a backend that orders it differently
+     */
+    key_format = dbpf_db_key_format();
+    key.data = TROVE_DBPF_KEY_FORMAT_KEY;
+    key.len = strlen(TROVE_DBPF_KEY_FORMAT_KEY);
+    data.data = &key_format;
+    data.len = sizeof(key_format);
+
+    ret = dbpf_db_put(db_p, &key, &data);
+    if (ret != 0)
+    {
+        gossip_err("db_p->put failed writing trove-dbpf key format: %s\n",
+                   strerror(ret));
+        return -ret;
+    }
+
     /* store initial handle value */
     key.data = LAST_HANDLE_STRING;
     key.len = sizeof(LAST_HANDLE_STRING);
@@ -1141,6 +1175,7 @@ int dbpf_collection_remove(char *collname,
     }
     else {
         /* Clean up properly by closing all db handles */
+        dbpf_bstream_packed_close(db_collection);
         dbpf_db_close(db_collection->coll_attr_db);
         dbpf_db_close(db_collection->ds_db);
         dbpf_db_close(db_collection->keyval_db);
@@ -1152,6 +1187,8 @@ int dbpf_collection_remove(char *collname,
         free(db_collection);
     }
 
+    dbpf_bstream_packed_destroy(db_data.coll_id);
+
     DBPF_GET_DS_ATTRIB_DBNAME(path_name, PATH_MAX,
                               sto_p->meta_path, db_data.coll_id);
     if (unlink(path_name) != 0)
@@ -1360,6 +1397,12 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
     int ret;
     struct dbpf_collection *coll_p = dbpf_collection_find_registered(coll_id);
 
+    /* write out deferred timestamps while the databases are open */
+    if (coll_p)
+    {
+        dbpf_timestamp_log_flush(coll_p, 1);
+    }
+
     dbpf_collection_deregister(coll_p);
 
     if( coll_p == NULL )
@@ -1368,6 +1411,8 @@ int dbpf_collection_clear(TROVE_coll_id coll_id)
        return 0;
     }
 
+    dbpf_bstream_packed_close(coll_p);
+
     if ( (coll_p->coll_attr_db != NULL ) &&
          (ret = dbpf_db_sync(coll_p->coll_attr_db))
         != 0)
@@ -1451,6 +1496,7 @@ int dbpf_collection_lookup(char *collname,
     char path_name[PATH_MAX];
     char trove_dbpf_version[32] = {0};
     int sto_major, sto_minor, sto_inc, major, minor, inc;
+    int32_t key_format = DBPF_DB_KEY_FORMAT_LEGACY;
 
     gossip_debug(GOSSIP_TROVE_DEBUG, "dbpf_collection_lookup of coll: %s\n", 
                  collname);
@@ -1610,6 +1656,41 @@ int dbpf_collection_lookup(char *collname,
         return -TROVE_EINVAL;
     }
 
+    /* collections created before the key format was recorded are legacy */
+    key.data = TROVE_DBPF_KEY_FORMAT_KEY;
+    key.len = strlen(TROVE_DBPF_KEY_FORMAT_KEY);
+    data.data = &key_format;
+    data.len = sizeof(key_format);
+
+    ret = dbpf_db_get(coll_p->coll_attr_db, &key, &data);
+    if (ret != 0 && ret != TROVE_ENOENT)
+    {
+        gossip_err("Failed to retrieve collection key format: %s\n",
+                   strerror(ret));
+        dbpf_db_close(coll_p->coll_attr_db);
+        free(coll_p->meta_path);
+        free(coll_p->data_path);
+        free(coll_p->name);
+        free(coll_p);
+        return -ret;
+    }
+
+    if (key_format != dbpf_db_key_format())
+    {
+        dbpf_db_close(coll_p->coll_attr_db);
+        free(coll_p->meta_path);
+        free(coll_p->data_path);
+        free(coll_p->name);
+        free(coll_p);
+        gossip_err("Trove-dbpf key format mismatch!\n");
+        gossip_err("This collection has key format %d\n", key_format);
+        gossip_err("This code understands key format %d\n",
+                   dbpf_db_key_format());
+        gossip_err("Run pvfs2-migrate-keys on the storage space to "
+                   "convert it\n");
+        return -TROVE_EINVAL;
+    }
+
     DBPF_GET_DS_ATTRIB_DBNAME(path_name, PATH_MAX,
                               my_storage_p->meta_path, coll_p->coll_id);
 
@@ -1655,6 +1736,20 @@ int dbpf_collection_lookup(char *collname,
         return -TROVE_ENOMEM;
     }
 
+    ret = dbpf_bstream_packed_open(coll_p, 0);
+    if (ret < 0)
+    {
+        PINT_dbpf_keyval_pcache_finalize(coll_p->pcache);
+        dbpf_db_close(coll_p->coll_attr_db);
+        dbpf_db_close(coll_p->keyval_db);
+        dbpf_db_close(coll_p->ds_db);
+        free(coll_p->meta_path);
+        free(coll_p->data_path);
+        free(coll_p->name);
+        free(coll_p);
+        return ret;
+    }
+
     coll_p->next_p = NULL;
 
     /*
@@ -232,7 +232,7 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
         if(qop_p->event_type == trove_dbpf_dspace_create_event_id)
         {
             PINT_EVENT_END(qop_p->event_type, dbpf_pid, NULL, qop_p->event_id,
-                           qop_p->op.u.d_create.out_handle_p);
+                           *qop_p->op.u.d_create.out_handle_p);
         }
         else
         {
@@ -253,7 +253,7 @@ int dbpf_sync_coalesce(dbpf_queued_op_t *qop_p, int retcode, int * outcount)
             if(ready_op->event_type == trove_dbpf_dspace_create_event_id)
             {
                 PINT_EVENT_END(ready_op->event_type, dbpf_pid, NULL, ready_op->event_id,
-                               ready_op->op.u.d_create.out_handle_p);
+                               *ready_op->op.u.d_create.out_handle_p);
             }
             else
             {
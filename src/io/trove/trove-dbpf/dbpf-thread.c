@@ -18,6 +18,7 @@
 #include "dbpf-bstream.h"
 #include "dbpf-op-queue.h"
 #include "dbpf-sync.h"
+#include "dbpf-timestamp-log.h"
 #include "pint-context.h"
 #include "pint-mgmt.h"
 
@@ -91,6 +92,10 @@ void *dbpf_thread_function(void *ptr)
     PINT_event_thread_start("TROVE-DBPF");
     while(dbpf_thread_running)
     {
+        /* write out deferred timestamps once enough are waiting or the
+         * oldest has waited long enough */
+        dbpf_timestamp_log_flush(NULL, 0);
+
         /* check if we any have ops to service in our work queue */
         gen_mutex_lock(&dbpf_op_queue_mutex);
         op_queued_empty = qlist_empty(&dbpf_op_queue);
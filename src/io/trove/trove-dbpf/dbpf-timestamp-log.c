@@ -0,0 +1,422 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <sys/time.h>
+
+#include "gossip.h"
+#include "quickhash.h"
+#include "dbpf-timestamp-log.h"
+#include "dbpf-attr-cache.h"
+#include "pvfs2-internal.h"
+
+extern gen_mutex_t dbpf_attr_cache_mutex;
+
+gen_mutex_t dbpf_timestamp_log_flush_mutex = GEN_MUTEX_INITIALIZER;
+
+/* protects everything below; never held while taking the flush mutex
+ * or the attr cache mutex */
+static gen_mutex_t s_log_mutex = GEN_MUTEX_INITIALIZER;
+
+typedef struct
+{
+    struct qlist_head hash_link;
+    struct qlist_head list_link;
+    TROVE_object_ref ref;
+    PVFS_time atime;
+    PVFS_time mtime;
+    PVFS_time ctime;
+    uint64_t seq;
+} dbpf_timestamp_log_entry_t;
+
+/* what a flush writes for one entry */
+struct flush_rec
+{
+    TROVE_object_ref ref;
+    PVFS_time atime;
+    PVFS_time mtime;
+    PVFS_time ctime;
+    uint64_t seq;
+    int done;
+};
+
+static struct qhash_table *s_table = NULL;
+static QLIST_HEAD(s_entry_list);
+static int s_count = 0;
+static uint64_t s_seq = 0;
+static uint64_t s_first_msecs = 0;   /* when the oldest waiting update came */
+
+static int hash_key(const void *key, int table_size);
+static int hash_key_compare(const void *key, struct qlist_head *link);
+
+static uint64_t now_msecs(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static dbpf_timestamp_log_entry_t *entry_lookup(TROVE_object_ref ref)
+{
+    struct qlist_head *hash_link;
+
+    hash_link = qhash_search(s_table, &ref);
+    if (!hash_link)
+    {
+        return NULL;
+    }
+    return qhash_entry(hash_link, dbpf_timestamp_log_entry_t, hash_link);
+}
+
+static void entry_remove(dbpf_timestamp_log_entry_t *entry)
+{
+    qhash_del(&entry->hash_link);
+    qlist_del(&entry->list_link);
+    free(entry);
+    s_count--;
+}
+
+int dbpf_timestamp_log_initialize(void)
+{
+    gen_mutex_lock(&s_log_mutex);
+    if (!s_table)
+    {
+        s_table = qhash_init(hash_key_compare, hash_key,
+                             DBPF_TIMESTAMP_LOG_TABLE_SIZE);
+    }
+    gen_mutex_unlock(&s_log_mutex);
+    return s_table ? 0 : -TROVE_ENOMEM;
+}
+
+void dbpf_timestamp_log_finalize(void)
+{
+    dbpf_timestamp_log_entry_t *entry, *tmp;
+
+    gen_mutex_lock(&s_log_mutex);
+    if (s_table)
+    {
+        if (s_count)
+        {
+            gossip_err("TROVE:DBPF: dropping timestamps of %d objects "
+                       "that were never written\n", s_count);
+        }
+        qlist_for_each_entry_safe(entry, tmp, &s_entry_list, list_link)
+        {
+            entry_remove(entry);
+        }
+        qhash_finalize(s_table);
+        s_table = NULL;
+    }
+    gen_mutex_unlock(&s_log_mutex);
+}
+
+int dbpf_timestamp_log_add(TROVE_object_ref ref, TROVE_ds_attributes *attr)
+{
+    dbpf_timestamp_log_entry_t *entry;
+
+    gen_mutex_lock(&s_log_mutex);
+    if (!s_table)
+    {
+        gen_mutex_unlock(&s_log_mutex);
+        return -1;
+    }
+
+    entry = entry_lookup(ref);
+    if (!entry)
+    {
+        entry = malloc(sizeof(*entry));
+        if (!entry)
+        {
+            gen_mutex_unlock(&s_log_mutex);
+            return -1;
+        }
+        entry->ref = ref;
+        qhash_add(s_table, &entry->ref, &entry->hash_link);
+        qlist_add_tail(&entry->list_link, &s_entry_list);
+        if (s_count++ == 0)
+        {
+            s_first_msecs = now_msecs();
+        }
+    }
+
+    /* later updates replace earlier ones, as the writes would have */
+    entry->atime = attr->atime;
+    entry->mtime = attr->mtime;
+    entry->ctime = attr->ctime;
+    entry->seq = ++s_seq;
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "timestamp log: deferred %llu "
+                 "(%d waiting)\n", llu(ref.handle), s_count);
+    gen_mutex_unlock(&s_log_mutex);
+    return 0;
+}
+
+uint64_t dbpf_timestamp_log_seq(void)
+{
+    uint64_t seq;
+
+    gen_mutex_lock(&s_log_mutex);
+    seq = s_seq;
+    gen_mutex_unlock(&s_log_mutex);
+    return seq;
+}
+
+void dbpf_timestamp_log_apply(TROVE_object_ref ref, TROVE_ds_attributes *attr)
+{
+    dbpf_timestamp_log_entry_t *entry;
+
+    gen_mutex_lock(&s_log_mutex);
+    if (s_table && s_count)
+    {
+        entry = entry_lookup(ref);
+        if (entry)
+        {
+            attr->atime = entry->atime;
+            attr->mtime = entry->mtime;
+            attr->ctime = entry->ctime;
+        }
+    }
+    gen_mutex_unlock(&s_log_mutex);
+}
+
+void dbpf_timestamp_log_drop(TROVE_object_ref ref, uint64_t seq)
+{
+    dbpf_timestamp_log_entry_t *entry;
+
+    gen_mutex_lock(&s_log_mutex);
+    if (s_table && s_count)
+    {
+        entry = entry_lookup(ref);
+        if (entry && entry->seq <= seq)
+        {
+            entry_remove(entry);
+        }
+    }
+    gen_mutex_unlock(&s_log_mutex);
+}
+
+static int flush_rec_compare(const void *a, const void *b)
+{
+    const struct flush_rec *x = a, *y = b;
+
+    if (x->ref.fs_id != y->ref.fs_id)
+    {
+        return (x->ref.fs_id < y->ref.fs_id) ? -1 : 1;
+    }
+    return (x->ref.handle > y->ref.handle) - (x->ref.handle < y->ref.handle);
+}
+
+/* flush_collection()
+ *
+ * reads the current attributes of a run of handles in one collection,
+ * puts the logged timestamps on them and writes them back in one
+ * transaction; marks the records it is finished with
+ */
+static void flush_collection(struct dbpf_collection *coll_p,
+                             struct flush_rec *recs, int count)
+{
+    TROVE_ds_attributes *attrs;
+    struct dbpf_data *keys, *vals;
+    int *errors;
+    int i, n, ret;
+
+    attrs = malloc(count * (sizeof(*attrs) + 2 * sizeof(*keys) +
+                            sizeof(int)));
+    if (!attrs)
+    {
+        return;
+    }
+    keys = (struct dbpf_data *)(attrs + count);
+    vals = keys + count;
+    errors = (int *)(vals + count);
+
+    for (i = 0; i < count; i++)
+    {
+        keys[i].data = &recs[i].ref.handle;
+        keys[i].len = sizeof(TROVE_handle);
+        vals[i].data = &attrs[i];
+        vals[i].len = sizeof(TROVE_ds_attributes);
+    }
+    ret = dbpf_db_get_multi(coll_p->ds_db, count, keys, vals, errors);
+    if (ret)
+    {
+        gossip_err("TROVE:DBPF: timestamp log read: %d\n", ret);
+        free(attrs);
+        return;
+    }
+
+    /* pack the objects that still exist to the front */
+    for (i = 0, n = 0; i < count; i++)
+    {
+        if (errors[i])
+        {
+            /* removed since; nothing to write */
+            recs[i].done = 1;
+            continue;
+        }
+        attrs[n] = attrs[i];
+        attrs[n].atime = recs[i].atime;
+        attrs[n].mtime = recs[i].mtime;
+        attrs[n].ctime = recs[i].ctime;
+        keys[n].data = &recs[i].ref.handle;
+        vals[n].data = &attrs[n];
+        errors[n] = i;
+        n++;
+    }
+
+    ret = dbpf_db_put_multi(coll_p->ds_db, n, keys, vals);
+    if (ret == 0)
+    {
+        ret = dbpf_db_sync(coll_p->ds_db);
+    }
+    if (ret)
+    {
+        /* left in the log for the next flush */
+        gossip_err("TROVE:DBPF: timestamp log write: %d\n", ret);
+        free(attrs);
+        return;
+    }
+
+    gen_mutex_lock(&dbpf_attr_cache_mutex);
+    for (i = 0; i < n; i++)
+    {
+        dbpf_attr_cache_ds_attr_update_cached_data(recs[errors[i]].ref,
+                                                   &attrs[i]);
+        recs[errors[i]].done = 1;
+    }
+    gen_mutex_unlock(&dbpf_attr_cache_mutex);
+
+    gossip_debug(GOSSIP_TROVE_DEBUG, "timestamp log: wrote %d objects in "
+                 "collection %d\n", n, coll_p->coll_id);
+    free(attrs);
+}
+
+void dbpf_timestamp_log_flush(struct dbpf_collection *coll_p, int force)
+{
+    dbpf_timestamp_log_entry_t *entry;
+    struct dbpf_collection *run_coll_p;
+    struct flush_rec *recs;
+    int i, j, count = 0;
+
+    /* cheap check for the dbpf thread, which calls this every cycle */
+    gen_mutex_lock(&s_log_mutex);
+    if (!s_table || s_count == 0 ||
+        (!force && s_count < DBPF_TIMESTAMP_LOG_FLUSH_COUNT &&
+         now_msecs() - s_first_msecs < DBPF_TIMESTAMP_LOG_FLUSH_MSECS))
+    {
+        gen_mutex_unlock(&s_log_mutex);
+        return;
+    }
+    gen_mutex_unlock(&s_log_mutex);
+
+    gen_mutex_lock(&dbpf_timestamp_log_flush_mutex);
+
+    /* copy out what to write; updates that come in meanwhile stay in
+     * the log, and getattr keeps seeing the log until the write is done */
+    gen_mutex_lock(&s_log_mutex);
+    recs = malloc(s_count * sizeof(*recs));
+    if (recs)
+    {
+        qlist_for_each_entry(entry, &s_entry_list, list_link)
+        {
+            if (coll_p && entry->ref.fs_id != coll_p->coll_id)
+            {
+                continue;
+            }
+            recs[count].ref = entry->ref;
+            recs[count].atime = entry->atime;
+            recs[count].mtime = entry->mtime;
+            recs[count].ctime = entry->ctime;
+            recs[count].seq = entry->seq;
+            recs[count].done = 0;
+            count++;
+        }
+    }
+    gen_mutex_unlock(&s_log_mutex);
+
+    if (!recs)
+    {
+        gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
+        return;
+    }
+
+    /* group by collection, and within one in database order */
+    qsort(recs, count, sizeof(*recs), flush_rec_compare);
+    for (i = 0; i < count; i = j)
+    {
+        for (j = i + 1; j < count && recs[j].ref.fs_id == recs[i].ref.fs_id;
+             j++)
+        {
+        }
+
+        run_coll_p = coll_p ? coll_p :
+            dbpf_collection_find_registered(recs[i].ref.fs_id);
+        if (!run_coll_p)
+        {
+            /* the collection has been closed; nowhere to write */
+            for (; i < j; i++)
+            {
+                recs[i].done = 1;
+            }
+            continue;
+        }
+        flush_collection(run_coll_p, &recs[i], j - i);
+    }
+
+    gen_mutex_lock(&s_log_mutex);
+    for (i = 0; i < count; i++)
+    {
+        if (recs[i].done)
+        {
+            entry = entry_lookup(recs[i].ref);
+            if (entry && entry->seq == recs[i].seq)
+            {
+                entry_remove(entry);
+            }
+        }
+    }
+    s_first_msecs = now_msecs();
+    gen_mutex_unlock(&s_log_mutex);
+
+    gen_mutex_unlock(&dbpf_timestamp_log_flush_mutex);
+    free(recs);
+}
+
+static int hash_key(const void *key, int table_size)
+{
+    unsigned long tmp = 0;
+    const TROVE_object_ref *ref = (const TROVE_object_ref *)key;
+
+    tmp = (ref->fs_id << 12);
+    tmp += ref->handle;
+    tmp = (tmp % table_size);
+
+    return ((int)tmp);
+}
+
+static int hash_key_compare(const void *key, struct qlist_head *link)
+{
+    dbpf_timestamp_log_entry_t *entry = NULL;
+    const TROVE_object_ref *ref = (const TROVE_object_ref *)key;
+
+    entry = qlist_entry(link, dbpf_timestamp_log_entry_t, hash_link);
+    assert(entry);
+
+    return ((entry->ref.handle == ref->handle) &&
+            (entry->ref.fs_id == ref->fs_id));
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
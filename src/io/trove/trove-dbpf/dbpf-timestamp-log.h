@@ -0,0 +1,67 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+#ifndef __DBPF_TIMESTAMP_LOG_H
+#define __DBPF_TIMESTAMP_LOG_H
+
+#include "pvfs2-internal.h"
+#include "dbpf.h"
+#include "trove-types.h"
+#include "gen-locks.h"
+
+/*
+  the timestamp log holds the atime, mtime and ctime of objects whose
+  dspace_setattr was posted with TROVE_DEFER_TIMESTAMPS.  repeated
+  updates of one handle are merged in memory, getattr sees the logged
+  values, and the dbpf thread writes them out in one transaction per
+  collection once enough handles are waiting or the oldest has waited
+  long enough.
+*/
+#define DBPF_TIMESTAMP_LOG_TABLE_SIZE                1021
+#define DBPF_TIMESTAMP_LOG_FLUSH_COUNT                512
+#define DBPF_TIMESTAMP_LOG_FLUSH_MSECS               1000
+
+/*
+  held across any write of a dspace record that must not interleave
+  with a flush; taken before dbpf_attr_cache_mutex
+*/
+extern gen_mutex_t dbpf_timestamp_log_flush_mutex;
+
+int dbpf_timestamp_log_initialize(void);
+void dbpf_timestamp_log_finalize(void);
+
+/* merge the timestamps of attr into the log; -1 if not initialized */
+int dbpf_timestamp_log_add(TROVE_object_ref ref, TROVE_ds_attributes *attr);
+
+/* the sequence number of the most recent update */
+uint64_t dbpf_timestamp_log_seq(void);
+
+/* overwrite the timestamps in attr with any logged for ref */
+void dbpf_timestamp_log_apply(TROVE_object_ref ref, TROVE_ds_attributes *attr);
+
+/*
+  forget the timestamps logged for ref up to sequence number seq, once
+  a full write has stored them; the caller holds the flush mutex
+*/
+void dbpf_timestamp_log_drop(TROVE_object_ref ref, uint64_t seq);
+
+/*
+  write out the logged timestamps of one collection, or of all of them
+  if coll_p is NULL; unless force is set this does nothing until the
+  log is due
+*/
+void dbpf_timestamp_log_flush(struct dbpf_collection *coll_p, int force);
+
+#endif /* __DBPF_TIMESTAMP_LOG_H */
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
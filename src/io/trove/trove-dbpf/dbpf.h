@@ -35,6 +35,11 @@ extern "C" {
 #define TROVE_DBPF_VERSION_KEY                       "trove-dbpf-version"
 #define TROVE_DBPF_VERSION_VALUE                                  "0.1.6"   
 
+/* Format of the dspace and keyval database keys, one of the
+ * DBPF_DB_KEY_FORMAT values.  Collections without it are legacy.
+ */
+#define TROVE_DBPF_KEY_FORMAT_KEY                 "trove-dbpf-key-format"
+
 #define LAST_HANDLE_STRING                                  "last_handle"
 
 #define TROVE_DB_MODE                                                 0600
@@ -124,6 +129,39 @@ do {                                                                      \
                  llu(__handle));                             \
     } while(0)
 
+/*
+  small bstreams may instead be packed into large, append-only container
+  files shared by many handles; the offset of each one is kept in the
+  packed bstream db (see dbpf-bstream-packed.c)
+*/
+#define PACKED_BSTREAM_DIRNAME "packed-bstreams"
+#define DBPF_GET_PACKED_BSTREAM_DIRNAME(__buf, __path_max, __base, __collid) \
+do {                                                                     \
+  snprintf(__buf, __path_max, "/%s/%08x/%s", __base, __collid,           \
+           PACKED_BSTREAM_DIRNAME);                                      \
+} while (0)
+
+/* arguments are: buf, path_max, base, collid, container */
+#define DBPF_GET_PACKED_CONTAINER_FILENAME(__b, __pm, __base, __cid, __cont) \
+do {                                                                      \
+  snprintf(__b, __pm, "/%s/%08x/%s/%08x.pack",                            \
+           __base, __cid, PACKED_BSTREAM_DIRNAME, (unsigned)(__cont));    \
+} while (0)
+
+/* arguments are: buf, path_max, base, collid, handle */
+#define DBPF_GET_PACKED_PROMOTE_FILENAME(__b, __pm, __base, __cid, __handle) \
+do {                                                                      \
+  snprintf(__b, __pm, "/%s/%08x/%s/%08llx.promote",                       \
+           __base, __cid, PACKED_BSTREAM_DIRNAME, llu(__handle));         \
+} while (0)
+
+#define PACKED_BSTREAM_DBNAME "packed_bstreams.db"
+#define DBPF_GET_PACKED_BSTREAM_DBNAME(__buf,__path_max,__base,__collid) \
+do {                                                                     \
+  snprintf(__buf, __path_max, "/%s/%08x/%s", __base, __collid,           \
+           PACKED_BSTREAM_DBNAME);                                       \
+} while (0)
+
 /* arguments are: buf, path_max, base, collid */
 #define KEYVAL_DBNAME "keyval.db"
 #define DBPF_GET_KEYVAL_DBNAME(__buf,__path_max,__base,__collid)         \
@@ -265,6 +303,8 @@ struct dbpf_storage
     dbpf_db *coll_db;
 };
 
+struct dbpf_packed_store;
+
 struct dbpf_collection
 {
     int refct;
@@ -290,6 +330,8 @@ struct dbpf_collection
      * If this option is on we don't queue ops or use threads.
      */
     int immediate_completion;
+    /* container files for small bstreams; NULL if never enabled */
+    struct dbpf_packed_store *packed;
 };
 
 /* Structure stored as data in collections database with collection
@@ -347,6 +389,7 @@ struct dbpf_dspace_verify_op
 struct dbpf_dspace_setattr_op
 {
     TROVE_ds_attributes_s *attr_p;
+    uint64_t timestamp_seq;     /* timestamp log position at post time */
 };
 
 struct dbpf_dspace_getattr_op
@@ -711,7 +754,7 @@ do {                                                          \
         __q_op_p->event_type = __event_type;                                    \
         PINT_EVENT_START(__event_type, dbpf_pid, NULL, (__event_id),            \
                          ## args);                                              \
-        *(__event_id) = __q_op_p->event_id;                                     \
+        __q_op_p->event_id = *(__event_id);                                     \
     }
 
 #define DBPF_EVENT_END(__event_type, __event_id) \
@@ -61,7 +61,11 @@ enum
     TROVE_KEYVAL_HANDLE_COUNT    = 1 << 7,
     TROVE_BINARY_KEY             = 1 << 8, /* tell trove this is a binary key */
     TROVE_KEYVAL_ITERATE_REMOVE  = 1 << 9, /* tell trove to delete keyvals as it iterates */
-    TROVE_KEYVAL_DIRECTORY_ENTRY = 1 << 10 /* tell trove to store this as a directory entry */
+    TROVE_KEYVAL_DIRECTORY_ENTRY = 1 << 10, /* tell trove to store this as a directory entry */
+
+    /* dspace_setattr: only atime, mtime and ctime differ from the stored
+     * attributes, so trove may write them later in a batch */
+    TROVE_DEFER_TIMESTAMPS       = 1 << 11
 };
 
 enum
@@ -88,7 +92,8 @@ enum
     TROVE_COLLECTION_IMMEDIATE_COMPLETION,
     TROVE_DIRECTIO_THREADS_NUM,
     TROVE_DIRECTIO_OPS_PER_QUEUE,
-    TROVE_DIRECTIO_TIMEOUT
+    TROVE_DIRECTIO_TIMEOUT,
+    TROVE_COLLECTION_PACKED_BSTREAM_MAX
 };
 
 /** Initializes the Trove layer.  Must be called before any other Trove
@@ -108,6 +108,7 @@ static void lebf_initialize(void)
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
             case PVFS_SERV_JOB_TIMER:
+            case PVFS_SERV_DIRDATA_SPLIT:
                 /* never used, skip initialization */
                 continue;
             case PVFS_SERV_GETCONFIG:
@@ -132,6 +133,7 @@ static void lebf_initialize(void)
             case PVFS_SERV_CREATE:
                 zero_credential(&req.u.create.credential);
                 zero_capability(&resp.u.create.metafile_attrs.capability);
+                req.u.create.dirent_name = tmp_name;
                 /* can request a range of handles */
                 reqsize = extra_size_PVFS_servreq_create;
                 respsize = extra_size_PVFS_servresp_create;
@@ -259,6 +261,7 @@ static void lebf_initialize(void)
                 respsize = extra_size_PVFS_servresp_mgmt_dspace_info_list;
                 break;
             case PVFS_SERV_MGMT_EVENT_MON:
+                resp.u.mgmt_event_mon.event_names = NULL;
                 resp.u.mgmt_event_mon.event_count = 0;
                 respsize = extra_size_PVFS_servresp_mgmt_event_mon;
                 break;
@@ -359,6 +362,22 @@ static void lebf_initialize(void)
                 req.u.mgmt_get_user_cert_keyreq.fs_id = 0;
                 respsize = extra_size_PVFS_servresp_mgmt_get_user_cert_keyreq;
                 break;
+            case PVFS_SERV_MGMT_GET_TOP:
+                resp.u.mgmt_get_top.client_names = NULL;
+                resp.u.mgmt_get_top.entry_count = 0;
+                respsize = extra_size_PVFS_servresp_mgmt_get_top;
+                break;
+            case PVFS_SERV_MGMT_REMOVE_TREE:
+                zero_credential(&req.u.mgmt_remove_tree.credential);
+                resp.u.mgmt_remove_tree.dir_array = NULL;
+                resp.u.mgmt_remove_tree.dir_count = 0;
+                respsize = extra_size_PVFS_servresp_mgmt_remove_tree;
+                break;
+            case PVFS_SERV_MGMT_SCAN:
+                resp.u.mgmt_scan.rec_array = NULL;
+                resp.u.mgmt_scan.rec_count = 0;
+                respsize = extra_size_PVFS_servresp_mgmt_scan;
+                break;
             case PVFS_SERV_NUM_OPS:  /* sentinel, should not hit */
                 assert(0);
                 break;
@@ -541,6 +560,9 @@ static int lebf_encode_req(
         CASE(PVFS_SERV_MGMT_SPLIT_DIRENT, mgmt_split_dirent);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT, mgmt_get_user_cert);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, mgmt_get_user_cert_keyreq);
+        CASE(PVFS_SERV_MGMT_GET_TOP, mgmt_get_top);
+        CASE(PVFS_SERV_MGMT_REMOVE_TREE, mgmt_remove_tree);
+        CASE(PVFS_SERV_MGMT_SCAN, mgmt_scan);
         case PVFS_SERV_GETCONFIG:
         case PVFS_SERV_MGMT_NOOP:
         case PVFS_SERV_PROTO_ERROR:
@@ -553,6 +575,7 @@ static int lebf_encode_req(
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
         case PVFS_SERV_JOB_TIMER:
+        case PVFS_SERV_DIRDATA_SPLIT:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, req->op);
             ret = -PVFS_ENOSYS;
@@ -646,6 +669,9 @@ static int lebf_encode_resp(
         CASE(PVFS_SERV_MGMT_GET_DIRENT, mgmt_get_dirent);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT, mgmt_get_user_cert);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, mgmt_get_user_cert_keyreq);
+        CASE(PVFS_SERV_MGMT_GET_TOP, mgmt_get_top);
+        CASE(PVFS_SERV_MGMT_REMOVE_TREE, mgmt_remove_tree);
+        CASE(PVFS_SERV_MGMT_SCAN, mgmt_scan);
         case PVFS_SERV_REMOVE:
         case PVFS_SERV_MGMT_REMOVE_OBJECT:
         case PVFS_SERV_MGMT_REMOVE_DIRENT:
@@ -669,6 +695,7 @@ static int lebf_encode_resp(
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
         case PVFS_SERV_JOB_TIMER:
+        case PVFS_SERV_DIRDATA_SPLIT:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_err("%s: invalid operation %d\n", __func__, resp->op);
             ret = -PVFS_ENOSYS;
@@ -769,6 +796,9 @@ static int lebf_decode_req(
         CASE(PVFS_SERV_MGMT_SPLIT_DIRENT, mgmt_split_dirent);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT, mgmt_get_user_cert);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, mgmt_get_user_cert_keyreq);
+        CASE(PVFS_SERV_MGMT_GET_TOP, mgmt_get_top);
+        CASE(PVFS_SERV_MGMT_REMOVE_TREE, mgmt_remove_tree);
+        CASE(PVFS_SERV_MGMT_SCAN, mgmt_scan);
         case PVFS_SERV_GETCONFIG:
         case PVFS_SERV_MGMT_NOOP:
         case PVFS_SERV_IMM_COPIES:
@@ -780,6 +810,7 @@ static int lebf_decode_req(
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
         case PVFS_SERV_JOB_TIMER:
+        case PVFS_SERV_DIRDATA_SPLIT:
         case PVFS_SERV_PROTO_ERROR:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_lerr("%s: invalid operation %d.\n", __func__, req->op);
@@ -864,6 +895,9 @@ static int lebf_decode_resp(
         CASE(PVFS_SERV_MGMT_GET_DIRENT, mgmt_get_dirent);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT, mgmt_get_user_cert);
         CASE(PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ, mgmt_get_user_cert_keyreq);
+        CASE(PVFS_SERV_MGMT_GET_TOP, mgmt_get_top);
+        CASE(PVFS_SERV_MGMT_REMOVE_TREE, mgmt_remove_tree);
+        CASE(PVFS_SERV_MGMT_SCAN, mgmt_scan);
         case PVFS_SERV_REMOVE:
         case PVFS_SERV_BATCH_REMOVE:
         case PVFS_SERV_MGMT_REMOVE_OBJECT:
@@ -887,6 +921,7 @@ static int lebf_decode_resp(
         case PVFS_SERV_PERF_UPDATE:
         case PVFS_SERV_PRECREATE_POOL_REFILLER:
         case PVFS_SERV_JOB_TIMER:
+        case PVFS_SERV_DIRDATA_SPLIT:
         case PVFS_SERV_NUM_OPS:  /* sentinel */
             gossip_lerr("%s: invalid operation %d.\n", __func__, resp->op);
             ret = -PVFS_EPROTO;
@@ -1124,6 +1159,15 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
 #endif
                 break;
 
+            case PVFS_SERV_MGMT_REMOVE_TREE:
+                decode_free(req->u.mgmt_remove_tree.credential.group_array);
+                decode_free(req->u.mgmt_remove_tree.credential.signature);
+#ifdef ENABLE_SECURITY_CERT
+                decode_free(
+                    req->u.mgmt_remove_tree.credential.certificate.buf);
+#endif
+                break;
+
             case PVFS_SERV_MGMT_SPLIT_DIRENT:
                 decode_free(req->u.mgmt_split_dirent.dist);
                 decode_free(req->u.mgmt_split_dirent.entry_handles);
@@ -1154,6 +1198,8 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_MGMT_CREATE_ROOT_DIR:
             case PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ:
             case PVFS_SERV_MGMT_GET_USER_CERT:
+            case PVFS_SERV_MGMT_GET_TOP:
+            case PVFS_SERV_MGMT_SCAN:
               /*nothing to free*/
                   break;
             case PVFS_SERV_INVALID:
@@ -1161,6 +1207,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
             case PVFS_SERV_PERF_UPDATE:
             case PVFS_SERV_PRECREATE_POOL_REFILLER:
             case PVFS_SERV_JOB_TIMER:
+            case PVFS_SERV_DIRDATA_SPLIT:
             case PVFS_SERV_PROTO_ERROR:            
             case PVFS_SERV_NUM_OPS:  /* sentinel */
                 gossip_lerr("%s: invalid request operation %d.\n",
@@ -1365,6 +1412,24 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                       decode_free(resp->u.mgmt_get_user_cert_keyreq.public_key.buf);
                       break;
                    }
+
+                case PVFS_SERV_MGMT_GET_TOP:
+                   {
+                      decode_free(resp->u.mgmt_get_top.entry_array);
+                      break;
+                   }
+
+                case PVFS_SERV_MGMT_REMOVE_TREE:
+                   {
+                      decode_free(resp->u.mgmt_remove_tree.dir_array);
+                      break;
+                   }
+
+                case PVFS_SERV_MGMT_SCAN:
+                   {
+                      decode_free(resp->u.mgmt_scan.rec_array);
+                      break;
+                   }
                 case PVFS_SERV_GETCONFIG:
                 case PVFS_SERV_REMOVE:
                 case PVFS_SERV_MGMT_REMOVE_OBJECT:
@@ -1397,6 +1462,7 @@ static void lebf_decode_rel(struct PINT_decoded_msg *msg,
                 case PVFS_SERV_PERF_UPDATE:
                 case PVFS_SERV_PRECREATE_POOL_REFILLER:
                 case PVFS_SERV_JOB_TIMER:
+                case PVFS_SERV_DIRDATA_SPLIT:
                 case PVFS_SERV_NUM_OPS:  /* sentinel */
                     gossip_lerr("%s: invalid response operation %d.\n",
                                 __func__, resp->op);
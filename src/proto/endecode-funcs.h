@@ -482,6 +482,36 @@ static inline void decode_##name(char **pptr, name *x) { \
     decode_##t12(pptr, &x->x12); \
 }
 
+#define endecode_fields_12_struct(name,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7,t8,x8,t9,x9,t10,x10,t11,x11,t12,x12) \
+static inline void encode_##name(char **pptr, const struct name *x) { \
+    encode_##t1(pptr, &x->x1); \
+    encode_##t2(pptr, &x->x2); \
+    encode_##t3(pptr, &x->x3); \
+    encode_##t4(pptr, &x->x4); \
+    encode_##t5(pptr, &x->x5); \
+    encode_##t6(pptr, &x->x6); \
+    encode_##t7(pptr, &x->x7); \
+    encode_##t8(pptr, &x->x8); \
+    encode_##t9(pptr, &x->x9); \
+    encode_##t10(pptr, &x->x10); \
+    encode_##t11(pptr, &x->x11); \
+    encode_##t12(pptr, &x->x12); \
+} \
+static inline void decode_##name(char **pptr, struct name *x) { \
+    decode_##t1(pptr, &x->x1); \
+    decode_##t2(pptr, &x->x2); \
+    decode_##t3(pptr, &x->x3); \
+    decode_##t4(pptr, &x->x4); \
+    decode_##t5(pptr, &x->x5); \
+    decode_##t6(pptr, &x->x6); \
+    decode_##t7(pptr, &x->x7); \
+    decode_##t8(pptr, &x->x8); \
+    decode_##t9(pptr, &x->x9); \
+    decode_##t10(pptr, &x->x10); \
+    decode_##t11(pptr, &x->x11); \
+    decode_##t12(pptr, &x->x12); \
+}
+
 #define endecode_fields_15_struct(name,t1,x1,t2,x2,t3,x3,t4,x4,t5,x5,t6,x6,t7,x7, \
     t8,x8,t9,x9,t10,x10,t11,x11,t12,x12,t13,x13,t14,x14,t15,x15) \
 static inline void encode_##name(char **pptr, const struct name *x) { \
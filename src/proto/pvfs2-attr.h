@@ -45,6 +45,9 @@
 
 #define PVFS_ATTR_META_UNSTUFFED (1 << 12)
 
+/* the bytes of a tiny stuffed file, returned only by getattr */
+#define PVFS_ATTR_META_INLINE_DATA (1 << 14)
+
 
 /* internal attribute masks for datafile objects */
 #define PVFS_ATTR_DATA_SIZE            (1 << 15)
@@ -98,6 +101,10 @@ struct PVFS_metafile_attr_s
 
     int32_t stuffed_size;
 
+    /* contents of a file kept inline, see PVFS_ATTR_META_INLINE_DATA */
+    uint32_t inline_size;
+    char *inline_data;
+
     PVFS_metafile_hint hint;
 };
 typedef struct PVFS_metafile_attr_s PVFS_metafile_attr;
@@ -152,6 +159,16 @@ typedef struct PVFS_metafile_attr_s PVFS_metafile_attr;
 	decode_PVFS_handle(pptr, &(x)->dfile_array[dfiles_i]);            \
     decode_PVFS_metafile_hint(pptr, &(x)->hint);                          \
 } while (0)
+#define encode_PVFS_metafile_attr_inline_data(pptr,x) do {              \
+    *(u_int32_t *) *(pptr) = htobmi32((x)->inline_size);                \
+    memcpy(*(pptr)+4, (x)->inline_data, (x)->inline_size);              \
+    *(pptr) += roundup8(4 + (x)->inline_size);                          \
+} while (0)
+#define decode_PVFS_metafile_attr_inline_data(pptr,x) do {              \
+    (x)->inline_size = bmitoh32(*(u_int32_t *) *(pptr));                \
+    (x)->inline_data = *(pptr) + 4;                                     \
+    *(pptr) += roundup8(4 + (x)->inline_size);                          \
+} while (0)
 #endif
 
 /* attributes specific to datafile objects */
@@ -307,6 +324,8 @@ typedef struct PVFS_object_attr PVFS_object_attr;
 	encode_PVFS_metafile_attr_dfiles(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_META_MIRROR_DFILES) \
         encode_PVFS_metafile_attr_mirror_dfiles(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_INLINE_DATA) \
+        encode_PVFS_metafile_attr_inline_data(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_DATA_SIZE) \
 	encode_PVFS_datafile_attr(pptr, &(x)->u.data); \
     if ((x)->mask & PVFS_ATTR_SYMLNK_TARGET) \
@@ -349,6 +368,8 @@ typedef struct PVFS_object_attr PVFS_object_attr;
 	decode_PVFS_metafile_attr_dfiles(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_META_MIRROR_DFILES) \
         decode_PVFS_metafile_attr_mirror_dfiles(pptr, &(x)->u.meta); \
+    if ((x)->mask & PVFS_ATTR_META_INLINE_DATA) \
+        decode_PVFS_metafile_attr_inline_data(pptr, &(x)->u.meta); \
     if ((x)->mask & PVFS_ATTR_DATA_SIZE) \
 	decode_PVFS_datafile_attr(pptr, &(x)->u.data); \
     if ((x)->mask & PVFS_ATTR_SYMLNK_TARGET) \
@@ -26,7 +26,7 @@
  * compatibility (such as changing the semantics or protocol fields for an
  * existing request type)
  */
-#define PVFS2_PROTO_MAJOR 7
+#define PVFS2_PROTO_MAJOR 11
 /* update PVFS2_PROTO_MINOR on wire protocol changes that preserve backwards
  * compatibility (such as adding a new request type)
  * NOTE: Incrementing this will make clients unable to talk to older servers.
@@ -98,6 +98,10 @@ enum PVFS_server_op
     PVFS_SERV_TREE_GETATTR = 49,
     PVFS_SERV_MGMT_GET_USER_CERT = 50,
     PVFS_SERV_MGMT_GET_USER_CERT_KEYREQ = 51,
+    PVFS_SERV_MGMT_GET_TOP = 52,
+    PVFS_SERV_DIRDATA_SPLIT = 53, /* not a real protocol request */
+    PVFS_SERV_MGMT_REMOVE_TREE = 54,
+    PVFS_SERV_MGMT_SCAN = 55,
 
     /* leave this entry last */
     PVFS_SERV_NUM_OPS
@@ -163,6 +167,16 @@ enum PVFS_server_op
 #define PVFS_REQ_LIMIT_MGMT_PERF_MON_COUNT 16
 /* max number of events returned by mgmt event mon op */
 #define PVFS_REQ_LIMIT_MGMT_EVENT_MON_COUNT 2048
+/* max bytes of event and label names returned by mgmt event mon op */
+#define PVFS_REQ_LIMIT_MGMT_EVENT_NAMES_BYTES 16384
+/* max number of heavy hitters returned by mgmt get top op */
+#define PVFS_REQ_LIMIT_MGMT_TOP_COUNT 64
+/* max bytes of client names returned by mgmt get top op */
+#define PVFS_REQ_LIMIT_MGMT_TOP_NAMES_BYTES 8192
+/* max number of entries removed by one mgmt remove tree op */
+#define PVFS_REQ_LIMIT_MGMT_REMOVE_TREE_COUNT 128
+/* max number of objects examined by one mgmt scan op */
+#define PVFS_REQ_LIMIT_MGMT_SCAN_COUNT 1024
 /* max number of handles returned by any operation using an array of handles */
 #define PVFS_REQ_LIMIT_HANDLES_COUNT PVFS_SYS_LIMIT_HANDLES_COUNT
 /* max number of handles that can be created at once using batch create */
@@ -181,6 +195,10 @@ enum PVFS_server_op
 #define PVFS_REQ_LIMIT_KEY_LEN 128
 /* max number of bytes in a value of a key/value/pair */
 #define PVFS_REQ_LIMIT_VAL_LEN 4096
+/* max number of bytes of file data kept inline with a stuffed file */
+#define PVFS_REQ_LIMIT_INLINE_DATA 4096
+/* max number of bytes of write data sent right behind an I/O request */
+#define PVFS_REQ_LIMIT_EAGER_WRITE (1024*1024)
 /* max number of key/value pairs to set or get in a list operation */
 #define PVFS_REQ_LIMIT_KEYVAL_LIST 32
 /* max number of bytes in an extended attribute key including null term */
@@ -206,7 +224,9 @@ enum PVFS_server_op
 /* create *********************************************************/
 /* - used to create an object.  This creates a metadata handle,
  * a datafile handle, and links the datafile handle to the metadata handle.
- * It also sets the attributes on the metadata. */
+ * It also sets the attributes on the metadata.  If a dirent name is given,
+ * the server also inserts the new file into the parent directory (forwarding
+ * the insert to the dirdata server if needed) before responding. */
 
 struct PVFS_servreq_create
 {
@@ -215,22 +235,30 @@ struct PVFS_servreq_create
     PVFS_object_attr attr;
 
     int32_t num_dfiles_req;
+    char *dirent_name;          /* name of new entry, NULL/empty for none */
+    PVFS_handle parent_handle;  /* handle of parent directory */
+    PVFS_handle dirent_handle;  /* handle of dirdata to insert into */
     /* NOTE: leave layout as final field so that we can deal with encoding
      * errors */
     PVFS_sys_layout layout;
 };
-endecode_fields_6_struct(
+endecode_fields_10_struct(
     PVFS_servreq_create,
     PVFS_fs_id, fs_id,
     skip4,,
     PVFS_credential, credential,
     PVFS_object_attr, attr,
     int32_t, num_dfiles_req,
+    skip4,,
+    string, dirent_name,
+    PVFS_handle, parent_handle,
+    PVFS_handle, dirent_handle,
     PVFS_sys_layout, layout);
 
 #define extra_size_PVFS_servreq_create                          \
     (extra_size_PVFS_object_attr + extra_size_PVFS_sys_layout + \
-     extra_size_PVFS_credential)
+     extra_size_PVFS_credential +                               \
+     roundup8(PVFS_REQ_LIMIT_SEGMENT_BYTES+1))
 
 #define PINT_SERVREQ_CREATE_FILL(__req,                       \
                                  __cap,                       \
@@ -258,6 +286,17 @@ do {                                                          \
     (__req).u.create.layout = __layout;                       \
 } while (0)
 
+/* turns a filled create request into a compound create-and-link */
+#define PINT_SERVREQ_CREATE_DIRENT_FILL(__req,                \
+                                        __name,               \
+                                        __parent_handle,      \
+                                        __dirent_handle)      \
+do {                                                          \
+    (__req).u.create.dirent_name = (__name);                  \
+    (__req).u.create.parent_handle = (__parent_handle);       \
+    (__req).u.create.dirent_handle = (__dirent_handle);       \
+} while (0)
+
 struct PVFS_servresp_create
 {
    PVFS_handle metafile_handle;
@@ -805,8 +844,9 @@ struct PVFS_servresp_getattr
 endecode_fields_1_struct(
     PVFS_servresp_getattr,
     PVFS_object_attr, attr);
+/* only getattr returns inline file data, so only it makes room for it */
 #define extra_size_PVFS_servresp_getattr \
-    extra_size_PVFS_object_attr
+    (extra_size_PVFS_object_attr + 8 + PVFS_REQ_LIMIT_INLINE_DATA)
 
 /* unstuff ****************************************************/
 /* - creates the datafile handles for the file.  This allows a stuffed
@@ -1477,6 +1517,9 @@ struct PVFS_servreq_io
     PVFS_offset file_req_offset;
     /* aggregate size of data to transfer */
     PVFS_size aggregate_size;
+    /* bytes of write data that follow the request in one expected
+     * message instead of a flow; 0 if the data waits for the ack */
+    PVFS_size eager_size;
 };
 #ifdef __PINT_REQPROTO_ENCODE_FUNCS_C
 #define encode_PVFS_servreq_io(pptr,x) do {          \
@@ -1491,6 +1534,7 @@ struct PVFS_servreq_io
     encode_PINT_Request(pptr, &(x)->file_req);       \
     encode_PVFS_offset(pptr, &(x)->file_req_offset); \
     encode_PVFS_size(pptr, &(x)->aggregate_size);    \
+    encode_PVFS_size(pptr, &(x)->eager_size);        \
 } while (0)
 #define decode_PVFS_servreq_io(pptr,x) do {                        \
     decode_PVFS_handle(pptr, &(x)->handle);                        \
@@ -1505,6 +1549,7 @@ struct PVFS_servreq_io
     PINT_request_decode((x)->file_req); /* unpacks the pointers */ \
     decode_PVFS_offset(pptr, &(x)->file_req_offset);               \
     decode_PVFS_size(pptr, &(x)->aggregate_size);                  \
+    decode_PVFS_size(pptr, &(x)->eager_size);                      \
 } while (0)
 /* could be huge, limit to max ioreq size beyond struct itself */
 #define extra_size_PVFS_servreq_io roundup8(PVFS_REQ_LIMIT_PATH_NAME_BYTES) \
@@ -1998,17 +2043,20 @@ do {                                                                           \
 
 struct PVFS_servresp_mgmt_event_mon
 {
+    char *event_names;
     struct PVFS_mgmt_event* event_array;
     uint32_t event_count;
 };
-endecode_fields_1a_struct(
+endecode_fields_2a_struct(
     PVFS_servresp_mgmt_event_mon,
+    string, event_names,
     skip4,,
     uint32_t, event_count,
     PVFS_mgmt_event, event_array);
 #define extra_size_PVFS_servresp_mgmt_event_mon \
   (PVFS_REQ_LIMIT_MGMT_EVENT_MON_COUNT *        \
-   roundup8(sizeof(struct PVFS_mgmt_event)))
+   roundup8(sizeof(struct PVFS_mgmt_event)) +   \
+   roundup8(PVFS_REQ_LIMIT_MGMT_EVENT_NAMES_BYTES + 5))
 
 /* geteattr ****************************************************/
 /* - retrieves list of extended attributes */
@@ -2318,6 +2366,168 @@ endecode_fields_1a_struct(
 #define extra_size_PVFS_servresp_mgmt_get_uid \
     UID_MGMT_MAX_HISTORY * sizeof(PVFS_uid_info_s)
 
+/* mgmt_get_top ****************************************************/
+/* retrieves the heaviest clients, users or objects from a server */
+
+struct PVFS_servreq_mgmt_get_top
+{
+    uint32_t kind;         /* enum PVFS_mgmt_top_kind */
+    uint32_t metric;       /* enum PVFS_mgmt_top_metric */
+    uint32_t entry_count;  /* max entries to return */
+};
+endecode_fields_3_struct(
+    PVFS_servreq_mgmt_get_top,
+    uint32_t, kind,
+    uint32_t, metric,
+    uint32_t, entry_count);
+
+#define PINT_SERVREQ_MGMT_GET_TOP_FILL(__req,            \
+                                       __cap,            \
+                                       __kind,           \
+                                       __metric,         \
+                                       __entry_count,    \
+                                       __hints)          \
+do {                                                     \
+    memset(&(__req), 0, sizeof(__req));                  \
+    (__req).op = PVFS_SERV_MGMT_GET_TOP;                 \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));          \
+    (__req).hints = (__hints);                           \
+    (__req).u.mgmt_get_top.kind = (__kind);              \
+    (__req).u.mgmt_get_top.metric = (__metric);          \
+    (__req).u.mgmt_get_top.entry_count = (__entry_count);\
+} while (0)
+
+struct PVFS_servresp_mgmt_get_top
+{
+    char *client_names;    /* newline separated, PVFS_MGMT_TOP_CLIENT only */
+    struct PVFS_mgmt_top_entry *entry_array;
+    uint32_t entry_count;
+};
+endecode_fields_2a_struct(
+    PVFS_servresp_mgmt_get_top,
+    string, client_names,
+    skip4,,
+    uint32_t, entry_count,
+    PVFS_mgmt_top_entry, entry_array);
+#define extra_size_PVFS_servresp_mgmt_get_top               \
+  (PVFS_REQ_LIMIT_MGMT_TOP_COUNT *                          \
+   roundup8(sizeof(struct PVFS_mgmt_top_entry)) +           \
+   roundup8(PVFS_REQ_LIMIT_MGMT_TOP_NAMES_BYTES + 5))
+
+/* mgmt_remove_tree ***********************************************/
+/* - removes a batch of entries, and the objects they refer to, from one
+ *   dirdata bucket of a directory; subdirectories that are not empty are
+ *   left in place and returned so the caller can descend into them
+ */
+
+struct PVFS_servreq_mgmt_remove_tree
+{
+    PVFS_handle handle;        /* dirdata handle */
+    PVFS_fs_id fs_id;
+    uint32_t entry_count;      /* max entries to remove */
+    PVFS_ds_position token;    /* position to continue from */
+    PVFS_credential credential;
+};
+endecode_fields_5_struct(
+    PVFS_servreq_mgmt_remove_tree,
+    PVFS_handle, handle,
+    PVFS_fs_id, fs_id,
+    uint32_t, entry_count,
+    PVFS_ds_position, token,
+    PVFS_credential, credential);
+
+#define PINT_SERVREQ_MGMT_REMOVE_TREE_FILL(__req,                 \
+                                           __cap,                 \
+                                           __cred,                \
+                                           __fsid,                \
+                                           __handle,              \
+                                           __token,               \
+                                           __entry_count,         \
+                                           __hints)               \
+do {                                                              \
+    memset(&(__req), 0, sizeof(__req));                           \
+    (__req).op = PVFS_SERV_MGMT_REMOVE_TREE;                      \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));                   \
+    (__req).hints = (__hints);                                    \
+    (__req).u.mgmt_remove_tree.credential = (__cred);             \
+    (__req).u.mgmt_remove_tree.fs_id = (__fsid);                  \
+    (__req).u.mgmt_remove_tree.handle = (__handle);               \
+    (__req).u.mgmt_remove_tree.token = (__token);                 \
+    (__req).u.mgmt_remove_tree.entry_count = (__entry_count);     \
+} while (0)
+
+struct PVFS_servresp_mgmt_remove_tree
+{
+    PVFS_ds_position token;    /* position to continue from */
+    uint32_t removed_count;    /* entries removed along with their objects */
+    uint32_t failed_count;     /* entries left in place after an error */
+    PVFS_error error;          /* first error seen, if failed_count > 0 */
+    uint32_t dir_count;        /* subdirectories that were not empty */
+    PVFS_dirent *dir_array;
+};
+endecode_fields_4a_struct(
+    PVFS_servresp_mgmt_remove_tree,
+    PVFS_ds_position, token,
+    uint32_t, removed_count,
+    uint32_t, failed_count,
+    PVFS_error, error,
+    uint32_t, dir_count,
+    PVFS_dirent, dir_array);
+#define extra_size_PVFS_servresp_mgmt_remove_tree \
+  (PVFS_REQ_LIMIT_MGMT_REMOVE_TREE_COUNT * sizeof(PVFS_dirent))
+
+/* mgmt_scan ******************************************************/
+/* - reads the attributes of the next objects stored on a server, in
+ *   handle order, and returns the ones that pass a filter
+ */
+
+struct PVFS_servreq_mgmt_scan
+{
+    PVFS_fs_id fs_id;
+    uint32_t rec_count;        /* max objects to examine */
+    PVFS_ds_position position; /* position to continue from */
+    struct PVFS_mgmt_scan_filter filter;
+};
+endecode_fields_4_struct(
+    PVFS_servreq_mgmt_scan,
+    PVFS_fs_id, fs_id,
+    uint32_t, rec_count,
+    PVFS_ds_position, position,
+    PVFS_mgmt_scan_filter, filter);
+
+#define PINT_SERVREQ_MGMT_SCAN_FILL(__req,                        \
+                                    __cap,                        \
+                                    __fs_id,                      \
+                                    __rec_count,                  \
+                                    __position,                   \
+                                    __filter,                     \
+                                    __hints)                      \
+do {                                                              \
+    memset(&(__req), 0, sizeof(__req));                           \
+    (__req).op = PVFS_SERV_MGMT_SCAN;                             \
+    PVFS_REQ_COPY_CAPABILITY((__cap), (__req));                   \
+    (__req).hints = (__hints);                                    \
+    (__req).u.mgmt_scan.fs_id = (__fs_id);                        \
+    (__req).u.mgmt_scan.rec_count = (__rec_count);                \
+    (__req).u.mgmt_scan.position = (__position);                  \
+    (__req).u.mgmt_scan.filter = (__filter);                      \
+} while (0)
+
+struct PVFS_servresp_mgmt_scan
+{
+    PVFS_ds_position position; /* position to continue from */
+    uint32_t rec_count;        /* objects that passed the filter */
+    struct PVFS_mgmt_scan_rec *rec_array;
+};
+endecode_fields_2a_struct(
+    PVFS_servresp_mgmt_scan,
+    PVFS_ds_position, position,
+    skip4,,
+    uint32_t, rec_count,
+    PVFS_mgmt_scan_rec, rec_array);
+#define extra_size_PVFS_servresp_mgmt_scan \
+  (PVFS_REQ_LIMIT_MGMT_SCAN_COUNT * sizeof(struct PVFS_mgmt_scan_rec))
+
 /* mgmt_get_dirent ************************************************/
 /* - used to retrieve the handle of the specified directory entry */
 struct PVFS_servreq_mgmt_get_dirent
@@ -2603,6 +2813,9 @@ struct PVFS_server_req
         struct PVFS_servreq_mgmt_split_dirent mgmt_split_dirent;
         struct PVFS_servreq_mgmt_get_user_cert mgmt_get_user_cert;
         struct PVFS_servreq_mgmt_get_user_cert_keyreq mgmt_get_user_cert_keyreq;
+        struct PVFS_servreq_mgmt_get_top mgmt_get_top;
+        struct PVFS_servreq_mgmt_remove_tree mgmt_remove_tree;
+        struct PVFS_servreq_mgmt_scan mgmt_scan;
     } u;
 };
 #ifdef __PINT_REQPROTO_ENCODE_FUNCS_C
@@ -2667,6 +2880,9 @@ struct PVFS_server_resp
         struct PVFS_servresp_mgmt_get_dirent mgmt_get_dirent;
         struct PVFS_servresp_mgmt_get_user_cert mgmt_get_user_cert;
         struct PVFS_servresp_mgmt_get_user_cert_keyreq mgmt_get_user_cert_keyreq;
+        struct PVFS_servresp_mgmt_get_top mgmt_get_top;
+        struct PVFS_servresp_mgmt_remove_tree mgmt_remove_tree;
+        struct PVFS_servresp_mgmt_scan mgmt_scan;
     } u;
 };
 endecode_fields_2_struct(
@@ -66,10 +66,10 @@ int PINT_get_capabilities(void *acl_buf,
 
     *op_mask = 0;
     
-    /* root has every possible capability */
+    /* root has every possible capability but the servers' own */
     if (userid == 0)
     {
-        *op_mask = ~((uint32_t)0);
+        *op_mask = ~((uint32_t)PINT_CAP_SERVER);
         /* remove dir-only capabilities */
         if (attr->objtype != PVFS_TYPE_DIRECTORY)
         {
@@ -50,6 +50,7 @@
 #include "client-state-machine.h"
 /* #include "pint-malloc.h" */
 #include "pint-uid-mgmt.h"
+#include "pint-top.h"
 #include "pint-security.h"
 #include "security-util.h"
 #ifdef ENABLE_CAPCACHE
@@ -99,7 +100,7 @@ static struct server_configuration_s server_config;
 static int signal_recvd_flag = 0;
 static pid_t server_controlling_pid = 0;
 
-static PINT_event_id PINT_sm_event_id;
+static PINT_event_type PINT_sm_event_id;
 
 /* A list of all serv_op's posted for unexpected message alone */
 QLIST_HEAD(posted_sop_list);
@@ -142,6 +143,7 @@ PINT_server_trove_keys_s Trove_Common_Keys[] =
     {DIST_DIR_ATTR_KEYSTR,        DIST_DIR_ATTR_KEYLEN},
     {DIST_DIRDATA_BITMAP_KEYSTR,  DIST_DIRDATA_BITMAP_KEYLEN},
     {DIST_DIRDATA_HANDLES_KEYSTR, DIST_DIRDATA_HANDLES_KEYLEN},
+    {INLINE_DATA_KEYSTR,          INLINE_DATA_KEYLEN},
 };
 
 PINT_server_trove_keys_s Trove_Special_Keys[] =
@@ -794,25 +796,43 @@ static int server_initialize_subsystems(
     int bmi_flags = BMI_INIT_SERVER;
     int server_index;
 
-    if(server_config.enable_events)
+    /* TAU when configured for it, otherwise the native ring buffers that
+     * mgmt_event_mon drains; either way nothing is recorded until events
+     * are enabled, here with EnableTracing or later with setparam
+     */
+#ifdef HAVE_TAU
+    ret = PINT_event_init(server_config.enable_events ?
+                          PINT_EVENT_TRACE_TAU : PINT_EVENT_TRACE_NATIVE);
+#else
+    ret = PINT_event_init(PINT_EVENT_TRACE_NATIVE);
+#endif
+    if (ret < 0)
     {
-        ret = PINT_event_init(PINT_EVENT_TRACE_TAU);
-        if (ret < 0)
-        {
-            gossip_err("Error initializing event interface.\n");
-            return (ret);
-        }
+        gossip_err("Error initializing event interface.\n");
+        return (ret);
+    }
 
-        /* Define the state machine event:
-         *   START: (client_id, request_id, rank, handle, op_id)
-         *   STOP: ()
-         */
-        PINT_event_define_event(
-            NULL, "sm", "%d%d%d%llu%d", "", &PINT_sm_event_id);
+    /* Define the state machine event:
+     *   START: (op name, client_id, request_id, rank, handle)
+     *   STOP: ()
+     */
+    PINT_event_define_event(
+        NULL, "sm", "%s%d%d%d%llu", "", &PINT_sm_event_id);
+
+    /* Define the state action event:
+     *   START: (machine name, state name)
+     *   STOP: ()
+     */
+    PINT_event_define_event(
+        NULL, "sm_state", "%s%s", "", &PINT_sm_state_event_id);
 
-        *server_status_flag |= SERVER_EVENT_INIT;
+    if(server_config.enable_events)
+    {
+        PINT_event_enable("all");
     }
 
+    *server_status_flag |= SERVER_EVENT_INIT;
+
     /* Initialize distributions */
     ret = PINT_dist_initialize(0);
     if (ret < 0)
@@ -1171,6 +1191,15 @@ static int server_initialize_subsystems(
                 return ret;
             } 
 
+            ret = trove_collection_setinfo(cur_fs->coll_id, trove_context,
+                                  TROVE_COLLECTION_PACKED_BSTREAM_MAX,
+                                  (void *)&cur_fs->packed_bstream_max);
+            if(ret < 0)
+            {
+                gossip_err("Error setting trove packed bstream size\n");
+                return ret;
+            }
+
             gossip_debug(GOSSIP_SERVER_DEBUG, "File system %s using "
                          "handles:\n\t%s\n", cur_fs->file_system_name,
                          cur_merged_handle_range);
@@ -1339,6 +1368,15 @@ static int server_initialize_subsystems(
 
     *server_status_flag |= SERVER_UID_MGMT_INIT;
 
+    ret = PINT_top_initialize();
+    if (ret < 0)
+    {
+        gossip_err("Error initializing the heavy hitter tables\n");
+        return (ret);
+    }
+
+    *server_status_flag |= SERVER_TOP_INIT;
+
     ret = precreate_pool_initialize(server_index);
     if (ret < 0)
     {
@@ -1749,6 +1787,28 @@ static void reload_config(void)
             orig_fs->exp_anon_uid = hup_fs->exp_anon_uid;
             orig_fs->exp_anon_gid = hup_fs->exp_anon_gid;
 
+            /* Update fair-share admission.  The request scheduler reads
+             * these on each post, so the new limits and weights apply to
+             * the next request; held requests keep their place.
+             */
+            orig_fs->fair_share = hup_fs->fair_share;
+            orig_fs->fair_share_max_ops = hup_fs->fair_share_max_ops;
+            orig_fs->fair_share_max_bytes = hup_fs->fair_share_max_bytes;
+            orig_fs->fair_share_quantum = hup_fs->fair_share_quantum;
+            orig_fs->fair_share_unit_bytes = hup_fs->fair_share_unit_bytes;
+
+            tmp_value = orig_fs->fair_share_weight_count;
+            orig_fs->fair_share_weight_count = hup_fs->fair_share_weight_count;
+            hup_fs->fair_share_weight_count = tmp_value;
+
+            tmp_ptr = orig_fs->fair_share_weight_keys;
+            orig_fs->fair_share_weight_keys = hup_fs->fair_share_weight_keys;
+            hup_fs->fair_share_weight_keys = tmp_ptr;
+
+            tmp_int_ptr = orig_fs->fair_share_weights;
+            orig_fs->fair_share_weights = hup_fs->fair_share_weights;
+            hup_fs->fair_share_weights = tmp_int_ptr;
+
             orig_filesystems = PINT_llist_next(orig_filesystems);
         }
 #ifdef USE_TRUSTED
@@ -1994,6 +2054,11 @@ static int server_shutdown(PINT_server_status_flag status,
 
     }
 
+    if (status & SERVER_TOP_INIT)
+    {
+        PINT_top_finalize();
+    }
+
     if (status & SERVER_GOSSIP_INIT)
     {
         gossip_debug(GOSSIP_SERVER_DEBUG,
@@ -2426,11 +2491,11 @@ int server_state_machine_start(
                          server_controlling_pid,
                          NULL,
                          &s_op->event_id,
+                         PINT_map_server_op_to_string(s_op->req->op),
                          PINT_HINT_GET_CLIENT_ID(s_op->req->hints),
                          PINT_HINT_GET_REQUEST_ID(s_op->req->hints),
                          PINT_HINT_GET_RANK(s_op->req->hints),
-                         PINT_HINT_GET_HANDLE(s_op->req->hints),
-                         s_op->req->op);
+                         PINT_HINT_GET_HANDLE(s_op->req->hints));
 
         s_op->resp.op = s_op->req->op;
 
@@ -2658,7 +2723,8 @@ struct PINT_state_machine_s *server_op_state_get_machine(int op)
         }
     default :
         {
-            if (op >= 0 && op < PVFS_SERV_NUM_OPS)
+            if (op >= 0 && op < PVFS_SERV_NUM_OPS &&
+                PINT_server_req_table[op].params)
                 return PINT_server_req_table[op].params->state_machine;
             else
                 return NULL;
@@ -106,7 +106,8 @@ enum
     NUM_DFILES_REQ_KEY       = 6,       
     DIST_DIR_ATTR_KEY        = 7,
     DIST_DIRDATA_BITMAP_KEY  = 8,
-    DIST_DIRDATA_HANDLES_KEY = 9
+    DIST_DIRDATA_HANDLES_KEY = 9,
+    INLINE_DATA_KEY          = 10
 
 };
 
@@ -159,7 +160,8 @@ typedef enum
     SERVER_SECURITY_INIT       = (1 << 20),
     SERVER_CAPCACHE_INIT       = (1 << 21),
     SERVER_CREDCACHE_INIT      = (1 << 22),
-    SERVER_CERTCACHE_INIT      = (1 << 23)
+    SERVER_CERTCACHE_INIT      = (1 << 23),
+    SERVER_TOP_INIT            = (1 << 24)
 } PINT_server_status_flag;
 
 typedef enum
@@ -178,6 +180,10 @@ struct PINT_server_create_op
     int handle_array_remote_count;
     PVFS_error saved_error_code;
     int handle_index;
+    /* server-to-server capability for forwarding the dirent insert */
+    PVFS_capability capability;
+    /* scheduler slot on the dirdata handle held by a local insert */
+    job_id_t dirent_scheduled_id;
 };
 
 /*MIRROR structures*/
@@ -217,6 +223,9 @@ struct PINT_server_mirror_op
 
    /*info about each job*/
    write_job_t *jobs;
+
+   /*hints of the write requests*/
+   PVFS_hint hints;
 };
 typedef struct PINT_server_mirror_op PINT_server_mirror_op;
 
@@ -396,19 +405,48 @@ struct PINT_server_crdirent_op
 
     /* Save the old directory attrs in case we have to back out due to an error. */
     PVFS_object_attr saved_attr;
+};
 
-    /* variables used for sending mgmt_split_dirent request */
-    PVFS_BMI_addr_t svr_addr; /*destination server address*/
-    PVFS_error *split_status; /*status from PVFS_SERV_MGMT_SPLIT_DIRENT*/
+struct dirdata_split_marker;
+
+/* background split of a dirdata bucket, see dirdata-split.sm */
+struct PINT_server_dirdata_split_op
+{
+    PVFS_credential credential;
+    PVFS_capability capability;
+    PVFS_fs_id fs_id;
+    PVFS_handle parent_handle;
+    PVFS_handle dirent_handle;  /* dirdata dspace being split */
+    int split_node;
+
+    /* attrs before the split, to back out to on error */
+    PVFS_object_attr saved_attr;
+    struct dirdata_split_marker *marker;
     PINT_dist *dist; /*distribution structure for basic_dist*/
-    int read_all_directory_entries;
+
+    /* streaming cursor and the batch it last returned */
+    PVFS_ds_position pos;
+    PVFS_ds_keyval *batch_key_a;
+    PVFS_ds_keyval *batch_val_a;
+
+    /* entries copied to the new bucket so far; the ones from
+     * first_unsent on are not sent yet */
     int nentries;
+    int max_entries;
+    int first_unsent;
     PVFS_handle *entry_handles;
     char **entry_names;
+    struct qhash_table *entry_table;
+
+    /* names touched while streaming, resent under the scheduler */
+    int touched_count;
+    char **touched_names;
+    PVFS_handle *touched_handles;
+    PVFS_error *touched_errors;
+
     int num_msgs_required;
     split_msg_boundary *msg_boundaries;
-    PVFS_ds_keyval *entries_key_a;
-    PVFS_ds_keyval *entries_val_a;
+    PVFS_error *split_status; /*status from PVFS_SERV_MGMT_SPLIT_DIRENT*/
     PVFS_handle *remote_dirdata_handles;
 };
 
@@ -498,6 +536,40 @@ struct PINT_server_batch_remove_op
     int error_code;
 };
 
+/* one batch of a subtree removal, see mgmt-remove-tree.sm */
+struct PINT_server_mgmt_remove_tree_op
+{
+    PVFS_ds_attributes dirdata_ds_attr;
+    PVFS_ds_position token;
+
+    /* entries read from the bucket and what became of each */
+    PVFS_dirent *entries;
+    int *entry_state;
+    int entry_count;
+
+    /* datafiles or objects handed to the current tree_remove, and the
+     * entry each belongs to */
+    PVFS_handle *handles;
+    int *handle_entry;
+    int handle_count;
+    int max_handles;
+
+    uint32_t removed_count;
+    uint32_t failed_count;
+    PVFS_error error;
+    PVFS_dirent *dir_array;
+    uint32_t dir_count;
+};
+
+/* one batch of a metadata scan, see mgmt-scan.sm */
+struct PINT_server_mgmt_scan_op
+{
+    PVFS_handle *handle_array;
+    PVFS_ds_attributes *ds_attr_array;
+    PVFS_error *error_array;
+    int handle_count;
+};
+
 struct PINT_server_mgmt_get_dirdata_op
 {
     PVFS_handle dirdata_handle;
@@ -512,6 +584,14 @@ struct PINT_server_getconfig_op
 struct PINT_server_io_op
 {
     flow_descriptor* flow_d;
+
+    /* write data that came right behind the request (io.sm) */
+    void *eager_buffer;
+    PVFS_size eager_charged;    /* bytes of io.sm's eager budget held */
+    int eager_refused;          /* error to refuse the eager data with */
+    PVFS_offset eager_offsets[IO_MAX_REGIONS];
+    PVFS_size eager_sizes[IO_MAX_REGIONS];
+    PVFS_size eager_written;
 };
 
 struct PINT_server_small_io_op
@@ -521,6 +601,17 @@ struct PINT_server_small_io_op
     PVFS_size result_bytes;
 };
 
+/* scratch space for the inline data of a datafile (inline-data.sm);
+ * outside the union since the I/O machines that use it have their own
+ */
+struct PINT_server_inline_data_op
+{
+    PVFS_size size;        /* bytes of inline data once a write is done */
+    int discard;           /* drop rather than move the inline data */
+    PVFS_offset offset;    /* region of the bstream it is moved to */
+    PVFS_size out_size;
+};
+
 struct PINT_server_flush_op
 {
     PVFS_handle handle;        /* handle of data we want to flush to disk */
@@ -628,6 +719,9 @@ struct PINT_server_perf_update_op
 {
     struct PINT_perf_counter *pc;
     struct PINT_perf_counter *tpc;
+    /* state machine allocation totals at the last rollover */
+    uint64_t sm_allocs;
+    uint64_t sm_alloc_misses;
 };
 
 /* This structure is passed into the void *ptr 
@@ -674,6 +768,7 @@ typedef struct PINT_server_op
     PVFS_object_attr attr;
 
     PVFS_BMI_addr_t addr;   /* address of client that contacted us */
+    int cap_verified; /* prelude already verified req->capability */
     bmi_msg_tag_t tag; /* operation tag */
     /* information about unexpected message that initiated this operation */
     struct BMI_unexpected_info unexp_bmi_buff;
@@ -691,6 +786,8 @@ typedef struct PINT_server_op
     PVFS_fs_id target_fs_id;
     PVFS_object_attr *target_object_attr;
 
+    struct PINT_server_inline_data_op inline_data;
+
     PINT_prelude_flag prelude_mask;
 
     enum PINT_server_req_access_type access_type;
@@ -708,6 +805,7 @@ typedef struct PINT_server_op
         struct PINT_server_getconfig_op getconfig;
         struct PINT_server_lookup_op lookup;
         struct PINT_server_crdirent_op crdirent;
+        struct PINT_server_dirdata_split_op dirdata_split;
         struct PINT_server_setattr_op setattr;
         struct PINT_server_readdir_op readdir;
         struct PINT_server_remove_op remove;
@@ -724,6 +822,8 @@ typedef struct PINT_server_op
                                                precreate_pool_refiller;
         struct PINT_server_batch_create_op batch_create;
         struct PINT_server_batch_remove_op batch_remove;
+        struct PINT_server_mgmt_remove_tree_op mgmt_remove_tree;
+        struct PINT_server_mgmt_scan_op mgmt_scan;
         struct PINT_server_unstuff_op unstuff;
         struct PINT_server_create_copies_op create_copies;
         struct PINT_server_mirror_op mirror;
@@ -922,13 +1022,32 @@ extern struct PINT_state_machine_s pvfs2_tree_get_file_size_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_getattr_work_sm;
 extern struct PINT_state_machine_s pvfs2_tree_setattr_work_sm;
 extern struct PINT_state_machine_s pvfs2_call_msgpairarray_sm;
+extern struct PINT_state_machine_s pvfs2_inline_data_migrate_sm;
 
 extern void tree_getattr_free(PINT_server_op *s_op);
 extern void tree_setattr_free(PINT_server_op *s_op);
 extern void tree_remove_free(PINT_server_op *s_op);
 extern void mkdir_free(struct PINT_server_op *s_op);
+extern void crdirent_free(struct PINT_server_op *s_op);
+
+/* background dirdata splits (dirdata-split.sm) */
+int dirdata_split_start(PVFS_fs_id fs_id,
+                        PVFS_handle parent_handle,
+                        PVFS_handle dirent_handle,
+                        const PVFS_credential *credential,
+                        int split_node,
+                        PVFS_object_attr *saved_attr,
+                        PVFS_object_attr *new_attr);
+int dirdata_split_in_progress(PVFS_handle dirent_handle);
+int dirdata_split_note(PVFS_handle dirent_handle, const char *name);
 extern void getattr_free(struct PINT_server_op *s_op);
 
+/* inline data of tiny stuffed files (inline-data.sm) */
+int inline_data_read(struct PINT_smcb *smcb,
+                     PVFS_fs_id fs_id,
+                     PVFS_handle handle,
+                     job_status_s *js_p);
+
 /* Exported Prototypes */
 int server_perf_start_rollover(struct PINT_perf_counter *pc,
                                struct PINT_perf_counter *tpc);
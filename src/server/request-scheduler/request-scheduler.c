@@ -16,6 +16,9 @@
  *  \note this is a prototype.  It simply hashes on the handle
  *  value in the request and builds a linked list for each handle.
  *  Only the request at the head of each list is allowed to proceed.
+ *
+ *  File systems that set FairShare put an admission gate in front of
+ *  the handle queues; see the fair-share section below.
  */
 
 /* LONG TERM
@@ -88,6 +91,12 @@ struct req_sched_element
     enum PINT_server_req_access_type access_type;
     int mode_change; /* specifies that the element is a mode change */
     enum PVFS_server_mode mode; /* the mode to change to */
+    /* fair-share admission; fair_fs is NULL if the request skipped it */
+    struct req_sched_fair_fs *fair_fs;
+    struct req_sched_fair_class *fair_class; /* set while held at the gate */
+    struct qlist_head fair_link;    /* ties it to its class queue */
+    PVFS_size fair_bytes;
+    int64_t fair_cost;
 };
 
 
@@ -114,6 +123,16 @@ static int hash_handle(
 static int hash_handle_compare(
     const void *key,
     struct qlist_head *link);
+static int hash_fair_key(
+    const void *key,
+    int table_size);
+static int hash_fair_key_compare(
+    const void *key,
+    struct qlist_head *link);
+static int req_sched_enqueue(
+    struct req_sched_element *tmp_element);
+static void req_sched_fair_finalize(
+    void);
 
 /* count of how many items are known to the scheduler */
 static int sched_count = 0;
@@ -215,6 +234,8 @@ int PINT_req_sched_finalize(
 
     /* tear down hash table */
     qhash_finalize(req_sched_table);
+
+    req_sched_fair_finalize();
     return (0);
 }
 
@@ -325,6 +346,416 @@ static void PINT_req_sched_do_change_mode(
     }
 }
 
+/* fair-share admission
+ *
+ * When a file system sets FairShare, each request is charged to a class
+ * (its uid or its client address) before it reaches the handle queues.
+ * Requests pass straight through while the file system is under its
+ * FairShareMaxOps and FairShareMaxBytes limits.  Past that they wait in
+ * their class queue, and classes take turns by deficit round robin: on
+ * each turn a class earns FairShareQuantum times its weight in cost
+ * units, and a request costs one unit plus one per FairShareUnitBytes of
+ * I/O.  Admitted requests give their share back on release, which is
+ * when held requests are let through.
+ */
+
+/** fair-share state for one file system */
+struct req_sched_fair_fs
+{
+    struct qlist_head link;
+    PVFS_fs_id fs_id;
+    struct filesystem_configuration_s *fs_conf;
+    int admitted_ops;               /* past the gate and not released */
+    PVFS_size admitted_bytes;       /* I/O bytes those requests carry */
+    int waiting;                    /* requests held in class queues */
+    struct qhash_table *class_table;
+    struct qlist_head active_list;  /* classes with held requests */
+};
+
+/** one uid or client with requests held at the gate */
+struct req_sched_fair_class
+{
+    struct qlist_head hash_link;
+    struct qlist_head active_link;
+    uint64_t key;
+    int weight;
+    int64_t deficit;
+    int depth;
+    struct qlist_head wait_list;
+};
+
+static QLIST_HEAD(
+    fair_fs_list);
+
+/* totals across file systems, for perf-mon */
+static int fair_waiting = 0;
+static int fair_classes = 0;
+
+/* req_sched_fair_lookup()
+ *
+ * finds the fair-share state for a file system, creating it on first
+ * use.  Returns NULL if the file system is not configured here.
+ */
+static struct req_sched_fair_fs *req_sched_fair_lookup(PVFS_fs_id fs_id)
+{
+    struct qlist_head *iterator;
+    struct req_sched_fair_fs *fair_fs;
+    struct server_configuration_s *config;
+    struct filesystem_configuration_s *fs_conf = NULL;
+
+    qlist_for_each(iterator, &fair_fs_list)
+    {
+        fair_fs = qlist_entry(iterator, struct req_sched_fair_fs, link);
+        if (fair_fs->fs_id == fs_id)
+        {
+            return fair_fs;
+        }
+    }
+
+    config = PINT_server_config_mgr_get_config(fs_id);
+    if (config)
+    {
+        fs_conf = PINT_config_find_fs_id(config, fs_id);
+        PINT_server_config_mgr_put_config(config);
+    }
+    if (!fs_conf)
+    {
+        return NULL;
+    }
+
+    fair_fs = (struct req_sched_fair_fs *)calloc(1, sizeof(*fair_fs));
+    if (!fair_fs)
+    {
+        return NULL;
+    }
+    fair_fs->class_table = qhash_init(hash_fair_key_compare,
+                                      hash_fair_key, 67);
+    if (!fair_fs->class_table)
+    {
+        free(fair_fs);
+        return NULL;
+    }
+    fair_fs->fs_id = fs_id;
+    fair_fs->fs_conf = fs_conf;
+    INIT_QLIST_HEAD(&fair_fs->active_list);
+    qlist_add_tail(&fair_fs->link, &fair_fs_list);
+    return fair_fs;
+}
+
+/* req_sched_fair_has_room()
+ *
+ * returns 1 if a request carrying bytes may pass the gate now.  An idle
+ * file system always admits, so one request larger than the byte limit
+ * cannot wedge the queue.
+ */
+static int req_sched_fair_has_room(struct req_sched_fair_fs *fair_fs,
+                                   PVFS_size bytes)
+{
+    struct filesystem_configuration_s *fs_conf = fair_fs->fs_conf;
+
+    if (fair_fs->admitted_ops == 0)
+    {
+        return 1;
+    }
+    if (fs_conf->fair_share_max_ops > 0 &&
+        fair_fs->admitted_ops >= fs_conf->fair_share_max_ops)
+    {
+        return 0;
+    }
+    if (fs_conf->fair_share_max_bytes > 0 && bytes > 0 &&
+        fair_fs->admitted_bytes + bytes > fs_conf->fair_share_max_bytes)
+    {
+        return 0;
+    }
+    return 1;
+}
+
+/* req_sched_fair_weight()
+ *
+ * looks up the configured weight of a new class; 1 if it is not listed
+ */
+static int req_sched_fair_weight(struct filesystem_configuration_s *fs_conf,
+                                 const struct PINT_req_sched_share *share)
+{
+    const char *name = NULL;
+    char *end;
+    int i;
+
+    for (i = 0; i < fs_conf->fair_share_weight_count; i++)
+    {
+        if (fs_conf->fair_share == PINT_FAIR_SHARE_UID)
+        {
+            if (strtoul(fs_conf->fair_share_weight_keys[i], &end, 10) ==
+                    share->uid && *end == '\0')
+            {
+                return fs_conf->fair_share_weights[i];
+            }
+        }
+        else
+        {
+            if (!name)
+            {
+                name = BMI_addr_rev_lookup_unexpected(share->addr);
+                if (!name)
+                {
+                    break;
+                }
+            }
+            if (!strncmp(name, fs_conf->fair_share_weight_keys[i],
+                         strlen(fs_conf->fair_share_weight_keys[i])))
+            {
+                return fs_conf->fair_share_weights[i];
+            }
+        }
+    }
+    return 1;
+}
+
+/* req_sched_fair_perf()
+ *
+ * publishes the held request counts and the deepest class queue
+ */
+static void req_sched_fair_perf(void)
+{
+    struct qlist_head *iterator, *iterator2;
+    struct req_sched_fair_fs *fair_fs;
+    struct req_sched_fair_class *fclass;
+    int depth = 0;
+
+    qlist_for_each(iterator, &fair_fs_list)
+    {
+        fair_fs = qlist_entry(iterator, struct req_sched_fair_fs, link);
+        qlist_for_each(iterator2, &fair_fs->active_list)
+        {
+            fclass = qlist_entry(iterator2, struct req_sched_fair_class,
+                                 active_link);
+            if (fclass->depth > depth)
+            {
+                depth = fclass->depth;
+            }
+        }
+    }
+
+    /* the client library builds the scheduler too, without a server
+     * perf counter to report to
+     */
+#ifdef __PVFS2_SERVER__
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FAIR_WAITING,
+                    fair_waiting, PINT_PERF_SET);
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FAIR_CLASSES,
+                    fair_classes, PINT_PERF_SET);
+    PINT_perf_count(PINT_server_pc, PINT_PERF_FAIR_DEPTH,
+                    depth, PINT_PERF_SET);
+#endif
+}
+
+/* req_sched_fair_hold()
+ *
+ * parks a request in its class queue until the gate lets it through
+ *
+ * returns 0 on success, -errno on failure
+ */
+static int req_sched_fair_hold(struct req_sched_element *element,
+                               const struct PINT_req_sched_share *share)
+{
+    struct req_sched_fair_fs *fair_fs = element->fair_fs;
+    struct filesystem_configuration_s *fs_conf = fair_fs->fs_conf;
+    struct req_sched_fair_class *fclass;
+    struct qlist_head *hash_link;
+    uint64_t key;
+
+    if (fs_conf->fair_share == PINT_FAIR_SHARE_UID)
+    {
+        key = share->uid;
+    }
+    else
+    {
+        key = (uint64_t)share->addr;
+    }
+
+    hash_link = qhash_search(fair_fs->class_table, &key);
+    if (hash_link)
+    {
+        fclass = qlist_entry(hash_link, struct req_sched_fair_class,
+                             hash_link);
+    }
+    else
+    {
+        fclass = (struct req_sched_fair_class *)calloc(1, sizeof(*fclass));
+        if (!fclass)
+        {
+            return -ENOMEM;
+        }
+        fclass->key = key;
+        fclass->weight = req_sched_fair_weight(fs_conf, share);
+        INIT_QLIST_HEAD(&fclass->wait_list);
+        qhash_add(fair_fs->class_table, &key, &fclass->hash_link);
+        qlist_add_tail(&fclass->active_link, &fair_fs->active_list);
+        fair_classes++;
+    }
+
+    element->fair_class = fclass;
+    element->fair_cost = 1;
+    if (fs_conf->fair_share_unit_bytes > 0)
+    {
+        element->fair_cost += element->fair_bytes /
+                              fs_conf->fair_share_unit_bytes;
+    }
+    qlist_add_tail(&element->fair_link, &fclass->wait_list);
+    fclass->depth++;
+    fair_fs->waiting++;
+    fair_waiting++;
+
+    gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED FAIR HOLD, "
+                 "class: %llu, depth: %d, queue_element: %p\n",
+                 llu(key), fclass->depth, element);
+    req_sched_fair_perf();
+    return 0;
+}
+
+/* req_sched_fair_unhold()
+ *
+ * takes a held request out of its class queue, dropping the class if it
+ * has nothing left waiting
+ */
+static void req_sched_fair_unhold(struct req_sched_element *element)
+{
+    struct req_sched_fair_class *fclass = element->fair_class;
+
+    qlist_del(&element->fair_link);
+    element->fair_class = NULL;
+    fclass->depth--;
+    element->fair_fs->waiting--;
+    fair_waiting--;
+
+    if (qlist_empty(&fclass->wait_list))
+    {
+        qlist_del(&fclass->active_link);
+        qlist_del(&fclass->hash_link);
+        free(fclass);
+        fair_classes--;
+    }
+}
+
+/* req_sched_fair_dispatch()
+ *
+ * lets held requests through, in deficit round robin order, for as long
+ * as the file system has room
+ */
+static void req_sched_fair_dispatch(struct req_sched_fair_fs *fair_fs)
+{
+    struct req_sched_fair_class *fclass;
+    struct req_sched_element *element;
+    int quantum;
+    int ret;
+
+    if (!fair_fs->waiting)
+    {
+        return;
+    }
+
+    quantum = fair_fs->fs_conf->fair_share_quantum;
+    if (quantum < 1)
+    {
+        quantum = 1;
+    }
+
+    while (!qlist_empty(&fair_fs->active_list))
+    {
+        fclass = qlist_entry(fair_fs->active_list.next,
+                             struct req_sched_fair_class, active_link);
+        element = qlist_entry(fclass->wait_list.next,
+                              struct req_sched_element, fair_link);
+
+        if (!req_sched_fair_has_room(fair_fs, element->fair_bytes))
+        {
+            break;
+        }
+
+        if (fclass->deficit < element->fair_cost)
+        {
+            /* out of credit: top it up and move on to the next class */
+            fclass->deficit += (int64_t)quantum * fclass->weight;
+            qlist_del(&fclass->active_link);
+            qlist_add_tail(&fclass->active_link, &fair_fs->active_list);
+            continue;
+        }
+        fclass->deficit -= element->fair_cost;
+
+        req_sched_fair_unhold(element);
+        fair_fs->admitted_ops++;
+        fair_fs->admitted_bytes += element->fair_bytes;
+
+        gossip_debug(GOSSIP_REQ_SCHED_DEBUG, "REQ SCHED FAIR ADMIT, "
+                     "handle: %llu, queue_element: %p\n",
+                     llu(element->handle), element);
+
+        /* held requests were already counted in sched_count */
+        sched_count--;
+        ret = req_sched_enqueue(element);
+        if (ret < 0)
+        {
+            /* nobody is left to report this to; let it run unordered */
+            gossip_err("Error: request scheduler could not queue handle "
+                       "%llu: %d\n", llu(element->handle), ret);
+            INIT_QLIST_HEAD(&element->list_link);
+            ret = 1;
+        }
+        if (ret == 1)
+        {
+            element->state = REQ_READY_TO_SCHEDULE;
+            qlist_add_tail(&element->ready_link, &ready_queue);
+        }
+    }
+
+    req_sched_fair_perf();
+}
+
+/* req_sched_fair_return()
+ *
+ * gives back the share of an admitted request and admits whoever can
+ * use it
+ */
+static void req_sched_fair_return(struct req_sched_element *element)
+{
+    struct req_sched_fair_fs *fair_fs = element->fair_fs;
+
+    fair_fs->admitted_ops--;
+    fair_fs->admitted_bytes -= element->fair_bytes;
+    req_sched_fair_dispatch(fair_fs);
+}
+
+static void req_sched_fair_finalize(void)
+{
+    struct qlist_head *iterator, *scratch;
+    struct qlist_head *iterator2, *scratch2;
+    struct qlist_head *iterator3, *scratch3;
+    struct req_sched_fair_fs *fair_fs;
+    struct req_sched_fair_class *fclass;
+
+    qlist_for_each_safe(iterator, scratch, &fair_fs_list)
+    {
+        fair_fs = qlist_entry(iterator, struct req_sched_fair_fs, link);
+        qlist_for_each_safe(iterator2, scratch2, &fair_fs->active_list)
+        {
+            fclass = qlist_entry(iterator2, struct req_sched_fair_class,
+                                 active_link);
+            qlist_for_each_safe(iterator3, scratch3, &fclass->wait_list)
+            {
+                free(qlist_entry(iterator3, struct req_sched_element,
+                                 fair_link));
+            }
+            qlist_del(&fclass->hash_link);
+            free(fclass);
+        }
+        qhash_finalize(fair_fs->class_table);
+        qlist_del(&fair_fs->link);
+        free(fair_fs);
+    }
+    fair_waiting = 0;
+    fair_classes = 0;
+}
+
 /* scheduler submission */
 
 /** Posts an incoming request to the scheduler
@@ -337,18 +768,13 @@ int PINT_req_sched_post(enum PVFS_server_op op,
                         PVFS_handle handle,
                         enum PINT_server_req_access_type access_type,
                         enum PINT_server_sched_policy sched_policy,
+                        const struct PINT_req_sched_share *share,
 			void *in_user_ptr,
 			req_sched_id * out_id)
 {
-    struct qlist_head *hash_link;
     int ret = -1;
     struct req_sched_element *tmp_element;
-    struct req_sched_element *tmp_element2;
-    struct req_sched_list *tmp_list;
-    struct req_sched_element *next_element;
-    struct req_sched_element *last_element;
-    struct qlist_head *iterator;
-    int tmp_flag;
+    struct req_sched_fair_fs *fair_fs;
 
     if(sched_policy == PINT_SERVER_REQ_BYPASS)
     {
@@ -401,6 +827,66 @@ int PINT_req_sched_post(enum PVFS_server_op op,
         }
     }
 
+    /* requests without a share (internal and server to server ones)
+     * never wait at the fair-share gate
+     */
+    if (share && (fair_fs = req_sched_fair_lookup(fs_id)) &&
+        fair_fs->fs_conf->fair_share != PINT_FAIR_SHARE_NONE)
+    {
+        tmp_element->fair_fs = fair_fs;
+        tmp_element->fair_bytes = share->bytes;
+        if (fair_fs->waiting ||
+            !req_sched_fair_has_room(fair_fs, share->bytes))
+        {
+            ret = req_sched_fair_hold(tmp_element, share);
+            if (ret < 0)
+            {
+                free(tmp_element);
+                return (ret);
+            }
+            /* count it now so admin mode waits for held requests too */
+            sched_count++;
+            return (0);
+        }
+        fair_fs->admitted_ops++;
+        fair_fs->admitted_bytes += share->bytes;
+    }
+
+    ret = req_sched_enqueue(tmp_element);
+    if (ret < 0)
+    {
+        if (tmp_element->fair_fs)
+        {
+            tmp_element->fair_fs->admitted_ops--;
+            tmp_element->fair_fs->admitted_bytes -= tmp_element->fair_bytes;
+        }
+        free(tmp_element);
+    }
+    return (ret);
+}
+
+/* req_sched_enqueue()
+ *
+ * adds a request to the queue for its handle
+ *
+ * returns 1 if it may proceed immediately, 0 if it has to wait for the
+ * requests ahead of it, -errno on failure
+ */
+static int req_sched_enqueue(
+    struct req_sched_element *tmp_element)
+{
+    struct qlist_head *hash_link;
+    int ret = -1;
+    struct req_sched_element *tmp_element2;
+    struct req_sched_list *tmp_list;
+    struct req_sched_element *next_element;
+    struct req_sched_element *last_element;
+    struct qlist_head *iterator;
+    int tmp_flag;
+    enum PVFS_server_op op = tmp_element->op;
+    PVFS_handle handle = tmp_element->handle;
+    enum PINT_server_req_access_type access_type = tmp_element->access_type;
+
     /* see if we have a request queue up for this handle */
     hash_link = qhash_search(req_sched_table, &(handle));
     if (hash_link)
@@ -417,7 +903,6 @@ int PINT_req_sched_post(enum PVFS_server_op op,
             sizeof(struct req_sched_list));
 	if (!tmp_list)
 	{
-	    free(tmp_element);
 	    return (-ENOMEM);
 	}
 
@@ -658,6 +1143,21 @@ int PINT_req_sched_unpost(
     /* retrieve the element directly from the id */
     tmp_element = id_gen_fast_lookup(in_id);
 
+    if (tmp_element->fair_class)
+    {
+        /* still held at the fair-share gate, so not in a handle queue */
+        if (returned_user_ptr)
+        {
+            returned_user_ptr[0] = tmp_element->user_ptr;
+        }
+        req_sched_fair_unhold(tmp_element);
+        req_sched_fair_perf();
+        sched_count--;
+        free(tmp_element);
+        PINT_req_sched_schedule_mode_change();
+        return (0);
+    }
+
     /* make sure it isn't already scheduled */
     if (tmp_element->state == REQ_SCHEDULED)
     {
@@ -736,6 +1236,11 @@ int PINT_req_sched_unpost(
 	sched_count--;
     }
 
+    if (tmp_element->fair_fs)
+    {
+        req_sched_fair_return(tmp_element);
+    }
+
     /* destroy the unposted element */
     free(tmp_element);
 
@@ -875,6 +1380,11 @@ int PINT_req_sched_release(
 		 "REQ SCHED RELEASING, handle: %llu, queue_element: %p\n",
 		 llu(tmp_element->handle), tmp_element);
 
+    if (tmp_element->fair_fs)
+    {
+        req_sched_fair_return(tmp_element);
+    }
+
     /* destroy the released request element */
     free(tmp_element);
 
@@ -1185,6 +1695,43 @@ static int hash_handle_compare(
     return (0);
 }
 
+/* hash_fair_key()
+ *
+ * hash function for fair-share classes, keyed on uid or client address
+ *
+ * returns integer offset into table
+ */
+static int hash_fair_key(
+    const void *key,
+    int table_size)
+{
+    const uint64_t *real_key = key;
+
+    return ((int) (*real_key % table_size));
+}
+
+/* hash_fair_key_compare()
+ *
+ * performs a comparison of a fair-share class to a given key
+ *
+ * returns 1 if match found, 0 otherwise
+ */
+static int hash_fair_key_compare(
+    const void *key,
+    struct qlist_head *link)
+{
+    struct req_sched_fair_class *fclass;
+    const uint64_t *real_key = key;
+
+    fclass = qlist_entry(link, struct req_sched_fair_class, hash_link);
+    if (fclass->key == *real_key)
+    {
+        return (1);
+    }
+
+    return (0);
+}
+
 /*
  * Local variables:
  *  c-indent-level: 4
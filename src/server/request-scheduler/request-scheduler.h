@@ -35,6 +35,14 @@ enum PINT_server_sched_policy
     PINT_SERVER_REQ_SCHEDULE
 };
 
+/** who a request is charged to when the file system uses FairShare */
+struct PINT_req_sched_share
+{
+    PVFS_BMI_addr_t addr;   /* client that sent the request */
+    PVFS_uid uid;           /* user in the request credential */
+    PVFS_size bytes;        /* I/O bytes this server expects to move */
+};
+
 /* setup and teardown */
 int PINT_req_sched_initialize(
     void);
@@ -52,6 +60,7 @@ int PINT_req_sched_post(enum PVFS_server_op op,
                         PVFS_handle handle,
                         enum PINT_server_req_access_type access_type,
                         enum PINT_server_sched_policy sched_policy,
+                        const struct PINT_req_sched_share *share,
 			void *in_user_ptr,
 			req_sched_id * out_id);
 
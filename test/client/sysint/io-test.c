@@ -24,6 +24,54 @@
 #endif
 
 #define DEFAULT_IO_SIZE 8*1024*1024
+#define SWEEP_ITERATIONS 16
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+/* times writes of each power of two size from min_size to max_size */
+static int write_sweep(PVFS_object_ref ref, PVFS_credential *credentials,
+                       void *buffer, int min_size, int max_size)
+{
+    PVFS_sysresp_io resp_io;
+    PVFS_Request mem_req;
+    double start_time, elapsed;
+    int ret, size, i;
+
+    for (size = min_size; size <= max_size; size *= 2)
+    {
+        ret = PVFS_Request_contiguous(size, PVFS_BYTE, &mem_req);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_request_contiguous failure", ret);
+            return (-1);
+        }
+
+        start_time = Wtime();
+        for (i = 0; i < SWEEP_ITERATIONS; i++)
+        {
+            ret = PVFS_sys_write(ref, PVFS_BYTE, 0, buffer, mem_req,
+                                 credentials, &resp_io, NULL);
+            if (ret < 0)
+            {
+                PVFS_perror("PVFS_sys_write failure", ret);
+                PVFS_Request_free(&mem_req);
+                return (-1);
+            }
+        }
+        elapsed = Wtime() - start_time;
+        PVFS_Request_free(&mem_req);
+
+        printf("IO-TEST: %10d bytes: %10.1f usec/write, %8.2f MB/s\n",
+               size, elapsed * 1000000 / SWEEP_ITERATIONS,
+               ((double)size * SWEEP_ITERATIONS) / (elapsed * 1048576));
+    }
+    return (0);
+}
 
 int main(int argc, char **argv)
 {
@@ -46,12 +94,28 @@ int main(int argc, char **argv)
     void *buffer = NULL;
     PVFS_sysresp_getattr resp_getattr;
     PVFS_handle *dfile_array = NULL;
+    int min_size = 0, max_size = 0;
 
-    if (argc != 2)
+    if (argc != 2 && argc != 4)
     {
-	fprintf(stderr, "Usage: %s <file name>\n", argv[0]);
+	fprintf(stderr, "Usage: %s <file name> [<min bytes> <max bytes>]\n",
+                argv[0]);
+	fprintf(stderr, "  with sizes, also times writes of each power of "
+                "two size in between\n");
 	return (-1);
     }
+    if (argc == 4)
+    {
+        min_size = atoi(argv[2]);
+        max_size = atoi(argv[3]);
+        if (min_size < 1 || max_size < min_size ||
+            max_size > (int)(io_size * sizeof(int)))
+        {
+            fprintf(stderr, "Error: sizes must be between 1 and %d bytes\n",
+                    (int)(io_size * sizeof(int)));
+            return (-1);
+        }
+    }
 
     /* create a buffer for running I/O on */
     io_buffer = (int *) malloc(io_size * sizeof(int));
@@ -244,6 +308,12 @@ int main(int argc, char **argv)
 	printf("%llu\n", llu(dfile_array[i]));
     }
 
+    if (min_size > 0 &&
+        write_sweep(pinode_refn, &credentials, buffer, min_size, max_size) < 0)
+    {
+        return (-1);
+    }
+
 	/**************************************************************
 	 * shut down pending interfaces
 	 */
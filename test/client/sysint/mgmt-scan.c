@@ -0,0 +1,460 @@
+/*
+ * (C) 2014 Clemson University
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Creates objects with known owner, size and times and checks which of
+ * them PVFS_mgmt_scan_list() returns for filters on each of those.
+ *
+ *   mgmt-scan path uid     create path and the objects below it, all
+ *                          owned by uid, and run the checks
+ *   mgmt-scan -r path      remove what the first form created
+ *
+ * Below path: "small" (1000 bytes), "big" (5000 bytes), "old" (empty,
+ * accessed and modified OLD_DAYS days ago) and the directory "sub".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-util.h"
+#include "str-utils.h"
+#include "pint-sysint-utils.h"
+#include "pvfs2-internal.h"
+
+#define OLD_DAYS 10
+#define DAY (24 * 60 * 60)
+#define SCAN_BATCH 256
+
+enum
+{
+    SMALL, BIG, OLD, SUB, TOP, NR_OBJECTS
+};
+
+static const char *object_names[NR_OBJECTS] =
+{
+    "small", "big", "old", "sub", "."
+};
+
+static PVFS_fs_id cur_fs;
+static PVFS_credential creds;
+static PVFS_BMI_addr_t *addr_array;
+static int server_count;
+static PVFS_handle handles[NR_OBJECTS];
+static PVFS_handle dfiles[NR_OBJECTS];
+
+/* scan_set()
+ *
+ * runs a scan with filter to the end on every server; returns a bit in
+ * *found for each entry of set that was returned, and its size in sizes
+ */
+static int scan_set(const struct PVFS_mgmt_scan_filter *filter,
+                    const PVFS_handle *set, int *found, PVFS_size *sizes)
+{
+    struct PVFS_mgmt_scan_rec **rec_matrix;
+    int *count_array;
+    PVFS_ds_position *position_array;
+    int i, j, k, more, ret = 0;
+
+    *found = 0;
+    rec_matrix = calloc(server_count, sizeof(*rec_matrix));
+    count_array = malloc(server_count * sizeof(*count_array));
+    position_array = malloc(server_count * sizeof(*position_array));
+    if (!rec_matrix || !count_array || !position_array)
+    {
+        return -PVFS_ENOMEM;
+    }
+    for (i = 0; i < server_count; i++)
+    {
+        rec_matrix[i] = malloc(SCAN_BATCH * sizeof(**rec_matrix));
+        if (!rec_matrix[i])
+        {
+            return -PVFS_ENOMEM;
+        }
+        position_array[i] = PVFS_ITERATE_START;
+    }
+
+    do
+    {
+        for (i = 0; i < server_count; i++)
+        {
+            count_array[i] = SCAN_BATCH;
+        }
+        ret = PVFS_mgmt_scan_list(cur_fs, &creds, filter, rec_matrix,
+                                  count_array, position_array, addr_array,
+                                  server_count, NULL, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_mgmt_scan_list", ret);
+            break;
+        }
+
+        more = 0;
+        for (i = 0; i < server_count; i++)
+        {
+            for (j = 0; j < count_array[i]; j++)
+            {
+                for (k = 0; k < NR_OBJECTS; k++)
+                {
+                    if (set[k] && rec_matrix[i][j].handle == set[k])
+                    {
+                        *found |= 1 << k;
+                        if (sizes)
+                        {
+                            sizes[k] = rec_matrix[i][j].size;
+                        }
+                    }
+                }
+            }
+            if (position_array[i] != PVFS_ITERATE_END)
+            {
+                more = 1;
+            }
+        }
+    } while (more);
+
+    for (i = 0; i < server_count; i++)
+    {
+        free(rec_matrix[i]);
+    }
+    free(rec_matrix);
+    free(count_array);
+    free(position_array);
+    return ret;
+}
+
+static int check(const char *what, const struct PVFS_mgmt_scan_filter *filter,
+                 int expected)
+{
+    int found, i;
+
+    if (scan_set(filter, handles, &found, NULL) < 0)
+    {
+        return 1;
+    }
+    if (found == expected)
+    {
+        return 0;
+    }
+
+    fprintf(stderr, "%s: returned", what);
+    for (i = 0; i < NR_OBJECTS; i++)
+    {
+        if (found & (1 << i))
+        {
+            fprintf(stderr, " %s", object_names[i]);
+        }
+    }
+    fprintf(stderr, ", expected");
+    for (i = 0; i < NR_OBJECTS; i++)
+    {
+        if (expected & (1 << i))
+        {
+            fprintf(stderr, " %s", object_names[i]);
+        }
+    }
+    fprintf(stderr, "\n");
+    return 1;
+}
+
+static int create_objects(PVFS_object_ref parent, char *name, PVFS_uid uid)
+{
+    PVFS_sysresp_mkdir resp_mkdir;
+    PVFS_sysresp_create resp_create;
+    PVFS_object_ref top, ref;
+    PVFS_sys_attr attr;
+    time_t now = time(NULL);
+    int i, ret;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE | PVFS_ATTR_SYS_DFILE_COUNT;
+    attr.owner = uid;
+    attr.group = creds.group_array[0];
+    attr.perms = 0755;
+    attr.atime = attr.ctime = attr.mtime = now;
+    attr.dfile_count = 1;
+
+    ret = PVFS_sys_mkdir(name, parent, attr, &creds, &resp_mkdir, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_mkdir", ret);
+        return ret;
+    }
+    top = resp_mkdir.ref;
+    handles[TOP] = top.handle;
+
+    ret = PVFS_sys_mkdir("sub", top, attr, &creds, &resp_mkdir, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_mkdir", ret);
+        return ret;
+    }
+    handles[SUB] = resp_mkdir.ref.handle;
+
+    attr.perms = 0644;
+    for (i = SMALL; i <= OLD; i++)
+    {
+        ret = PVFS_sys_create((char *)object_names[i], top, attr, &creds,
+                              NULL, &resp_create, NULL, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_create", ret);
+            return ret;
+        }
+        ref = resp_create.ref;
+        handles[i] = ref.handle;
+
+        ret = PVFS_mgmt_get_dfile_array(ref, &creds, &dfiles[i], 1, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_mgmt_get_dfile_array", ret);
+            return ret;
+        }
+
+        if (i == SMALL || i == BIG)
+        {
+            ret = PVFS_sys_truncate(ref, i == SMALL ? 1000 : 5000, &creds,
+                                    NULL);
+            if (ret < 0)
+            {
+                PVFS_perror("PVFS_sys_truncate", ret);
+                return ret;
+            }
+        }
+    }
+
+    /* backdate "old" last, nothing touches it afterwards */
+    memset(&attr, 0, sizeof(attr));
+    attr.atime = attr.mtime = now - OLD_DAYS * DAY;
+    attr.mask = PVFS_ATTR_SYS_ATIME | PVFS_ATTR_SYS_ATIME_SET |
+                PVFS_ATTR_SYS_MTIME | PVFS_ATTR_SYS_MTIME_SET;
+    ref.handle = handles[OLD];
+    ret = PVFS_sys_setattr(ref, attr, &creds, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_setattr", ret);
+    }
+    return ret;
+}
+
+static int run_checks(PVFS_uid uid)
+{
+    struct PVFS_mgmt_scan_filter filter;
+    PVFS_size sizes[NR_OBJECTS];
+    int errors = 0, found;
+
+    memset(&filter, 0, sizeof(filter));
+    filter.mask = PVFS_MGMT_SCAN_TYPE | PVFS_MGMT_SCAN_UID;
+    filter.uid = uid;
+
+    filter.type_mask = PVFS_TYPE_METAFILE;
+    errors += check("files of uid", &filter,
+                    1 << SMALL | 1 << BIG | 1 << OLD);
+
+    filter.type_mask = PVFS_TYPE_DIRECTORY;
+    errors += check("directories of uid", &filter, 1 << SUB | 1 << TOP);
+
+    /* only datafiles have a size on the servers; the test passes every
+     * other type */
+    filter.mask |= PVFS_MGMT_SCAN_SIZE;
+    filter.type_mask = PVFS_TYPE_METAFILE | PVFS_TYPE_DIRECTORY;
+    filter.min_size = filter.max_size = 1000;
+    errors += check("size of files and directories", &filter,
+                    1 << SMALL | 1 << BIG | 1 << OLD | 1 << SUB | 1 << TOP);
+
+    /* datafiles are tested, whoever owns them */
+    filter.mask = PVFS_MGMT_SCAN_TYPE | PVFS_MGMT_SCAN_SIZE;
+    filter.type_mask = PVFS_TYPE_DATAFILE;
+    if (scan_set(&filter, dfiles, &found, sizes) < 0)
+    {
+        errors++;
+    }
+    else if (found != 1 << SMALL || sizes[SMALL] != 1000)
+    {
+        fprintf(stderr, "datafiles of 1000 bytes: found %x, size %lld\n",
+                found, lld(sizes[SMALL]));
+        errors++;
+    }
+    return errors;
+}
+
+static int run_time_checks(PVFS_uid uid)
+{
+    struct PVFS_mgmt_scan_filter filter;
+    time_t now = time(NULL);
+    int errors = 0;
+
+    memset(&filter, 0, sizeof(filter));
+    filter.mask = PVFS_MGMT_SCAN_TYPE | PVFS_MGMT_SCAN_UID;
+    filter.uid = uid;
+    filter.type_mask = PVFS_TYPE_METAFILE;
+
+    filter.mask |= PVFS_MGMT_SCAN_MTIME;
+    filter.min_mtime = 0;
+    filter.max_mtime = now - (OLD_DAYS - 1) * DAY;
+    errors += check("modified long ago", &filter, 1 << OLD);
+
+    filter.min_mtime = now - DAY;
+    filter.max_mtime = now + DAY;
+    errors += check("modified today", &filter, 1 << SMALL | 1 << BIG);
+
+    filter.mask &= ~PVFS_MGMT_SCAN_MTIME;
+    filter.mask |= PVFS_MGMT_SCAN_ATIME;
+    filter.min_atime = 0;
+    filter.max_atime = now - (OLD_DAYS - 1) * DAY;
+    errors += check("accessed long ago", &filter, 1 << OLD);
+
+    filter.mask &= ~PVFS_MGMT_SCAN_ATIME;
+    filter.mask |= PVFS_MGMT_SCAN_CTIME;
+    filter.min_ctime = now - DAY;
+    filter.max_ctime = now + DAY;
+    errors += check("changed today", &filter,
+                    1 << SMALL | 1 << BIG | 1 << OLD);
+    return errors;
+}
+
+static int remove_objects(PVFS_object_ref parent, char *name)
+{
+    PVFS_sysresp_lookup resp_lookup;
+    PVFS_object_ref top;
+    char path[PVFS_NAME_MAX];
+    int i, ret;
+
+    ret = PVFS_sys_ref_lookup(cur_fs, name, parent, &creds, &resp_lookup,
+                              PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_ref_lookup", ret);
+        return ret;
+    }
+    top = resp_lookup.ref;
+    for (i = SMALL; i <= SUB; i++)
+    {
+        snprintf(path, sizeof(path), "%s", object_names[i]);
+        ret = PVFS_sys_remove(path, top, &creds, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_remove", ret);
+            return ret;
+        }
+    }
+    return PVFS_sys_remove(name, parent, &creds, NULL);
+}
+
+int main(int argc, char **argv)
+{
+    int ret, opt, remove = 0, errors;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    char entry_name[PVFS_NAME_MAX] = {0};
+    PVFS_object_ref parent_ref;
+    PVFS_uid uid = 0;
+
+    while ((opt = getopt(argc, argv, "r")) != -1)
+    {
+        switch (opt)
+        {
+            case 'r':
+                remove = 1;
+                break;
+            default:
+                fprintf(stderr, "usage: %s [-r] path [uid]\n", argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - (remove ? 1 : 2))
+    {
+        fprintf(stderr, "usage: %s [-r] path [uid]\n", argv[0]);
+        return 1;
+    }
+    if (!remove)
+    {
+        uid = strtoul(argv[optind + 1], NULL, 10);
+    }
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return 1;
+    }
+    ret = PVFS_util_resolve(argv[optind], &cur_fs, pvfs_path,
+                            PVFS_NAME_MAX);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return 1;
+    }
+    PVFS_util_gen_credential_defaults(&creds);
+
+    ret = PINT_lookup_parent(pvfs_path, cur_fs, &creds, &parent_ref.handle);
+    if (ret < 0 ||
+        PINT_remove_base_dir(pvfs_path, entry_name, PVFS_NAME_MAX) < 0)
+    {
+        fprintf(stderr, "cannot find the parent of %s\n", pvfs_path);
+        return 1;
+    }
+    parent_ref.fs_id = cur_fs;
+
+    if (remove)
+    {
+        ret = remove_objects(parent_ref, entry_name);
+        PVFS_sys_finalize();
+        return ret < 0;
+    }
+
+    ret = PVFS_mgmt_count_servers(cur_fs,
+                                  PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                  &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_count_servers", ret);
+        return 1;
+    }
+    addr_array = malloc(server_count * sizeof(PVFS_BMI_addr_t));
+    if (!addr_array)
+    {
+        return 1;
+    }
+    ret = PVFS_mgmt_get_server_array(cur_fs,
+                                     PVFS_MGMT_IO_SERVER|PVFS_MGMT_META_SERVER,
+                                     addr_array, &server_count);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_get_server_array", ret);
+        return 1;
+    }
+
+    if (create_objects(parent_ref, entry_name, uid) < 0)
+    {
+        return 1;
+    }
+
+    errors = run_time_checks(uid);
+    errors += run_checks(uid);
+
+    free(addr_array);
+    PVFS_sys_finalize();
+    if (errors)
+    {
+        fprintf(stderr, "%d checks failed\n", errors);
+    }
+    return errors != 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -7,6 +7,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
 
 #include "pvfs2.h"
 #include "ncache.h"
@@ -28,6 +29,7 @@ int main(int argc, char **argv)
     PVFS_object_ref entry_ref;
     char entry_handle[1024];
     char entry_name[PVFS_NAME_MAX] = "";
+    PVFS_time dir_version, cached_version;
 
     gossip_enable_stderr();
     gossip_set_debug_mask(1, GOSSIP_NCACHE_DEBUG);
@@ -50,12 +52,12 @@ int main(int argc, char **argv)
     ret = PINT_ncache_update(
         (const char*) filename,
         (const PVFS_object_ref*) &test_ref, 
-        (const PVFS_object_ref*) &root_ref);
+        (const PVFS_object_ref*) &root_ref, 0);
     test_ref.handle = 1001;
     ret = PINT_ncache_get_cached_entry(
         (const char*) filename, 
         &test_ref,
-        (const PVFS_object_ref*) &root_ref); 
+        (const PVFS_object_ref*) &root_ref, NULL); 
     if (test_ref.handle != 1000 || ret != 0)
     {
         gossip_err("[1] Cannot properly resolve inserted entry!\n");
@@ -66,12 +68,12 @@ int main(int argc, char **argv)
     ret = PINT_ncache_update(
         (const char*) "testfile1001", 
         (const PVFS_object_ref*) &test_ref, 
-        (const PVFS_object_ref*) &root_ref);
+        (const PVFS_object_ref*) &root_ref, 0);
 
     ret = PINT_ncache_get_cached_entry(
         (const char*) "testfile1001", 
         &test_ref,
-        (const PVFS_object_ref*) &root_ref); 
+        (const PVFS_object_ref*) &root_ref, NULL); 
     if (test_ref.handle != 1001)
     {
         gossip_err("[2] Cannot properly resolve inserted entry!\n");
@@ -92,7 +94,7 @@ int main(int argc, char **argv)
 	ret = PINT_ncache_update(
             (const char*) new_filename[i],
             (const PVFS_object_ref*) &test_ref, 
-            (const PVFS_object_ref*) &root_ref);
+            (const PVFS_object_ref*) &root_ref, 0);
 	if (ret < 0)
 	{
 	    gossip_err("Error: failed to insert entry.\n");
@@ -110,7 +112,7 @@ int main(int argc, char **argv)
 	ret = PINT_ncache_get_cached_entry(
             (const char*) new_filename[i], 
             &test_ref,
-            (const PVFS_object_ref*) &root_ref); 
+            (const PVFS_object_ref*) &root_ref, NULL); 
 	if ((ret < 0) && (ret != -PVFS_ENOENT))
 	{
 	    gossip_err("ncache_get_cached_entry() failure.\n");
@@ -134,7 +136,7 @@ int main(int argc, char **argv)
         ret = PINT_ncache_get_cached_entry(
             (const char*) new_filename[i], 
             &test_ref,
-            (const PVFS_object_ref*) &root_ref); 
+            (const PVFS_object_ref*) &root_ref, NULL); 
 
         if (ret != -PVFS_ENOENT)
         {
@@ -151,6 +153,80 @@ int main(int argc, char **argv)
             (const PVFS_object_ref*) &root_ref); 
     }
 
+    /* a name that does not exist is cached as a null ref, which lookup
+     * reports as -PVFS_ENOENT; the parent is old enough for its version
+     * to be kept */
+    PINT_ncache_set_info(NCACHE_NEGATIVE_TIMEOUT_MSECS, 1000);
+    dir_version = time(NULL) - 10;
+    filename = "missingfile";
+    ret = PINT_ncache_update_negative(
+        (const char*) filename,
+        (const PVFS_object_ref*) &root_ref, dir_version);
+    if (ret < 0)
+    {
+        gossip_err("[3] Cannot insert negative entry!\n");
+        return -1;
+    }
+    test_ref.handle = 1002;
+    ret = PINT_ncache_get_cached_entry(
+        (const char*) filename,
+        &test_ref,
+        (const PVFS_object_ref*) &root_ref, &cached_version);
+    ret = (ret == 0 && test_ref.handle == PVFS_HANDLE_NULL) ?
+        -PVFS_ENOENT : ret;
+    if (ret != -PVFS_ENOENT)
+    {
+        gossip_err("[4] Negative entry not returned as ENOENT!\n");
+        return -1;
+    }
+
+    /* once expired it comes back for revalidation, and holds while the
+     * directory is unchanged */
+    sleep(2);
+    ret = PINT_ncache_get_cached_entry(
+        (const char*) filename,
+        &test_ref,
+        (const PVFS_object_ref*) &root_ref, &cached_version);
+    if (ret != -PVFS_ETIME || cached_version != dir_version)
+    {
+        gossip_err("[5] Expired negative entry lost its version!\n");
+        return -1;
+    }
+    test_ref.handle = 1002;
+    ret = PINT_ncache_revalidate(
+        (const char*) filename,
+        &test_ref,
+        (const PVFS_object_ref*) &root_ref, dir_version);
+    if (ret != 0 || test_ref.handle != PVFS_HANDLE_NULL)
+    {
+        gossip_err("[6] Cannot revalidate negative entry!\n");
+        return -1;
+    }
+
+    /* a new directory version drops it */
+    sleep(2);
+    ret = PINT_ncache_revalidate(
+        (const char*) filename,
+        &test_ref,
+        (const PVFS_object_ref*) &root_ref, dir_version + 1);
+    if (ret != -PVFS_ENOENT)
+    {
+        gossip_err("[7] Negative entry survived a directory change!\n");
+        return -1;
+    }
+    ret = PINT_ncache_get_cached_entry(
+        (const char*) filename,
+        &test_ref,
+        (const PVFS_object_ref*) &root_ref, &cached_version);
+    if (ret == 0 || ret == -PVFS_ETIME)
+    {
+        gossip_err("[8] Dropped negative entry is still cached!\n");
+        return -1;
+    }
+
+    gossip_debug(GOSSIP_NCACHE_DEBUG, "Negative entries were stored, "
+                 "returned and dropped as expected\n");
+
     PINT_ncache_set_info(TCACHE_TIMEOUT_MSECS,5000);
     PINT_ncache_set_info(TCACHE_HARD_LIMIT, 20000);
     PINT_ncache_set_info(TCACHE_SOFT_LIMIT, 10000);
@@ -174,7 +250,7 @@ int main(int argc, char **argv)
         	ret = PINT_ncache_update(
         	    (const char*) entry_name,
                 (const PVFS_object_ref*) &entry_ref, 
-                (const PVFS_object_ref*) &parent_ref);
+                (const PVFS_object_ref*) &parent_ref, 0);
         }
     }
 
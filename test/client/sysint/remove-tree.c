@@ -0,0 +1,297 @@
+/*
+ * (C) 2014 Clemson University
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Builds a nested tree and removes it with PVFS_mgmt_remove_tree().
+ *
+ *   remove-tree -b path    create path and a tree below it
+ *   remove-tree -i N path  start removing the tree below path and exit
+ *                          without cleaning up once N entries are gone
+ *   remove-tree path       remove the tree below path, check that path
+ *                          is empty and remove path itself
+ *   remove-tree -c path    print the number of objects on the servers
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+#include <sys/types.h>
+
+#include "pvfs2.h"
+#include "pvfs2-mgmt.h"
+#include "pvfs2-util.h"
+#include "str-utils.h"
+#include "pint-sysint-utils.h"
+#include "pvfs2-internal.h"
+
+#define TREE_DEPTH 3    /* levels of subdirectories */
+#define TREE_FANOUT 3   /* subdirectories in each directory */
+#define TREE_FILES 4    /* files in each directory, the last striped */
+
+static PVFS_credential creds;
+static uint64_t interrupt_after;
+
+static int build_dir(PVFS_object_ref parent, int depth)
+{
+    PVFS_sysresp_mkdir resp_mkdir;
+    PVFS_sysresp_create resp_create;
+    PVFS_sys_attr attr;
+    char name[32];
+    int i, ret;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+    attr.owner = creds.userid;
+    attr.group = creds.group_array[0];
+    attr.atime = attr.ctime = attr.mtime = time(NULL);
+
+    for (i = 0; i < TREE_FILES; i++)
+    {
+        attr.perms = 0644;
+        if (i == TREE_FILES - 1)
+        {
+            attr.dfile_count = 2;
+            attr.mask |= PVFS_ATTR_SYS_DFILE_COUNT;
+        }
+        snprintf(name, sizeof(name), "f%d", i);
+        ret = PVFS_sys_create(name, parent, attr, &creds, NULL,
+                              &resp_create, NULL, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_create", ret);
+            return ret;
+        }
+    }
+    attr.mask &= ~PVFS_ATTR_SYS_DFILE_COUNT;
+
+    if (depth == TREE_DEPTH)
+    {
+        return 0;
+    }
+
+    for (i = 0; i < TREE_FANOUT; i++)
+    {
+        attr.perms = 0755;
+        snprintf(name, sizeof(name), "d%d", i);
+        ret = PVFS_sys_mkdir(name, parent, attr, &creds, &resp_mkdir, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_mkdir", ret);
+            return ret;
+        }
+        ret = build_dir(resp_mkdir.ref, depth + 1);
+        if (ret < 0)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+/* stands in for the client being killed part way through */
+static void interrupt_cb(const struct PVFS_mgmt_remove_tree_progress *progress,
+                         void *arg)
+{
+    if (interrupt_after && progress->removed >= interrupt_after)
+    {
+        printf("interrupted after %llu entries\n", llu(progress->removed));
+        fflush(stdout);
+        _exit(0);
+    }
+}
+
+static int count_objects(PVFS_fs_id fs_id)
+{
+    PVFS_sysresp_statfs resp_statfs;
+    struct PVFS_mgmt_server_stat *stat_array;
+    uint64_t used = 0;
+    int count, i, ret;
+
+    ret = PVFS_sys_statfs(fs_id, &creds, &resp_statfs, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_statfs", ret);
+        return ret;
+    }
+    count = resp_statfs.server_count;
+    stat_array = malloc(count * sizeof(*stat_array));
+    if (!stat_array)
+    {
+        return -PVFS_ENOMEM;
+    }
+    ret = PVFS_mgmt_statfs_all(fs_id, &creds, stat_array, &count,
+                               NULL, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_statfs_all", ret);
+        free(stat_array);
+        return ret;
+    }
+    for (i = 0; i < count; i++)
+    {
+        used += stat_array[i].handles_total_count -
+            stat_array[i].handles_available_count;
+    }
+    printf("%llu\n", llu(used));
+    free(stat_array);
+    return 0;
+}
+
+static void usage(char *prog)
+{
+    fprintf(stderr, "usage: %s [-b | -c | -i count] path\n", prog);
+}
+
+int main(int argc, char **argv)
+{
+    int ret, opt, build = 0, count = 0;
+    char pvfs_path[PVFS_NAME_MAX] = {0};
+    char entry_name[PVFS_NAME_MAX] = {0};
+    PVFS_fs_id cur_fs;
+    PVFS_object_ref ref, parent_ref;
+    PVFS_sysresp_lookup resp_lookup;
+    PVFS_sysresp_mkdir resp_mkdir;
+    PVFS_sysresp_readdir resp_readdir;
+    PVFS_sys_attr attr;
+    struct PVFS_mgmt_remove_tree_progress progress;
+
+    while ((opt = getopt(argc, argv, "bci:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b':
+                build = 1;
+                break;
+            case 'c':
+                count = 1;
+                break;
+            case 'i':
+                interrupt_after = strtoull(optarg, NULL, 10);
+                break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (optind != argc - 1)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    ret = PVFS_util_init_defaults();
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_init_defaults", ret);
+        return 1;
+    }
+    ret = PVFS_util_resolve(argv[optind], &cur_fs, pvfs_path,
+                            PVFS_NAME_MAX);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_util_resolve", ret);
+        return 1;
+    }
+    PVFS_util_gen_credential_defaults(&creds);
+
+    if (count)
+    {
+        return count_objects(cur_fs) < 0;
+    }
+
+    ret = PINT_lookup_parent(pvfs_path, cur_fs, &creds, &parent_ref.handle);
+    if (ret < 0 ||
+        PINT_remove_base_dir(pvfs_path, entry_name, PVFS_NAME_MAX) < 0)
+    {
+        fprintf(stderr, "cannot find the parent of %s\n", pvfs_path);
+        return 1;
+    }
+    parent_ref.fs_id = cur_fs;
+
+    if (build)
+    {
+        memset(&attr, 0, sizeof(attr));
+        attr.mask = PVFS_ATTR_SYS_ALL_SETABLE;
+        attr.owner = creds.userid;
+        attr.group = creds.group_array[0];
+        attr.perms = 0755;
+        attr.atime = attr.ctime = attr.mtime = time(NULL);
+        ret = PVFS_sys_mkdir(entry_name, parent_ref, attr, &creds,
+                             &resp_mkdir, NULL);
+        if (ret < 0)
+        {
+            PVFS_perror("PVFS_sys_mkdir", ret);
+            return 1;
+        }
+        ret = build_dir(resp_mkdir.ref, 0);
+        PVFS_sys_finalize();
+        return ret < 0;
+    }
+
+    ret = PVFS_sys_lookup(cur_fs, pvfs_path, &creds, &resp_lookup,
+                          PVFS2_LOOKUP_LINK_NO_FOLLOW, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_lookup", ret);
+        return 1;
+    }
+    ref = resp_lookup.ref;
+
+    memset(&progress, 0, sizeof(progress));
+    ret = PVFS_mgmt_remove_tree(ref, &creds, 0, &progress, interrupt_cb,
+                                NULL, NULL);
+    printf("removed %llu entries in %llu directories, %llu failed\n",
+           llu(progress.removed), llu(progress.dirs), llu(progress.failed));
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_mgmt_remove_tree", ret);
+        return 1;
+    }
+    if (interrupt_after)
+    {
+        fprintf(stderr, "removal finished before it could be interrupted\n");
+        return 1;
+    }
+
+    memset(&resp_readdir, 0, sizeof(resp_readdir));
+    ret = PVFS_sys_readdir(ref, PVFS_READDIR_START, 32, &creds,
+                           &resp_readdir, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_readdir", ret);
+        return 1;
+    }
+    if (resp_readdir.pvfs_dirent_outcount != 0)
+    {
+        fprintf(stderr, "%s still has %d entries, first %s\n", pvfs_path,
+                resp_readdir.pvfs_dirent_outcount,
+                resp_readdir.dirent_array[0].d_name);
+        return 1;
+    }
+    free(resp_readdir.dirent_array);
+
+    ret = PVFS_sys_remove(entry_name, parent_ref, &creds, NULL);
+    if (ret < 0)
+    {
+        PVFS_perror("PVFS_sys_remove", ret);
+        return 1;
+    }
+
+    PVFS_sys_finalize();
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -0,0 +1,149 @@
+/*
+ * (C) 2001 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Contention benchmark for the id_gen_safe registry.  Each thread keeps
+ * a window of live ids and repeatedly registers a new one, looks up the
+ * whole window and retires the oldest, checking along the way that
+ * retired ids no longer resolve.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+#include "pvfs2.h"
+#include "id-generator.h"
+
+#define DEFAULT_THREADS 8
+#define DEFAULT_ITERATIONS 1000000
+#define WINDOW 16
+
+static int iterations = DEFAULT_ITERATIONS;
+static int errors = 0;
+
+static void *bench_thread(void *arg)
+{
+    BMI_id_gen_t window[WINDOW];
+    int items[WINDOW];
+    BMI_id_gen_t stale = 0;
+    int i, j, slot;
+
+    memset(window, 0, sizeof(window));
+
+    for (i = 0; i < iterations; i++)
+    {
+        slot = i % WINDOW;
+        if (window[slot])
+        {
+            if (id_gen_safe_unregister(window[slot]) != 0)
+            {
+                __sync_fetch_and_add(&errors, 1);
+            }
+            stale = window[slot];
+        }
+
+        if (id_gen_safe_register(&window[slot], &items[slot]) != 0)
+        {
+            __sync_fetch_and_add(&errors, 1);
+            return NULL;
+        }
+
+        for (j = 0; j < WINDOW; j++)
+        {
+            if (window[j] && id_gen_safe_lookup(window[j]) != &items[j])
+            {
+                __sync_fetch_and_add(&errors, 1);
+            }
+        }
+
+        if (stale && id_gen_safe_lookup(stale) != NULL)
+        {
+            __sync_fetch_and_add(&errors, 1);
+        }
+    }
+
+    for (j = 0; j < WINDOW; j++)
+    {
+        if (window[j])
+        {
+            id_gen_safe_unregister(window[j]);
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    int thread_count = DEFAULT_THREADS;
+    pthread_t *threads;
+    struct timeval start, end;
+    double elapsed;
+    int i;
+
+    if (argc > 1)
+    {
+        thread_count = atoi(argv[1]);
+    }
+    if (argc > 2)
+    {
+        iterations = atoi(argv[2]);
+    }
+    if (thread_count < 1 || iterations < 1)
+    {
+        fprintf(stderr, "usage: %s [threads] [iterations]\n", argv[0]);
+        return 1;
+    }
+
+    threads = malloc(thread_count * sizeof(pthread_t));
+    if (!threads)
+    {
+        return 1;
+    }
+
+    id_gen_safe_initialize();
+
+    gettimeofday(&start, NULL);
+    for (i = 0; i < thread_count; i++)
+    {
+        pthread_create(&threads[i], NULL, bench_thread, NULL);
+    }
+    for (i = 0; i < thread_count; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    gettimeofday(&end, NULL);
+
+    id_gen_safe_finalize();
+
+    elapsed = (end.tv_sec - start.tv_sec) +
+        (end.tv_usec - start.tv_usec) / 1000000.0;
+    printf("%d threads, %d iterations each: %.3f s, "
+           "%.0f register/unregister pairs/s, %.0f lookups/s\n",
+           thread_count, iterations, elapsed,
+           (double)thread_count * iterations / elapsed,
+           (double)thread_count * iterations * (WINDOW + 1) / elapsed);
+
+    free(threads);
+
+    if (errors)
+    {
+        printf("FAILED: %d errors\n", errors);
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */
@@ -23,6 +23,7 @@ static void check_param(char *parameter_name, int param, int expected_value);
 #define TEST_SOFT_LIMIT          5
 #define TEST_ENABLE              1
 #define TEST_RECLAIM_PERCENTAGE 50
+#define TEST_SHARD_COUNT         2
 
 
 /* test payload */
@@ -35,6 +36,8 @@ struct foo_payload
 int main(int argc, char **argv)
 {
     struct PINT_tcache* test_tcache;
+    struct PINT_tcache_shards* test_shards;
+    struct PINT_tcache_shard* shard;
     int i;
     struct foo_payload* tmp_payload;
     struct PINT_tcache_entry* test_entry = NULL;
@@ -462,6 +465,69 @@ int main(int argc, char **argv)
         printf("Done.\n");
     }
 
+    PINT_tcache_finalize(test_tcache);
+
+    /* the same limits should hold for a sharded cache as a whole */
+    printf("Initializing sharded cache... ");
+    test_shards = PINT_tcache_shards_initialize(foo_compare_key_entry,
+        foo_hash_key,
+        foo_free_payload,
+        -1,
+        TEST_SHARD_COUNT);
+    if(!test_shards)
+    {
+        fprintf(stderr, "PINT_tcache_shards_initialize failure.\n");
+        return(-1);
+    }
+    ret = PINT_tcache_shards_set_info(test_shards, TCACHE_HARD_LIMIT,
+                                      TEST_HARD_LIMIT);
+    assert(ret == 0);
+    ret = PINT_tcache_shards_get_info(test_shards, TCACHE_HARD_LIMIT, &param);
+    assert(ret == 0);
+    check_param("TCACHE_HARD_LIMIT", param, TEST_HARD_LIMIT);
+    printf("Done.\n");
+
+    for(i = 0; i < TEST_HARD_LIMIT * 3; i++)
+    {
+        tmp_payload = (struct foo_payload*)malloc(sizeof(struct foo_payload));
+        assert(tmp_payload);
+        tmp_payload->key = i;
+        tmp_payload->value = i;
+
+        shard = PINT_tcache_shard_lock(test_shards, &i);
+        ret = PINT_tcache_insert_entry(shard->tcache, &i, tmp_payload,
+                                       &tmp_count);
+        PINT_tcache_shard_unlock(test_shards, shard);
+        if(ret < 0)
+        {
+            PVFS_perror("PINT_tcache_insert", ret);
+            return(-1);
+        }
+    }
+
+    ret = PINT_tcache_shards_get_info(test_shards, TCACHE_NUM_ENTRIES,
+                                      &param);
+    assert(ret == 0);
+    check_param("TCACHE_NUM_ENTRIES", param, TEST_HARD_LIMIT);
+
+    /* the newest entries must have survived replacement in every shard */
+    for(i = TEST_HARD_LIMIT * 3 - TEST_SHARD_COUNT;
+        i < TEST_HARD_LIMIT * 3; i++)
+    {
+        printf("Looking up sharded entry [%d]... ", i);
+        shard = PINT_tcache_shard_lock(test_shards, &i);
+        ret = PINT_tcache_lookup(shard->tcache, &i, &test_entry, &status);
+        PINT_tcache_shard_unlock(test_shards, shard);
+        if(ret < 0 || ((struct foo_payload*)test_entry->payload)->value != i)
+        {
+            PVFS_perror("\nPINT_tcache_lookup", ret);
+            return(-1);
+        }
+        printf("Done.\n");
+    }
+
+    PINT_tcache_shards_finalize(test_shards);
+
     return(0);
 }
 
@@ -167,6 +167,10 @@ int bench_initialize_bmi_interface(
     {
 	sprintf(local_address, "ib://NULL:%d\n", BMI_IB_PORT);
     }
+    else if (strcmp(method, "bmi_shm") == 0)
+    {
+	sprintf(local_address, "shm://NULL:%d\n", BMI_SHM_PORT);
+    }
     else
     {
 	fprintf(stderr, "Bad method: %s\n", method);
@@ -341,6 +345,10 @@ int bench_initialize_bmi_addresses_client(
 	{
 	    sprintf(bmi_server_name, "ib://%s:%d", server_name, BMI_IB_PORT);
 	}
+	else if (strcmp(method_name, "bmi_shm") == 0)
+	{
+	    sprintf(bmi_server_name, "shm://%s:%d", server_name, BMI_SHM_PORT);
+	}
 	else
 	{
 	    return (-1);
@@ -22,6 +22,7 @@
 #define BMI_GM_PORT 5
 #define BMI_MX_ENDPOINT 3
 #define BMI_IB_PORT 3335
+#define BMI_SHM_PORT 3334
 
 int bench_initialize_bmi_interface(
     char *method,
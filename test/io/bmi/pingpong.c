@@ -718,6 +718,8 @@ static void get_method(struct options *opts)
                 opts->method = strdup("bmi_mx");
         } else if (id[0] == 'i' && id[1] == 'b' && check_uri(&id[2])) {
                 opts->method = strdup("bmi_ib");
+        } else if (id[0] == 's' && id[1] == 'h' && id[2] == 'm' && check_uri(&id[3])) {
+                opts->method = strdup("bmi_shm");
         }
         return;
 }
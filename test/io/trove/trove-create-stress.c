@@ -10,6 +10,7 @@
 #include <stdlib.h>
 #include <time.h>
 #include <getopt.h>
+#include <sys/time.h>
 
 #include "trove.h"
 #include "trove-test.h"
@@ -20,9 +21,21 @@ char path_to_file[PATH_SIZE] = "/bar";
 TROVE_handle requested_file_handle = 4095;
 
 int file_count = 500;
+int bstream_size = 0;
+int packed_max = 0;
+int remove_odd = 0;
 
 int parse_args(int argc, char **argv);
 
+static double elapsed(struct timeval *start)
+{
+    struct timeval now;
+
+    gettimeofday(&now, NULL);
+    return (now.tv_sec - start->tv_sec) +
+        (now.tv_usec - start->tv_usec) * 1e-6;
+}
+
 int main(int argc, char **argv)
 {
     int ret, count, i, myuid, mygid;
@@ -38,6 +51,11 @@ int main(int argc, char **argv)
     TROVE_extent cur_extent;
     TROVE_handle_extent_array extent_array;
     TROVE_context_id trove_context = -1;
+    char *buf = NULL;
+    TROVE_offset stream_offset = 0;
+    TROVE_size stream_size, out_size;
+    struct timeval start;
+    double secs;
 
     ret = parse_args(argc, argv);
     if (ret < 0) {
@@ -67,6 +85,29 @@ int main(int argc, char **argv)
         return -1;
     }
 
+    if (packed_max > 0)
+    {
+        ret = trove_collection_setinfo(coll_id, trove_context,
+                                       TROVE_COLLECTION_PACKED_BSTREAM_MAX,
+                                       &packed_max);
+        if (ret < 0)
+        {
+            fprintf(stderr, "setinfo of packed bstream size failed\n");
+            return -1;
+        }
+    }
+
+    if (bstream_size > 0)
+    {
+        buf = malloc(bstream_size);
+        if (!buf)
+        {
+            return -1;
+        }
+        memset(buf, 'a', bstream_size);
+    }
+    stream_size = bstream_size;
+
     myuid = getuid();
     mygid = getgid();
     mytime = time(NULL);
@@ -91,11 +132,12 @@ int main(int argc, char **argv)
 
     /* TODO: verify that this is in fact a directory! */
     
+    gettimeofday(&start, NULL);
     for (i=0; i < file_count; i++) {
 	char tmp_file_name[PATH_SIZE];
 	file_handle = 0;
 
-        cur_extent.first = cur_extent.last = requested_file_handle;
+        cur_extent.first = cur_extent.last = requested_file_handle + i;
         extent_array.extent_count = 1;
         extent_array.extent_array = &cur_extent;
 	ret = trove_dspace_create(coll_id,
@@ -154,6 +196,60 @@ int main(int argc, char **argv)
 	    fprintf(stderr, "keyval write failed.\n");
 	    return -1;
 	}
+
+	if (buf) {
+	    ret = trove_bstream_write_list(coll_id, file_handle,
+                                           &buf, &stream_size, 1,
+                                           &stream_offset, &stream_size, 1,
+                                           &out_size, 0, NULL, NULL,
+                                           trove_context, &op_id, NULL);
+	    while (ret == 0) ret = trove_dspace_test(
+                coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+                TROVE_DEFAULT_TEST_TIMEOUT);
+	    if (ret < 0 || out_size != stream_size) {
+		fprintf(stderr, "bstream write failed.\n");
+		return -1;
+	    }
+	}
+    }
+    secs = elapsed(&start);
+    printf("created %d files with %d byte bstreams in %.2f seconds "
+           "(%.0f files/s)\n", file_count, bstream_size, secs,
+           file_count / secs);
+    free(buf);
+
+    if (remove_odd) {
+        gettimeofday(&start, NULL);
+        for (i=1; i < file_count; i += 2) {
+            char tmp_file_name[PATH_SIZE];
+
+            snprintf(tmp_file_name, PATH_SIZE, "%s/file%d", path_name, i);
+            key.buffer = tmp_file_name;
+            key.buffer_sz = strlen(tmp_file_name) + 1;
+            ret = trove_keyval_remove(coll_id, parent_handle, &key, NULL,
+                                      0, NULL, NULL, trove_context, &op_id,
+                                      NULL);
+            while (ret == 0) ret = trove_dspace_test(
+                coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+                TROVE_DEFAULT_TEST_TIMEOUT);
+            if (ret < 0) {
+                fprintf(stderr, "keyval remove failed.\n");
+                return -1;
+            }
+
+            ret = trove_dspace_remove(coll_id, requested_file_handle + i,
+                                      0, NULL, trove_context, &op_id, NULL);
+            while (ret == 0) ret = trove_dspace_test(
+                coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+                TROVE_DEFAULT_TEST_TIMEOUT);
+            if (ret < 0) {
+                fprintf(stderr, "dspace remove failed.\n");
+                return -1;
+            }
+        }
+        secs = elapsed(&start);
+        printf("removed %d files in %.2f seconds (%.0f files/s)\n",
+               file_count / 2, secs, (file_count / 2) / secs);
     }
     
     trove_close_context(coll_id, trove_context);
@@ -166,7 +262,7 @@ int parse_args(int argc, char **argv)
 {
     int c;
 
-    while ((c = getopt(argc, argv, "s:c:p:n:")) != EOF) {
+    while ((c = getopt(argc, argv, "s:c:p:n:b:P:r")) != EOF) {
 	switch (c) {
 	    case 's':
 		strncpy(storage_space, optarg, SSPACE_SIZE);
@@ -180,6 +276,15 @@ int parse_args(int argc, char **argv)
 	    case 'n':
 		file_count = atoi(optarg);
 		break;
+	    case 'b': /* bytes written to each file's bstream */
+		bstream_size = atoi(optarg);
+		break;
+	    case 'P': /* largest bstream kept in the packed store */
+		packed_max = atoi(optarg);
+		break;
+	    case 'r': /* remove every other file afterwards */
+		remove_odd = 1;
+		break;
 	    case '?':
 	    default:
 		return -1;
@@ -0,0 +1,201 @@
+/*
+ * (C) 2002 Clemson University and The University of Chicago
+ *
+ * See COPYING in top-level directory.
+ */
+
+/* Creates a set of dataspaces and times trove_dspace_getattr_list() over
+ * all of them.  The attribute cache is not set up in this program, so every
+ * pass reads the attributes from the database.
+ */
+
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include "trove.h"
+#include "trove-test.h"
+
+char storage_space[SSPACE_SIZE] = "/tmp/trove-test-space";
+char file_system[FS_SIZE] = "fs-foo";
+TROVE_handle first_handle = 1048576;
+
+int handle_count = 1000;
+int pass_count = 100;
+int skip_create = 0;
+
+int parse_args(int argc, char **argv);
+
+static double Wtime(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return((double)t.tv_sec + (double)(t.tv_usec) / 1000000);
+}
+
+int main(int argc, char **argv)
+{
+    int ret, count, i, j;
+    TROVE_op_id op_id;
+    TROVE_coll_id coll_id;
+    TROVE_handle file_handle;
+    TROVE_handle *handles;
+    TROVE_ds_state state, *errors;
+    TROVE_ds_attributes_s s_attr, *attrs;
+    TROVE_extent cur_extent;
+    TROVE_handle_extent_array extent_array;
+    TROVE_context_id trove_context = -1;
+    double start, elapsed;
+
+    ret = parse_args(argc, argv);
+    if (ret < 0) {
+	fprintf(stderr, "argument parsing failed.\n");
+	return -1;
+    }
+
+    handles = malloc(handle_count * sizeof(*handles));
+    attrs = malloc(handle_count * sizeof(*attrs));
+    errors = malloc(handle_count * sizeof(*errors));
+    if (!handles || !attrs || !errors) {
+	fprintf(stderr, "out of memory.\n");
+	return -1;
+    }
+
+    ret = trove_initialize(
+        TROVE_METHOD_DBPF, NULL, storage_space, storage_space, 0);
+    if (ret < 0) {
+	fprintf(stderr, "initialize failed.\n");
+	return -1;
+    }
+
+    ret = trove_collection_lookup(
+        TROVE_METHOD_DBPF, file_system, &coll_id, NULL, &op_id);
+    if (ret < 0) {
+	fprintf(stderr, "collection lookup failed.\n");
+	return -1;
+    }
+
+    ret = trove_open_context(coll_id, &trove_context);
+    if (ret < 0) {
+        fprintf(stderr, "trove_open_context failed\n");
+        return -1;
+    }
+
+    /* spread the handles out so that they are not requested in key order */
+    for (i = 0; i < handle_count; i++) {
+	handles[i] = first_handle + ((i * 7919) % handle_count);
+    }
+
+    for (i = 0; i < handle_count && !skip_create; i++) {
+	cur_extent.first = cur_extent.last = handles[i];
+	extent_array.extent_count = 1;
+	extent_array.extent_array = &cur_extent;
+	ret = trove_dspace_create(coll_id, &extent_array, &file_handle,
+				  TROVE_TEST_FILE, NULL,
+				  TROVE_FORCE_REQUESTED_HANDLE, NULL,
+				  trove_context, &op_id, NULL);
+	while (ret == 0) ret = trove_dspace_test(
+            coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+            TROVE_DEFAULT_TEST_TIMEOUT);
+	if (ret < 0) {
+	    fprintf(stderr, "dspace create failed.\n");
+	    return -1;
+	}
+
+	memset(&s_attr, 0, sizeof(s_attr));
+	s_attr.fs_id  = coll_id;
+	s_attr.handle = file_handle;
+	s_attr.type   = TROVE_TEST_FILE;
+	s_attr.uid    = getuid();
+	s_attr.gid    = getgid();
+	s_attr.mode   = 0644;
+	s_attr.ctime  = time(NULL);
+
+	ret = trove_dspace_setattr(coll_id, file_handle, &s_attr, 0, NULL,
+				   trove_context, &op_id, NULL);
+	while (ret == 0) ret = trove_dspace_test(
+            coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+            TROVE_DEFAULT_TEST_TIMEOUT);
+	if (ret < 0) {
+	    fprintf(stderr, "dspace setattr failed.\n");
+	    return -1;
+	}
+    }
+
+    start = Wtime();
+    for (j = 0; j < pass_count; j++) {
+	memset(attrs, 0, handle_count * sizeof(*attrs));
+	ret = trove_dspace_getattr_list(coll_id, handle_count, handles,
+					attrs, errors, 0, NULL,
+					trove_context, &op_id, NULL);
+	while (ret == 0) ret = trove_dspace_test(
+            coll_id, op_id, trove_context, &count, NULL, NULL, &state,
+            TROVE_DEFAULT_TEST_TIMEOUT);
+	if (ret < 0) {
+	    fprintf(stderr, "dspace getattr list failed.\n");
+	    return -1;
+	}
+	for (i = 0; i < handle_count; i++) {
+	    if (errors[i] != 0 || attrs[i].handle != handles[i]) {
+		fprintf(stderr, "bad attributes for handle %llu.\n",
+			llu(handles[i]));
+		return -1;
+	    }
+	}
+    }
+    elapsed = Wtime() - start;
+
+    printf("%d passes of %d handles in %f seconds (%.0f handles/s)\n",
+	   pass_count, handle_count, elapsed,
+	   (double)pass_count * handle_count / elapsed);
+
+    trove_close_context(coll_id, trove_context);
+    trove_finalize(TROVE_METHOD_DBPF);
+    free(handles);
+    free(attrs);
+    free(errors);
+
+    return 0;
+}
+
+int parse_args(int argc, char **argv)
+{
+    int c;
+
+    while ((c = getopt(argc, argv, "s:c:n:i:x")) != EOF) {
+	switch (c) {
+	    case 's':
+		strncpy(storage_space, optarg, SSPACE_SIZE);
+		break;
+	    case 'c': /* collection */
+		strncpy(file_system, optarg, FS_SIZE);
+		break;
+	    case 'n': /* dataspaces read by each pass */
+		handle_count = atoi(optarg);
+		break;
+	    case 'i': /* passes */
+		pass_count = atoi(optarg);
+		break;
+	    case 'x': /* dataspaces exist from an earlier run */
+		skip_create = 1;
+		break;
+	    case '?':
+	    default:
+		return -1;
+	}
+    }
+    return 0;
+}
+
+/*
+ * Local variables:
+ *  c-indent-level: 4
+ *  c-basic-offset: 4
+ * End:
+ *
+ * vim: ts=8 sts=4 sw=4 expandtab
+ */